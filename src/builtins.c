@@ -7,9 +7,10 @@
 
 #include "private.h"
 
-static KrkClass * Helper;
-static KrkClass * LicenseReader;
-static KrkClass * property;
+static KrkVMLocal helperKey;
+#define Helper KRK_VM_LOCAL(KrkClass*,helperKey)
+static KrkVMLocal licenseReaderKey;
+#define LicenseReader KRK_VM_LOCAL(KrkClass*,licenseReaderKey)
 
 FUNC_SIG(list,__init__);
 FUNC_SIG(list,sort);
@@ -206,6 +207,22 @@ KRK_FUNC(bin,{
 	return finishStringBuilder(&sb);
 })
 
+/**
+ * The values of @p value if it is a tuple or exactly a list, which the
+ * builtins below read directly instead of going through an iterator.
+ */
+static inline KrkValueArray * directValues(KrkValue value) {
+	if (IS_TUPLE(value)) return &AS_TUPLE(value)->values;
+	if (IS_INSTANCE(value) && AS_INSTANCE(value)->_class == vm.baseClasses->listClass) return AS_LIST(value);
+	return NULL;
+}
+
+#define IS_NUMBER(value) (IS_INTEGER(value) || IS_FLOATING(value))
+
+static inline double numberAsDouble(KrkValue value) {
+	return IS_INTEGER(value) ? (double)AS_INTEGER(value) : AS_FLOATING(value);
+}
+
 #define unpackArray(counter, indexer) do { \
 	for (size_t i = 0; i < counter; ++i) { \
 		if (!krk_isFalsey(indexer)) { \
@@ -216,6 +233,8 @@ KRK_FUNC(bin,{
 } while (0)
 KRK_FUNC(any,{
 	FUNCTION_TAKES_EXACTLY(1);
+	krk_integer_type first, step, count;
+	if (krk_rangeValues(argv[0], &first, &step, &count)) return BOOLEAN_VAL(count > 1 || (count == 1 && first != 0));
 	unpackIterableFast(argv[0]);
 	return BOOLEAN_VAL(0);
 })
@@ -231,85 +250,150 @@ KRK_FUNC(any,{
 } while (0)
 KRK_FUNC(all,{
 	FUNCTION_TAKES_EXACTLY(1);
+	krk_integer_type first, step, count;
+	if (krk_rangeValues(argv[0], &first, &step, &count)) {
+		/* True unless 0 is one of the values. */
+		if (!count) return BOOLEAN_VAL(1);
+		krk_integer_type last = first + step * (count - 1);
+		krk_integer_type low = step > 0 ? first : last, high = step > 0 ? last : first;
+		return BOOLEAN_VAL(!(low <= 0 && high >= 0 && first % step == 0));
+	}
 	unpackIterableFast(argv[0]);
 	return BOOLEAN_VAL(1);
 })
 #undef unpackArray
 
-#define CURRENT_CTYPE KrkInstance *
+/**
+ * Where map, filter and enumerate get their values from: a tuple or a
+ * list is read directly by index, anything else through its iterator.
+ */
+static KrkValue iterSource(KrkValue iterable) {
+	if (directValues(iterable)) return iterable;
+	KrkClass * type = krk_getType(iterable);
+	if (!type->_iter) return krk_runtimeError(vm.exceptions->typeError, "'%s' object is not iterable", krk_typeName(iterable));
+	krk_push(iterable);
+	return krk_callDirect(type->_iter, 1);
+}
+
+/**
+ * Get the next value from @p source, made by @ref iterSource; @p index is
+ * how far a list or tuple has been read.
+ *
+ * @return 1 with the value in @p out, 0 at the end, or -1 on an exception.
+ */
+static int iterNext(KrkValue source, size_t * index, KrkValue * out) {
+	KrkValueArray * values = directValues(source);
+	if (values) {
+		if (*index >= values->count) return 0;
+		*out = values->values[(*index)++];
+		return 1;
+	}
+	krk_push(source);
+	KrkValue value = krk_callStack(0);
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return -1;
+	if (krk_valuesSame(value, source)) return 0;
+	*out = value;
+	return 1;
+}
+
+/**
+ * Call @p function with the @p argc values on the top of the stack, and
+ * pop them. Native functions are called directly, without going through
+ * the VM and setting up a call frame.
+ */
+static KrkValue callWithStack(KrkValue function, int argc) {
+	if (IS_NATIVE(function)) {
+		KrkValue result = krk_callNativeOnStack(argc, krk_currentThread.stackTop - argc, 0, AS_NATIVE(function)->function);
+		krk_currentThread.stackTop -= argc;
+		return result;
+	}
+	krk_push(function);
+	memmove(krk_currentThread.stackTop - argc, krk_currentThread.stackTop - argc - 1, sizeof(KrkValue) * argc);
+	krk_currentThread.stackTop[-argc - 1] = function;
+	return krk_callStack(argc);
+}
+
 #define CURRENT_NAME  self
 
-#define IS_map(o) (krk_isInstanceOf(o,map))
-#define AS_map(o) (AS_INSTANCE(o))
-static KrkClass * map;
+/**
+ * @brief Iterator over the results of calling a function with values from some iterables.
+ * @extends KrkInstance
+ */
+struct map {
+	KrkInstance inst;
+	KrkValue function;
+	KrkValue sources;  /**< Tuple of what @ref iterSource made for each iterable */
+	size_t * indices;  /**< How far each source has been read, if it is a list or tuple */
+	size_t count;      /**< Sources there are indices for */
+};
+
+#define IS_map(o) (krk_isInstanceOf(o,mapClass))
+#define AS_map(o) ((struct map*)AS_OBJECT(o))
+#define CURRENT_CTYPE struct map *
+static KrkVMLocal mapKey;
+#define mapClass KRK_VM_LOCAL(KrkClass*,mapKey)
+
+static void _map_gcscan(KrkInstance * self) {
+	krk_markValue(((struct map*)self)->function);
+	krk_markValue(((struct map*)self)->sources);
+}
+
+static void _map_gcsweep(KrkInstance * self) {
+	struct map * me = (struct map*)self;
+	if (me->indices) FREE_ARRAY(size_t, me->indices, me->count);
+	me->indices = NULL;
+	me->count = 0;
+}
+
 KRK_METHOD(map,__init__,{
 	METHOD_TAKES_AT_LEAST(2);
-
-	/* Attach the function to it */
-	krk_attachNamedValue(&self->fields, "_function", argv[1]);
+	_map_gcsweep((KrkInstance*)self);
+	self->function = argv[1];
 
 	/* Make the iter objects */
-	KrkTuple * iters = krk_newTuple(argc - 2);
-	krk_push(OBJECT_VAL(iters));
-
-	/* Attach the tuple to the object */
-	krk_attachNamedValue(&self->fields, "_iterables", krk_peek(0));
-	krk_pop();
+	KrkTuple * sources = krk_newTuple(argc - 2);
+	self->sources = OBJECT_VAL(sources);
+	krk_gcWriteBarrier((KrkObj*)self);
 
 	for (int i = 2; i < argc; ++i) {
-		KrkClass * type = krk_getType(argv[i]);
-		if (!type->_iter) {
-			return krk_runtimeError(vm.exceptions->typeError, "'%s' object is not iterable", krk_typeName(argv[i]));
-		}
-		krk_push(argv[i]);
-		KrkValue asIter = krk_callDirect(type->_iter, 1);
+		KrkValue source = iterSource(argv[i]);
 		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return NONE_VAL();
-		/* Attach it to the tuple */
-		iters->values.values[iters->values.count++] = asIter;
+		sources->values.values[sources->values.count++] = source;
+		krk_gcWriteBarrier((KrkObj*)sources);
 	}
 
+	self->indices = ALLOCATE(size_t, sources->values.count);
+	memset(self->indices, 0, sizeof(size_t) * sources->values.count);
+	self->count = sources->values.count;
 	return argv[0];
 })
 
 KRK_METHOD(map,__iter__,{
 	METHOD_TAKES_NONE();
-	return OBJECT_VAL(self);
+	return argv[0];
 })
 
 KRK_METHOD(map,__call__,{
 	METHOD_TAKES_NONE();
-
-	size_t stackOffset = krk_currentThread.stackTop - krk_currentThread.stack;
-
-	/* Get members */
-	KrkValue function = NONE_VAL();
-	KrkValue iterators = NONE_VAL();
-
-	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("_function")), &function)) return krk_runtimeError(vm.exceptions->valueError, "corrupt map object");
-	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("_iterables")), &iterators) || !IS_TUPLE(iterators)) return krk_runtimeError(vm.exceptions->valueError, "corrupt map object");
-
-	krk_push(function);
-
-	/* Go through each iterator */
-	for (size_t i = 0; i < AS_TUPLE(iterators)->values.count; ++i) {
-		/* Obtain the next value and push it */
-		krk_push(AS_TUPLE(iterators)->values.values[i]);
-		krk_push(krk_callStack(0));
-		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return NONE_VAL();
-		/* End iteration whenever one runs out */
-		if (krk_valuesEqual(krk_peek(0), AS_TUPLE(iterators)->values.values[i])) {
-			for (size_t j = 0; j < i + 1; ++j) krk_pop();
-			krk_pop(); /* the function */
-			return OBJECT_VAL(self);
+	if (!IS_TUPLE(self->sources) || self->count != AS_TUPLE(self->sources)->values.count) return krk_runtimeError(vm.exceptions->valueError, "corrupt map object");
+	KrkTuple * sources = AS_TUPLE(self->sources);
+
+	/* Push the next value of each source, ending whenever one runs out */
+	for (size_t i = 0; i < sources->values.count; ++i) {
+		KrkValue value;
+		int status = iterNext(sources->values.values[i], &self->indices[i], &value);
+		if (status != 1) {
+			krk_currentThread.stackTop -= i;
+			return status ? NONE_VAL() : argv[0];
 		}
+		krk_push(value);
 	}
 
-	/* Call the function */
-	KrkValue val = krk_callStack(AS_TUPLE(iterators)->values.count);
-	krk_currentThread.stackTop = krk_currentThread.stack + stackOffset;
-	return val;
+	return callWithStack(self->function, sources->values.count);
 })
 
+#undef CURRENT_CTYPE
+
 KRK_FUNC(zip,{
 	if (!argc) return NONE_VAL(); /* uh, new empty tuple maybe? */
 	KrkValue map = NONE_VAL();
@@ -327,151 +411,235 @@ KRK_FUNC(zip,{
 	return krk_callStack(argc+1);
 })
 
-#define IS_filter(o) (krk_isInstanceOf(o,filter))
-#define AS_filter(o) (AS_INSTANCE(o))
-static KrkClass * filter;
+/**
+ * @brief Iterator over the values from an iterable that a function returns true for.
+ * @extends KrkInstance
+ */
+struct filter {
+	KrkInstance inst;
+	KrkValue function;  /**< None to keep the values that are true themselves */
+	KrkValue source;    /**< What @ref iterSource made for the iterable */
+	size_t index;
+};
+
+#define IS_filter(o) (krk_isInstanceOf(o,filterClass))
+#define AS_filter(o) ((struct filter*)AS_OBJECT(o))
+#define CURRENT_CTYPE struct filter *
+static KrkVMLocal filterKey;
+#define filterClass KRK_VM_LOCAL(KrkClass*,filterKey)
+
+static void _filter_gcscan(KrkInstance * self) {
+	krk_markValue(((struct filter*)self)->function);
+	krk_markValue(((struct filter*)self)->source);
+}
+
 KRK_METHOD(filter,__init__,{
 	METHOD_TAKES_EXACTLY(2);
-	krk_attachNamedValue(&self->fields, "_function", argv[1]);
-	KrkClass * type = krk_getType(argv[2]);
-	if (!type->_iter) {
-		return krk_runtimeError(vm.exceptions->typeError, "'%s' object is not iterable", krk_typeName(argv[2]));
-	}
-	krk_push(argv[2]);
-	KrkValue asIter = krk_callDirect(type->_iter, 1);
+	self->function = argv[1];
+	self->index = 0;
+	krk_gcWriteBarrier((KrkObj*)self);
+	KrkValue source = iterSource(argv[2]);
 	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return NONE_VAL();
-	krk_attachNamedValue(&self->fields, "_iterator", asIter);
+	self->source = source;
+	krk_gcWriteBarrier((KrkObj*)self);
 	return argv[0];
 })
 
 KRK_METHOD(filter,__iter__,{
 	METHOD_TAKES_NONE();
-	return OBJECT_VAL(self);
+	return argv[0];
 })
 
 KRK_METHOD(filter,__call__,{
 	METHOD_TAKES_NONE();
-	size_t stackOffset = krk_currentThread.stackTop - krk_currentThread.stack;
-	KrkValue function = NONE_VAL();
-	KrkValue iterator = NONE_VAL();
-
-	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("_function")), &function)) return krk_runtimeError(vm.exceptions->valueError, "corrupt filter object");
-	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("_iterator")), &iterator)) return krk_runtimeError(vm.exceptions->valueError, "corrupt filter object");
-
 	while (1) {
-		krk_push(iterator);
-		krk_push(krk_callStack(0));
-
-		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return NONE_VAL();
-		if (krk_valuesEqual(iterator, krk_peek(0))) {
-			krk_currentThread.stackTop = krk_currentThread.stack + stackOffset;
-			return OBJECT_VAL(self);
-		}
+		KrkValue value;
+		int status = iterNext(self->source, &self->index, &value);
+		if (status != 1) return status ? NONE_VAL() : argv[0];
 
-		if (IS_NONE(function)) {
-			if (krk_isFalsey(krk_peek(0))) {
-				krk_pop(); /* iterator result */
-				continue;
-			}
+		krk_push(value);
+		if (IS_NONE(self->function)) {
+			if (!krk_isFalsey(value)) return krk_pop();
 		} else {
-			krk_push(function);
-			krk_push(krk_peek(1));
-			KrkValue result = krk_callStack(1);
-			if (krk_isFalsey(result)) {
-				krk_pop(); /* iterator result */
-				continue;
+			krk_push(value);
+			KrkValue result = callWithStack(self->function, 1);
+			if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) {
+				krk_pop();
+				return NONE_VAL();
 			}
+			if (!krk_isFalsey(result)) return krk_pop();
 		}
-
-		KrkValue out = krk_pop();
-		krk_currentThread.stackTop = krk_currentThread.stack + stackOffset;
-		return out;
+		krk_pop();
 	}
 })
 
-#define IS_enumerate(o) (krk_isInstanceOf(o,enumerate))
-#define AS_enumerate(o) (AS_INSTANCE(o))
-static KrkClass * enumerate;
+#undef CURRENT_CTYPE
+
+/**
+ * @brief Iterator over pairs of a count and the values from an iterable.
+ * @extends KrkInstance
+ */
+struct enumerate {
+	KrkInstance inst;
+	KrkValue counter;
+	KrkValue source;  /**< What @ref iterSource made for the iterable */
+	size_t index;
+};
+
+#define IS_enumerate(o) (krk_isInstanceOf(o,enumerateClass))
+#define AS_enumerate(o) ((struct enumerate*)AS_OBJECT(o))
+#define CURRENT_CTYPE struct enumerate *
+static KrkVMLocal enumerateKey;
+#define enumerateClass KRK_VM_LOCAL(KrkClass*,enumerateKey)
+
+static void _enumerate_gcscan(KrkInstance * self) {
+	krk_markValue(((struct enumerate*)self)->counter);
+	krk_markValue(((struct enumerate*)self)->source);
+}
+
 KRK_METHOD(enumerate,__init__,{
-	METHOD_TAKES_EXACTLY(1);
+	KRK_ARGS(args, ".O|O", "iterable", "start");
+	KrkValue iterable;
 	KrkValue start = INTEGER_VAL(0);
-	if (hasKw) krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("start")), &start);
+	if (!krk_parseArgs(args, &iterable, &start)) return NONE_VAL();
 
-	krk_attachNamedValue(&self->fields, "_counter", start);
+	self->counter = start;
+	self->index = 0;
+	krk_gcWriteBarrier((KrkObj*)self);
 
-	/* Attach iterator */
-	KrkClass * type = krk_getType(argv[1]);
-	if (!type->_iter) {
-		return krk_runtimeError(vm.exceptions->typeError, "'%s' object is not iterable", krk_typeName(argv[1]));
-	}
-	krk_push(argv[1]);
-	KrkValue asIter = krk_callDirect(type->_iter, 1);
+	KrkValue source = iterSource(iterable);
 	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return NONE_VAL();
-	krk_attachNamedValue(&self->fields, "_iterator", asIter);
+	self->source = source;
+	krk_gcWriteBarrier((KrkObj*)self);
 
 	return argv[0];
 })
 
 KRK_METHOD(enumerate,__iter__,{
 	METHOD_TAKES_NONE();
-	return OBJECT_VAL(self);
+	return argv[0];
 })
 
 extern KrkValue krk_operator_add (KrkValue a, KrkValue b);
 KRK_METHOD(enumerate,__call__,{
 	METHOD_TAKES_NONE();
-	size_t stackOffset = krk_currentThread.stackTop - krk_currentThread.stack;
-	KrkValue counter = NONE_VAL();
-	KrkValue iterator = NONE_VAL();
-
-	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("_counter")), &counter)) return krk_runtimeError(vm.exceptions->valueError, "corrupt enumerate object");
-	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("_iterator")), &iterator)) return krk_runtimeError(vm.exceptions->valueError, "corrupt enumerate object");
+	KrkValue value;
+	int status = iterNext(self->source, &self->index, &value);
+	if (status != 1) return status ? NONE_VAL() : argv[0];
+	krk_push(value);
 
+	/* Make a tuple */
 	KrkTuple * tupleOut = krk_newTuple(2);
+	tupleOut->values.values[tupleOut->values.count++] = self->counter;
+	tupleOut->values.values[tupleOut->values.count++] = krk_pop();
 	krk_push(OBJECT_VAL(tupleOut));
 
-	krk_push(iterator);
-	krk_push(krk_callStack(0));
-
-	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) {
-		krk_currentThread.stackTop = krk_currentThread.stack + stackOffset;
-		return NONE_VAL();
-	}
-	if (krk_valuesEqual(iterator, krk_peek(0))) {
-		krk_pop();
-		krk_pop();
-		krk_currentThread.stackTop = krk_currentThread.stack + stackOffset;
-		return OBJECT_VAL(self);
+	if (IS_INTEGER(self->counter) && !IS_BOOLEAN(self->counter)) {
+		self->counter = INTEGER_VAL(AS_INTEGER(self->counter) + 1);
+	} else {
+		self->counter = krk_operator_add(self->counter, INTEGER_VAL(1));
+		krk_gcWriteBarrier((KrkObj*)self);
 	}
 
-	/* Make a tuple */
-	tupleOut->values.values[tupleOut->values.count++] = counter;
-	tupleOut->values.values[tupleOut->values.count++] = krk_pop();
+	return krk_pop();
+})
 
-	krk_push(krk_operator_add(counter, INTEGER_VAL(1)));
-	krk_attachNamedValue(&self->fields, "_counter", krk_pop());
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE KrkInstance *
 
-	KrkValue out = krk_pop();
-	krk_currentThread.stackTop = krk_currentThread.stack + stackOffset;
-	return out;
-})
+/**
+ * Add the numbers at the start of @p values to @p total, keeping the
+ * running sum unboxed, and return how many were added: adding stops at
+ * the first value that isn't an int or a float. Ints wrap as they do when
+ * added one at a time.
+ */
+static size_t sumNumbers(KrkValue * total, const KrkValue values[], size_t count) {
+	size_t i = 0;
+	if (!count || !IS_NUMBER(*total) || !IS_NUMBER(values[0])) return 0;
+	if (IS_INTEGER(*total)) {
+		uint64_t sum = AS_INTEGER(*total);
+		for (; i < count && IS_INTEGER(values[i]); ++i) sum += AS_INTEGER(values[i]);
+		*total = INTEGER_VAL(sum);
+	}
+	if (i < count && IS_NUMBER(values[i])) {
+		double sum = numberAsDouble(*total);
+		for (; i < count && IS_NUMBER(values[i]); ++i) sum += numberAsDouble(values[i]);
+		*total = FLOATING_VAL(sum);
+	}
+	return i;
+}
 
 #define unpackArray(counter, indexer) do { \
 	for (size_t i = 0; i < counter; ++i) { \
 		base = krk_operator_add(base, indexer); \
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) { \
+			if (unpackingIterable) { krk_pop(); krk_pop(); } \
+			return NONE_VAL(); \
+		} \
 	} \
 } while (0)
 KRK_FUNC(sum,{
-	FUNCTION_TAKES_AT_LEAST(1);
+	KRK_ARGS(args, "O|O", "iterable", "start");
+	KrkValue iterable;
 	KrkValue base = INTEGER_VAL(0);
-	if (hasKw) {
-		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("start")), &base);
+	if (!krk_parseArgs(args, &iterable, &base)) return NONE_VAL();
+	krk_integer_type first, step, count;
+	KrkValueArray * values = directValues(iterable);
+	if (IS_INTEGER(base) && krk_rangeValues(iterable, &first, &step, &count)) {
+		if (!count) return base;
+		/* Unsigned, so this wraps the same way adding the values one a time would. */
+		uint64_t n = count;
+		uint64_t steps = (n % 2 == 0) ? (n / 2) * (n - 1) : n * ((n - 1) / 2);
+		return INTEGER_VAL((uint64_t)AS_INTEGER(base) + n * (uint64_t)first + steps * (uint64_t)step);
+	} else if (values) {
+		int unpackingIterable = 0;
+		size_t start = sumNumbers(&base, values->values, values->count);
+		/* Anything left is added generically; that can run code that changes the list. */
+		unpackArray((values->count > start ? values->count - start : 0), values->values[start + i]);
+		return base;
 	}
-	unpackIterableFast(argv[0]);
+	unpackIterableFast(iterable);
 	return base;
 })
 #undef unpackArray
 
+/**
+ * Find the smallest of the numbers at the start of @p values, or the
+ * largest if @p largest is set, starting from @p best, and return how many
+ * were looked at: looking stops at the first value that isn't an int or
+ * a float. The first of equal values is kept, as for any other values.
+ */
+static size_t extremeNumbers(KrkValue * best, const KrkValue values[], size_t count, int largest) {
+	size_t i = 0;
+	if (IS_KWARGS(*best) && count && IS_NUMBER(values[0])) *best = values[i++];
+	if (!IS_NUMBER(*best)) return i;
+	KrkValue found = *best;
+	for (; i < count && IS_NUMBER(values[i]); ++i) {
+		KrkValue value = values[i];
+		int better;
+		if (IS_INTEGER(value) && IS_INTEGER(found)) {
+			better = largest ? AS_INTEGER(value) > AS_INTEGER(found) : AS_INTEGER(value) < AS_INTEGER(found);
+		} else {
+			double x = numberAsDouble(value), y = numberAsDouble(found);
+			better = largest ? x > y : x < y;
+		}
+		if (better) found = value;
+	}
+	*best = found;
+	return i;
+}
+
+/**
+ * The smallest, or largest, value of a non-empty range, or None, having
+ * raised an exception, for an empty one.
+ */
+static KrkValue rangeExtreme(const char * name, krk_integer_type first, krk_integer_type step, krk_integer_type count, int largest) {
+	if (!count) return krk_runtimeError(vm.exceptions->valueError, "empty argument to %s()", name);
+	krk_integer_type last = first + step * (count - 1);
+	if (largest) return INTEGER_VAL(step > 0 ? last : first);
+	return INTEGER_VAL(step > 0 ? first : last);
+}
+
 extern KrkValue krk_operator_lt(KrkValue a, KrkValue b);
 #define unpackArray(counter, indexer) do { \
 	for (size_t i = 0; i < counter; ++i) { \
@@ -486,8 +654,16 @@ extern KrkValue krk_operator_lt(KrkValue a, KrkValue b);
 KRK_FUNC(min,{
 	FUNCTION_TAKES_AT_LEAST(1);
 	KrkValue base = KWARGS_VAL(0);
+	krk_integer_type first, step, count;
+	KrkValueArray * values = argc > 1 ? NULL : directValues(argv[0]);
 	if (argc > 1) {
-		unpackArray((size_t)argc,argv[i]);
+		size_t start = extremeNumbers(&base, argv, argc, 0);
+		unpackArray((size_t)argc - start, argv[start + i]);
+	} else if (krk_rangeValues(argv[0], &first, &step, &count)) {
+		return rangeExtreme("min", first, step, count, 0);
+	} else if (values) {
+		size_t start = extremeNumbers(&base, values->values, values->count, 0);
+		unpackArray((values->count > start ? values->count - start : 0), values->values[start + i]);
 	} else {
 		unpackIterableFast(argv[0]);
 	}
@@ -510,8 +686,16 @@ extern KrkValue krk_operator_gt(KrkValue a, KrkValue b);
 KRK_FUNC(max,{
 	FUNCTION_TAKES_AT_LEAST(1);
 	KrkValue base = KWARGS_VAL(0);
+	krk_integer_type first, step, count;
+	KrkValueArray * values = argc > 1 ? NULL : directValues(argv[0]);
 	if (argc > 1) {
-		unpackArray((size_t)argc,argv[i]);
+		size_t start = extremeNumbers(&base, argv, argc, 1);
+		unpackArray((size_t)argc - start, argv[start + i]);
+	} else if (krk_rangeValues(argv[0], &first, &step, &count)) {
+		return rangeExtreme("max", first, step, count, 1);
+	} else if (values) {
+		size_t start = extremeNumbers(&base, values->values, values->count, 1);
+		unpackArray((values->count > start ? values->count - start : 0), values->values[start + i]);
 	} else {
 		unpackIterableFast(argv[0]);
 	}
@@ -521,41 +705,63 @@ KRK_FUNC(max,{
 #undef unpackArray
 
 KRK_FUNC(print,{
-	KrkValue sepVal;
-	KrkValue endVal;
-	char * sep = " "; size_t sepLen = 1;
-	char * end = "\n"; size_t endLen = 1;
-	if (hasKw) {
-		if (krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("sep")), &sepVal)) {
-			if (!IS_STRING(sepVal)) return krk_runtimeError(vm.exceptions->typeError, "'%s' should be a string, not '%s'", "sep", krk_typeName(sepVal));
-			sep = AS_CSTRING(sepVal);
-			sepLen = AS_STRING(sepVal)->length;
-		}
-		if (krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("end")), &endVal)) {
-			if (!IS_STRING(endVal)) return krk_runtimeError(vm.exceptions->typeError, "'%s' should be a string, not '%s'", "end", krk_typeName(endVal));
-			end = AS_CSTRING(endVal);
-			endLen = AS_STRING(endVal)->length;
+	KRK_ARGS(args, "*$|z#z#Op", "sep", "end", "file", "flush");
+	int count;
+	const KrkValue * values;
+	const char * sep = " "; size_t sepLen = 1;
+	const char * end = "\n"; size_t endLen = 1;
+	KrkValue file = NONE_VAL();
+	int flush = 0;
+	if (!krk_parseArgs(args, &count, &values, &sep, &sepLen, &end, &endLen, &file, &flush)) return NONE_VAL();
+	if (!sep) { sep = " "; sepLen = 1; }
+	if (!end) { end = "\n"; endLen = 1; }
+	if (IS_NONE(file)) krk_tableGet_fast(&vm.system->fields, S("stdout"), &file);
+
+	/* Everything is written at once, so lines printed by different threads do not interleave. */
+	struct StringBuilder sb = {0};
+	for (int i = 0; i < count; ++i) {
+		if (i) pushStringBuilderStr(&sb, sep, sepLen);
+		KrkValue printable = values[i];
+		if (!IS_STRING(printable)) {
+			KrkClass * type = krk_getType(printable);
+			krk_push(printable);
+			printable = krk_callDirect(type->_tostr ? type->_tostr : type->_reprer, 1);
+			if (!IS_STRING(printable)) {
+				if (!(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION)) {
+					krk_runtimeError(vm.exceptions->typeError, "__str__ returned non-string (type %s)", krk_typeName(printable));
+				}
+				return discardStringBuilder(&sb);
+			}
 		}
+		/* Growing the builder can collect garbage. */
+		krk_push(printable);
+		pushStringBuilderStr(&sb, AS_CSTRING(printable), AS_STRING(printable)->length);
+		krk_pop();
 	}
-	if (!argc) {
-		for (size_t j = 0; j < endLen; ++j) {
-			fputc(end[j], stdout);
+	pushStringBuilderStr(&sb, end, endLen);
+
+	FILE * stream = stdout;
+	if (IS_NONE(file) || krk_fileStream(file, &stream)) {
+		/* Like File.write, writing to a closed file does nothing. */
+		if (stream) {
+			krk_beginBlocking();
+			fwrite(sb.bytes, 1, sb.length, stream);
+			if (flush) fflush(stream);
+			krk_endBlocking();
 		}
+		return discardStringBuilder(&sb);
 	}
-	for (int i = 0; i < argc; ++i) {
-		KrkValue printable = argv[i];
-		if (IS_STRING(printable)) { /* krk_printValue runs repr */
-			/* Make sure we handle nil bits correctly. */
-			for (size_t j = 0; j < AS_STRING(printable)->length; ++j) {
-				fputc(AS_CSTRING(printable)[j], stdout);
-			}
-		} else {
-			krk_printValue(stdout, printable);
-		}
-		char * thingToPrint = (i == argc - 1) ? end : sep;
-		for (size_t j = 0; j < ((i == argc - 1) ? endLen : sepLen); ++j) {
-			fputc(thingToPrint[j], stdout);
-		}
+
+	KrkValue write = krk_valueGetAttribute(file, "write");
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return discardStringBuilder(&sb);
+	krk_push(write);
+	krk_push(finishStringBuilder(&sb));
+	krk_callStack(1);
+	if (flush && !(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION)) {
+		KrkValue method = krk_valueGetAttribute(file, "flush");
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return NONE_VAL();
+		krk_push(method);
+		krk_callStack(0);
 	}
 })
 
@@ -601,6 +807,11 @@ KRK_FUNC(locals,{
 	KrkCodeObject * func = frame->closure->function;
 	size_t offset = frame->ip - func->chunk.code;
 
+	/* Strings being built in locals can't be appended to in place once they are in the dict. */
+	for (KrkValue * value = &krk_currentThread.stack[frame->slots]; value < krk_currentThread.stackTop; ++value) {
+		krk_escapeValue(*value);
+	}
+
 	/* First, we'll populate with arguments */
 	size_t slot = 0;
 	for (short int i = 0; i < func->requiredArgs; ++i) {
@@ -853,7 +1064,7 @@ KRK_METHOD(LicenseReader,__call__,{
 	return krk_runtimeError(vm.exceptions->typeError, "unexpected error");
 })
 
-#define IS_property(o) (krk_isInstanceOf(o,property))
+#define IS_property(o) (krk_isInstanceOf(o,vm.baseClasses->propertyClass))
 #define AS_property(o) (AS_INSTANCE(o))
 KRK_METHOD(property,__init__,{
 	METHOD_TAKES_AT_LEAST(1);
@@ -924,6 +1135,114 @@ KRK_METHOD(property,__set__,{
 	return krk_runtimeError(vm.exceptions->attributeError, "attribute can not be set");
 })
 
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct MemberDescriptor *
+
+static void _member_gcscan(KrkInstance * self) {
+	krk_markObject((KrkObj*)((struct MemberDescriptor*)self)->name);
+	krk_markObject((KrkObj*)((struct MemberDescriptor*)self)->owner);
+}
+
+KRK_METHOD(member,__get__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!krk_isInstanceOf(argv[1], self->owner) || !IS_INSTANCE(argv[1])) {
+		return krk_runtimeError(vm.exceptions->typeError, "descriptor '%s' for '%s' objects doesn't apply to a '%s' object",
+			self->name->chars, self->owner->name->chars, krk_typeName(argv[1]));
+	}
+	KrkValue value = *krk_slotValue(AS_INSTANCE(argv[1]), self->offset);
+	if (IS_KWARGS(value)) return krk_runtimeError(vm.exceptions->attributeError, "'%s' object has no attribute '%s'", krk_typeName(argv[1]), self->name->chars);
+	return value;
+})
+
+KRK_METHOD(member,__set__,{
+	METHOD_TAKES_EXACTLY(2);
+	if (!krk_isInstanceOf(argv[1], self->owner) || !IS_INSTANCE(argv[1])) {
+		return krk_runtimeError(vm.exceptions->typeError, "descriptor '%s' for '%s' objects doesn't apply to a '%s' object",
+			self->name->chars, self->owner->name->chars, krk_typeName(argv[1]));
+	}
+	*krk_slotValue(AS_INSTANCE(argv[1]), self->offset) = argv[2];
+	krk_gcWriteBarrier(AS_OBJECT(argv[1]));
+	return argv[2];
+})
+
+KRK_METHOD(member,__repr__,{
+	METHOD_TAKES_NONE();
+	struct StringBuilder sb = {0};
+	pushStringBuilderStr(&sb, "<member '", 9);
+	pushStringBuilderStr(&sb, self->name->chars, self->name->length);
+	pushStringBuilderStr(&sb, "' of '", 6);
+	pushStringBuilderStr(&sb, self->owner->name->chars, self->owner->name->length);
+	pushStringBuilderStr(&sb, "' objects>", 10);
+	return finishStringBuilder(&sb);
+})
+
+KRK_METHOD(member,__name__,{
+	ATTRIBUTE_NOT_ASSIGNABLE();
+	return OBJECT_VAL(self->name);
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE KrkInstance *
+
+_noexport
+int krk_applySlots(KrkClass * _class) {
+	KrkValue slots;
+	if (!krk_tableGet_fast(&_class->methods, S("__slots__"), &slots)) return 1;
+
+	size_t count;
+	KrkValue * names;
+	if (IS_STRING(slots)) {
+		count = 1;
+		names = &slots;
+	} else if (IS_TUPLE(slots)) {
+		count = AS_TUPLE(slots)->values.count;
+		names = AS_TUPLE(slots)->values.values;
+	} else if (IS_list(slots)) {
+		count = AS_LIST(slots)->count;
+		names = AS_LIST(slots)->values;
+	} else {
+		krk_runtimeError(vm.exceptions->typeError, "__slots__ must be a str, tuple, or list, not '%s'", krk_typeName(slots));
+		return 0;
+	}
+
+	/* Instances only go without fields if every class they inherit from has __slots__ as well. */
+	int hasFields = _class->base && _class->base != vm.baseClasses->objectClass && !(_class->base->obj.flags & KRK_OBJ_FLAGS_CLASS_NO_FIELDS);
+	size_t start = (_class->allocSize + sizeof(KrkValue) - 1) & ~(sizeof(KrkValue) - 1);
+	size_t offset = start;
+
+	for (size_t i = 0; i < count; ++i) {
+		if (!IS_STRING(names[i])) {
+			krk_runtimeError(vm.exceptions->typeError, "__slots__ items must be str, not '%s'", krk_typeName(names[i]));
+			return 0;
+		}
+		KrkString * name = AS_STRING(names[i]);
+		if (!strcmp(name->chars, "__dict__")) {
+			hasFields = 1;
+			continue;
+		}
+		if (!strcmp(name->chars, "__weakref__")) continue;
+		KrkValue existing;
+		if (krk_tableGet_fast(&_class->methods, name, &existing)) {
+			krk_runtimeError(vm.exceptions->valueError, "'%s' in __slots__ conflicts with class variable", name->chars);
+			return 0;
+		}
+		struct MemberDescriptor * member = (struct MemberDescriptor*)krk_newInstance(vm.baseClasses->memberClass);
+		krk_push(OBJECT_VAL(member));
+		member->name = name;
+		member->owner = _class;
+		member->offset = offset;
+		krk_tableSet(&_class->methods, OBJECT_VAL(name), OBJECT_VAL(member));
+		krk_pop();
+		offset += sizeof(KrkValue);
+	}
+
+	/* A base with __slots__ has already set where they start, and ours follow on from its. */
+	if (offset != start && !_class->slotsStart) _class->slotsStart = start;
+	_class->allocSize = offset;
+	if (!hasFields) _class->obj.flags |= KRK_OBJ_FLAGS_CLASS_NO_FIELDS;
+	return 1;
+}
+
 KRK_FUNC(id,{
 	FUNCTION_TAKES_EXACTLY(1);
 	if (!IS_OBJECT(argv[0])) return krk_runtimeError(vm.exceptions->typeError, "'%s' has no identity", krk_typeName(argv[0]));
@@ -1016,7 +1335,7 @@ void _createAndBind_builtins(void) {
 		"attaching new properties to the @c \\__builtins__ instance."
 	);
 
-	property = krk_makeClass(vm.builtins, &vm.baseClasses->propertyClass, "property", vm.baseClasses->objectClass);
+	KrkClass * property = krk_makeClass(vm.builtins, &vm.baseClasses->propertyClass, "property", vm.baseClasses->objectClass);
 	KRK_DOC(BIND_METHOD(property,__init__),
 		"@brief Create a property object.\n"
 		"@arguments fget,[fset]\n\n"
@@ -1049,6 +1368,22 @@ void _createAndBind_builtins(void) {
 		"different name will create a duplicate alias.");
 	krk_finalizeClass(property);
 
+	KrkClass * member = ADD_BASE_CLASS(vm.baseClasses->memberClass, "member_descriptor", vm.baseClasses->objectClass);
+	KRK_DOC(member,
+		"@brief Descriptor for a value named in a class's @c \\__slots__.\n\n"
+		"Instances of a class with @c \\__slots__ hold the named values themselves, after "
+		"the rest of the instance. If every class they inherit from has @c \\__slots__, "
+		"they have no other attributes.");
+	member->allocSize = sizeof(struct MemberDescriptor);
+	member->_ongcscan = _member_gcscan;
+	member->obj.flags |= KRK_OBJ_FLAGS_NO_INHERIT;
+	BIND_METHOD(member,__get__);
+	BIND_METHOD(member,__set__);
+	BIND_METHOD(member,__repr__);
+	krk_defineNative(&member->methods, "__str__", FUNC_NAME(member,__repr__));
+	BIND_PROP(member,__name__);
+	krk_finalizeClass(member);
+
 	krk_makeClass(vm.builtins, &Helper, "Helper", vm.baseClasses->objectClass);
 	KRK_DOC(Helper,
 		"@brief Special object that prints a helpeful message.\n\n"
@@ -1069,22 +1404,29 @@ void _createAndBind_builtins(void) {
 	krk_finalizeClass(LicenseReader);
 	krk_attachNamedObject(&vm.builtins->fields, "license", (KrkObj*)krk_newInstance(LicenseReader));
 
-	krk_makeClass(vm.builtins, &map, "map", vm.baseClasses->objectClass);
+	KrkClass * map = krk_makeClass(vm.builtins, &mapClass, "map", vm.baseClasses->objectClass);
 	KRK_DOC(map, "Return an iterator that applies a function to a series of iterables");
+	map->allocSize = sizeof(struct map);
+	map->_ongcscan = _map_gcscan;
+	map->_ongcsweep = _map_gcsweep;
 	BIND_METHOD(map,__init__);
 	BIND_METHOD(map,__iter__);
 	BIND_METHOD(map,__call__);
 	krk_finalizeClass(map);
 
-	krk_makeClass(vm.builtins, &filter, "filter", vm.baseClasses->objectClass);
+	KrkClass * filter = krk_makeClass(vm.builtins, &filterClass, "filter", vm.baseClasses->objectClass);
 	KRK_DOC(filter, "Return an iterator that returns only the items from an iterable for which the given function returns true.");
+	filter->allocSize = sizeof(struct filter);
+	filter->_ongcscan = _filter_gcscan;
 	BIND_METHOD(filter,__init__);
 	BIND_METHOD(filter,__iter__);
 	BIND_METHOD(filter,__call__);
 	krk_finalizeClass(filter);
 
-	krk_makeClass(vm.builtins, &enumerate, "enumerate", vm.baseClasses->objectClass);
+	KrkClass * enumerate = krk_makeClass(vm.builtins, &enumerateClass, "enumerate", vm.baseClasses->objectClass);
 	KRK_DOC(enumerate, "Return an iterator that produces a tuple with a count the iterated values of the passed iteratable.");
+	enumerate->allocSize = sizeof(struct enumerate);
+	enumerate->_ongcscan = _enumerate_gcscan;
 	BIND_METHOD(enumerate,__init__);
 	BIND_METHOD(enumerate,__iter__);
 	BIND_METHOD(enumerate,__call__);
@@ -1127,10 +1469,13 @@ void _createAndBind_builtins(void) {
 		"@c repr strings should convey all information needed to recreate the object, if this is possible.");
 	BUILTIN_FUNCTION("print", FUNC_NAME(krk,print),
 		"@brief Print text to the standard output.\n"
-		"@arguments *args,sep=' ',end='\\n'\n\n"
+		"@arguments *args,sep=' ',end='\\n',file=None,flush=False\n\n"
 		"Prints the string representation of each argument to the standard output. "
 		"The keyword argument @p sep specifies the string to print between values. "
-		"The keyword argument @p end specifies the string to print after all of the values have been printed.");
+		"The keyword argument @p end specifies the string to print after all of the values have been printed. "
+		"The keyword argument @p file specifies where to print to instead of @c kuroko.stdout; "
+		"it may be any object with a @c write method, which is called once with all of the text. "
+		"If @p flush is true, the file is flushed afterwards.");
 	BUILTIN_FUNCTION("ord", FUNC_NAME(krk,ord),
 		"@brief Obtain the ordinal integer value of a codepoint or byte.\n"
 		"@arguments char\n\n"
@@ -10,6 +10,10 @@ void krk_initChunk(KrkChunk * chunk) {
 	chunk->linesCount = 0;
 	chunk->linesCapacity = 0;
 	chunk->lines = NULL;
+
+	chunk->handlersCount = 0;
+	chunk->handlersCapacity = 0;
+	chunk->handlers = NULL;
 	chunk->filename = NULL;
 	krk_initValueArray(&chunk->constants);
 }
@@ -40,6 +44,7 @@ void krk_writeChunk(KrkChunk * chunk, uint8_t byte, size_t line) {
 void krk_freeChunk(KrkChunk * chunk) {
 	FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
 	FREE_ARRAY(KrkLineMap, chunk->lines, chunk->linesCapacity);
+	FREE_ARRAY(KrkHandlerRegion, chunk->handlers, chunk->handlersCapacity);
 	krk_freeValueArray(&chunk->constants);
 	krk_initChunk(chunk);
 }
@@ -78,3 +83,20 @@ size_t krk_lineNumber(KrkChunk * chunk, size_t offset) {
 	return line;
 }
 
+
+void krk_addHandlerRegion(KrkChunk * chunk, size_t startOffset, size_t endOffset) {
+	if (chunk->handlersCapacity < chunk->handlersCount + 1) {
+		int old = chunk->handlersCapacity;
+		chunk->handlersCapacity = GROW_CAPACITY(old);
+		chunk->handlers = GROW_ARRAY(KrkHandlerRegion, chunk->handlers, old, chunk->handlersCapacity);
+	}
+	chunk->handlers[chunk->handlersCount] = (KrkHandlerRegion){startOffset, endOffset};
+	chunk->handlersCount++;
+}
+
+int krk_inHandlerRegion(KrkChunk * chunk, size_t offset) {
+	for (size_t i = 0; i < chunk->handlersCount; ++i) {
+		if (offset >= chunk->handlers[i].startOffset && offset < chunk->handlers[i].endOffset) return 1;
+	}
+	return 0;
+}
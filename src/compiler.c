@@ -189,6 +189,24 @@ struct LoopExit {
 	KrkToken token; /**< Token for this exit statement, so its location can be printed in an error message. */
 };
 
+/**
+ * @brief Bytecode emitter backtracking breadcrumb.
+ *
+ * Records the state of the bytecode emitter so it may be rewound
+ * when an expression needs to be re-parsed. Allows us to implement
+ * backtracking to compile the inner expression of a comprehension,
+ * the left hand side of a ternary, or the targets list of a
+ * complex assignment.
+ *
+ * We rewind the bytecode, line mapping, and constants table,
+ * so that we don't keep around duplicate constants or debug info.
+ */
+typedef struct ChunkRecorder {
+	size_t count;      /**< Offset into the bytecode */
+	size_t lines;      /**< Offset into the line map */
+	size_t constants;  /**< Number of constants in the constants table */
+} ChunkRecorder;
+
 /**
  * @brief Subcompiler state.
  *
@@ -223,6 +241,12 @@ typedef struct Compiler {
 	int delSatisfied;                  /**< Flag indicating if a 'del' target has been completed. */
 
 	size_t optionsFlags;               /**< Special __options__ imports; similar to __future__ in Python */
+
+	const char * statementStart;       /**< First token of the last expression statement, whose value is discarded. */
+	const char * tupleStart;           /**< First token of the last tuple built by a comma expression. */
+	size_t tupleCount;                 /**< Number of elements in that tuple. */
+	size_t tupleEnd;                   /**< Bytecode offset just after its OP_TUPLE. */
+	ChunkRecorder beforeTuple;         /**< Emitter state just before its OP_TUPLE. */
 } Compiler;
 
 #define OPTIONS_FLAG_COMPILE_TIME_BUILTINS    (1 << 0)
@@ -240,24 +264,6 @@ typedef struct ClassCompiler {
 	int hasAnnotations;               /**< Flag indicating if an annotation dictionary has been attached to this class. */
 } ClassCompiler;
 
-/**
- * @brief Bytecode emitter backtracking breadcrumb.
- *
- * Records the state of the bytecode emitter so it may be rewound
- * when an expression needs to be re-parsed. Allows us to implement
- * backtracking to compile the inner expression of a comprehension,
- * the left hand side of a ternary, or the targets list of a
- * complex assignment.
- *
- * We rewind the bytecode, line mapping, and constants table,
- * so that we don't keep around duplicate constants or debug info.
- */
-typedef struct ChunkRecorder {
-	size_t count;      /**< Offset into the bytecode */
-	size_t lines;      /**< Offset into the line map */
-	size_t constants;  /**< Number of constants in the constants table */
-} ChunkRecorder;
-
 /**
  * @brief Compiler emit and parse state prior to this expression.
  *
@@ -269,9 +275,14 @@ typedef struct RewindState {
 	Parser        oldParser;  /**< Previous/current tokens. */
 } RewindState;
 
-static Parser parser;
-static Compiler * current = NULL;
-static ClassCompiler * currentClass = NULL;
+/*
+ * Compiler state is per-thread, so threads can compile independently. The
+ * innermost compiler is also published in the thread state, so a collection
+ * on another thread can see the code objects this one is building.
+ */
+static threadLocal Parser parser;
+static threadLocal Compiler * current = NULL;
+static threadLocal ClassCompiler * currentClass = NULL;
 
 #define currentChunk() (&current->codeobject->chunk)
 
@@ -287,7 +298,7 @@ static int isCoroutine(int type) {
 }
 
 static char * calculateQualName(void) {
-	static char space[1024]; /* We'll just truncate if we need to */
+	static threadLocal char space[1024]; /* We'll just truncate if we need to */
 	space[1023] = '\0';
 	char * writer = &space[1023];
 
@@ -328,6 +339,7 @@ static void rewindChunk(KrkChunk * out, ChunkRecorder from) {
 static void initCompiler(Compiler * compiler, FunctionType type) {
 	compiler->enclosing = current;
 	current = compiler;
+	krk_currentThread.compiler = current;
 	compiler->codeobject = NULL;
 	compiler->type = type;
 	compiler->scopeDepth = 0;
@@ -351,6 +363,9 @@ static void initCompiler(Compiler * compiler, FunctionType type) {
 	compiler->annotationCount = 0;
 	compiler->delSatisfied = 0;
 	compiler->optionsFlags = compiler->enclosing ? compiler->enclosing->optionsFlags : 0;
+	compiler->statementStart = NULL;
+	compiler->tupleStart = NULL;
+	compiler->tupleEnd = 0;
 
 	if (type != TYPE_MODULE) {
 		current->codeobject->name = krk_copyString(parser.previous.start, parser.previous.length);
@@ -387,7 +402,7 @@ static void declareVariable(void);
 static void string(int exprType);
 static KrkToken decorator(size_t level, FunctionType type);
 static void complexAssignment(ChunkRecorder before, KrkScanner oldScanner, Parser oldParser, size_t targetCount, int parenthesized);
-static void complexAssignmentTargets(KrkScanner oldScanner, Parser oldParser, size_t targetCount, int parenthesized);
+static void complexAssignmentTargets(KrkScanner oldScanner, Parser oldParser, size_t targetCount, int parenthesized, int onStack);
 static int invalidTarget(int exprType, const char * description);
 static void call(int exprType, RewindState *rewind);
 
@@ -571,13 +586,21 @@ static KrkCodeObject * endCompiler(void) {
 	current->codeobject->potentialPositionals = current->codeobject->requiredArgs + current->codeobject->keywordArgs;
 	current->codeobject->totalArguments = current->codeobject->potentialPositionals + !!(current->codeobject->obj.flags & KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_ARGS) + !!(current->codeobject->obj.flags & KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_KWS);
 
+	if ((vm.globalFlags & KRK_GLOBAL_OPTIMIZE) && !parser.hadError) {
+		krk_optimizeCodeObject(function);
+	}
+
 #ifndef KRK_NO_DISASSEMBLY
 	if ((krk_currentThread.flags & KRK_THREAD_ENABLE_DISASSEMBLY) && !parser.hadError) {
 		krk_disassembleCodeObject(stderr, function, function->name ? function->name->chars : "(module)");
 	}
 #endif
 
+	/* No longer remembered by krk_markCompilerRoots, but it may still be holding young objects. */
+	krk_gcWriteBarrier((KrkObj*)function);
+
 	current = current->enclosing;
+	krk_currentThread.compiler = current;
 	return function;
 }
 
@@ -1186,6 +1209,7 @@ static void declaration(void) {
 }
 
 static void expressionStatement(void) {
+	current->statementStart = parser.current.start;
 	parsePrecedence(PREC_ASSIGNMENT);
 	emitByte(OP_POP);
 }
@@ -1298,6 +1322,7 @@ static void doUpvalues(Compiler * compiler, KrkCodeObject * function) {
 static void typeHint(KrkToken name) {
 	current->enclosing->enclosed = current;
 	current = current->enclosing;
+	krk_currentThread.compiler = current;
 
 	current->enclosed->annotationCount++;
 
@@ -1307,6 +1332,7 @@ static void typeHint(KrkToken name) {
 
 	current = current->enclosed;
 	current->enclosing->enclosed = NULL;
+	krk_currentThread.compiler = current;
 }
 
 static void hideLocal(void) {
@@ -1830,6 +1856,7 @@ static void withStatement(void) {
 
 	/* Handler object */
 	anonymousLocal();
+	size_t withStart = currentChunk()->count;
 	int withJump = emitJump(OP_PUSH_WITH);
 
 	if (check(TOKEN_COMMA)) {
@@ -1848,6 +1875,8 @@ static void withStatement(void) {
 
 	/* Scope exit pops context manager */
 	endScope();
+
+	krk_addHandlerRegion(currentChunk(), withStart, currentChunk()->count);
 }
 
 static void ifStatement(void) {
@@ -2106,6 +2135,7 @@ static void tryStatement(void) {
 
 	/* Make sure we are in a local scope so this ends up on the stack */
 	beginScope();
+	size_t tryStart = currentChunk()->count;
 	int tryJump = emitJump(OP_PUSH_TRY);
 
 	size_t exceptionObject = anonymousLocal();
@@ -2217,6 +2247,8 @@ _anotherExcept:
 	}
 
 	endScope(); /* will pop the exception handler */
+
+	krk_addHandlerRegion(currentChunk(), tryStart, currentChunk()->count);
 }
 
 static void raiseStatement(void) {
@@ -2565,7 +2597,8 @@ static void string(int exprType) {
 	int isFormat = (parser.previous.type == TOKEN_PREFIX_F);
 	int isRaw = (parser.previous.type == TOKEN_PREFIX_R);
 
-	int atLeastOne = 0;
+	size_t pieces = 0; /* Values for OP_BUILD_STRING */
+	int hasFields = 0;
 	const char * lineBefore = krk_tellScanner().linePtr;
 	size_t lineNo = krk_tellScanner().line;
 
@@ -2666,11 +2699,11 @@ static void string(int exprType) {
 					c += 2;
 					continue;
 				}
-				if (!atLeastOne || stringLength) { /* Make sure there's a string for coersion reasons */
+				if (stringLength) {
 					emitConstant(OBJECT_VAL(krk_copyString(stringBytes,stringLength)));
-					if (atLeastOne) emitByte(OP_ADD);
-					atLeastOne = 1;
+					pieces++;
 				}
+				hasFields = 1;
 				const char * start = c+1;
 				stringLength = 0;
 				KrkScanner beforeExpression = krk_tellScanner();
@@ -2687,45 +2720,45 @@ static void string(int exprType) {
 				krk_rewindScanner(beforeExpression); /* To get us back to where we were with a string token */
 				parser = parserBefore;
 				c = inner.start;
-				KrkToken which = syntheticToken("str");
-				int hasEq = 0;
+				int formatFlags = 0;
 				while (*c == ' ') c++;
 				if (*c == '=') {
 					c++;
 					while (*c == ' ') c++;
 					emitConstant(OBJECT_VAL(krk_copyString(start,c-start)));
 					emitByte(OP_SWAP);
-					hasEq = 1;
+					pieces++;
 				}
 				if (*c == '!') {
 					c++;
 					/* Conversion specifiers, must only be one */
 					if (*c == 'r') {
-						which = syntheticToken("repr");
+						formatFlags |= KRK_FORMAT_REPR;
 					} else if (*c == 's') {
-						which = syntheticToken("str");
+						formatFlags |= KRK_FORMAT_STR;
 					} else {
 						error("Unsupported conversion flag '%c' for f-string expression.", *c);
 						goto _cleanupError;
 					}
 					c++;
 				}
-				size_t ind = identifierConstant(&which);
-				EMIT_OPERAND_OP(OP_GET_GLOBAL, ind);
-				emitByte(OP_SWAP);
-				emitBytes(OP_CALL, 1);
 				if (*c == ':') {
-					/* TODO format specs */
-					error("Format spec not supported in f-string (GH-10)");
-					goto _cleanupError;
+					/* The specifier is kept as a constant; its meaning depends on the value's type */
+					const char * specStart = ++c;
+					while (c < end && *c != '}' && *c != '{') c++;
+					if (*c == '{') {
+						error("Nested replacement fields in f-string format specifiers are not supported");
+						goto _cleanupError;
+					}
+					emitConstant(OBJECT_VAL(krk_copyString(specStart, c - specStart)));
+					formatFlags |= KRK_FORMAT_SPEC;
 				}
 				if (*c != '}') {
 					error("Expected closing '}' after expression in f-string");
 					goto _cleanupError;
 				}
-				if (hasEq) emitByte(OP_ADD);
-				if (atLeastOne) emitByte(OP_ADD);
-				atLeastOne = 1;
+				if (formatFlags) EMIT_OPERAND_OP(OP_FORMAT_VALUE, formatFlags);
+				pieces++;
 				c++;
 			} else {
 				if (*(unsigned char*)c > 127 && isBytes) {
@@ -2749,9 +2782,14 @@ static void string(int exprType) {
 		emitConstant(OBJECT_VAL(bytes));
 		return;
 	}
-	if (!isFormat || stringLength || !atLeastOne) {
+	if (!hasFields) {
 		emitConstant(OBJECT_VAL(krk_copyString(stringBytes,stringLength)));
-		if (atLeastOne) emitByte(OP_ADD);
+	} else {
+		if (stringLength) {
+			emitConstant(OBJECT_VAL(krk_copyString(stringBytes,stringLength)));
+			pieces++;
+		}
+		EMIT_OPERAND_OP(OP_BUILD_STRING, pieces);
 	}
 	FREE_ARRAY(char,stringBytes,stringCapacity);
 #undef PUSH_CHAR
@@ -2805,7 +2843,11 @@ static ssize_t resolveUpvalue(Compiler * compiler, KrkToken * name) {
 		parsePrecedence(PREC_ASSIGNMENT); \
 		EMIT_OPERAND_OP(opset, arg); \
 	} else if (exprType == EXPR_CAN_ASSIGN && matchAssignment()) { \
-		EMIT_OPERAND_OP(opget, arg); \
+		if (opget == OP_GET_LOCAL && parser.previous.type == TOKEN_PLUS_EQUAL) { \
+			EMIT_OPERAND_OP(OP_GET_LOCAL_INPLACE, arg); \
+		} else { \
+			EMIT_OPERAND_OP(opget, arg); \
+		} \
 		assignmentValue(); \
 		EMIT_OPERAND_OP(opset, arg); \
 	} else if (exprType == EXPR_DEL_TARGET && checkEndOfDel()) {\
@@ -3100,7 +3142,7 @@ static void parens(int exprType) {
 			error("Can not assign to generator expression.");
 		} else {
 			rewindChunk(currentChunk(), before);
-			complexAssignmentTargets(scannerBefore, parserBefore, argCount, 2);
+			complexAssignmentTargets(scannerBefore, parserBefore, argCount, 2, 0);
 			if (!matchComplexEnd()) {
 				errorAtCurrent("Unexpected end of nested target list");
 			}
@@ -3271,12 +3313,28 @@ static void ternary(int exprType, RewindState *rewind) {
 	parser = outParser;
 }
 
-static void complexAssignmentTargets(KrkScanner oldScanner, Parser oldParser, size_t targetCount, int parenthesized) {
-	emitBytes(OP_DUP, 0);
+/**
+ * @brief Assign to a list of targets.
+ *
+ * Normally the value is a sequence on the stack, which is left there as the value
+ * of the assignment expression while its elements are unpacked into the targets.
+ * If @p onStack is set, the compiler already left the elements themselves on the
+ * stack instead, and the last one stands in for the value of the expression.
+ */
+static void complexAssignmentTargets(KrkScanner oldScanner, Parser oldParser, size_t targetCount, int parenthesized, int onStack) {
+	if (onStack) {
+		if (targetCount == 2) {
+			emitByte(OP_SWAP);
+		} else {
+			EMIT_OPERAND_OP(OP_REVERSE,targetCount);
+		}
+	} else {
+		emitBytes(OP_DUP, 0);
 
-	if (targetCount > 0) {
-		EMIT_OPERAND_OP(OP_UNPACK,targetCount);
-		EMIT_OPERAND_OP(OP_REVERSE,targetCount);
+		if (targetCount > 0) {
+			EMIT_OPERAND_OP(OP_UNPACK,targetCount);
+			EMIT_OPERAND_OP(OP_REVERSE,targetCount);
+		}
 	}
 
 	/* Rewind */
@@ -3288,7 +3346,7 @@ static void complexAssignmentTargets(KrkScanner oldScanner, Parser oldParser, si
 	do {
 		checkTargetCount++;
 		parsePrecedence(PREC_MUST_ASSIGN);
-		emitByte(OP_POP);
+		if (!onStack || checkTargetCount < targetCount) emitByte(OP_POP);
 
 		if (checkTargetCount == targetCount && parser.previous.type == TOKEN_COMMA) {
 			if (!match(parenthesized ? TOKEN_RIGHT_PAREN : TOKEN_EQUAL)) {
@@ -3323,13 +3381,26 @@ _errorAtCurrent:
 static void complexAssignment(ChunkRecorder before, KrkScanner oldScanner, Parser oldParser, size_t targetCount, int parenthesized) {
 
 	rewindChunk(currentChunk(), before);
+	const char * valueStart = parser.current.start;
 	parsePrecedence(PREC_ASSIGNMENT);
 
+	/*
+	 * A statement like 'a, b = b, a' doesn't need the tuple on the right: if its
+	 * value is discarded and the right side is a comma expression of as many
+	 * elements, drop the OP_TUPLE and assign the elements straight from the stack.
+	 * At module level the value of the last statement is kept for the REPL.
+	 */
+	int onStack = !parenthesized && current->type != TYPE_MODULE &&
+		oldParser.current.start == current->statementStart &&
+		current->tupleStart == valueStart && current->tupleCount == targetCount &&
+		current->tupleEnd == currentChunk()->count;
+	if (onStack) rewindChunk(currentChunk(), current->beforeTuple);
+
 	/* Store end state */
 	KrkScanner outScanner = krk_tellScanner();
 	Parser outParser = parser;
 
-	complexAssignmentTargets(oldScanner,oldParser,targetCount,parenthesized);
+	complexAssignmentTargets(oldScanner,oldParser,targetCount,parenthesized,onStack);
 
 	/* Restore end state */
 	krk_rewindScanner(outScanner);
@@ -3344,7 +3415,11 @@ static void comma(int exprType, RewindState *rewind) {
 		parsePrecedence(PREC_TERNARY);
 	} while (match(TOKEN_COMMA));
 
+	current->beforeTuple = recordChunk(currentChunk());
 	EMIT_OPERAND_OP(OP_TUPLE,expressionCount);
+	current->tupleStart = rewind->oldParser.current.start;
+	current->tupleCount = expressionCount;
+	current->tupleEnd = currentChunk()->count;
 
 	if (exprType == EXPR_CAN_ASSIGN && match(TOKEN_EQUAL)) {
 		complexAssignment(rewind->before, rewind->oldScanner, rewind->oldParser, expressionCount, 0);
@@ -3516,10 +3591,6 @@ static void parsePrecedence(Precedence precedence) {
 }
 
 
-#ifdef ENABLE_THREADING
-static volatile int _compilerLock = 0;
-#endif
-
 /**
  * @brief Compile a source string to bytecode.
  *
@@ -3534,9 +3605,6 @@ static volatile int _compilerLock = 0;
  * @exception SyntaxError if @p src could not be compiled.
  */
 KrkCodeObject * krk_compile(const char * src, char * fileName) {
-	/* Allow only one compiler across threads at a time. */
-	_obtain_lock(_compilerLock);
-
 	/* Point a new scanner at the source. */
 	krk_initScanner(src);
 
@@ -3562,8 +3630,9 @@ KrkCodeObject * krk_compile(const char * src, char * fileName) {
 		if (!krk_tableGet(&krk_currentThread.module->fields, OBJECT_VAL(krk_copyString("__doc__", 7)), &doc)) {
 			if (match(TOKEN_STRING) || match(TOKEN_BIG_STRING)) {
 				string(EXPR_NORMAL);
-				krk_attachNamedObject(&krk_currentThread.module->fields, "__doc__",
-					(KrkObj*)AS_STRING(currentChunk()->constants.values[currentChunk()->constants.count-1]));
+				/* Also kept on the code object, so bytecode caches can restore it */
+				compiler.codeobject->docstring = AS_STRING(currentChunk()->constants.values[currentChunk()->constants.count-1]);
+				krk_attachNamedObject(&krk_currentThread.module->fields, "__doc__", (KrkObj*)compiler.codeobject->docstring);
 				emitByte(OP_POP); /* string() actually put an instruction for that, pop its result */
 				consume(TOKEN_EOL,"Garbage after docstring");
 			} else {
@@ -3592,7 +3661,6 @@ KrkCodeObject * krk_compile(const char * src, char * fileName) {
 	 */
 	if (parser.hadError) function = NULL;
 
-	_release_lock(_compilerLock);
 	return function;
 }
 
@@ -3600,14 +3668,18 @@ KrkCodeObject * krk_compile(const char * src, char * fileName) {
  * @brief GC scan for compiler-owned references.
  *
  * Called by the garbage collector during the scan phase
- * to mark references held by the compiler.
+ * to mark references held by the compilers of every thread.
  */
 void krk_markCompilerRoots(void) {
-	Compiler * compiler = current;
-	while (compiler != NULL) {
-		if (compiler->enclosed && compiler->enclosed->codeobject) krk_markObject((KrkObj*)compiler->enclosed->codeobject);
-		krk_markObject((KrkObj*)compiler->codeobject);
-		compiler = compiler->enclosing;
+	for (KrkThreadState * thread = vm.threads; thread; thread = thread->next) {
+		Compiler * compiler = thread->compiler;
+		while (compiler != NULL) {
+			if (compiler->enclosed && compiler->enclosed->codeobject) krk_markObject((KrkObj*)compiler->enclosed->codeobject);
+			krk_markObject((KrkObj*)compiler->codeobject);
+			/* Code objects are written to without barriers while they are being compiled. */
+			if (compiler->codeobject) krk_gcWriteBarrier((KrkObj*)compiler->codeobject);
+			compiler = compiler->enclosing;
+		}
 	}
 }
 
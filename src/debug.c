@@ -5,6 +5,9 @@
 #include <kuroko/vm.h>
 #include <kuroko/util.h>
 #include <kuroko/compiler.h>
+#include <kuroko/marshal.h>
+
+#include "private.h"
 
 #ifndef KRK_DISABLE_DEBUG
 
@@ -63,6 +66,7 @@ void krk_debug_dumpStack(FILE * file, KrkCallFrame * frame) {
 
 void krk_disassembleCodeObject(FILE * f, KrkCodeObject * func, const char * name) {
 	KrkChunk * chunk = &func->chunk;
+	if (!krk_materializeCodeObject(func)) return;
 	/* Function header */
 	fprintf(f, "<%s(", name);
 	for (int i = 0; i < func->requiredArgs; ++i) {
@@ -301,6 +305,7 @@ int krk_debug_addBreakpointFileLine(KrkString * filename, size_t line, int flags
 
 	/* Examine all code objects to find one that matches the requested
 	 * filename and line number... */
+	krk_gcGatherObjects();
 	KrkObj * object = vm.objects;
 	while (object) {
 		if (object->type == KRK_OBJ_CODEOBJECT) {
@@ -626,7 +631,8 @@ KRK_FUNC(build,{
 #define CONSTANT(opc,more) case opc: { constant = chunk->code[offset + 1]; size = 2; more; break; } \
 	case opc ## _LONG: { constant = (chunk->code[offset + 1] << 16) | \
 	(chunk->code[offset + 2] << 8) | (chunk->code[offset + 3]); size = 4; more; break; }
-#define OPERAND(opc,more) case opc: { operand = chunk->code[offset + 1]; size = 2; more; break; } \
+#define OPERANDB(opc,more) case opc: { operand = chunk->code[offset + 1]; size = 2; more; break; }
+#define OPERAND(opc,more) OPERANDB(opc,more) \
 	case opc ## _LONG: { operand = (chunk->code[offset + 1] << 16) | \
 	(chunk->code[offset + 2] << 8) | (chunk->code[offset + 3]); size = 4; more; break; }
 #define JUMP(opc,sign) case opc: { jump = 0 sign ((chunk->code[offset + 1] << 8) | (chunk->code[offset + 2])); \
@@ -645,6 +651,7 @@ KRK_FUNC(build,{
 #define EXPAND_ARGS_MORE
 #define LOCAL_MORE local = operand;
 static KrkValue _examineInternal(KrkCodeObject* func) {
+	if (!krk_materializeCodeObject(func)) return NONE_VAL();
 	KrkValue output = krk_list_of(0,NULL,0);
 	krk_push(output);
 
@@ -785,6 +792,7 @@ void _createAndBind_disMod(void) {
 #define OPCODE(opc) krk_attachNamedValue(&module->fields, #opc, INTEGER_VAL(opc));
 #define SIMPLE(opc) OPCODE(opc)
 #define CONSTANT(opc,more) OPCODE(opc) OPCODE(opc ## _LONG)
+#define OPERANDB(opc,more) OPCODE(opc)
 #define OPERAND(opc,more) OPCODE(opc) OPCODE(opc ## _LONG)
 #define JUMP(opc,sign) OPCODE(opc)
 #define CLOSURE_MORE
@@ -0,0 +1,615 @@
+/**
+ * @file deque.c
+ * @brief Double-ended queue.
+ *
+ * A deque keeps its values in a ring: a buffer whose size is a power of two,
+ * with the first value at @c head and the rest following it, wrapping
+ * around at the end. Values are added and removed at either end without
+ * moving any others, and the buffer only grows when it is full.
+ */
+#include <string.h>
+#include <kuroko/vm.h>
+#include <kuroko/object.h>
+#include <kuroko/memory.h>
+#include <kuroko/util.h>
+
+#include "private.h"
+
+static KrkVMLocal dequeKey;
+#define dequeClass KRK_VM_LOCAL(KrkClass*,dequeKey)
+static KrkVMLocal dequeiteratorKey;
+#define dequeiterator KRK_VM_LOCAL(KrkClass*,dequeiteratorKey)
+
+/**
+ * @brief Double-ended queue of values.
+ * @extends KrkInstance
+ */
+struct Deque {
+	KrkInstance inst;
+	KrkValue * values;         /**< The ring; @c capacity values */
+	size_t capacity;           /**< Zero, or a power of two */
+	size_t head;               /**< Where the first value is */
+	size_t count;              /**< Values in the deque */
+	size_t maxlen;             /**< Most values the deque holds, if it is bounded */
+	size_t state;              /**< Bumped whenever values are added or removed, so iterators can notice */
+	unsigned int bounded:1;
+};
+
+#define IS_deque(o) krk_isInstanceOf(o,dequeClass)
+#define AS_deque(o) ((struct Deque*)AS_OBJECT(o))
+
+/** The @p i th value from the front. */
+#define AT(self,i) ((self)->values[((self)->head + (i)) & ((self)->capacity - 1)])
+
+static void dequeFree(struct Deque * self) {
+	if (self->capacity) FREE_ARRAY(KrkValue, self->values, self->capacity);
+	self->values = NULL;
+	self->capacity = 0;
+	self->head = 0;
+	self->count = 0;
+	self->state++;
+}
+
+static void _deque_gcscan(KrkInstance * self) {
+	struct Deque * me = (struct Deque*)self;
+	for (size_t i = 0; i < me->count; ++i) {
+		krk_markValue(AT(me,i));
+	}
+}
+
+static void _deque_gcsweep(KrkInstance * self) {
+	dequeFree((struct Deque*)self);
+}
+
+/**
+ * Make room for @p count values. The ring is unwound into the new buffer,
+ * so the values start at the front again.
+ */
+static void dequeReserve(struct Deque * self, size_t count) {
+	if (count <= self->capacity) return;
+	size_t capacity = self->capacity < 8 ? 8 : self->capacity;
+	while (capacity < count) capacity *= 2;
+	KrkValue * values = ALLOCATE(KrkValue, capacity);
+	for (size_t i = 0; i < self->count; ++i) {
+		values[i] = AT(self,i);
+	}
+	if (self->capacity) FREE_ARRAY(KrkValue, self->values, self->capacity);
+	self->values = values;
+	self->capacity = capacity;
+	self->head = 0;
+}
+
+static void dequeStore(struct Deque * self, size_t i, KrkValue value) {
+	AT(self,i) = value;
+	if (IS_OBJECT(value)) krk_gcWriteBarrier((KrkObj*)self);
+}
+
+static KrkValue dequePopLeft(struct Deque * self) {
+	KrkValue value = AT(self,0);
+	AT(self,0) = NONE_VAL();
+	self->head = (self->head + 1) & (self->capacity - 1);
+	self->count--;
+	self->state++;
+	return value;
+}
+
+static KrkValue dequePop(struct Deque * self) {
+	KrkValue value = AT(self,self->count-1);
+	AT(self,self->count-1) = NONE_VAL();
+	self->count--;
+	self->state++;
+	return value;
+}
+
+/** Add @p value at the back, pushing the front value out if the deque is full. */
+static void dequeAppend(struct Deque * self, KrkValue value) {
+	if (self->bounded && self->count == self->maxlen) {
+		if (!self->maxlen) return;
+		dequePopLeft(self);
+	}
+	dequeReserve(self, self->count + 1);
+	self->count++;
+	self->state++;
+	dequeStore(self, self->count - 1, value);
+}
+
+/** Add @p value at the front, pushing the back value out if the deque is full. */
+static void dequeAppendLeft(struct Deque * self, KrkValue value) {
+	if (self->bounded && self->count == self->maxlen) {
+		if (!self->maxlen) return;
+		dequePop(self);
+	}
+	dequeReserve(self, self->count + 1);
+	self->head = (self->head - 1) & (self->capacity - 1);
+	self->count++;
+	self->state++;
+	dequeStore(self, 0, value);
+}
+
+/**
+ * Take out the value at @p index, closing the gap from whichever end is
+ * nearer.
+ */
+static KrkValue dequeDelete(struct Deque * self, size_t index) {
+	KrkValue value = AT(self,index);
+	if (index < self->count / 2) {
+		for (size_t i = index; i > 0; --i) AT(self,i) = AT(self,i-1);
+		dequePopLeft(self);
+	} else {
+		for (size_t i = index; i + 1 < self->count; ++i) AT(self,i) = AT(self,i+1);
+		dequePop(self);
+	}
+	return value;
+}
+
+/** Put @p value before the value at @p index, opening the gap from whichever end is nearer. */
+static void dequeInsert(struct Deque * self, size_t index, KrkValue value) {
+	dequeReserve(self, self->count + 1);
+	if (index < self->count / 2) {
+		self->head = (self->head - 1) & (self->capacity - 1);
+		self->count++;
+		for (size_t i = 0; i < index; ++i) AT(self,i) = AT(self,i+1);
+	} else {
+		self->count++;
+		for (size_t i = self->count - 1; i > index; --i) AT(self,i) = AT(self,i-1);
+	}
+	self->state++;
+	dequeStore(self, index, value);
+}
+
+/**
+ * Find @p value at or after @p start and before @p stop. Comparisons can
+ * run managed code, so this fails if that code changes the deque.
+ * Returns -1 if the value is not found, and -2 on an exception.
+ */
+static ssize_t dequeFind(struct Deque * self, KrkValue value, size_t start, size_t stop) {
+	size_t state = self->state;
+	for (size_t i = start; i < stop && i < self->count; ++i) {
+		KrkValue other = AT(self,i);
+		if (krk_valuesSame(other, value)) return i;
+		int equal = krk_valuesEqual(other, value);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return -2;
+		if (state != self->state) {
+			krk_runtimeError(vm.exceptions->valueError, "deque mutated during iteration");
+			return -2;
+		}
+		if (equal) return i;
+	}
+	return -1;
+}
+
+#define CURRENT_CTYPE struct Deque *
+#define CURRENT_NAME  self
+
+#define DEQUE_WRAP_INDEX() \
+	if (index < 0) index += self->count; \
+	if (index < 0 || index >= (krk_integer_type)self->count) return krk_runtimeError(vm.exceptions->indexError, "deque index out of range")
+
+#define unpackArray(counter, indexer) do { \
+	if (!self->bounded) dequeReserve(self, self->count + counter); \
+	for (size_t i = 0; i < counter; ++i) { \
+		dequeAppend(self, indexer); \
+	} \
+} while (0)
+
+/**
+ * Push a list of the values in the deque, for extending it with itself
+ * without chasing the values being added.
+ */
+static KrkValue pushSnapshot(struct Deque * self) {
+	KrkValue snapshot = krk_list_of(0,NULL,0);
+	krk_push(snapshot);
+	for (size_t i = 0; i < self->count; ++i) {
+		krk_writeValueArray(AS_LIST(snapshot), AT(self,i));
+	}
+	return snapshot;
+}
+
+/** Add the values of @p iterable at the back. */
+static KrkValue dequeExtend(struct Deque * self, KrkValue iterable) {
+	if (IS_OBJECT(iterable) && AS_OBJECT(iterable) == (KrkObj*)self) {
+		unpackIterableFast(pushSnapshot(self));
+		krk_pop();
+		return NONE_VAL();
+	}
+	unpackIterableFast(iterable);
+	return NONE_VAL();
+}
+
+#undef unpackArray
+#define unpackArray(counter, indexer) do { \
+	for (size_t i = 0; i < counter; ++i) { \
+		dequeAppendLeft(self, indexer); \
+	} \
+} while (0)
+
+/** Add the values of @p iterable at the front, one at a time, so they end up reversed. */
+static KrkValue dequeExtendLeft(struct Deque * self, KrkValue iterable) {
+	if (IS_OBJECT(iterable) && AS_OBJECT(iterable) == (KrkObj*)self) {
+		unpackIterableFast(pushSnapshot(self));
+		krk_pop();
+		return NONE_VAL();
+	}
+	unpackIterableFast(iterable);
+	return NONE_VAL();
+}
+
+#undef unpackArray
+
+KRK_METHOD(deque,__init__,{
+	KRK_ARGS(args, ".|OO", "iterable", "maxlen");
+	KrkValue iterable = NONE_VAL();
+	KrkValue maxlen = NONE_VAL();
+	if (!krk_parseArgs(args, &iterable, &maxlen)) return NONE_VAL();
+	if (!IS_NONE(maxlen) && !IS_INTEGER(maxlen)) return TYPE_ERROR(int or None,maxlen);
+	if (IS_INTEGER(maxlen) && AS_INTEGER(maxlen) < 0) return krk_runtimeError(vm.exceptions->valueError, "maxlen must be non-negative");
+	dequeFree(self);
+	self->bounded = !IS_NONE(maxlen);
+	self->maxlen = self->bounded ? AS_INTEGER(maxlen) : 0;
+	if (!IS_NONE(iterable)) {
+		dequeExtend(self, iterable);
+	}
+	return argv[0];
+})
+
+KRK_METHOD(deque,__len__,{
+	METHOD_TAKES_NONE();
+	return INTEGER_VAL(self->count);
+})
+
+KRK_METHOD(deque,maxlen,{
+	METHOD_TAKES_NONE();
+	return self->bounded ? INTEGER_VAL(self->maxlen) : NONE_VAL();
+})
+
+KRK_METHOD(deque,append,{
+	METHOD_TAKES_EXACTLY(1);
+	dequeAppend(self, argv[1]);
+})
+
+KRK_METHOD(deque,appendleft,{
+	METHOD_TAKES_EXACTLY(1);
+	dequeAppendLeft(self, argv[1]);
+})
+
+KRK_METHOD(deque,pop,{
+	METHOD_TAKES_NONE();
+	if (!self->count) return krk_runtimeError(vm.exceptions->indexError, "pop from an empty deque");
+	return dequePop(self);
+})
+
+KRK_METHOD(deque,popleft,{
+	METHOD_TAKES_NONE();
+	if (!self->count) return krk_runtimeError(vm.exceptions->indexError, "pop from an empty deque");
+	return dequePopLeft(self);
+})
+
+KRK_METHOD(deque,extend,{
+	METHOD_TAKES_EXACTLY(1);
+	return dequeExtend(self, argv[1]);
+})
+
+KRK_METHOD(deque,extendleft,{
+	METHOD_TAKES_EXACTLY(1);
+	return dequeExtendLeft(self, argv[1]);
+})
+
+KRK_METHOD(deque,clear,{
+	METHOD_TAKES_NONE();
+	dequeFree(self);
+})
+
+KRK_METHOD(deque,copy,{
+	METHOD_TAKES_NONE();
+	KrkInstance * out = krk_newInstance(krk_getType(argv[0]));
+	krk_push(OBJECT_VAL(out));
+	struct Deque * them = (struct Deque*)out;
+	them->bounded = self->bounded;
+	them->maxlen = self->maxlen;
+	dequeReserve(them, self->count);
+	for (size_t i = 0; i < self->count; ++i) {
+		them->values[i] = AT(self,i);
+	}
+	them->count = self->count;
+	return krk_pop();
+})
+
+KRK_METHOD(deque,rotate,{
+	METHOD_TAKES_AT_MOST(1);
+	krk_integer_type n = 1;
+	if (argc > 1) {
+		CHECK_ARG(1,int,krk_integer_type,_n);
+		n = _n;
+	}
+	if (self->count < 2) return NONE_VAL();
+	n %= (krk_integer_type)self->count;
+	if (n < 0) n += self->count;
+	if (!n) return NONE_VAL();
+	if (self->count == self->capacity) {
+		/* When the ring is full, rotating it is just moving where it starts. */
+		self->head = (self->head - n) & (self->capacity - 1);
+	} else if ((size_t)n <= self->count / 2) {
+		/* Move the last n values to the front... */
+		for (krk_integer_type i = 0; i < n; ++i) {
+			KrkValue value = AT(self,self->count-1);
+			AT(self,self->count-1) = NONE_VAL();
+			self->head = (self->head - 1) & (self->capacity - 1);
+			AT(self,0) = value;
+		}
+	} else {
+		/* ...or the first count-n values to the back, whichever is fewer. */
+		for (size_t i = n; i < self->count; ++i) {
+			KrkValue value = AT(self,0);
+			AT(self,0) = NONE_VAL();
+			self->head = (self->head + 1) & (self->capacity - 1);
+			AT(self,self->count-1) = value;
+		}
+	}
+	self->state++;
+})
+
+KRK_METHOD(deque,reverse,{
+	METHOD_TAKES_NONE();
+	for (size_t i = 0, j = self->count; i + 1 < j; ++i, --j) {
+		KrkValue tmp = AT(self,i);
+		AT(self,i) = AT(self,j-1);
+		AT(self,j-1) = tmp;
+	}
+	self->state++;
+})
+
+KRK_METHOD(deque,count,{
+	METHOD_TAKES_EXACTLY(1);
+	krk_integer_type count = 0;
+	ssize_t found = -1;
+	while ((found = dequeFind(self, argv[1], found + 1, self->count)) >= 0) count++;
+	if (found == -2) return NONE_VAL();
+	return INTEGER_VAL(count);
+})
+
+KRK_METHOD(deque,index,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(3);
+	krk_integer_type start = 0;
+	krk_integer_type stop = self->count;
+	if (argc > 2) {
+		CHECK_ARG(2,int,krk_integer_type,_start);
+		start = _start < 0 ? _start + (krk_integer_type)self->count : _start;
+		if (start < 0) start = 0;
+	}
+	if (argc > 3) {
+		CHECK_ARG(3,int,krk_integer_type,_stop);
+		stop = _stop < 0 ? _stop + (krk_integer_type)self->count : _stop;
+		if (stop < 0) stop = 0;
+	}
+	ssize_t found = dequeFind(self, argv[1], start, stop);
+	if (found == -2) return NONE_VAL();
+	if (found == -1) return krk_runtimeError(vm.exceptions->valueError, "value not in deque");
+	return INTEGER_VAL(found);
+})
+
+KRK_METHOD(deque,insert,{
+	METHOD_TAKES_EXACTLY(2);
+	CHECK_ARG(1,int,krk_integer_type,index);
+	if (self->bounded && self->count == self->maxlen) return krk_runtimeError(vm.exceptions->indexError, "deque already at its maximum size");
+	/* Like list.insert, out of range indexes go to the nearer end. */
+	if (index < 0) index += self->count;
+	if (index < 0) index = 0;
+	if (index > (krk_integer_type)self->count) index = self->count;
+	dequeInsert(self, index, argv[2]);
+})
+
+KRK_METHOD(deque,remove,{
+	METHOD_TAKES_EXACTLY(1);
+	ssize_t found = dequeFind(self, argv[1], 0, self->count);
+	if (found == -2) return NONE_VAL();
+	if (found == -1) return krk_runtimeError(vm.exceptions->valueError, "value not in deque");
+	dequeDelete(self, found);
+})
+
+KRK_METHOD(deque,__contains__,{
+	METHOD_TAKES_EXACTLY(1);
+	ssize_t found = dequeFind(self, argv[1], 0, self->count);
+	if (found == -2) return NONE_VAL();
+	return BOOLEAN_VAL(found >= 0);
+})
+
+KRK_METHOD(deque,__getitem__,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,int,krk_integer_type,index);
+	DEQUE_WRAP_INDEX();
+	return AT(self,index);
+})
+
+KRK_METHOD(deque,__setitem__,{
+	METHOD_TAKES_EXACTLY(2);
+	CHECK_ARG(1,int,krk_integer_type,index);
+	DEQUE_WRAP_INDEX();
+	dequeStore(self, index, argv[2]);
+	return argv[2];
+})
+
+KRK_METHOD(deque,__delitem__,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,int,krk_integer_type,index);
+	DEQUE_WRAP_INDEX();
+	dequeDelete(self, index);
+})
+
+KRK_METHOD(deque,__eq__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_deque(argv[1])) return NOTIMPL_VAL();
+	struct Deque * them = AS_deque(argv[1]);
+	if (self->count != them->count) return BOOLEAN_VAL(0);
+	/* Comparisons can run managed code, which might change either deque. */
+	for (size_t i = 0; i < self->count && i < them->count; ++i) {
+		if (!krk_valuesEqual(AT(self,i), AT(them,i))) return BOOLEAN_VAL(0);
+	}
+	return BOOLEAN_VAL(self->count == them->count);
+})
+
+KRK_METHOD(deque,__repr__,{
+	METHOD_TAKES_NONE();
+	if (((KrkObj*)self)->flags & KRK_OBJ_FLAGS_IN_REPR) return OBJECT_VAL(S("[...]"));
+	((KrkObj*)self)->flags |= KRK_OBJ_FLAGS_IN_REPR;
+	struct StringBuilder sb = {0};
+	pushStringBuilderStr(&sb, "deque([", 7);
+	for (size_t i = 0; i < self->count; ++i) {
+		if (i > 0) {
+			pushStringBuilderStr(&sb, ", ", 2);
+		}
+		KrkClass * type = krk_getType(AT(self,i));
+		krk_push(AT(self,i));
+		KrkValue result = krk_callDirect(type->_reprer, 1);
+		if (IS_STRING(result)) {
+			pushStringBuilderStr(&sb, AS_STRING(result)->chars, AS_STRING(result)->length);
+		}
+	}
+	pushStringBuilder(&sb, ']');
+	if (self->bounded) {
+		char tmp[50];
+		size_t len = snprintf(tmp, sizeof(tmp), ", maxlen=%zu", self->maxlen);
+		pushStringBuilderStr(&sb, tmp, len);
+	}
+	pushStringBuilder(&sb, ')');
+	((KrkObj*)self)->flags &= ~(KRK_OBJ_FLAGS_IN_REPR);
+	return finishStringBuilder(&sb);
+})
+
+FUNC_SIG(dequeiterator,__init__);
+
+KRK_METHOD(deque,__iter__,{
+	METHOD_TAKES_NONE();
+	KrkInstance * output = krk_newInstance(dequeiterator);
+	krk_push(OBJECT_VAL(output));
+	FUNC_NAME(dequeiterator,__init__)(2,(KrkValue[]){krk_peek(0), argv[0]}, 0);
+	return krk_pop();
+})
+
+#undef CURRENT_CTYPE
+
+/**
+ * @brief Iterator over the values in a deque.
+ * @extends KrkInstance
+ */
+struct DequeIterator {
+	KrkInstance inst;
+	KrkValue deque;
+	size_t i;
+	size_t state;   /**< The deque's state when iteration started */
+};
+#define IS_dequeiterator(o) krk_isInstanceOf(o,dequeiterator)
+#define AS_dequeiterator(o) ((struct DequeIterator*)AS_OBJECT(o))
+
+#define CURRENT_CTYPE struct DequeIterator *
+
+static void _dequeiterator_gcscan(KrkInstance * self) {
+	krk_markValue(((struct DequeIterator*)self)->deque);
+}
+
+KRK_METHOD(dequeiterator,__init__,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,deque,struct Deque*,source);
+	self->deque = argv[1];
+	self->i = 0;
+	self->state = source->state;
+	krk_gcWriteBarrier((KrkObj*)self);
+	return argv[0];
+})
+
+KRK_METHOD(dequeiterator,__call__,{
+	METHOD_TAKES_NONE();
+	struct Deque * source = AS_deque(self->deque);
+	if (source->state != self->state) return krk_runtimeError(vm.exceptions->valueError, "deque mutated during iteration");
+	if (self->i >= source->count) return argv[0];
+	return AT(source, self->i++);
+})
+
+#undef CURRENT_CTYPE
+
+_noexport
+size_t krk_dequeBytes(KrkValue value) {
+	if (!IS_deque(value)) return 0;
+	return sizeof(KrkValue) * AS_deque(value)->capacity;
+}
+
+_noexport
+void _createAndBind_collectionsMod(void) {
+	/**
+	 * _collections = module()
+	 *
+	 * Native collection types, used by the collections module.
+	 */
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	krk_attachNamedObject(&vm.modules, "_collections", (KrkObj*)module);
+	krk_attachNamedObject(&module->fields, "__name__", (KrkObj*)S("_collections"));
+	krk_attachNamedValue(&module->fields, "__file__", NONE_VAL());
+	KRK_DOC(module, "@brief Native collection types. See the @c collections module.");
+
+	KrkClass * deque = krk_makeClass(module, &dequeClass, "deque", vm.baseClasses->objectClass);
+	KRK_DOC(deque,
+		"@brief Double-ended queue with fast appends and pops at either end.\n"
+		"@arguments iterable=None,maxlen=None\n\n"
+		"If @p maxlen is given, the deque never holds more than that many values: "
+		"adding a value to a full deque drops one from the other end.");
+	deque->allocSize = sizeof(struct Deque);
+	deque->_ongcscan = _deque_gcscan;
+	deque->_ongcsweep = _deque_gcsweep;
+	BIND_METHOD(deque,__init__);
+	BIND_METHOD(deque,__len__);
+	BIND_METHOD(deque,__repr__);
+	BIND_METHOD(deque,__iter__);
+	BIND_METHOD(deque,__contains__);
+	BIND_METHOD(deque,__getitem__);
+	BIND_METHOD(deque,__setitem__);
+	BIND_METHOD(deque,__delitem__);
+	BIND_METHOD(deque,__eq__);
+	BIND_PROP(deque,maxlen);
+	KRK_DOC(BIND_METHOD(deque,append),
+		"@brief Add @p item at the back.\n"
+		"@arguments item");
+	KRK_DOC(BIND_METHOD(deque,appendleft),
+		"@brief Add @p item at the front.\n"
+		"@arguments item");
+	KRK_DOC(BIND_METHOD(deque,pop),
+		"@brief Remove and return the value at the back.");
+	KRK_DOC(BIND_METHOD(deque,popleft),
+		"@brief Remove and return the value at the front.");
+	KRK_DOC(BIND_METHOD(deque,extend),
+		"@brief Add the values of @p iterable at the back.\n"
+		"@arguments iterable");
+	KRK_DOC(BIND_METHOD(deque,extendleft),
+		"@brief Add the values of @p iterable at the front, which reverses them.\n"
+		"@arguments iterable");
+	KRK_DOC(BIND_METHOD(deque,clear),
+		"@brief Remove every value.");
+	KRK_DOC(BIND_METHOD(deque,copy),
+		"@brief Shallow copy of the deque.");
+	KRK_DOC(BIND_METHOD(deque,rotate),
+		"@brief Move the last @p n values to the front, or the first to the back if @p n is negative.\n"
+		"@arguments n=1");
+	KRK_DOC(BIND_METHOD(deque,reverse),
+		"@brief Reverse the values in place.");
+	KRK_DOC(BIND_METHOD(deque,count),
+		"@brief Count the values equal to @p x.\n"
+		"@arguments x");
+	KRK_DOC(BIND_METHOD(deque,index),
+		"@brief Position of the first value equal to @p x.\n"
+		"@arguments x,start=0,stop=None");
+	KRK_DOC(BIND_METHOD(deque,insert),
+		"@brief Put @p x before position @p i.\n"
+		"@arguments i,x");
+	KRK_DOC(BIND_METHOD(deque,remove),
+		"@brief Remove the first value equal to @p value.\n"
+		"@arguments value");
+	krk_defineNative(&deque->methods, "__str__", FUNC_NAME(deque,__repr__));
+	krk_attachNamedValue(&deque->methods, "__hash__", NONE_VAL());
+	krk_finalizeClass(deque);
+
+	krk_makeClass(module, &dequeiterator, "dequeiterator", vm.baseClasses->objectClass);
+	dequeiterator->allocSize = sizeof(struct DequeIterator);
+	dequeiterator->_ongcscan = _dequeiterator_gcscan;
+	BIND_METHOD(dequeiterator,__init__);
+	BIND_METHOD(dequeiterator,__call__);
+	krk_finalizeClass(dequeiterator);
+}
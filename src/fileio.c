@@ -1,7 +1,15 @@
 /**
  * @file fileio.c
  * @brief Provides an interface to C FILE* streams.
+ *
+ * Lines are read with getline(), which scans the stream's own buffer for
+ * the newline with memchr and copies the line out in one go; the buffer it
+ * copies into belongs to the file object and is reused for every line.
+ * Reading through the stream's buffer, rather than one of our own on top
+ * of it, keeps lines, reads, writes, and anything else using the same
+ * stream, such as @c input() on @c stdin, seeing the same position.
  */
+#define _DEFAULT_SOURCE
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -14,8 +22,12 @@
 #include <kuroko/memory.h>
 #include <kuroko/util.h>
 
-static KrkClass * File = NULL;
-static KrkClass * BinaryFile = NULL;
+#include "private.h"
+
+static KrkVMLocal fileKey;
+#define FileClass KRK_VM_LOCAL(KrkClass*,fileKey)
+static KrkVMLocal binaryFileKey;
+#define BinaryFile KRK_VM_LOCAL(KrkClass*,binaryFileKey)
 
 /**
  * @brief Object for a C `FILE*` stream.
@@ -25,15 +37,18 @@ struct File {
 	KrkInstance inst;
 	FILE * filePtr;
 	int unowned;
+	char * line;      /**< Buffer for getline(), kept between lines */
+	size_t lineSize;  /**< Size of @c line */
 };
 
-#define IS_File(o) (krk_isInstanceOf(o, File))
+#define IS_File(o) (krk_isInstanceOf(o, FileClass))
 #define AS_File(o) ((struct File*)AS_OBJECT(o))
 
 #define IS_BinaryFile(o) (krk_isInstanceOf(o, BinaryFile))
 #define AS_BinaryFile(o) ((struct File*)AS_OBJECT(o))
 
-static KrkClass * Directory = NULL;
+static KrkVMLocal directoryKey;
+#define DirectoryClass KRK_VM_LOCAL(KrkClass*,directoryKey)
 /**
  * @brief OBject for a C `DIR*` stream.
  * @extends KrkInstance
@@ -43,33 +58,55 @@ struct Directory {
 	DIR * dirPtr;
 };
 
-#define IS_Directory(o) (krk_isInstanceOf(o,Directory))
+#define IS_Directory(o) (krk_isInstanceOf(o,DirectoryClass))
 #define AS_Directory(o) ((struct Directory*)AS_OBJECT(o))
 
 #define CURRENT_CTYPE struct File *
 #define CURRENT_NAME  self
 
+/* Buffer size for files opened without saying how they should be buffered. */
+#define DEFAULT_BUFFER_SIZE (64 * 1024)
+
+/** Set how @p file is buffered, as the @c buffering argument of open() describes. */
+static void setBuffering(FILE * file, krk_integer_type buffering) {
+	switch (buffering) {
+		case -1: setvbuf(file, NULL, _IOFBF, DEFAULT_BUFFER_SIZE); break;
+		case 0:  setvbuf(file, NULL, _IONBF, 0); break;
+		case 1:  setvbuf(file, NULL, _IOLBF, BUFSIZ); break;
+		default: setvbuf(file, NULL, _IOFBF, buffering); break;
+	}
+}
+
+int krk_fileStream(KrkValue value, FILE ** out) {
+	if (!IS_File(value) || IS_BinaryFile(value)) return 0;
+	*out = AS_File(value)->filePtr;
+	return 1;
+}
+
 KRK_FUNC(open,{
-	FUNCTION_TAKES_AT_LEAST(1);
-	FUNCTION_TAKES_AT_MOST(2);
-	CHECK_ARG(0,str,KrkString*,filename);
-	if (argc == 2 && !IS_STRING(argv[1])) return TYPE_ERROR(str,argv[1]);
+	KRK_ARGS(args, "O!|O!i", "file", "mode", "buffering");
+	KrkValue path;
+	KrkValue mode = NONE_VAL();
+	krk_integer_type buffering = -1;
+	if (!krk_parseArgs(args, vm.baseClasses->strClass, &path, vm.baseClasses->strClass, &mode, &buffering)) return NONE_VAL();
+	KrkString * filename = AS_STRING(path);
+	if (buffering < -1) return krk_runtimeError(vm.exceptions->valueError, "buffering must be >= -1");
 	KrkValue arg;
 	int isBinary = 0;
-	if (argc == 1) {
+	if (IS_NONE(mode)) {
 		arg = OBJECT_VAL(S("r"));
 		krk_push(arg); /* Will be peeked to find arg string for fopen */
 	} else {
 		/* Check mode against allowable modes */
-		if (AS_STRING(argv[1])->length == 0) return krk_runtimeError(vm.exceptions->typeError, "open: mode string must not be empty");
-		for (size_t i = 0; i < AS_STRING(argv[1])->length-1; ++i) {
-			if (AS_CSTRING(argv[1])[i] == 'b') {
+		if (AS_STRING(mode)->length == 0) return krk_runtimeError(vm.exceptions->typeError, "open: mode string must not be empty");
+		for (size_t i = 0; i < AS_STRING(mode)->length-1; ++i) {
+			if (AS_CSTRING(mode)[i] == 'b') {
 				return krk_runtimeError(vm.exceptions->typeError, "open: 'b' mode indicator must appear at end of mode string");
 			}
 		}
-		arg = argv[1];
-		if (AS_CSTRING(argv[1])[AS_STRING(argv[1])->length-1] == 'b') {
-			KrkValue tmp = OBJECT_VAL(krk_copyString(AS_CSTRING(argv[1]), AS_STRING(argv[1])->length-1));
+		arg = mode;
+		if (AS_CSTRING(mode)[AS_STRING(mode)->length-1] == 'b') {
+			KrkValue tmp = OBJECT_VAL(krk_copyString(AS_CSTRING(mode), AS_STRING(mode)->length-1));
 			krk_push(tmp);
 			isBinary = 1;
 		} else {
@@ -80,8 +117,10 @@ KRK_FUNC(open,{
 	FILE * file = fopen(filename->chars, AS_CSTRING(krk_peek(0)));
 	if (!file) return krk_runtimeError(vm.exceptions->ioError, "open: failed to open file; system returned: %s", strerror(errno));
 
+	setBuffering(file, buffering);
+
 	/* Now let's build an object to hold it */
-	KrkInstance * fileObject = krk_newInstance(isBinary ? BinaryFile : File);
+	KrkInstance * fileObject = krk_newInstance(isBinary ? BinaryFile : FileClass);
 	krk_push(OBJECT_VAL(fileObject));
 
 	/* Let's put the filename in there somewhere... */
@@ -111,66 +150,102 @@ KRK_METHOD(File,__str__,{
 	return OBJECT_VAL(out);
 })
 
-KRK_METHOD(File,readline,{
-	METHOD_TAKES_NONE();
+#ifdef _WIN32
+# define flockfile(f) _lock_file(f)
+# define funlockfile(f) _unlock_file(f)
+static ssize_t getline(char ** line, size_t * size, FILE * file) {
+	size_t length = 0;
+	int c;
+	while ((c = fgetc(file)) >= 0) {
+		if (length + 2 > *size) {
+			*size = *size ? *size * 2 : BLOCK_SIZE;
+			*line = realloc(*line, *size);
+		}
+		(*line)[length++] = c;
+		if (c == '\n') break;
+	}
+	if (!length) return -1;
+	(*line)[length] = '\0';
+	return length;
+}
+#endif
+
+/**
+ * Read a line of @p self into its line buffer, and make a @c str or @c bytes of it
+ * with @p make. Returns @c None at the end of the file.
+ *
+ * The stream stays locked until the line has been copied out of the buffer,
+ * so that another thread reading from the same file can not replace it first.
+ */
+static KrkValue readLine(struct File * self, KrkValue (*make)(const char *, size_t)) {
 	FILE * file = self->filePtr;
 
 	if (!file || feof(file)) {
 		return NONE_VAL();
 	}
 
-	size_t sizeRead = 0;
-	size_t spaceAvailable = 0;
-	char * buffer = NULL;
-
-	do {
-		if (spaceAvailable < sizeRead + BLOCK_SIZE) {
-			spaceAvailable = (spaceAvailable ? spaceAvailable * 2 : (2 * BLOCK_SIZE));
-			buffer = realloc(buffer, spaceAvailable);
-		}
-
-		char * target = &buffer[sizeRead];
-		while (sizeRead < spaceAvailable) {
-			int c = fgetc(file);
-			if (krk_currentThread.flags & KRK_THREAD_SIGNALLED) break;
-			if (c < 0) break;
-			sizeRead++;
-			*target++ = c;
-			if (c == '\n') goto _finish_line;
+	krk_beginBlocking();
+	flockfile(file);
+	ssize_t length = getline(&self->line, &self->lineSize, file);
+	krk_endBlocking();
+
+	KrkValue out = NONE_VAL();
+	if (length > 0) {
+		out = make(self->line, length);
+	} else if (ferror(file)) {
+		/* An interrupted read ends the line; the signal is dealt with when we return. */
+		clearerr(file);
+		if (!(krk_currentThread.flags & KRK_THREAD_SIGNALLED)) {
+			krk_runtimeError(vm.exceptions->ioError, "Read error.");
 		}
+	}
+	funlockfile(file);
+	return out;
+}
 
-		if (krk_currentThread.flags & KRK_THREAD_SIGNALLED) break;
-	} while (!feof(file));
+static KrkValue makeString(const char * chars, size_t length) {
+	return OBJECT_VAL(krk_copyStringUninterned(chars, length));
+}
 
-_finish_line: (void)0;
-	if (sizeRead == 0) {
-		free(buffer);
-		return NONE_VAL();
-	}
+static KrkValue makeBytes(const char * chars, size_t length) {
+	return OBJECT_VAL(krk_newBytes(length, (unsigned char*)chars));
+}
 
-	/* Make a new string to fit our output. */
-	KrkString * out = krk_copyString(buffer,sizeRead);
-	free(buffer);
-	return OBJECT_VAL(out);
+KRK_METHOD(File,readline,{
+	METHOD_TAKES_NONE();
+	return readLine(self, makeString);
 })
 
-KRK_METHOD(File,readlines,{
-	METHOD_TAKES_NONE();
+static KrkValue readLines(struct File * self, KrkValue (*make)(const char *, size_t)) {
 	KrkValue myList = krk_list_of(0,NULL,0);
 	krk_push(myList);
 
 	for (;;) {
-		KrkValue line = FUNC_NAME(File,readline)(1, argv, 0);
+		KrkValue line = readLine(self, make);
 		if (IS_NONE(line)) break;
-		if (krk_currentThread.flags & KRK_THREAD_SIGNALLED) break;
+		if (krk_currentThread.flags & (KRK_THREAD_SIGNALLED | KRK_THREAD_HAS_EXCEPTION)) break;
 
-		krk_push(line);
 		krk_writeValueArray(AS_LIST(myList), line);
-		krk_pop(); /* line */
 	}
 
 	krk_pop(); /* myList */
 	return myList;
+}
+
+KRK_METHOD(File,readlines,{
+	METHOD_TAKES_NONE();
+	return readLines(self, makeString);
+})
+
+KRK_METHOD(File,__iter__,{
+	METHOD_TAKES_NONE();
+	return argv[0];
+})
+
+KRK_METHOD(File,__call__,{
+	METHOD_TAKES_NONE();
+	KrkValue line = readLine(self, makeString);
+	return IS_NONE(line) ? argv[0] : line;
 })
 
 KRK_METHOD(File,read,{
@@ -203,10 +278,13 @@ KRK_METHOD(File,read,{
 			}
 
 			char * target = &buffer[sizeRead];
-			size_t newlyRead = fread(target, 1, BLOCK_SIZE, file);
+			size_t space = spaceAvailable - sizeRead;
+			krk_beginBlocking();
+			size_t newlyRead = fread(target, 1, space, file);
+			krk_endBlocking();
 			if (krk_currentThread.flags & KRK_THREAD_SIGNALLED) break;
 
-			if (newlyRead < BLOCK_SIZE) {
+			if (newlyRead < space) {
 				if (ferror(file)) {
 					free(buffer);
 					return krk_runtimeError(vm.exceptions->ioError, "Read error.");
@@ -218,11 +296,13 @@ KRK_METHOD(File,read,{
 	} else {
 		spaceAvailable = sizeToRead;
 		buffer = realloc(buffer, spaceAvailable);
+		krk_beginBlocking();
 		sizeRead = fread(buffer, 1, sizeToRead, file);
+		krk_endBlocking();
 	}
 
 	/* Make a new string to fit our output. */
-	KrkString * out = krk_copyString(buffer,sizeRead);
+	KrkString * out = krk_copyStringUninterned(buffer,sizeRead);
 	free(buffer);
 	return OBJECT_VAL(out);
 })
@@ -253,6 +333,25 @@ KRK_METHOD(File,flush,{
 	if (file) fflush(file);
 })
 
+KRK_METHOD(File,reconfigure,{
+	KRK_ARGS(args, ".$i", "buffering");
+	krk_integer_type buffering;
+	if (!krk_parseArgs(args, &buffering)) return NONE_VAL();
+	if (buffering < -1) return krk_runtimeError(vm.exceptions->valueError, "buffering must be >= -1");
+	FILE * file = self->filePtr;
+	if (!file) return krk_runtimeError(vm.exceptions->valueError, "I/O operation on closed file.");
+	/* A stream's buffering can only be changed before anything else is done with it. */
+	fflush(file);
+	setBuffering(file, buffering);
+})
+
+KRK_METHOD(File,fileno,{
+	METHOD_TAKES_NONE();
+	FILE * file = self->filePtr;
+	if (!file) return krk_runtimeError(vm.exceptions->valueError, "I/O operation on closed file.");
+	return INTEGER_VAL(fileno(file));
+})
+
 KRK_METHOD(File,__init__,{
 	return krk_runtimeError(vm.exceptions->typeError, "File objects can not be instantiated; use fileio.open() to obtain File objects.");
 })
@@ -262,13 +361,14 @@ KRK_METHOD(File,__exit__,{
 	return FUNC_NAME(File,close)(1,argv,0);
 })
 
-static void makeFileInstance(KrkInstance * module, const char name[], FILE * file) {
-	KrkInstance * fileObject = krk_newInstance(File);
+static void makeFileInstance(KrkInstance * module, const char name[], const char mode[], FILE * file) {
+	KrkInstance * fileObject = krk_newInstance(FileClass);
 	krk_push(OBJECT_VAL(fileObject));
 	KrkValue filename = OBJECT_VAL(krk_copyString(name,strlen(name)));
 	krk_push(filename);
 
 	krk_attachNamedValue(&fileObject->fields, "filename", filename);
+	krk_attachNamedObject(&fileObject->fields, "modestr", (KrkObj*)krk_copyString(mode,strlen(mode)));
 	((struct File*)fileObject)->filePtr = file;
 	((struct File*)fileObject)->unowned = 1;
 
@@ -280,64 +380,34 @@ static void makeFileInstance(KrkInstance * module, const char name[], FILE * fil
 
 KRK_METHOD(BinaryFile,readline,{
 	METHOD_TAKES_NONE();
-	FILE * file = self->filePtr;
-
-	if (!file || feof(file)) {
-		return NONE_VAL();
-	}
-
-	size_t sizeRead = 0;
-	size_t spaceAvailable = 0;
-	char * buffer = NULL;
-
-	do {
-		if (spaceAvailable < sizeRead + BLOCK_SIZE) {
-			spaceAvailable = (spaceAvailable ? spaceAvailable * 2 : (2 * BLOCK_SIZE));
-			buffer = realloc(buffer, spaceAvailable);
-		}
-
-		char * target = &buffer[sizeRead];
-		while (sizeRead < spaceAvailable) {
-			int c = fgetc(file);
-			if (krk_currentThread.flags & KRK_THREAD_SIGNALLED) break;
-			if (c < 0) break;
-			sizeRead++;
-			*target++ = c;
-			if (c == '\n') goto _finish_line;
-		}
-
-		if (krk_currentThread.flags & KRK_THREAD_SIGNALLED) break;
-	} while (!feof(file));
-
-_finish_line: (void)0;
-	if (sizeRead == 0) {
-		free(buffer);
-		return NONE_VAL();
-	}
-
-	/* Make a new string to fit our output. */
-	KrkBytes * out = krk_newBytes(sizeRead, (unsigned char*)buffer);
-	free(buffer);
-	return OBJECT_VAL(out);
+	return readLine(self, makeBytes);
 })
 
 KRK_METHOD(BinaryFile,readlines,{
 	METHOD_TAKES_NONE();
-	KrkValue myList = krk_list_of(0,NULL,0);
-	krk_push(myList);
+	return readLines(self, makeBytes);
+})
 
-	for (;;) {
-		KrkValue line = FUNC_NAME(BinaryFile,readline)(1, argv, 0);
-		if (IS_NONE(line)) break;
-		if (krk_currentThread.flags & KRK_THREAD_SIGNALLED) break;
+KRK_METHOD(BinaryFile,__call__,{
+	METHOD_TAKES_NONE();
+	KrkValue line = readLine(self, makeBytes);
+	return IS_NONE(line) ? argv[0] : line;
+})
 
-		krk_push(line);
-		krk_writeValueArray(AS_LIST(myList), line);
-		krk_pop(); /* line */
+KRK_METHOD(BinaryFile,readinto,{
+	METHOD_TAKES_EXACTLY(1);
+	KrkBuffer target;
+	if (!krk_getBuffer(argv[1], &target, 1)) return NONE_VAL();
+	FILE * file = self->filePtr;
+	if (!file) return krk_runtimeError(vm.exceptions->valueError, "I/O operation on closed file.");
+	krk_beginBlocking();
+	size_t sizeRead = fread(target.bytes, 1, target.length, file);
+	krk_endBlocking();
+	if (sizeRead < target.length && ferror(file)) {
+		clearerr(file);
+		return krk_runtimeError(vm.exceptions->ioError, "Read error.");
 	}
-
-	krk_pop(); /* myList */
-	return myList;
+	return INTEGER_VAL(sizeRead);
 })
 
 KRK_METHOD(BinaryFile,read,{
@@ -370,11 +440,14 @@ KRK_METHOD(BinaryFile,read,{
 			}
 
 			char * target = &buffer[sizeRead];
-			size_t newlyRead = fread(target, 1, BLOCK_SIZE, file);
+			size_t space = spaceAvailable - sizeRead;
+			krk_beginBlocking();
+			size_t newlyRead = fread(target, 1, space, file);
+			krk_endBlocking();
 
 			if (krk_currentThread.flags & KRK_THREAD_SIGNALLED) break;
 
-			if (newlyRead < BLOCK_SIZE) {
+			if (newlyRead < space) {
 				if (ferror(file)) {
 					free(buffer);
 					return krk_runtimeError(vm.exceptions->ioError, "Read error.");
@@ -386,7 +459,9 @@ KRK_METHOD(BinaryFile,read,{
 	} else {
 		spaceAvailable = sizeToRead;
 		buffer = realloc(buffer, spaceAvailable);
+		krk_beginBlocking();
 		sizeRead = fread(buffer, 1, sizeToRead, file);
+		krk_endBlocking();
 	}
 
 	/* Make a new string to fit our output. */
@@ -397,7 +472,8 @@ KRK_METHOD(BinaryFile,read,{
 
 KRK_METHOD(BinaryFile,write,{
 	METHOD_TAKES_EXACTLY(1);
-	if (!IS_BYTES(argv[1])) return TYPE_ERROR(bytes,argv[1]);
+	KrkBuffer data;
+	if (!krk_getBuffer(argv[1], &data, 0)) return NONE_VAL();
 	/* Find the file ptr reference */
 	FILE * file = self->filePtr;
 
@@ -405,7 +481,7 @@ KRK_METHOD(BinaryFile,write,{
 		return NONE_VAL();
 	}
 
-	return INTEGER_VAL(fwrite(AS_BYTES(argv[1])->bytes, 1, AS_BYTES(argv[1])->length, file));
+	return INTEGER_VAL(fwrite(data.bytes, 1, data.length, file));
 })
 
 #undef CURRENT_CTYPE
@@ -416,6 +492,7 @@ static void _file_sweep(KrkInstance * self) {
 		fclose(me->filePtr);
 		me->filePtr = NULL;
 	}
+	free(me->line);
 }
 
 static void _dir_sweep(KrkInstance * self) {
@@ -433,7 +510,7 @@ KRK_FUNC(opendir,{
 	DIR * dir = opendir(path->chars);
 	if (!dir) return krk_runtimeError(vm.exceptions->ioError, "opendir: %s", strerror(errno));
 
-	struct Directory * dirObj = (void *)krk_newInstance(Directory);
+	struct Directory * dirObj = (void *)krk_newInstance(DirectoryClass);
 	krk_push(OBJECT_VAL(dirObj));
 
 	krk_attachNamedValue(&dirObj->inst.fields, "path", OBJECT_VAL(path));
@@ -505,7 +582,7 @@ void _createAndBind_fileioMod(void) {
 	);
 
 	/* Define a class to represent files. (Should this be a helper method?) */
-	krk_makeClass(module, &File, "File", vm.baseClasses->objectClass);
+	KrkClass * File = krk_makeClass(module, &FileClass, "File", vm.baseClasses->objectClass);
 	KRK_DOC(File,"Interface to a buffered file stream.");
 	File->allocSize = sizeof(struct File);
 	File->_ongcsweep = _file_sweep;
@@ -515,13 +592,21 @@ void _createAndBind_fileioMod(void) {
 		"@arguments bytes=-1\n\n"
 		"Reads up to @p bytes bytes from the stream. If @p bytes is @c -1 then reading "
 		"will continue until the system returns _end of file_.");
-	KRK_DOC(BIND_METHOD(File,readline), "@brief Read one line from the stream.");
+	KRK_DOC(BIND_METHOD(File,readline), "@brief Read one line from the stream.\n\n"
+		"Returns @c None at the end of the stream.");
 	KRK_DOC(BIND_METHOD(File,readlines), "@brief Read the entire stream and return a list of lines.");
+	KRK_DOC(BIND_METHOD(File,__iter__), "@brief Iterate over the lines of the stream.");
+	KRK_DOC(BIND_METHOD(File,__call__), "@brief Read the next line of the stream, or return the file itself at the end.");
 	KRK_DOC(BIND_METHOD(File,write), "@brief Write to the stream.\n"
 		"@arguments data\n\n"
 		"Writes the contents of @p data to the stream.");
 	KRK_DOC(BIND_METHOD(File,close), "@brief Close the stream and flush any remaining buffered writes.");
 	KRK_DOC(BIND_METHOD(File,flush), "@brief Flush unbuffered writes to the stream.");
+	KRK_DOC(BIND_METHOD(File,fileno), "@brief The file descriptor the stream reads from and writes to.");
+	KRK_DOC(BIND_METHOD(File,reconfigure), "@brief Change how the stream is buffered.\n"
+		"@arguments buffering\n\n"
+		"Flushes the stream, then buffers it as the @p buffering argument of @ref open describes: @c 0 for no buffering, "
+		"@c 1 to write a line at a time, @c -1 for a 64KiB buffer, or the size of the buffer to use.");
 	BIND_METHOD(File,__str__);
 	KRK_DOC(BIND_METHOD(File,__init__), "@bsnote{%File objects can not be initialized using this constructor. "
 		"Use the <a class=\"el\" href=\"#open\">open()</a> function instead.}");
@@ -537,10 +622,15 @@ void _createAndBind_fileioMod(void) {
 	BIND_METHOD(BinaryFile,read);
 	BIND_METHOD(BinaryFile,readline);
 	BIND_METHOD(BinaryFile,readlines);
+	BIND_METHOD(BinaryFile,__call__);
+	KRK_DOC(BIND_METHOD(BinaryFile,readinto), "@brief Read into a writable bytes-like object.\n"
+		"@arguments buffer\n\n"
+		"Reads up to the length of @p buffer, such as a @ref bytearray or @c memoryview, from the stream "
+		"into it, and returns how many bytes were read.");
 	BIND_METHOD(BinaryFile,write);
 	krk_finalizeClass(BinaryFile);
 
-	krk_makeClass(module, &Directory, "Directory", vm.baseClasses->objectClass);
+	KrkClass * Directory = krk_makeClass(module, &DirectoryClass, "Directory", vm.baseClasses->objectClass);
 	KRK_DOC(Directory,
 		"Represents an opened file system directory."
 	);
@@ -556,16 +646,18 @@ void _createAndBind_fileioMod(void) {
 	krk_finalizeClass(Directory);
 
 	/* Make an instance for stdout, stderr, and stdin */
-	makeFileInstance(module, "stdin", stdin);
-	makeFileInstance(module, "stdout", stdout);
-	makeFileInstance(module, "stderr", stderr);
+	makeFileInstance(module, "stdin", "r", stdin);
+	makeFileInstance(module, "stdout", "w", stdout);
+	makeFileInstance(module, "stderr", "w", stderr);
 
 	/* Our base will be the open method */
 	KRK_DOC(BIND_FUNC(module,open), "@brief Open a file.\n"
-		"@arguments path,mode=\"r\"\n\n"
+		"@arguments path,mode=\"r\",buffering=-1\n\n"
 		"Opens @p path using the modestring @p mode. Supported modestring characters depend on the system implementation. "
 		"If the last character of @p mode is @c 'b' a @ref BinaryFile will be returned. If the file could not be opened, "
-		"an @ref IOError will be raised.");
+		"an @ref IOError will be raised. "
+		"@p buffering is the size of the stream's buffer: @c 0 for no buffering, @c 1 to write a line at a time, "
+		"or @c -1 for the default of 64KiB.");
 	KRK_DOC(BIND_FUNC(module,opendir), "@brief Open a directory for scanning.\n"
 		"@arguments path\n\n"
 		"Opens the directory at @p path and returns a @ref Directory object. If @p path could not be opened or is not "
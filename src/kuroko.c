@@ -29,6 +29,8 @@
 #include <kuroko/scanner.h>
 #include <kuroko/compiler.h>
 #include <kuroko/util.h>
+#include <kuroko/profiler.h>
+#include <kuroko/marshal.h>
 
 #define PROMPT_MAIN  ">>> "
 #define PROMPT_BLOCK "  > "
@@ -767,8 +769,18 @@ int main(int argc, char * argv[]) {
 	int inspectAfter = 0;
 	int opt;
 	int maxDepth = -1;
-	while ((opt = getopt(argc, argv, "+:c:C:dgGim:rR:stTMSV-:")) != -1) {
+	char * profileFile = NULL;
+	char * startupImage = NULL;
+	char * writeImage = NULL;
+#ifdef KRK_OPCODE_STATS
+	int opcodeStats = 0;
+#endif
+	while ((opt = getopt(argc, argv, "+:Bc:C:dgGiI:m:OP:rR:stTMSV-:")) != -1) {
 		switch (opt) {
+			case 'B':
+				/* Don't write bytecode caches for imported modules. */
+				flags |= KRK_GLOBAL_NO_WRITE_BYTECODE;
+				break;
 			case 'c':
 				runCmd = optarg;
 				goto _finishArgs;
@@ -802,10 +814,20 @@ int main(int argc, char * argv[]) {
 			case 'i':
 				inspectAfter = 1;
 				break;
+			case 'I':
+				startupImage = optarg;
+				break;
 			case 'm':
 				moduleAsMain = 1;
 				optind--; /* to get us back to optarg */
 				goto _finishArgs;
+			case 'O':
+				/* Run the bytecode optimizer on compiled code. */
+				flags |= KRK_GLOBAL_OPTIMIZE;
+				break;
+			case 'P':
+				profileFile = optarg;
+				break;
 			case 'r':
 				enableRline = 0;
 				break;
@@ -829,6 +851,16 @@ int main(int argc, char * argv[]) {
 				optarg = argv[optind]+2;
 				/* fall through */
 			case '-':
+#ifdef KRK_OPCODE_STATS
+				if (!strcmp(optarg,"opcode-stats")) {
+					opcodeStats = 1;
+					break;
+				}
+#endif
+				if (!strncmp(optarg,"write-image=",12)) {
+					writeImage = optarg + 12;
+					goto _finishArgs;
+				}
 				if (!strcmp(optarg,"version")) {
 					return runString(argv,0,"import kuroko; print('Kuroko',kuroko.version)\n");
 				} else if (!strcmp(optarg,"help")) {
@@ -836,11 +868,15 @@ int main(int argc, char * argv[]) {
 					fprintf(stderr,"usage: %s [flags] [FILE...]\n"
 						"\n"
 						"Interpreter options:\n"
+						" -B          Do not write .kbc bytecode caches when importing modules.\n"
 						" -d          Debug output from the bytecode compiler.\n"
 						" -g          Collect garbage on every allocation.\n"
 						" -G          Report GC collections.\n"
 						" -i          Enter repl after a running -c, -m, or FILE.\n"
+						" -I image    Preload the modules bundled in a startup image.\n"
 						" -m mod      Run a module as a script.\n"
+						" -O          Optimize bytecode after compilation.\n"
+						" -P file     Write sampled collapsed call stacks to 'file'.\n"
 						" -r          Disable complex line editing in the REPL.\n"
 						" -R depth    Set maximum recursion depth.\n"
 						" -s          Debug output from the scanner/tokenizer.\n"
@@ -852,6 +888,11 @@ int main(int argc, char * argv[]) {
 						" -V          Print version information.\n"
 						"\n"
 						" --version   Print version information.\n"
+						" --write-image=image MOD...\n"
+						"             Bundle the named modules into a startup image.\n"
+#ifdef KRK_OPCODE_STATS
+						" --opcode-stats Print instruction counters on exit.\n"
+#endif
 						" --help      Show this help text.\n"
 						"\n"
 						"If no files are provided, the interactive REPL will run.\n",
@@ -874,6 +915,11 @@ _finishArgs:
 		krk_setMaximumRecursionDepth(maxDepth);
 	}
 
+	if (profileFile && krk_profilerStart(1000)) {
+		fprintf(stderr, "%s: profiling is not available in this build\n", argv[0]);
+		profileFile = NULL;
+	}
+
 #ifndef KRK_DISABLE_DEBUG
 	krk_debug_registerCallback(debuggerHook);
 #endif
@@ -947,6 +993,15 @@ _finishArgs:
 		"If provided, @p syntax specifies the name of an @c rline syntax module to "
 		"provide color highlighting of the input line.");
 
+	if (writeImage || startupImage) {
+		int failed = writeImage ? krk_writeStartupImage(writeImage, argc - optind, &argv[optind]) : krk_loadStartupImage(startupImage);
+		if (failed) {
+			krk_dumpTraceback();
+			return 1;
+		}
+		if (writeImage) return 0;
+	}
+
 	if (moduleAsMain) {
 		krk_push(OBJECT_VAL(krk_copyString("__main__",8)));
 		int out = !krk_importModule(
@@ -1189,6 +1244,24 @@ _finishArgs:
 		}
 	}
 
+#ifdef KRK_OPCODE_STATS
+	if (opcodeStats) {
+		krk_opcodeStatsWrite(stderr, 50);
+	}
+#endif
+
+	if (profileFile) {
+		krk_profilerStop();
+		FILE * f = fopen(profileFile, "w");
+		if (f) {
+			krk_resetStack();
+			krk_profilerWrite(f);
+			fclose(f);
+		} else {
+			fprintf(stderr, "%s: %s: %s\n", argv[0], profileFile, strerror(errno));
+		}
+	}
+
 	if (vm.globalFlags & KRK_GLOBAL_CALLGRIND) {
 		fclose(vm.callgrindFile);
 		vm.globalFlags &= ~(KRK_GLOBAL_CALLGRIND);
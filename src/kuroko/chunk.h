@@ -22,6 +22,9 @@
  * it is recommended that this property remain true.
  *
  * 2-operand opcodes are generally jump instructions.
+ *
+ * Some opcodes are never emitted by the compiler and are instead written over
+ * generic instructions at runtime by the VM; see the quickening notes in vm.c.
  */
 typedef enum {
 	OP_NONE,
@@ -84,6 +87,35 @@ typedef enum {
 	OP_INPLACE_MODULO,
 	OP_INPLACE_MULTIPLY,
 
+	/* Type-specialized forms of the above, installed by quickening */
+	OP_ADD_INT,
+	OP_ADD_FLOAT,
+	OP_ADD_STR,
+	OP_SUBTRACT_INT,
+	OP_SUBTRACT_FLOAT,
+	OP_MULTIPLY_INT,
+	OP_MULTIPLY_FLOAT,
+	OP_DIVIDE_FLOAT,
+	OP_MODULO_INT,
+	OP_BITAND_INT,
+	OP_BITOR_INT,
+	OP_BITXOR_INT,
+	OP_LESS_INT,
+	OP_LESS_FLOAT,
+	OP_GREATER_INT,
+	OP_GREATER_FLOAT,
+	OP_LESS_EQUAL_INT,
+	OP_LESS_EQUAL_FLOAT,
+	OP_GREATER_EQUAL_INT,
+	OP_GREATER_EQUAL_FLOAT,
+	OP_INPLACE_ADD_INT,
+	OP_INPLACE_ADD_FLOAT,
+	OP_INPLACE_ADD_STR,
+	OP_INPLACE_SUBTRACT_INT,
+	OP_INPLACE_SUBTRACT_FLOAT,
+	OP_INPLACE_MULTIPLY_INT,
+	OP_INPLACE_MULTIPLY_FLOAT,
+
 	/* One-opcode instructions */
 	OP_CALL,
 	OP_CLASS,
@@ -96,6 +128,7 @@ typedef enum {
 	OP_EXPAND_ARGS,
 	OP_GET_GLOBAL,
 	OP_GET_LOCAL,
+	OP_GET_LOCAL_INPLACE,
 	OP_GET_PROPERTY,
 	OP_GET_SUPER,
 	OP_GET_UPVALUE,
@@ -109,6 +142,8 @@ typedef enum {
 	OP_SET_PROPERTY,
 	OP_SET_UPVALUE,
 	OP_TUPLE,
+	OP_BUILD_STRING,
+	OP_FORMAT_VALUE,
 	OP_UNPACK,
 	OP_LIST_APPEND,
 	OP_DICT_SET,
@@ -123,6 +158,10 @@ typedef enum {
 	OP_CLOSE_MANY,
 	OP_POP_MANY,
 
+	/* Superinstructions installed by quickening; these have no long forms */
+	OP_ADD_LOCAL_LOCAL,
+	OP_LESS_LOCAL_CONST,
+
 	/* Two opcode instructions */
 	OP_JUMP_IF_FALSE_OR_POP,
 	OP_JUMP_IF_TRUE_OR_POP,
@@ -147,6 +186,7 @@ typedef enum {
 	OP_EXPAND_ARGS_LONG,
 	OP_GET_GLOBAL_LONG,
 	OP_GET_LOCAL_LONG,
+	OP_GET_LOCAL_INPLACE_LONG,
 	OP_GET_PROPERTY_LONG,
 	OP_GET_SUPER_LONG,
 	OP_GET_UPVALUE_LONG,
@@ -160,6 +200,8 @@ typedef enum {
 	OP_SET_PROPERTY_LONG,
 	OP_SET_UPVALUE_LONG,
 	OP_TUPLE_LONG,
+	OP_BUILD_STRING_LONG,
+	OP_FORMAT_VALUE_LONG,
 	OP_UNPACK_LONG,
 	OP_LIST_APPEND_LONG,
 	OP_DICT_SET_LONG,
@@ -190,15 +232,30 @@ typedef struct {
 	size_t line;
 } KrkLineMap;
 
+/**
+ * @brief Bytecode range in which an exception handler may be live.
+ *
+ * The compiler records one region for each @c try and @c with statement,
+ * covering the instructions between the push of the handler and the end
+ * of the scope that pops it. Instructions outside of every region can
+ * not have a handler for their own frame on the stack, which lets
+ * @c OP_RETURN skip looking for one.
+ */
+typedef struct {
+	size_t startOffset;
+	size_t endOffset;
+} KrkHandlerRegion;
+
 /**
  * @brief Opcode chunk of a code object.
  *
  * Opcode chunks are internal to code objects and I'm not really
  * sure why we're still separating them from the KrkCodeObjects.
  *
- * Stores four flexible arrays using three different formats:
+ * Stores five flexible arrays using four different formats:
  * - Code, representing opcodes and operands.
  * - Lines, representing offset-to-line mappings.
+ * - Handlers, representing ranges where exception handlers may be live.
  * - Filename, the string name of the source file.
  * - Constants, an array of values referenced by the code object.
  */
@@ -211,6 +268,10 @@ typedef struct {
 	size_t linesCapacity;
 	KrkLineMap * lines;
 
+	size_t handlersCount;
+	size_t handlersCapacity;
+	KrkHandlerRegion * handlers;
+
 	KrkString * filename;
 	KrkValueArray constants;
 } KrkChunk;
@@ -264,3 +325,25 @@ extern size_t krk_writeConstant(KrkChunk * chunk, KrkValue value, size_t line);
  * @return Line number, 1-indexed.
  */
 extern size_t krk_lineNumber(KrkChunk * chunk, size_t offset);
+
+/**
+ * @brief Record a bytecode range in which an exception handler may be live.
+ * @memberof KrkChunk
+ *
+ * Called by the compiler when it finishes a @c try or @c with statement.
+ *
+ * @param chunk       Bytecode chunk containing the statement.
+ * @param startOffset Offset of the instruction that pushes the handler.
+ * @param endOffset   Offset just past the instruction that pops it.
+ */
+extern void krk_addHandlerRegion(KrkChunk * chunk, size_t startOffset, size_t endOffset);
+
+/**
+ * @brief Determine whether an instruction may have a live exception handler.
+ * @memberof KrkChunk
+ *
+ * @param chunk  Bytecode chunk containing the instruction.
+ * @param offset Byte offset of the instruction.
+ * @return 1 if @p offset falls within a recorded handler region, 0 otherwise.
+ */
+extern int krk_inHandlerRegion(KrkChunk * chunk, size_t offset);
@@ -16,6 +16,19 @@
  */
 extern KrkCodeObject * krk_compile(const char * src, char * fileName);
 
+/**
+ * @brief Simplify the bytecode of a finished code object.
+ *
+ * Folds arithmetic and string concatenation of constants, resolves branches
+ * on constants, removes unreachable instructions and values that are pushed
+ * only to be popped, and threads jumps to jumps. The line map, handler regions
+ * and local name ranges are updated to match. The compiler calls this for each
+ * code object when @c KRK_GLOBAL_OPTIMIZE is set.
+ *
+ * @param function Code object to optimize; it must not have been run yet.
+ */
+extern void krk_optimizeCodeObject(KrkCodeObject * function);
+
 /**
  * @brief Mark objects owned by the compiler as in use.
  */
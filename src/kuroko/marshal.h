@@ -0,0 +1,156 @@
+#pragma once
+/**
+ * @file marshal.h
+ * @brief Binary serialization of compiled code objects.
+ *
+ * A compiled module can be written out as a @c KRKB image holding a string
+ * table and every code object reachable from the module's top-level code.
+ * Images record the modification time and size of the source file they
+ * were compiled from, so the import system can keep @c .kbc files next to
+ * module sources and skip recompiling them when the source has not changed.
+ *
+ * Loaded images are used in place: the import system maps @c .kbc files into
+ * memory, code objects point directly at the bytecode and line maps inside
+ * them, and the constants of each code object are only built the first time
+ * it is called. Until then, such a code object is marked with
+ * @c KRK_OBJ_FLAGS_CODEOBJECT_LAZY; use @ref krk_materializeCodeObject before
+ * looking at its constants or local names.
+ *
+ * Several module images can also be bundled into one startup image, which an
+ * interpreter maps at launch to preload those modules without searching the
+ * module paths for them.
+ *
+ * Images are only meant to be read by the build of Kuroko that wrote them:
+ * the header records a format version and a checksum of the opcode table,
+ * and images with any other values are rejected.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include "object.h"
+
+/**
+ * @brief Identifies the version of a source file an image was compiled from.
+ */
+typedef struct {
+	uint64_t mtime; /**< @brief Modification time of the source, in nanoseconds where available */
+	uint64_t size;  /**< @brief Size of the source file in bytes */
+} KrkSourceStamp;
+
+/**
+ * @brief Obtain the stamp of a source file.
+ *
+ * @param fileName Path to the source file.
+ * @param stamp    Receives the modification time and size of the file.
+ * @return 0 on success, or -1 if the file could not be examined.
+ */
+extern int krk_sourceStamp(const char * fileName, KrkSourceStamp * stamp);
+
+/**
+ * @brief Write a code object and everything it references to a stream.
+ *
+ * Constants that can not be represented in an image, such as @c long
+ * integers, cause the write to fail; callers should treat an image
+ * as a cache and discard a partially written file.
+ *
+ * @param out      Stream to write to.
+ * @param function Top-level code object of a module; it must not have been run yet.
+ * @param source   Stamp of the source file to record, or NULL to record none.
+ * @return 0 on success, or -1 on failure.
+ */
+extern int krk_marshal(FILE * out, KrkCodeObject * function, const KrkSourceStamp * source);
+
+/**
+ * @brief Check whether a buffer holds a usable image.
+ *
+ * Verifies the magic, format version and opcode checksum. When @p source
+ * is provided, the recorded source stamp must also match it, and the image
+ * must have been compiled with the bytecode optimizer in the same state as
+ * it is now.
+ *
+ * @param data   Image contents.
+ * @param size   Size of @p data in bytes.
+ * @param source Expected source stamp, or NULL to skip checking it.
+ * @return 1 if the image can be loaded, 0 otherwise.
+ */
+extern int krk_marshalValid(const uint8_t * data, size_t size, const KrkSourceStamp * source);
+
+/**
+ * @brief Load the top-level code object of an image.
+ *
+ * The resulting code objects belong to the current module, like those
+ * produced by @c krk_compile. No exception is raised for a malformed image
+ * header; damage further in is reported when the affected function is
+ * first called.
+ *
+ * @param data     Image contents, aligned to at least 8 bytes. Code objects use this
+ *                 memory in place and may write to it, so it must stay valid and
+ *                 writable for as long as they exist; in practice, forever.
+ * @param size     Size of @p data in bytes.
+ * @param filename Source path to attach to the code objects, for tracebacks.
+ * @return The top-level code object, or NULL if the image was invalid.
+ */
+extern KrkCodeObject * krk_unmarshal(uint8_t * data, size_t size, KrkString * filename);
+
+/**
+ * @brief Build the constants and local names of a code object loaded from an image.
+ *
+ * Called by the VM the first time a function is called. Does nothing for
+ * code objects that are already complete.
+ *
+ * @param function Code object to complete.
+ * @return 1 on success, or 0 with an @c ImportError set if the image is damaged.
+ */
+extern int krk_materializeCodeObject(KrkCodeObject * function);
+
+/**
+ * @brief Compile a source file, using and refreshing its bytecode cache.
+ *
+ * For @c foo.krk, the cache is @c foo.kbc in the same directory. If the
+ * cache is valid for the current source it is loaded instead of compiling.
+ * Otherwise the source is compiled and, if @p writable is set and
+ * @c KRK_GLOBAL_NO_WRITE_BYTECODE is not, a new cache is written; failing to
+ * write it is not an error. The cache is bypassed entirely while compiler
+ * debugging output is enabled.
+ *
+ * @param fileName Path to a source file ending in @c .krk
+ * @param writable Whether a new cache may be written for this file.
+ * @return The compiled code object, or NULL with an exception set on failure.
+ */
+extern KrkCodeObject * krk_compileCached(char * fileName, int writable);
+
+/**
+ * @brief Write a startup image bundling several modules.
+ *
+ * Each module is imported to find its source file, which is then compiled
+ * again into an image. Only modules written in Kuroko can be bundled.
+ * The resulting file can be given to @ref krk_loadStartupImage by later
+ * processes to preload the same modules without searching for or compiling them.
+ *
+ * @param fileName Path of the startup image to write.
+ * @param count    Number of modules in @p modules.
+ * @param modules  Dotted names of the modules, in the order they should be preloaded.
+ * @return 0 on success, or -1 with an exception set on failure.
+ */
+extern int krk_writeStartupImage(const char * fileName, int count, char * modules[]);
+
+/**
+ * @brief Map a startup image and preload the modules it contains.
+ *
+ * Bundled modules are imported in the order they were written. Later
+ * imports of a bundled module, from any search path, use the bundled
+ * code. Modules whose source file has changed since the image was written
+ * are left out and imported normally.
+ *
+ * @param fileName Path to a startup image from @ref krk_writeStartupImage
+ * @return 0 on success, or -1 with an exception set on failure.
+ */
+extern int krk_loadStartupImage(const char * fileName);
+
+/**
+ * @brief Look up a module in the loaded startup images.
+ *
+ * @param path      Module name, with @c PATH_SEP between components as used by the importer.
+ * @param isPackage Set to 1 if the module is a package.
+ * @return The source path the module was bundled from, or NULL if it is not bundled.
+ */
+extern const char * krk_startupImageFind(KrkString * path, int * isPackage);
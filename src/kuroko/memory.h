@@ -42,12 +42,55 @@ extern void krk_freeObjects(void);
  *
  * Runs one scan-sweep cycle of the garbage collector, potentially
  * freeing unused resources and advancing potentially-unused
- * resources to the next stage of removal.
+ * resources to the next stage of removal. An incremental collection
+ * that is still in progress is finished first.
  *
  * @return The number of bytes released by this collection cycle.
  */
 extern size_t krk_collectGarbage(void);
 
+/**
+ * @brief Run a minor cycle of the garbage collector.
+ *
+ * Only objects allocated since the last collection are scanned and
+ * swept; older objects are assumed to be alive, and the ones that have
+ * been written to since are scanned through the remembered set.
+ * Objects that survive a collection are promoted and are only freed
+ * by a full collection from @ref krk_collectGarbage.
+ *
+ * @return The number of objects released by this collection cycle.
+ */
+extern size_t krk_collectYoungGarbage(void);
+
+/**
+ * @brief Add an old object to the remembered set.
+ *
+ * Use @ref krk_gcWriteBarrier instead of calling this directly.
+ *
+ * @param obj The object that was written to.
+ */
+extern void krk_gcRemember(KrkObj * obj);
+
+/**
+ * @brief Record a store of a reference into a heap object.
+ *
+ * Minor collections do not scan old objects, so a young object that is
+ * only referenced by an old one would be freed. Whenever a reference
+ * to another object is stored into an existing object by a path that
+ * does not go through a table or value array with an owner set, this
+ * must be called with the object that was written to, after the store.
+ * Stores into objects that were just allocated, before anything else
+ * is allocated, do not need it.
+ *
+ * Incremental collections rely on the same remembered set to find old
+ * objects that were written to after they were scanned.
+ *
+ * @param obj The object that was written to.
+ */
+static inline void krk_gcWriteBarrier(KrkObj * obj) {
+	if ((obj->flags & (KRK_OBJ_FLAGS_GC_OLD | KRK_OBJ_FLAGS_GC_REMEMBERED)) == KRK_OBJ_FLAGS_GC_OLD) krk_gcRemember(obj);
+}
+
 /**
  * @brief During a GC scan cycle, mark a value as used.
  *
@@ -90,3 +133,27 @@ extern void krk_markTable(KrkTable * table);
  * @param size Size of data at @p ptr
  */
 extern void krk_gcTakeBytes(const void * ptr, size_t size);
+
+#ifdef ENABLE_THREADING
+/**
+ * @brief Mark the current thread as waiting in a blocking call.
+ *
+ * Native functions that may wait for a long time - on a lock, another
+ * thread, a timer, or I/O - should wrap the wait in this and
+ * @ref krk_endBlocking so that other threads can collect garbage in
+ * the meantime. Between the two, the thread must not touch any heap
+ * objects other than through values that are on its stack, and must not
+ * allocate.
+ */
+extern void krk_beginBlocking(void);
+
+/**
+ * @brief Resume after a blocking call started by @ref krk_beginBlocking
+ *
+ * If another thread is collecting garbage, waits for it to finish.
+ */
+extern void krk_endBlocking(void);
+#else
+static inline void krk_beginBlocking(void) { }
+static inline void krk_endBlocking(void) { }
+#endif
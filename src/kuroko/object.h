@@ -4,6 +4,7 @@
  * @brief Struct definitions for core object types.
  */
 #include <stdio.h>
+#include <string.h>
 #include "kuroko.h"
 #include "value.h"
 #include "chunk.h"
@@ -50,11 +51,19 @@ typedef struct KrkObj {
 #define KRK_OBJ_FLAGS_STRING_UCS1   0x0001
 #define KRK_OBJ_FLAGS_STRING_UCS2   0x0002
 #define KRK_OBJ_FLAGS_STRING_UCS4   0x0003
+#define KRK_OBJ_FLAGS_STRING_INTERNED 0x0400 /**< In the string table; equal interned strings are the same object */
+#define KRK_OBJ_FLAGS_STRING_APPENDABLE 0x0800 /**< Only referenced by the local it is being built in, so @c += may extend it in place */
+#define KRK_OBJ_FLAGS_STRING_SPARE  0x1000 /**< The UTF-8 buffer has room to grow; see @c krk_stringCapacity */
+#define KRK_OBJ_FLAGS_STRING_BREADCRUMBS 0x2000 /**< @c codes holds a breadcrumb index rather than codepoints */
 
 #define KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_ARGS 0x0001
 #define KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_KWS  0x0002
 #define KRK_OBJ_FLAGS_CODEOBJECT_IS_GENERATOR  0x0004
 #define KRK_OBJ_FLAGS_CODEOBJECT_IS_COROUTINE  0x0008
+#define KRK_OBJ_FLAGS_CODEOBJECT_QUICKENED     0x0400
+#define KRK_OBJ_FLAGS_CODEOBJECT_LINE_PROFILE  0x0800
+#define KRK_OBJ_FLAGS_CODEOBJECT_IMAGE         0x1000
+#define KRK_OBJ_FLAGS_CODEOBJECT_LAZY          0x2000
 
 #define KRK_OBJ_FLAGS_FUNCTION_MASK                0x0007
 #define KRK_OBJ_FLAGS_FUNCTION_IS_CLASS_METHOD     0x0001
@@ -62,11 +71,14 @@ typedef struct KrkObj {
 #define KRK_OBJ_FLAGS_FUNCTION_IS_DYNAMIC_PROPERTY 0x0004
 
 #define KRK_OBJ_FLAGS_NO_INHERIT    0x0200
+#define KRK_OBJ_FLAGS_CLASS_NO_FIELDS 0x0400 /**< Instances only have the attributes named in @c __slots__ */
 #define KRK_OBJ_FLAGS_SECOND_CHANCE 0x0100
 #define KRK_OBJ_FLAGS_IS_MARKED     0x0010
 #define KRK_OBJ_FLAGS_IN_REPR       0x0020
 #define KRK_OBJ_FLAGS_IMMORTAL      0x0040
 #define KRK_OBJ_FLAGS_VALID_HASH    0x0080
+#define KRK_OBJ_FLAGS_GC_OLD        0x4000 /**< Survived a collection; not scanned by minor collections */
+#define KRK_OBJ_FLAGS_GC_REMEMBERED 0x8000 /**< Old object in the remembered set */
 
 
 /**
@@ -97,9 +109,54 @@ typedef struct KrkString {
 	size_t length;       /**< @brief String length in bytes */
 	size_t codesLength;  /**< @brief String length in Unicode codepoints */
 	char * chars;        /**< @brief UTF8 canonical data */
-	void * codes;        /**< @brief Codepoint data */
+	void * codes;        /**< @brief Codepoint data; only valid after @ref krk_unicodeString */
 } KrkString;
 
+/**
+ * @brief Hash a sequence of bytes the same way strings are hashed.
+ *
+ * The hash is seeded randomly when the VM starts, unless the @c KUROKO_HASH_SEED
+ * environment variable sets a seed, so hashes should not be kept across runs.
+ *
+ * @param data   Bytes to hash.
+ * @param length Number of bytes.
+ * @return The hash.
+ */
+extern uint32_t krk_hashBytes(const void * data, size_t length);
+
+/**
+ * @brief Calculate and cache the hash of a string. Use @ref krk_stringHash instead.
+ * @memberof KrkString
+ */
+extern uint32_t krk_stringHashSlow(KrkString * string);
+
+/**
+ * @brief Obtain the hash of a string.
+ * @memberof KrkString
+ *
+ * Strings that are not interned don't have their hash calculated until
+ * something asks for it.
+ */
+static inline uint32_t krk_stringHash(KrkString * string) {
+	if (string->obj.flags & KRK_OBJ_FLAGS_VALID_HASH) return string->obj.hash;
+	return krk_stringHashSlow(string);
+}
+
+/**
+ * @brief Compare two strings for equality.
+ * @memberof KrkString
+ *
+ * Two interned strings are only equal if they are the same object; any
+ * other pair is compared by length, hash if both have one, and then contents.
+ */
+static inline int krk_stringsEqual(KrkString * a, KrkString * b) {
+	if (a == b) return 1;
+	if (a->obj.flags & b->obj.flags & KRK_OBJ_FLAGS_STRING_INTERNED) return 0;
+	if (a->length != b->length) return 0;
+	if ((a->obj.flags & b->obj.flags & KRK_OBJ_FLAGS_VALID_HASH) && a->obj.hash != b->obj.hash) return 0;
+	return !memcmp(a->chars, b->chars, a->length);
+}
+
 /**
  * @brief Immutable sequence of bytes.
  * @extends KrkObj
@@ -136,6 +193,42 @@ typedef struct {
 } KrkLocalEntry;
 
 struct KrkInstance;
+struct KrkClass;
+
+/**
+ * @brief Number of receiver classes remembered by each attribute lookup site.
+ */
+#define KRK_INLINE_CACHE_SIZE 2
+
+/**
+ * @brief Lookup cache for one property or global instruction.
+ *
+ * Property instructions remember the result of searching the methods tables
+ * of a class and its bases for a name. An entry is only valid while the class
+ * still has the version it had when the entry was filled in; see @ref krk_bumpClassVersion.
+ *
+ * OP_GET_GLOBAL remembers the table entry a name was found in, which stays
+ * valid until either the globals or builtins table adds, removes or moves an entry.
+ *
+ * Entries do not hold references and are not scanned by the garbage collector.
+ * Writers make @c sequence odd while they update an entry, and readers that
+ * see it odd or changed treat the cache as a miss.
+ */
+typedef struct KrkInlineCache {
+	size_t sequence;                  /**< @brief Bumped before and after every update */
+	union {
+		struct {
+			struct KrkClass * _class; /**< @brief Class the lookup started from */
+			size_t version;           /**< @brief @c version of @c _class at the time of the lookup */
+			KrkValue value;           /**< @brief Attribute that was found, or @c KWARGS_VAL(0) if there was none */
+		} entries[KRK_INLINE_CACHE_SIZE];
+		struct {
+			KrkTableEntry * entry;    /**< @brief Entry holding the value, in either the globals or builtins table */
+			size_t globalsVersion;    /**< @brief @c version of the globals table at the time of the lookup */
+			size_t builtinsVersion;   /**< @brief @c version of the builtins table at the time of the lookup */
+		} global;
+	} as;
+} KrkInlineCache;
 
 /**
  * @brief Code object.
@@ -160,6 +253,13 @@ typedef struct {
 	KrkLocalEntry * localNames;            /**< @brief Stores the names of local variables used in the function, for debugging */
 	struct KrkInstance * globalsContext;   /**< @brief The globals namespace the function should reference when called */
 	KrkString * qualname;                  /**< @brief The dotted name of the function */
+	KrkInlineCache * inlineCaches;         /**< @brief Lookup caches for property and global instructions, indexed by the constant holding the name */
+	struct KrkLineProfile * lineProfile;   /**< @brief Per-line hit counts and timings, when line profiling is enabled for this function */
+	struct KrkImage * image;               /**< @brief Bytecode image this function was loaded from, which owns its bytecode, line map and handler regions */
+	size_t imageIndex;                     /**< @brief Index of this function in @ref image */
+#ifdef KRK_OPCODE_STATS
+	size_t instructionCount;               /**< @brief Number of instructions executed in this code object */
+#endif
 } KrkCodeObject;
 
 
@@ -180,6 +280,26 @@ typedef struct {
 
 typedef void (*KrkCleanupCallback)(struct KrkInstance *);
 
+/**
+ * @brief Contiguous bytes held by an object, to be read or written in place.
+ *
+ * Filled in by @ref krk_getBuffer. The bytes belong to the object and are
+ * only good until it next runs managed code or is resized.
+ */
+typedef struct KrkBuffer {
+	uint8_t * bytes;  /**< @brief Start of the bytes */
+	size_t length;    /**< @brief Number of bytes */
+	int readonly;     /**< @brief Set when the bytes must not be written to */
+} KrkBuffer;
+
+/**
+ * @brief Exposes the bytes of an instance as a @ref KrkBuffer.
+ *
+ * Returns 1 on success; raises an exception and returns 0 when the instance
+ * has no bytes to expose, such as when it has been closed.
+ */
+typedef int (*KrkBufferCallback)(struct KrkInstance *, KrkBuffer *);
+
 /**
  * @brief Type object.
  * @extends KrkObj
@@ -195,9 +315,12 @@ typedef struct KrkClass {
 	struct KrkClass * base;   /**< @brief Pointer to base class implementation */
 	KrkTable methods;         /**< @brief General attributes table */
 	size_t allocSize;         /**< @brief Size to allocate when creating instances of this class */
-	KrkCleanupCallback _ongcscan;   /**< @brief C function to call when the garbage collector visits an instance of this class in the scan phase */
-	KrkCleanupCallback _ongcsweep;  /**< @brief C function to call when the garbage collector is discarding an instance of this class */
+	size_t slotsStart;        /**< @brief Offset of the first @c __slots__ value in instances, which run up to @ref allocSize; 0 if there are none */
+	KrkCleanupCallback _ongcscan;   /**< @brief C function to call when the garbage collector visits an instance of this class in the scan phase; may run on a collector helper thread */
+	KrkCleanupCallback _ongcsweep;  /**< @brief C function to call when the garbage collector is discarding an instance of this class; may run on a collector helper thread */
+	KrkBufferCallback _ongetbuffer; /**< @brief C function that exposes the bytes held by an instance of this class; see @ref krk_getBuffer */
 	KrkTable subclasses;      /**< @brief Set of classes that subclass this class */
+	size_t version;           /**< @brief Changes whenever the methods of this class or one of its bases change */
 
 	KrkObj * _getter;         /**< @brief @c %__getitem__  Called when an instance is subscripted */
 	KrkObj * _setter;         /**< @brief @c %__setitem__  Called when a subscripted instance is assigned to */
@@ -316,6 +439,37 @@ typedef struct {
 	KrkTable entries;  /**< @brief The actual table of values in the dict */
 } KrkDict;
 
+/**
+ * @brief Iterator over the values in a list.
+ * @extends KrkInstance
+ */
+struct ListIterator {
+	KrkInstance inst;
+	KrkValue l;
+	size_t i;
+};
+
+/**
+ * @brief Iterator over the values in a tuple.
+ * @extends KrkInstance
+ */
+struct TupleIter {
+	KrkInstance inst;
+	KrkValue myTuple;
+	int i;
+};
+
+/**
+ * @brief Iterator over the integers in a range.
+ * @extends KrkInstance
+ */
+struct RangeIterator {
+	KrkInstance inst;
+	krk_integer_type i;
+	krk_integer_type max;
+	krk_integer_type step;
+};
+
 /**
  * @extends KrkInstance
  */
@@ -323,6 +477,7 @@ struct DictItems {
 	KrkInstance inst;
 	KrkValue dict;
 	size_t i;
+	size_t version; /**< Version of the dict's table when iteration started */
 };
 
 /**
@@ -332,6 +487,7 @@ struct DictKeys {
 	KrkInstance inst;
 	KrkValue dict;
 	size_t i;
+	size_t version; /**< Version of the dict's table when iteration started */
 };
 
 /**
@@ -341,6 +497,7 @@ struct DictValues {
 	KrkInstance inst;
 	KrkValue dict;
 	size_t i;
+	size_t version; /**< Version of the dict's table when iteration started */
 };
 
 /**
@@ -354,6 +511,34 @@ struct KrkModule {
 #endif
 };
 
+/**
+ * @extends KrkInstance
+ * @brief A mutable array of bytes.
+ *
+ * Room is kept past the end of @c bytes so that appending is amortized.
+ */
+struct ByteArray {
+	KrkInstance inst;
+	uint8_t * bytes;  /**< @brief Heap storage, of @c capacity bytes */
+	size_t length;    /**< @brief Bytes in use */
+	size_t capacity;  /**< @brief Bytes allocated */
+};
+
+/**
+ * @extends KrkInstance
+ * @brief A view of part of the bytes of another object.
+ *
+ * The view finds the bytes of @c obj again each time it is used, so it stays
+ * good when a @ref ByteArray it looks at grows and moves its storage.
+ */
+struct MemoryView {
+	KrkInstance inst;
+	KrkValue obj;     /**< @brief Object whose bytes are viewed; None once released */
+	size_t offset;    /**< @brief Where the view starts in those bytes */
+	size_t length;    /**< @brief Bytes in the view */
+	int readonly;     /**< @brief Set if the view can not be written to */
+};
+
 /**
  * @extends KrkInstance
  */
@@ -397,7 +582,7 @@ extern KrkString * krk_takeString(char * chars, size_t length);
  * @param length Length of the C string.
  * @param codesLength Length of the expected resulting KrkString in codepoints.
  * @param type Compact type of the string, eg. UCS1, UCS2, UCS4... @see KrkStringType
- * @param hash Precalculated string hash.
+ * @param hash Precalculated string hash, from @ref krk_hashBytes.
  */
 extern KrkString * krk_takeStringVetted(char * chars, size_t length, size_t codesLength, KrkStringType type, uint32_t hash);
 
@@ -418,6 +603,52 @@ extern KrkString * krk_takeStringVetted(char * chars, size_t length, size_t code
  */
 extern KrkString * krk_copyString(const char * chars, size_t length);
 
+/**
+ * @brief Like @ref krk_takeString, but without adding the string to the string table.
+ * @memberof KrkString
+ *
+ * Strings built from runtime data - file contents, concatenations, formatted
+ * output - are rarely looked up again, and interning them costs a table probe
+ * under a global lock for each one. Uninterned strings still compare equal to
+ * interned strings with the same contents; use @ref krk_internString if one
+ * will be used repeatedly as an attribute name.
+ *
+ * @param chars  C string to take ownership of.
+ * @param length Length of the C string.
+ * @return A string object.
+ */
+extern KrkString * krk_takeStringUninterned(char * chars, size_t length);
+
+/**
+ * @brief Like @ref krk_copyString, but without adding the string to the string table.
+ * @memberof KrkString
+ *
+ * @param chars  C string to copy.
+ * @param length Length of the C string.
+ * @return A string object.
+ */
+extern KrkString * krk_copyStringUninterned(const char * chars, size_t length);
+
+/**
+ * @brief Like @ref krk_takeStringVetted, but without adding the string to the string table.
+ * @memberof KrkString
+ *
+ * No hash is needed, as the string's hash is calculated when it is first used.
+ */
+extern KrkString * krk_takeStringVettedUninterned(char * chars, size_t length, size_t codesLength, KrkStringType type);
+
+/**
+ * @brief Obtain the interned string equal to @p string.
+ * @memberof KrkString
+ *
+ * If @p string is not interned and no equal string is, @p string itself
+ * is added to the string table.
+ *
+ * @param string String to intern.
+ * @return The interned string with the same contents.
+ */
+extern KrkString * krk_internString(KrkString * string);
+
 /**
  * @brief Ensure that a codepoint representation of a string is available.
  * @memberof KrkString
@@ -450,6 +681,26 @@ extern void * krk_unicodeString(KrkString * string);
  */
 extern uint32_t krk_unicodeCodepoint(KrkString * string, size_t index);
 
+/**
+ * @brief Find where a codepoint starts in the UTF-8 data of a string.
+ * @memberof KrkString
+ *
+ * Unlike @ref krk_unicodeString, this does not build a codepoint array. Long
+ * non-ASCII strings are given a sparse index of the byte offset of every
+ * @ref KRK_STRING_BREADCRUMB_SPACING th codepoint instead, so lookups only
+ * have to walk a short distance through the UTF-8 data.
+ *
+ * @param string String to index into.
+ * @param index  Offset of the codepoint, up to and including @c codesLength
+ * @return Offset of the first byte of that codepoint in @c chars
+ */
+extern size_t krk_stringByteOffset(KrkString * string, size_t index);
+
+/**
+ * @brief Codepoints between entries in the breadcrumb index of a string.
+ */
+#define KRK_STRING_BREADCRUMB_SPACING 64
+
 /**
  * @brief Convert an integer codepoint to a UTF-8 byte representation.
  * @memberof KrkString
@@ -583,6 +834,20 @@ extern KrkTuple *       krk_newTuple(size_t length);
  */
 extern KrkBytes *       krk_newBytes(size_t length, uint8_t * source);
 
+/**
+ * @brief Get the bytes held by a bytes-like object.
+ *
+ * Works for @ref bytes, @ref bytearray, @c memoryview, and instances of any
+ * class with an @c _ongetbuffer callback, such as @c mmap. When @p writable
+ * is set, read-only buffers are refused.
+ *
+ * @param value    Object to find the bytes of
+ * @param buffer   Filled in with where the bytes are
+ * @param writable Whether the caller will write to the bytes
+ * @return 1 on success; 0 with an exception raised otherwise.
+ */
+extern int krk_getBuffer(KrkValue value, KrkBuffer * buffer, int writable);
+
 #define krk_isObjType(v,t) (IS_OBJECT(v) && (AS_OBJECT(v)->type == (t)))
 #define OBJECT_TYPE(value) (AS_OBJECT(value)->type)
 #define IS_STRING(value)   krk_isObjType(value, KRK_OBJ_STRING)
@@ -0,0 +1,131 @@
+#pragma once
+/**
+ * @file profiler.h
+ * @brief Sampling and line profilers.
+ *
+ * A timer periodically asks whichever thread is running managed code to
+ * snapshot its call frames at the next instruction boundary. Each
+ * snapshot is rendered as a collapsed stack (outermost frame first,
+ * frames separated by semicolons) and placed in a fixed-size ring buffer
+ * without taking any locks. Collecting the profile drains the buffer and
+ * counts identical stacks, producing output suitable for flame graph
+ * tools.
+ *
+ * If the ring buffer fills before it is collected, the oldest samples
+ * are discarded.
+ */
+#include <stdio.h>
+#include "vm.h"
+
+/**
+ * @brief Start sampling.
+ *
+ * @param interval Sampling interval, in microseconds of CPU time.
+ * @return 0 on success, or -1 if profiling is not available on this platform.
+ */
+extern int krk_profilerStart(long interval);
+
+/**
+ * @brief Stop sampling.
+ *
+ * Samples already taken remain in the ring buffer until collected.
+ */
+extern void krk_profilerStop(void);
+
+/**
+ * @brief Drain collected samples into a dict.
+ *
+ * @return A dict mapping collapsed stack strings to sample counts.
+ */
+extern KrkValue krk_profilerCollect(void);
+
+/**
+ * @brief Drain collected samples and write them as collapsed stacks.
+ *
+ * Writes one line per distinct stack, followed by its sample count.
+ *
+ * @param f Stream to write to.
+ */
+extern void krk_profilerWrite(FILE * f);
+
+/**
+ * @brief Record a sample of the current thread's call frames.
+ *
+ * Called by the VM when a sample has been requested for this thread.
+ * Internal method, should not generally be called.
+ */
+extern void krk_profilerSample(void);
+
+/**
+ * @brief Line hit counts and timings for a line-profiled code object.
+ *
+ * Indexed by line number, relative to @c firstLine. Time spent in other
+ * functions called from a line is attributed to that line.
+ */
+struct KrkLineProfile {
+	size_t firstLine;
+	size_t lineCount;
+	struct {
+		size_t hits;
+		uint64_t nanoseconds;
+	} lines[];
+};
+
+/**
+ * @brief Enable line profiling for a code object.
+ *
+ * Only instructions in code objects with line profiling enabled are
+ * timed; everything else runs at full speed.
+ *
+ * @param function Code object to profile.
+ */
+extern void krk_lineProfileEnable(KrkCodeObject * function);
+
+/**
+ * @brief Account for the instruction @p frame is about to execute.
+ *
+ * Called by the VM before each instruction in a line-profiled function.
+ * Internal method, should not generally be called.
+ */
+extern void krk_lineProfileHook(KrkCallFrame * frame);
+
+/**
+ * @brief Build a dict of line profiling results.
+ *
+ * @return A dict mapping line-profiled code objects to lists of
+ *         (line, hits, seconds) tuples, for lines that have been executed.
+ */
+extern KrkValue krk_lineProfileStats(void);
+
+#ifdef KRK_OPCODE_STATS
+/**
+ * @brief Execution counts for each opcode.
+ *
+ * Only available when built with @c KRK_OPCODE_STATS. Counters are updated
+ * without synchronization, so counts from concurrent threads are approximate.
+ */
+extern size_t krk_opcodeCounts[256];
+
+/**
+ * @brief Execution counts for each pair of consecutive opcodes, indexed by [first][second].
+ */
+extern size_t krk_opcodePairCounts[256][256];
+
+/**
+ * @brief Build a dict of instruction counters.
+ *
+ * The result has three entries: @c opcodes maps opcode names to counts,
+ * @c pairs maps tuples of two opcode names to counts, and @c functions
+ * maps code objects to the number of instructions executed in them.
+ * Only non-zero counters are included.
+ */
+extern KrkValue krk_opcodeStats(void);
+
+/**
+ * @brief Print instruction counters, most frequent first.
+ *
+ * @param f     Stream to write to.
+ * @param limit Maximum number of entries to print in each section.
+ */
+extern void krk_opcodeStatsWrite(FILE * f, size_t limit);
+#endif
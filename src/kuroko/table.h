@@ -24,11 +24,24 @@ typedef struct {
 
 /**
  * @brief Simple hash table of arbitrary keys to values.
+ *
+ * Entries are kept densely, in insertion order, in @ref entries. They are
+ * followed in the same allocation by the hash of each entry's key, so keys
+ * are only hashed once, and by the hash index that maps keys to positions
+ * in @ref entries. Each slot in the index is a signed 8, 16, 32, or 64-bit position,
+ * whichever is the smallest that fits, or -1 for an empty slot and -2 for
+ * one whose entry was deleted. Deleted entries, and entries past @ref used,
+ * have a @c KWARGS key, so code walking the table can loop over
+ * @ref capacity entries and skip those.
  */
 typedef struct {
 	size_t count;
-	size_t capacity;
+	size_t used;       /**< @brief Entries handed out so far, including deleted ones; new entries are added here */
+	size_t capacity;   /**< @brief Room in @ref entries; three quarters of the slots in the index */
+	size_t tombstones; /**< @brief Index slots left by deleted entries; they still count towards the load until the next resize */
 	KrkTableEntry * entries;
+	size_t version;    /**< @brief Bumped whenever an entry is added, removed or moved */
+	KrkObj * owner;    /**< @brief Object this table is embedded in, for the GC write barrier; NULL if none */
 } KrkTable;
 
 /**
@@ -37,7 +50,9 @@ typedef struct {
  *
  * This should be called for any new hash table, especially ones
  * initialized in heap or stack space, to set up the capacity, count
- * and initial entries pointer.
+ * and initial entries pointer. The owner is cleared; tables embedded
+ * in heap objects should set it afterwards so that storing young objects
+ * into them is seen by the garbage collector.
  *
  * @param table Hash table to initialize.
  */
@@ -48,6 +63,7 @@ extern void krk_initTable(KrkTable * table);
  * @memberof KrkTable
  *
  * Frees the entries array for the table and resets count and capacity.
+ * The owner is kept, so the table can be reused.
  *
  * @param table Hash table to release.
  */
@@ -59,7 +75,7 @@ extern void krk_freeTable(KrkTable * table);
  *
  * Copies each key-value pair from one hash table to another. If a key
  * from 'from' already exists in 'to', the existing value in 'to' will be
- * overwritten with the value from 'from'.
+ * overwritten with the value from 'from'. Keys are not hashed again.
  *
  * @param from Source table.
  * @param to   Destination table.
@@ -132,7 +148,8 @@ extern int krk_tableGet_fast(KrkTable * table, KrkString * str, KrkValue * value
  * @memberof KrkTable
  *
  * Scans the table 'table' for the key 'key' and, if found, removes
- * the entry, replacing it with a tombstone value.
+ * the entry. The entries after it are not moved, so the removed entry
+ * stays behind as a hole until the table is next resized.
  *
  * @param table Table to delete from.
  * @param key   Key to delete.
@@ -141,19 +158,29 @@ extern int krk_tableGet_fast(KrkTable * table, KrkString * str, KrkValue * value
 extern int krk_tableDelete(KrkTable * table, KrkValue key);
 
 /**
- * @brief Internal table scan function.
+ * @brief Find the entry for a key.
+ * @memberof KrkTable
+ *
+ * Scans the table 'table' for the key 'key' and returns a pointer to its
+ * entry, which stays valid until the table's version changes.
+ *
+ * @param table Table to scan.
+ * @param key   Key to locate.
+ * @return A pointer to the entry for 'key', or NULL if it is not present or can not be hashed.
+ */
+extern KrkTableEntry * krk_findEntry(KrkTable * table, KrkValue key);
+
+/**
+ * @brief Find the entry for a string key.
  * @memberof KrkTable
  *
- * Scans through the the entry array 'entries' to find the appropriate entry
- * for 'key', return a pointer to the entry, which may be or may not have
- * an associated pair.
+ * Same as krk_findEntry(), but only works for string keys, like krk_tableGet_fast().
  *
- * @param entries  Table entry array to scan.
- * @param capacity Size of the table entry array, in entries.
- * @param key      Key to locate.
- * @return A pointer to the entry for 'key'.
+ * @param table Table to scan.
+ * @param str   Key to locate.
+ * @return A pointer to the entry for 'str', or NULL if it is not present.
  */
-extern KrkTableEntry * krk_findEntry(KrkTableEntry * entries, size_t capacity, KrkValue key);
+extern KrkTableEntry * krk_findEntry_fast(KrkTable * table, KrkString * str);
 
 /**
  * @brief Calculate the hash for a value.
@@ -171,9 +198,10 @@ extern int krk_hashValue(KrkValue value, uint32_t *hashOut);
  * @brief Preset the size of a table.
  * @memberof KrkTable
  *
- * Reserves space for a large table.
+ * Reserves space for a large table. This also compacts the entries,
+ * dropping any that were deleted.
  *
  * @param table Table to resize.
- * @param capacity Target capacity.
+ * @param capacity Number of entries to make room for.
  */
 extern void krk_tableAdjustCapacity(KrkTable * table, size_t capacity);
@@ -57,16 +57,21 @@
 
 #define NOT_ENOUGH_ARGS(name) krk_runtimeError(vm.exceptions->argumentError, "Expected more args.")
 
+/* Type names are only pasted and quoted, so a class kept with KRK_VM_LOCAL may be named after its type. */
 #define CHECK_ARG(i, type, ctype, name) \
 	if (unlikely(argc < (i+1))) return NOT_ENOUGH_ARGS(name); \
-	if (unlikely(!IS_ ## type (argv[i]))) return TYPE_ERROR(type,argv[i]); \
+	if (unlikely(!IS_ ## type (argv[i]))) return krk_runtimeError(vm.exceptions->typeError, "%s() expects %s, not '%s'", \
+		_method_name, #type, krk_typeName(argv[i])); \
 	ctype name __attribute__((unused)) = AS_ ## type (argv[i])
 
 #define FUNC_NAME(klass, name) _ ## klass ## _ ## name
-#define FUNC_SIG(klass, name) _noexport KrkValue FUNC_NAME(klass,name) (int argc, const KrkValue argv[], int hasKw)
-#define KRK_METHOD(klass, name, ...) FUNC_SIG(klass, name) { \
+#define FUNC_SIG(klass, name) _noexport KrkValue _ ## klass ## _ ## name (int argc, const KrkValue argv[], int hasKw)
+#define KRK_METHOD(klass, name, ...) _noexport KrkValue _ ## klass ## _ ## name (int argc, const KrkValue argv[], int hasKw) { \
 	static __attribute__ ((unused)) const char* _method_name = # name; \
-	CHECK_ARG(0,klass,CURRENT_CTYPE,CURRENT_NAME); \
+	if (unlikely(argc < 1)) return NOT_ENOUGH_ARGS(name); \
+	if (unlikely(!IS_ ## klass (argv[0]))) return krk_runtimeError(vm.exceptions->typeError, "%s() expects %s, not '%s'", \
+		_method_name, #klass, krk_typeName(argv[0])); \
+	CURRENT_CTYPE CURRENT_NAME __attribute__((unused)) = AS_ ## klass (argv[0]); \
 	__VA_ARGS__ \
 	return NONE_VAL(); }
 
@@ -81,6 +86,81 @@
 #define BIND_PROP(klass,method) krk_defineNativeProperty(&klass->methods, #method, _ ## klass ## _ ## method)
 #define BIND_FUNC(module,func) krk_defineNative(&module->fields, #func, _krk_ ## func)
 
+/**
+ * @brief Description of the arguments of a native, for @ref krk_parseArgs.
+ *
+ * Declare one with @ref KRK_ARGS. Each VM interns the names the first time
+ * it parses with it and keeps them, so keyword arguments are then found
+ * by comparing pointers rather than by making and hashing strings.
+ */
+typedef struct {
+	const char * format;        /**< @brief What each argument is converted to */
+	const char * const * names; /**< @brief Name of each argument, for keywords and errors */
+	size_t count;               /**< @brief Number of @ref names */
+	KrkVMLocal key;             /**< @brief Finds the interned names in each VM */
+} KrkArgSpec;
+
+/**
+ * @brief Declare the static argument description @p spec.
+ *
+ * @p format is as for @ref krk_parseArgs, and is followed by the name of every
+ * argument in it, in order; @c * takes no name.
+ * @code
+ * KRK_ARGS(args, "*$zz", "sep", "end");
+ * @endcode
+ */
+#define KRK_ARGS(spec, format, ...) \
+	static const char * const spec ## _names[] = { __VA_ARGS__ }; \
+	static KrkArgSpec spec = { format, spec ## _names, sizeof(spec ## _names) / sizeof(const char *), 0 }
+
+/**
+ * @brief Convert the arguments of a native as described by a @ref KrkArgSpec.
+ *
+ * Each character of the format takes one argument, by position or keyword,
+ * and stores it through the next pointer or pointers passed:
+ *
+ * - @c O  any value, into a @c KrkValue
+ * - @c O! an instance of a class, which is passed as a @c KrkClass* before the output
+ * - @c i  an @c int (or @c bool), into a @c krk_integer_type
+ * - @c d  an @c int or @c float, into a @c double
+ * - @c p  whether any value is true, into an @c int
+ * - @c s  a @c str, into a @c const @c char*; @c s# also stores its length in bytes into a @c size_t
+ * - @c z  as @c s, but @c None as NULL (and a length of 0)
+ * - @c y  a @c bytes, into a @c const @c uint8_t*; @c y# also stores its length
+ *
+ * and these change how the ones after them are taken:
+ *
+ * - @c |  optional; the outputs of those that are not given are left as they are
+ * - @c $  keyword only
+ * - @c *  no name; the positional arguments left, as an @c int count and a @c const @c KrkValue*
+ *
+ * A leading @c . skips @c argv[0], for methods. Keyword arguments that are
+ * not named, and positional arguments that are left over, are errors.
+ *
+ * @return 1 on success, or 0 with an exception raised.
+ */
+extern int krk_parseArgs_impl(const char * method, int argc, const KrkValue argv[], int hasKw, KrkArgSpec * spec, ...);
+
+/**
+ * @def krk_parseArgs
+ * @brief Parse the arguments of the current native with @p spec, from @ref KRK_ARGS
+ * @see krk_parseArgs_impl
+ */
+#define krk_parseArgs(spec, ...) krk_parseArgs_impl(_method_name, argc, argv, hasKw, &spec, __VA_ARGS__)
+
+#ifdef ENABLE_THREADING
+struct timespec;
+
+/**
+ * @brief Turn a @c timeout argument into a deadline for the @c pthread timed waits.
+ *
+ * @param timeout A number of seconds, or @c None to wait forever.
+ * @param until   Set to the realtime clock @p timeout seconds from now.
+ * @return 1 for a number of seconds, 0 for @c None, or -1 with an exception raised.
+ */
+extern int krk_parseTimeout(KrkValue timeout, struct timespec * until);
+#endif
+
 /**
  * @brief Inline flexible string array.
  */
@@ -137,7 +217,7 @@ static inline void pushStringBuilderStr(struct StringBuilder * sb, const char *s
  * @return A value representing a string object.
  */
 static inline KrkValue finishStringBuilder(struct StringBuilder * sb) {
-	KrkValue out = OBJECT_VAL(krk_copyString(sb->bytes, sb->length));
+	KrkValue out = OBJECT_VAL(krk_copyStringUninterned(sb->bytes, sb->length));
 	FREE_ARRAY(char,sb->bytes, sb->capacity);
 	return out;
 }
@@ -213,6 +293,8 @@ static inline KrkValue discardStringBuilder(struct StringBuilder * sb) {
 
 #define IS_bytearray(o) (krk_isInstanceOf(o,vm.baseClasses->bytearrayClass))
 #define AS_bytearray(o) ((struct ByteArray*)AS_INSTANCE(o))
+#define IS_memoryview(o) (krk_isInstanceOf(o,vm.baseClasses->memoryviewClass))
+#define AS_memoryview(o) ((struct MemoryView*)AS_INSTANCE(o))
 
 #define IS_slice(o) krk_isInstanceOf(o,vm.baseClasses->sliceClass)
 #define AS_slice(o) ((struct KrkSlice*)AS_INSTANCE(o))
@@ -222,6 +304,17 @@ static inline KrkValue discardStringBuilder(struct StringBuilder * sb) {
 #endif
 
 extern KrkValue krk_dict_nth_key_fast(size_t capacity, KrkTableEntry * entries, size_t index);
+
+/**
+ * @brief Compare two values the way sorting does.
+ *
+ * Integers and floats are compared directly; anything else goes
+ * through the @c < operator.
+ *
+ * @return Whether @p a < @p b, or -1 if comparing them raised an exception.
+ */
+extern int krk_lessThan(KrkValue a, KrkValue b);
+
 extern KrkValue FUNC_NAME(str,__getitem__)(int,const KrkValue*,int);
 extern KrkValue FUNC_NAME(str,__int__)(int,const KrkValue*,int);
 extern KrkValue FUNC_NAME(str,__float__)(int,const KrkValue*,int);
@@ -274,6 +367,7 @@ extern KrkValue FUNC_NAME(str,format)(int,const KrkValue*,int);
 
 static inline void _setDoc_class(KrkClass * thing, const char * text, size_t size) {
 	thing->docstring = krk_copyString(text, size);
+	krk_gcWriteBarrier((KrkObj*)thing);
 }
 static inline void _setDoc_instance(KrkInstance * thing, const char * text, size_t size) {
 	krk_attachNamedObject(&thing->fields, "__doc__", (KrkObj*)krk_copyString(text, size));
@@ -80,6 +80,7 @@ typedef struct {
 	size_t capacity;   /**< Available allocated space. */
 	size_t count;      /**< Current number of used slots. */
 	KrkValue * values; /**< Pointer to heap-allocated storage. */
+	KrkObj * owner;    /**< Object this array is embedded in, for the GC write barrier; NULL if none. */
 } KrkValueArray;
 
 /**
@@ -88,7 +89,9 @@ typedef struct {
  *
  * This should be called for any new value array, especially ones
  * initialized in heap or stack space, to set up the capacity, count
- * and initial value pointer.
+ * and initial value pointer. The owner is cleared; arrays embedded in
+ * heap objects should set it afterwards so that storing young objects
+ * into them is seen by the garbage collector.
  *
  * @param array Value array to initialize.
  */
@@ -113,7 +116,7 @@ extern void krk_writeValueArray(KrkValueArray * array, KrkValue value);
  * Frees the storage associated with a given value array and resets
  * its capacity and count. Does not directly free resources associated
  * with heap objects referenced by the values in this array: The GC
- * is responsible for taking care of that.
+ * is responsible for taking care of that. The owner is kept.
  *
  * @param array Array to release.
  */
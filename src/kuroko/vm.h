@@ -49,7 +49,6 @@ typedef struct {
 	size_t slots;         /**< Offset into the stack at which this function call's arguments begin */
 	size_t outSlots;      /**< Offset into the stack at which stackTop will be reset upon return */
 	KrkTable * globals;   /**< Pointer to the attribute table containing valud global vairables for this call */
-	struct timespec in_time;
 } KrkCallFrame;
 
 /**
@@ -122,6 +121,9 @@ struct BaseClasses {
 	KrkClass * bytearrayClass;       /**< Mutable array of bytes */
 	KrkClass * dictvaluesClass;      /**< Iterator over values of a dict */
 	KrkClass * sliceClass;           /**< Slice object */
+	KrkClass * memberClass;          /**< Descriptor for one of the values named in a class's @c __slots__ */
+	KrkClass * memoryviewClass;      /**< View of the bytes of another object */
+	KrkClass * lazyModuleClass;      /**< Module bound by a lazy import that has not been loaded yet */
 };
 
 /**
@@ -136,8 +138,9 @@ struct BaseClasses {
 typedef struct KrkThreadState {
 	struct KrkThreadState * next; /**< Invasive list pointer to next thread. */
 
-	KrkCallFrame * frames;     /**< Call frame stack for this thread, max KRK_CALL_FRAMES_MAX */
+	KrkCallFrame * frames;     /**< Call frame stack for this thread, with room for vm.maximumCallDepth */
 	size_t frameCount;         /**< Number of active call frames. */
+	size_t frameSpace;         /**< Number of call frames reserved at @c frames. */
 	size_t stackSize;          /**< Size of the allocated stack space for this thread. */
 	KrkValue * stack;          /**< Pointer to the bottom of the stack for this thread. */
 	KrkValue * stackTop;       /**< Pointer to the top of the stack. */
@@ -150,6 +153,13 @@ typedef struct KrkThreadState {
 	KrkValue * stackMax;       /**< End of allocated stack space. */
 
 	KrkValue scratchSpace[KRK_THREAD_SCRATCH_SIZE]; /**< A place to store a few values to keep them from being prematurely GC'd. */
+	struct Compiler * compiler; /**< Innermost function being compiled on this thread, marked by the GC. */
+	int parked;                /**< Set while the thread is stopped for another thread's collection or waiting in a blocking call. */
+	KrkObj * objects;          /**< Objects this thread allocated since the collector last moved them to @c vm.objects */
+	KrkObj * objectsTail;      /**< Last object in @c objects */
+	ssize_t bytesAllocated;    /**< Bytes this thread allocated, less those it freed, not yet added to @c vm.bytesAllocated */
+	struct KrkVM * owner;      /**< The VM this thread runs in; threads that never changed it use @c krk_vm */
+	struct timespec * frameTimes; /**< Entry time of each call frame, only allocated once callgrind output is on. */
 } KrkThreadState;
 
 /**
@@ -159,6 +169,11 @@ typedef struct KrkThreadState {
  * path to the VM binary, global execution flags, the
  * string and module tables, tables of builtin types,
  * and the state of the (shared) garbage collector.
+ *
+ * A process normally has just the one in @c krk_vm, but more can be
+ * made with @ref krk_newVM. They share no objects, and each has its own
+ * heap and collector; every thread belongs to one of them, and @c vm is
+ * the one the current thread belongs to.
  */
 typedef struct KrkVM {
 	int globalFlags;                  /**< Global VM state flags */
@@ -172,16 +187,36 @@ typedef struct KrkVM {
 	struct Exceptions * exceptions;   /**< Pointer to a (static) namespacing struct for the KrkClass*'s of basic exception types */
 
 	/* Garbage collector state */
-	KrkObj * objects;                 /**< Linked list of all objects in the GC */
+	KrkObj * objects;                 /**< Linked list of all objects in the GC, except those still on their thread's own list */
+	KrkObj * survivors;               /**< First young object in @c objects that has survived a minor collection */
 	size_t bytesAllocated;            /**< Running total of bytes allocated */
 	size_t nextGC;                    /**< Point at which we should sweep again */
+	size_t nextMinorGC;               /**< Point at which we should sweep young objects again */
+	size_t nurserySize;               /**< Bytes to allocate between minor collections */
+	double heapGrowth;                /**< Factor the heap may grow by between full collections */
+	size_t minHeap;                   /**< Heap size below which full collections are not started */
+	size_t maxHeapGrowth;             /**< Most bytes the heap may grow by between full collections */
+	size_t nextGCStep;                /**< Point at which an incremental collection should continue */
+	size_t gcStepBudget;              /**< Microseconds an incremental collection step may take, or 0 to collect all at once */
+	size_t gcThreads;                 /**< Threads that mark and free objects during a collection, including the one collecting */
 	size_t grayCount;                 /**< Count of objects marked by scan. */
 	size_t grayCapacity;              /**< How many objects we can fit in the scan list. */
 	KrkObj** grayStack;               /**< Scan list */
+	size_t rememberedCount;           /**< Count of old objects written to since the last collection. */
+	size_t rememberedCapacity;        /**< How many objects we can fit in the remembered set. */
+	KrkObj** remembered;              /**< Old objects that may reference young objects */
 
 	KrkThreadState * threads;         /**< Invasive linked list of all VM threads. */
+	volatile int safepointRequested;  /**< Set when every thread should stop at its next safepoint so one of them can collect. */
 	FILE * callgrindFile;             /**< File to write unprocessed callgrind data to. */
 	size_t maximumCallDepth;          /**< Maximum recursive call depth. */
+	size_t classVersion;              /**< Last version tag handed out to a class. */
+	struct KrkGCState * gc;           /**< Collector state private to memory.c */
+	uint64_t * locals;                /**< Values of C globals declared with @ref KRK_VM_LOCAL */
+	volatile int stringLock;          /**< Held while the strings table is changed */
+	volatile int codeLock;            /**< Held while a lazy code object is published or a code object is quickened */
+	struct KrkArgNames * argNames;    /**< Keyword names interned for krk_parseArgs */
+	KrkTable importDirs;              /**< Listings of module search directories, by path */
 } KrkVM;
 
 /* Thread-specific flags */
@@ -192,6 +227,11 @@ typedef struct KrkVM {
 #define KRK_THREAD_SINGLE_STEP         (1 << 4)
 #define KRK_THREAD_SIGNALLED           (1 << 5)
 #define KRK_THREAD_DEFER_STACK_FREE    (1 << 6)
+#define KRK_THREAD_PROFILE_SAMPLE      (1 << 7)
+/* Set by the VM while the current frame belongs to a line-profiled function; not inherited from global flags. */
+#define KRK_THREAD_LINE_PROFILE        (1 << 16)
+/* Set on the thread that collected garbage, so it calls gc.callbacks at the next instruction. */
+#define KRK_THREAD_GC_CALLBACKS        (1 << 17)
 
 /* Global flags */
 #define KRK_GLOBAL_ENABLE_STRESS_GC    (1 << 8)
@@ -200,6 +240,9 @@ typedef struct KrkVM {
 #define KRK_GLOBAL_CALLGRIND           (1 << 11)
 #define KRK_GLOBAL_REPORT_GC_COLLECTS  (1 << 12)
 #define KRK_GLOBAL_THREADS             (1 << 13)
+#define KRK_GLOBAL_OPTIMIZE            (1 << 14)
+#define KRK_GLOBAL_NO_WRITE_BYTECODE   (1 << 15)
+#define KRK_GLOBAL_LAZY_IMPORTS        (1 << 18)
 
 #ifdef ENABLE_THREADING
 #  define threadLocal __thread
@@ -228,15 +271,48 @@ extern threadLocal KrkThreadState krk_currentThread;
 #endif
 
 /**
- * @brief Singleton instance of the shared VM state.
+ * @brief The VM of threads that were not given another one.
  */
 extern KrkVM krk_vm;
 
 /**
  * @def vm
- * @brief Convenience macro for namespacing.
+ * @brief The VM the current thread belongs to.
+ */
+#define vm (*krk_currentThread.owner)
+
+/**
+ * @brief Number of values each VM keeps for @ref KRK_VM_LOCAL globals.
+ */
+#define KRK_VM_LOCALS 256
+
+/**
+ * @brief Key to a C global that has a separate value in each VM.
+ *
+ * Declare one as a zero-initialized static and access the value
+ * through @ref KRK_VM_LOCAL; the first VM to use it picks a slot, which
+ * every VM then uses for it. Values start out zeroed.
  */
-#define vm krk_vm
+typedef size_t KrkVMLocal;
+
+/**
+ * @brief Pick the slot for a VM-local global.
+ *
+ * Called by @ref KRK_VM_LOCAL the first time @p key is used.
+ */
+extern size_t krk_vmLocalSlot(KrkVMLocal * key);
+
+/**
+ * @def KRK_VM_LOCAL
+ * @brief The current VM's value of a C global, as an lvalue of @p type.
+ *
+ * @p type must be no larger than 64 bits. A class a module keeps may be declared as:
+ * @code
+ * static KrkVMLocal fooKey;
+ * #define FooClass KRK_VM_LOCAL(KrkClass*,fooKey)
+ * @endcode
+ */
+#define KRK_VM_LOCAL(type,key) (*(type*)krk_vmLocal(&key))
 
 /**
  * @brief Initialize the VM at program startup.
@@ -261,9 +337,28 @@ extern void krk_initVM(int flags);
  * call to krk_initVM is made. The resources released here can include allocated
  * heap memory, FILE pointers or descriptors, or various other things which were
  * initialized by C extension modules.
+ *
+ * This releases the VM of the calling thread. A VM made by @ref krk_newVM is
+ * freed along with it, and the thread goes back to using @c krk_vm.
  */
 extern void krk_freeVM(void);
 
+/**
+ * @brief Create a separate VM and make it the calling thread's.
+ * @memberof KrkVM
+ *
+ * The new VM is initialized as by @ref krk_initVM and shares no objects with
+ * any other; values can only be passed between VMs by copying them. The calling
+ * thread must not be running in another VM, and threads it starts from
+ * managed code belong to the new one. Release it with @ref krk_freeVM from
+ * the same thread.
+ *
+ * @param flags   Combination of global VM flags and initial thread flags.
+ * @param binpath Path to the interpreter binary, as for @c vm.binpath, or NULL.
+ * @return The new VM, which is also @c vm on the calling thread.
+ */
+extern KrkVM * krk_newVM(int flags, const char * binpath);
+
 /**
  * @brief Reset the current thread's stack state to the top level.
  *
@@ -295,6 +390,17 @@ extern void krk_resetStack(void);
  */
 extern KrkValue krk_interpret(const char * src, char * fromFile);
 
+/**
+ * @brief Run a compiled top-level code object in the current module.
+ *
+ * This is the second half of @c krk_interpret, for code that was compiled
+ * ahead of time or loaded from a bytecode image.
+ *
+ * @param function Top-level code object to run.
+ * @return As with @c krk_interpret.
+ */
+extern KrkValue krk_runCodeObject(KrkCodeObject * function);
+
 /**
  * @brief Load and run a source file and return when execution completes.
  *
@@ -468,6 +574,16 @@ extern KrkValue krk_runtimeError(KrkClass * type, const char * fmt, ...)
  */
 extern KrkThreadState * krk_getCurrentThread(void);
 
+/**
+ * @brief Address of the current VM's value of a VM-local global.
+ * @see KRK_VM_LOCAL
+ */
+static inline void * krk_vmLocal(KrkVMLocal * key) {
+	size_t slot = __atomic_load_n(key, __ATOMIC_ACQUIRE);
+	if (__builtin_expect(!slot,0)) slot = krk_vmLocalSlot(key);
+	return &vm.locals[slot];
+}
+
 /**
  * @brief Continue VM execution until the next exit trigger.
  *
@@ -643,6 +759,19 @@ extern KrkClass * krk_makeClass(KrkInstance * module, KrkClass ** _class, const
  */
 extern void krk_finalizeClass(KrkClass * _class);
 
+/**
+ * @brief Invalidate cached attribute lookups for a class.
+ * @memberof KrkClass
+ *
+ * Assigns a new version tag to the class and all of its subclasses so that
+ * inline caches in property instructions look up attributes again. Should
+ * be called whenever the @c methods table of a class is modified after it
+ * has been used; @ref krk_finalizeClass calls this automatically.
+ *
+ * @param _class Class object that was modified.
+ */
+extern void krk_bumpClassVersion(KrkClass * _class);
+
 /**
  * @brief If there is an active exception, print a traceback to @c stderr
  *
@@ -0,0 +1,1000 @@
+/**
+ * @file marshal.c
+ * @brief Binary serialization of compiled code objects.
+ *
+ * Images are laid out to be used where they sit in memory, typically a private
+ * mapping of a .kbc file. The header is followed by tables of offsets to every
+ * string and every code object in the image. Each code object's bytecode, line
+ * map and handler regions are stored aligned and in the VM's own layout, so the
+ * loaded code object points straight at them instead of copying them.
+ *
+ * Loading an image only builds a shell for its top-level code object: names,
+ * arguments and pointers into the image. The constants and local names of a
+ * code object - and with them the shells of the functions defined inside it -
+ * are built the first time it is called, so the cost of a module grows with
+ * the functions that are actually used rather than the ones it contains.
+ *
+ * Values are stored in host byte order.
+ */
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include <kuroko/vm.h>
+#include <kuroko/memory.h>
+#include <kuroko/compiler.h>
+#include <kuroko/marshal.h>
+#include <kuroko/util.h>
+#include <kuroko/threads.h>
+
+#define MARSHAL_OPTIMIZED 0x0001
+
+/* Flags that come from the compiler; the rest are runtime state. */
+#define CODEOBJECT_MARSHAL_FLAGS (KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_ARGS | KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_KWS | \
+	KRK_OBJ_FLAGS_CODEOBJECT_IS_GENERATOR | KRK_OBJ_FLAGS_CODEOBJECT_IS_COROUTINE)
+
+struct MarshalHeader {
+	uint8_t  magic[4];   /* K R K B */
+	uint8_t  version[4]; /* 1 0 1 4 */
+	uint32_t checksum;   /* Opcode table and in-place structure layouts */
+	uint32_t flags;
+	uint64_t sourceTime;
+	uint64_t sourceSize;
+	uint32_t stringCount;
+	uint32_t functionCount;
+	/* uint32_t stringOffsets[stringCount]; */
+	/* uint32_t functionOffsets[functionCount]; */
+} __attribute__((packed));
+
+/* Offsets are from the start of the image. Argument name indexes follow the header. */
+struct FunctionHeader {
+	uint32_t nameInd;
+	uint32_t docInd;
+	uint32_t qualInd;
+	uint16_t reqArgs;
+	uint16_t kwArgs;
+	uint16_t upvalues;
+	uint8_t  flags;
+	uint8_t  reserved;
+	uint32_t locals;
+	uint32_t bcSize;
+	uint32_t lmSize;
+	uint32_t ctSize;
+	uint32_t hrSize;
+	uint32_t codeOffset;
+	uint32_t linesOffset;    /* KrkLineMap[lmSize] */
+	uint32_t handlersOffset; /* KrkHandlerRegion[hrSize] */
+	uint32_t localsOffset;   /* struct LocalEntry[locals] */
+	uint32_t constantsOffset;
+} __attribute__((packed));
+
+struct LocalEntry {
+	uint32_t id;
+	uint32_t birthday;
+	uint32_t deathday;
+	uint32_t nameInd;
+} __attribute__((packed));
+
+#define NO_STRING UINT32_MAX
+#define IMAGE_ALIGN 8
+
+/**
+ * @brief A loaded image.
+ *
+ * Code objects loaded from an image point into it, and the image is
+ * never released; like shared object modules, it stays mapped for the
+ * rest of the process.
+ */
+struct KrkImage {
+	uint8_t * data;
+	size_t size;
+	uint32_t stringCount;
+	uint32_t functionCount;
+};
+
+/*
+ * Startup images bundle the images of several modules into one file,
+ * together with the module names and source paths they were built from.
+ */
+struct StartupHeader {
+	uint8_t  magic[4];   /* K R K S */
+	uint8_t  version[4]; /* 1 0 1 4 */
+	uint32_t count;
+	uint32_t tableOffset;
+} __attribute__((packed));
+
+/* Followed by the module name and then the source path, neither terminated. */
+struct StartupEntry {
+	uint32_t nameLength;
+	uint32_t fileLength;
+	uint32_t flags;
+	uint32_t dataOffset;
+	uint32_t dataSize;
+} __attribute__((packed));
+
+#define STARTUP_PACKAGE 0x0001
+
+struct StartupModule {
+	char * name;     /* With PATH_SEP between components */
+	char * fileName;
+	int isPackage;
+	int state;       /* 0 until the source has been checked, then 1 if the image is current or -1 if not */
+	uint8_t * data;
+	size_t size;
+};
+
+static struct StartupModule * startupModules = NULL;
+static size_t startupModuleCount = 0;
+
+/**
+ * Images are only valid for the opcode numbering they were written with,
+ * so rather than relying on someone remembering to bump the format version
+ * whenever opcodes.h changes, the header carries a checksum of it. The sizes
+ * of the structures that are used in place are mixed in as well.
+ */
+static uint32_t formatChecksum(void) {
+#define SIMPLE(opc) { #opc, opc },
+#define CONSTANT(opc,more) { #opc, opc }, { #opc "_LONG", opc ## _LONG },
+#define OPERANDB(opc,more) { #opc, opc },
+#define OPERAND(opc,more) { #opc, opc }, { #opc "_LONG", opc ## _LONG },
+#define JUMP(opc,sign) { #opc, opc },
+	static const struct { const char * name; uint8_t opcode; } opcodes[] = {
+#include "opcodes.h"
+	};
+#undef SIMPLE
+#undef CONSTANT
+#undef OPERANDB
+#undef OPERAND
+#undef JUMP
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < sizeof(opcodes) / sizeof(*opcodes); ++i) {
+		for (const char * c = opcodes[i].name; *c; ++c) hash = (hash ^ (uint8_t)*c) * 16777619u;
+		hash = (hash ^ opcodes[i].opcode) * 16777619u;
+	}
+	hash = (hash ^ sizeof(KrkLineMap)) * 16777619u;
+	hash = (hash ^ sizeof(KrkHandlerRegion)) * 16777619u;
+	return hash;
+}
+
+int krk_sourceStamp(const char * fileName, KrkSourceStamp * stamp) {
+	struct stat statbuf;
+	if (stat(fileName, &statbuf) != 0) return -1;
+#if defined(__APPLE__)
+	stamp->mtime = (uint64_t)statbuf.st_mtimespec.tv_sec * 1000000000 + statbuf.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+	stamp->mtime = (uint64_t)statbuf.st_mtim.tv_sec * 1000000000 + statbuf.st_mtim.tv_nsec;
+#else
+	stamp->mtime = (uint64_t)statbuf.st_mtime * 1000000000;
+#endif
+	stamp->size = statbuf.st_size;
+	return 0;
+}
+
+/* Images are assembled in memory so offsets can be filled in after the fact. */
+struct Buffer {
+	uint8_t * data;
+	size_t size;
+	size_t capacity;
+};
+
+static size_t put(struct Buffer * buffer, const void * data, size_t size) {
+	if (buffer->size + size > buffer->capacity) {
+		while (buffer->size + size > buffer->capacity) buffer->capacity = GROW_CAPACITY(buffer->capacity);
+		buffer->data = realloc(buffer->data, buffer->capacity);
+	}
+	size_t offset = buffer->size;
+	if (data) memcpy(&buffer->data[offset], data, size);
+	else memset(&buffer->data[offset], 0, size);
+	buffer->size += size;
+	return offset;
+}
+
+static size_t align(struct Buffer * buffer) {
+	if (buffer->size % IMAGE_ALIGN) put(buffer, NULL, IMAGE_ALIGN - buffer->size % IMAGE_ALIGN);
+	return buffer->size;
+}
+
+struct MarshalState {
+	struct Buffer out;
+	KrkValueArray functions;
+	KrkValueArray strings;
+	KrkTable stringIndexes;
+};
+
+static uint32_t stringIndex(struct MarshalState * state, KrkString * str) {
+	KrkValue index;
+	if (krk_tableGet_fast(&state->stringIndexes, str, &index)) return AS_INTEGER(index);
+	krk_tableSet(&state->stringIndexes, OBJECT_VAL(str), INTEGER_VAL(state->strings.count));
+	krk_writeValueArray(&state->strings, OBJECT_VAL(str));
+	return state->strings.count - 1;
+}
+
+static uint32_t functionIndex(struct MarshalState * state, KrkCodeObject * function) {
+	for (size_t i = 0; i < state->functions.count; ++i) {
+		if (AS_OBJECT(state->functions.values[i]) == (KrkObj*)function) return i;
+	}
+	krk_writeValueArray(&state->functions, OBJECT_VAL(function));
+	return state->functions.count - 1;
+}
+
+static size_t argumentNameCount(KrkCodeObject * function, int keyword) {
+	if (keyword) return function->keywordArgs + !!(function->obj.flags & KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_KWS);
+	return function->requiredArgs + !!(function->obj.flags & KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_ARGS);
+}
+
+/* Assign indexes to every function and string before anything is written. */
+static int collect(struct MarshalState * state) {
+	for (size_t f = 0; f < state->functions.count; ++f) {
+		KrkCodeObject * function = AS_codeobject(state->functions.values[f]);
+		if (!krk_materializeCodeObject(function)) return 1;
+		if (function->name) stringIndex(state, function->name);
+		if (function->docstring) stringIndex(state, function->docstring);
+		if (function->qualname) stringIndex(state, function->qualname);
+		for (size_t i = 0; i < argumentNameCount(function, 0); ++i) stringIndex(state, AS_STRING(function->requiredArgNames.values[i]));
+		for (size_t i = 0; i < argumentNameCount(function, 1); ++i) stringIndex(state, AS_STRING(function->keywordArgNames.values[i]));
+		for (size_t i = 0; i < function->localNameCount; ++i) stringIndex(state, function->localNames[i].name);
+		for (size_t i = 0; i < function->chunk.constants.count; ++i) {
+			KrkValue value = function->chunk.constants.values[i];
+			if (IS_STRING(value)) stringIndex(state, AS_STRING(value));
+			else if (IS_codeobject(value)) functionIndex(state, AS_codeobject(value));
+		}
+	}
+	return 0;
+}
+
+static void writeReference(struct MarshalState * state, char shortForm, char longForm, uint32_t index) {
+	if (index < 256) {
+		put(&state->out, (uint8_t[]){shortForm,index}, 2);
+	} else {
+		put(&state->out, &longForm, 1);
+		put(&state->out, &index, sizeof(uint32_t));
+	}
+}
+
+static int writeConstant(struct MarshalState * state, KrkValue value) {
+	struct Buffer * out = &state->out;
+	if (IS_KWARGS(value)) {
+		put(out, "k", 1);
+	} else if (IS_INTEGER(value)) {
+		int64_t i = AS_INTEGER(value);
+		if (i >= 0 && i < 256) {
+			put(out, (uint8_t[]){'i',i}, 2);
+		} else {
+			put(out, "I", 1);
+			put(out, &i, sizeof(int64_t));
+		}
+	} else if (IS_FLOATING(value)) {
+		double d = AS_FLOATING(value);
+		put(out, "d", 1);
+		put(out, &d, sizeof(double));
+	} else if (IS_STRING(value)) {
+		writeReference(state, 's', 'S', stringIndex(state, AS_STRING(value)));
+	} else if (IS_BYTES(value)) {
+		uint32_t length = AS_BYTES(value)->length;
+		put(out, "B", 1);
+		put(out, &length, sizeof(uint32_t));
+		put(out, AS_BYTES(value)->bytes, length);
+	} else if (IS_codeobject(value)) {
+		writeReference(state, 'f', 'F', functionIndex(state, AS_codeobject(value)));
+	} else {
+		return 1;
+	}
+	return 0;
+}
+
+static int writeFunction(struct MarshalState * state, KrkCodeObject * function) {
+	struct Buffer * out = &state->out;
+	struct FunctionHeader header = {
+		function->name ? stringIndex(state, function->name) : NO_STRING,
+		function->docstring ? stringIndex(state, function->docstring) : NO_STRING,
+		function->qualname ? stringIndex(state, function->qualname) : NO_STRING,
+		function->requiredArgs,
+		function->keywordArgs,
+		function->upvalueCount,
+		function->obj.flags & CODEOBJECT_MARSHAL_FLAGS,
+		0,
+		function->localNameCount,
+		function->chunk.count,
+		function->chunk.linesCount,
+		function->chunk.constants.count,
+		function->chunk.handlersCount,
+		0, 0, 0, 0, 0,
+	};
+	size_t headerOffset = put(out, NULL, sizeof(header));
+
+	for (size_t i = 0; i < argumentNameCount(function, 0); ++i) {
+		uint32_t ind = stringIndex(state, AS_STRING(function->requiredArgNames.values[i]));
+		put(out, &ind, sizeof(uint32_t));
+	}
+	for (size_t i = 0; i < argumentNameCount(function, 1); ++i) {
+		uint32_t ind = stringIndex(state, AS_STRING(function->keywordArgNames.values[i]));
+		put(out, &ind, sizeof(uint32_t));
+	}
+
+	header.codeOffset = put(out, function->chunk.code, function->chunk.count);
+	header.linesOffset = align(out);
+	put(out, function->chunk.lines, sizeof(KrkLineMap) * function->chunk.linesCount);
+	header.handlersOffset = align(out);
+	put(out, function->chunk.handlers, sizeof(KrkHandlerRegion) * function->chunk.handlersCount);
+
+	header.localsOffset = out->size;
+	for (size_t i = 0; i < function->localNameCount; ++i) {
+		struct LocalEntry entry = {
+			function->localNames[i].id,
+			function->localNames[i].birthday,
+			function->localNames[i].deathday,
+			stringIndex(state, function->localNames[i].name),
+		};
+		put(out, &entry, sizeof(entry));
+	}
+
+	header.constantsOffset = out->size;
+	for (size_t i = 0; i < function->chunk.constants.count; ++i) {
+		if (writeConstant(state, function->chunk.constants.values[i])) return 1;
+	}
+
+	memcpy(&out->data[headerOffset], &header, sizeof(header));
+	return 0;
+}
+
+int krk_marshal(FILE * out, KrkCodeObject * function, const KrkSourceStamp * source) {
+	struct MarshalState state;
+	memset(&state, 0, sizeof(state));
+	krk_initValueArray(&state.functions);
+	krk_initValueArray(&state.strings);
+	krk_initTable(&state.stringIndexes);
+
+	/* Everything collected is reachable from the function, which the caller keeps alive. */
+	krk_writeValueArray(&state.functions, OBJECT_VAL(function));
+	int failed = collect(&state);
+
+	struct MarshalHeader header = {
+		{'K','R','K','B'},
+		{'1','0','1','4'},
+		formatChecksum(),
+		(vm.globalFlags & KRK_GLOBAL_OPTIMIZE) ? MARSHAL_OPTIMIZED : 0,
+		source ? source->mtime : 0,
+		source ? source->size : 0,
+		state.strings.count,
+		state.functions.count,
+	};
+	put(&state.out, &header, sizeof(header));
+	size_t stringTable = put(&state.out, NULL, sizeof(uint32_t) * state.strings.count);
+	size_t functionTable = put(&state.out, NULL, sizeof(uint32_t) * state.functions.count);
+
+	for (size_t i = 0; !failed && i < state.strings.count; ++i) {
+		uint32_t length = AS_STRING(state.strings.values[i])->length;
+		uint32_t offset = put(&state.out, &length, sizeof(uint32_t));
+		put(&state.out, AS_CSTRING(state.strings.values[i]), length);
+		memcpy(&state.out.data[stringTable + sizeof(uint32_t) * i], &offset, sizeof(uint32_t));
+	}
+
+	/* collect() already found every string and function, so the tables above are complete. */
+	for (size_t i = 0; !failed && i < state.functions.count; ++i) {
+		uint32_t offset = align(&state.out);
+		memcpy(&state.out.data[functionTable + sizeof(uint32_t) * i], &offset, sizeof(uint32_t));
+		failed = writeFunction(&state, AS_codeobject(state.functions.values[i]));
+	}
+
+	if (!failed && state.out.size > UINT32_MAX) failed = 1;
+	if (!failed && fwrite(state.out.data, 1, state.out.size, out) != state.out.size) failed = 1;
+
+	free(state.out.data);
+	krk_freeTable(&state.stringIndexes);
+	krk_freeValueArray(&state.strings);
+	krk_freeValueArray(&state.functions);
+
+	return failed ? -1 : 0;
+}
+
+int krk_marshalValid(const uint8_t * data, size_t size, const KrkSourceStamp * source) {
+	struct MarshalHeader header;
+	if (size < sizeof(header)) return 0;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, (uint8_t[]){'K','R','K','B'}, 4) != 0) return 0;
+	if (memcmp(header.version, (uint8_t[]){'1','0','1','4'}, 4) != 0) return 0;
+	if (header.checksum != formatChecksum()) return 0;
+	if (source) {
+		if (header.sourceTime != source->mtime || header.sourceSize != source->size) return 0;
+		if (!!(header.flags & MARSHAL_OPTIMIZED) != !!(vm.globalFlags & KRK_GLOBAL_OPTIMIZE)) return 0;
+	}
+	return 1;
+}
+
+/* Pointer to @p size bytes at @p offset, or NULL if that runs off the end of the image. */
+static void * at(struct KrkImage * image, size_t offset, size_t size) {
+	if (offset > image->size || size > image->size - offset) return NULL;
+	return &image->data[offset];
+}
+
+static int readU32(struct KrkImage * image, size_t offset, uint32_t * out) {
+	void * ptr = at(image, offset, sizeof(uint32_t));
+	if (!ptr) return 1;
+	memcpy(out, ptr, sizeof(uint32_t));
+	return 0;
+}
+
+static KrkString * imageString(struct KrkImage * image, uint32_t index) {
+	uint32_t offset, length;
+	if (index >= image->stringCount) return NULL;
+	if (readU32(image, sizeof(struct MarshalHeader) + sizeof(uint32_t) * index, &offset)) return NULL;
+	if (readU32(image, offset, &length)) return NULL;
+	const char * chars = at(image, (size_t)offset + sizeof(uint32_t), length);
+	if (!chars) return NULL;
+	return krk_copyString(chars, length);
+}
+
+static int functionHeader(struct KrkImage * image, size_t index, struct FunctionHeader * header, uint32_t * offset) {
+	if (index >= image->functionCount) return 1;
+	if (readU32(image, sizeof(struct MarshalHeader) + sizeof(uint32_t) * (image->stringCount + index), offset)) return 1;
+	void * ptr = at(image, *offset, sizeof(struct FunctionHeader));
+	if (!ptr) return 1;
+	memcpy(header, ptr, sizeof(struct FunctionHeader));
+	return 0;
+}
+
+static int aligned(const void * ptr) {
+	return ((uintptr_t)ptr % IMAGE_ALIGN) == 0;
+}
+
+/* Build the part of a code object that someone may look at before calling it. */
+static KrkCodeObject * loadShell(struct KrkImage * image, size_t index, KrkString * filename, KrkInstance * globals) {
+	struct FunctionHeader header;
+	uint32_t offset;
+	if (functionHeader(image, index, &header, &offset)) return NULL;
+
+	KrkCodeObject * self = krk_newCodeObject();
+	krk_push(OBJECT_VAL(self));
+	self->obj.flags |= KRK_OBJ_FLAGS_CODEOBJECT_IMAGE | KRK_OBJ_FLAGS_CODEOBJECT_LAZY | (header.flags & CODEOBJECT_MARSHAL_FLAGS);
+	self->image = image;
+	self->imageIndex = index;
+	self->globalsContext = globals;
+	self->chunk.filename = filename;
+	self->requiredArgs = header.reqArgs;
+	self->keywordArgs = header.kwArgs;
+	self->upvalueCount = header.upvalues;
+	self->potentialPositionals = self->requiredArgs + self->keywordArgs;
+	self->totalArguments = self->potentialPositionals + !!(self->obj.flags & KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_ARGS) + !!(self->obj.flags & KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_KWS);
+
+	/* Each string may trigger a collection that promotes this code object. */
+	if (header.nameInd != NO_STRING && !(self->name = imageString(image, header.nameInd))) goto _corrupt;
+	krk_gcWriteBarrier((KrkObj*)self);
+	if (header.docInd != NO_STRING && !(self->docstring = imageString(image, header.docInd))) goto _corrupt;
+	krk_gcWriteBarrier((KrkObj*)self);
+	if (header.qualInd != NO_STRING && !(self->qualname = imageString(image, header.qualInd))) goto _corrupt;
+	krk_gcWriteBarrier((KrkObj*)self);
+	if (!self->name) self->name = S("__main__");
+	krk_gcWriteBarrier((KrkObj*)self);
+
+	size_t argOffset = offset + sizeof(struct FunctionHeader);
+	for (int keyword = 0; keyword < 2; ++keyword) {
+		KrkValueArray * names = keyword ? &self->keywordArgNames : &self->requiredArgNames;
+		for (size_t i = 0; i < argumentNameCount(self, keyword); ++i, argOffset += sizeof(uint32_t)) {
+			uint32_t ind;
+			KrkString * name;
+			if (readU32(image, argOffset, &ind) || !(name = imageString(image, ind))) goto _corrupt;
+			krk_push(OBJECT_VAL(name));
+			krk_writeValueArray(names, OBJECT_VAL(name));
+			krk_pop();
+		}
+	}
+
+	/* Used in place; capacities stay at zero since the image owns this memory. */
+	self->chunk.code = at(image, header.codeOffset, header.bcSize);
+	self->chunk.lines = at(image, header.linesOffset, sizeof(KrkLineMap) * header.lmSize);
+	self->chunk.handlers = at(image, header.handlersOffset, sizeof(KrkHandlerRegion) * header.hrSize);
+	if (!self->chunk.code || !self->chunk.lines || !self->chunk.handlers) goto _corrupt;
+	if (!aligned(self->chunk.lines) || !aligned(self->chunk.handlers)) goto _corrupt;
+	self->chunk.count = header.bcSize;
+	self->chunk.linesCount = header.lmSize;
+	self->chunk.handlersCount = header.hrSize;
+
+	krk_pop();
+	return self;
+
+_corrupt:
+	self->chunk.code = NULL;
+	self->chunk.lines = NULL;
+	self->chunk.handlers = NULL;
+	krk_pop();
+	return NULL;
+}
+
+static int readConstant(struct KrkImage * image, size_t * offset, KrkCodeObject * parent, KrkValue * out) {
+	uint8_t * tag = at(image, *offset, 1);
+	if (!tag) return 1;
+	*offset += 1;
+	uint32_t index;
+	switch (*tag) {
+		case 'k':
+			*out = KWARGS_VAL(0);
+			return 0;
+		case 'I': {
+			int64_t value;
+			void * ptr = at(image, *offset, sizeof(int64_t));
+			if (!ptr) return 1;
+			memcpy(&value, ptr, sizeof(int64_t));
+			*offset += sizeof(int64_t);
+			*out = INTEGER_VAL(value);
+			return 0;
+		}
+		case 'd': {
+			double value;
+			void * ptr = at(image, *offset, sizeof(double));
+			if (!ptr) return 1;
+			memcpy(&value, ptr, sizeof(double));
+			*offset += sizeof(double);
+			*out = FLOATING_VAL(value);
+			return 0;
+		}
+		case 'i':
+		case 's':
+		case 'f': {
+			uint8_t * small = at(image, *offset, 1);
+			if (!small) return 1;
+			*offset += 1;
+			index = *small;
+			break;
+		}
+		case 'S':
+		case 'F':
+		case 'B':
+			if (readU32(image, *offset, &index)) return 1;
+			*offset += sizeof(uint32_t);
+			break;
+		default:
+			return 1;
+	}
+
+	/* The rest carry an index or a length */
+	switch (*tag) {
+		case 'i':
+			*out = INTEGER_VAL(index);
+			return 0;
+		case 's':
+		case 'S': {
+			KrkString * str = imageString(image, index);
+			if (!str) return 1;
+			*out = OBJECT_VAL(str);
+			return 0;
+		}
+		case 'f':
+		case 'F': {
+			/* Nested code is loaded when it is first run, maybe from another module. */
+			KrkCodeObject * function = loadShell(image, index, parent->chunk.filename, parent->globalsContext);
+			if (!function) return 1;
+			*out = OBJECT_VAL(function);
+			return 0;
+		}
+		default: {
+			uint8_t * bytes = at(image, *offset, index);
+			if (!bytes) return 1;
+			*offset += index;
+			*out = OBJECT_VAL(krk_newBytes(index, bytes));
+			return 0;
+		}
+	}
+}
+
+int krk_materializeCodeObject(KrkCodeObject * self) {
+	if (!(__atomic_load_n(&self->obj.flags, __ATOMIC_ACQUIRE) & KRK_OBJ_FLAGS_CODEOBJECT_LAZY)) return 1;
+
+	struct KrkImage * image = self->image;
+	struct FunctionHeader header;
+	uint32_t offset;
+	if (functionHeader(image, self->imageIndex, &header, &offset)) goto _corrupt;
+
+	struct LocalEntry * entries = at(image, header.localsOffset, sizeof(struct LocalEntry) * (size_t)header.locals);
+	if (!entries) goto _corrupt;
+
+	/*
+	 * Another thread may be making the same first call. Each builds its own
+	 * copy, kept alive in a tuple, and only the first to finish publishes it.
+	 */
+	KrkTuple * built = krk_newTuple(header.ctSize + header.locals);
+	krk_push(OBJECT_VAL(built));
+	KrkLocalEntry * localNames = NULL;
+	if (header.locals) {
+		localNames = ALLOCATE(KrkLocalEntry, header.locals);
+		memset(localNames, 0, sizeof(KrkLocalEntry) * header.locals);
+	}
+
+	size_t constantOffset = header.constantsOffset;
+	for (size_t i = 0; i < header.ctSize; ++i) {
+		KrkValue value;
+		if (readConstant(image, &constantOffset, self, &value)) goto _discard;
+		built->values.values[built->values.count++] = value;
+		krk_gcWriteBarrier((KrkObj*)built);
+	}
+
+	for (size_t i = 0; i < header.locals; ++i) {
+		struct LocalEntry entry;
+		memcpy(&entry, &entries[i], sizeof(entry));
+		localNames[i].id = entry.id;
+		localNames[i].birthday = entry.birthday;
+		localNames[i].deathday = entry.deathday;
+		if (!(localNames[i].name = imageString(image, entry.nameInd))) goto _discard;
+		built->values.values[built->values.count++] = OBJECT_VAL(localNames[i].name);
+		krk_gcWriteBarrier((KrkObj*)built);
+	}
+
+	_obtain_lock(vm.codeLock);
+	if (self->obj.flags & KRK_OBJ_FLAGS_CODEOBJECT_LAZY) {
+		for (size_t i = 0; i < header.ctSize; ++i) {
+			krk_writeValueArray(&self->chunk.constants, built->values.values[i]);
+		}
+		self->localNames = localNames;
+		self->localNameCapacity = header.locals;
+		self->localNameCount = header.locals;
+		localNames = NULL;
+		krk_gcWriteBarrier((KrkObj*)self);
+		__atomic_and_fetch(&self->obj.flags, ~KRK_OBJ_FLAGS_CODEOBJECT_LAZY, __ATOMIC_RELEASE);
+	}
+	_release_lock(vm.codeLock);
+
+	if (localNames) FREE_ARRAY(KrkLocalEntry, localNames, header.locals);
+	krk_pop();
+	return 1;
+
+_discard:
+	if (localNames) FREE_ARRAY(KrkLocalEntry, localNames, header.locals);
+	krk_pop();
+_corrupt:
+	krk_runtimeError(vm.exceptions->importError, "Bytecode image for '%s' is corrupt.",
+		self->chunk.filename ? self->chunk.filename->chars : "<unknown>");
+	return 0;
+}
+
+KrkCodeObject * krk_unmarshal(uint8_t * data, size_t size, KrkString * filename) {
+	if (!krk_marshalValid(data, size, NULL) || !aligned(data)) return NULL;
+
+	struct MarshalHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (!header.functionCount) return NULL;
+	if ((size - sizeof(header)) / sizeof(uint32_t) < (size_t)header.stringCount + header.functionCount) return NULL;
+
+	struct KrkImage * image = malloc(sizeof(struct KrkImage));
+	image->data = data;
+	image->size = size;
+	image->stringCount = header.stringCount;
+	image->functionCount = header.functionCount;
+
+	krk_push(OBJECT_VAL(filename));
+	KrkCodeObject * result = loadShell(image, 0, filename, krk_currentThread.module);
+	krk_pop();
+
+	if (!result) free(image);
+	return result;
+}
+
+static char * readFile(const char * fileName, size_t * sizeOut) {
+	FILE * f = fopen(fileName, "rb");
+	if (!f) return NULL;
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	char * buf = size < 0 ? NULL : malloc(size + 1);
+	if (buf && fread(buf, 1, size, f) != (size_t)size) {
+		free(buf);
+		buf = NULL;
+	}
+	fclose(f);
+	if (buf) {
+		buf[size] = '\0';
+		*sizeOut = size;
+	}
+	return buf;
+}
+
+/*
+ * Images are mapped privately and writable: pages are only read from the
+ * file as they are touched, and quickening and breakpoints modify a
+ * private copy of just the pages they write to.
+ */
+static uint8_t * mapImage(const char * fileName, size_t * sizeOut) {
+#ifndef _WIN32
+	int fd = open(fileName, O_RDONLY);
+	if (fd < 0) return NULL;
+	struct stat statbuf;
+	void * data = MAP_FAILED;
+	if (fstat(fd, &statbuf) == 0 && statbuf.st_size > 0) {
+		data = mmap(NULL, statbuf.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		*sizeOut = statbuf.st_size;
+	}
+	close(fd);
+	return data == MAP_FAILED ? NULL : data;
+#else
+	return (uint8_t*)readFile(fileName, sizeOut);
+#endif
+}
+
+static void unmapImage(uint8_t * data, size_t size) {
+#ifndef _WIN32
+	munmap(data, size);
+#else
+	free(data);
+#endif
+}
+
+static struct StartupModule * startupModuleForFile(const char * fileName);
+
+static void attachModuleDoc(KrkCodeObject * function) {
+	/* The compiler would have set the module docstring while parsing. */
+	KrkValue doc;
+	if (!krk_tableGet_fast(&krk_currentThread.module->fields, S("__doc__"), &doc)) {
+		krk_attachNamedValue(&krk_currentThread.module->fields, "__doc__",
+			function->docstring ? OBJECT_VAL(function->docstring) : NONE_VAL());
+	}
+}
+
+static void writeCache(const char * cacheName, KrkCodeObject * function, const KrkSourceStamp * source) {
+	/* Write to a temporary name and move it into place, so readers never see a partial image. */
+	size_t len = strlen(cacheName);
+	char * tmpName = malloc(len + 5);
+	snprintf(tmpName, len + 5, "%s.tmp", cacheName);
+	FILE * out = fopen(tmpName, "wb");
+	if (out) {
+		int failed = krk_marshal(out, function, source);
+		if (fclose(out) != 0) failed = 1;
+		if (failed || rename(tmpName, cacheName) != 0) remove(tmpName);
+	}
+	free(tmpName);
+}
+
+KrkCodeObject * krk_compileCached(char * fileName, int writable) {
+	KrkSourceStamp source;
+	int useCache = !(krk_currentThread.flags & (KRK_THREAD_ENABLE_DISASSEMBLY | KRK_THREAD_ENABLE_SCAN_TRACING));
+	size_t len = strlen(fileName);
+	if (len < 4 || strcmp(&fileName[len-4], ".krk") != 0 || krk_sourceStamp(fileName, &source) != 0) useCache = 0;
+
+	struct StartupModule * bundled = useCache ? startupModuleForFile(fileName) : NULL;
+	if (bundled) {
+		krk_push(OBJECT_VAL(krk_copyString(fileName, len)));
+		KrkCodeObject * function = krk_unmarshal(bundled->data, bundled->size, AS_STRING(krk_peek(0)));
+		krk_pop();
+		if (function) {
+			attachModuleDoc(function);
+			return function;
+		}
+	}
+
+	char * cacheName = NULL;
+	if (useCache) {
+		cacheName = strdup(fileName);
+		memcpy(&cacheName[len-4], ".kbc", 4);
+
+		size_t size;
+		uint8_t * image = mapImage(cacheName, &size);
+		if (image) {
+			KrkCodeObject * function = NULL;
+			if (krk_marshalValid(image, size, &source)) {
+				krk_push(OBJECT_VAL(krk_copyString(fileName, len)));
+				function = krk_unmarshal(image, size, AS_STRING(krk_peek(0)));
+				krk_pop();
+			}
+			if (function) {
+				attachModuleDoc(function);
+				free(cacheName);
+				return function;
+			}
+			unmapImage(image, size);
+		}
+	}
+
+	size_t size;
+	char * buf = readFile(fileName, &size);
+	if (!buf) {
+		free(cacheName);
+		krk_runtimeError(vm.exceptions->ioError, "could not read file '%s': %s", fileName, strerror(errno));
+		return NULL;
+	}
+
+	KrkCodeObject * function = krk_compile(buf, fileName);
+	free(buf);
+
+	if (function && useCache && writable && !(vm.globalFlags & KRK_GLOBAL_NO_WRITE_BYTECODE)) {
+		krk_push(OBJECT_VAL(function));
+		writeCache(cacheName, function, &source);
+		krk_pop();
+	}
+
+	free(cacheName);
+	return function;
+}
+
+static void writeStartupEntry(struct Buffer * table, const char * name, const char * fileName, int isPackage, long offset, long size) {
+	struct StartupEntry entry = {strlen(name), strlen(fileName), isPackage ? STARTUP_PACKAGE : 0, offset, size};
+	put(table, &entry, sizeof(entry));
+	put(table, name, entry.nameLength);
+	put(table, fileName, entry.fileLength);
+}
+
+int krk_writeStartupImage(const char * fileName, int count, char * modules[]) {
+	FILE * out = fopen(fileName, "wb");
+	if (!out) {
+		krk_runtimeError(vm.exceptions->ioError, "could not open '%s' for writing: %s", fileName, strerror(errno));
+		return -1;
+	}
+
+	struct StartupHeader header = {{'K','R','K','S'}, {'1','0','1','4'}, count, 0};
+	fwrite(&header, 1, sizeof(header), out);
+
+	struct Buffer table = {0};
+	KrkInstance * enclosing = krk_currentThread.module;
+	size_t stackBase = krk_currentThread.stackTop - krk_currentThread.stack;
+
+	for (int i = 0; i < count; ++i) {
+		/* Let the importer find the module, then build an image from its source. */
+		KrkString * name = krk_copyString(modules[i], strlen(modules[i]));
+		krk_push(OBJECT_VAL(name));
+		if (!krk_importModule(name, name)) goto _error;
+
+		KrkValue module = krk_peek(0), file, isPackage;
+		if (!IS_INSTANCE(module) || !krk_tableGet_fast(&AS_INSTANCE(module)->fields, S("__file__"), &file) || !IS_STRING(file) ||
+			AS_STRING(file)->length < 4 || strcmp(&AS_CSTRING(file)[AS_STRING(file)->length-4], ".krk") != 0) {
+			krk_runtimeError(vm.exceptions->importError, "'%s' is not a Kuroko source module and can not be bundled", modules[i]);
+			goto _error;
+		}
+		int package = krk_tableGet_fast(&AS_INSTANCE(module)->fields, S("__ispackage__"), &isPackage) && IS_BOOLEAN(isPackage) && AS_BOOLEAN(isPackage);
+
+		KrkSourceStamp source;
+		size_t size;
+		char * buf = readFile(AS_CSTRING(file), &size);
+		if (!buf || krk_sourceStamp(AS_CSTRING(file), &source) != 0) {
+			free(buf);
+			krk_runtimeError(vm.exceptions->ioError, "could not read file '%s': %s", AS_CSTRING(file), strerror(errno));
+			goto _error;
+		}
+
+		krk_startModule("__startup_image__");
+		KrkCodeObject * function = krk_compile(buf, AS_CSTRING(file));
+		free(buf);
+		krk_currentThread.module = enclosing;
+		if (!function) goto _error;
+
+		krk_push(OBJECT_VAL(function));
+		long offset = ftell(out);
+		while (offset % IMAGE_ALIGN) {
+			fputc(0, out);
+			offset++;
+		}
+		if (krk_marshal(out, function, &source) != 0) {
+			krk_runtimeError(vm.exceptions->valueError, "module '%s' can not be stored in an image", modules[i]);
+			goto _error;
+		}
+
+		/* The importer looks names up by path */
+		char * path = strdup(modules[i]);
+		for (char * c = path; *c; ++c) if (*c == '.') *c = PATH_SEP[0];
+		writeStartupEntry(&table, path, AS_CSTRING(file), package, offset, ftell(out) - offset);
+		free(path);
+		krk_currentThread.stackTop = krk_currentThread.stack + stackBase;
+	}
+
+	header.tableOffset = ftell(out);
+	fwrite(table.data, 1, table.size, out);
+	fseek(out, 0, SEEK_SET);
+	fwrite(&header, 1, sizeof(header), out);
+	free(table.data);
+	krk_tableDelete(&vm.modules, OBJECT_VAL(S("__startup_image__")));
+
+	if (ferror(out) | fclose(out)) {
+		remove(fileName);
+		krk_runtimeError(vm.exceptions->ioError, "failed to write '%s'", fileName);
+		return -1;
+	}
+	return 0;
+
+_error:
+	krk_currentThread.module = enclosing;
+	krk_currentThread.stackTop = krk_currentThread.stack + stackBase;
+	krk_tableDelete(&vm.modules, OBJECT_VAL(S("__startup_image__")));
+	free(table.data);
+	fclose(out);
+	remove(fileName);
+	return -1;
+}
+
+static struct StartupModule * startupModule(struct StartupModule * entry) {
+	if (!entry->state) {
+		KrkSourceStamp source;
+		entry->state = (krk_sourceStamp(entry->fileName, &source) == 0 && krk_marshalValid(entry->data, entry->size, &source)) ? 1 : -1;
+	}
+	return entry->state == 1 ? entry : NULL;
+}
+
+static char * copyChars(const uint8_t * chars, size_t length) {
+	char * out = malloc(length + 1);
+	memcpy(out, chars, length);
+	out[length] = '\0';
+	return out;
+}
+
+int krk_loadStartupImage(const char * fileName) {
+	size_t size;
+	uint8_t * data = mapImage(fileName, &size);
+	if (!data) {
+		krk_runtimeError(vm.exceptions->ioError, "could not read file '%s': %s", fileName, strerror(errno));
+		return -1;
+	}
+
+	struct StartupHeader header;
+	struct KrkImage image = {data, size, 0, 0};
+	if (size < sizeof(header)) goto _invalid;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, (uint8_t[]){'K','R','K','S'}, 4) != 0) goto _invalid;
+	if (memcmp(header.version, (uint8_t[]){'1','0','1','4'}, 4) != 0) goto _invalid;
+
+	/* Check the whole table before registering anything from it */
+	size_t offset = header.tableOffset;
+	for (size_t i = 0; i < header.count; ++i) {
+		struct StartupEntry entry;
+		void * ptr = at(&image, offset, sizeof(entry));
+		if (!ptr) goto _invalid;
+		memcpy(&entry, ptr, sizeof(entry));
+		offset += sizeof(entry);
+		if (!at(&image, offset, (size_t)entry.nameLength + entry.fileLength)) goto _invalid;
+		offset += (size_t)entry.nameLength + entry.fileLength;
+		if (!at(&image, entry.dataOffset, entry.dataSize) || entry.dataOffset % IMAGE_ALIGN) goto _invalid;
+		if (!krk_marshalValid(&data[entry.dataOffset], entry.dataSize, NULL)) goto _invalid;
+	}
+
+	size_t first = startupModuleCount;
+	startupModuleCount += header.count;
+	startupModules = realloc(startupModules, sizeof(struct StartupModule) * startupModuleCount);
+	offset = header.tableOffset;
+	for (size_t i = first; i < startupModuleCount; ++i) {
+		struct StartupEntry entry;
+		memcpy(&entry, &data[offset], sizeof(entry));
+		offset += sizeof(entry);
+		startupModules[i].name = copyChars(&data[offset], entry.nameLength);
+		offset += entry.nameLength;
+		startupModules[i].fileName = copyChars(&data[offset], entry.fileLength);
+		offset += entry.fileLength;
+		startupModules[i].isPackage = !!(entry.flags & STARTUP_PACKAGE);
+		startupModules[i].state = 0;
+		startupModules[i].data = &data[entry.dataOffset];
+		startupModules[i].size = entry.dataSize;
+	}
+
+	/* Preload in the order the modules were written */
+	for (size_t i = first; i < startupModuleCount; ++i) {
+		if (!startupModule(&startupModules[i])) continue;
+		char * dotted = strdup(startupModules[i].name);
+		for (char * c = dotted; *c; ++c) if (*c == PATH_SEP[0]) *c = '.';
+		KrkString * name = krk_copyString(dotted, strlen(dotted));
+		free(dotted);
+		krk_push(OBJECT_VAL(name));
+		if (!krk_importModule(name, name)) return -1;
+		krk_pop(); /* module */
+		krk_pop(); /* name */
+	}
+	return 0;
+
+_invalid:
+	unmapImage(data, size);
+	krk_runtimeError(vm.exceptions->importError, "'%s' is not a valid startup image for this build.", fileName);
+	return -1;
+}
+
+const char * krk_startupImageFind(KrkString * path, int * isPackage) {
+	for (size_t i = 0; i < startupModuleCount; ++i) {
+		if (strcmp(startupModules[i].name, path->chars) == 0 && startupModule(&startupModules[i])) {
+			*isPackage = startupModules[i].isPackage;
+			return startupModules[i].fileName;
+		}
+	}
+	return NULL;
+}
+
+static struct StartupModule * startupModuleForFile(const char * fileName) {
+	for (size_t i = 0; i < startupModuleCount; ++i) {
+		if (strcmp(startupModules[i].fileName, fileName) == 0) return startupModule(&startupModules[i]);
+	}
+	return NULL;
+}
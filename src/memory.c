@@ -1,3 +1,5 @@
+#include <errno.h>
+#include <string.h>
 #include <kuroko/vm.h>
 #include <kuroko/memory.h>
 #include <kuroko/object.h>
@@ -6,6 +8,19 @@
 #include <kuroko/util.h>
 
 #include "private.h"
+#include "probes.h"
+
+#ifdef ENABLE_THREADING
+#include <pthread.h>
+#include <unistd.h>
+#include <sched.h>
+#include <kuroko/threads.h>
+#endif
+
+/* The memory debugger's tables are not thread safe. */
+#if defined(ENABLE_THREADING) && !defined(KRK_EXTENSIVE_MEMORY_DEBUGGING)
+# define GC_PARALLEL 1
+#endif
 
 #if defined(KRK_EXTENSIVE_MEMORY_DEBUGGING)
 /**
@@ -143,28 +158,191 @@ static int _debug_mem_has(const void *ptr) {
 }
 #endif
 
+static void collectWhenSafe(void);
+static void finishCycle(void);
+
+/* More collector threads than this are not useful. */
+#define GC_MAX_THREADS 64
+
+/* Pauses are counted in buckets of under 10us, 100us, 1ms, 10ms, 100ms, 1s, and the rest. */
+#define GC_PAUSE_BUCKETS 7
+
+/**
+ * Incremental collections mark old objects a few at a time between
+ * allocations, finish marking in one short pause, and then sweep old
+ * objects a few at a time behind @c sweepCursor.
+ */
+enum {
+	GC_IDLE,
+	GC_MARKING,
+	GC_SWEEPING,
+};
+
+/**
+ * What the collector of each VM keeps between and during collections,
+ * as @c vm.gc; the rest is in @c KrkVM itself.
+ */
+struct KrkGCState {
+#ifdef ENABLE_THREADING
+	/* The thread that stopped the others to collect garbage, while it does. */
+	KrkThreadState * collectingThread;
+	pthread_mutex_t safepointLock;
+	pthread_cond_t threadParked;
+	pthread_cond_t worldResumed;
+	int worldStopped;
+#endif
+	/* Set while collector helper threads are freeing or marking objects alongside the collecting thread. */
+	int freeingInParallel;
+	int markingInParallel;
+
+	/**
+	 * Objects with any of these flags set are not marked again. During a
+	 * minor collection this includes old objects, which are assumed to be
+	 * alive; the remembered set takes care of what they reference.
+	 */
+	uint16_t skipFlags;
+
+	/**
+	 * Set while checking whether a remembered object still references young
+	 * objects; krk_markObject then only notes whether it saw any.
+	 */
+	int checkingYoung;
+	int foundYoung;
+
+	int gcPhase;
+
+	/**
+	 * Set during incremental marking steps, which only mark old objects;
+	 * young ones are scanned when marking is finished.
+	 */
+	int markingOld;
+
+	volatile int rememberedLock;
+
+	/* The first old object left after the last minor sweep. */
+	KrkObj * sweepStop;
+	KrkObj ** sweepCursor;
+
+	struct {
+		size_t collections;
+		size_t minorCollections;
+		uint64_t pauseTotal;
+		uint64_t pauseLast;
+		uint64_t pauseMax;
+		size_t pauseHistogram[GC_PAUSE_BUCKETS];
+		size_t objectsFreed;
+		size_t bytesFreed;
+		/* What the last collection did, for gc.callbacks */
+		int lastGeneration;
+		size_t lastObjects;
+		size_t lastBytes;
+		uint64_t lastPause;
+	} gcStats;
+
+	struct {
+		uint64_t longest;
+		uint64_t pause;
+		uint64_t total;
+		size_t steps;
+		size_t bytesBefore;
+		size_t freed;
+		size_t bytesFreed;
+	} cycle;
+
+	KrkInstance * gcModule;
+
+	/* Set while gc.dump_heap is collecting the references of an object. */
+	int dumpingHeap;
+	KrkObj ** dumpReferences;
+	size_t dumpCount;
+	size_t dumpCapacity;
+};
+
+#define gc (vm.gc)
+
+void krk_initGC(void) {
+	gc = calloc(1, sizeof(struct KrkGCState));
+	gc->skipFlags = KRK_OBJ_FLAGS_IS_MARKED;
+	gc->gcPhase = GC_IDLE;
+#ifdef ENABLE_THREADING
+	pthread_mutex_init(&gc->safepointLock, NULL);
+	pthread_cond_init(&gc->threadParked, NULL);
+	pthread_cond_init(&gc->worldResumed, NULL);
+#endif
+}
+
+void krk_freeGC(void) {
+#ifdef ENABLE_THREADING
+	pthread_mutex_destroy(&gc->safepointLock);
+	pthread_cond_destroy(&gc->threadParked);
+	pthread_cond_destroy(&gc->worldResumed);
+#endif
+	free(gc->dumpReferences);
+	free(gc);
+	gc = NULL;
+}
+
+#ifdef ENABLE_THREADING
+/**
+ * Moves the objects @p thread allocated onto @c vm.objects, and what it
+ * counted on its own into @c vm.bytesAllocated. That thread must not be
+ * running: either it is the current thread, or it is parked.
+ */
+static void gatherObjects(KrkThreadState * thread) {
+	if (thread->objects) {
+		thread->objectsTail->next = vm.objects;
+		vm.objects = thread->objects;
+		thread->objects = NULL;
+		thread->objectsTail = NULL;
+	}
+	vm.bytesAllocated += (size_t)thread->bytesAllocated;
+	thread->bytesAllocated = 0;
+}
+#endif
+
+#ifdef GC_PARALLEL
+/* How far a thread's own count may get from zero before it is added to vm.bytesAllocated. */
+#define THREAD_BYTES_FLUSH (32 * 1024)
+
+/**
+ * Threads other than the one collecting count their allocations on their
+ * own, and only add them to @c vm.bytesAllocated once in a while, so the
+ * collector's trigger is a little behind but allocating does not contend
+ * on one shared counter.
+ */
+static inline void accountBytes(ssize_t delta) {
+	if (unlikely(gc->freeingInParallel)) {
+		__atomic_add_fetch(&vm.bytesAllocated, (size_t)delta, __ATOMIC_RELAXED);
+	} else if ((vm.globalFlags & KRK_GLOBAL_THREADS) && &krk_currentThread != gc->collectingThread) {
+		ssize_t local = krk_currentThread.bytesAllocated + delta;
+		if (unlikely(local > THREAD_BYTES_FLUSH || local < -THREAD_BYTES_FLUSH)) {
+			__atomic_add_fetch(&vm.bytesAllocated, (size_t)local, __ATOMIC_RELAXED);
+			local = 0;
+		}
+		krk_currentThread.bytesAllocated = local;
+	} else {
+		vm.bytesAllocated += delta;
+	}
+}
+# define ACCOUNT_BYTES(delta) accountBytes(delta)
+#else
+# define ACCOUNT_BYTES(delta) do { vm.bytesAllocated += (delta); } while (0)
+#endif
+
 void krk_gcTakeBytes(const void * ptr, size_t size) {
 #if defined(KRK_EXTENSIVE_MEMORY_DEBUGGING)
 	_debug_mem_set(ptr, size);
 #endif
 
-	vm.bytesAllocated += size;
+	ACCOUNT_BYTES(size);
 }
 
 void * krk_reallocate(void * ptr, size_t old, size_t new) {
 
-	vm.bytesAllocated -= old;
-	vm.bytesAllocated += new;
+	ACCOUNT_BYTES(new - old);
 
-	if (new > old && ptr != krk_currentThread.stack && &krk_currentThread == vm.threads && !(vm.globalFlags & KRK_GLOBAL_GC_PAUSED)) {
-#ifndef KRK_NO_STRESS_GC
-		if (vm.globalFlags & KRK_GLOBAL_ENABLE_STRESS_GC) {
-			krk_collectGarbage();
-		}
-#endif
-		if (vm.bytesAllocated > vm.nextGC) {
-			krk_collectGarbage();
-		}
+	if (new > old && ptr != krk_currentThread.stack && !(vm.globalFlags & KRK_GLOBAL_GC_PAUSED)) {
+		collectWhenSafe();
 	}
 
 	void * out;
@@ -198,38 +376,83 @@ void * krk_reallocate(void * ptr, size_t old, size_t new) {
 	return out;
 }
 
+void * krk_allocateObjectMemory(size_t size) {
+	ACCOUNT_BYTES(size);
+
+	if (!(vm.globalFlags & KRK_GLOBAL_GC_PAUSED)) {
+		collectWhenSafe();
+	}
+
+	void * out = krk_slabAllocate(size);
+
+#if defined(KRK_EXTENSIVE_MEMORY_DEBUGGING)
+	if (out) _debug_mem_set(out, size);
+#endif
+
+	return out;
+}
+
+void krk_freeObjectMemory(void * ptr, size_t size) {
+	ACCOUNT_BYTES(-size);
+
+#if defined(KRK_EXTENSIVE_MEMORY_DEBUGGING)
+	if (!_debug_mem_has(ptr)) {
+		fprintf(stderr, "Invalid free of object %p of size %zu\n", ptr, size);
+		abort();
+	}
+	size_t t = _debug_mem_get(ptr);
+	if (t != size) {
+		fprintf(stderr, "Invalid free of object %p of size %zu - should be %zu\n", ptr, size, t);
+		abort();
+	}
+	_debug_mem_remove(ptr);
+#endif
+
+	krk_slabFree(ptr, size);
+}
+
+#define FREE_OBJECT(t,p) krk_freeObjectMemory(p,sizeof(t))
+
 static void freeObject(KrkObj * object) {
 	switch (object->type) {
 		case KRK_OBJ_STRING: {
 			KrkString * string = (KrkString*)object;
-			FREE_ARRAY(char, string->chars, string->length + 1);
+			FREE_ARRAY(char, string->chars, krk_stringCapacity(string));
 			if (string->codes && string->codes != string->chars) free(string->codes);
-			FREE(KrkString, object);
+			FREE_OBJECT(KrkString, object);
 			break;
 		}
 		case KRK_OBJ_CODEOBJECT: {
 			KrkCodeObject * function = (KrkCodeObject*)object;
+			if (function->obj.flags & KRK_OBJ_FLAGS_CODEOBJECT_IMAGE) {
+				/* These belong to the bytecode image */
+				function->chunk.code = NULL;
+				function->chunk.lines = NULL;
+				function->chunk.handlers = NULL;
+			}
 			krk_freeChunk(&function->chunk);
 			krk_freeValueArray(&function->requiredArgNames);
 			krk_freeValueArray(&function->keywordArgNames);
 			FREE_ARRAY(KrkLocalEntry, function->localNames, function->localNameCount);
 			function->localNameCount = 0;
-			FREE(KrkCodeObject, object);
+			free(function->inlineCaches);
+			free(function->lineProfile);
+			FREE_OBJECT(KrkCodeObject, object);
 			break;
 		}
 		case KRK_OBJ_NATIVE: {
-			FREE(KrkNative, object);
+			FREE_OBJECT(KrkNative, object);
 			break;
 		}
 		case KRK_OBJ_CLOSURE: {
 			KrkClosure * closure = (KrkClosure*)object;
 			FREE_ARRAY(KrkUpvalue*,closure->upvalues,closure->upvalueCount);
 			krk_freeTable(&closure->fields);
-			FREE(KrkClosure, object);
+			FREE_OBJECT(KrkClosure, object);
 			break;
 		}
 		case KRK_OBJ_UPVALUE: {
-			FREE(KrkUpvalue, object);
+			FREE_OBJECT(KrkUpvalue, object);
 			break;
 		}
 		case KRK_OBJ_CLASS: {
@@ -239,7 +462,7 @@ static void freeObject(KrkObj * object) {
 			if (_class->base) {
 				krk_tableDelete(&_class->base->subclasses, OBJECT_VAL(object));
 			}
-			FREE(KrkClass, object);
+			FREE_OBJECT(KrkClass, object);
 			break;
 		}
 		case KRK_OBJ_INSTANCE: {
@@ -248,28 +471,31 @@ static void freeObject(KrkObj * object) {
 				inst->_class->_ongcsweep(inst);
 			}
 			krk_freeTable(&inst->fields);
-			krk_reallocate(object,inst->_class->allocSize,0);
+			krk_freeObjectMemory(object,inst->_class->allocSize);
 			break;
 		}
 		case KRK_OBJ_BOUND_METHOD:
-			FREE(KrkBoundMethod, object);
+			FREE_OBJECT(KrkBoundMethod, object);
 			break;
 		case KRK_OBJ_TUPLE: {
 			KrkTuple * tuple = (KrkTuple*)object;
 			krk_freeValueArray(&tuple->values);
-			FREE(KrkTuple, object);
+			FREE_OBJECT(KrkTuple, object);
 			break;
 		}
 		case KRK_OBJ_BYTES: {
 			KrkBytes * bytes = (KrkBytes*)object;
 			FREE_ARRAY(uint8_t, bytes->bytes, bytes->length);
-			FREE(KrkBytes, bytes);
+			FREE_OBJECT(KrkBytes, bytes);
 			break;
 		}
 	}
 }
 
 void krk_freeObjects() {
+#ifdef ENABLE_THREADING
+	gatherObjects(&krk_currentThread);
+#endif
 	KrkObj * object = vm.objects;
 	KrkObj * other = NULL;
 
@@ -294,6 +520,7 @@ void krk_freeObjects() {
 	}
 
 	free(vm.grayStack);
+	free(vm.remembered);
 }
 
 void krk_freeMemoryDebugger(void) {
@@ -313,11 +540,24 @@ void krk_freeMemoryDebugger(void) {
 #endif
 }
 
-void krk_markObject(KrkObj * object) {
-	if (!object) return;
-	if (object->flags & KRK_OBJ_FLAGS_IS_MARKED) return;
-	object->flags |= KRK_OBJ_FLAGS_IS_MARKED;
+static void addRemembered(KrkObj * obj) {
+	if (obj->flags & KRK_OBJ_FLAGS_GC_REMEMBERED) return;
+	obj->flags |= KRK_OBJ_FLAGS_GC_REMEMBERED;
+	if (vm.rememberedCapacity < vm.rememberedCount + 1) {
+		vm.rememberedCapacity = GROW_CAPACITY(vm.rememberedCapacity);
+		vm.remembered = realloc(vm.remembered, sizeof(KrkObj*) * vm.rememberedCapacity);
+		if (!vm.remembered) exit(1);
+	}
+	vm.remembered[vm.rememberedCount++] = obj;
+}
 
+void krk_gcRemember(KrkObj * obj) {
+	_obtain_lock(gc->rememberedLock);
+	addRemembered(obj);
+	_release_lock(gc->rememberedLock);
+}
+
+static void grayObject(KrkObj * object) {
 	if (vm.grayCapacity < vm.grayCount + 1) {
 		vm.grayCapacity = GROW_CAPACITY(vm.grayCapacity);
 		vm.grayStack = realloc(vm.grayStack, sizeof(KrkObj*) * vm.grayCapacity);
@@ -326,6 +566,39 @@ void krk_markObject(KrkObj * object) {
 	vm.grayStack[vm.grayCount++] = object;
 }
 
+#ifdef GC_PARALLEL
+static void pushMarkStack(KrkObj * object);
+#endif
+
+static void addDumpReference(KrkObj * object);
+
+void krk_markObject(KrkObj * object) {
+	if (!object) return;
+	struct KrkGCState * state = gc;
+	if (unlikely(state->checkingYoung | state->markingOld | state->dumpingHeap)) {
+		if (state->dumpingHeap) {
+			addDumpReference(object);
+			return;
+		}
+		if (state->checkingYoung) {
+			if (!(object->flags & KRK_OBJ_FLAGS_GC_OLD)) state->foundYoung = 1;
+			return;
+		}
+		if (!(object->flags & KRK_OBJ_FLAGS_GC_OLD)) return;
+	}
+	if (object->flags & state->skipFlags) return;
+#ifdef GC_PARALLEL
+	if (unlikely(state->markingInParallel)) {
+		/* Another marker may have gotten here first. */
+		if (__atomic_fetch_or(&object->flags, KRK_OBJ_FLAGS_IS_MARKED, __ATOMIC_RELAXED) & KRK_OBJ_FLAGS_IS_MARKED) return;
+		pushMarkStack(object);
+		return;
+	}
+#endif
+	object->flags |= KRK_OBJ_FLAGS_IS_MARKED;
+	grayObject(object);
+}
+
 void krk_markValue(KrkValue value) {
 	if (!IS_OBJECT(value)) return;
 	krk_markObject(AS_OBJECT(value));
@@ -380,6 +653,12 @@ static void blackenObject(KrkObj * object) {
 			krk_markObject((KrkObj*)((KrkInstance*)object)->_class);
 			if (((KrkInstance*)object)->_class->_ongcscan) ((KrkInstance*)object)->_class->_ongcscan((KrkInstance*)object);
 			krk_markTable(&((KrkInstance*)object)->fields);
+			KrkClass * _class = ((KrkInstance*)object)->_class;
+			if (_class->slotsStart) {
+				for (size_t offset = _class->slotsStart; offset < _class->allocSize; offset += sizeof(KrkValue)) {
+					krk_markValue(*krk_slotValue((KrkInstance*)object, offset));
+				}
+			}
 			break;
 		}
 		case KRK_OBJ_BOUND_METHOD: {
@@ -400,43 +679,378 @@ static void blackenObject(KrkObj * object) {
 	}
 }
 
-static void traceReferences() {
-	while (vm.grayCount > 0) {
+struct ObjectChain {
+	KrkObj * head;
+	KrkObj ** tail;
+};
+
+static inline void chainAppend(struct ObjectChain * chain, KrkObj * object) {
+	*chain->tail = object;
+	chain->tail = &object->next;
+}
+
+#ifdef GC_PARALLEL
+/*
+ * Parallel collection.
+ *
+ * With more than one collector thread configured and a heap big enough
+ * to be worth it, marking and freeing are spread over helper threads
+ * that sleep between collections. The collecting thread works as one of
+ * them. All of this happens while the world is stopped, so the only
+ * threads touching the heap are the collector's.
+ *
+ * Each marker pops objects from a private stack. When that grows, it
+ * moves a batch to its shared stack, from which markers that have run
+ * out of work steal half at a time. Marking ends when no marker is
+ * active, as markers only share work while they are active and never
+ * go idle with anything left on their own shared stack.
+ *
+ * Sweeping still walks the object list on the collecting thread, but
+ * the dead objects it finds are handed out to the helpers in batches to
+ * be freed. Classes are freed last, on the collecting thread, as
+ * freeing one updates its base class and instances that are being
+ * freed may still need to look at it.
+ */
+/* Heaps smaller than this are collected by one thread. */
+#define GC_PARALLEL_MIN  (4 * 1024 * 1024)
+/* Objects moved to a shared stack at a time. */
+#define GC_SHARE_BATCH   64
+/* Consecutive dead objects handed to the same helper. */
+#define GC_FREE_BATCH    256
+
+struct MarkStack {
+	KrkObj ** items;
+	size_t count;
+	size_t capacity;
+	volatile int lock;
+	KrkObj ** shared;
+	size_t sharedCount;
+	size_t sharedCapacity;
+};
+
+static struct MarkStack markStacks[GC_MAX_THREADS];
+static threadLocal struct MarkStack * currentMarkStack = NULL;
+static size_t gcWorkers = 1;
+static volatile size_t activeMarkers = 0;
+
+static void pushItems(KrkObj *** items, size_t * count, size_t * capacity, KrkObj ** from, size_t n) {
+	if (*capacity < *count + n) {
+		while (*capacity < *count + n) *capacity = GROW_CAPACITY(*capacity);
+		*items = realloc(*items, sizeof(KrkObj*) * *capacity);
+		if (!*items) exit(1);
+	}
+	memcpy(*items + *count, from, sizeof(KrkObj*) * n);
+	*count += n;
+}
+
+static void pushMarkStack(KrkObj * object) {
+	struct MarkStack * stack = currentMarkStack;
+	pushItems(&stack->items, &stack->count, &stack->capacity, &object, 1);
+}
+
+static void shareWork(struct MarkStack * stack) {
+	_obtain_lock(stack->lock);
+	stack->count -= GC_SHARE_BATCH;
+	pushItems(&stack->shared, &stack->sharedCount, &stack->sharedCapacity, stack->items + stack->count, GC_SHARE_BATCH);
+	_release_lock(stack->lock);
+}
+
+/* Take back our own shared work, or steal half of someone else's. */
+static int takeWork(size_t index) {
+	struct MarkStack * self = &markStacks[index];
+	for (size_t i = 0; i < gcWorkers; ++i) {
+		struct MarkStack * victim = &markStacks[(index + i) % gcWorkers];
+		if (!victim->sharedCount) continue;
+		_obtain_lock(victim->lock);
+		size_t n = victim == self ? victim->sharedCount : (victim->sharedCount + 1) / 2;
+		if (n) {
+			victim->sharedCount -= n;
+			pushItems(&self->items, &self->count, &self->capacity, victim->shared + victim->sharedCount, n);
+		}
+		_release_lock(victim->lock);
+		if (n) return 1;
+	}
+	return 0;
+}
+
+static int anySharedWork(void) {
+	for (size_t i = 0; i < gcWorkers; ++i) {
+		if (markStacks[i].sharedCount) return 1;
+	}
+	return 0;
+}
+
+static void markWorker(size_t index) {
+	struct MarkStack * self = &markStacks[index];
+	currentMarkStack = self;
+	for (;;) {
+		while (self->count) {
+			blackenObject(self->items[--self->count]);
+			if (self->count >= GC_SHARE_BATCH * 2 && !self->sharedCount) shareWork(self);
+		}
+		if (takeWork(index)) continue;
+		__atomic_sub_fetch(&activeMarkers, 1, __ATOMIC_ACQ_REL);
+		for (;;) {
+			if (!__atomic_load_n(&activeMarkers, __ATOMIC_ACQUIRE)) {
+				currentMarkStack = NULL;
+				return;
+			}
+			if (anySharedWork()) {
+				__atomic_add_fetch(&activeMarkers, 1, __ATOMIC_ACQ_REL);
+				if (takeWork(index)) break;
+				__atomic_sub_fetch(&activeMarkers, 1, __ATOMIC_ACQ_REL);
+			}
+			sched_yield();
+		}
+	}
+}
+
+static struct ObjectChain deadChains[GC_MAX_THREADS];
+
+static void freeWorker(size_t index) {
+	KrkObj * object = deadChains[index].head;
+	while (object) {
+		KrkObj * next = object->next;
+		freeObject(object);
+		object = next;
+	}
+}
+
+/* Helper threads, which sleep until the collector has a job for them. */
+static pthread_mutex_t _helperLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _helperWake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t _helperDone = PTHREAD_COND_INITIALIZER;
+static size_t helperCount = 0;
+static size_t helpersBusy = 0;
+static size_t jobNumber = 0;
+static size_t helperStartJob[GC_MAX_THREADS];
+static void (*helperJob)(size_t) = NULL;
+/* The VM whose collection the helpers are working on. */
+static KrkVM * helperVM = NULL;
+
+/* The helpers work for one collection at a time; collections in other VMs meanwhile run on one thread. */
+static volatile int _helpersInUse = 0;
+
+static void * gcHelper(void * arg) {
+#if defined(__APPLE__) && defined(__aarch64__)
+	krk_forceThreadData();
+#endif
+	size_t index = (uintptr_t)arg;
+	pthread_mutex_lock(&_helperLock);
+	size_t seen = helperStartJob[index];
+	for (;;) {
+		while (jobNumber == seen) pthread_cond_wait(&_helperWake, &_helperLock);
+		seen = jobNumber;
+		if (index >= gcWorkers) continue;
+		void (*job)(size_t) = helperJob;
+		krk_currentThread.owner = helperVM;
+		pthread_mutex_unlock(&_helperLock);
+		job(index);
+		pthread_mutex_lock(&_helperLock);
+		if (--helpersBusy == 0) pthread_cond_signal(&_helperDone);
+	}
+	return NULL;
+}
+
+/* Start any helpers we are missing; if we can't, make do with the ones we have. */
+static void startHelpers(void) {
+	pthread_mutex_lock(&_helperLock);
+	while (helperCount < gcWorkers - 1) {
+		pthread_t helper;
+		helperStartJob[helperCount + 1] = jobNumber;
+		if (pthread_create(&helper, NULL, gcHelper, (void*)(uintptr_t)(helperCount + 1))) {
+			gcWorkers = helperCount + 1;
+			break;
+		}
+		pthread_detach(helper);
+		helperCount++;
+	}
+	pthread_mutex_unlock(&_helperLock);
+}
+
+/* Run @p job on the collecting thread as worker 0 and on the helpers as the rest. */
+static void runOnHelpers(void (*job)(size_t)) {
+	pthread_mutex_lock(&_helperLock);
+	helperJob = job;
+	helperVM = &vm;
+	helpersBusy = gcWorkers - 1;
+	jobNumber++;
+	pthread_cond_broadcast(&_helperWake);
+	pthread_mutex_unlock(&_helperLock);
+
+	job(0);
+
+	pthread_mutex_lock(&_helperLock);
+	while (helpersBusy) pthread_cond_wait(&_helperDone, &_helperLock);
+	pthread_mutex_unlock(&_helperLock);
+}
+
+static void releaseHelpers(void) {
+	__atomic_store_n(&_helpersInUse, 0, __ATOMIC_RELEASE);
+}
+
+/* If this returns non-zero, the caller has the helpers until it calls releaseHelpers. */
+static int collectInParallel(void) {
+	size_t workers = vm.gcThreads < GC_MAX_THREADS ? vm.gcThreads : GC_MAX_THREADS;
+	if (workers < 2 || vm.bytesAllocated < GC_PARALLEL_MIN) return 0;
+	if (__atomic_exchange_n(&_helpersInUse, 1, __ATOMIC_ACQUIRE)) return 0;
+	gcWorkers = workers;
+	startHelpers();
+	if (gcWorkers > 1) return 1;
+	releaseHelpers();
+	return 0;
+}
+
+static void traceInParallel(size_t base) {
+	/* Deal out what is on the gray stack so every marker starts with something. */
+	size_t total = vm.grayCount - base;
+	for (size_t i = 0; i < gcWorkers; ++i) {
+		size_t start = base + total * i / gcWorkers;
+		size_t end   = base + total * (i + 1) / gcWorkers;
+		pushItems(&markStacks[i].shared, &markStacks[i].sharedCount, &markStacks[i].sharedCapacity, vm.grayStack + start, end - start);
+	}
+	vm.grayCount = base;
+
+	activeMarkers = gcWorkers;
+	gc->markingInParallel = 1;
+	runOnHelpers(markWorker);
+	gc->markingInParallel = 0;
+}
+#endif
+
+/* Objects below @p base on the gray stack belong to an incremental collection. */
+static void traceReferences(size_t base) {
+#ifdef GC_PARALLEL
+	if (collectInParallel()) {
+		traceInParallel(base);
+		releaseHelpers();
+		return;
+	}
+#endif
+	while (vm.grayCount > base) {
 		KrkObj * object = vm.grayStack[--vm.grayCount];
 		blackenObject(object);
 	}
 }
 
-static size_t sweep() {
-	KrkObj * previous = NULL;
-	KrkObj * object = vm.objects;
+/* Whether an object references anything young. */
+static int hasYoungReferences(KrkObj * object) {
+	gc->checkingYoung = 1;
+	gc->foundYoung = 0;
+	blackenObject(object);
+	gc->checkingYoung = 0;
+	return gc->foundYoung;
+}
+
+/**
+ * New objects are always added to the head of the object list, and
+ * young objects are kept there, so the list is all of the young objects
+ * followed by all of the old ones and a minor collection only has to
+ * sweep up to the first old object it finds.
+ *
+ * Young objects that survive a minor collection are moved behind the
+ * ones that did not, starting at @c vm.survivors, and are promoted if
+ * they survive another one; most objects that are still alive when
+ * they are first collected are only being passed around on the stack.
+ * Unmarked young objects on their first chance go back to the head of
+ * the list so they get swept again by the next minor collection.
+ * A full collection promotes everything it does not free, so that
+ * anything unmarked objects were left referencing is freed with them
+ * by the next one.
+ */
+static void removeWhiteString(KrkString * string) {
+	if (!vm.strings.count) return;
+	KrkTableEntry * entry = krk_findEntry(&vm.strings, OBJECT_VAL(string));
+	if (entry && IS_OBJECT(entry->key) && AS_OBJECT(entry->key) == (KrkObj*)string) {
+		krk_tableDelete(&vm.strings, entry->key);
+	}
+}
+
+static size_t sweep(int young) {
+	struct ObjectChain unreached = {NULL, &unreached.head};
+	struct ObjectChain survived = {NULL, &survived.head};
+	struct ObjectChain promoted = {NULL, &promoted.head};
+	KrkObj * first = vm.objects;
+	KrkObj * object = first;
+	int aged = !young;
 	size_t count = 0;
-	while (object) {
+#ifdef GC_PARALLEL
+	int deferring = collectInParallel();
+	struct ObjectChain deadClasses = {NULL, &deadClasses.head};
+	if (deferring) {
+		for (size_t i = 0; i < gcWorkers; ++i) deadChains[i] = (struct ObjectChain){NULL, &deadChains[i].head};
+	}
+#endif
+	while (object && !(young && (object->flags & KRK_OBJ_FLAGS_GC_OLD))) {
+		if (object == vm.survivors) aged = 1;
+		KrkObj * next = object->next;
 		if (object->flags & (KRK_OBJ_FLAGS_IMMORTAL | KRK_OBJ_FLAGS_IS_MARKED)) {
 			object->flags &= ~(KRK_OBJ_FLAGS_IS_MARKED | KRK_OBJ_FLAGS_SECOND_CHANCE);
-			previous = object;
-			object = object->next;
-		} else if (object->flags & KRK_OBJ_FLAGS_SECOND_CHANCE) {
-			KrkObj * unreached = object;
-			object = object->next;
-			if (previous != NULL) {
-				previous->next = object;
+			if (aged) {
+				object->flags |= KRK_OBJ_FLAGS_GC_OLD;
+				/* It may reference younger survivors; that gets checked once the sweep is done. */
+				if (young) addRemembered(object);
+				/* Incremental collections scan what is promoted while they are marking as they go. */
+				if (gc->gcPhase == GC_MARKING) {
+					object->flags |= KRK_OBJ_FLAGS_IS_MARKED;
+					grayObject(object);
+				}
+				chainAppend(&promoted, object);
 			} else {
-				vm.objects = object;
+				chainAppend(&survived, object);
 			}
-			freeObject(unreached);
+		} else if (object->flags & KRK_OBJ_FLAGS_SECOND_CHANCE) {
+#ifdef GC_PARALLEL
+			if (deferring) {
+				if (object->type == KRK_OBJ_CLASS) chainAppend(&deadClasses, object);
+				else chainAppend(&deadChains[(count / GC_FREE_BATCH) % gcWorkers], object);
+			} else
+#endif
+			freeObject(object);
 			count++;
-		} else {
+		} else if (young) {
+			/* Full collections take unmarked strings out of the string table before sweeping. */
+			if (object->type == KRK_OBJ_STRING && (object->flags & KRK_OBJ_FLAGS_STRING_INTERNED)) removeWhiteString((KrkString*)object);
 			object->flags |= KRK_OBJ_FLAGS_SECOND_CHANCE;
-			previous = object;
-			object = object->next;
+			chainAppend(&unreached, object);
+		} else {
+			object->flags |= KRK_OBJ_FLAGS_SECOND_CHANCE | KRK_OBJ_FLAGS_GC_OLD;
+			chainAppend(&promoted, object);
+		}
+		object = next;
+	}
+	*promoted.tail = object;
+	*survived.tail = promoted.head;
+	*unreached.tail = survived.head;
+
+	/* Objects allocated by other threads while we were sweeping stay in front. */
+	KrkObj ** head = &vm.objects;
+	while (*head != first) head = &(*head)->next;
+	*head = unreached.head;
+	vm.survivors = survived.head;
+	gc->sweepStop = object;
+
+#ifdef GC_PARALLEL
+	if (deferring) {
+		for (size_t i = 0; i < gcWorkers; ++i) *deadChains[i].tail = NULL;
+		if (count > GC_FREE_BATCH) {
+			gc->freeingInParallel = 1;
+			runOnHelpers(freeWorker);
+			gc->freeingInParallel = 0;
+		} else {
+			freeWorker(0);
 		}
+		*deadClasses.tail = NULL;
+		deadChains[0] = deadClasses;
+		freeWorker(0);
+		releaseHelpers();
 	}
+#endif
 	return count;
 }
 
 void krk_markTable(KrkTable * table) {
-	for (size_t i = 0; i < table->capacity; ++i) {
+	for (size_t i = 0; i < table->used; ++i) {
 		KrkTableEntry * entry = &table->entries[i];
 		krk_markValue(entry->key);
 		krk_markValue(entry->value);
@@ -444,7 +1058,7 @@ void krk_markTable(KrkTable * table) {
 }
 
 static void tableRemoveWhite(KrkTable * table) {
-	for (size_t i = 0; i < table->capacity; ++i) {
+	for (size_t i = 0; i < table->used; ++i) {
 		KrkTableEntry * entry = &table->entries[i];
 		if (IS_OBJECT(entry->key) && !((AS_OBJECT(entry->key))->flags & KRK_OBJ_FLAGS_IS_MARKED)) {
 			krk_tableDelete(table, entry->key);
@@ -476,15 +1090,18 @@ static void markRoots() {
 	}
 
 	krk_markCompilerRoots();
+	krk_markWeakReferences();
 
 	krk_markObject((KrkObj*)vm.builtins);
 	krk_markTable(&vm.modules);
+	krk_markTable(&vm.importDirs);
 
 	if (vm.specialMethodNames) {
 		for (int i = 0; i < METHOD__MAX; ++i) {
 			krk_markValue(vm.specialMethodNames[i]);
 		}
 	}
+	krk_markArgNames();
 }
 
 static int smartSize(char _out[100], size_t s) {
@@ -505,43 +1122,86 @@ static int smartSize(char _out[100], size_t s) {
 	return snprintf(_out, 100, "%d B", (int)s);
 }
 
-size_t krk_collectGarbage(void) {
-	struct timespec outTime, inTime;
+#define NS_PARTS(t) (long long)((t) / 1000000000ULL), (long)((t) % 1000000000ULL)
 
-	if (vm.globalFlags & KRK_GLOBAL_REPORT_GC_COLLECTS) {
-		clock_gettime(CLOCK_MONOTONIC, &inTime);
-	}
+static uint64_t gcClock(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/* Set on the thread running gc.callbacks, so collections they cause don't call them again. */
+static threadLocal int runningCallbacks = 0;
+
+static void recordPause(uint64_t ns) {
+	gc->gcStats.pauseLast = ns;
+	gc->gcStats.pauseTotal += ns;
+	if (ns > gc->gcStats.pauseMax) gc->gcStats.pauseMax = ns;
+	size_t bucket = 0;
+	for (uint64_t limit = 10000; bucket < GC_PAUSE_BUCKETS - 1 && ns >= limit; limit *= 10) bucket++;
+	gc->gcStats.pauseHistogram[bucket]++;
+}
+
+static void recordCollection(int generation, size_t objects, size_t bytes, uint64_t pause) {
+	if (KRK_PROBE_ENABLED(gc__done)) KRK_PROBE(gc__done, generation, objects, bytes, pause);
+	if (generation) gc->gcStats.collections++;
+	else gc->gcStats.minorCollections++;
+	gc->gcStats.objectsFreed += objects;
+	gc->gcStats.bytesFreed += bytes;
+	gc->gcStats.lastGeneration = generation;
+	gc->gcStats.lastObjects = objects;
+	gc->gcStats.lastBytes = bytes;
+	gc->gcStats.lastPause = pause;
+	/* The interpreter calls them, and those of any weak references that were cleared, once it is between instructions. */
+	krk_currentThread.flags |= KRK_THREAD_GC_CALLBACKS;
+}
 
+static size_t bytesFreedSince(size_t before) {
+	return before > vm.bytesAllocated ? before - vm.bytesAllocated : 0;
+}
+
+/**
+ * The next full collection is due once the heap has grown by @c vm.heapGrowth
+ * times what survived this one, but by no more than @c vm.maxHeapGrowth bytes,
+ * so heaps in the GiB range are not left to double before they are collected.
+ * Small heaps are not collected before they reach @c vm.minHeap.
+ */
+static void scheduleCollection(void) {
+	size_t growth = (size_t)(vm.bytesAllocated * (vm.heapGrowth - 1.0));
+	if (growth > vm.maxHeapGrowth) growth = vm.maxHeapGrowth;
+	vm.nextGC = vm.bytesAllocated + growth;
+	if (vm.nextGC < vm.minHeap) vm.nextGC = vm.minHeap;
+}
+
+size_t krk_collectGarbage(void) {
+	if (gc->gcPhase != GC_IDLE) finishCycle();
+	if (KRK_PROBE_ENABLED(gc__start)) KRK_PROBE(gc__start, 1);
+
+	uint64_t start = gcClock();
 	size_t bytesBefore = vm.bytesAllocated;
 
+	/* Everything is scanned, so nothing needs to be remembered. */
+	_obtain_lock(gc->rememberedLock);
+	for (size_t i = 0; i < vm.rememberedCount; ++i) {
+		vm.remembered[i]->flags &= ~KRK_OBJ_FLAGS_GC_REMEMBERED;
+	}
+	vm.rememberedCount = 0;
+	_release_lock(gc->rememberedLock);
+
 	markRoots();
-	traceReferences();
+	traceReferences(0);
 	tableRemoveWhite(&vm.strings);
-	size_t out = sweep();
+	krk_clearWeakReferences(0);
+	size_t out = sweep(0);
 
-	/**
-	 * The GC scheduling is in need of some improvement. The strategy at the moment
-	 * is to schedule the next collect at double the current post-collection byte
-	 * allocation size, up until that reaches 128MiB (64*2). Beyond that point,
-	 * the next collection is scheduled for 64MiB after the current value.
-	 *
-	 * Previously, we always doubled as that was what Lox did, but this rather
-	 * quickly runs into issues when memory allocation climbs into the GiB range.
-	 * 64MiB seems to be a good switchover point.
-	 */
-	if (vm.bytesAllocated < 0x4000000) {
-		vm.nextGC = vm.bytesAllocated * 2;
-	} else {
-		vm.nextGC = vm.bytesAllocated + 0x4000000;
-	}
+	scheduleCollection();
+	vm.nextMinorGC = vm.bytesAllocated + vm.nurserySize;
 
-	if (vm.globalFlags & KRK_GLOBAL_REPORT_GC_COLLECTS) {
-		clock_gettime(CLOCK_MONOTONIC, &outTime);
-		struct timespec diff;
-		diff.tv_sec  = outTime.tv_sec  - inTime.tv_sec;
-		diff.tv_nsec = outTime.tv_nsec - inTime.tv_nsec;
-		if (diff.tv_nsec < 0) { diff.tv_sec--; diff.tv_nsec += 1000000000L; }
+	uint64_t pause = gcClock() - start;
+	recordPause(pause);
+	recordCollection(1, out, bytesFreedSince(bytesBefore), pause);
 
+	if (vm.globalFlags & KRK_GLOBAL_REPORT_GC_COLLECTS) {
 		char smartBefore[100];
 		smartSize(smartBefore, bytesBefore);
 		char smartAfter[100];
@@ -552,16 +1212,684 @@ size_t krk_collectGarbage(void) {
 		smartSize(smartNext, vm.nextGC);
 
 		fprintf(stderr, "[gc] %lld.%.9lds %s before; %s after; freed %s in %llu objects; next collection at %s\n",
-			(long long)diff.tv_sec, diff.tv_nsec,
+			NS_PARTS(pause),
 			smartBefore,smartAfter,smartFreed,(unsigned long long)out, smartNext);
 	}
 	return out;
 }
 
+/**
+ * Keep remembering the objects whose young objects have not been promoted yet.
+ * While an incremental collection is marking, the ones that were already
+ * scanned by it are scanned again, as they may have been written to since.
+ */
+static void pruneRemembered(void) {
+	size_t kept = 0;
+	for (size_t i = 0; i < vm.rememberedCount; ++i) {
+		KrkObj * object = vm.remembered[i];
+		if (hasYoungReferences(object)) {
+			vm.remembered[kept++] = object;
+		} else {
+			object->flags &= ~KRK_OBJ_FLAGS_GC_REMEMBERED;
+			if (gc->gcPhase == GC_MARKING && (object->flags & KRK_OBJ_FLAGS_IS_MARKED)) grayObject(object);
+		}
+	}
+	vm.rememberedCount = kept;
+}
+
+size_t krk_collectYoungGarbage(void) {
+	if (KRK_PROBE_ENABLED(gc__start)) KRK_PROBE(gc__start, 0);
+	uint64_t start = gcClock();
+	size_t bytesBefore = vm.bytesAllocated;
+
+	/* An incremental collection may have left work on the gray stack. */
+	size_t base = vm.grayCount;
+
+	gc->skipFlags = KRK_OBJ_FLAGS_IS_MARKED | KRK_OBJ_FLAGS_GC_OLD;
+	markRoots();
+
+	/* Old objects that were written to may hold the only references to young ones. */
+	_obtain_lock(gc->rememberedLock);
+	size_t remembered = vm.rememberedCount;
+	for (size_t i = 0; i < vm.rememberedCount; ++i) {
+		blackenObject(vm.remembered[i]);
+	}
+
+	traceReferences(base);
+	krk_clearWeakReferences(1);
+	size_t out = sweep(1);
+	gc->skipFlags = KRK_OBJ_FLAGS_IS_MARKED;
+	pruneRemembered();
+	_release_lock(gc->rememberedLock);
+
+	vm.nextMinorGC = vm.bytesAllocated + vm.nurserySize;
+
+	uint64_t pause = gcClock() - start;
+	recordPause(pause);
+	recordCollection(0, out, bytesFreedSince(bytesBefore), pause);
+
+	if (vm.globalFlags & KRK_GLOBAL_REPORT_GC_COLLECTS) {
+		char smartBefore[100];
+		smartSize(smartBefore, bytesBefore);
+		char smartAfter[100];
+		smartSize(smartAfter, vm.bytesAllocated);
+
+		fprintf(stderr, "[gc] minor %lld.%.9lds %s before; %s after; freed %llu objects; scanned %llu remembered\n",
+			NS_PARTS(pause),
+			smartBefore,smartAfter,(unsigned long long)out,(unsigned long long)remembered);
+	}
+	return out;
+}
+
+/* Objects are blackened or swept this many at a time between looks at the clock. */
+#define GC_STEP_OBJECTS 64
+/* Bytes allocated between incremental collection steps. */
+#define GC_STEP_INTERVAL (256 * 1024)
+
+static void startCycle(void) {
+	if (KRK_PROBE_ENABLED(gc__start)) KRK_PROBE(gc__start, 1);
+	memset(&gc->cycle, 0, sizeof(gc->cycle));
+	gc->cycle.bytesBefore = vm.bytesAllocated;
+	uint64_t start = gcClock();
+
+	gc->gcPhase = GC_MARKING;
+	gc->markingOld = 1;
+	markRoots();
+	/* Young objects are not marked until the end, but the old ones they reference are. */
+	for (KrkObj * object = vm.objects; object && !(object->flags & KRK_OBJ_FLAGS_GC_OLD); object = object->next) {
+		blackenObject(object);
+	}
+	gc->markingOld = 0;
+
+	gc->cycle.longest = gc->cycle.total = gcClock() - start;
+	recordPause(gc->cycle.total);
+}
+
+/* Returns non-zero once there is nothing left to mark. */
+static int markStep(uint64_t deadline) {
+	gc->markingOld = 1;
+	while (vm.grayCount) {
+		for (int i = 0; i < GC_STEP_OBJECTS && vm.grayCount; ++i) {
+			blackenObject(vm.grayStack[--vm.grayCount]);
+		}
+		if (gcClock() > deadline) break;
+	}
+	gc->markingOld = 0;
+	return !vm.grayCount;
+}
+
+static void sweepObject(void) {
+	KrkObj * object = *gc->sweepCursor;
+	if (object->flags & (KRK_OBJ_FLAGS_IMMORTAL | KRK_OBJ_FLAGS_IS_MARKED)) {
+		object->flags &= ~(KRK_OBJ_FLAGS_IS_MARKED | KRK_OBJ_FLAGS_SECOND_CHANCE);
+		gc->sweepCursor = &object->next;
+	} else if (object->flags & KRK_OBJ_FLAGS_SECOND_CHANCE) {
+		*gc->sweepCursor = object->next;
+		size_t before = vm.bytesAllocated;
+		freeObject(object);
+		gc->cycle.freed++;
+		gc->cycle.bytesFreed += bytesFreedSince(before);
+	} else {
+		object->flags |= KRK_OBJ_FLAGS_SECOND_CHANCE;
+		gc->sweepCursor = &object->next;
+	}
+}
+
+/* Returns non-zero once there is nothing left to sweep. */
+static int sweepStep(uint64_t deadline) {
+	while (*gc->sweepCursor) {
+		for (int i = 0; i < GC_STEP_OBJECTS && *gc->sweepCursor; ++i) {
+			sweepObject();
+		}
+		if (gcClock() > deadline) break;
+	}
+	return !*gc->sweepCursor;
+}
+
+/**
+ * Everything that was written to or allocated while marking is scanned
+ * again here: the roots, the young objects, and the remembered set.
+ * Young objects are then swept as in a minor collection, with all of the
+ * objects that reference them marked.
+ */
+static void finishMarking(void) {
+	uint64_t start = gcClock();
+
+	markRoots();
+	_obtain_lock(gc->rememberedLock);
+	for (size_t i = 0; i < vm.rememberedCount; ++i) {
+		KrkObj * object = vm.remembered[i];
+		if (object->flags & (KRK_OBJ_FLAGS_IS_MARKED | KRK_OBJ_FLAGS_IMMORTAL)) blackenObject(object);
+	}
+	traceReferences(0);
+
+	/* The rest are garbage, and so is anything young only they reference. */
+	size_t kept = 0;
+	for (size_t i = 0; i < vm.rememberedCount; ++i) {
+		KrkObj * object = vm.remembered[i];
+		if (object->flags & (KRK_OBJ_FLAGS_IS_MARKED | KRK_OBJ_FLAGS_IMMORTAL)) {
+			vm.remembered[kept++] = object;
+		} else {
+			object->flags &= ~KRK_OBJ_FLAGS_GC_REMEMBERED;
+		}
+	}
+	vm.rememberedCount = kept;
+
+	tableRemoveWhite(&vm.strings);
+	krk_clearWeakReferences(0);
+	gc->gcPhase = GC_SWEEPING;
+	size_t before = vm.bytesAllocated;
+	gc->cycle.freed += sweep(1);
+	gc->cycle.bytesFreed += bytesFreedSince(before);
+	pruneRemembered();
+	_release_lock(gc->rememberedLock);
+	vm.nextMinorGC = vm.bytesAllocated + vm.nurserySize;
+
+	/**
+	 * Minor collections relink everything in front of the first old object,
+	 * so the sweep has to continue from an old object that stays put.
+	 */
+	gc->sweepCursor = &vm.objects;
+	while (*gc->sweepCursor != gc->sweepStop) gc->sweepCursor = &(*gc->sweepCursor)->next;
+	KrkObj ** first = gc->sweepCursor;
+	while (*gc->sweepCursor && gc->sweepCursor == first) sweepObject();
+
+	gc->cycle.pause = gcClock() - start;
+}
+
+static void endCycle(void) {
+	gc->gcPhase = GC_IDLE;
+	scheduleCollection();
+	recordCollection(1, gc->cycle.freed, gc->cycle.bytesFreed, gc->cycle.longest);
+
+	if (vm.globalFlags & KRK_GLOBAL_REPORT_GC_COLLECTS) {
+		char smartBefore[100];
+		smartSize(smartBefore, gc->cycle.bytesBefore);
+		char smartAfter[100];
+		smartSize(smartAfter, vm.bytesAllocated);
+		char smartNext[100];
+		smartSize(smartNext, vm.nextGC);
+
+		fprintf(stderr, "[gc] incremental %lld.%.9lds in %zu steps, longest %lld.%.9lds, final pause %lld.%.9lds; "
+			"%s before; %s after; freed %llu objects; next collection at %s\n",
+			NS_PARTS(gc->cycle.total), gc->cycle.steps, NS_PARTS(gc->cycle.longest), NS_PARTS(gc->cycle.pause),
+			smartBefore, smartAfter, (unsigned long long)gc->cycle.freed, smartNext);
+	}
+}
+
+static void finishCycle(void) {
+	uint64_t start = gcClock();
+	if (gc->gcPhase == GC_MARKING) finishMarking();
+	while (*gc->sweepCursor) sweepObject();
+	uint64_t took = gcClock() - start;
+	recordPause(took);
+	gc->cycle.total += took;
+	if (took > gc->cycle.longest) gc->cycle.longest = took;
+	endCycle();
+}
+
+static void incrementalStep(void) {
+	uint64_t start = gcClock();
+
+	/* Don't let the heap grow without bound if the program allocates faster than we collect. */
+	if (!vm.gcStepBudget || vm.bytesAllocated > vm.nextGC + vm.nextGC / 2) {
+		finishCycle();
+		return;
+	}
+
+	uint64_t deadline = start + (uint64_t)vm.gcStepBudget * 1000;
+	if (gc->gcPhase == GC_MARKING) {
+		if (markStep(deadline)) finishMarking();
+	} else if (sweepStep(deadline)) {
+		gc->gcPhase = GC_IDLE;
+	}
+
+	uint64_t took = gcClock() - start;
+	recordPause(took);
+	gc->cycle.steps++;
+	gc->cycle.total += took;
+	if (took > gc->cycle.longest) gc->cycle.longest = took;
+	if (gc->gcPhase == GC_IDLE) endCycle();
+	vm.nextGCStep = vm.bytesAllocated + GC_STEP_INTERVAL;
+}
+
+static void collectAsNeeded(void) {
+#ifndef KRK_NO_STRESS_GC
+	if (vm.globalFlags & KRK_GLOBAL_ENABLE_STRESS_GC) {
+		krk_collectYoungGarbage();
+	}
+#endif
+	if (gc->gcPhase != GC_IDLE) {
+		if (vm.bytesAllocated > vm.nextGCStep) incrementalStep();
+	} else if (vm.bytesAllocated > vm.nextGC) {
+		if (vm.gcStepBudget) {
+			startCycle();
+			vm.nextGCStep = vm.bytesAllocated + GC_STEP_INTERVAL;
+		} else {
+			krk_collectGarbage();
+		}
+	}
+	if (vm.bytesAllocated > vm.nextMinorGC) {
+		krk_collectYoungGarbage();
+	}
+}
+
+#ifdef ENABLE_THREADING
+/*
+ * Stopping the world.
+ *
+ * Once a second thread has started, a thread that finds a collection is due
+ * while allocating can not simply run it: other threads may be halfway
+ * through changing objects, and the allocating thread may itself be inside a
+ * native method holding a lock one of them is waiting on. Instead, it sets
+ * @c vm.safepointRequested and carries on. Every thread checks that flag at
+ * its safepoints - backward jumps, calls, and returns in the interpreter loop,
+ * where it holds no locks and all of its values are on its stack - and the
+ * first one to get there waits for the others to park and then collects.
+ *
+ * A thread waiting in a blocking call between @ref krk_beginBlocking and
+ * @ref krk_endBlocking counts as parked, so a thread sitting in @c join() or
+ * @c sleep() does not hold up collections.
+ */
+static int collectionDue(void) {
+#ifndef KRK_NO_STRESS_GC
+	if (vm.globalFlags & KRK_GLOBAL_ENABLE_STRESS_GC) return 1;
+#endif
+	if (gc->gcPhase != GC_IDLE) {
+		if (vm.bytesAllocated > vm.nextGCStep) return 1;
+	} else if (vm.bytesAllocated > vm.nextGC) {
+		return 1;
+	}
+	return vm.bytesAllocated > vm.nextMinorGC;
+}
+
+static int othersParked(void) {
+	for (KrkThreadState * thread = vm.threads; thread; thread = thread->next) {
+		if (thread != &krk_currentThread && !thread->parked) return 0;
+	}
+	return 1;
+}
+
+/**
+ * Returns 1 once every other thread is parked, or 0 if another thread
+ * was already stopping the world, in which case this one was parked
+ * until it finished.
+ */
+static int stopTheWorld(void) {
+	pthread_mutex_lock(&gc->safepointLock);
+	if (gc->worldStopped) {
+		krk_currentThread.parked = 1;
+		pthread_cond_broadcast(&gc->threadParked);
+		while (gc->worldStopped) pthread_cond_wait(&gc->worldResumed, &gc->safepointLock);
+		krk_currentThread.parked = 0;
+		pthread_mutex_unlock(&gc->safepointLock);
+		return 0;
+	}
+	gc->worldStopped = 1;
+	vm.safepointRequested = 1;
+	while (!othersParked()) pthread_cond_wait(&gc->threadParked, &gc->safepointLock);
+	for (KrkThreadState * thread = vm.threads; thread; thread = thread->next) {
+		gatherObjects(thread);
+	}
+	gc->collectingThread = &krk_currentThread;
+	pthread_mutex_unlock(&gc->safepointLock);
+	return 1;
+}
+
+static void resumeTheWorld(void) {
+	pthread_mutex_lock(&gc->safepointLock);
+	gc->collectingThread = NULL;
+	gc->worldStopped = 0;
+	vm.safepointRequested = 0;
+	pthread_cond_broadcast(&gc->worldResumed);
+	pthread_mutex_unlock(&gc->safepointLock);
+}
+
+void krk_safepoint(void) {
+	if (stopTheWorld()) {
+		collectAsNeeded();
+		resumeTheWorld();
+	}
+}
+
+void krk_beginBlocking(void) {
+	if (!(vm.globalFlags & KRK_GLOBAL_THREADS)) return;
+	pthread_mutex_lock(&gc->safepointLock);
+	krk_currentThread.parked = 1;
+	pthread_cond_broadcast(&gc->threadParked);
+	pthread_mutex_unlock(&gc->safepointLock);
+}
+
+void krk_endBlocking(void) {
+	if (!krk_currentThread.parked) return;
+	pthread_mutex_lock(&gc->safepointLock);
+	while (gc->worldStopped) pthread_cond_wait(&gc->worldResumed, &gc->safepointLock);
+	krk_currentThread.parked = 0;
+	pthread_mutex_unlock(&gc->safepointLock);
+}
+
+void krk_attachThread(void) {
+	pthread_mutex_lock(&gc->safepointLock);
+	while (gc->worldStopped) pthread_cond_wait(&gc->worldResumed, &gc->safepointLock);
+	krk_currentThread.next = vm.threads->next;
+	vm.threads->next = &krk_currentThread;
+	pthread_mutex_unlock(&gc->safepointLock);
+}
+
+void krk_detachThread(void) {
+	pthread_mutex_lock(&gc->safepointLock);
+	/* What this thread allocated can only join the heap while nothing is collecting. */
+	krk_currentThread.parked = 1;
+	pthread_cond_broadcast(&gc->threadParked);
+	while (gc->worldStopped) pthread_cond_wait(&gc->worldResumed, &gc->safepointLock);
+	gatherObjects(&krk_currentThread);
+	for (KrkThreadState * previous = vm.threads; previous; previous = previous->next) {
+		if (previous->next == &krk_currentThread) {
+			previous->next = krk_currentThread.next;
+			break;
+		}
+	}
+	/* Whoever is stopping the world may be waiting on this thread. */
+	pthread_cond_broadcast(&gc->threadParked);
+	pthread_mutex_unlock(&gc->safepointLock);
+	krk_slabReleaseCache();
+}
+
+void krk_gcGatherObjects(void) {
+	if (vm.globalFlags & KRK_GLOBAL_THREADS) {
+		while (!stopTheWorld());
+		resumeTheWorld();
+	}
+}
+#else
+void krk_gcGatherObjects(void) { }
+
+void krk_safepoint(void) {
+	vm.safepointRequested = 0;
+	collectAsNeeded();
+}
+#endif
+
+static void collectWhenSafe(void) {
+#ifdef ENABLE_THREADING
+	if (vm.globalFlags & KRK_GLOBAL_THREADS) {
+		if (collectionDue()) vm.safepointRequested = 1;
+		return;
+	}
+#endif
+	collectAsNeeded();
+}
+
+static size_t collectNow(int generation) {
+#ifdef ENABLE_THREADING
+	if (vm.globalFlags & KRK_GLOBAL_THREADS) {
+		while (!stopTheWorld());
+		size_t count = generation ? krk_collectGarbage() : krk_collectYoungGarbage();
+		resumeTheWorld();
+		return count;
+	}
+#endif
+	return generation ? krk_collectGarbage() : krk_collectYoungGarbage();
+}
+
+static const char * objectTypeNames[] = {
+	[KRK_OBJ_CODEOBJECT] = "codeobject",
+	[KRK_OBJ_NATIVE] = "native",
+	[KRK_OBJ_CLOSURE] = "closure",
+	[KRK_OBJ_STRING] = "string",
+	[KRK_OBJ_UPVALUE] = "upvalue",
+	[KRK_OBJ_CLASS] = "class",
+	[KRK_OBJ_INSTANCE] = "instance",
+	[KRK_OBJ_BOUND_METHOD] = "bound_method",
+	[KRK_OBJ_TUPLE] = "tuple",
+	[KRK_OBJ_BYTES] = "bytes",
+};
+#define OBJECT_TYPES (sizeof(objectTypeNames) / sizeof(*objectTypeNames))
+
+/*
+ * Heap dumps.
+ *
+ * gc.dump_heap writes the heap as JSON lines: first the roots, as
+ * {"roots": [ids]}, then one line for each object with its id, object
+ * type, class name, size as reported by sys.getsizeof, and the ids of
+ * the objects it references. Ids are addresses, written as strings.
+ * References are found by running blackenObject with krk_markObject
+ * collecting them instead of marking anything.
+ */
+static void addDumpReference(KrkObj * object) {
+	if (gc->dumpCapacity < gc->dumpCount + 1) {
+		gc->dumpCapacity = GROW_CAPACITY(gc->dumpCapacity);
+		gc->dumpReferences = realloc(gc->dumpReferences, sizeof(KrkObj*) * gc->dumpCapacity);
+		if (!gc->dumpReferences) exit(1);
+	}
+	gc->dumpReferences[gc->dumpCount++] = object;
+}
+
+static void dumpString(FILE * out, const char * chars, size_t length) {
+	fputc('"', out);
+	for (size_t i = 0; i < length; ++i) {
+		unsigned char c = chars[i];
+		if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+		else if (c < 0x20) fprintf(out, "\\u%04x", c);
+		else fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+static void dumpReferenceList(FILE * out) {
+	fputc('[', out);
+	for (size_t i = 0; i < gc->dumpCount; ++i) {
+		fprintf(out, i ? ",\"%p\"" : "\"%p\"", (void*)gc->dumpReferences[i]);
+	}
+	fputc(']', out);
+	gc->dumpCount = 0;
+}
+
+static size_t dumpHeap(FILE * out) {
+	gc->dumpingHeap = 1;
+	markRoots();
+	fputs("{\"roots\":", out);
+	dumpReferenceList(out);
+	fputs("}\n", out);
+
+	size_t count = 0;
+	for (KrkObj * object = vm.objects; object; object = object->next) {
+		blackenObject(object);
+		KrkClass * type = krk_getType(OBJECT_VAL(object));
+		fprintf(out, "{\"id\":\"%p\",\"type\":\"%s\",\"class\":", (void*)object, objectTypeNames[object->type]);
+		dumpString(out, type->name->chars, type->name->length);
+		fprintf(out, ",\"size\":%zu,\"refs\":", krk_sizeOfObject(object));
+		dumpReferenceList(out);
+		fputs("}\n", out);
+		count++;
+	}
+	gc->dumpingHeap = 0;
+	return count;
+}
+
+static size_t dumpHeapNow(FILE * out) {
+#ifdef ENABLE_THREADING
+	if (vm.globalFlags & KRK_GLOBAL_THREADS) {
+		while (!stopTheWorld());
+		size_t count = dumpHeap(out);
+		resumeTheWorld();
+		return count;
+	}
+#endif
+	return dumpHeap(out);
+}
+
+KRK_FUNC(dump_heap,{
+	FUNCTION_TAKES_EXACTLY(1);
+	CHECK_ARG(0,str,KrkString*,path);
+	FILE * out = fopen(path->chars, "w");
+	if (!out) return krk_runtimeError(vm.exceptions->ioError, "dump_heap: failed to open file; system returned: %s", strerror(errno));
+	size_t count = dumpHeapNow(out);
+	fclose(out);
+	return INTEGER_VAL(count);
+})
+
+void krk_runGCCallbacks(void) {
+	krk_currentThread.flags &= ~KRK_THREAD_GC_CALLBACKS;
+	krk_runWeakReferenceCallbacks();
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return;
+	if (runningCallbacks || !gc->gcModule) return;
+
+	KrkValue callbacks;
+	if (!krk_tableGet_fast(&gc->gcModule->fields, S("callbacks"), &callbacks) || !IS_list(callbacks) || !AS_LIST(callbacks)->count) return;
+
+	/* Building the dict may collect again, which is not reported. */
+	runningCallbacks = 1;
+	int generation = gc->gcStats.lastGeneration;
+	size_t objects = gc->gcStats.lastObjects;
+	size_t bytes = gc->gcStats.lastBytes;
+	uint64_t pause = gc->gcStats.lastPause;
+
+	krk_push(callbacks);
+	KrkValue info = krk_dict_of(0, NULL, 0);
+	krk_push(info);
+	krk_attachNamedValue(AS_DICT(info), "generation", INTEGER_VAL(generation));
+	krk_attachNamedValue(AS_DICT(info), "collected", INTEGER_VAL(objects));
+	krk_attachNamedValue(AS_DICT(info), "freed_bytes", INTEGER_VAL(bytes));
+	krk_attachNamedValue(AS_DICT(info), "pause", FLOATING_VAL(pause / 1e9));
+
+	/* Callbacks may add or remove callbacks. */
+	for (size_t i = 0; i < AS_LIST(callbacks)->count; ++i) {
+		krk_push(AS_LIST(callbacks)->values[i]);
+		krk_push(info);
+		krk_callStack(1);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) break;
+	}
+
+	krk_pop();
+	krk_pop();
+	runningCallbacks = 0;
+}
+
 KRK_FUNC(collect,{
+	FUNCTION_TAKES_AT_MOST(1);
+	krk_integer_type generation = 1;
+	if (argc > 0) {
+		CHECK_ARG(0,int,krk_integer_type,_generation);
+		generation = _generation;
+	}
+	if (generation != 0 && generation != 1) return krk_runtimeError(vm.exceptions->valueError, "invalid generation");
+	return INTEGER_VAL(collectNow(generation));
+})
+
+KRK_FUNC(get_nursery_size,{
+	FUNCTION_TAKES_NONE();
+	return INTEGER_VAL(vm.nurserySize);
+})
+
+KRK_FUNC(set_nursery_size,{
+	FUNCTION_TAKES_EXACTLY(1);
+	CHECK_ARG(0,int,krk_integer_type,size);
+	if (size <= 0) return krk_runtimeError(vm.exceptions->valueError, "nursery size must be positive");
+	vm.nurserySize = size;
+	vm.nextMinorGC = vm.bytesAllocated + vm.nurserySize;
+})
+
+KRK_FUNC(get_step_budget,{
+	FUNCTION_TAKES_NONE();
+	return INTEGER_VAL(vm.gcStepBudget);
+})
+
+KRK_FUNC(set_step_budget,{
+	FUNCTION_TAKES_EXACTLY(1);
+	CHECK_ARG(0,int,krk_integer_type,budget);
+	if (budget < 0) return krk_runtimeError(vm.exceptions->valueError, "step budget must not be negative");
+	vm.gcStepBudget = budget;
+})
+
+KRK_FUNC(get_threads,{
+	FUNCTION_TAKES_NONE();
+	return INTEGER_VAL(vm.gcThreads);
+})
+
+KRK_FUNC(set_threads,{
+	FUNCTION_TAKES_EXACTLY(1);
+	CHECK_ARG(0,int,krk_integer_type,threads);
+	if (threads <= 0) return krk_runtimeError(vm.exceptions->valueError, "thread count must be positive");
+	vm.gcThreads = threads < GC_MAX_THREADS ? threads : GC_MAX_THREADS;
+})
+
+KRK_FUNC(get_heap_growth,{
+	FUNCTION_TAKES_NONE();
+	return FLOATING_VAL(vm.heapGrowth);
+})
+
+KRK_FUNC(set_heap_growth,{
+	FUNCTION_TAKES_EXACTLY(1);
+	if (!IS_INTEGER(argv[0]) && !IS_FLOATING(argv[0])) return TYPE_ERROR(int or float,argv[0]);
+	double growth = IS_INTEGER(argv[0]) ? (double)AS_INTEGER(argv[0]) : AS_FLOATING(argv[0]);
+	if (!(growth > 1.0)) return krk_runtimeError(vm.exceptions->valueError, "heap growth must be greater than 1");
+	vm.heapGrowth = growth;
+})
+
+KRK_FUNC(get_min_heap,{
 	FUNCTION_TAKES_NONE();
-	if (&krk_currentThread != vm.threads) return krk_runtimeError(vm.exceptions->valueError, "only the main thread can do that");
-	return INTEGER_VAL(krk_collectGarbage());
+	return INTEGER_VAL(vm.minHeap);
+})
+
+KRK_FUNC(set_min_heap,{
+	FUNCTION_TAKES_EXACTLY(1);
+	CHECK_ARG(0,int,krk_integer_type,size);
+	if (size < 0) return krk_runtimeError(vm.exceptions->valueError, "minimum heap size must not be negative");
+	vm.minHeap = size;
+	if (gc->gcPhase == GC_IDLE && vm.nextGC < vm.minHeap) vm.nextGC = vm.minHeap;
+})
+
+KRK_FUNC(get_max_heap_growth,{
+	FUNCTION_TAKES_NONE();
+	return INTEGER_VAL(vm.maxHeapGrowth);
+})
+
+KRK_FUNC(set_max_heap_growth,{
+	FUNCTION_TAKES_EXACTLY(1);
+	CHECK_ARG(0,int,krk_integer_type,size);
+	if (size <= 0) return krk_runtimeError(vm.exceptions->valueError, "maximum heap growth must be positive");
+	vm.maxHeapGrowth = size;
+})
+
+KRK_FUNC(get_stats,{
+	FUNCTION_TAKES_NONE();
+	krk_gcGatherObjects();
+	KrkValue stats = krk_dict_of(0, NULL, 0);
+	krk_push(stats);
+	krk_attachNamedValue(AS_DICT(stats), "collections", INTEGER_VAL(gc->gcStats.collections));
+	krk_attachNamedValue(AS_DICT(stats), "minor_collections", INTEGER_VAL(gc->gcStats.minorCollections));
+	krk_attachNamedValue(AS_DICT(stats), "pause_total", FLOATING_VAL(gc->gcStats.pauseTotal / 1e9));
+	krk_attachNamedValue(AS_DICT(stats), "pause_last", FLOATING_VAL(gc->gcStats.pauseLast / 1e9));
+	krk_attachNamedValue(AS_DICT(stats), "pause_max", FLOATING_VAL(gc->gcStats.pauseMax / 1e9));
+	krk_attachNamedValue(AS_DICT(stats), "objects_freed", INTEGER_VAL(gc->gcStats.objectsFreed));
+	krk_attachNamedValue(AS_DICT(stats), "bytes_freed", INTEGER_VAL(gc->gcStats.bytesFreed));
+	krk_attachNamedValue(AS_DICT(stats), "bytes_allocated", INTEGER_VAL(vm.bytesAllocated));
+	krk_attachNamedValue(AS_DICT(stats), "next_collection", INTEGER_VAL(vm.nextGC));
+	KrkValue histogram = krk_list_of(0, NULL, 0);
+	krk_push(histogram);
+	for (size_t i = 0; i < GC_PAUSE_BUCKETS; ++i) {
+		krk_writeValueArray(AS_LIST(histogram), INTEGER_VAL(gc->gcStats.pauseHistogram[i]));
+	}
+	krk_attachNamedValue(AS_DICT(stats), "pause_histogram", histogram);
+	krk_pop();
+	return krk_pop();
+})
+
+KRK_FUNC(count_objects,{
+	FUNCTION_TAKES_NONE();
+	size_t counts[OBJECT_TYPES] = {0};
+	krk_gcGatherObjects();
+	/* This may include some garbage that is yet to be swept. */
+	for (KrkObj * object = vm.objects; object; object = object->next) {
+		counts[object->type]++;
+	}
+	KrkValue out = krk_dict_of(0, NULL, 0);
+	krk_push(out);
+	for (size_t i = 0; i < OBJECT_TYPES; ++i) {
+		krk_attachNamedValue(AS_DICT(out), objectTypeNames[i], INTEGER_VAL(counts[i]));
+	}
+	return krk_pop();
 })
 
 KRK_FUNC(pause,{
@@ -582,13 +1910,77 @@ void _createAndBind_gcMod(void) {
 	 * Namespace for methods for controlling the garbage collector.
 	 */
 	KrkInstance * gcModule = krk_newInstance(vm.baseClasses->moduleClass);
+	gc->gcModule = gcModule;
 	krk_attachNamedObject(&vm.modules, "gc", (KrkObj*)gcModule);
 	krk_attachNamedObject(&gcModule->fields, "__name__", (KrkObj*)S("gc"));
 	krk_attachNamedValue(&gcModule->fields, "__file__", NONE_VAL());
 	KRK_DOC(gcModule, "@brief Namespace containing methods for controlling the garbage collector.");
+	/* Functions called with a dict describing each collection after it finishes. */
+	krk_push(krk_list_of(0, NULL, 0));
+	krk_attachNamedValue(&gcModule->fields, "callbacks", krk_peek(0));
+	krk_pop();
 
 	KRK_DOC(BIND_FUNC(gcModule,collect),
-		"@brief Triggers one cycle of garbage collection.");
+		"@brief Triggers one cycle of garbage collection.\n"
+		"@arguments generation=1\n\n"
+		"With @p generation of @c 0, only objects allocated since the last collection are collected. "
+		"Otherwise, all objects are. Returns the number of objects freed.");
+	KRK_DOC(BIND_FUNC(gcModule,get_nursery_size),
+		"@brief Returns the number of bytes allocated between minor collections.");
+	KRK_DOC(BIND_FUNC(gcModule,set_nursery_size),
+		"@brief Sets the number of bytes allocated between minor collections.\n"
+		"@arguments size");
+	KRK_DOC(BIND_FUNC(gcModule,get_step_budget),
+		"@brief Returns the number of microseconds each step of an incremental collection may take.");
+	KRK_DOC(BIND_FUNC(gcModule,set_step_budget),
+		"@brief Makes full collections incremental.\n"
+		"@arguments budget\n\n"
+		"With a @p budget greater than @c 0, full collections are started in the background when they are due, "
+		"and continue in steps of about @p budget microseconds as more memory is allocated. "
+		"A @p budget of @c 0 collects all at once, which is the default.");
+	KRK_DOC(BIND_FUNC(gcModule,get_threads),
+		"@brief Returns the number of threads that take part in a collection.");
+	KRK_DOC(BIND_FUNC(gcModule,set_threads),
+		"@brief Sets the number of threads that take part in a collection.\n"
+		"@arguments threads\n\n"
+		"Collections of large heaps are marked and freed by up to @p threads threads, "
+		"counting the one that is collecting, which defaults to the number of processors up to @c 8. "
+		"A value of @c 1 collects on the collecting thread alone.");
+	KRK_DOC(BIND_FUNC(gcModule,get_heap_growth),
+		"@brief Returns the factor by which the heap may grow before the next full collection.");
+	KRK_DOC(BIND_FUNC(gcModule,set_heap_growth),
+		"@brief Sets the factor by which the heap may grow before the next full collection.\n"
+		"@arguments growth\n\n"
+		"After a full collection, the next one is due once the heap reaches @p growth times what survived "
+		"it, which defaults to @c 2.0.");
+	KRK_DOC(BIND_FUNC(gcModule,get_min_heap),
+		"@brief Returns the heap size in bytes below which full collections are not started.");
+	KRK_DOC(BIND_FUNC(gcModule,set_min_heap),
+		"@brief Sets the heap size in bytes below which full collections are not started.\n"
+		"@arguments size");
+	KRK_DOC(BIND_FUNC(gcModule,get_max_heap_growth),
+		"@brief Returns the most bytes the heap may grow by between full collections.");
+	KRK_DOC(BIND_FUNC(gcModule,set_max_heap_growth),
+		"@brief Sets the most bytes the heap may grow by between full collections.\n"
+		"@arguments size\n\n"
+		"This caps the growth factor for large heaps, so they are not left to double before they are collected.");
+	KRK_DOC(BIND_FUNC(gcModule,get_stats),
+		"@brief Returns a dict of statistics about the collections so far.\n\n"
+		"The counts of full and minor collections are in @c collections and @c minor_collections. "
+		"@c pause_total, @c pause_last, and @c pause_max are in seconds, and @c pause_histogram counts "
+		"pauses of under 10us, 100us, 1ms, 10ms, 100ms, 1s, and longer. "
+		"@c objects_freed and @c bytes_freed are running totals. "
+		"@c bytes_allocated is the current heap size and @c next_collection is the size at which "
+		"the next full collection is due.");
+	KRK_DOC(BIND_FUNC(gcModule,count_objects),
+		"@brief Returns a dict of the number of objects on the heap for each object type.\n\n"
+		"Objects that have become unreachable since the last collection are included.");
+	KRK_DOC(BIND_FUNC(gcModule,dump_heap),
+		"@brief Writes a snapshot of the heap to a file.\n"
+		"@arguments path\n\n"
+		"The file gets a line of JSON listing the roots, followed by a line for each object with its "
+		"@c id, @c type, @c class, @c size, and the ids of the objects it references in @c refs. "
+		"@c tools/heapsummary.krk summarizes what a snapshot's objects retain. Returns the number of objects written.");
 	KRK_DOC(BIND_FUNC(gcModule,pause),
 		"@brief Disables automatic garbage collection until @ref resume is called.");
 	KRK_DOC(BIND_FUNC(gcModule,resume),
@@ -0,0 +1,1505 @@
+/**
+ * @file    module__asyncio.c
+ * @brief   Native event loop, futures and tasks for the @c asyncio module.
+ *
+ * An event loop keeps three queues: handles that are ready to run, a heap of
+ * timers ordered by when they are due, and the readers and writers waiting
+ * on file descriptors. Each pass of the loop waits in the system's readiness
+ * interface - epoll on Linux, kqueue on the BSDs and macOS, and poll()
+ * elsewhere - for no longer than the soonest timer, moves whatever became
+ * ready onto the ready queue, and runs what was ready when the pass began.
+ *
+ * A task drives a coroutine: each step sends it @c None, and it comes back
+ * with the future it is waiting on, which wakes the task again once it's
+ * done. Awaiting a future yields it once and then gives its result, or raises
+ * its exception, in the coroutine that awaited it.
+ *
+ * File descriptors the readiness interface can't watch, such as regular
+ * files under epoll, are treated as always ready.
+ */
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+# define LOOP_EPOLL
+# include <sys/epoll.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__) || defined(__DragonFly__)
+# define LOOP_KQUEUE
+# include <sys/types.h>
+# include <sys/event.h>
+# include <sys/time.h>
+#else
+# define LOOP_POLL
+# include <poll.h>
+#endif
+
+#include <kuroko/vm.h>
+#include <kuroko/memory.h>
+#include <kuroko/util.h>
+
+static KrkVMLocal moduleKey;
+#define module KRK_VM_LOCAL(KrkInstance*,moduleKey)
+
+static KrkVMLocal eventLoopKey;
+#define EventLoopClass KRK_VM_LOCAL(KrkClass*,eventLoopKey)
+static KrkVMLocal handleKey;
+#define HandleClass KRK_VM_LOCAL(KrkClass*,handleKey)
+static KrkVMLocal futureKey;
+#define FutureClass KRK_VM_LOCAL(KrkClass*,futureKey)
+static KrkVMLocal futureIterKey;
+#define FutureIterClass KRK_VM_LOCAL(KrkClass*,futureIterKey)
+static KrkVMLocal taskKey;
+#define TaskClass KRK_VM_LOCAL(KrkClass*,taskKey)
+
+static KrkVMLocal cancelledErrorKey;
+#define CancelledError KRK_VM_LOCAL(KrkClass*,cancelledErrorKey)
+static KrkVMLocal invalidStateErrorKey;
+#define InvalidStateError KRK_VM_LOCAL(KrkClass*,invalidStateErrorKey)
+static KrkVMLocal timeoutErrorKey;
+#define TimeoutError KRK_VM_LOCAL(KrkClass*,timeoutErrorKey)
+
+/** The loop whose @c run_forever is running, or None. */
+static KrkVMLocal runningLoopKey;
+#define runningLoop KRK_VM_LOCAL(KrkValue,runningLoopKey)
+
+/** Readiness events waited for at once. */
+#define LOOP_EVENTS 1024
+
+enum { WATCH_READ = 1, WATCH_WRITE = 2 };
+
+/**
+ * @brief What is waiting on one file descriptor.
+ */
+struct Watch {
+	KrkValue reader;   /**< Handle to run when readable, or None */
+	KrkValue writer;   /**< Handle to run when writable, or None */
+	int events;        /**< WATCH_ bits the poller was last told about */
+	int always;        /**< The poller can't watch this descriptor, so it is always ready */
+};
+
+/**
+ * @brief Event loop.
+ * @extends KrkInstance
+ */
+struct EventLoop {
+	KrkInstance inst;
+	KrkValueArray ready;    /**< Handles to run, from @c readyHead on */
+	size_t readyHead;
+	KrkValueArray timers;   /**< Binary heap of timer handles, soonest first */
+	struct Watch * watches; /**< Indexed by file descriptor */
+	size_t watchSpace;
+	size_t watching;        /**< Descriptors with a reader or writer */
+	size_t alwaysReady;     /**< Of those, how many are always ready */
+	uint64_t sequence;      /**< Orders timers that are due at the same time */
+	int pollfd;             /**< epoll or kqueue descriptor */
+	int initialized;
+	int running;
+	int stopping;
+	int closed;
+};
+
+/**
+ * @brief A callback scheduled on an event loop.
+ * @extends KrkInstance
+ *
+ * The callback may also be a task, which is stepped, or a future, which
+ * is done with the first of @c args as its result, unless it is done already.
+ */
+struct Handle {
+	KrkInstance inst;
+	KrkValue callback;
+	KrkValue args;          /**< Tuple, or None */
+	double when;
+	uint64_t sequence;
+	int cancelled;
+};
+
+enum { FUTURE_PENDING, FUTURE_FINISHED, FUTURE_CANCELLED };
+
+/**
+ * @brief Eventual result of an asynchronous operation.
+ * @extends KrkInstance
+ */
+struct Future {
+	KrkInstance inst;
+	KrkValue loop;
+	KrkValue result;
+	KrkValue exception;     /**< None, or what @c result() raises */
+	KrkValue callbacks;     /**< List of what to call when done, or None */
+	int state;
+};
+
+/**
+ * @brief Future for the result of a coroutine, which it runs.
+ * @extends Future
+ */
+struct Task {
+	struct Future future;
+	KrkValue coro;
+	KrkValue send;          /**< The coroutine's bound @c send */
+	KrkValue waiting;       /**< Future the coroutine is waiting on, or None */
+	int mustCancel;
+};
+
+/**
+ * @brief What awaiting a future iterates.
+ * @extends KrkInstance
+ */
+struct FutureIter {
+	KrkInstance inst;
+	KrkValue future;
+};
+
+#define IS_EventLoop(o) (krk_isInstanceOf(o,EventLoopClass))
+#define AS_EventLoop(o) ((struct EventLoop*)AS_OBJECT(o))
+#define IS_Handle(o) (krk_isInstanceOf(o,HandleClass))
+#define AS_Handle(o) ((struct Handle*)AS_OBJECT(o))
+#define IS_Future(o) (krk_isInstanceOf(o,FutureClass))
+#define AS_Future(o) ((struct Future*)AS_OBJECT(o))
+#define IS_FutureIter(o) (krk_isInstanceOf(o,FutureIterClass))
+#define AS_FutureIter(o) ((struct FutureIter*)AS_OBJECT(o))
+#define IS_Task(o) (krk_isInstanceOf(o,TaskClass))
+#define AS_Task(o) ((struct Task*)AS_OBJECT(o))
+
+static double monotonic(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec / 1000000000.0;
+}
+
+static void _EventLoop_gcscan(KrkInstance * _self) {
+	struct EventLoop * self = (struct EventLoop*)_self;
+	for (size_t i = self->readyHead; i < self->ready.count; ++i) krk_markValue(self->ready.values[i]);
+	for (size_t i = 0; i < self->timers.count; ++i) krk_markValue(self->timers.values[i]);
+	for (size_t i = 0; i < self->watchSpace; ++i) {
+		krk_markValue(self->watches[i].reader);
+		krk_markValue(self->watches[i].writer);
+	}
+}
+
+static void _EventLoop_gcsweep(KrkInstance * _self) {
+	struct EventLoop * self = (struct EventLoop*)_self;
+	krk_freeValueArray(&self->ready);
+	krk_freeValueArray(&self->timers);
+	free(self->watches);
+	if (self->initialized && self->pollfd >= 0) close(self->pollfd);
+}
+
+static void _Handle_gcscan(KrkInstance * _self) {
+	struct Handle * self = (struct Handle*)_self;
+	krk_markValue(self->callback);
+	krk_markValue(self->args);
+}
+
+static void _Future_gcscan(KrkInstance * _self) {
+	struct Future * self = (struct Future*)_self;
+	krk_markValue(self->loop);
+	krk_markValue(self->result);
+	krk_markValue(self->exception);
+	krk_markValue(self->callbacks);
+}
+
+static void _Task_gcscan(KrkInstance * _self) {
+	struct Task * self = (struct Task*)_self;
+	_Future_gcscan(_self);
+	krk_markValue(self->coro);
+	krk_markValue(self->send);
+	krk_markValue(self->waiting);
+}
+
+static void _FutureIter_gcscan(KrkInstance * _self) {
+	krk_markValue(((struct FutureIter*)_self)->future);
+}
+
+/**
+ * Take the exception being raised, so it can be kept in a future.
+ */
+static KrkValue takeException(void) {
+	KrkValue exception = krk_currentThread.currentException;
+	krk_currentThread.currentException = NONE_VAL();
+	krk_currentThread.flags &= ~KRK_THREAD_HAS_EXCEPTION;
+	return exception;
+}
+
+/**
+ * Raise @p exception, which was raised before and kept in a future.
+ */
+static KrkValue raiseException(KrkValue exception) {
+	krk_currentThread.currentException = exception;
+	krk_currentThread.flags |= KRK_THREAD_HAS_EXCEPTION;
+	return NONE_VAL();
+}
+
+/**
+ * @name Scheduling
+ * @{
+ */
+
+static struct Handle * newHandle(KrkValue callback, KrkValue args, double when) {
+	struct Handle * handle = (struct Handle*)krk_newInstance(HandleClass);
+	handle->callback = callback;
+	handle->args = args;
+	handle->when = when;
+	return handle;
+}
+
+static void schedule(struct EventLoop * self, KrkValue handle) {
+	krk_writeValueArray(&self->ready, handle);
+	krk_gcWriteBarrier((KrkObj*)self);
+}
+
+/** Schedule @p callback to be called soon with the values of @p args, a tuple or None. */
+static KrkValue callSoon(struct EventLoop * self, KrkValue callback, KrkValue args) {
+	krk_push(args);
+	struct Handle * handle = newHandle(callback, args, 0);
+	krk_push(OBJECT_VAL(handle));
+	schedule(self, OBJECT_VAL(handle));
+	krk_pop();
+	krk_pop();
+	return OBJECT_VAL(handle);
+}
+
+static int timerBefore(KrkValue a, KrkValue b) {
+	struct Handle * x = AS_Handle(a);
+	struct Handle * y = AS_Handle(b);
+	return x->when < y->when || (x->when == y->when && x->sequence < y->sequence);
+}
+
+static void timerPush(struct EventLoop * self, KrkValue handle) {
+	AS_Handle(handle)->sequence = self->sequence++;
+	krk_writeValueArray(&self->timers, handle);
+	krk_gcWriteBarrier((KrkObj*)self);
+	KrkValue * heap = self->timers.values;
+	size_t i = self->timers.count - 1;
+	while (i > 0) {
+		size_t parent = (i - 1) / 2;
+		if (!timerBefore(heap[i], heap[parent])) break;
+		KrkValue tmp = heap[i]; heap[i] = heap[parent]; heap[parent] = tmp;
+		i = parent;
+	}
+}
+
+static KrkValue timerPop(struct EventLoop * self) {
+	KrkValue * heap = self->timers.values;
+	KrkValue top = heap[0];
+	heap[0] = heap[--self->timers.count];
+	size_t i = 0, count = self->timers.count;
+	while (1) {
+		size_t child = 2 * i + 1;
+		if (child >= count) break;
+		if (child + 1 < count && timerBefore(heap[child+1], heap[child])) child++;
+		if (!timerBefore(heap[child], heap[i])) break;
+		KrkValue tmp = heap[i]; heap[i] = heap[child]; heap[child] = tmp;
+		i = child;
+	}
+	return top;
+}
+
+/** @} */
+
+/**
+ * @name Readiness
+ *
+ * The poller is told which of @c WATCH_READ and @c WATCH_WRITE each
+ * descriptor is waited on for whenever that changes.
+ * @{
+ */
+
+static int pollerOpen(void) {
+#if defined(LOOP_EPOLL)
+	return epoll_create1(EPOLL_CLOEXEC);
+#elif defined(LOOP_KQUEUE)
+	return kqueue();
+#else
+	return -2;
+#endif
+}
+
+static const char * pollerName(void) {
+#if defined(LOOP_EPOLL)
+	return "epoll";
+#elif defined(LOOP_KQUEUE)
+	return "kqueue";
+#else
+	return "poll";
+#endif
+}
+
+/**
+ * Tell the poller that @p fd is now waited on for @p want.
+ * Returns -1, with @c errno set, if it can't be.
+ */
+static int pollerUpdate(struct EventLoop * self, int fd, int want) {
+	struct Watch * watch = &self->watches[fd];
+	if (watch->always) {
+		if (!want) {
+			watch->always = 0;
+			self->alwaysReady--;
+		}
+		return 0;
+	}
+	if (want == watch->events) return 0;
+#if defined(LOOP_EPOLL)
+	struct epoll_event event = {0};
+	event.events = ((want & WATCH_READ) ? EPOLLIN : 0) | ((want & WATCH_WRITE) ? EPOLLOUT : 0);
+	event.data.fd = fd;
+	if (!want) {
+		/* A descriptor that was closed has already left the set. */
+		epoll_ctl(self->pollfd, EPOLL_CTL_DEL, fd, &event);
+	} else if (!watch->events || epoll_ctl(self->pollfd, EPOLL_CTL_MOD, fd, &event) == -1) {
+		/* The descriptor may have been closed and its number reused since it was last modified. */
+		if (epoll_ctl(self->pollfd, EPOLL_CTL_ADD, fd, &event) == -1) {
+			if (errno != EPERM) return -1;
+			watch->always = 1;
+			self->alwaysReady++;
+			want = 0;
+		}
+	}
+#elif defined(LOOP_KQUEUE)
+	struct kevent changes[2];
+	int n = 0;
+	if ((want ^ watch->events) & WATCH_READ) {
+		EV_SET(&changes[n++], fd, EVFILT_READ, (want & WATCH_READ) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+	}
+	if ((want ^ watch->events) & WATCH_WRITE) {
+		EV_SET(&changes[n++], fd, EVFILT_WRITE, (want & WATCH_WRITE) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+	}
+	if (kevent(self->pollfd, changes, n, NULL, 0, NULL) == -1 && want) return -1;
+#endif
+	watch->events = want;
+	return 0;
+}
+
+/**
+ * Put what is waiting on @p fd on the ready queue, for whichever of
+ * @c WATCH_READ and @c WATCH_WRITE it is ready for. A future waiting
+ * on it is only waiting once, so it stops being watched.
+ */
+static void fire(struct EventLoop * self, int fd, int ready) {
+	if (fd < 0 || (size_t)fd >= self->watchSpace) return;
+	struct Watch * watch = &self->watches[fd];
+	int before = (IS_NONE(watch->reader) ? 0 : WATCH_READ) | (IS_NONE(watch->writer) ? 0 : WATCH_WRITE);
+	if (!before) return;
+	if ((ready & WATCH_READ) && IS_Handle(watch->reader)) {
+		KrkValue handle = watch->reader;
+		schedule(self, handle);
+		if (IS_Future(AS_Handle(handle)->callback)) {
+			watch->reader = NONE_VAL();
+		}
+	}
+	if ((ready & WATCH_WRITE) && IS_Handle(watch->writer)) {
+		KrkValue handle = watch->writer;
+		schedule(self, handle);
+		if (IS_Future(AS_Handle(handle)->callback)) {
+			watch->writer = NONE_VAL();
+		}
+	}
+	int want = (IS_NONE(watch->reader) ? 0 : WATCH_READ) | (IS_NONE(watch->writer) ? 0 : WATCH_WRITE);
+	if (!want) self->watching--;
+	pollerUpdate(self, fd, want);
+}
+
+/**
+ * Wait up to @p timeout seconds, or forever if it is negative, for descriptors
+ * to be ready, and schedule what is waiting on them.
+ * Returns -1, with @c errno set, on failure.
+ */
+static int pollerWait(struct EventLoop * self, double timeout) {
+	int result = 0;
+	int ms = timeout < 0 ? -1 : (int)(timeout * 1000.0 + 0.999);
+#if defined(LOOP_EPOLL)
+	struct epoll_event events[LOOP_EVENTS];
+	krk_beginBlocking();
+	int count = epoll_wait(self->pollfd, events, LOOP_EVENTS, ms);
+	krk_endBlocking();
+	for (int i = 0; i < count; ++i) {
+		int ready = 0;
+		/* Errors and hangups are reported to both sides, which will see them when they try the descriptor. */
+		if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) ready |= WATCH_READ;
+		if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) ready |= WATCH_WRITE;
+		fire(self, events[i].data.fd, ready);
+	}
+#elif defined(LOOP_KQUEUE)
+	struct kevent events[LOOP_EVENTS];
+	struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+	krk_beginBlocking();
+	int count = kevent(self->pollfd, NULL, 0, events, LOOP_EVENTS, ms < 0 ? NULL : &ts);
+	krk_endBlocking();
+	for (int i = 0; i < count; ++i) {
+		fire(self, (int)events[i].ident, events[i].filter == EVFILT_READ ? WATCH_READ : WATCH_WRITE);
+	}
+#else
+	struct pollfd * fds = malloc(sizeof(struct pollfd) * (self->watching ? self->watching : 1));
+	nfds_t n = 0;
+	for (size_t fd = 0; fd < self->watchSpace && n < self->watching; ++fd) {
+		struct Watch * watch = &self->watches[fd];
+		if (IS_NONE(watch->reader) && IS_NONE(watch->writer)) continue;
+		fds[n].fd = fd;
+		fds[n].events = (IS_NONE(watch->reader) ? 0 : POLLIN) | (IS_NONE(watch->writer) ? 0 : POLLOUT);
+		fds[n].revents = 0;
+		n++;
+	}
+	krk_beginBlocking();
+	int count = poll(fds, n, ms);
+	krk_endBlocking();
+	for (nfds_t i = 0; count > 0 && i < n; ++i) {
+		int ready = 0;
+		if (fds[i].revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL)) ready |= WATCH_READ;
+		if (fds[i].revents & (POLLOUT | POLLERR | POLLHUP | POLLNVAL)) ready |= WATCH_WRITE;
+		if (ready) fire(self, fds[i].fd, ready);
+	}
+	free(fds);
+#endif
+	if (count == -1) result = (errno == EINTR) ? 0 : -1;
+
+	if (self->alwaysReady) {
+		for (size_t fd = 0; fd < self->watchSpace; ++fd) {
+			if (self->watches[fd].always) fire(self, fd, WATCH_READ | WATCH_WRITE);
+		}
+	}
+	return result;
+}
+
+/**
+ * Make @p handle what waits on @p fd for @p which, replacing what did before;
+ * None stops waiting. Returns whether something was waiting, or -1 if the
+ * poller refused and an exception was raised.
+ */
+static int setWatch(struct EventLoop * self, krk_integer_type fd, int which, KrkValue handle) {
+	if (fd < 0) {
+		krk_runtimeError(vm.exceptions->valueError, "invalid file descriptor: %ld", (long)fd);
+		return -1;
+	}
+	if ((size_t)fd >= self->watchSpace) {
+		if (IS_NONE(handle)) return 0;
+		size_t space = self->watchSpace ? self->watchSpace : 64;
+		while (space <= (size_t)fd) space *= 2;
+		self->watches = realloc(self->watches, sizeof(struct Watch) * space);
+		for (size_t i = self->watchSpace; i < space; ++i) {
+			self->watches[i] = (struct Watch){NONE_VAL(), NONE_VAL(), 0, 0};
+		}
+		self->watchSpace = space;
+	}
+	struct Watch * watch = &self->watches[fd];
+	int before = (IS_NONE(watch->reader) ? 0 : WATCH_READ) | (IS_NONE(watch->writer) ? 0 : WATCH_WRITE);
+	KrkValue * slot = which == WATCH_READ ? &watch->reader : &watch->writer;
+	int had = !IS_NONE(*slot);
+	KrkValue previous = *slot;
+	*slot = handle;
+	krk_gcWriteBarrier((KrkObj*)self);
+	int want = (IS_NONE(watch->reader) ? 0 : WATCH_READ) | (IS_NONE(watch->writer) ? 0 : WATCH_WRITE);
+	if (pollerUpdate(self, fd, want) == -1) {
+		*slot = previous;
+		krk_runtimeError(vm.exceptions->ioError, "%s", strerror(errno));
+		return -1;
+	}
+	if (!before && want) self->watching++;
+	if (before && !want) self->watching--;
+	return had;
+}
+
+/** @} */
+
+/**
+ * @name Futures
+ * @{
+ */
+
+static KrkValue currentLoop(void);
+
+static void initFuture(struct Future * self, KrkValue loop) {
+	self->loop = loop;
+	self->result = NONE_VAL();
+	self->exception = NONE_VAL();
+	self->callbacks = NONE_VAL();
+	self->state = FUTURE_PENDING;
+	krk_gcWriteBarrier((KrkObj*)self);
+}
+
+/**
+ * Finish @p self in @p state and schedule its callbacks. Tasks waiting on
+ * it are stepped; anything else is called with the future.
+ */
+static void finish(struct Future * self, int state) {
+	self->state = state;
+	if (IS_NONE(self->callbacks)) return;
+	KrkValue callbacks = self->callbacks;
+	self->callbacks = NONE_VAL();
+	krk_push(callbacks);
+	struct EventLoop * loop = AS_EventLoop(self->loop);
+	KrkValue args = NONE_VAL();
+	for (size_t i = 0; i < AS_LIST(callbacks)->count; ++i) {
+		KrkValue callback = AS_LIST(callbacks)->values[i];
+		if (IS_Task(callback)) {
+			callSoon(loop, callback, NONE_VAL());
+			continue;
+		}
+		if (IS_NONE(args)) {
+			KrkTuple * tuple = krk_newTuple(1);
+			tuple->values.values[tuple->values.count++] = OBJECT_VAL(self);
+			args = OBJECT_VAL(tuple);
+			krk_push(args);
+		}
+		callSoon(loop, callback, args);
+	}
+	if (!IS_NONE(args)) krk_pop();
+	krk_pop();
+}
+
+static void addCallback(struct Future * self, KrkValue callback) {
+	if (self->state != FUTURE_PENDING) {
+		KrkValue args = NONE_VAL();
+		if (!IS_Task(callback)) {
+			KrkTuple * tuple = krk_newTuple(1);
+			tuple->values.values[tuple->values.count++] = OBJECT_VAL(self);
+			args = OBJECT_VAL(tuple);
+		}
+		krk_push(args);
+		callSoon(AS_EventLoop(self->loop), callback, args);
+		krk_pop();
+		return;
+	}
+	if (IS_NONE(self->callbacks)) {
+		self->callbacks = krk_list_of(0, NULL, 0);
+		krk_gcWriteBarrier((KrkObj*)self);
+	}
+	krk_writeValueArray(AS_LIST(self->callbacks), callback);
+}
+
+static KrkValue newCancelledError(void) {
+	KrkValue exception = OBJECT_VAL(krk_newInstance(CancelledError));
+	return exception;
+}
+
+static int cancelFuture(struct Future * self) {
+	if (self->state != FUTURE_PENDING) return 0;
+	finish(self, FUTURE_CANCELLED);
+	return 1;
+}
+
+static int cancelTask(struct Task * self);
+
+static int cancel(struct Future * self) {
+	if (IS_Task(OBJECT_VAL(self))) return cancelTask((struct Task*)self);
+	return cancelFuture(self);
+}
+
+/**
+ * What awaiting @p self gives: its result, or a raised exception.
+ */
+static KrkValue futureResult(struct Future * self) {
+	switch (self->state) {
+		case FUTURE_PENDING:
+			return krk_runtimeError(InvalidStateError, "Result is not set.");
+		case FUTURE_CANCELLED:
+			if (!IS_NONE(self->exception)) return raiseException(self->exception);
+			return krk_runtimeError(CancelledError, "%s", "");
+	}
+	if (!IS_NONE(self->exception)) return raiseException(self->exception);
+	return self->result;
+}
+
+/** @} */
+
+/**
+ * @name Tasks
+ * @{
+ */
+
+static void taskFinish(struct Task * self, int state, KrkValue result, KrkValue exception) {
+	if (self->future.state != FUTURE_PENDING) return;
+	self->future.result = result;
+	self->future.exception = exception;
+	self->waiting = NONE_VAL();
+	krk_gcWriteBarrier((KrkObj*)self);
+	finish(&self->future, state);
+}
+
+/**
+ * Run @p self's coroutine until it waits again. Returns 0 if the exception it
+ * raised should stop the loop, as well as being kept in the task.
+ */
+static int taskStep(struct Task * self) {
+	if (self->future.state != FUTURE_PENDING) return 1;
+	if (self->mustCancel) {
+		/* Coroutines can't have exceptions thrown into them, so one that isn't waiting on anything just stops. */
+		KrkValue exception = newCancelledError();
+		krk_push(exception);
+		taskFinish(self, FUTURE_CANCELLED, NONE_VAL(), exception);
+		krk_pop();
+		return 1;
+	}
+
+	self->waiting = NONE_VAL();
+	KrkValue previousTask;
+	krk_tableGet(&module->fields, OBJECT_VAL(S("_current_task")), &previousTask);
+	krk_push(previousTask);
+	krk_attachNamedObject(&module->fields, "_current_task", (KrkObj*)self);
+
+	size_t frameCount = krk_currentThread.frameCount;
+	krk_push(self->send);
+	krk_push(NONE_VAL());
+	KrkValue result = krk_callStack(1);
+	/* The frames an exception was raised in are left behind; drop them, as it won't be handled there. */
+	krk_currentThread.frameCount = frameCount;
+
+	krk_attachNamedValue(&module->fields, "_current_task", krk_peek(0));
+	krk_pop();
+
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) {
+		KrkValue exception = takeException();
+		krk_push(exception);
+		int interrupted = krk_isInstanceOf(exception, vm.exceptions->keyboardInterrupt);
+		taskFinish(self, krk_isInstanceOf(exception, CancelledError) ? FUTURE_CANCELLED : FUTURE_FINISHED, NONE_VAL(), exception);
+		krk_pop();
+		if (interrupted) {
+			raiseException(exception);
+			return 0;
+		}
+		return 1;
+	}
+
+	if (krk_valuesSame(result, self->coro)) {
+		/* The coroutine returned. */
+		KrkValue method = krk_valueGetAttribute_default(self->coro, "__finish__", NONE_VAL());
+		KrkValue value = NONE_VAL();
+		if (!IS_NONE(method)) {
+			krk_push(method);
+			value = krk_callStack(0);
+		}
+		krk_push(value);
+		taskFinish(self, FUTURE_FINISHED, value, NONE_VAL());
+		krk_pop();
+		return 1;
+	}
+
+	if (IS_NONE(result)) {
+		/* A bare yield gives other tasks a turn. */
+		callSoon(AS_EventLoop(self->future.loop), OBJECT_VAL(self), NONE_VAL());
+		return 1;
+	}
+
+	if (IS_Future(result) && !krk_valuesSame(result, OBJECT_VAL(self))) {
+		struct Future * future = AS_Future(result);
+		self->waiting = result;
+		krk_gcWriteBarrier((KrkObj*)self);
+		addCallback(future, OBJECT_VAL(self));
+		return 1;
+	}
+
+	krk_push(result);
+	krk_runtimeError(vm.exceptions->typeError, "Task got bad yield: '%s'", krk_typeName(result));
+	KrkValue exception = takeException();
+	krk_pop();
+	krk_push(exception);
+	taskFinish(self, FUTURE_FINISHED, NONE_VAL(), exception);
+	krk_pop();
+	return 1;
+}
+
+/**
+ * A task waiting on a future is cancelled by cancelling that future, which
+ * raises CancelledError in the coroutine where it awaited it. A task that
+ * isn't is cancelled when it next runs.
+ */
+static int cancelTask(struct Task * self) {
+	if (self->future.state != FUTURE_PENDING) return 0;
+	if (IS_Future(self->waiting) && cancel(AS_Future(self->waiting))) return 1;
+	self->mustCancel = 1;
+	return 1;
+}
+
+static KrkValue newTask(KrkValue coro, KrkValue loop) {
+	KrkValue send = krk_valueGetAttribute_default(coro, "send", NONE_VAL());
+	if (IS_NONE(send)) {
+		return krk_runtimeError(vm.exceptions->typeError, "a coroutine was expected, got '%s'", krk_typeName(coro));
+	}
+	krk_push(send);
+	struct Task * task = (struct Task*)krk_newInstance(TaskClass);
+	krk_push(OBJECT_VAL(task));
+	initFuture(&task->future, loop);
+	task->coro = coro;
+	task->send = send;
+	task->waiting = NONE_VAL();
+	krk_gcWriteBarrier((KrkObj*)task);
+	callSoon(AS_EventLoop(loop), OBJECT_VAL(task), NONE_VAL());
+	krk_pop();
+	krk_pop();
+	return OBJECT_VAL(task);
+}
+
+/** A future for @p value: itself if it's a future, or a task running it if it's a coroutine. */
+static KrkValue ensureFuture(KrkValue value, KrkValue loop) {
+	if (IS_Future(value)) return value;
+	return newTask(value, loop);
+}
+
+/** @} */
+
+/**
+ * @name Running
+ * @{
+ */
+
+/**
+ * Run one handle. Exceptions from callbacks are reported and don't stop the
+ * loop, except a keyboard interrupt. Returns 0 if the loop should stop for one.
+ */
+static int runHandle(struct Handle * handle) {
+	if (handle->cancelled) return 1;
+	KrkValue callback = handle->callback;
+	if (IS_Task(callback)) {
+		return taskStep(AS_Task(callback));
+	}
+	if (IS_Future(callback)) {
+		struct Future * future = AS_Future(callback);
+		if (future->state == FUTURE_PENDING) {
+			future->result = IS_TUPLE(handle->args) && AS_TUPLE(handle->args)->values.count ? AS_TUPLE(handle->args)->values.values[0] : NONE_VAL();
+			krk_gcWriteBarrier((KrkObj*)future);
+			finish(future, FUTURE_FINISHED);
+		}
+		return 1;
+	}
+	size_t frameCount = krk_currentThread.frameCount;
+	krk_push(callback);
+	size_t count = 0;
+	if (IS_TUPLE(handle->args)) {
+		count = AS_TUPLE(handle->args)->values.count;
+		for (size_t i = 0; i < count; ++i) krk_push(AS_TUPLE(handle->args)->values.values[i]);
+	}
+	krk_callStack(count);
+	krk_currentThread.frameCount = frameCount;
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) {
+		if (krk_isInstanceOf(krk_currentThread.currentException, vm.exceptions->keyboardInterrupt)) return 0;
+		krk_dumpTraceback();
+		takeException();
+	}
+	return 1;
+}
+
+/**
+ * One pass of the loop. Returns 0, with an exception raised, if it should stop.
+ */
+static int runOnce(struct EventLoop * self) {
+	double timeout = -1;
+	if (self->readyHead < self->ready.count || self->stopping || self->alwaysReady) {
+		timeout = 0;
+	} else if (self->timers.count) {
+		timeout = AS_Handle(self->timers.values[0])->when - monotonic();
+		if (timeout < 0) timeout = 0;
+	} else if (!self->watching) {
+		krk_runtimeError(vm.exceptions->valueError, "event loop has nothing left to run and would wait forever");
+		return 0;
+	}
+
+	if (pollerWait(self, timeout) == -1) {
+		krk_runtimeError(vm.exceptions->ioError, "%s", strerror(errno));
+		return 0;
+	}
+	if (krk_currentThread.flags & KRK_THREAD_SIGNALLED) {
+		krk_currentThread.flags &= ~KRK_THREAD_SIGNALLED;
+		krk_runtimeError(vm.exceptions->keyboardInterrupt, "Keyboard interrupt.");
+		return 0;
+	}
+
+	double now = monotonic();
+	while (self->timers.count && AS_Handle(self->timers.values[0])->when <= now) {
+		KrkValue handle = timerPop(self);
+		if (!AS_Handle(handle)->cancelled) schedule(self, handle);
+	}
+
+	/* Handles scheduled by these wait for the next pass. */
+	size_t end = self->ready.count;
+	while (self->readyHead < end) {
+		KrkValue handle = self->ready.values[self->readyHead];
+		self->ready.values[self->readyHead++] = NONE_VAL();
+		krk_push(handle);
+		int ok = runHandle(AS_Handle(handle));
+		krk_pop();
+		if (!ok) return 0;
+	}
+	if (self->readyHead == self->ready.count) {
+		self->ready.count = 0;
+		self->readyHead = 0;
+	} else if (self->readyHead > self->ready.count / 2) {
+		memmove(self->ready.values, &self->ready.values[self->readyHead], sizeof(KrkValue) * (self->ready.count - self->readyHead));
+		self->ready.count -= self->readyHead;
+		self->readyHead = 0;
+	}
+	return 1;
+}
+
+/**
+ * Run passes of the loop until it is stopped, or until @p future is done if it
+ * isn't None. Returns 0 with an exception raised if it couldn't.
+ */
+static int runLoop(struct EventLoop * self, KrkValue future) {
+	if (!self->initialized || self->closed) {
+		krk_runtimeError(vm.exceptions->valueError, "event loop is closed");
+		return 0;
+	}
+	if (self->running || !IS_NONE(runningLoop)) {
+		krk_runtimeError(vm.exceptions->valueError, "an event loop is already running");
+		return 0;
+	}
+	self->running = 1;
+	self->stopping = 0;
+	runningLoop = OBJECT_VAL(self);
+	int ok = 1;
+	while (!self->stopping && (IS_NONE(future) || AS_Future(future)->state == FUTURE_PENDING)) {
+		if (!(ok = runOnce(self))) break;
+	}
+	runningLoop = NONE_VAL();
+	self->running = 0;
+	self->stopping = 0;
+	return ok;
+}
+
+/** @} */
+
+#define CURRENT_CTYPE struct EventLoop *
+#define CURRENT_NAME  self
+
+KRK_METHOD(EventLoop,__init__,{
+	METHOD_TAKES_NONE();
+	if (self->initialized) return argv[0];
+	self->pollfd = pollerOpen();
+	if (self->pollfd == -1) {
+		return krk_runtimeError(vm.exceptions->ioError, "%s", strerror(errno));
+	}
+	self->initialized = 1;
+	krk_initValueArray(&self->ready);
+	krk_initValueArray(&self->timers);
+	return argv[0];
+})
+
+KRK_METHOD(EventLoop,time,{
+	METHOD_TAKES_NONE();
+	return FLOATING_VAL(monotonic());
+})
+
+/**
+ * The callback, and a tuple of the arguments after it, from argv[first] on.
+ */
+static KrkValue callbackArgs(int argc, const KrkValue argv[], int first) {
+	KrkTuple * args = krk_newTuple(argc - first - 1);
+	for (int i = first + 1; i < argc; ++i) {
+		args->values.values[args->values.count++] = argv[i];
+	}
+	return OBJECT_VAL(args);
+}
+
+KRK_METHOD(EventLoop,call_soon,{
+	METHOD_TAKES_AT_LEAST(1);
+	KrkValue args = callbackArgs(argc, argv, 1);
+	return callSoon(self, argv[1], args);
+})
+
+static KrkValue callAt(struct EventLoop * self, double when, int argc, const KrkValue argv[]) {
+	KrkValue args = callbackArgs(argc, argv, 2);
+	krk_push(args);
+	struct Handle * handle = newHandle(argv[2], args, when);
+	krk_push(OBJECT_VAL(handle));
+	timerPush(self, OBJECT_VAL(handle));
+	krk_pop();
+	krk_pop();
+	return OBJECT_VAL(handle);
+}
+
+static int asSeconds(KrkValue value, double * out) {
+	if (IS_INTEGER(value)) *out = AS_INTEGER(value);
+	else if (IS_FLOATING(value)) *out = AS_FLOATING(value);
+	else {
+		krk_runtimeError(vm.exceptions->typeError, "expected int or float, not '%s'", krk_typeName(value));
+		return 0;
+	}
+	return 1;
+}
+
+KRK_METHOD(EventLoop,call_later,{
+	METHOD_TAKES_AT_LEAST(2);
+	double delay;
+	if (!asSeconds(argv[1], &delay)) return NONE_VAL();
+	return callAt(self, monotonic() + delay, argc, argv);
+})
+
+KRK_METHOD(EventLoop,call_at,{
+	METHOD_TAKES_AT_LEAST(2);
+	double when;
+	if (!asSeconds(argv[1], &when)) return NONE_VAL();
+	return callAt(self, when, argc, argv);
+})
+
+static KrkValue addWatch(struct EventLoop * self, krk_integer_type fd, int which, int argc, const KrkValue argv[]) {
+	KrkValue args = callbackArgs(argc, argv, 2);
+	krk_push(args);
+	struct Handle * handle = newHandle(argv[2], args, 0);
+	krk_push(OBJECT_VAL(handle));
+	int result = setWatch(self, fd, which, OBJECT_VAL(handle));
+	krk_pop();
+	krk_pop();
+	if (result < 0) return NONE_VAL();
+	return OBJECT_VAL(handle);
+}
+
+KRK_METHOD(EventLoop,add_reader,{
+	METHOD_TAKES_AT_LEAST(2);
+	CHECK_ARG(1,int,krk_integer_type,fd);
+	return addWatch(self, fd, WATCH_READ, argc, argv);
+})
+
+KRK_METHOD(EventLoop,add_writer,{
+	METHOD_TAKES_AT_LEAST(2);
+	CHECK_ARG(1,int,krk_integer_type,fd);
+	return addWatch(self, fd, WATCH_WRITE, argc, argv);
+})
+
+KRK_METHOD(EventLoop,remove_reader,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,int,krk_integer_type,fd);
+	int result = setWatch(self, fd, WATCH_READ, NONE_VAL());
+	if (result < 0) return NONE_VAL();
+	return BOOLEAN_VAL(result);
+})
+
+KRK_METHOD(EventLoop,remove_writer,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,int,krk_integer_type,fd);
+	int result = setWatch(self, fd, WATCH_WRITE, NONE_VAL());
+	if (result < 0) return NONE_VAL();
+	return BOOLEAN_VAL(result);
+})
+
+static KrkValue waitFor(struct EventLoop * self, krk_integer_type fd, int which) {
+	struct Future * future = (struct Future*)krk_newInstance(FutureClass);
+	krk_push(OBJECT_VAL(future));
+	initFuture(future, OBJECT_VAL(self));
+	struct Handle * handle = newHandle(OBJECT_VAL(future), NONE_VAL(), 0);
+	krk_push(OBJECT_VAL(handle));
+	int result = setWatch(self, fd, which, OBJECT_VAL(handle));
+	krk_pop();
+	if (result < 0) {
+		krk_pop();
+		return NONE_VAL();
+	}
+	return krk_pop();
+}
+
+KRK_METHOD(EventLoop,wait_readable,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,int,krk_integer_type,fd);
+	return waitFor(self, fd, WATCH_READ);
+})
+
+KRK_METHOD(EventLoop,wait_writable,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,int,krk_integer_type,fd);
+	return waitFor(self, fd, WATCH_WRITE);
+})
+
+KRK_METHOD(EventLoop,create_future,{
+	METHOD_TAKES_NONE();
+	struct Future * future = (struct Future*)krk_newInstance(FutureClass);
+	krk_push(OBJECT_VAL(future));
+	initFuture(future, OBJECT_VAL(self));
+	return krk_pop();
+})
+
+KRK_METHOD(EventLoop,create_task,{
+	METHOD_TAKES_EXACTLY(1);
+	return newTask(argv[1], OBJECT_VAL(self));
+})
+
+KRK_METHOD(EventLoop,run_forever,{
+	METHOD_TAKES_NONE();
+	runLoop(self, NONE_VAL());
+})
+
+KRK_METHOD(EventLoop,run_until_complete,{
+	METHOD_TAKES_EXACTLY(1);
+	KrkValue future = ensureFuture(argv[1], OBJECT_VAL(self));
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return NONE_VAL();
+	krk_push(future);
+	int ok = runLoop(self, future);
+	krk_pop();
+	if (!ok) return NONE_VAL();
+	if (AS_Future(future)->state == FUTURE_PENDING) {
+		return krk_runtimeError(InvalidStateError, "Event loop stopped before Future completed.");
+	}
+	return futureResult(AS_Future(future));
+})
+
+KRK_METHOD(EventLoop,stop,{
+	METHOD_TAKES_NONE();
+	self->stopping = 1;
+})
+
+KRK_METHOD(EventLoop,is_running,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(self->running);
+})
+
+KRK_METHOD(EventLoop,is_closed,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(self->closed);
+})
+
+KRK_METHOD(EventLoop,close,{
+	METHOD_TAKES_NONE();
+	if (self->running) return krk_runtimeError(vm.exceptions->valueError, "can not close a running event loop");
+	if (self->closed) return NONE_VAL();
+	self->closed = 1;
+	self->ready.count = 0;
+	self->readyHead = 0;
+	self->timers.count = 0;
+	for (size_t i = 0; i < self->watchSpace; ++i) {
+		self->watches[i].reader = NONE_VAL();
+		self->watches[i].writer = NONE_VAL();
+	}
+	self->watching = 0;
+	self->alwaysReady = 0;
+	if (self->pollfd >= 0) close(self->pollfd);
+	self->pollfd = -1;
+})
+
+KRK_METHOD(EventLoop,backend,{
+	METHOD_TAKES_NONE();
+	return OBJECT_VAL(krk_copyString(pollerName(), strlen(pollerName())));
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct Handle *
+
+KRK_METHOD(Handle,cancel,{
+	METHOD_TAKES_NONE();
+	self->cancelled = 1;
+})
+
+KRK_METHOD(Handle,cancelled,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(self->cancelled);
+})
+
+KRK_METHOD(Handle,when,{
+	METHOD_TAKES_NONE();
+	return FLOATING_VAL(self->when);
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct Future *
+
+KRK_METHOD(Future,__init__,{
+	METHOD_TAKES_NONE();
+	KrkValue loop = NONE_VAL();
+	if (hasKw) krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("loop")), &loop);
+	if (IS_NONE(loop)) loop = currentLoop();
+	if (!IS_EventLoop(loop)) return TYPE_ERROR(EventLoop,loop);
+	initFuture(self, loop);
+	return argv[0];
+})
+
+KRK_METHOD(Future,result,{
+	METHOD_TAKES_NONE();
+	return futureResult(self);
+})
+
+KRK_METHOD(Future,exception,{
+	METHOD_TAKES_NONE();
+	if (self->state == FUTURE_PENDING) return krk_runtimeError(InvalidStateError, "Exception is not set.");
+	if (self->state == FUTURE_CANCELLED) return futureResult(self);
+	return self->exception;
+})
+
+KRK_METHOD(Future,set_result,{
+	METHOD_TAKES_EXACTLY(1);
+	if (self->state != FUTURE_PENDING) return krk_runtimeError(InvalidStateError, "invalid state");
+	self->result = argv[1];
+	krk_gcWriteBarrier((KrkObj*)self);
+	finish(self, FUTURE_FINISHED);
+})
+
+KRK_METHOD(Future,set_exception,{
+	METHOD_TAKES_EXACTLY(1);
+	if (self->state != FUTURE_PENDING) return krk_runtimeError(InvalidStateError, "invalid state");
+	KrkValue exception = argv[1];
+	if (IS_CLASS(exception)) {
+		krk_push(exception);
+		exception = krk_callStack(0);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return NONE_VAL();
+	}
+	if (!krk_isInstanceOf(exception, vm.exceptions->baseException)) {
+		return krk_runtimeError(vm.exceptions->typeError, "exception expected, not '%s'", krk_typeName(exception));
+	}
+	self->exception = exception;
+	krk_gcWriteBarrier((KrkObj*)self);
+	finish(self, FUTURE_FINISHED);
+})
+
+KRK_METHOD(Future,done,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(self->state != FUTURE_PENDING);
+})
+
+KRK_METHOD(Future,cancelled,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(self->state == FUTURE_CANCELLED);
+})
+
+KRK_METHOD(Future,cancel,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(cancel(self));
+})
+
+KRK_METHOD(Future,add_done_callback,{
+	METHOD_TAKES_EXACTLY(1);
+	addCallback(self, argv[1]);
+})
+
+KRK_METHOD(Future,remove_done_callback,{
+	METHOD_TAKES_EXACTLY(1);
+	if (IS_NONE(self->callbacks)) return INTEGER_VAL(0);
+	KrkValueArray * callbacks = AS_LIST(self->callbacks);
+	size_t kept = 0;
+	for (size_t i = 0; i < callbacks->count; ++i) {
+		if (krk_valuesSame(callbacks->values[i], argv[1])) continue;
+		callbacks->values[kept++] = callbacks->values[i];
+	}
+	size_t removed = callbacks->count - kept;
+	callbacks->count = kept;
+	return INTEGER_VAL(removed);
+})
+
+KRK_METHOD(Future,get_loop,{
+	METHOD_TAKES_NONE();
+	return self->loop;
+})
+
+KRK_METHOD(Future,__await__,{
+	METHOD_TAKES_NONE();
+	struct FutureIter * iter = (struct FutureIter*)krk_newInstance(FutureIterClass);
+	iter->future = OBJECT_VAL(self);
+	return OBJECT_VAL(iter);
+})
+
+KRK_METHOD(Future,__repr__,{
+	METHOD_TAKES_NONE();
+	const char * state = self->state == FUTURE_PENDING ? "pending" : self->state == FUTURE_CANCELLED ? "cancelled" : "finished";
+	KrkClass * type = krk_getType(argv[0]);
+	char tmp[256];
+	size_t len = snprintf(tmp, sizeof(tmp), "<%s %s>", type->name->chars, state);
+	return OBJECT_VAL(krk_copyString(tmp, len < sizeof(tmp) ? len : sizeof(tmp) - 1));
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct FutureIter *
+
+/*
+ * Awaiting runs OP_YIELD_FROM over this: the first send gives the future to
+ * the task, and any after it give this iterator back to say it's finished,
+ * so __finish__ gives the future's result. A future waited on by something
+ * other than a task may not be done yet when it is resumed, and is given out
+ * again until it is.
+ */
+KRK_METHOD(FutureIter,send,{
+	METHOD_TAKES_EXACTLY(1);
+	if (AS_Future(self->future)->state == FUTURE_PENDING) return self->future;
+	return argv[0];
+})
+
+KRK_METHOD(FutureIter,__call__,{
+	METHOD_TAKES_NONE();
+	if (AS_Future(self->future)->state == FUTURE_PENDING) return self->future;
+	return argv[0];
+})
+
+KRK_METHOD(FutureIter,__finish__,{
+	METHOD_TAKES_NONE();
+	return futureResult(AS_Future(self->future));
+})
+
+KRK_METHOD(FutureIter,__iter__,{
+	METHOD_TAKES_NONE();
+	return argv[0];
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct Task *
+
+KRK_METHOD(Task,__init__,{
+	METHOD_TAKES_EXACTLY(1);
+	KrkValue loop = NONE_VAL();
+	if (hasKw) krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("loop")), &loop);
+	if (IS_NONE(loop)) loop = currentLoop();
+	if (!IS_EventLoop(loop)) return TYPE_ERROR(EventLoop,loop);
+	KrkValue send = krk_valueGetAttribute_default(argv[1], "send", NONE_VAL());
+	if (IS_NONE(send)) {
+		return krk_runtimeError(vm.exceptions->typeError, "a coroutine was expected, got '%s'", krk_typeName(argv[1]));
+	}
+	initFuture(&self->future, loop);
+	self->coro = argv[1];
+	self->send = send;
+	self->waiting = NONE_VAL();
+	krk_gcWriteBarrier((KrkObj*)self);
+	callSoon(AS_EventLoop(loop), argv[0], NONE_VAL());
+	return argv[0];
+})
+
+KRK_METHOD(Task,get_coro,{
+	METHOD_TAKES_NONE();
+	return self->coro;
+})
+
+#undef CURRENT_CTYPE
+
+/**
+ * The running loop, or else the default one, which is made the first time it is wanted.
+ */
+static KrkValue currentLoop(void) {
+	if (!IS_NONE(runningLoop)) return runningLoop;
+	KrkValue loop;
+	if (krk_tableGet(&module->fields, OBJECT_VAL(S("_default_loop")), &loop) && IS_EventLoop(loop)) return loop;
+	loop = OBJECT_VAL(krk_newInstance(EventLoopClass));
+	krk_push(loop);
+	krk_attachNamedValue(&module->fields, "_default_loop", loop);
+	FUNC_NAME(EventLoop,__init__)(1, &loop, 0);
+	return krk_pop();
+}
+
+KRK_FUNC(get_event_loop,{
+	FUNCTION_TAKES_NONE();
+	return currentLoop();
+})
+
+KRK_FUNC(get_running_loop,{
+	FUNCTION_TAKES_NONE();
+	if (IS_NONE(runningLoop)) return krk_runtimeError(InvalidStateError, "no running event loop");
+	return runningLoop;
+})
+
+KRK_FUNC(set_event_loop,{
+	FUNCTION_TAKES_EXACTLY(1);
+	if (!IS_NONE(argv[0]) && !IS_EventLoop(argv[0])) return TYPE_ERROR(EventLoop,argv[0]);
+	krk_attachNamedValue(&module->fields, "_default_loop", argv[0]);
+})
+
+KRK_FUNC(current_task,{
+	FUNCTION_TAKES_NONE();
+	KrkValue task = NONE_VAL();
+	krk_tableGet(&module->fields, OBJECT_VAL(S("_current_task")), &task);
+	return task;
+})
+
+KRK_FUNC(ensure_future,{
+	FUNCTION_TAKES_EXACTLY(1);
+	return ensureFuture(argv[0], currentLoop());
+})
+
+KRK_FUNC(create_task,{
+	FUNCTION_TAKES_EXACTLY(1);
+	return newTask(argv[0], currentLoop());
+})
+
+KRK_FUNC(sleep,{
+	FUNCTION_TAKES_AT_LEAST(1);
+	FUNCTION_TAKES_AT_MOST(2);
+	double delay;
+	if (!asSeconds(argv[0], &delay)) return NONE_VAL();
+	KrkValue loop = currentLoop();
+	krk_push(loop);
+	struct Future * future = (struct Future*)krk_newInstance(FutureClass);
+	krk_push(OBJECT_VAL(future));
+	initFuture(future, loop);
+	KrkTuple * args = krk_newTuple(1);
+	args->values.values[args->values.count++] = argc > 1 ? argv[1] : NONE_VAL();
+	krk_push(OBJECT_VAL(args));
+	if (delay <= 0) {
+		callSoon(AS_EventLoop(loop), OBJECT_VAL(future), OBJECT_VAL(args));
+	} else {
+		struct Handle * handle = newHandle(OBJECT_VAL(future), OBJECT_VAL(args), monotonic() + delay);
+		krk_push(OBJECT_VAL(handle));
+		timerPush(AS_EventLoop(loop), OBJECT_VAL(handle));
+		krk_pop();
+	}
+	krk_pop();
+	KrkValue out = krk_pop();
+	krk_pop();
+	return out;
+})
+
+KrkValue krk_module_onload__asyncio(void) {
+	module = krk_newInstance(vm.baseClasses->moduleClass);
+	runningLoop = NONE_VAL();
+	krk_push(OBJECT_VAL(module));
+
+	KRK_DOC(module, "@brief Native event loop, futures and tasks; use the @c asyncio module.");
+	krk_attachNamedValue(&module->fields, "_current_task", NONE_VAL());
+
+	KrkClass * EventLoop = krk_makeClass(module, &EventLoopClass, "EventLoop", vm.baseClasses->objectClass);
+	KRK_DOC(EventLoop,
+		"@brief Runs callbacks, timers, and tasks, and waits for file descriptors to be ready.\n\n"
+		"Readiness is waited for with epoll, kqueue, or poll(), whichever the system has; see @ref EventLoop_backend.");
+	EventLoop->allocSize = sizeof(struct EventLoop);
+	EventLoop->_ongcscan = _EventLoop_gcscan;
+	EventLoop->_ongcsweep = _EventLoop_gcsweep;
+	BIND_METHOD(EventLoop,__init__);
+	KRK_DOC(BIND_METHOD(EventLoop,time),
+		"@brief The loop's clock, in seconds, which is what @ref EventLoop_call_at takes.");
+	KRK_DOC(BIND_METHOD(EventLoop,call_soon),
+		"@brief Call @p callback with @p args on the next pass of the loop.\n"
+		"@arguments callback,*args\n\n"
+		"Returns a @ref Handle that can cancel the call.");
+	KRK_DOC(BIND_METHOD(EventLoop,call_later),
+		"@brief Call @p callback with @p args once @p delay seconds have passed.\n"
+		"@arguments delay,callback,*args");
+	KRK_DOC(BIND_METHOD(EventLoop,call_at),
+		"@brief Call @p callback with @p args once the loop's clock reaches @p when.\n"
+		"@arguments when,callback,*args");
+	KRK_DOC(BIND_METHOD(EventLoop,add_reader),
+		"@brief Call @p callback with @p args whenever the file descriptor @p fd is readable.\n"
+		"@arguments fd,callback,*args\n\n"
+		"Replaces any reader @p fd already had.");
+	KRK_DOC(BIND_METHOD(EventLoop,add_writer),
+		"@brief Call @p callback with @p args whenever the file descriptor @p fd is writable.\n"
+		"@arguments fd,callback,*args");
+	KRK_DOC(BIND_METHOD(EventLoop,remove_reader),
+		"@brief Stop watching @p fd for reading. Returns whether it was being watched.\n"
+		"@arguments fd");
+	KRK_DOC(BIND_METHOD(EventLoop,remove_writer),
+		"@brief Stop watching @p fd for writing. Returns whether it was being watched.\n"
+		"@arguments fd");
+	KRK_DOC(BIND_METHOD(EventLoop,wait_readable),
+		"@brief A @ref Future that is done when @p fd is next readable.\n"
+		"@arguments fd\n\n"
+		"This takes the place of any reader @p fd had.");
+	KRK_DOC(BIND_METHOD(EventLoop,wait_writable),
+		"@brief A @ref Future that is done when @p fd is next writable.\n"
+		"@arguments fd");
+	KRK_DOC(BIND_METHOD(EventLoop,create_future),
+		"@brief A new @ref Future attached to this loop.");
+	KRK_DOC(BIND_METHOD(EventLoop,create_task),
+		"@brief Start running the coroutine @p coro in a new @ref Task.\n"
+		"@arguments coro");
+	KRK_DOC(BIND_METHOD(EventLoop,run_forever),
+		"@brief Run the loop until @ref EventLoop_stop is called.");
+	KRK_DOC(BIND_METHOD(EventLoop,run_until_complete),
+		"@brief Run the loop until @p future is done, and return its result.\n"
+		"@arguments future\n\n"
+		"A coroutine is run in a new @ref Task.");
+	KRK_DOC(BIND_METHOD(EventLoop,stop),
+		"@brief Stop the loop once the current pass is over.");
+	KRK_DOC(BIND_METHOD(EventLoop,is_running),
+		"@brief Whether the loop is running.");
+	KRK_DOC(BIND_METHOD(EventLoop,is_closed),
+		"@brief Whether the loop has been closed.");
+	KRK_DOC(BIND_METHOD(EventLoop,close),
+		"@brief Drop everything scheduled on the loop and release its poller.");
+	KRK_DOC(BIND_PROP(EventLoop,backend),
+		"@brief Name of the readiness interface: @c epoll, @c kqueue, or @c poll.");
+	krk_finalizeClass(EventLoop);
+
+	KrkClass * Handle = krk_makeClass(module, &HandleClass, "Handle", vm.baseClasses->objectClass);
+	KRK_DOC(Handle, "@brief A callback scheduled on an @ref EventLoop.");
+	Handle->allocSize = sizeof(struct Handle);
+	Handle->_ongcscan = _Handle_gcscan;
+	KRK_DOC(BIND_METHOD(Handle,cancel),
+		"@brief Don't call the callback, if it hasn't been called yet.");
+	KRK_DOC(BIND_METHOD(Handle,cancelled),
+		"@brief Whether the handle was cancelled.");
+	KRK_DOC(BIND_METHOD(Handle,when),
+		"@brief When a timer is due, on the loop's clock.");
+	krk_finalizeClass(Handle);
+
+	KrkClass * Future = krk_makeClass(module, &FutureClass, "Future", vm.baseClasses->objectClass);
+	KRK_DOC(Future,
+		"@brief The eventual result of an asynchronous operation.\n"
+		"@arguments loop=None\n\n"
+		"Awaiting a future waits until it is done, and then gives its result or raises its exception.");
+	Future->allocSize = sizeof(struct Future);
+	Future->_ongcscan = _Future_gcscan;
+	BIND_METHOD(Future,__init__);
+	KRK_DOC(BIND_METHOD(Future,result),
+		"@brief The result; raises the exception instead if there was one, "
+		"@ref CancelledError if the future was cancelled, or @ref InvalidStateError if it isn't done.");
+	KRK_DOC(BIND_METHOD(Future,exception),
+		"@brief The exception set on the future, or None.");
+	KRK_DOC(BIND_METHOD(Future,set_result),
+		"@brief Finish the future with @p result.\n"
+		"@arguments result");
+	KRK_DOC(BIND_METHOD(Future,set_exception),
+		"@brief Finish the future with @p exception, an exception or exception class.\n"
+		"@arguments exception");
+	KRK_DOC(BIND_METHOD(Future,done),
+		"@brief Whether the future has a result, an exception, or was cancelled.");
+	KRK_DOC(BIND_METHOD(Future,cancelled),
+		"@brief Whether the future was cancelled.");
+	KRK_DOC(BIND_METHOD(Future,cancel),
+		"@brief Cancel the future if it isn't done. Returns whether it was cancelled.");
+	KRK_DOC(BIND_METHOD(Future,add_done_callback),
+		"@brief Call @p callback with the future once it is done.\n"
+		"@arguments callback");
+	KRK_DOC(BIND_METHOD(Future,remove_done_callback),
+		"@brief Stop @p callback being called when the future is done. Returns how many were removed.\n"
+		"@arguments callback");
+	KRK_DOC(BIND_METHOD(Future,get_loop),
+		"@brief The event loop the future is attached to.");
+	BIND_METHOD(Future,__await__);
+	BIND_METHOD(Future,__repr__);
+	krk_defineNative(&Future->methods, "__iter__", FUNC_NAME(Future,__await__));
+	krk_finalizeClass(Future);
+
+	KrkClass * FutureIter = krk_makeClass(module, &FutureIterClass, "FutureIter", vm.baseClasses->objectClass);
+	FutureIter->allocSize = sizeof(struct FutureIter);
+	FutureIter->_ongcscan = _FutureIter_gcscan;
+	BIND_METHOD(FutureIter,send);
+	BIND_METHOD(FutureIter,__call__);
+	BIND_METHOD(FutureIter,__finish__);
+	BIND_METHOD(FutureIter,__iter__);
+	krk_finalizeClass(FutureIter);
+
+	KrkClass * Task = krk_makeClass(module, &TaskClass, "Task", Future);
+	KRK_DOC(Task,
+		"@brief A future for the result of a coroutine, which it runs on an event loop.\n"
+		"@arguments coro,loop=None\n\n"
+		"Cancelling a task waiting on a future cancels that future, raising @ref CancelledError where "
+		"the coroutine awaited it. A task that isn't waiting stops the next time it would run.");
+	Task->allocSize = sizeof(struct Task);
+	Task->_ongcscan = _Task_gcscan;
+	BIND_METHOD(Task,__init__);
+	KRK_DOC(BIND_METHOD(Task,get_coro),
+		"@brief The coroutine the task runs.");
+	krk_finalizeClass(Task);
+
+	krk_makeClass(module, &CancelledError, "CancelledError", vm.exceptions->baseException);
+	KRK_DOC(CancelledError, "Raised where a cancelled future was awaited.");
+	krk_finalizeClass(CancelledError);
+	krk_makeClass(module, &InvalidStateError, "InvalidStateError", vm.exceptions->baseException);
+	KRK_DOC(InvalidStateError, "Raised when a future isn't in the state an operation needs.");
+	krk_finalizeClass(InvalidStateError);
+	krk_makeClass(module, &TimeoutError, "TimeoutError", vm.exceptions->baseException);
+	KRK_DOC(TimeoutError, "Raised when an operation doesn't finish in the time it was given.");
+	krk_finalizeClass(TimeoutError);
+
+	KRK_DOC(BIND_FUNC(module,get_event_loop),
+		"@brief The running event loop, or else the default one, which is made if there isn't one.");
+	KRK_DOC(BIND_FUNC(module,get_running_loop),
+		"@brief The running event loop; raises @ref InvalidStateError if there isn't one.");
+	KRK_DOC(BIND_FUNC(module,set_event_loop),
+		"@brief Make @p loop the default event loop.\n"
+		"@arguments loop");
+	KRK_DOC(BIND_FUNC(module,current_task),
+		"@brief The task that is running, or None.");
+	KRK_DOC(BIND_FUNC(module,ensure_future),
+		"@brief @p value if it is a future, or else a @ref Task running the coroutine @p value.\n"
+		"@arguments value");
+	KRK_DOC(BIND_FUNC(module,create_task),
+		"@brief Start running the coroutine @p coro in a new @ref Task on the current event loop.\n"
+		"@arguments coro");
+	KRK_DOC(BIND_FUNC(module,sleep),
+		"@brief A @ref Future that finishes with @p result after @p delay seconds.\n"
+		"@arguments delay,result=None\n\n"
+		"A @p delay of 0 lets everything else that is ready run first.");
+
+	return krk_pop();
+}
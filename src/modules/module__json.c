@@ -0,0 +1,1014 @@
+/**
+ * @file    module__json.c
+ * @brief   JSON parsing and serialization, for the @c json module.
+ *
+ * Documents are parsed from the UTF-8 bytes of a string straight into
+ * dicts, lists, strings and numbers: nothing is copied out of the source
+ * except the contents of the strings it holds. Runs of whitespace, and of
+ * string bytes that need no escaping, are found sixteen bytes at a time
+ * with SSE2 or NEON where they are available, and eight bytes at a time
+ * otherwise. The encoder uses the same scan to copy the unescaped parts of
+ * strings into its output in one go.
+ *
+ * @c JSONDecoder takes a document a piece at a time, as it arrives from a
+ * file or a socket, and hands back each value at the top level of the
+ * stream once all of it has been seen. It keeps track of where it was in
+ * the bytes it has buffered, so each byte is only scanned once to find
+ * where a value ends; the value is then parsed in one go.
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <kuroko/vm.h>
+#include <kuroko/memory.h>
+#include <kuroko/util.h>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+# include <arm_neon.h>
+#endif
+
+/**
+ * Deepest nesting of arrays and objects that will be parsed or encoded;
+ * both recurse on the C stack.
+ */
+#define JSON_MAX_DEPTH 1000
+
+/** Largest and smallest values that fit in an @c int; anything else becomes a @c float. */
+#define JSON_INT_MAX (((krk_integer_type)1 << 47) - 1)
+#define JSON_INT_MIN (-((krk_integer_type)1 << 47))
+
+static KrkVMLocal jsonDecoderKey;
+#define JSONDecoderClass KRK_VM_LOCAL(KrkClass*,jsonDecoderKey)
+
+static inline int isSpace(unsigned char c) {
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/** Whether @p c can be copied into a JSON string as it is. */
+static inline int isPlain(unsigned char c, int asciiOnly) {
+	return c != '"' && c != '\\' && c >= 0x20 && (!asciiOnly || c < 0x80);
+}
+
+static inline int isDigit(unsigned char c) {
+	return c >= '0' && c <= '9';
+}
+
+/**
+ * Length of the run of whitespace at the start of @p chars. Most values
+ * aren't preceded by any, so that is checked for before anything else.
+ */
+static size_t whitespaceRun(const unsigned char * chars, size_t length) {
+	size_t i = 0;
+	if (!length || !isSpace(chars[0])) return 0;
+#if defined(__SSE2__)
+	const __m128i space = _mm_set1_epi8(' '), nl = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r'), tab = _mm_set1_epi8('\t');
+	for (; i + 16 <= length; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(chars + i));
+		__m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, space), _mm_cmpeq_epi8(bytes, nl)),
+			_mm_or_si128(_mm_cmpeq_epi8(bytes, cr), _mm_cmpeq_epi8(bytes, tab)));
+		int mask = ~_mm_movemask_epi8(ws) & 0xFFFF;
+		if (mask) return i + __builtin_ctz(mask);
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	for (; i + 16 <= length; i += 16) {
+		uint8x16_t bytes = vld1q_u8(chars + i);
+		uint8x16_t ws = vorrq_u8(vorrq_u8(vceqq_u8(bytes, vdupq_n_u8(' ')), vceqq_u8(bytes, vdupq_n_u8('\n'))),
+			vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('\r')), vceqq_u8(bytes, vdupq_n_u8('\t'))));
+		if (vminvq_u8(ws) != 0xFF) break;
+	}
+#endif
+	/* Indentation is mostly spaces. */
+	for (; i + 8 <= length; i += 8) {
+		uint64_t word;
+		memcpy(&word, chars + i, 8);
+		if (word != 0x2020202020202020ULL) break;
+	}
+	while (i < length && isSpace(chars[i])) i++;
+	return i;
+}
+
+/**
+ * Length of the run of bytes at the start of @p chars that can go in a
+ * JSON string as they are: anything but a quote, a backslash or a control
+ * character, and, if @p asciiOnly is set, anything but non-ASCII bytes.
+ */
+static size_t plainRun(const unsigned char * chars, size_t length, int asciiOnly) {
+	size_t i = 0;
+#if defined(__SSE2__)
+	const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), control = _mm_set1_epi8(0x1F);
+	for (; i + 16 <= length; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(chars + i));
+		__m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash)),
+			_mm_cmpeq_epi8(_mm_max_epu8(bytes, control), control));
+		int mask = _mm_movemask_epi8(special);
+		if (asciiOnly) mask |= _mm_movemask_epi8(bytes);
+		if (mask) return i + __builtin_ctz(mask);
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	for (; i + 16 <= length; i += 16) {
+		uint8x16_t bytes = vld1q_u8(chars + i);
+		uint8x16_t special = vorrq_u8(vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('"')), vceqq_u8(bytes, vdupq_n_u8('\\'))),
+			vcltq_u8(bytes, vdupq_n_u8(0x20)));
+		if (asciiOnly) special = vorrq_u8(special, vcgeq_u8(bytes, vdupq_n_u8(0x80)));
+		if (vmaxvq_u8(special)) break;
+	}
+#endif
+	const uint64_t ones = 0x0101010101010101ULL, high = 0x8080808080808080ULL;
+	for (; i + 8 <= length; i += 8) {
+		uint64_t word;
+		memcpy(&word, chars + i, 8);
+		uint64_t quotes = word ^ (ones * '"'), backslashes = word ^ (ones * '\\');
+		/* Sets the top bit of the bytes that are zero, or less than 0x20, and possibly of bytes after them. */
+		uint64_t special = ((quotes - ones) & ~quotes) | ((backslashes - ones) & ~backslashes) | ((word - ones * 0x20) & ~word);
+		if (asciiOnly) special |= word;
+		if (special & high) break;
+	}
+	while (i < length && isPlain(chars[i], asciiOnly)) i++;
+	return i;
+}
+
+/**
+ * @brief Position in a document being parsed.
+ */
+struct Parser {
+	const unsigned char * start;  /**< Beginning of the document, to give positions in errors */
+	const unsigned char * p;      /**< Next byte to look at */
+	const unsigned char * end;
+	int depth;                    /**< Arrays and objects we are inside of */
+};
+
+/**
+ * Raise a ValueError for a problem at @p at, giving its line and column,
+ * and return 0.
+ */
+static int parseError(struct Parser * P, const unsigned char * at, const char * message) {
+	size_t line = 1;
+	const unsigned char * lineStart = P->start;
+	for (const unsigned char * c = P->start; c < at; ++c) {
+		if (*c == '\n') {
+			line++;
+			lineStart = c + 1;
+		}
+	}
+	krk_runtimeError(vm.exceptions->valueError, "%s: line %zu column %zu (char %zu)",
+		message, line, (size_t)(at - lineStart) + 1, (size_t)(at - P->start));
+	return 0;
+}
+
+static inline void skipWhitespace(struct Parser * P) {
+	P->p += whitespaceRun(P->p, P->end - P->p);
+}
+
+static int hex4(const unsigned char * c, const unsigned char * end, uint32_t * out) {
+	if (end - c < 4) return 0;
+	uint32_t value = 0;
+	for (int i = 0; i < 4; ++i) {
+		unsigned char h = c[i];
+		value <<= 4;
+		if (h >= '0' && h <= '9') value |= h - '0';
+		else if (h >= 'a' && h <= 'f') value |= h - 'a' + 10;
+		else if (h >= 'A' && h <= 'F') value |= h - 'A' + 10;
+		else return 0;
+	}
+	*out = value;
+	return 1;
+}
+
+/**
+ * Parse the string starting at the quote under @c P->p. Object keys are
+ * interned, as most documents repeat the same few of them many times.
+ */
+static int parseString(struct Parser * P, KrkValue * out, int isKey) {
+	const unsigned char * s = P->p + 1;
+	const unsigned char * c = s + plainRun(s, P->end - s, 0);
+
+	if (c < P->end && *c == '"') {
+		/* Nothing to unescape, so the string is exactly the bytes between the quotes. */
+		KrkString * str = isKey ? krk_copyString((const char*)s, c - s) : krk_copyStringUninterned((const char*)s, c - s);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return 0;
+		P->p = c + 1;
+		*out = OBJECT_VAL(str);
+		return 1;
+	}
+
+	struct StringBuilder sb = {0};
+	pushStringBuilderStr(&sb, (const char*)s, c - s);
+	while (1) {
+		if (c == P->end) {
+			discardStringBuilder(&sb);
+			return parseError(P, s - 1, "Unterminated string starting at");
+		}
+		if (*c == '"') break;
+		if (*c != '\\') {
+			discardStringBuilder(&sb);
+			return parseError(P, c, "Invalid control character at");
+		}
+		if (++c == P->end) continue;
+		switch (*c) {
+			case '"':  pushStringBuilder(&sb, '"'); break;
+			case '\\': pushStringBuilder(&sb, '\\'); break;
+			case '/':  pushStringBuilder(&sb, '/'); break;
+			case 'b':  pushStringBuilder(&sb, '\b'); break;
+			case 'f':  pushStringBuilder(&sb, '\f'); break;
+			case 'n':  pushStringBuilder(&sb, '\n'); break;
+			case 'r':  pushStringBuilder(&sb, '\r'); break;
+			case 't':  pushStringBuilder(&sb, '\t'); break;
+			case 'u': {
+				uint32_t codepoint, low;
+				if (!hex4(c + 1, P->end, &codepoint)) {
+					discardStringBuilder(&sb);
+					return parseError(P, c - 1, "Invalid \\uXXXX escape");
+				}
+				c += 4;
+				if (codepoint >= 0xD800 && codepoint <= 0xDBFF && P->end - c >= 7 && c[1] == '\\' && c[2] == 'u' &&
+				    hex4(c + 3, P->end, &low) && low >= 0xDC00 && low <= 0xDFFF) {
+					codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+					c += 6;
+				} else if (codepoint >= 0xD800 && codepoint <= 0xDFFF) {
+					/* Strings can't hold unpaired surrogates. */
+					codepoint = 0xFFFD;
+				}
+				unsigned char bytes[5];
+				size_t len = krk_codepointToBytes(codepoint, bytes);
+				pushStringBuilderStr(&sb, (const char*)bytes, len);
+				break;
+			}
+			default:
+				discardStringBuilder(&sb);
+				return parseError(P, c - 1, "Invalid \\escape");
+		}
+		c++;
+		const unsigned char * run = c;
+		c += plainRun(c, P->end - c, 0);
+		pushStringBuilderStr(&sb, (const char*)run, c - run);
+	}
+
+	P->p = c + 1;
+	if (isKey) {
+		*out = OBJECT_VAL(krk_copyString(sb.bytes, sb.length));
+		discardStringBuilder(&sb);
+	} else {
+		*out = finishStringBuilder(&sb);
+	}
+	return !(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION);
+}
+
+/**
+ * Parse a number. Integers that don't fit in an @c int are read as floats.
+ */
+static int parseNumber(struct Parser * P, KrkValue * out) {
+	const unsigned char * s = P->p, * c = s, * end = P->end;
+	int isFloat = 0;
+	if (*c == '-') c++;
+	if (c < end && *c == '0') {
+		c++;
+	} else if (c < end && *c >= '1' && *c <= '9') {
+		while (c < end && isDigit(*c)) c++;
+	} else {
+		return parseError(P, s, "Expecting value");
+	}
+	if (c < end && *c == '.') {
+		if (c + 1 == end || !isDigit(c[1])) return parseError(P, c + 1, "Expecting digit");
+		c++;
+		while (c < end && isDigit(*c)) c++;
+		isFloat = 1;
+	}
+	if (c < end && (*c == 'e' || *c == 'E')) {
+		c++;
+		if (c < end && (*c == '+' || *c == '-')) c++;
+		if (c == end || !isDigit(*c)) return parseError(P, c, "Expecting digit");
+		while (c < end && isDigit(*c)) c++;
+		isFloat = 1;
+	}
+	P->p = c;
+
+	size_t length = c - s;
+	int negative = *s == '-';
+	if (!isFloat && length - negative <= 18) {
+		krk_integer_type value = 0;
+		for (const unsigned char * d = s + negative; d < c; ++d) value = value * 10 + (*d - '0');
+		if (negative) value = -value;
+		if (value >= JSON_INT_MIN && value <= JSON_INT_MAX) {
+			*out = INTEGER_VAL(value);
+			return 1;
+		}
+	}
+
+	/* strtod wants a terminated string, which the source may not be. */
+	char tmp[64];
+	char * text = length < sizeof(tmp) ? tmp : malloc(length + 1);
+	memcpy(text, s, length);
+	text[length] = '\0';
+	*out = FLOATING_VAL(strtod(text, NULL));
+	if (text != tmp) free(text);
+	return 1;
+}
+
+static int parseValue(struct Parser * P, KrkValue * out);
+
+static int parseArray(struct Parser * P, KrkValue * out) {
+	if (++P->depth > JSON_MAX_DEPTH) return parseError(P, P->p, "Nesting too deep at");
+	P->p++;
+	KrkValue list = krk_list_of(0, NULL, 0);
+	krk_push(list);
+	skipWhitespace(P);
+	if (P->p < P->end && *P->p == ']') {
+		P->p++;
+	} else while (1) {
+		KrkValue value;
+		if (!parseValue(P, &value)) {
+			krk_pop();
+			return 0;
+		}
+		krk_push(value);
+		krk_writeValueArray(AS_LIST(list), value);
+		krk_pop();
+		skipWhitespace(P);
+		if (P->p < P->end && *P->p == ',') {
+			P->p++;
+			continue;
+		}
+		if (P->p < P->end && *P->p == ']') {
+			P->p++;
+			break;
+		}
+		krk_pop();
+		return parseError(P, P->p, "Expecting ',' delimiter");
+	}
+	P->depth--;
+	*out = krk_pop();
+	return 1;
+}
+
+static int parseObject(struct Parser * P, KrkValue * out) {
+	if (++P->depth > JSON_MAX_DEPTH) return parseError(P, P->p, "Nesting too deep at");
+	P->p++;
+	KrkValue dict = krk_dict_of(0, NULL, 0);
+	krk_push(dict);
+	skipWhitespace(P);
+	if (P->p < P->end && *P->p == '}') {
+		P->p++;
+	} else while (1) {
+		skipWhitespace(P);
+		if (P->p == P->end || *P->p != '"') {
+			krk_pop();
+			return parseError(P, P->p, "Expecting property name enclosed in double quotes");
+		}
+		KrkValue key, value;
+		if (!parseString(P, &key, 1)) {
+			krk_pop();
+			return 0;
+		}
+		krk_push(key);
+		skipWhitespace(P);
+		if (P->p == P->end || *P->p != ':') {
+			krk_pop();
+			krk_pop();
+			return parseError(P, P->p, "Expecting ':' delimiter");
+		}
+		P->p++;
+		if (!parseValue(P, &value)) {
+			krk_pop();
+			krk_pop();
+			return 0;
+		}
+		krk_push(value);
+		krk_tableSet(AS_DICT(dict), key, value);
+		krk_pop();
+		krk_pop();
+		skipWhitespace(P);
+		if (P->p < P->end && *P->p == ',') {
+			P->p++;
+			continue;
+		}
+		if (P->p < P->end && *P->p == '}') {
+			P->p++;
+			break;
+		}
+		krk_pop();
+		return parseError(P, P->p, "Expecting ',' delimiter");
+	}
+	P->depth--;
+	*out = krk_pop();
+	return 1;
+}
+
+static int parseLiteral(struct Parser * P, const char * literal, size_t length, KrkValue value, KrkValue * out) {
+	if ((size_t)(P->end - P->p) < length || memcmp(P->p, literal, length)) return parseError(P, P->p, "Expecting value");
+	P->p += length;
+	*out = value;
+	return 1;
+}
+
+static int parseValue(struct Parser * P, KrkValue * out) {
+	skipWhitespace(P);
+	if (P->p == P->end) return parseError(P, P->p, "Expecting value");
+	switch (*P->p) {
+		case '"': return parseString(P, out, 0);
+		case '[': return parseArray(P, out);
+		case '{': return parseObject(P, out);
+		case 't': return parseLiteral(P, "true", 4, BOOLEAN_VAL(1), out);
+		case 'f': return parseLiteral(P, "false", 5, BOOLEAN_VAL(0), out);
+		case 'n': return parseLiteral(P, "null", 4, NONE_VAL(), out);
+		case 'N': return parseLiteral(P, "NaN", 3, FLOATING_VAL(NAN), out);
+		case 'I': return parseLiteral(P, "Infinity", 8, FLOATING_VAL(INFINITY), out);
+		case '-':
+			if (P->end - P->p > 1 && P->p[1] == 'I') return parseLiteral(P, "-Infinity", 9, FLOATING_VAL(-INFINITY), out);
+			return parseNumber(P, out);
+		default:
+			if (isDigit(*P->p)) return parseNumber(P, out);
+			return parseError(P, P->p, "Expecting value");
+	}
+}
+
+/**
+ * Parse @p length bytes at @p chars as one value, with nothing but
+ * whitespace around it.
+ */
+static int parseDocument(const unsigned char * chars, size_t length, KrkValue * out) {
+	struct Parser P = {chars, chars, chars + length, 0};
+	if (!parseValue(&P, out)) return 0;
+	krk_push(*out);
+	skipWhitespace(&P);
+	krk_pop();
+	if (P.p != P.end) return parseError(&P, P.p, "Extra data");
+	return 1;
+}
+
+/** Get at the bytes of a str or bytes object, or raise a TypeError. */
+static int documentBytes(KrkValue value, const unsigned char ** chars, size_t * length) {
+	if (IS_STRING(value)) {
+		*chars = (const unsigned char*)AS_STRING(value)->chars;
+		*length = AS_STRING(value)->length;
+	} else if (IS_BYTES(value)) {
+		*chars = AS_BYTES(value)->bytes;
+		*length = AS_BYTES(value)->length;
+	} else {
+		krk_runtimeError(vm.exceptions->typeError, "the JSON object must be str or bytes, not '%s'", krk_typeName(value));
+		return 0;
+	}
+	return 1;
+}
+
+KRK_FUNC(loads,{
+	FUNCTION_TAKES_EXACTLY(1);
+	const unsigned char * chars;
+	size_t length;
+	if (!documentBytes(argv[0], &chars, &length)) return NONE_VAL();
+	KrkValue out;
+	if (!parseDocument(chars, length, &out)) return NONE_VAL();
+	return out;
+})
+
+/**
+ * @brief Output being built by @c dumps, and how to lay it out.
+ */
+struct Encoder {
+	struct StringBuilder sb;
+	const char * indent;         /**< Added once per level of nesting on each new line; NULL to keep everything on one line */
+	size_t indentLength;
+	const char * itemSeparator;
+	size_t itemSeparatorLength;
+	const char * keySeparator;
+	size_t keySeparatorLength;
+	int sortKeys;
+	int ensureAscii;             /**< Escape everything that isn't ASCII */
+	KrkValue fallback;           /**< Called to turn objects that can't be encoded into ones that can; None to raise instead */
+	int depth;
+	KrkObj * open[JSON_MAX_DEPTH]; /**< Containers being encoded, innermost last, to catch ones that contain themselves */
+};
+
+static void newline(struct Encoder * E) {
+	if (!E->indent) return;
+	pushStringBuilder(&E->sb, '\n');
+	for (int i = 0; i < E->depth; ++i) pushStringBuilderStr(&E->sb, E->indent, E->indentLength);
+}
+
+static int enter(struct Encoder * E, KrkObj * container) {
+	if (E->depth == JSON_MAX_DEPTH) {
+		krk_runtimeError(vm.exceptions->valueError, "Nesting too deep");
+		return 0;
+	}
+	for (int i = 0; i < E->depth; ++i) {
+		if (E->open[i] == container) {
+			krk_runtimeError(vm.exceptions->valueError, "Circular reference detected");
+			return 0;
+		}
+	}
+	E->open[E->depth++] = container;
+	return 1;
+}
+
+static void pushEscape(struct StringBuilder * sb, uint32_t codepoint) {
+	char tmp[8];
+	size_t len = snprintf(tmp, sizeof(tmp), "\\u%04x", (unsigned int)codepoint);
+	pushStringBuilderStr(sb, tmp, len);
+}
+
+static void encodeString(struct Encoder * E, KrkString * string) {
+	const unsigned char * c = (const unsigned char*)string->chars, * end = c + string->length;
+	pushStringBuilder(&E->sb, '"');
+	while (c < end) {
+		size_t run = plainRun(c, end - c, E->ensureAscii);
+		pushStringBuilderStr(&E->sb, (const char*)c, run);
+		c += run;
+		if (c == end) break;
+		switch (*c) {
+			case '"':  pushStringBuilderStr(&E->sb, "\\\"", 2); break;
+			case '\\': pushStringBuilderStr(&E->sb, "\\\\", 2); break;
+			case '\b': pushStringBuilderStr(&E->sb, "\\b", 2); break;
+			case '\f': pushStringBuilderStr(&E->sb, "\\f", 2); break;
+			case '\n': pushStringBuilderStr(&E->sb, "\\n", 2); break;
+			case '\r': pushStringBuilderStr(&E->sb, "\\r", 2); break;
+			case '\t': pushStringBuilderStr(&E->sb, "\\t", 2); break;
+			default:
+				if (*c < 0x80) {
+					pushEscape(&E->sb, *c);
+				} else {
+					/* Strings are valid UTF-8, so the lead byte says how long the sequence is. */
+					uint32_t codepoint;
+					if (*c < 0xE0) {
+						codepoint = (c[0] & 0x1F) << 6 | (c[1] & 0x3F);
+						c += 1;
+					} else if (*c < 0xF0) {
+						codepoint = (c[0] & 0x0F) << 12 | (c[1] & 0x3F) << 6 | (c[2] & 0x3F);
+						c += 2;
+					} else {
+						codepoint = (c[0] & 0x07) << 18 | (c[1] & 0x3F) << 12 | (c[2] & 0x3F) << 6 | (c[3] & 0x3F);
+						c += 3;
+					}
+					if (codepoint > 0xFFFF) {
+						codepoint -= 0x10000;
+						pushEscape(&E->sb, 0xD800 + (codepoint >> 10));
+						pushEscape(&E->sb, 0xDC00 + (codepoint & 0x3FF));
+					} else {
+						pushEscape(&E->sb, codepoint);
+					}
+				}
+		}
+		c++;
+	}
+	pushStringBuilder(&E->sb, '"');
+}
+
+/**
+ * Floats are written with as few digits as read back to the same value,
+ * and always look like floats, so they are read back as floats.
+ */
+static void encodeFloat(struct Encoder * E, double value) {
+	if (isnan(value)) {
+		pushStringBuilderStr(&E->sb, "NaN", 3);
+		return;
+	}
+	if (isinf(value)) {
+		if (value < 0) pushStringBuilderStr(&E->sb, "-Infinity", 9);
+		else pushStringBuilderStr(&E->sb, "Infinity", 8);
+		return;
+	}
+	char tmp[40];
+	size_t len = snprintf(tmp, sizeof(tmp), "%.16g", value);
+	if (strtod(tmp, NULL) != value) len = snprintf(tmp, sizeof(tmp), "%.17g", value);
+	if (!strpbrk(tmp, ".e")) {
+		tmp[len++] = '.';
+		tmp[len++] = '0';
+	}
+	pushStringBuilderStr(&E->sb, tmp, len);
+}
+
+static int encodeValue(struct Encoder * E, KrkValue value);
+
+/** Keys that aren't strings are turned into the strings JSON would write them as. */
+static int encodeKey(struct Encoder * E, KrkValue key) {
+	if (IS_STRING(key)) {
+		encodeString(E, AS_STRING(key));
+	} else if (IS_BOOLEAN(key) || IS_INTEGER(key) || IS_FLOATING(key) || IS_NONE(key)) {
+		pushStringBuilder(&E->sb, '"');
+		encodeValue(E, key);
+		pushStringBuilder(&E->sb, '"');
+	} else {
+		krk_runtimeError(vm.exceptions->typeError, "keys must be str, int, float, bool or None, not '%s'", krk_typeName(key));
+		return 0;
+	}
+	return 1;
+}
+
+static int encodeMember(struct Encoder * E, KrkValue key, KrkValue value, int first) {
+	if (!first) pushStringBuilderStr(&E->sb, E->itemSeparator, E->itemSeparatorLength);
+	newline(E);
+	if (!encodeKey(E, key)) return 0;
+	pushStringBuilderStr(&E->sb, E->keySeparator, E->keySeparatorLength);
+	/* The default function may change the dict, so hold on to what is being encoded from it. */
+	krk_push(value);
+	int result = encodeValue(E, value);
+	krk_pop();
+	return result;
+}
+
+static int encodeDict(struct Encoder * E, KrkValue value) {
+	KrkTable * table = AS_DICT(value);
+	if (!table->count) {
+		pushStringBuilderStr(&E->sb, "{}", 2);
+		return 1;
+	}
+	if (!enter(E, AS_OBJECT(value))) return 0;
+	pushStringBuilder(&E->sb, '{');
+	int first = 1;
+	if (E->sortKeys) {
+		KrkValue keys = krk_list_of(0, NULL, 0);
+		krk_push(keys);
+		for (size_t i = 0; i < table->used; ++i) {
+			if (IS_KWARGS(table->entries[i].key)) continue;
+			krk_writeValueArray(AS_LIST(keys), table->entries[i].key);
+		}
+		KrkValue sort;
+		krk_tableGet(&vm.baseClasses->listClass->methods, OBJECT_VAL(S("sort")), &sort);
+		krk_push(sort);
+		krk_push(keys);
+		krk_callStack(1);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) {
+			krk_pop();
+			return 0;
+		}
+		for (size_t i = 0; i < AS_LIST(keys)->count; ++i) {
+			KrkValue member;
+			if (!krk_tableGet(table, AS_LIST(keys)->values[i], &member)) continue;
+			if (!encodeMember(E, AS_LIST(keys)->values[i], member, first)) {
+				krk_pop();
+				return 0;
+			}
+			first = 0;
+		}
+		krk_pop();
+	} else {
+		/* The table is looked at again for each entry, in case the default function changes it. */
+		for (size_t i = 0; i < table->used; ++i) {
+			KrkTableEntry entry = table->entries[i];
+			if (IS_KWARGS(entry.key)) continue;
+			krk_push(entry.key);
+			int result = encodeMember(E, entry.key, entry.value, first);
+			krk_pop();
+			if (!result) return 0;
+			first = 0;
+		}
+	}
+	E->depth--;
+	newline(E);
+	pushStringBuilder(&E->sb, '}');
+	return 1;
+}
+
+static int encodeArray(struct Encoder * E, KrkValue value) {
+	KrkValueArray * values = IS_TUPLE(value) ? &AS_TUPLE(value)->values : AS_LIST(value);
+	if (!values->count) {
+		pushStringBuilderStr(&E->sb, "[]", 2);
+		return 1;
+	}
+	if (!enter(E, AS_OBJECT(value))) return 0;
+	pushStringBuilder(&E->sb, '[');
+	for (size_t i = 0; i < values->count; ++i) {
+		if (i) pushStringBuilderStr(&E->sb, E->itemSeparator, E->itemSeparatorLength);
+		newline(E);
+		KrkValue item = values->values[i];
+		krk_push(item);
+		int result = encodeValue(E, item);
+		krk_pop();
+		if (!result) return 0;
+	}
+	E->depth--;
+	newline(E);
+	pushStringBuilder(&E->sb, ']');
+	return 1;
+}
+
+static int encodeValue(struct Encoder * E, KrkValue value) {
+	if (IS_STRING(value)) {
+		encodeString(E, AS_STRING(value));
+	} else if (IS_BOOLEAN(value)) {
+		if (AS_BOOLEAN(value)) pushStringBuilderStr(&E->sb, "true", 4);
+		else pushStringBuilderStr(&E->sb, "false", 5);
+	} else if (IS_INTEGER(value)) {
+		char tmp[32];
+		size_t len = snprintf(tmp, sizeof(tmp), PRIkrk_int, AS_INTEGER(value));
+		pushStringBuilderStr(&E->sb, tmp, len);
+	} else if (IS_FLOATING(value)) {
+		encodeFloat(E, AS_FLOATING(value));
+	} else if (IS_NONE(value)) {
+		pushStringBuilderStr(&E->sb, "null", 4);
+	} else if (IS_TUPLE(value) || IS_list(value)) {
+		return encodeArray(E, value);
+	} else if (IS_dict(value)) {
+		return encodeDict(E, value);
+	} else if (!IS_NONE(E->fallback)) {
+		if (E->depth == JSON_MAX_DEPTH) {
+			krk_runtimeError(vm.exceptions->valueError, "Nesting too deep");
+			return 0;
+		}
+		krk_push(E->fallback);
+		krk_push(value);
+		KrkValue replacement = krk_callStack(1);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return 0;
+		krk_push(replacement);
+		E->depth++;
+		int result = encodeValue(E, replacement);
+		E->depth--;
+		krk_pop();
+		return result;
+	} else {
+		krk_runtimeError(vm.exceptions->typeError, "Object of type '%s' is not JSON serializable", krk_typeName(value));
+		return 0;
+	}
+	return 1;
+}
+
+static int separatorArg(KrkValue value, const char ** chars, size_t * length) {
+	if (!IS_STRING(value)) return 0;
+	*chars = AS_CSTRING(value);
+	*length = AS_STRING(value)->length;
+	return 1;
+}
+
+KRK_FUNC(dumps,{
+	FUNCTION_TAKES_EXACTLY(1);
+	KrkValue indent = NONE_VAL(), sortKeys = BOOLEAN_VAL(0), ensureAscii = BOOLEAN_VAL(1), separators = NONE_VAL();
+	struct Encoder * E = calloc(1, sizeof(struct Encoder));
+	E->fallback = NONE_VAL();
+	if (hasKw) {
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("indent")), &indent);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("sort_keys")), &sortKeys);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("ensure_ascii")), &ensureAscii);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("separators")), &separators);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("default")), &E->fallback);
+	}
+	E->sortKeys = !krk_isFalsey(sortKeys);
+	E->ensureAscii = !krk_isFalsey(ensureAscii);
+
+	/* An indent given as a number of spaces is made into a string of them, which is kept on the stack. */
+	int pushed = 0;
+	if (IS_INTEGER(indent) && !IS_BOOLEAN(indent)) {
+		struct StringBuilder spaces = {0};
+		for (krk_integer_type i = 0; i < AS_INTEGER(indent); ++i) pushStringBuilder(&spaces, ' ');
+		indent = finishStringBuilder(&spaces);
+		krk_push(indent);
+		pushed = 1;
+	}
+	if (IS_STRING(indent)) {
+		E->indent = AS_CSTRING(indent);
+		E->indentLength = AS_STRING(indent)->length;
+	} else if (!IS_NONE(indent)) {
+		free(E);
+		return TYPE_ERROR(int or str,indent);
+	}
+
+	E->itemSeparator = E->indent ? "," : ", ";
+	E->itemSeparatorLength = E->indent ? 1 : 2;
+	E->keySeparator = ": ";
+	E->keySeparatorLength = 2;
+	if (!IS_NONE(separators)) {
+		if (!IS_TUPLE(separators) || AS_TUPLE(separators)->values.count != 2 ||
+		    !separatorArg(AS_TUPLE(separators)->values.values[0], &E->itemSeparator, &E->itemSeparatorLength) ||
+		    !separatorArg(AS_TUPLE(separators)->values.values[1], &E->keySeparator, &E->keySeparatorLength)) {
+			if (pushed) krk_pop();
+			free(E);
+			return krk_runtimeError(vm.exceptions->typeError, "separators must be a tuple of two strings");
+		}
+	}
+
+	int result = encodeValue(E, argv[0]);
+	if (pushed) krk_pop();
+	KrkValue out = result ? finishStringBuilder(&E->sb) : discardStringBuilder(&E->sb);
+	free(E);
+	return out;
+})
+
+/**
+ * @brief Incremental parser for a stream of JSON values.
+ * @extends KrkInstance
+ *
+ * Bytes are held in @c buffer from the start of the value that is still
+ * being looked for the end of.
+ */
+struct JSONDecoder {
+	KrkInstance inst;
+	unsigned char * buffer;
+	size_t length;
+	size_t capacity;
+	size_t scanned;          /**< Bytes of @c buffer already scanned */
+	size_t start;            /**< Where the value being scanned begins */
+	size_t depth;            /**< Arrays and objects open in the value being scanned */
+	unsigned int inValue:1;  /**< Past the whitespace before a value */
+	unsigned int inString:1;
+	unsigned int escaped:1;  /**< Just after a backslash in a string */
+	unsigned int scalar:1;   /**< The value is a number or literal, which ends at the first byte that can't be part of one */
+};
+
+#define IS_JSONDecoder(o) (krk_isInstanceOf(o,JSONDecoderClass))
+#define AS_JSONDecoder(o) ((struct JSONDecoder*)AS_OBJECT(o))
+
+static void _JSONDecoder_gcsweep(KrkInstance * self) {
+	struct JSONDecoder * me = (struct JSONDecoder*)self;
+	FREE_ARRAY(unsigned char, me->buffer, me->capacity);
+	me->buffer = NULL;
+	me->capacity = 0;
+	me->length = 0;
+}
+
+static void resetScan(struct JSONDecoder * self) {
+	self->depth = 0;
+	self->inValue = 0;
+	self->inString = 0;
+	self->escaped = 0;
+	self->scalar = 0;
+}
+
+static inline int isScalarByte(unsigned char c) {
+	return isDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '+' || c == '.';
+}
+
+/** Parse the value that ends at @p end and add it to @p results. */
+static int emitValue(struct JSONDecoder * self, size_t end, KrkValue results) {
+	size_t start = self->start;
+	resetScan(self);
+	self->start = end;
+	KrkValue value;
+	if (!parseDocument(self->buffer + start, end - start, &value)) return 0;
+	krk_push(value);
+	krk_writeValueArray(AS_LIST(results), value);
+	krk_pop();
+	return 1;
+}
+
+/**
+ * Scan the bytes that have been added to the buffer since the last time,
+ * parsing each value that is found the end of.
+ */
+static int scanValues(struct JSONDecoder * self, KrkValue results) {
+	const unsigned char * buffer = self->buffer;
+	size_t i = self->scanned, length = self->length;
+	while (i < length) {
+		if (!self->inValue) {
+			i += whitespaceRun(buffer + i, length - i);
+			if (i == length) break;
+			self->inValue = 1;
+			self->start = i;
+			unsigned char c = buffer[i++];
+			if (c == '[' || c == '{') self->depth = 1;
+			else if (c == '"') self->inString = 1;
+			else self->scalar = 1;
+		} else if (self->escaped) {
+			self->escaped = 0;
+			i++;
+		} else if (self->inString) {
+			i += plainRun(buffer + i, length - i, 0);
+			if (i == length) break;
+			unsigned char c = buffer[i++];
+			if (c == '\\') {
+				self->escaped = 1;
+			} else if (c == '"') {
+				self->inString = 0;
+				if (!self->depth && !emitValue(self, i, results)) return 0;
+			}
+		} else if (self->scalar) {
+			if (isScalarByte(buffer[i])) i++;
+			else if (!emitValue(self, i, results)) return 0;
+		} else {
+			unsigned char c = buffer[i++];
+			if (c == '"') {
+				self->inString = 1;
+			} else if (c == '[' || c == '{') {
+				self->depth++;
+			} else if (c == ']' || c == '}') {
+				if (!--self->depth && !emitValue(self, i, results)) return 0;
+			}
+		}
+	}
+	self->scanned = i;
+	return 1;
+}
+
+/** Drop the bytes before the value still being scanned. */
+static void compact(struct JSONDecoder * self) {
+	size_t keep = self->inValue ? self->start : self->scanned;
+	memmove(self->buffer, self->buffer + keep, self->length - keep);
+	self->length -= keep;
+	self->scanned -= keep;
+	self->start = self->inValue ? 0 : self->scanned;
+}
+
+#define CURRENT_CTYPE struct JSONDecoder *
+#define CURRENT_NAME  self
+
+KRK_METHOD(JSONDecoder,__init__,{
+	METHOD_TAKES_NONE();
+	_JSONDecoder_gcsweep((KrkInstance*)self);
+	self->scanned = 0;
+	self->start = 0;
+	resetScan(self);
+	return argv[0];
+})
+
+KRK_METHOD(JSONDecoder,feed,{
+	METHOD_TAKES_EXACTLY(1);
+	const unsigned char * chars;
+	size_t length;
+	if (!documentBytes(argv[1], &chars, &length)) return NONE_VAL();
+	if (self->length + length > self->capacity) {
+		size_t old = self->capacity;
+		while (self->capacity < self->length + length) self->capacity = GROW_CAPACITY(self->capacity);
+		self->buffer = GROW_ARRAY(unsigned char, self->buffer, old, self->capacity);
+	}
+	memcpy(self->buffer + self->length, chars, length);
+	self->length += length;
+
+	KrkValue results = krk_list_of(0, NULL, 0);
+	krk_push(results);
+	int ok = scanValues(self, results);
+	if (!ok) self->scanned = self->start;
+	compact(self);
+	if (!ok) {
+		krk_pop();
+		return NONE_VAL();
+	}
+	return krk_pop();
+})
+
+KRK_METHOD(JSONDecoder,close,{
+	METHOD_TAKES_NONE();
+	KrkValue results = krk_list_of(0, NULL, 0);
+	krk_push(results);
+	int ok = 1;
+	if (self->scalar) {
+		ok = emitValue(self, self->length, results);
+	} else if (self->inValue) {
+		struct Parser P = {self->buffer + self->start, self->buffer + self->start, self->buffer + self->length, 0};
+		ok = parseError(&P, P.end, self->inString ? "Unterminated string" : "Unterminated value");
+	}
+	self->length = 0;
+	self->scanned = 0;
+	self->start = 0;
+	resetScan(self);
+	if (!ok) {
+		krk_pop();
+		return NONE_VAL();
+	}
+	return krk_pop();
+})
+
+KRK_METHOD(JSONDecoder,decode,{
+	METHOD_TAKES_EXACTLY(1);
+	return _krk_loads(1, &argv[1], 0);
+})
+
+#undef CURRENT_CTYPE
+
+KrkValue krk_module_onload__json(void) {
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	krk_push(OBJECT_VAL(module));
+
+	KRK_DOC(module, "@brief Native JSON parser and serializer; use the @c json module.");
+
+	KRK_DOC(BIND_FUNC(module,loads),
+		"@brief Parse @p s as a JSON document.\n"
+		"@arguments s\n\n"
+		"@p s may be a @ref str or UTF-8 @ref bytes. Objects become dicts, arrays become lists, and numbers "
+		"become ints, or floats if they have a fraction or an exponent or are too big for an int. "
+		"@c NaN, @c Infinity and @c -Infinity are accepted, as they are written by @ref dumps. "
+		"Escaped surrogates that aren't part of a pair become U+FFFD. Raises @ref ValueError, "
+		"giving the line and column, if @p s isn't valid JSON.");
+	KRK_DOC(BIND_FUNC(module,dumps),
+		"@brief Serialize @p obj as a JSON document.\n"
+		"@arguments obj,indent=None,sort_keys=False,ensure_ascii=True,separators=None,default=None\n\n"
+		"Dicts, lists, tuples, strings, numbers, booleans and @c None can be serialized. If @p default is given, "
+		"it is called with anything else, and should return something that can be. "
+		"With an @p indent, given as a number of spaces or as a string, each member of an array or object "
+		"goes on its own line. @p separators is a tuple of the strings to put between items and between keys "
+		"and values; they are @c ', ' and @c ': ' by default, or @c ',' and @c ': ' with an indent. "
+		"If @p ensure_ascii is true, characters outside of ASCII are written as escapes.");
+
+	KrkClass * JSONDecoder = krk_makeClass(module, &JSONDecoderClass, "JSONDecoder", vm.baseClasses->objectClass);
+	KRK_DOC(JSONDecoder,
+		"@brief Parser for JSON that arrives a piece at a time.\n\n"
+		"Pieces of a stream of JSON values, one after another and separated by any whitespace, "
+		"such as a JSON Lines file, are passed to @ref feed as they are read, and the complete values "
+		"come back from it as soon as the end of each one has been seen. Pieces may be @ref str or "
+		"@ref bytes, and may split a value, or a UTF-8 sequence in it, anywhere.");
+	JSONDecoder->allocSize = sizeof(struct JSONDecoder);
+	JSONDecoder->_ongcsweep = _JSONDecoder_gcsweep;
+	BIND_METHOD(JSONDecoder,__init__);
+	KRK_DOC(BIND_METHOD(JSONDecoder,feed),
+		"@brief Add @p data to the stream, and return a list of the values it completed.\n"
+		"@arguments data\n\n"
+		"A number at the end of the stream isn't returned until something follows it, or the stream is closed. "
+		"If a value isn't valid JSON, it is dropped and @ref ValueError is raised.");
+	KRK_DOC(BIND_METHOD(JSONDecoder,close),
+		"@brief End the stream, and return a list of any value that was waiting for it to end.\n\n"
+		"Raises @ref ValueError if the stream ends in the middle of a value. The decoder can be fed "
+		"a new stream afterwards.");
+	KRK_DOC(BIND_METHOD(JSONDecoder,decode),
+		"@brief Parse @p s as a whole JSON document, as @ref loads does.\n"
+		"@arguments s");
+	krk_finalizeClass(JSONDecoder);
+
+	return krk_pop();
+}
@@ -0,0 +1,850 @@
+/**
+ * @file    module_array.c
+ * @brief   Arrays of numbers of one C type, stored contiguously.
+ *
+ * An array owns a buffer of values of the type named by its typecode, as in
+ * Python's @c array module. Slicing an array doesn't copy it: the slice is a
+ * view, which refers to the buffer of the array it was taken from through
+ * an offset and a stride, and works out where that buffer is each time it
+ * is used, so views stay valid when the array they look at grows.
+ *
+ * Arithmetic and reductions are done in loops over one C type, with the
+ * operands first converted to a contiguous buffer of the result type when
+ * they aren't already laid out that way.
+ */
+#include <string.h>
+#include <kuroko/vm.h>
+#include <kuroko/memory.h>
+#include <kuroko/util.h>
+
+static KrkVMLocal arrayKey;
+#define arrayClass KRK_VM_LOCAL(KrkClass*,arrayKey)
+static KrkVMLocal arrayiteratorKey;
+#define arrayiterator KRK_VM_LOCAL(KrkClass*,arrayiteratorKey)
+
+/**
+ * Every type an array can hold: name, typecode, C type, an unsigned type
+ * integer arithmetic is done in so overflow wraps, and whether it is a
+ * floating point type.
+ */
+#define ARRAY_TYPES(X) \
+	X(b, 'b', int8_t,   unsigned int, 0) \
+	X(B, 'B', uint8_t,  unsigned int, 0) \
+	X(h, 'h', int16_t,  unsigned int, 0) \
+	X(H, 'H', uint16_t, unsigned int, 0) \
+	X(i, 'i', int32_t,  uint32_t,     0) \
+	X(I, 'I', uint32_t, uint32_t,     0) \
+	X(l, 'l', int64_t,  uint64_t,     0) \
+	X(L, 'L', uint64_t, uint64_t,     0) \
+	X(q, 'q', int64_t,  uint64_t,     0) \
+	X(Q, 'Q', uint64_t, uint64_t,     0) \
+	X(f, 'f', float,    float,        1) \
+	X(d, 'd', double,   double,       1)
+
+/**
+ * @brief Typed array of numbers.
+ * @extends KrkInstance
+ */
+struct Array {
+	KrkInstance inst;
+	char * data;        /**< Owned buffer; NULL for views */
+	size_t length;      /**< Values in the array */
+	size_t capacity;    /**< Values there is room for in @c data */
+	KrkValue base;      /**< For a view, the array that owns the buffer; otherwise None */
+	ssize_t offset;     /**< For a view, where its first value is in the buffer */
+	ssize_t stride;     /**< Values from one element to the next; 1 unless this is a view */
+	char typecode;
+	unsigned char itemsize;
+};
+
+#define IS_array(o) (krk_isInstanceOf(o,arrayClass))
+#define AS_array(o) ((struct Array*)AS_OBJECT(o))
+
+/** The @p i th value of @p self, whose first value is at @p data. */
+#define ELEMENT(self,data,i) ((data) + (ssize_t)(i) * (self)->stride * (ssize_t)(self)->itemsize)
+
+enum { ARRAY_ADD, ARRAY_SUB, ARRAY_MUL, ARRAY_DIV };
+
+#define BOX_0(v) INTEGER_VAL(v)
+#define BOX_1(v) FLOATING_VAL(v)
+#define ACC_0 uint64_t
+#define ACC_1 double
+
+static size_t itemsizeOf(char code) {
+	switch (code) {
+#define X(n,c,t,u,f) case c: return sizeof(t);
+		ARRAY_TYPES(X)
+#undef X
+	}
+	return 0;
+}
+
+static int isFloatCode(char code) {
+	return code == 'f' || code == 'd';
+}
+
+static KrkValue boxValue(char code, const char * p) {
+	switch (code) {
+#define X(n,c,t,u,f) case c: return BOX_ ## f (*(const t*)p);
+		ARRAY_TYPES(X)
+#undef X
+	}
+	return NONE_VAL();
+}
+
+static int64_t readInteger(char code, const char * p) {
+	switch (code) {
+#define X(n,c,t,u,f) case c: return (int64_t)*(const t*)p;
+		ARRAY_TYPES(X)
+#undef X
+	}
+	return 0;
+}
+
+static double readDouble(char code, const char * p) {
+	switch (code) {
+#define X(n,c,t,u,f) case c: return (double)*(const t*)p;
+		ARRAY_TYPES(X)
+#undef X
+	}
+	return 0;
+}
+
+#define STORE_0(t) \
+	if (!IS_INTEGER(value)) goto _notNumber; \
+	int64_t x = AS_INTEGER(value); \
+	if ((int64_t)(t)x != x || (x < 0 && (t)-1 > 0)) goto _outOfRange; \
+	*(t*)p = (t)x; \
+	return 1;
+
+#define STORE_1(t) \
+	if (IS_INTEGER(value)) *(t*)p = (t)AS_INTEGER(value); \
+	else if (IS_FLOATING(value)) *(t*)p = (t)AS_FLOATING(value); \
+	else goto _notNumber; \
+	return 1;
+
+/**
+ * Store @p value as a @p code at @p p. Returns 0, with an exception set,
+ * if it is not a number that fits.
+ */
+static int storeValue(char code, char * p, KrkValue value) {
+	switch (code) {
+#define X(n,c,t,u,f) case c: { STORE_ ## f(t) }
+		ARRAY_TYPES(X)
+#undef X
+	}
+	return 0;
+_notNumber:
+	krk_runtimeError(vm.exceptions->typeError, "array of type '%c' can not hold '%s'", code, krk_typeName(value));
+	return 0;
+_outOfRange:
+	krk_runtimeError(vm.exceptions->valueError, "value out of range for array of type '%c'", code);
+	return 0;
+}
+
+/**
+ * Where the first value of @p self is. For a view, this checks the array
+ * it looks at still has all of its values, which calling its @c \__init__
+ * again can take away, and returns 0 with an exception set if not.
+ */
+static int arrayBuffer(struct Array * self, char ** out) {
+	if (IS_NONE(self->base)) {
+		*out = self->data;
+		return 1;
+	}
+	struct Array * base = AS_array(self->base);
+	if (base->typecode != self->typecode) {
+		krk_runtimeError(vm.exceptions->valueError, "view of an array that has changed type");
+		return 0;
+	}
+	if (self->length) {
+		ssize_t last = self->offset + (ssize_t)(self->length - 1) * self->stride;
+		if (self->offset >= (ssize_t)base->length || last < 0 || last >= (ssize_t)base->length) {
+			krk_runtimeError(vm.exceptions->valueError, "view of an array that has shrunk");
+			return 0;
+		}
+	}
+	*out = base->data + self->offset * (ssize_t)self->itemsize;
+	return 1;
+}
+
+static int sharesBuffer(struct Array * a, struct Array * b) {
+	struct Array * baseA = IS_NONE(a->base) ? a : AS_array(a->base);
+	struct Array * baseB = IS_NONE(b->base) ? b : AS_array(b->base);
+	return baseA == baseB;
+}
+
+/**
+ * Get the values of @p self as a contiguous buffer of @p code values. If
+ * they are already laid out that way, and @p copy is not set, this is the
+ * array's own buffer; otherwise they are converted into a new one and
+ * @p owned is set, and the caller frees it.
+ */
+static int asContiguous(struct Array * self, char code, int copy, char ** out, int * owned) {
+	char * data;
+	if (!arrayBuffer(self, &data)) return 0;
+	*owned = 0;
+	if (!copy && self->typecode == code && self->stride == 1) {
+		*out = data;
+		return 1;
+	}
+	size_t itemsize = itemsizeOf(code);
+	char * buf = ALLOCATE(char, self->length * itemsize + 1);
+	if (self->typecode == code) {
+		for (size_t i = 0; i < self->length; ++i) {
+			memcpy(buf + i * itemsize, ELEMENT(self,data,i), itemsize);
+		}
+	} else if (isFloatCode(code)) {
+		for (size_t i = 0; i < self->length; ++i) {
+			double x = readDouble(self->typecode, ELEMENT(self,data,i));
+			if (code == 'f') ((float*)buf)[i] = x;
+			else ((double*)buf)[i] = x;
+		}
+	} else {
+		for (size_t i = 0; i < self->length; ++i) {
+			int64_t x = readInteger(self->typecode, ELEMENT(self,data,i));
+			switch (code) {
+#define X(n,c,t,u,f) case c: ((t*)buf)[i] = (t)x; break;
+				ARRAY_TYPES(X)
+#undef X
+			}
+		}
+	}
+	*out = buf;
+	*owned = 1;
+	return 1;
+}
+
+static void freeContiguous(char * buf, int owned, size_t length, char code) {
+	if (owned) FREE_ARRAY(char, buf, length * itemsizeOf(code) + 1);
+}
+
+static void arrayReserve(struct Array * self, size_t capacity) {
+	if (capacity <= self->capacity) return;
+	size_t old = self->capacity;
+	while (self->capacity < capacity) self->capacity = GROW_CAPACITY(self->capacity);
+	self->data = GROW_ARRAY(char, self->data, old * self->itemsize, self->capacity * self->itemsize);
+}
+
+/** Make a new array of @p length uninitialised @p code values, and push it. */
+static struct Array * pushNewArray(char code, size_t length) {
+	struct Array * out = (struct Array*)krk_newInstance(arrayClass);
+	krk_push(OBJECT_VAL(out));
+	out->base = NONE_VAL();
+	out->stride = 1;
+	out->typecode = code;
+	out->itemsize = itemsizeOf(code);
+	arrayReserve(out, length);
+	out->length = length;
+	return out;
+}
+
+static int arrayAppend(struct Array * self, KrkValue value) {
+	arrayReserve(self, self->length + 1);
+	if (!storeValue(self->typecode, self->data + self->length * self->itemsize, value)) return 0;
+	self->length++;
+	return 1;
+}
+
+static int arrayFromBytes(struct Array * self, const uint8_t * bytes, size_t length) {
+	if (length % self->itemsize) {
+		krk_runtimeError(vm.exceptions->valueError, "bytes length not a multiple of item size");
+		return 0;
+	}
+	if (!length) return 1;
+	arrayReserve(self, self->length + length / self->itemsize);
+	memcpy(self->data + self->length * self->itemsize, bytes, length);
+	self->length += length / self->itemsize;
+	return 1;
+}
+
+/** Add the values of @p iterable to the end of @p self. Returns 0 on an exception. */
+static int arrayExtend(struct Array * self, KrkValue iterable) {
+	if (IS_array(iterable)) {
+		struct Array * them = AS_array(iterable);
+		char * buf;
+		int owned;
+		if (!asContiguous(them, self->typecode, sharesBuffer(self, them), &buf, &owned)) return 0;
+		arrayReserve(self, self->length + them->length);
+		if (them->length) memcpy(self->data + self->length * self->itemsize, buf, them->length * self->itemsize);
+		self->length += them->length;
+		freeContiguous(buf, owned, them->length, self->typecode);
+		return 1;
+	} else if (IS_BYTES(iterable)) {
+		return arrayFromBytes(self, AS_BYTES(iterable)->bytes, AS_BYTES(iterable)->length);
+	} else if (IS_list(iterable) || IS_TUPLE(iterable)) {
+		KrkValueArray * values = IS_TUPLE(iterable) ? &AS_TUPLE(iterable)->values : AS_LIST(iterable);
+		arrayReserve(self, self->length + values->count);
+		for (size_t i = 0; i < values->count; ++i) {
+			if (!arrayAppend(self, values->values[i])) return 0;
+		}
+		return 1;
+	}
+
+	KrkClass * type = krk_getType(iterable);
+	if (!type->_iter) {
+		krk_runtimeError(vm.exceptions->typeError, "'%s' object is not iterable", krk_typeName(iterable));
+		return 0;
+	}
+	krk_push(iterable);
+	KrkValue iter = krk_callDirect(type->_iter, 1);
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return 0;
+	krk_push(iter);
+	for (;;) {
+		krk_push(iter);
+		KrkValue value = krk_callStack(0);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) break;
+		if (krk_valuesSame(value, iter)) break;
+		if (!arrayAppend(self, value)) break;
+	}
+	krk_pop();
+	return !(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION);
+}
+
+/* Loops over one type, written so the compiler can vectorize them. */
+#define X(n,c,t,u,f) \
+static void binary_ ## n (int op, t * out, const t * a, const t * b, size_t count) { \
+	switch (op) { \
+		case ARRAY_ADD: for (size_t i = 0; i < count; ++i) out[i] = (t)((u)a[i] + (u)b[i]); break; \
+		case ARRAY_SUB: for (size_t i = 0; i < count; ++i) out[i] = (t)((u)a[i] - (u)b[i]); break; \
+		case ARRAY_MUL: for (size_t i = 0; i < count; ++i) out[i] = (t)((u)a[i] * (u)b[i]); break; \
+		case ARRAY_DIV: if (f) for (size_t i = 0; i < count; ++i) out[i] = a[i] / b[i]; break; \
+	} \
+} \
+static void scalar_ ## n (int op, t * out, const t * a, t s, size_t count, int reversed) { \
+	switch (op) { \
+		case ARRAY_ADD: for (size_t i = 0; i < count; ++i) out[i] = (t)((u)a[i] + (u)s); break; \
+		case ARRAY_SUB: \
+			if (reversed) for (size_t i = 0; i < count; ++i) out[i] = (t)((u)s - (u)a[i]); \
+			else for (size_t i = 0; i < count; ++i) out[i] = (t)((u)a[i] - (u)s); \
+			break; \
+		case ARRAY_MUL: for (size_t i = 0; i < count; ++i) out[i] = (t)((u)a[i] * (u)s); break; \
+		case ARRAY_DIV: \
+			if (!f) break; \
+			if (reversed) for (size_t i = 0; i < count; ++i) out[i] = s / a[i]; \
+			else for (size_t i = 0; i < count; ++i) out[i] = a[i] / s; \
+			break; \
+	} \
+} \
+static KrkValue sum_ ## n (const t * a, size_t count) { \
+	ACC_ ## f acc = 0; \
+	for (size_t i = 0; i < count; ++i) acc += a[i]; \
+	return BOX_ ## f (acc); \
+} \
+static KrkValue dot_ ## n (const t * a, const t * b, size_t count) { \
+	ACC_ ## f acc = 0; \
+	for (size_t i = 0; i < count; ++i) acc += (ACC_ ## f)a[i] * (ACC_ ## f)b[i]; \
+	return BOX_ ## f (acc); \
+} \
+static KrkValue min_ ## n (const t * a, size_t count) { \
+	t best = a[0]; \
+	for (size_t i = 1; i < count; ++i) best = a[i] < best ? a[i] : best; \
+	return BOX_ ## f (best); \
+} \
+static KrkValue max_ ## n (const t * a, size_t count) { \
+	t best = a[0]; \
+	for (size_t i = 1; i < count; ++i) best = a[i] > best ? a[i] : best; \
+	return BOX_ ## f (best); \
+}
+ARRAY_TYPES(X)
+#undef X
+
+/**
+ * The type of the result of @p op between a @p self array and @p other,
+ * which is either another array's typecode or, if @p isScalar, 'q' for an
+ * integer or 'd' for a float.
+ */
+static char promote(char self, char other, int isScalar, int op) {
+	if (isScalar) {
+		if (isFloatCode(self)) return self;
+		if (op == ARRAY_DIV || isFloatCode(other)) return 'd';
+		return self;
+	}
+	if (self == other && (op != ARRAY_DIV || isFloatCode(self))) return self;
+	if (op == ARRAY_DIV || isFloatCode(self) || isFloatCode(other)) return 'd';
+	return 'q';
+}
+
+/**
+ * @p a @p op @p b, where @p a is an array and @p b is an array or a number.
+ * If @p reversed, the number is the left operand. If @p inplace, the result
+ * is written over @p a, if it can hold it; otherwise this is not implemented
+ * and the operator falls back to making a new array. A view that isn't
+ * contiguous is worked on in a copy, which is then written back.
+ */
+static KrkValue arrayBinary(KrkValue a, KrkValue b, int op, int reversed, int inplace) {
+	struct Array * self = AS_array(a);
+	struct Array * other = NULL;
+	char code;
+	if (IS_array(b)) {
+		other = AS_array(b);
+		if (other->length != self->length) return krk_runtimeError(vm.exceptions->valueError, "arrays have different lengths");
+		code = promote(self->typecode, other->typecode, 0, op);
+	} else if (IS_INTEGER(b)) {
+		code = promote(self->typecode, 'q', 1, op);
+	} else if (IS_FLOATING(b)) {
+		code = promote(self->typecode, 'd', 1, op);
+	} else {
+		return NOTIMPL_VAL();
+	}
+	if (inplace && code != self->typecode) return NOTIMPL_VAL();
+
+	union { int64_t i; double d; char bytes[8]; } scalar;
+	if (!other && !storeValue(code, scalar.bytes, b)) return NONE_VAL();
+
+	char * out, * left, * right = NULL;
+	int leftOwned, rightOwned = 0;
+	if (inplace) {
+		krk_push(a);
+		if (!asContiguous(self, code, 0, &left, &leftOwned)) {
+			krk_pop();
+			return NONE_VAL();
+		}
+		out = left;
+	} else {
+		out = pushNewArray(code, self->length)->data;
+		if (!asContiguous(self, code, 0, &left, &leftOwned)) {
+			krk_pop();
+			return NONE_VAL();
+		}
+	}
+	if (other && !asContiguous(other, code, inplace && sharesBuffer(self, other), &right, &rightOwned)) {
+		freeContiguous(left, leftOwned, self->length, code);
+		krk_pop();
+		return NONE_VAL();
+	}
+
+	switch (code) {
+#define X(n,c,t,u,f) case c: \
+		if (other) binary_ ## n (op, (t*)out, (const t*)left, (const t*)right, self->length); \
+		else scalar_ ## n (op, (t*)out, (const t*)left, *(t*)scalar.bytes, self->length, reversed); \
+		break;
+		ARRAY_TYPES(X)
+#undef X
+	}
+
+	if (inplace && leftOwned) {
+		char * data;
+		arrayBuffer(self, &data);
+		for (size_t i = 0; i < self->length; ++i) memcpy(ELEMENT(self,data,i), left + i * self->itemsize, self->itemsize);
+	}
+	freeContiguous(left, leftOwned, self->length, code);
+	if (other) freeContiguous(right, rightOwned, other->length, code);
+	return krk_pop();
+}
+
+#define CURRENT_CTYPE struct Array *
+#define CURRENT_NAME  self
+
+#define ARRAY_WRAP_INDEX() \
+	if (index < 0) index += self->length; \
+	if (index < 0 || index >= (krk_integer_type)self->length) return krk_runtimeError(vm.exceptions->indexError, "array index out of range")
+
+static void _array_gcscan(KrkInstance * self) {
+	krk_markValue(((struct Array*)self)->base);
+}
+
+static void _array_gcsweep(KrkInstance * self) {
+	struct Array * me = (struct Array*)self;
+	if (me->data) FREE_ARRAY(char, me->data, me->capacity * me->itemsize);
+	me->data = NULL;
+	me->capacity = 0;
+	me->length = 0;
+}
+
+KRK_METHOD(array,__init__,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	CHECK_ARG(1,str,KrkString*,typecode);
+	if (typecode->length != 1 || !itemsizeOf(typecode->chars[0])) {
+		return krk_runtimeError(vm.exceptions->valueError, "bad typecode (must be b, B, h, H, i, I, l, L, q, Q, f or d)");
+	}
+	_array_gcsweep((KrkInstance*)self);
+	self->base = NONE_VAL();
+	self->offset = 0;
+	self->stride = 1;
+	self->typecode = typecode->chars[0];
+	self->itemsize = itemsizeOf(self->typecode);
+	if (argc > 2 && !arrayExtend(self, argv[2])) return NONE_VAL();
+	return argv[0];
+})
+
+KRK_METHOD(array,typecode,{
+	METHOD_TAKES_NONE();
+	return OBJECT_VAL(krk_copyString(&self->typecode, 1));
+})
+
+KRK_METHOD(array,itemsize,{
+	METHOD_TAKES_NONE();
+	return INTEGER_VAL(self->itemsize);
+})
+
+KRK_METHOD(array,__len__,{
+	METHOD_TAKES_NONE();
+	return INTEGER_VAL(self->length);
+})
+
+KRK_METHOD(array,__getitem__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (IS_INTEGER(argv[1])) {
+		CHECK_ARG(1,int,krk_integer_type,index);
+		ARRAY_WRAP_INDEX();
+		char * data;
+		if (!arrayBuffer(self, &data)) return NONE_VAL();
+		return boxValue(self->typecode, ELEMENT(self,data,index));
+	} else if (IS_slice(argv[1])) {
+		KRK_SLICER(argv[1],self->length) {
+			return NONE_VAL();
+		}
+		size_t length = step > 0 ? (end - start + step - 1) / step : (start - end - step - 1) / -step;
+		struct Array * view = (struct Array*)krk_newInstance(arrayClass);
+		view->base = IS_NONE(self->base) ? argv[0] : self->base;
+		view->offset = self->offset + start * self->stride;
+		view->stride = self->stride * step;
+		view->length = length;
+		view->typecode = self->typecode;
+		view->itemsize = self->itemsize;
+		return OBJECT_VAL(view);
+	} else {
+		return TYPE_ERROR(int or slice, argv[1]);
+	}
+})
+
+KRK_METHOD(array,__setitem__,{
+	METHOD_TAKES_EXACTLY(2);
+	if (IS_INTEGER(argv[1])) {
+		CHECK_ARG(1,int,krk_integer_type,index);
+		ARRAY_WRAP_INDEX();
+		char * data;
+		if (!arrayBuffer(self, &data)) return NONE_VAL();
+		if (!storeValue(self->typecode, ELEMENT(self,data,index), argv[2])) return NONE_VAL();
+		return argv[2];
+	} else if (IS_slice(argv[1])) {
+		/* Fill in a view of the slice; it isn't an object, as nothing needs to refer to it. */
+		KRK_SLICER(argv[1],self->length) {
+			return NONE_VAL();
+		}
+		struct Array view = *self;
+		view.offset = self->offset + start * self->stride;
+		view.stride = self->stride * step;
+		view.length = step > 0 ? (end - start + step - 1) / step : (start - end - step - 1) / -step;
+		if (IS_NONE(self->base)) {
+			view.base = argv[0];
+			view.offset = start;
+		}
+		char * data;
+		if (!arrayBuffer(&view, &data)) return NONE_VAL();
+
+		if (IS_INTEGER(argv[2]) || IS_FLOATING(argv[2])) {
+			char value[8];
+			if (!storeValue(view.typecode, value, argv[2])) return NONE_VAL();
+			for (size_t i = 0; i < view.length; ++i) memcpy(ELEMENT(&view,data,i), value, view.itemsize);
+		} else if (IS_array(argv[2])) {
+			struct Array * them = AS_array(argv[2]);
+			if (them->length != view.length) return krk_runtimeError(vm.exceptions->valueError, "can only assign an array of the same length to a slice");
+			char * buf;
+			int owned;
+			if (!asContiguous(them, view.typecode, sharesBuffer(&view, them), &buf, &owned)) return NONE_VAL();
+			for (size_t i = 0; i < view.length; ++i) memcpy(ELEMENT(&view,data,i), buf + i * view.itemsize, view.itemsize);
+			freeContiguous(buf, owned, them->length, view.typecode);
+		} else if (IS_list(argv[2]) || IS_TUPLE(argv[2])) {
+			KrkValueArray * values = IS_TUPLE(argv[2]) ? &AS_TUPLE(argv[2])->values : AS_LIST(argv[2]);
+			if (values->count != view.length) return krk_runtimeError(vm.exceptions->valueError, "can only assign a sequence of the same length to a slice");
+			for (size_t i = 0; i < view.length; ++i) {
+				if (!storeValue(view.typecode, ELEMENT(&view,data,i), values->values[i])) return NONE_VAL();
+			}
+		} else {
+			return TYPE_ERROR(number or sequence, argv[2]);
+		}
+		return argv[2];
+	} else {
+		return TYPE_ERROR(int or slice, argv[1]);
+	}
+})
+
+KRK_METHOD(array,append,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_NONE(self->base)) return krk_runtimeError(vm.exceptions->valueError, "cannot resize a view");
+	arrayAppend(self, argv[1]);
+})
+
+KRK_METHOD(array,extend,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_NONE(self->base)) return krk_runtimeError(vm.exceptions->valueError, "cannot resize a view");
+	arrayExtend(self, argv[1]);
+})
+
+KRK_METHOD(array,frombytes,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,bytes,KrkBytes*,bytes);
+	if (!IS_NONE(self->base)) return krk_runtimeError(vm.exceptions->valueError, "cannot resize a view");
+	arrayFromBytes(self, bytes->bytes, bytes->length);
+})
+
+KRK_METHOD(array,tobytes,{
+	METHOD_TAKES_NONE();
+	char * buf;
+	int owned;
+	if (!asContiguous(self, self->typecode, 0, &buf, &owned)) return NONE_VAL();
+	KrkBytes * out = krk_newBytes(self->length * self->itemsize, (uint8_t*)buf);
+	freeContiguous(buf, owned, self->length, self->typecode);
+	return OBJECT_VAL(out);
+})
+
+KRK_METHOD(array,tolist,{
+	METHOD_TAKES_NONE();
+	char * data;
+	if (!arrayBuffer(self, &data)) return NONE_VAL();
+	KrkValue out = krk_list_of(0, NULL, 0);
+	krk_push(out);
+	for (size_t i = 0; i < self->length; ++i) {
+		krk_writeValueArray(AS_LIST(out), boxValue(self->typecode, ELEMENT(self,data,i)));
+	}
+	return krk_pop();
+})
+
+KRK_METHOD(array,copy,{
+	METHOD_TAKES_NONE();
+	char * buf;
+	int owned;
+	if (!asContiguous(self, self->typecode, 0, &buf, &owned)) return NONE_VAL();
+	struct Array * out = pushNewArray(self->typecode, self->length);
+	if (self->length) memcpy(out->data, buf, self->length * self->itemsize);
+	freeContiguous(buf, owned, self->length, self->typecode);
+	return krk_pop();
+})
+
+KRK_METHOD(array,__repr__,{
+	METHOD_TAKES_NONE();
+	char * data;
+	if (!arrayBuffer(self, &data)) return NONE_VAL();
+	struct StringBuilder sb = {0};
+	pushStringBuilderStr(&sb, "array('", 7);
+	pushStringBuilder(&sb, self->typecode);
+	pushStringBuilderStr(&sb, "', [", 4);
+	for (size_t i = 0; i < self->length; ++i) {
+		if (i > 0) pushStringBuilderStr(&sb, ", ", 2);
+		KrkValue value = boxValue(self->typecode, ELEMENT(self,data,i));
+		krk_push(value);
+		KrkValue result = krk_callDirect(krk_getType(value)->_reprer, 1);
+		if (IS_STRING(result)) {
+			pushStringBuilderStr(&sb, AS_STRING(result)->chars, AS_STRING(result)->length);
+		}
+	}
+	pushStringBuilderStr(&sb, "])", 2);
+	return finishStringBuilder(&sb);
+})
+
+KRK_METHOD(array,__eq__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_array(argv[1])) return NOTIMPL_VAL();
+	struct Array * them = AS_array(argv[1]);
+	if (them->length != self->length) return BOOLEAN_VAL(0);
+	char * mine, * theirs;
+	if (!arrayBuffer(self, &mine) || !arrayBuffer(them, &theirs)) return NONE_VAL();
+	for (size_t i = 0; i < self->length; ++i) {
+		if (!krk_valuesEqual(boxValue(self->typecode, ELEMENT(self,mine,i)), boxValue(them->typecode, ELEMENT(them,theirs,i)))) return BOOLEAN_VAL(0);
+	}
+	return BOOLEAN_VAL(1);
+})
+
+KRK_METHOD(array,__add__,{ METHOD_TAKES_EXACTLY(1); return arrayBinary(argv[0], argv[1], ARRAY_ADD, 0, 0); })
+KRK_METHOD(array,__sub__,{ METHOD_TAKES_EXACTLY(1); return arrayBinary(argv[0], argv[1], ARRAY_SUB, 0, 0); })
+KRK_METHOD(array,__mul__,{ METHOD_TAKES_EXACTLY(1); return arrayBinary(argv[0], argv[1], ARRAY_MUL, 0, 0); })
+KRK_METHOD(array,__truediv__,{ METHOD_TAKES_EXACTLY(1); return arrayBinary(argv[0], argv[1], ARRAY_DIV, 0, 0); })
+KRK_METHOD(array,__radd__,{ METHOD_TAKES_EXACTLY(1); return arrayBinary(argv[0], argv[1], ARRAY_ADD, 1, 0); })
+KRK_METHOD(array,__rsub__,{ METHOD_TAKES_EXACTLY(1); return arrayBinary(argv[0], argv[1], ARRAY_SUB, 1, 0); })
+KRK_METHOD(array,__rmul__,{ METHOD_TAKES_EXACTLY(1); return arrayBinary(argv[0], argv[1], ARRAY_MUL, 1, 0); })
+KRK_METHOD(array,__rtruediv__,{ METHOD_TAKES_EXACTLY(1); return arrayBinary(argv[0], argv[1], ARRAY_DIV, 1, 0); })
+KRK_METHOD(array,__iadd__,{ METHOD_TAKES_EXACTLY(1); return arrayBinary(argv[0], argv[1], ARRAY_ADD, 0, 1); })
+KRK_METHOD(array,__isub__,{ METHOD_TAKES_EXACTLY(1); return arrayBinary(argv[0], argv[1], ARRAY_SUB, 0, 1); })
+KRK_METHOD(array,__imul__,{ METHOD_TAKES_EXACTLY(1); return arrayBinary(argv[0], argv[1], ARRAY_MUL, 0, 1); })
+KRK_METHOD(array,__itruediv__,{ METHOD_TAKES_EXACTLY(1); return arrayBinary(argv[0], argv[1], ARRAY_DIV, 0, 1); })
+
+/* Reductions run over a contiguous copy of views that aren't contiguous. */
+#define REDUCE(which) do { \
+	char * buf; \
+	int owned; \
+	if (!asContiguous(self, self->typecode, 0, &buf, &owned)) return NONE_VAL(); \
+	KrkValue result = NONE_VAL(); \
+	switch (self->typecode) { \
+		ARRAY_TYPES(which) \
+	} \
+	freeContiguous(buf, owned, self->length, self->typecode); \
+	return result; \
+} while (0)
+
+#define SUM(n,c,t,u,f) case c: result = sum_ ## n ((const t*)buf, self->length); break;
+#define MIN(n,c,t,u,f) case c: result = min_ ## n ((const t*)buf, self->length); break;
+#define MAX(n,c,t,u,f) case c: result = max_ ## n ((const t*)buf, self->length); break;
+
+KRK_METHOD(array,sum,{
+	METHOD_TAKES_NONE();
+	REDUCE(SUM);
+})
+
+KRK_METHOD(array,min,{
+	METHOD_TAKES_NONE();
+	if (!self->length) return krk_runtimeError(vm.exceptions->valueError, "min() of an empty array");
+	REDUCE(MIN);
+})
+
+KRK_METHOD(array,max,{
+	METHOD_TAKES_NONE();
+	if (!self->length) return krk_runtimeError(vm.exceptions->valueError, "max() of an empty array");
+	REDUCE(MAX);
+})
+
+static KrkValue arrayDot(struct Array * self, struct Array * them) {
+	if (them->length != self->length) return krk_runtimeError(vm.exceptions->valueError, "arrays have different lengths");
+	char code = promote(self->typecode, them->typecode, 0, ARRAY_MUL);
+	char * left, * right;
+	int leftOwned, rightOwned;
+	if (!asContiguous(self, code, 0, &left, &leftOwned)) return NONE_VAL();
+	if (!asContiguous(them, code, 0, &right, &rightOwned)) {
+		freeContiguous(left, leftOwned, self->length, code);
+		return NONE_VAL();
+	}
+	KrkValue result = NONE_VAL();
+	switch (code) {
+#define X(n,c,t,u,f) case c: result = dot_ ## n ((const t*)left, (const t*)right, self->length); break;
+		ARRAY_TYPES(X)
+#undef X
+	}
+	freeContiguous(left, leftOwned, self->length, code);
+	freeContiguous(right, rightOwned, them->length, code);
+	return result;
+}
+
+KRK_METHOD(array,dot,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,array,struct Array*,them);
+	return arrayDot(self, them);
+})
+
+FUNC_SIG(arrayiterator,__init__);
+
+KRK_METHOD(array,__iter__,{
+	METHOD_TAKES_NONE();
+	KrkInstance * output = krk_newInstance(arrayiterator);
+	krk_push(OBJECT_VAL(output));
+	FUNC_NAME(arrayiterator,__init__)(2,(KrkValue[]){krk_peek(0), argv[0]}, 0);
+	return krk_pop();
+})
+
+#undef CURRENT_CTYPE
+
+/**
+ * @brief Iterator over the values in an array.
+ * @extends KrkInstance
+ */
+struct ArrayIterator {
+	KrkInstance inst;
+	KrkValue array;
+	size_t i;
+};
+
+#define IS_arrayiterator(o) (krk_isInstanceOf(o,arrayiterator))
+#define AS_arrayiterator(o) ((struct ArrayIterator*)AS_OBJECT(o))
+#define CURRENT_CTYPE struct ArrayIterator *
+
+static void _arrayiterator_gcscan(KrkInstance * self) {
+	krk_markValue(((struct ArrayIterator*)self)->array);
+}
+
+KRK_METHOD(arrayiterator,__init__,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,array,struct Array*,source);
+	self->array = argv[1];
+	self->i = 0;
+	return argv[0];
+})
+
+KRK_METHOD(arrayiterator,__call__,{
+	METHOD_TAKES_NONE();
+	struct Array * source = AS_array(self->array);
+	if (self->i >= source->length) return argv[0];
+	char * data;
+	if (!arrayBuffer(source, &data)) return NONE_VAL();
+	return boxValue(source->typecode, ELEMENT(source,data,self->i++));
+})
+
+KrkValue krk_module_onload_array(void) {
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	krk_push(OBJECT_VAL(module));
+
+	KRK_DOC(module, "@brief Arrays of numbers of one C type, stored contiguously.");
+
+	KrkClass * array = krk_makeClass(module, &arrayClass, "array", vm.baseClasses->objectClass);
+	KRK_DOC(array,
+		"@brief Array of numbers of the type given by @p typecode.\n"
+		"@arguments typecode,initializer=None\n\n"
+		"@p typecode is one of @c b, @c B, @c h, @c H, @c i, @c I, @c l, @c L, @c q or @c Q, for "
+		"signed and unsigned integers of 8, 16, 32 and 64 bits, or @c f or @c d, for single and double "
+		"precision floats. @p initializer may be @ref bytes, another array, or any iterable of numbers.\n\n"
+		"Slicing an array makes a view, which shares the values of the array it was taken from. "
+		"Arithmetic with another array of the same length, or with a number, is done element by element "
+		"and makes a new array; in-place operators write over the array when its type can hold the result.");
+	array->allocSize = sizeof(struct Array);
+	array->_ongcscan = _array_gcscan;
+	array->_ongcsweep = _array_gcsweep;
+	BIND_METHOD(array,__init__);
+	BIND_METHOD(array,__len__);
+	BIND_METHOD(array,__getitem__);
+	BIND_METHOD(array,__setitem__);
+	BIND_METHOD(array,__iter__);
+	BIND_METHOD(array,__repr__);
+	BIND_METHOD(array,__eq__);
+	BIND_METHOD(array,__add__);
+	BIND_METHOD(array,__sub__);
+	BIND_METHOD(array,__mul__);
+	BIND_METHOD(array,__truediv__);
+	BIND_METHOD(array,__radd__);
+	BIND_METHOD(array,__rsub__);
+	BIND_METHOD(array,__rmul__);
+	BIND_METHOD(array,__rtruediv__);
+	BIND_METHOD(array,__iadd__);
+	BIND_METHOD(array,__isub__);
+	BIND_METHOD(array,__imul__);
+	BIND_METHOD(array,__itruediv__);
+	BIND_PROP(array,typecode);
+	BIND_PROP(array,itemsize);
+	KRK_DOC(BIND_METHOD(array,append),
+		"@brief Add @p x to the end of the array.\n"
+		"@arguments x");
+	KRK_DOC(BIND_METHOD(array,extend),
+		"@brief Add the values of @p iterable to the end of the array.\n"
+		"@arguments iterable");
+	KRK_DOC(BIND_METHOD(array,frombytes),
+		"@brief Add values from their machine representation in @p data.\n"
+		"@arguments data");
+	KRK_DOC(BIND_METHOD(array,tobytes),
+		"@brief The machine representation of the values, as @ref bytes.");
+	KRK_DOC(BIND_METHOD(array,tolist),
+		"@brief The values, as a @ref list.");
+	KRK_DOC(BIND_METHOD(array,copy),
+		"@brief A new array with the same values, which does not share them.");
+	KRK_DOC(BIND_METHOD(array,sum),
+		"@brief Sum of the values.");
+	KRK_DOC(BIND_METHOD(array,min),
+		"@brief Smallest value.");
+	KRK_DOC(BIND_METHOD(array,max),
+		"@brief Largest value.");
+	KRK_DOC(BIND_METHOD(array,dot),
+		"@brief Sum of the products of the values of this array and @p other.\n"
+		"@arguments other");
+	krk_defineNative(&array->methods, "__str__", FUNC_NAME(array,__repr__));
+	krk_attachNamedValue(&array->methods, "__hash__", NONE_VAL());
+	krk_finalizeClass(array);
+
+	krk_makeClass(module, &arrayiterator, "arrayiterator", vm.baseClasses->objectClass);
+	arrayiterator->allocSize = sizeof(struct ArrayIterator);
+	arrayiterator->_ongcscan = _arrayiterator_gcscan;
+	BIND_METHOD(arrayiterator,__init__);
+	BIND_METHOD(arrayiterator,__call__);
+	krk_finalizeClass(arrayiterator);
+
+	krk_attachNamedObject(&module->fields, "typecodes", (KrkObj*)S("bBhHiIlLqQfd"));
+
+	return krk_pop();
+}
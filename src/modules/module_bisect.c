@@ -0,0 +1,152 @@
+/**
+ * @file    module_bisect.c
+ * @brief   Binary search and insertion for sorted lists.
+ *
+ * Searches work on the values of a list or tuple directly. Integers and
+ * floats are compared without going through @c \__lt__; anything else uses
+ * the @c < operator, as sorting does.
+ */
+#include <string.h>
+#include <kuroko/vm.h>
+#include <kuroko/util.h>
+
+/**
+ * Where @p x goes in the sorted values of @p seq, between @p lo and @p hi:
+ * before any equal values, or after them if @p right is set. If @p key is
+ * not None, it is called on each value looked at, and @p x is compared with
+ * what it returns. Returns -1 on an exception.
+ */
+static krk_integer_type search(KrkValue seq, KrkValue x, krk_integer_type lo, krk_integer_type hi, KrkValue key, int right) {
+	while (lo < hi) {
+		krk_integer_type mid = lo + (hi - lo) / 2;
+		/* Comparisons can run managed code, so the list is looked at again each time. */
+		KrkValueArray * values = IS_TUPLE(seq) ? &AS_TUPLE(seq)->values : AS_LIST(seq);
+		if (mid >= (krk_integer_type)values->count) {
+			krk_runtimeError(vm.exceptions->indexError, "list index out of range");
+			return -1;
+		}
+		KrkValue item = values->values[mid];
+		if (!IS_NONE(key)) {
+			krk_push(key);
+			krk_push(item);
+			item = krk_callStack(1);
+			if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return -1;
+		}
+		int lt = right ? krk_lessThan(x, item) : krk_lessThan(item, x);
+		if (lt < 0) return -1;
+		if (right ? lt : !lt) hi = mid;
+		else lo = mid + 1;
+	}
+	return lo;
+}
+
+/**
+ * Read the arguments shared by every function here: (a, x, lo=0, hi=None, *, key=None).
+ */
+static int parseArgs(const char * name, int argc, const KrkValue argv[], int hasKw, int mutable,
+                     krk_integer_type * lo, krk_integer_type * hi, KrkValue * key) {
+	if (argc < 2 || argc > 4) {
+		krk_runtimeError(vm.exceptions->argumentError, "%s() takes from 2 to 4 positional arguments (%d given)", name, argc);
+		return 0;
+	}
+	if (mutable ? !IS_list(argv[0]) : !(IS_list(argv[0]) || IS_TUPLE(argv[0]))) {
+		krk_runtimeError(vm.exceptions->typeError, "%s() expects %s, not '%s'", name, mutable ? "list" : "list or tuple", krk_typeName(argv[0]));
+		return 0;
+	}
+	KrkValue loValue = argc > 2 ? argv[2] : INTEGER_VAL(0);
+	KrkValue hiValue = argc > 3 ? argv[3] : NONE_VAL();
+	*key = NONE_VAL();
+	if (hasKw) {
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("lo")), &loValue);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("hi")), &hiValue);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("key")), key);
+	}
+	if (!IS_INTEGER(loValue) || !(IS_INTEGER(hiValue) || IS_NONE(hiValue))) {
+		krk_runtimeError(vm.exceptions->typeError, "%s() bounds must be integers", name);
+		return 0;
+	}
+	KrkValueArray * values = IS_TUPLE(argv[0]) ? &AS_TUPLE(argv[0])->values : AS_LIST(argv[0]);
+	*lo = AS_INTEGER(loValue);
+	*hi = IS_NONE(hiValue) ? (krk_integer_type)values->count : AS_INTEGER(hiValue);
+	if (*lo < 0) {
+		krk_runtimeError(vm.exceptions->valueError, "lo must be non-negative");
+		return 0;
+	}
+	return 1;
+}
+
+static KrkValue bisect(const char * name, int argc, const KrkValue argv[], int hasKw, int right) {
+	krk_integer_type lo, hi;
+	KrkValue key;
+	if (!parseArgs(name, argc, argv, hasKw, 0, &lo, &hi, &key)) return NONE_VAL();
+	krk_integer_type index = search(argv[0], argv[1], lo, hi, key, right);
+	if (index < 0) return NONE_VAL();
+	return INTEGER_VAL(index);
+}
+
+static KrkValue insort(const char * name, int argc, const KrkValue argv[], int hasKw, int right) {
+	krk_integer_type lo, hi;
+	KrkValue key;
+	if (!parseArgs(name, argc, argv, hasKw, 1, &lo, &hi, &key)) return NONE_VAL();
+	KrkValue x = argv[1];
+	if (!IS_NONE(key)) {
+		krk_push(key);
+		krk_push(argv[1]);
+		x = krk_callStack(1);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return NONE_VAL();
+		krk_push(x);
+	}
+	krk_integer_type index = search(argv[0], x, lo, hi, key, right);
+	if (!IS_NONE(key)) krk_pop();
+	if (index < 0) return NONE_VAL();
+
+	KrkValueArray * values = AS_LIST(argv[0]);
+	if (index > (krk_integer_type)values->count) index = values->count;
+	krk_writeValueArray(values, argv[1]);
+	memmove(&values->values[index+1], &values->values[index], sizeof(KrkValue) * (values->count - 1 - index));
+	values->values[index] = argv[1];
+	return NONE_VAL();
+}
+
+KRK_FUNC(bisect_left,{
+	return bisect("bisect_left", argc, argv, hasKw, 0);
+})
+
+KRK_FUNC(bisect_right,{
+	return bisect("bisect_right", argc, argv, hasKw, 1);
+})
+
+KRK_FUNC(insort_left,{
+	return insort("insort_left", argc, argv, hasKw, 0);
+})
+
+KRK_FUNC(insort_right,{
+	return insort("insort_right", argc, argv, hasKw, 1);
+})
+
+KrkValue krk_module_onload_bisect(void) {
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	krk_push(OBJECT_VAL(module));
+
+	KRK_DOC(module, "@brief Binary search and insertion for sorted lists.");
+
+	KRK_DOC(BIND_FUNC(module,bisect_left),
+		"@brief Index to insert @p x at in the sorted list @p a, before any equal values.\n"
+		"@arguments a,x,lo=0,hi=None,key=None\n\n"
+		"Only the values from @p lo up to @p hi are searched. If @p key is given, it is called "
+		"on the values of @p a, and @p x is compared with the results.");
+	KRK_DOC(BIND_FUNC(module,bisect_right),
+		"@brief Index to insert @p x at in the sorted list @p a, after any equal values.\n"
+		"@arguments a,x,lo=0,hi=None,key=None");
+	KRK_DOC(BIND_FUNC(module,insort_left),
+		"@brief Insert @p x into the sorted list @p a, before any equal values.\n"
+		"@arguments a,x,lo=0,hi=None,key=None\n\n"
+		"If @p key is given, it is called on @p x as well as on the values of @p a.");
+	KRK_DOC(BIND_FUNC(module,insort_right),
+		"@brief Insert @p x into the sorted list @p a, after any equal values.\n"
+		"@arguments a,x,lo=0,hi=None,key=None");
+	krk_defineNative(&module->fields, "bisect", _krk_bisect_right);
+	krk_defineNative(&module->fields, "insort", _krk_insort_right);
+
+	return krk_pop();
+}
@@ -0,0 +1,495 @@
+/**
+ * @file    module_heapq.c
+ * @brief   Binary min-heaps kept in lists.
+ *
+ * A heap is a list where every value is no greater than the two at
+ * <tt>2*i+1</tt> and <tt>2*i+2</tt>, so the smallest is always first.
+ * The functions here work on the values of the list directly. Integers and
+ * floats are compared without going through @c \__lt__; anything else uses
+ * the @c < operator. Comparisons can run managed code, so the list is looked
+ * at again after each one, and a heap that changes size while it is being
+ * rearranged is an error.
+ */
+#include <string.h>
+#include <kuroko/vm.h>
+#include <kuroko/memory.h>
+#include <kuroko/util.h>
+
+static KrkVMLocal mergeKey;
+#define merge KRK_VM_LOCAL(KrkClass*,mergeKey)
+
+static int changedSize(KrkValueArray * heap, size_t size) {
+	if (heap->count == size) return 0;
+	krk_runtimeError(vm.exceptions->valueError, "heap changed size during comparison");
+	return 1;
+}
+
+static void swap(KrkValueArray * heap, size_t a, size_t b) {
+	KrkValue tmp = heap->values[a];
+	heap->values[a] = heap->values[b];
+	heap->values[b] = tmp;
+}
+
+/**
+ * Move the value at @p pos towards @p start until its parent is no greater.
+ * Returns 0 on an exception.
+ */
+static int siftDown(KrkValueArray * heap, size_t start, size_t pos) {
+	size_t size = heap->count;
+	while (pos > start) {
+		size_t parent = (pos - 1) >> 1;
+		int lt = krk_lessThan(heap->values[pos], heap->values[parent]);
+		if (lt < 0 || changedSize(heap, size)) return 0;
+		if (!lt) break;
+		swap(heap, pos, parent);
+		pos = parent;
+	}
+	return 1;
+}
+
+/**
+ * Move the value at @p pos down to a leaf, always following the smaller
+ * child, then back up to where it belongs. That takes fewer comparisons
+ * than stopping on the way down, as the value being moved usually came
+ * from the bottom of the heap.
+ */
+static int siftUp(KrkValueArray * heap, size_t pos) {
+	size_t size = heap->count;
+	size_t start = pos;
+	size_t limit = size >> 1;
+	while (pos < limit) {
+		size_t child = 2 * pos + 1;
+		if (child + 1 < size) {
+			int lt = krk_lessThan(heap->values[child], heap->values[child + 1]);
+			if (lt < 0 || changedSize(heap, size)) return 0;
+			if (!lt) child++;
+		}
+		swap(heap, pos, child);
+		pos = child;
+	}
+	return siftDown(heap, start, pos);
+}
+
+#define HEAP_ARG(name) \
+	if (argc < 1 || !IS_list(argv[0])) return TYPE_ERROR(list,argc < 1 ? NONE_VAL() : argv[0]); \
+	KrkValueArray * name = AS_LIST(argv[0])
+
+KRK_FUNC(heappush,{
+	FUNCTION_TAKES_EXACTLY(2);
+	HEAP_ARG(heap);
+	krk_writeValueArray(heap, argv[1]);
+	siftDown(heap, 0, heap->count - 1);
+})
+
+KRK_FUNC(heappop,{
+	FUNCTION_TAKES_EXACTLY(1);
+	HEAP_ARG(heap);
+	if (!heap->count) return krk_runtimeError(vm.exceptions->indexError, "index out of range");
+	KrkValue last = heap->values[--heap->count];
+	if (!heap->count) return last;
+	KrkValue out = heap->values[0];
+	heap->values[0] = last;
+	krk_push(out);
+	siftUp(heap, 0);
+	return krk_pop();
+})
+
+KRK_FUNC(heapreplace,{
+	FUNCTION_TAKES_EXACTLY(2);
+	HEAP_ARG(heap);
+	if (!heap->count) return krk_runtimeError(vm.exceptions->indexError, "index out of range");
+	KrkValue out = heap->values[0];
+	heap->values[0] = argv[1];
+	if (IS_OBJECT(argv[1])) krk_gcWriteBarrier((KrkObj*)AS_OBJECT(argv[0]));
+	krk_push(out);
+	siftUp(heap, 0);
+	return krk_pop();
+})
+
+KRK_FUNC(heappushpop,{
+	FUNCTION_TAKES_EXACTLY(2);
+	HEAP_ARG(heap);
+	if (!heap->count) return argv[1];
+	int lt = krk_lessThan(heap->values[0], argv[1]);
+	if (lt < 0) return NONE_VAL();
+	if (!lt) return argv[1];
+	if (!heap->count) return krk_runtimeError(vm.exceptions->indexError, "index out of range");
+	KrkValue out = heap->values[0];
+	heap->values[0] = argv[1];
+	if (IS_OBJECT(argv[1])) krk_gcWriteBarrier((KrkObj*)AS_OBJECT(argv[0]));
+	krk_push(out);
+	siftUp(heap, 0);
+	return krk_pop();
+})
+
+KRK_FUNC(heapify,{
+	FUNCTION_TAKES_EXACTLY(1);
+	HEAP_ARG(heap);
+	for (size_t i = heap->count / 2; i > 0; --i) {
+		if (!siftUp(heap, i - 1)) return NONE_VAL();
+	}
+})
+
+/**
+ * The best @c n values seen so far by nsmallest or nlargest, kept in a heap
+ * with the worst of them at the top, so it is the one a better value
+ * replaces. Values are ranked by key, then by the order they were seen, so
+ * equal values come out in that order.
+ */
+struct Best {
+	KrkValueArray * keys;
+	KrkValueArray * values;
+	size_t * order;
+	int largest;
+};
+
+/**
+ * Whether @p a is worse than @p b. Returns -1 on an exception.
+ */
+static int worse(struct Best * best, size_t a, size_t b) {
+	KrkValue x = best->keys->values[a];
+	KrkValue y = best->keys->values[b];
+	int lt = best->largest ? krk_lessThan(x, y) : krk_lessThan(y, x);
+	if (lt) return lt;
+	lt = best->largest ? krk_lessThan(y, x) : krk_lessThan(x, y);
+	if (lt) return lt < 0 ? -1 : 0;
+	return best->order[a] > best->order[b];
+}
+
+static void swapBest(struct Best * best, size_t a, size_t b) {
+	swap(best->keys, a, b);
+	if (best->values != best->keys) swap(best->values, a, b);
+	size_t tmp = best->order[a];
+	best->order[a] = best->order[b];
+	best->order[b] = tmp;
+}
+
+static int siftBest(struct Best * best, size_t pos, size_t size) {
+	for (;;) {
+		size_t child = 2 * pos + 1;
+		if (child >= size) return 1;
+		if (child + 1 < size) {
+			int w = worse(best, child + 1, child);
+			if (w < 0) return 0;
+			if (w) child++;
+		}
+		int w = worse(best, child, pos);
+		if (w < 0) return 0;
+		if (!w) return 1;
+		swapBest(best, pos, child);
+		pos = child;
+	}
+}
+
+/**
+ * Keep the @p n best values of @p iterable, and return them as a list in order.
+ */
+static KrkValue nbest(const char * _method_name, int argc, const KrkValue argv[], int hasKw, int largest) {
+	FUNCTION_TAKES_EXACTLY(2);
+	CHECK_ARG(0,int,krk_integer_type,n);
+	KrkValue key = NONE_VAL();
+	if (hasKw) krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("key")), &key);
+
+	KrkValue iterable = argv[1];
+	KrkClass * type = krk_getType(iterable);
+	if (!type->_iter) return krk_runtimeError(vm.exceptions->typeError, "'%s' object is not iterable", krk_typeName(iterable));
+
+	KrkValue values = krk_list_of(0,NULL,0);
+	krk_push(values);
+	KrkValue keys = IS_NONE(key) ? values : krk_list_of(0,NULL,0);
+	krk_push(keys);
+	if (n <= 0) {
+		krk_pop();
+		return krk_pop();
+	}
+
+	struct Best best = { AS_LIST(keys), AS_LIST(values), NULL, largest };
+	size_t orderCapacity = 0;
+	size_t seen = 0;
+
+	krk_push(iterable);
+	KrkValue iter = krk_callDirect(type->_iter, 1);
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) goto _done;
+	krk_push(iter);
+	for (;;) {
+		krk_push(iter);
+		KrkValue value = krk_callStack(0);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) break;
+		if (krk_valuesSame(value, iter)) break;
+		krk_push(value);
+		KrkValue k = value;
+		if (!IS_NONE(key)) {
+			krk_push(key);
+			krk_push(value);
+			k = krk_callStack(1);
+			if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) {
+				krk_pop();
+				break;
+			}
+		}
+		krk_push(k);
+
+		if (best.values->count < (size_t)n) {
+			/* Still filling up: add it, then move it up past anything better. */
+			if (orderCapacity < best.values->count + 1) {
+				size_t old = orderCapacity;
+				orderCapacity = GROW_CAPACITY(old);
+				best.order = GROW_ARRAY(size_t, best.order, old, orderCapacity);
+			}
+			if (best.keys != best.values) krk_writeValueArray(best.keys, k);
+			krk_writeValueArray(best.values, value);
+			size_t pos = best.values->count - 1;
+			best.order[pos] = seen;
+			while (pos > 0) {
+				size_t parent = (pos - 1) / 2;
+				int w = worse(&best, pos, parent);
+				if (w < 0) break;
+				if (!w) break;
+				swapBest(&best, pos, parent);
+				pos = parent;
+			}
+		} else {
+			/* Full: it only gets in if it is better than the worst kept. */
+			int lt = largest ? krk_lessThan(best.keys->values[0], k) : krk_lessThan(k, best.keys->values[0]);
+			if (lt > 0) {
+				best.keys->values[0] = k;
+				best.values->values[0] = value;
+				krk_gcWriteBarrier(AS_OBJECT(keys));
+				krk_gcWriteBarrier(AS_OBJECT(values));
+				best.order[0] = seen;
+				siftBest(&best, 0, best.values->count);
+			}
+		}
+		krk_pop();
+		krk_pop();
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) break;
+		seen++;
+	}
+	krk_pop();
+
+	/* Taking the worst off the top each time puts them in order from the back. */
+	for (size_t size = best.values->count; size > 1 && !(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION); --size) {
+		swapBest(&best, 0, size - 1);
+		siftBest(&best, 0, size - 1);
+	}
+
+_done:
+	if (orderCapacity) FREE_ARRAY(size_t, best.order, orderCapacity);
+	krk_pop();
+	return krk_pop();
+}
+
+KRK_FUNC(nsmallest,{
+	return nbest(_method_name, argc, argv, hasKw, 0);
+})
+
+KRK_FUNC(nlargest,{
+	return nbest(_method_name, argc, argv, hasKw, 1);
+})
+
+/**
+ * @brief Iterator over the merged values of several sorted iterables.
+ * @extends KrkInstance
+ *
+ * Each input has its iterator, its current value, and that value's key in
+ * the lists here, at its own index. The heap holds the indexes of the
+ * inputs that still have values, ordered by key and then by index, so the
+ * earlier input's value comes first when they are equal.
+ */
+struct Merge {
+	KrkInstance inst;
+	KrkValue iterators;
+	KrkValue values;
+	KrkValue keys;
+	KrkValue key;
+	size_t * heap;
+	size_t count;
+	size_t capacity;
+	int reverse;
+};
+
+#define IS_merge(o) (krk_isInstanceOf(o,merge))
+#define AS_merge(o) ((struct Merge*)AS_OBJECT(o))
+#define CURRENT_CTYPE struct Merge *
+#define CURRENT_NAME  self
+
+static void _merge_gcscan(KrkInstance * _self) {
+	struct Merge * self = (struct Merge*)_self;
+	krk_markValue(self->iterators);
+	krk_markValue(self->values);
+	krk_markValue(self->keys);
+	krk_markValue(self->key);
+}
+
+static void _merge_gcsweep(KrkInstance * _self) {
+	struct Merge * self = (struct Merge*)_self;
+	if (self->capacity) FREE_ARRAY(size_t, self->heap, self->capacity);
+	self->heap = NULL;
+	self->capacity = 0;
+	self->count = 0;
+}
+
+/** Whether input @p a comes before input @p b. Returns -1 on an exception. */
+static int mergeBefore(struct Merge * self, size_t a, size_t b) {
+	KrkValue x = AS_LIST(self->keys)->values[a];
+	KrkValue y = AS_LIST(self->keys)->values[b];
+	int lt = self->reverse ? krk_lessThan(y, x) : krk_lessThan(x, y);
+	if (lt) return lt;
+	lt = self->reverse ? krk_lessThan(x, y) : krk_lessThan(y, x);
+	if (lt) return lt < 0 ? -1 : 0;
+	return a < b;
+}
+
+static int mergeSift(struct Merge * self, size_t pos) {
+	for (;;) {
+		size_t child = 2 * pos + 1;
+		if (child >= self->count) return 1;
+		if (child + 1 < self->count) {
+			int b = mergeBefore(self, self->heap[child + 1], self->heap[child]);
+			if (b < 0) return 0;
+			if (b) child++;
+		}
+		int b = mergeBefore(self, self->heap[child], self->heap[pos]);
+		if (b < 0) return 0;
+		if (!b) return 1;
+		size_t tmp = self->heap[pos];
+		self->heap[pos] = self->heap[child];
+		self->heap[child] = tmp;
+		pos = child;
+	}
+}
+
+/**
+ * Get the next value of input @p i. Returns 1 if there was one, 0 if the
+ * input is exhausted, and -1 on an exception.
+ */
+static int mergeAdvance(struct Merge * self, size_t i) {
+	KrkValue iter = AS_LIST(self->iterators)->values[i];
+	krk_push(iter);
+	KrkValue value = krk_callStack(0);
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return -1;
+	if (krk_valuesSame(value, iter)) return 0;
+	AS_LIST(self->values)->values[i] = value;
+	krk_gcWriteBarrier(AS_OBJECT(self->values));
+	KrkValue k = value;
+	if (!IS_NONE(self->key)) {
+		krk_push(self->key);
+		krk_push(value);
+		k = krk_callStack(1);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return -1;
+	}
+	AS_LIST(self->keys)->values[i] = k;
+	krk_gcWriteBarrier(AS_OBJECT(self->keys));
+	return 1;
+}
+
+KRK_METHOD(merge,__init__,{
+	KrkValue key = NONE_VAL();
+	KrkValue reverse = BOOLEAN_VAL(0);
+	if (hasKw) {
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("key")), &key);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("reverse")), &reverse);
+	}
+	_merge_gcsweep((KrkInstance*)self);
+	self->key = key;
+	self->reverse = !krk_isFalsey(reverse);
+	self->iterators = krk_list_of(0,NULL,0);
+	self->values = krk_list_of(0,NULL,0);
+	self->keys = krk_list_of(0,NULL,0);
+	krk_gcWriteBarrier((KrkObj*)self);
+
+	for (int i = 1; i < argc; ++i) {
+		KrkClass * type = krk_getType(argv[i]);
+		if (!type->_iter) return krk_runtimeError(vm.exceptions->typeError, "'%s' object is not iterable", krk_typeName(argv[i]));
+		krk_push(argv[i]);
+		KrkValue iter = krk_callDirect(type->_iter, 1);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return NONE_VAL();
+		krk_writeValueArray(AS_LIST(self->iterators), iter);
+		krk_writeValueArray(AS_LIST(self->values), NONE_VAL());
+		krk_writeValueArray(AS_LIST(self->keys), NONE_VAL());
+	}
+
+	size_t inputs = argc - 1;
+	if (inputs) {
+		self->heap = ALLOCATE(size_t, inputs);
+		self->capacity = inputs;
+	}
+	for (size_t i = 0; i < inputs; ++i) {
+		int got = mergeAdvance(self, i);
+		if (got < 0) return NONE_VAL();
+		if (got) self->heap[self->count++] = i;
+	}
+	for (size_t i = self->count / 2; i > 0; --i) {
+		if (!mergeSift(self, i - 1)) return NONE_VAL();
+	}
+	return argv[0];
+})
+
+KRK_METHOD(merge,__iter__,{
+	METHOD_TAKES_NONE();
+	return argv[0];
+})
+
+KRK_METHOD(merge,__call__,{
+	METHOD_TAKES_NONE();
+	if (!self->count) return argv[0];
+	size_t input = self->heap[0];
+	KrkValue out = AS_LIST(self->values)->values[input];
+	krk_push(out);
+	int got = mergeAdvance(self, input);
+	if (got < 0) return krk_pop(), NONE_VAL();
+	if (!got) self->heap[0] = self->heap[--self->count];
+	if (self->count && !mergeSift(self, 0)) return krk_pop(), NONE_VAL();
+	return krk_pop();
+})
+
+#undef CURRENT_CTYPE
+
+KrkValue krk_module_onload_heapq(void) {
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	krk_push(OBJECT_VAL(module));
+
+	KRK_DOC(module, "@brief Binary min-heaps kept in lists.");
+
+	KRK_DOC(BIND_FUNC(module,heappush),
+		"@brief Add @p item to @p heap.\n"
+		"@arguments heap,item");
+	KRK_DOC(BIND_FUNC(module,heappop),
+		"@brief Remove and return the smallest value in @p heap.\n"
+		"@arguments heap");
+	KRK_DOC(BIND_FUNC(module,heapreplace),
+		"@brief Remove and return the smallest value in @p heap, then add @p item.\n"
+		"@arguments heap,item\n\n"
+		"The value returned may be larger than @p item.");
+	KRK_DOC(BIND_FUNC(module,heappushpop),
+		"@brief Add @p item to @p heap, then remove and return the smallest value.\n"
+		"@arguments heap,item\n\n"
+		"This is faster than @ref heappush followed by @ref heappop.");
+	KRK_DOC(BIND_FUNC(module,heapify),
+		"@brief Rearrange the list @p x into a heap, in linear time.\n"
+		"@arguments x");
+	KRK_DOC(BIND_FUNC(module,nsmallest),
+		"@brief The @p n smallest values of @p iterable, smallest first.\n"
+		"@arguments n,iterable,key=None\n\n"
+		"Equal values are in the order they were found, as with @c sorted.");
+	KRK_DOC(BIND_FUNC(module,nlargest),
+		"@brief The @p n largest values of @p iterable, largest first.\n"
+		"@arguments n,iterable,key=None\n\n"
+		"Equal values are in the order they were found, as with @c sorted with @c reverse=True.");
+
+	krk_makeClass(module, &merge, "merge", vm.baseClasses->objectClass);
+	KRK_DOC(merge,
+		"@brief Iterator over the values of several sorted iterables, in order.\n"
+		"@arguments *iterables,key=None,reverse=False\n\n"
+		"The inputs are read as the values are needed. Equal values come out in the order of "
+		"the inputs they came from.");
+	merge->allocSize = sizeof(struct Merge);
+	merge->_ongcscan = _merge_gcscan;
+	merge->_ongcsweep = _merge_gcsweep;
+	BIND_METHOD(merge,__init__);
+	BIND_METHOD(merge,__iter__);
+	BIND_METHOD(merge,__call__);
+	krk_finalizeClass(merge);
+
+	return krk_pop();
+}
@@ -0,0 +1,701 @@
+/**
+ * @file    module_interpreters.c
+ * @brief   Isolated interpreters running in parallel, and channels between them.
+ *
+ * Each interpreter is a VM of its own, made with @c krk_newVM on a thread
+ * of its own, with its own heap and collector; nothing in one is ever seen
+ * by another, so they run side by side without sharing a lock. Values go
+ * between them through channels, which are kept outside of any heap and
+ * hold copies of what was sent, serialized into a compact binary form.
+ */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <kuroko/vm.h>
+#include <kuroko/memory.h>
+#include <kuroko/util.h>
+
+#ifdef ENABLE_THREADING
+#include <pthread.h>
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+static KrkVMLocal interpreterKey;
+#define InterpreterClass KRK_VM_LOCAL(KrkClass*,interpreterKey)
+static KrkVMLocal channelKey;
+#define ChannelClass KRK_VM_LOCAL(KrkClass*,channelKey)
+static KrkVMLocal interpreterErrorKey;
+#define InterpreterError KRK_VM_LOCAL(KrkClass*,interpreterErrorKey)
+static KrkVMLocal channelEmptyKey;
+#define ChannelEmpty KRK_VM_LOCAL(KrkClass*,channelEmptyKey)
+
+/** How deeply containers may be nested in a value that is sent. */
+#define MAX_DEPTH 200
+
+/*
+ * Values are written as a tag byte followed by what the tag needs:
+ * a 64-bit integer or double, a length and that many bytes for strings,
+ * or a count and then that many values (or pairs, for dicts) for containers.
+ */
+enum {
+	TAG_NONE  = 'N',
+	TAG_TRUE  = 'T',
+	TAG_FALSE = 'F',
+	TAG_INT   = 'i',
+	TAG_FLOAT = 'f',
+	TAG_STR   = 's',
+	TAG_BYTES = 'b',
+	TAG_TUPLE = 't',
+	TAG_LIST  = 'l',
+	TAG_DICT  = 'd',
+};
+
+struct Encoder {
+	unsigned char * data;
+	size_t size;
+	size_t capacity;
+};
+
+static void put(struct Encoder * out, const void * data, size_t size) {
+	if (out->size + size > out->capacity) {
+		while (out->size + size > out->capacity) out->capacity = out->capacity ? out->capacity * 2 : 64;
+		out->data = realloc(out->data, out->capacity);
+	}
+	memcpy(out->data + out->size, data, size);
+	out->size += size;
+}
+
+static void putTag(struct Encoder * out, unsigned char tag, uint64_t n) {
+	put(out, &tag, 1);
+	put(out, &n, sizeof(n));
+}
+
+/** Write @p value to @p out; returns 0 with an exception raised if it can't be sent. */
+static int encode(struct Encoder * out, KrkValue value, int depth) {
+	if (depth > MAX_DEPTH) {
+		krk_runtimeError(vm.exceptions->valueError, "value is nested too deeply to send");
+		return 0;
+	}
+	if (IS_NONE(value)) {
+		put(out, &(unsigned char){TAG_NONE}, 1);
+	} else if (IS_BOOLEAN(value)) {
+		put(out, &(unsigned char){AS_BOOLEAN(value) ? TAG_TRUE : TAG_FALSE}, 1);
+	} else if (IS_INTEGER(value)) {
+		putTag(out, TAG_INT, (uint64_t)AS_INTEGER(value));
+	} else if (IS_FLOATING(value)) {
+		double d = AS_FLOATING(value);
+		uint64_t bits;
+		memcpy(&bits, &d, sizeof(bits));
+		putTag(out, TAG_FLOAT, bits);
+	} else if (IS_STRING(value)) {
+		putTag(out, TAG_STR, AS_STRING(value)->length);
+		put(out, AS_STRING(value)->chars, AS_STRING(value)->length);
+	} else if (IS_BYTES(value)) {
+		putTag(out, TAG_BYTES, AS_BYTES(value)->length);
+		put(out, AS_BYTES(value)->bytes, AS_BYTES(value)->length);
+	} else if (IS_TUPLE(value) || IS_list(value)) {
+		KrkValueArray * values = IS_TUPLE(value) ? &AS_TUPLE(value)->values : AS_LIST(value);
+		putTag(out, IS_TUPLE(value) ? TAG_TUPLE : TAG_LIST, values->count);
+		for (size_t i = 0; i < values->count; ++i) {
+			if (!encode(out, values->values[i], depth + 1)) return 0;
+		}
+	} else if (IS_dict(value)) {
+		KrkTable * table = AS_DICT(value);
+		putTag(out, TAG_DICT, table->count);
+		for (size_t i = 0; i < table->used; ++i) {
+			KrkTableEntry * entry = &table->entries[i];
+			if (IS_KWARGS(entry->key)) continue;
+			if (!encode(out, entry->key, depth + 1) || !encode(out, entry->value, depth + 1)) return 0;
+		}
+	} else {
+		krk_runtimeError(vm.exceptions->typeError, "'%s' can not be sent between interpreters", krk_typeName(value));
+		return 0;
+	}
+	return 1;
+}
+
+static uint64_t takeCount(const unsigned char ** at) {
+	uint64_t n;
+	memcpy(&n, *at, sizeof(n));
+	*at += sizeof(n);
+	return n;
+}
+
+/** Read one value from @p at, which was written by @ref encode, and push it. */
+static void decode(const unsigned char ** at) {
+	unsigned char tag = *(*at)++;
+	switch (tag) {
+		case TAG_NONE:  krk_push(NONE_VAL()); break;
+		case TAG_TRUE:  krk_push(BOOLEAN_VAL(1)); break;
+		case TAG_FALSE: krk_push(BOOLEAN_VAL(0)); break;
+		case TAG_INT:   krk_push(INTEGER_VAL((krk_integer_type)(int64_t)takeCount(at))); break;
+		case TAG_FLOAT: {
+			uint64_t bits = takeCount(at);
+			double d;
+			memcpy(&d, &bits, sizeof(d));
+			krk_push(FLOATING_VAL(d));
+			break;
+		}
+		case TAG_STR: {
+			size_t length = takeCount(at);
+			krk_push(OBJECT_VAL(krk_copyString((const char*)*at, length)));
+			*at += length;
+			break;
+		}
+		case TAG_BYTES: {
+			size_t length = takeCount(at);
+			krk_push(OBJECT_VAL(krk_newBytes(length, (uint8_t*)*at)));
+			*at += length;
+			break;
+		}
+		case TAG_TUPLE: {
+			size_t count = takeCount(at);
+			KrkTuple * tuple = krk_newTuple(count);
+			krk_push(OBJECT_VAL(tuple));
+			for (size_t i = 0; i < count; ++i) {
+				decode(at);
+				krk_writeValueArray(&tuple->values, krk_peek(0));
+				krk_pop();
+			}
+			break;
+		}
+		case TAG_LIST: {
+			size_t count = takeCount(at);
+			krk_push(krk_list_of(0, NULL, 0));
+			for (size_t i = 0; i < count; ++i) {
+				decode(at);
+				krk_writeValueArray(AS_LIST(krk_peek(1)), krk_peek(0));
+				krk_pop();
+			}
+			break;
+		}
+		case TAG_DICT: {
+			size_t count = takeCount(at);
+			krk_push(krk_dict_of(0, NULL, 0));
+			for (size_t i = 0; i < count; ++i) {
+				decode(at);
+				decode(at);
+				krk_tableSet(AS_DICT(krk_peek(2)), krk_peek(1), krk_peek(0));
+				krk_pop();
+				krk_pop();
+			}
+			break;
+		}
+	}
+}
+
+/**
+ * @brief A value waiting in a channel.
+ */
+struct Message {
+	struct Message * next;
+	size_t size;
+	unsigned char data[];
+};
+
+/**
+ * @brief The shared part of a channel.
+ *
+ * Channels belong to no VM. Each @ref Channel object, in whichever
+ * interpreter, holds a reference, and the channel is freed when the last
+ * of them is collected.
+ */
+struct ChannelState {
+	struct ChannelState * next; /**< In @ref channels */
+	size_t id;
+	size_t refs;
+	pthread_mutex_t mutex;
+	pthread_cond_t notEmpty;
+	struct Message * head;
+	struct Message ** tail;
+	size_t count;
+};
+
+static pthread_mutex_t channelsLock = PTHREAD_MUTEX_INITIALIZER;
+static struct ChannelState * channels = NULL;
+static size_t lastChannel = 0;
+
+/** Take a reference to the channel numbered @p id, or a new one if @p id is 0. */
+static struct ChannelState * openChannel(size_t id) {
+	pthread_mutex_lock(&channelsLock);
+	struct ChannelState * state = channels;
+	if (id) {
+		while (state && state->id != id) state = state->next;
+		if (state) state->refs++;
+	} else {
+		state = calloc(1, sizeof(struct ChannelState));
+		state->id = ++lastChannel;
+		state->refs = 1;
+		state->tail = &state->head;
+		pthread_mutex_init(&state->mutex, NULL);
+		pthread_cond_init(&state->notEmpty, NULL);
+		state->next = channels;
+		channels = state;
+	}
+	pthread_mutex_unlock(&channelsLock);
+	return state;
+}
+
+static void closeChannel(struct ChannelState * state) {
+	pthread_mutex_lock(&channelsLock);
+	if (--state->refs) {
+		pthread_mutex_unlock(&channelsLock);
+		return;
+	}
+	struct ChannelState ** link = &channels;
+	while (*link != state) link = &(*link)->next;
+	*link = state->next;
+	pthread_mutex_unlock(&channelsLock);
+
+	while (state->head) {
+		struct Message * next = state->head->next;
+		free(state->head);
+		state->head = next;
+	}
+	pthread_mutex_destroy(&state->mutex);
+	pthread_cond_destroy(&state->notEmpty);
+	free(state);
+}
+
+/**
+ * @brief One interpreter's handle on a channel.
+ * @extends KrkInstance
+ */
+struct Channel {
+	KrkInstance inst;
+	struct ChannelState * state;
+};
+
+#define IS_Channel(o) (krk_isInstanceOf(o,ChannelClass))
+#define AS_Channel(o) ((struct Channel*)AS_OBJECT(o))
+#define CURRENT_CTYPE struct Channel *
+#define CURRENT_NAME  self
+
+#define CHECK_CHANNEL() do { if (!self->state) return krk_runtimeError(vm.exceptions->valueError, "channel is not open"); } while (0)
+
+static void _channel_gcsweep(KrkInstance * self) {
+	struct Channel * me = (struct Channel*)self;
+	if (me->state) closeChannel(me->state);
+	me->state = NULL;
+}
+
+KRK_METHOD(Channel,__init__,{
+	METHOD_TAKES_AT_MOST(1);
+	if (self->state) return krk_runtimeError(vm.exceptions->valueError, "channel is already open");
+	if (argc > 1) {
+		CHECK_ARG(1,int,krk_integer_type,id);
+		if (id <= 0 || !(self->state = openChannel(id))) return krk_runtimeError(vm.exceptions->valueError, "no channel %zd", (ssize_t)id);
+	} else {
+		self->state = openChannel(0);
+	}
+	return argv[0];
+})
+
+KRK_METHOD(Channel,id,{
+	METHOD_TAKES_NONE();
+	CHECK_CHANNEL();
+	return INTEGER_VAL(self->state->id);
+})
+
+KRK_METHOD(Channel,__repr__,{
+	METHOD_TAKES_NONE();
+	CHECK_CHANNEL();
+	char tmp[64];
+	size_t len = snprintf(tmp, sizeof(tmp), "<Channel %zu>", self->state->id);
+	return OBJECT_VAL(krk_copyString(tmp, len));
+})
+
+KRK_METHOD(Channel,__len__,{
+	METHOD_TAKES_NONE();
+	CHECK_CHANNEL();
+	pthread_mutex_lock(&self->state->mutex);
+	size_t count = self->state->count;
+	pthread_mutex_unlock(&self->state->mutex);
+	return INTEGER_VAL(count);
+})
+
+KRK_METHOD(Channel,send,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_CHANNEL();
+	struct Encoder out = {0};
+	put(&out, &(struct Message){0}, sizeof(struct Message));
+	if (!encode(&out, argv[1], 0)) {
+		free(out.data);
+		return NONE_VAL();
+	}
+	struct Message * message = (struct Message*)out.data;
+	message->size = out.size - sizeof(struct Message);
+
+	struct ChannelState * state = self->state;
+	pthread_mutex_lock(&state->mutex);
+	*state->tail = message;
+	state->tail = &message->next;
+	state->count++;
+	pthread_cond_signal(&state->notEmpty);
+	pthread_mutex_unlock(&state->mutex);
+})
+
+KRK_METHOD(Channel,recv,{
+	KRK_ARGS(args, ".|pO", "block", "timeout");
+	int blocking = 1;
+	KrkValue timeout = NONE_VAL();
+	if (!krk_parseArgs(args, &blocking, &timeout)) return NONE_VAL();
+	CHECK_CHANNEL();
+	struct timespec until;
+	int timed = krk_parseTimeout(timeout, &until);
+	if (timed < 0) return NONE_VAL();
+
+	struct ChannelState * state = self->state;
+	krk_beginBlocking();
+	pthread_mutex_lock(&state->mutex);
+	while (!state->head && blocking) {
+		if (timed) {
+			if (pthread_cond_timedwait(&state->notEmpty, &state->mutex, &until) == ETIMEDOUT) break;
+		} else {
+			pthread_cond_wait(&state->notEmpty, &state->mutex);
+		}
+	}
+	struct Message * message = state->head;
+	if (message) {
+		state->head = message->next;
+		if (!state->head) state->tail = &state->head;
+		state->count--;
+	}
+	pthread_mutex_unlock(&state->mutex);
+	krk_endBlocking();
+
+	if (!message) return krk_runtimeError(ChannelEmpty, "Channel is empty.");
+	const unsigned char * at = message->data;
+	decode(&at);
+	free(message);
+	return krk_pop();
+})
+
+#undef CURRENT_CTYPE
+
+/**
+ * @brief The thread an interpreter runs on, and the one job it may have.
+ *
+ * Shared by the @ref Interpreter object and its thread. If the object is
+ * collected while the thread still runs, the thread frees it on its way out.
+ */
+struct Host {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t wake;  /**< Signalled when @ref source or @ref closing is set */
+	pthread_cond_t done;  /**< Signalled when a job is finished */
+	int flags;            /**< Global flags taken from the creating VM */
+	char * binpath;
+	char ** paths;        /**< Module paths, copied from the creating interpreter */
+	size_t pathCount;
+	char * source;        /**< Code waiting to run, if any */
+	char * error;         /**< What the last job raised, if it raised anything */
+	int busy;             /**< A job is waiting or running */
+	int closing;
+	int detached;
+};
+
+static void freeHost(struct Host * host) {
+	for (size_t i = 0; i < host->pathCount; ++i) free(host->paths[i]);
+	free(host->paths);
+	free(host->binpath);
+	free(host->source);
+	free(host->error);
+	pthread_mutex_destroy(&host->mutex);
+	pthread_cond_destroy(&host->wake);
+	pthread_cond_destroy(&host->done);
+	free(host);
+}
+
+/** Run @p source in the current VM; returns what it raised, as a malloc'd string, or NULL. */
+static char * runSource(const char * source) {
+	krk_interpret(source, "<interpreter>");
+	if (!(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION)) {
+		krk_resetStack();
+		return NULL;
+	}
+	KrkValue exception = krk_currentThread.currentException;
+	krk_currentThread.flags &= ~KRK_THREAD_HAS_EXCEPTION;
+	krk_push(exception);
+	KrkClass * type = krk_getType(exception);
+	const char * message = "";
+	if (type->_tostr) {
+		krk_push(exception);
+		KrkValue str = krk_callDirect(type->_tostr, 1);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) krk_currentThread.flags &= ~KRK_THREAD_HAS_EXCEPTION;
+		else if (IS_STRING(str)) message = AS_CSTRING(str);
+		krk_push(str);
+	}
+	size_t size = type->name->length + strlen(message) + 3;
+	char * error = malloc(size);
+	snprintf(error, size, *message ? "%s: %s" : "%s", type->name->chars, message);
+	krk_resetStack();
+	return error;
+}
+
+static void * hostThread(void * arg) {
+	struct Host * host = arg;
+	krk_newVM(host->flags, host->binpath);
+	krk_startModule("__main__");
+
+	KrkValue paths = krk_list_of(0, NULL, 0);
+	krk_push(paths);
+	for (size_t i = 0; i < host->pathCount; ++i) {
+		krk_writeValueArray(AS_LIST(paths), OBJECT_VAL(krk_copyString(host->paths[i], strlen(host->paths[i]))));
+	}
+	krk_attachNamedValue(&vm.system->fields, "module_paths", paths);
+	krk_pop();
+
+	pthread_mutex_lock(&host->mutex);
+	while (1) {
+		while (!host->source && !host->closing) pthread_cond_wait(&host->wake, &host->mutex);
+		/* What was started before a close still runs. */
+		if (!host->source) break;
+		char * source = host->source;
+		host->source = NULL;
+		pthread_mutex_unlock(&host->mutex);
+		char * error = runSource(source);
+		free(source);
+		pthread_mutex_lock(&host->mutex);
+		host->error = error;
+		host->busy = 0;
+		pthread_cond_broadcast(&host->done);
+	}
+	int detached = host->detached;
+	pthread_mutex_unlock(&host->mutex);
+
+	krk_freeVM();
+	if (detached) freeHost(host);
+	return NULL;
+}
+
+/**
+ * @brief An interpreter to run code in.
+ * @extends KrkInstance
+ */
+struct Interpreter {
+	KrkInstance inst;
+	struct Host * host;
+};
+
+#define IS_Interpreter(o) (krk_isInstanceOf(o,InterpreterClass))
+#define AS_Interpreter(o) ((struct Interpreter*)AS_OBJECT(o))
+#define CURRENT_CTYPE struct Interpreter *
+
+static void _interpreter_gcsweep(KrkInstance * self) {
+	struct Interpreter * me = (struct Interpreter*)self;
+	struct Host * host = me->host;
+	if (!host) return;
+	me->host = NULL;
+	pthread_mutex_lock(&host->mutex);
+	host->closing = 1;
+	host->detached = 1;
+	pthread_cond_signal(&host->wake);
+	pthread_mutex_unlock(&host->mutex);
+	pthread_detach(host->thread);
+}
+
+#define CHECK_OPEN() do { if (!self->host) return krk_runtimeError(InterpreterError, "interpreter is closed"); } while (0)
+
+KRK_METHOD(Interpreter,__init__,{
+	METHOD_TAKES_NONE();
+	if (self->host) return krk_runtimeError(vm.exceptions->valueError, "interpreter is already running");
+
+	struct Host * host = calloc(1, sizeof(struct Host));
+	pthread_mutex_init(&host->mutex, NULL);
+	pthread_cond_init(&host->wake, NULL);
+	pthread_cond_init(&host->done, NULL);
+	/* Tracebacks are not printed; what was raised is reported to join() instead. */
+	host->flags = KRK_GLOBAL_CLEAN_OUTPUT | (vm.globalFlags & (KRK_GLOBAL_ENABLE_STRESS_GC | KRK_GLOBAL_OPTIMIZE | KRK_GLOBAL_NO_WRITE_BYTECODE));
+	if (vm.binpath) host->binpath = strdup(vm.binpath);
+
+	KrkValue paths;
+	if (krk_tableGet(&vm.system->fields, OBJECT_VAL(S("module_paths")), &paths) && IS_list(paths)) {
+		host->paths = malloc(sizeof(char*) * (AS_LIST(paths)->count + 1));
+		for (size_t i = 0; i < AS_LIST(paths)->count; ++i) {
+			KrkValue path = AS_LIST(paths)->values[i];
+			if (IS_STRING(path)) host->paths[host->pathCount++] = strdup(AS_CSTRING(path));
+		}
+	}
+
+	if (pthread_create(&host->thread, NULL, hostThread, host)) {
+		freeHost(host);
+		return krk_runtimeError(InterpreterError, "could not start a thread for the interpreter");
+	}
+	self->host = host;
+	return argv[0];
+})
+
+KRK_METHOD(Interpreter,start,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,str,KrkString*,source);
+	CHECK_OPEN();
+	struct Host * host = self->host;
+	pthread_mutex_lock(&host->mutex);
+	if (host->busy) {
+		pthread_mutex_unlock(&host->mutex);
+		return krk_runtimeError(InterpreterError, "interpreter is already running");
+	}
+	free(host->error);
+	host->error = NULL;
+	host->source = strdup(source->chars);
+	host->busy = 1;
+	pthread_cond_signal(&host->wake);
+	pthread_mutex_unlock(&host->mutex);
+})
+
+KRK_METHOD(Interpreter,join,{
+	METHOD_TAKES_NONE();
+	CHECK_OPEN();
+	struct Host * host = self->host;
+	krk_beginBlocking();
+	pthread_mutex_lock(&host->mutex);
+	while (host->busy) pthread_cond_wait(&host->done, &host->mutex);
+	char * error = host->error;
+	host->error = NULL;
+	pthread_mutex_unlock(&host->mutex);
+	krk_endBlocking();
+	if (error) {
+		krk_runtimeError(InterpreterError, "%s", error);
+		free(error);
+	}
+})
+
+KRK_METHOD(Interpreter,run,{
+	METHOD_TAKES_EXACTLY(1);
+	FUNC_NAME(Interpreter,start)(argc, argv, hasKw);
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return NONE_VAL();
+	return FUNC_NAME(Interpreter,join)(1, argv, 0);
+})
+
+KRK_METHOD(Interpreter,running,{
+	METHOD_TAKES_NONE();
+	if (!self->host) return BOOLEAN_VAL(0);
+	pthread_mutex_lock(&self->host->mutex);
+	int busy = self->host->busy;
+	pthread_mutex_unlock(&self->host->mutex);
+	return BOOLEAN_VAL(busy);
+})
+
+KRK_METHOD(Interpreter,close,{
+	METHOD_TAKES_NONE();
+	struct Host * host = self->host;
+	if (!host) return NONE_VAL();
+	self->host = NULL;
+	pthread_mutex_lock(&host->mutex);
+	host->closing = 1;
+	pthread_cond_signal(&host->wake);
+	pthread_mutex_unlock(&host->mutex);
+	krk_beginBlocking();
+	pthread_join(host->thread, NULL);
+	krk_endBlocking();
+	freeHost(host);
+})
+
+KRK_METHOD(Interpreter,__enter__,{
+	METHOD_TAKES_NONE();
+	CHECK_OPEN();
+	return argv[0];
+})
+
+KRK_METHOD(Interpreter,__exit__,{
+	return FUNC_NAME(Interpreter,close)(1, argv, 0);
+})
+
+#undef CURRENT_CTYPE
+
+/**
+ * Keep this library loaded for good: the threads of interpreters that were
+ * collected may still be running its code after every module object
+ * referencing it is gone.
+ */
+static void pinLibrary(void) {
+#if !defined(_WIN32) && defined(RTLD_NODELETE)
+	static int pinned = 0;
+	if (__atomic_exchange_n(&pinned, 1, __ATOMIC_ACQ_REL)) return;
+	Dl_info info;
+	if (dladdr(&pinned, &info) && info.dli_fname) dlopen(info.dli_fname, RTLD_LAZY | RTLD_NODELETE);
+#endif
+}
+#endif
+
+KrkValue krk_module_onload_interpreters(void) {
+#ifndef ENABLE_THREADING
+	return krk_runtimeError(vm.exceptions->importError, "interpreters requires thread support");
+#else
+	pinLibrary();
+
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	krk_push(OBJECT_VAL(module));
+
+	KRK_DOC(module,
+		"@brief Isolated interpreters running in parallel, and channels between them.\n\n"
+		"Each @ref Interpreter has its own heap, collector, modules and globals, and runs on a "
+		"thread of its own. Values are passed between interpreters through a @ref Channel, as copies.");
+
+	KrkClass * Interpreter = krk_makeClass(module, &InterpreterClass, "Interpreter", vm.baseClasses->objectClass);
+	KRK_DOC(Interpreter,
+		"@brief A separate interpreter, on a thread of its own.\n\n"
+		"Its module paths are those of the interpreter that made it. Globals set by code it runs "
+		"are kept for the code it runs next.");
+	Interpreter->allocSize = sizeof(struct Interpreter);
+	Interpreter->_ongcsweep = _interpreter_gcsweep;
+	BIND_METHOD(Interpreter,__init__);
+	KRK_DOC(BIND_METHOD(Interpreter,start),
+		"@brief Start running @p source in the interpreter, without waiting for it.\n"
+		"@arguments source");
+	KRK_DOC(BIND_METHOD(Interpreter,join),
+		"@brief Wait for what was started to finish.\n\n"
+		"If it raised an exception, an @ref InterpreterError with its type and message is raised here.");
+	KRK_DOC(BIND_METHOD(Interpreter,run),
+		"@brief Run @p source in the interpreter and wait for it, as @ref start and then @ref join.\n"
+		"@arguments source");
+	KRK_DOC(BIND_METHOD(Interpreter,close),
+		"@brief Wait for what was started, then stop the interpreter and free everything in it.");
+	BIND_PROP(Interpreter,running);
+	BIND_METHOD(Interpreter,__enter__);
+	BIND_METHOD(Interpreter,__exit__);
+	krk_finalizeClass(Interpreter);
+
+	KrkClass * Channel = krk_makeClass(module, &ChannelClass, "Channel", vm.baseClasses->objectClass);
+	KRK_DOC(Channel,
+		"@brief A queue of values that any interpreter can send to and receive from.\n"
+		"@arguments id=None\n\n"
+		"With an @p id, opens the existing channel with that @ref id, which is how another "
+		"interpreter gets hold of it. Only @c None, @ref bool, @ref int, @ref float, @ref str, "
+		"@ref bytes, and tuples, lists and dicts of them can be sent.");
+	Channel->allocSize = sizeof(struct Channel);
+	Channel->_ongcsweep = _channel_gcsweep;
+	BIND_METHOD(Channel,__init__);
+	BIND_METHOD(Channel,__repr__);
+	krk_defineNative(&Channel->methods, "__str__", FUNC_NAME(Channel,__repr__));
+	BIND_METHOD(Channel,__len__);
+	BIND_PROP(Channel,id);
+	KRK_DOC(BIND_METHOD(Channel,send),
+		"@brief Put a copy of @p value at the end of the channel.\n"
+		"@arguments value");
+	KRK_DOC(BIND_METHOD(Channel,recv),
+		"@brief Take the value at the front of the channel.\n"
+		"@arguments block=True,timeout=None\n\n"
+		"Waits for one to be sent, if @p block is set, for up to @p timeout seconds; "
+		"raises @ref ChannelEmpty if there is none.");
+	krk_attachNamedValue(&Channel->methods, "__hash__", NONE_VAL());
+	krk_finalizeClass(Channel);
+
+	krk_makeClass(module, &InterpreterError, "InterpreterError", vm.exceptions->baseException);
+	KRK_DOC(InterpreterError, "@brief Raised for code that failed in another interpreter.");
+	krk_finalizeClass(InterpreterError);
+	krk_makeClass(module, &ChannelEmpty, "ChannelEmpty", vm.exceptions->baseException);
+	KRK_DOC(ChannelEmpty, "@brief Raised when nothing could be received from a channel.");
+	krk_finalizeClass(ChannelEmpty);
+
+	return krk_pop();
+#endif
+}
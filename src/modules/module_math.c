@@ -5,6 +5,7 @@
 #include <kuroko/vm.h>
 #include <kuroko/value.h>
 #include <kuroko/object.h>
+#include <kuroko/memory.h>
 #include <kuroko/util.h>
 
 #define ONE_ARGUMENT(name) if (argc != 1) { \
@@ -147,6 +148,105 @@ MATH_IS(isfinite)
 MATH_IS(isinf)
 MATH_IS(isnan)
 
+/**
+ * @brief Exact sum of floats, as the non-overlapping partial sums of the values so far.
+ *
+ * This is Shewchuk's algorithm, as used by Python's @c math.fsum: each value
+ * is added to the partials from smallest to largest, keeping the rounding
+ * error of each addition as a new partial.
+ */
+struct Partials {
+	double * values;
+	size_t count;
+	size_t capacity;
+	double special;   /**< Sum of infinities and NaNs, which are left out of the partials */
+	int hasSpecial;
+	int hasNan;
+	int overflowed;
+};
+
+static void addPartial(struct Partials * P, double x) {
+	if (!isfinite(x)) {
+		P->special += x;
+		P->hasSpecial = 1;
+		if (isnan(x)) P->hasNan = 1;
+		return;
+	}
+	size_t i = 0;
+	for (size_t j = 0; j < P->count; ++j) {
+		double y = P->values[j];
+		if (fabs(x) < fabs(y)) {
+			double t = x;
+			x = y;
+			y = t;
+		}
+		double hi = x + y;
+		double lo = y - (hi - x);
+		if (lo != 0.0) P->values[i++] = lo;
+		x = hi;
+	}
+	if (!isfinite(x)) P->overflowed = 1;
+	if (i == P->capacity) {
+		size_t old = P->capacity;
+		P->capacity = GROW_CAPACITY(old);
+		P->values = GROW_ARRAY(double, P->values, old, P->capacity);
+	}
+	P->values[i++] = x;
+	P->count = i;
+}
+
+static double sumPartials(struct Partials * P) {
+	size_t n = P->count;
+	double hi = 0.0, lo = 0.0;
+	if (!n) return 0.0;
+	hi = P->values[--n];
+	while (n > 0) {
+		double x = hi, y = P->values[--n];
+		hi = x + y;
+		lo = y - (hi - x);
+		if (lo != 0.0) break;
+	}
+	/* Round half to even when the rest of the partials push the result past the halfway point. */
+	if (n > 0 && ((lo < 0.0 && P->values[n-1] < 0.0) || (lo > 0.0 && P->values[n-1] > 0.0))) {
+		double y = lo * 2.0, x = hi + y;
+		if (y == x - hi) hi = x;
+	}
+	return hi;
+}
+
+#define unpackArray(counter, indexer) do { \
+	for (size_t i = 0; i < counter; ++i) { \
+		KrkValue value = indexer; \
+		if (IS_FLOATING(value)) addPartial(&P, AS_FLOATING(value)); \
+		else if (IS_INTEGER(value)) addPartial(&P, (double)AS_INTEGER(value)); \
+		else { \
+			if (unpackingIterable) { krk_pop(); krk_pop(); } \
+			FREE_ARRAY(double, P.values, P.capacity); \
+			REAL_NUMBER_NOT(fsum, value) \
+		} \
+	} \
+} while (0)
+static KrkValue _math_fsum(int argc, const KrkValue argv[], int hasKw) {
+	ONE_ARGUMENT(fsum)
+	struct Partials P = {0};
+	int unpackingIterable = 0;
+	if (IS_TUPLE(argv[0])) {
+		unpackArray(AS_TUPLE(argv[0])->values.count, AS_TUPLE(argv[0])->values.values[i]);
+	} else if (IS_list(argv[0])) {
+		unpackArray(AS_LIST(argv[0])->count, AS_LIST(argv[0])->values[i]);
+	} else {
+		unpackingIterable = 1;
+		unpackIterable(argv[0]);
+	}
+	double result = P.hasSpecial ? P.special : sumPartials(&P);
+	int overflowed = P.overflowed && !P.hasSpecial;
+	FREE_ARRAY(double, P.values, P.capacity);
+	if (isnan(result) && !P.hasNan) return krk_runtimeError(vm.exceptions->valueError, "-inf + inf in fsum");
+	if (overflowed) return krk_runtimeError(vm.exceptions->valueError, "intermediate overflow in fsum");
+	return FLOATING_VAL(result);
+}
+#undef unpackArray
+
 #define bind(name) krk_defineNative(&module->fields, #name, _math_ ## name)
 
 KrkValue krk_module_onload_math(void) {
@@ -258,6 +358,11 @@ KrkValue krk_module_onload_math(void) {
 	KRK_DOC(bind(isinf),
 		"@brief Determines if the input is infinite.\n"
 		"@arguments x\n");
+	KRK_DOC(bind(fsum),
+		"@brief Adds up the numbers from @p iterable without losing precision.\n"
+		"@arguments iterable\n\n"
+		"Unlike @ref sum, which rounds after each addition, this keeps track of the rounding errors, "
+		"so the result is the exact sum rounded once.");
 	KRK_DOC(bind(isnan),
 		"@brief Determines if the input is the floating point `NaN`.\n"
 		"@arguments x\n");
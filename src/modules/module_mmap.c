@@ -0,0 +1,592 @@
+/**
+ * @file    module_mmap.c
+ * @brief   Memory-mapped files.
+ *
+ * A map is a view of a file, or of anonymous memory, that is read and
+ * written in place: indexing, searching and iterating look at the mapped
+ * pages directly, and only slices and reads copy anything, into @c bytes
+ * of the size asked for. What is mapped is not part of the heap, so the
+ * collector neither counts it nor has to free it; it is unmapped when the
+ * map is closed or collected.
+ */
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <kuroko/vm.h>
+#include <kuroko/util.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+# define MAP_ANONYMOUS MAP_ANON
+#endif
+
+static KrkVMLocal memoryMapKey;
+#define MemoryMapClass KRK_VM_LOCAL(KrkClass*,memoryMapKey)
+static KrkVMLocal memoryMapIteratorKey;
+#define MemoryMapIteratorClass KRK_VM_LOCAL(KrkClass*,memoryMapIteratorKey)
+
+enum Access {
+	ACCESS_DEFAULT,
+	ACCESS_READ,
+	ACCESS_WRITE,
+	ACCESS_COPY,
+};
+
+/**
+ * @brief Mapped region of a file or of anonymous memory.
+ * @extends KrkInstance
+ */
+struct MemoryMap {
+	KrkInstance inst;
+	unsigned char * data; /**< Start of the mapping; NULL once closed */
+	size_t length;        /**< Bytes mapped */
+	size_t pos;           /**< Position for read, write and seek */
+	int writable;         /**< Whether the pages are mapped with PROT_WRITE */
+	enum Access access;
+};
+
+#define IS_MemoryMap(o) (krk_isInstanceOf(o,MemoryMapClass))
+#define AS_MemoryMap(o) ((struct MemoryMap*)AS_OBJECT(o))
+#define CURRENT_CTYPE struct MemoryMap *
+#define CURRENT_NAME  self
+
+static void _mmap_gcsweep(KrkInstance * self) {
+	struct MemoryMap * me = (struct MemoryMap*)self;
+	if (me->data) munmap(me->data, me->length);
+	me->data = NULL;
+}
+
+static int _mmap_getbuffer(KrkInstance * self, KrkBuffer * buffer) {
+	struct MemoryMap * me = (struct MemoryMap*)self;
+	if (!me->data) {
+		krk_runtimeError(vm.exceptions->valueError, "mmap closed or invalid");
+		return 0;
+	}
+	buffer->bytes = me->data;
+	buffer->length = me->length;
+	buffer->readonly = !me->writable;
+	return 1;
+}
+
+#define NAMED_ARG(name,type,ctype,def,ind) \
+	ctype name = def; \
+	if (argc > ind) { \
+		CHECK_ARG(ind,type,ctype,_tmp); \
+		name = _tmp; \
+	} \
+	if (hasKw) { \
+		KrkValue tmp; \
+		if (krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S(#name)), &tmp)) { \
+			if (!IS_ ## type (tmp)) return TYPE_ERROR(type,tmp); \
+			name = AS_ ## type (tmp); \
+		} \
+	}
+
+#define CHECK_OPEN() do { if (!self->data) return krk_runtimeError(vm.exceptions->valueError, "mmap closed or invalid"); } while (0)
+#define CHECK_WRITABLE() do { if (!self->writable) return krk_runtimeError(vm.exceptions->typeError, "mmap can't modify a readonly memory map."); } while (0)
+
+KRK_METHOD(MemoryMap,__init__,{
+	METHOD_TAKES_AT_LEAST(2);
+	METHOD_TAKES_AT_MOST(6);
+	NAMED_ARG(fileno,int,krk_integer_type,-1,1);
+	NAMED_ARG(length,int,krk_integer_type,0,2);
+	NAMED_ARG(flags,int,krk_integer_type,MAP_SHARED,3);
+	NAMED_ARG(prot,int,krk_integer_type,PROT_READ|PROT_WRITE,4);
+	NAMED_ARG(access,int,krk_integer_type,ACCESS_DEFAULT,5);
+	NAMED_ARG(offset,int,krk_integer_type,0,6);
+
+	if (self->data) return krk_runtimeError(vm.exceptions->valueError, "mmap is already mapped");
+	if (length < 0) return krk_runtimeError(vm.exceptions->valueError, "memory mapped length must be positive");
+	if (offset < 0) return krk_runtimeError(vm.exceptions->valueError, "memory mapped offset must be positive");
+
+	switch (access) {
+		case ACCESS_DEFAULT: break;
+		case ACCESS_READ:  flags = MAP_SHARED;  prot = PROT_READ; break;
+		case ACCESS_WRITE: flags = MAP_SHARED;  prot = PROT_READ|PROT_WRITE; break;
+		case ACCESS_COPY:  flags = MAP_PRIVATE; prot = PROT_READ|PROT_WRITE; break;
+		default:
+			return krk_runtimeError(vm.exceptions->valueError, "mmap invalid access parameter.");
+	}
+
+	if (fileno == -1) {
+		flags |= MAP_ANONYMOUS;
+		if (length == 0) return krk_runtimeError(vm.exceptions->valueError, "cannot mmap an empty region");
+	} else {
+		struct stat st;
+		if (fstat(fileno, &st) < 0) return krk_runtimeError(vm.exceptions->ioError, "%s", strerror(errno));
+		if (S_ISREG(st.st_mode)) {
+			if (length == 0) {
+				if (st.st_size == 0) return krk_runtimeError(vm.exceptions->valueError, "cannot mmap an empty file");
+				if (offset >= st.st_size) return krk_runtimeError(vm.exceptions->valueError, "mmap offset is greater than file size");
+				length = st.st_size - offset;
+			} else if (offset > st.st_size || st.st_size - offset < length) {
+				return krk_runtimeError(vm.exceptions->valueError, "mmap length is greater than file size");
+			}
+		} else if (length == 0) {
+			return krk_runtimeError(vm.exceptions->valueError, "cannot mmap a file of unknown size without a length");
+		}
+	}
+
+	void * data = mmap(NULL, length, prot, flags, fileno, offset);
+	if (data == MAP_FAILED) return krk_runtimeError(vm.exceptions->ioError, "%s", strerror(errno));
+
+	self->data = data;
+	self->length = length;
+	self->pos = 0;
+	self->writable = !!(prot & PROT_WRITE);
+	self->access = access;
+	return argv[0];
+})
+
+KRK_METHOD(MemoryMap,__len__,{
+	METHOD_TAKES_NONE();
+	CHECK_OPEN();
+	return INTEGER_VAL(self->length);
+})
+
+KRK_METHOD(MemoryMap,closed,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(self->data == NULL);
+})
+
+KRK_METHOD(MemoryMap,__repr__,{
+	METHOD_TAKES_NONE();
+	static const char * accessNames[] = {"ACCESS_DEFAULT", "ACCESS_READ", "ACCESS_WRITE", "ACCESS_COPY"};
+	char tmp[256];
+	size_t len;
+	if (!self->data) {
+		len = snprintf(tmp, sizeof(tmp), "<mmap.mmap closed=True>");
+	} else {
+		len = snprintf(tmp, sizeof(tmp), "<mmap.mmap closed=False, access=%s, length=%zu, pos=%zu>",
+			accessNames[self->access], self->length, self->pos);
+	}
+	return OBJECT_VAL(krk_copyString(tmp, len));
+})
+
+#define MMAP_WRAP_INDEX() \
+	if (index < 0) index += self->length; \
+	if (index < 0 || index >= (krk_integer_type)self->length) return krk_runtimeError(vm.exceptions->indexError, "mmap index out of range")
+
+KRK_METHOD(MemoryMap,__getitem__,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_OPEN();
+	if (IS_INTEGER(argv[1])) {
+		CHECK_ARG(1,int,krk_integer_type,index);
+		MMAP_WRAP_INDEX();
+		return INTEGER_VAL(self->data[index]);
+	} else if (IS_slice(argv[1])) {
+		KRK_SLICER(argv[1],self->length) {
+			return NONE_VAL();
+		}
+		if (step == 1) {
+			return OBJECT_VAL(krk_newBytes(end > start ? end - start : 0, self->data + start));
+		}
+		size_t length = step > 0 ? (end > start ? (end - start + step - 1) / step : 0) : (start > end ? (start - end - step - 1) / -step : 0);
+		KrkBytes * out = krk_newBytes(length, NULL);
+		for (size_t i = 0; i < length; ++i) {
+			out->bytes[i] = self->data[start + (krk_integer_type)i * step];
+		}
+		return OBJECT_VAL(out);
+	} else {
+		return TYPE_ERROR(int or slice, argv[1]);
+	}
+})
+
+KRK_METHOD(MemoryMap,__setitem__,{
+	METHOD_TAKES_EXACTLY(2);
+	CHECK_OPEN();
+	CHECK_WRITABLE();
+	if (IS_INTEGER(argv[1])) {
+		CHECK_ARG(1,int,krk_integer_type,index);
+		MMAP_WRAP_INDEX();
+		if (!IS_INTEGER(argv[2])) return TYPE_ERROR(int,argv[2]);
+		if (AS_INTEGER(argv[2]) < 0 || AS_INTEGER(argv[2]) > 255) return krk_runtimeError(vm.exceptions->valueError, "mmap item value must be in range(0, 256)");
+		self->data[index] = AS_INTEGER(argv[2]);
+		return argv[2];
+	} else if (IS_slice(argv[1])) {
+		if (!IS_BYTES(argv[2])) return TYPE_ERROR(bytes,argv[2]);
+		KrkBytes * value = AS_BYTES(argv[2]);
+		KRK_SLICER(argv[1],self->length) {
+			return NONE_VAL();
+		}
+		size_t length = step > 0 ? (end > start ? (end - start + step - 1) / step : 0) : (start > end ? (start - end - step - 1) / -step : 0);
+		if (length != value->length) return krk_runtimeError(vm.exceptions->indexError, "mmap slice assignment is wrong size");
+		if (step == 1) {
+			memcpy(self->data + start, value->bytes, length);
+		} else {
+			for (size_t i = 0; i < length; ++i) {
+				self->data[start + (krk_integer_type)i * step] = value->bytes[i];
+			}
+		}
+		return argv[2];
+	} else {
+		return TYPE_ERROR(int or slice, argv[1]);
+	}
+})
+
+/**
+ * Work out the range a search looks at from the optional @p start and @p end
+ * arguments, which are clamped to the map like the bounds of a slice.
+ */
+static int searchRange(struct MemoryMap * self, int argc, const KrkValue argv[], size_t * start, size_t * end) {
+	krk_integer_type bounds[2] = {self->pos, self->length};
+	for (int i = 0; i < 2; ++i) {
+		if (argc <= i + 2 || IS_NONE(argv[i + 2])) continue;
+		if (!IS_INTEGER(argv[i + 2])) return 0;
+		bounds[i] = AS_INTEGER(argv[i + 2]);
+		if (bounds[i] < 0) bounds[i] += self->length;
+		if (bounds[i] < 0) bounds[i] = 0;
+		if (bounds[i] > (krk_integer_type)self->length) bounds[i] = self->length;
+	}
+	*start = bounds[0];
+	*end = bounds[1];
+	return 1;
+}
+
+/**
+ * Find the first occurrence of @p needle in @p haystack, skipping from one
+ * occurrence of its first byte to the next with memchr.
+ */
+static const unsigned char * findBytes(const unsigned char * haystack, size_t length, const unsigned char * needle, size_t needleLength) {
+	if (!needleLength) return haystack;
+	const unsigned char * last = haystack + length - needleLength;
+	while (haystack <= last) {
+		haystack = memchr(haystack, needle[0], last - haystack + 1);
+		if (!haystack) return NULL;
+		if (!memcmp(haystack, needle, needleLength)) return haystack;
+		haystack++;
+	}
+	return NULL;
+}
+
+KRK_METHOD(MemoryMap,find,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(3);
+	CHECK_OPEN();
+	CHECK_ARG(1,bytes,KrkBytes*,sub);
+	size_t start, end;
+	if (!searchRange(self, argc, argv, &start, &end)) return krk_runtimeError(vm.exceptions->typeError, "slice indices must be integers or None");
+	if (end < start || end - start < sub->length) return INTEGER_VAL(-1);
+	const unsigned char * found = findBytes(self->data + start, end - start, sub->bytes, sub->length);
+	return INTEGER_VAL(found ? found - self->data : -1);
+})
+
+KRK_METHOD(MemoryMap,rfind,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(3);
+	CHECK_OPEN();
+	CHECK_ARG(1,bytes,KrkBytes*,sub);
+	size_t start, end;
+	if (!searchRange(self, argc, argv, &start, &end)) return krk_runtimeError(vm.exceptions->typeError, "slice indices must be integers or None");
+	if (end < start || end - start < sub->length) return INTEGER_VAL(-1);
+	for (size_t i = end - sub->length + 1; i-- > start; ) {
+		if (!memcmp(self->data + i, sub->bytes, sub->length)) return INTEGER_VAL(i);
+	}
+	return INTEGER_VAL(-1);
+})
+
+KRK_METHOD(MemoryMap,read,{
+	METHOD_TAKES_AT_MOST(1);
+	CHECK_OPEN();
+	size_t available = self->pos < self->length ? self->length - self->pos : 0;
+	size_t size = available;
+	if (argc > 1 && !IS_NONE(argv[1])) {
+		CHECK_ARG(1,int,krk_integer_type,requested);
+		if (requested >= 0 && (size_t)requested < available) size = requested;
+	}
+	KrkBytes * out = krk_newBytes(size, self->data + self->pos);
+	self->pos += size;
+	return OBJECT_VAL(out);
+})
+
+KRK_METHOD(MemoryMap,read_byte,{
+	METHOD_TAKES_NONE();
+	CHECK_OPEN();
+	if (self->pos >= self->length) return krk_runtimeError(vm.exceptions->valueError, "read byte out of range");
+	return INTEGER_VAL(self->data[self->pos++]);
+})
+
+KRK_METHOD(MemoryMap,readline,{
+	METHOD_TAKES_NONE();
+	CHECK_OPEN();
+	if (self->pos >= self->length) return OBJECT_VAL(krk_newBytes(0, NULL));
+	const unsigned char * start = self->data + self->pos;
+	const unsigned char * newline = memchr(start, '\n', self->length - self->pos);
+	size_t size = newline ? (size_t)(newline - start) + 1 : self->length - self->pos;
+	self->pos += size;
+	return OBJECT_VAL(krk_newBytes(size, (unsigned char*)start));
+})
+
+KRK_METHOD(MemoryMap,write,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_OPEN();
+	CHECK_WRITABLE();
+	CHECK_ARG(1,bytes,KrkBytes*,data);
+	if (self->pos > self->length || self->length - self->pos < data->length) return krk_runtimeError(vm.exceptions->valueError, "data out of range");
+	memcpy(self->data + self->pos, data->bytes, data->length);
+	self->pos += data->length;
+	return INTEGER_VAL(data->length);
+})
+
+KRK_METHOD(MemoryMap,write_byte,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_OPEN();
+	CHECK_WRITABLE();
+	CHECK_ARG(1,int,krk_integer_type,byte);
+	if (byte < 0 || byte > 255) return krk_runtimeError(vm.exceptions->valueError, "mmap item value must be in range(0, 256)");
+	if (self->pos >= self->length) return krk_runtimeError(vm.exceptions->valueError, "write byte out of range");
+	self->data[self->pos++] = byte;
+})
+
+KRK_METHOD(MemoryMap,seek,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	CHECK_OPEN();
+	CHECK_ARG(1,int,krk_integer_type,pos);
+	krk_integer_type whence = 0;
+	if (argc > 2) {
+		CHECK_ARG(2,int,krk_integer_type,_whence);
+		whence = _whence;
+	}
+	switch (whence) {
+		case 0: break;
+		case 1: pos += self->pos; break;
+		case 2: pos += self->length; break;
+		default: return krk_runtimeError(vm.exceptions->valueError, "unknown seek type");
+	}
+	if (pos < 0 || pos > (krk_integer_type)self->length) return krk_runtimeError(vm.exceptions->valueError, "seek out of range");
+	self->pos = pos;
+	return INTEGER_VAL(pos);
+})
+
+KRK_METHOD(MemoryMap,tell,{
+	METHOD_TAKES_NONE();
+	CHECK_OPEN();
+	return INTEGER_VAL(self->pos);
+})
+
+/**
+ * Check that @p offset and @p size, as given to flush or madvise, cover part
+ * of the map, filling in @p size when it is None. The start has to be on a
+ * page boundary; mmap itself only ever hands back page-aligned maps.
+ */
+static int checkRegion(struct MemoryMap * self, krk_integer_type offset, KrkValue sizeArg, size_t * size) {
+	if (offset < 0 || offset > (krk_integer_type)self->length) {
+		krk_runtimeError(vm.exceptions->valueError, "offset out of range");
+		return 0;
+	}
+	if (offset % sysconf(_SC_PAGESIZE)) {
+		krk_runtimeError(vm.exceptions->valueError, "offset must be a multiple of PAGESIZE");
+		return 0;
+	}
+	*size = self->length - offset;
+	if (!IS_NONE(sizeArg)) {
+		if (!IS_INTEGER(sizeArg) || AS_INTEGER(sizeArg) < 0) {
+			krk_runtimeError(vm.exceptions->valueError, "size must be a non-negative integer");
+			return 0;
+		}
+		if ((size_t)AS_INTEGER(sizeArg) < *size) *size = AS_INTEGER(sizeArg);
+	}
+	return 1;
+}
+
+KRK_METHOD(MemoryMap,flush,{
+	METHOD_TAKES_AT_MOST(2);
+	CHECK_OPEN();
+	krk_integer_type offset = 0;
+	if (argc > 1) {
+		CHECK_ARG(1,int,krk_integer_type,_offset);
+		offset = _offset;
+	}
+	size_t size;
+	if (!checkRegion(self, offset, argc > 2 ? argv[2] : NONE_VAL(), &size)) return NONE_VAL();
+	if (self->access == ACCESS_READ || self->access == ACCESS_COPY || !size) return NONE_VAL();
+	krk_beginBlocking();
+	int result = msync(self->data + offset, size, MS_SYNC);
+	krk_endBlocking();
+	if (result < 0) return krk_runtimeError(vm.exceptions->ioError, "%s", strerror(errno));
+})
+
+KRK_METHOD(MemoryMap,madvise,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(3);
+	CHECK_OPEN();
+	CHECK_ARG(1,int,krk_integer_type,option);
+	krk_integer_type start = 0;
+	if (argc > 2) {
+		CHECK_ARG(2,int,krk_integer_type,_start);
+		start = _start;
+	}
+	size_t size;
+	if (!checkRegion(self, start, argc > 3 ? argv[3] : NONE_VAL(), &size)) return NONE_VAL();
+	if (size && madvise(self->data + start, size, option) < 0) return krk_runtimeError(vm.exceptions->ioError, "%s", strerror(errno));
+})
+
+KRK_METHOD(MemoryMap,close,{
+	METHOD_TAKES_NONE();
+	_mmap_gcsweep((KrkInstance*)self);
+})
+
+KRK_METHOD(MemoryMap,__enter__,{
+	METHOD_TAKES_NONE();
+	CHECK_OPEN();
+	return argv[0];
+})
+
+KRK_METHOD(MemoryMap,__exit__,{
+	_mmap_gcsweep((KrkInstance*)self);
+})
+
+FUNC_SIG(MemoryMapIterator,__init__);
+
+KRK_METHOD(MemoryMap,__iter__,{
+	METHOD_TAKES_NONE();
+	CHECK_OPEN();
+	KrkInstance * output = krk_newInstance(MemoryMapIteratorClass);
+	krk_push(OBJECT_VAL(output));
+	FUNC_NAME(MemoryMapIterator,__init__)(2,(KrkValue[]){krk_peek(0), argv[0]}, 0);
+	return krk_pop();
+})
+
+#undef CURRENT_CTYPE
+
+/**
+ * @brief Iterator over the bytes of a map.
+ * @extends KrkInstance
+ */
+struct MemoryMapIterator {
+	KrkInstance inst;
+	KrkValue map;
+	size_t i;
+};
+
+#define IS_MemoryMapIterator(o) (krk_isInstanceOf(o,MemoryMapIteratorClass))
+#define AS_MemoryMapIterator(o) ((struct MemoryMapIterator*)AS_OBJECT(o))
+#define CURRENT_CTYPE struct MemoryMapIterator *
+
+static void _mmapiterator_gcscan(KrkInstance * self) {
+	krk_markValue(((struct MemoryMapIterator*)self)->map);
+}
+
+KRK_METHOD(MemoryMapIterator,__init__,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,MemoryMap,struct MemoryMap*,source);
+	self->map = argv[1];
+	self->i = 0;
+	return argv[0];
+})
+
+KRK_METHOD(MemoryMapIterator,__call__,{
+	METHOD_TAKES_NONE();
+	struct MemoryMap * source = AS_MemoryMap(self->map);
+	if (!source->data || self->i >= source->length) return argv[0];
+	return INTEGER_VAL(source->data[self->i++]);
+})
+
+KrkValue krk_module_onload_mmap(void) {
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	krk_push(OBJECT_VAL(module));
+
+	KRK_DOC(module, "@brief Memory-mapped files.");
+
+	KrkClass * MemoryMap = krk_makeClass(module, &MemoryMapClass, "mmap", vm.baseClasses->objectClass);
+	KRK_DOC(MemoryMap,
+		"@brief Map @p length bytes of the file open as @p fileno into memory.\n"
+		"@arguments fileno,length,flags=MAP_SHARED,prot=PROT_READ|PROT_WRITE,access=ACCESS_DEFAULT,offset=0\n\n"
+		"A @p fileno of @c -1 maps anonymous memory. A @p length of @c 0 maps the rest of the file after @p offset, "
+		"which must be a multiple of @ref ALLOCATIONGRANULARITY. @p access may be @ref ACCESS_READ, @ref ACCESS_WRITE or "
+		"@ref ACCESS_COPY in place of @p flags and @p prot.\n\n"
+		"Maps are indexed, sliced and searched like @ref bytes, in place: only slices and reads make copies. "
+		"A @c memoryview of a map looks at the mapped bytes without copying them.");
+	MemoryMap->allocSize = sizeof(struct MemoryMap);
+	MemoryMap->_ongcsweep = _mmap_gcsweep;
+	MemoryMap->_ongetbuffer = _mmap_getbuffer;
+	BIND_METHOD(MemoryMap,__init__);
+	BIND_METHOD(MemoryMap,__len__);
+	BIND_METHOD(MemoryMap,__repr__);
+	BIND_METHOD(MemoryMap,__getitem__);
+	BIND_METHOD(MemoryMap,__setitem__);
+	BIND_METHOD(MemoryMap,__iter__);
+	BIND_METHOD(MemoryMap,__enter__);
+	BIND_METHOD(MemoryMap,__exit__);
+	BIND_PROP(MemoryMap,closed);
+	KRK_DOC(BIND_METHOD(MemoryMap,find),
+		"@brief Lowest index of @p sub between @p start and @p end, or @c -1.\n"
+		"@arguments sub,start=None,end=None\n\n"
+		"@p start defaults to the current position.");
+	KRK_DOC(BIND_METHOD(MemoryMap,rfind),
+		"@brief Highest index of @p sub between @p start and @p end, or @c -1.\n"
+		"@arguments sub,start=None,end=None");
+	KRK_DOC(BIND_METHOD(MemoryMap,read),
+		"@brief Read up to @p n bytes from the current position, or everything after it.\n"
+		"@arguments n=None");
+	KRK_DOC(BIND_METHOD(MemoryMap,read_byte),
+		"@brief Read one byte from the current position, as an @ref int.");
+	KRK_DOC(BIND_METHOD(MemoryMap,readline),
+		"@brief Read from the current position up to and including the next newline.");
+	KRK_DOC(BIND_METHOD(MemoryMap,write),
+		"@brief Write @p data at the current position.\n"
+		"@arguments data");
+	KRK_DOC(BIND_METHOD(MemoryMap,write_byte),
+		"@brief Write one byte at the current position.\n"
+		"@arguments byte");
+	KRK_DOC(BIND_METHOD(MemoryMap,seek),
+		"@brief Move the current position.\n"
+		"@arguments pos,whence=0\n\n"
+		"@p whence is @c 0 to seek from the start, @c 1 from the current position, or @c 2 from the end.");
+	KRK_DOC(BIND_METHOD(MemoryMap,tell),
+		"@brief The current position.");
+	KRK_DOC(BIND_METHOD(MemoryMap,flush),
+		"@brief Write changes to @p size bytes from @p offset back to the file.\n"
+		"@arguments offset=0,size=None");
+	KRK_DOC(BIND_METHOD(MemoryMap,madvise),
+		"@brief Tell the system how @p length bytes from @p start will be used.\n"
+		"@arguments option,start=0,length=None\n\n"
+		"@p option is one of the @c MADV_ constants.");
+	KRK_DOC(BIND_METHOD(MemoryMap,close),
+		"@brief Unmap the memory. Further use of the map raises @ref ValueError.");
+	krk_defineNative(&MemoryMap->methods, "__str__", FUNC_NAME(MemoryMap,__repr__));
+	krk_attachNamedValue(&MemoryMap->methods, "__hash__", NONE_VAL());
+	krk_finalizeClass(MemoryMap);
+
+	KrkClass * MemoryMapIterator = krk_makeClass(module, &MemoryMapIteratorClass, "mmapiterator", vm.baseClasses->objectClass);
+	MemoryMapIterator->allocSize = sizeof(struct MemoryMapIterator);
+	MemoryMapIterator->_ongcscan = _mmapiterator_gcscan;
+	BIND_METHOD(MemoryMapIterator,__init__);
+	BIND_METHOD(MemoryMapIterator,__call__);
+	krk_finalizeClass(MemoryMapIterator);
+
+	krk_attachNamedObject(&module->fields, "error", (KrkObj*)vm.exceptions->ioError);
+
+#define CONSTANT(name) krk_attachNamedValue(&module->fields, #name, INTEGER_VAL(name))
+	CONSTANT(ACCESS_DEFAULT);
+	CONSTANT(ACCESS_READ);
+	CONSTANT(ACCESS_WRITE);
+	CONSTANT(ACCESS_COPY);
+	CONSTANT(MAP_SHARED);
+	CONSTANT(MAP_PRIVATE);
+	CONSTANT(MAP_ANONYMOUS);
+	CONSTANT(PROT_READ);
+	CONSTANT(PROT_WRITE);
+	CONSTANT(PROT_EXEC);
+	CONSTANT(MADV_NORMAL);
+	CONSTANT(MADV_RANDOM);
+	CONSTANT(MADV_SEQUENTIAL);
+	CONSTANT(MADV_WILLNEED);
+	CONSTANT(MADV_DONTNEED);
+#ifdef MADV_FREE
+	CONSTANT(MADV_FREE);
+#endif
+#ifdef MADV_HUGEPAGE
+	CONSTANT(MADV_HUGEPAGE);
+	CONSTANT(MADV_NOHUGEPAGE);
+#endif
+#undef CONSTANT
+	krk_attachNamedValue(&module->fields, "PAGESIZE", INTEGER_VAL(sysconf(_SC_PAGESIZE)));
+	krk_attachNamedValue(&module->fields, "ALLOCATIONGRANULARITY", INTEGER_VAL(sysconf(_SC_PAGESIZE)));
+
+	return krk_pop();
+}
@@ -0,0 +1,530 @@
+/**
+ * @file    module_select.c
+ * @brief   Waiting for file descriptors to become ready.
+ *
+ * @c select() is built on poll(), so it has no limit on descriptor numbers.
+ * A @c poll object keeps its own array of descriptors to hand to poll() on
+ * each call, and an @c epoll object wraps an epoll instance on Linux, where
+ * the kernel keeps the set and each wait only costs as much as what became
+ * ready. Each of them releases the VM while waiting, so other threads keep
+ * running.
+ *
+ * Anything with a @c fileno() method can be used in place of a descriptor.
+ */
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+
+#ifdef __linux__
+# define HAS_EPOLL
+# include <sys/epoll.h>
+#endif
+
+#include <kuroko/vm.h>
+#include <kuroko/memory.h>
+#include <kuroko/util.h>
+
+static KrkVMLocal pollKey;
+#define PollClass KRK_VM_LOCAL(KrkClass*,pollKey)
+#ifdef HAS_EPOLL
+static KrkVMLocal epollKey;
+#define EpollClass KRK_VM_LOCAL(KrkClass*,epollKey)
+#endif
+
+/**
+ * @brief Descriptors registered with a poll object.
+ * @extends KrkInstance
+ */
+struct Poll {
+	KrkInstance inst;
+	struct pollfd * fds;
+	size_t count;
+	size_t capacity;
+};
+
+#define IS_Poll(o) (krk_isInstanceOf(o,PollClass))
+#define AS_Poll(o) ((struct Poll*)AS_OBJECT(o))
+#define CURRENT_CTYPE struct Poll *
+#define CURRENT_NAME  self
+
+/** Raise @c select.error for @c errno */
+static KrkValue selectError(void) {
+	return krk_runtimeError(vm.exceptions->ioError, "%s", strerror(errno));
+}
+
+/**
+ * Get the descriptor for @p value, which is an integer or has a @c fileno()
+ * method that returns one. Returns 0 with an exception raised if it has neither.
+ */
+static int fileDescriptor(KrkValue value, int * fd) {
+	if (!IS_INTEGER(value)) {
+		KrkValue method = krk_valueGetAttribute_default(value, "fileno", NONE_VAL());
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return 0;
+		if (IS_NONE(method)) {
+			krk_runtimeError(vm.exceptions->typeError, "argument must be an int, or have a fileno() method, not '%s'", krk_typeName(value));
+			return 0;
+		}
+		krk_push(method);
+		value = krk_callStack(0);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return 0;
+		if (!IS_INTEGER(value)) {
+			krk_runtimeError(vm.exceptions->typeError, "fileno() returned '%s', not 'int'", krk_typeName(value));
+			return 0;
+		}
+	}
+	if (AS_INTEGER(value) < 0) {
+		krk_runtimeError(vm.exceptions->valueError, "file descriptor cannot be a negative integer (%d)", (int)AS_INTEGER(value));
+		return 0;
+	}
+	*fd = AS_INTEGER(value);
+	return 1;
+}
+
+/**
+ * Convert a timeout in @p scale units per second, or None for no limit, to
+ * the milliseconds waited for by poll(), rounding up so that short waits
+ * don't become busy loops.
+ */
+static int timeoutMilliseconds(KrkValue timeout, double scale, int * ms) {
+	if (IS_NONE(timeout)) {
+		*ms = -1;
+		return 1;
+	}
+	double value;
+	if (IS_INTEGER(timeout)) value = AS_INTEGER(timeout);
+	else if (IS_FLOATING(timeout)) value = AS_FLOATING(timeout);
+	else {
+		krk_runtimeError(vm.exceptions->typeError, "timeout must be a number or None, not '%s'", krk_typeName(timeout));
+		return 0;
+	}
+	if (value < 0) {
+		*ms = -1;
+		return 1;
+	}
+	value = value * scale;
+	*ms = value > 2147483647.0 ? 2147483647 : (int)value + (value > (int)value);
+	return 1;
+}
+
+/** Wait in poll() with the VM released; @p fds must not be in a managed object. */
+static int waitFor(struct pollfd * fds, size_t count, int ms) {
+	int result;
+	do {
+		krk_beginBlocking();
+		result = poll(fds, count, ms);
+		int error = errno;
+		krk_endBlocking();
+		errno = error;
+	} while (result < 0 && errno == EINTR && !(krk_currentThread.flags & KRK_THREAD_SIGNALLED));
+	return result;
+}
+
+/** The values in the list or tuple @p value, or NULL with TypeError raised. */
+static KrkValueArray * sequenceValues(KrkValue value) {
+	if (IS_list(value)) return AS_LIST(value);
+	if (IS_TUPLE(value)) return &AS_TUPLE(value)->values;
+	krk_runtimeError(vm.exceptions->typeError, "arguments 1-3 must be lists or tuples, not '%s'", krk_typeName(value));
+	return NULL;
+}
+
+KRK_FUNC(select,{
+	FUNCTION_TAKES_AT_LEAST(3);
+	FUNCTION_TAKES_AT_MOST(4);
+
+	int ms = -1;
+	if (argc > 3) {
+		if (!timeoutMilliseconds(argv[3], 1000.0, &ms)) return NONE_VAL();
+		if (!IS_NONE(argv[3]) && ms < 0) return krk_runtimeError(vm.exceptions->valueError, "timeout must be non-negative");
+	}
+
+	/* Copy the three sequences, as fileno() may run code that changes them. */
+	size_t counts[3];
+	for (int i = 0; i < 3; ++i) {
+		KrkValueArray * values = sequenceValues(argv[i]);
+		if (!values) {
+			krk_currentThread.stackTop -= i;
+			return NONE_VAL();
+		}
+		krk_push(krk_list_of(values->count, values->values, 0));
+		counts[i] = values->count;
+	}
+
+	size_t total = counts[0] + counts[1] + counts[2];
+	struct pollfd * fds = calloc(total ? total : 1, sizeof(struct pollfd));
+	static const short wanted[3] = {POLLIN, POLLOUT, POLLPRI};
+	size_t n = 0;
+	for (int i = 0; i < 3; ++i) {
+		KrkValueArray * values = AS_LIST(krk_peek(2 - i));
+		for (size_t j = 0; j < counts[i]; ++j, ++n) {
+			if (!fileDescriptor(values->values[j], &fds[n].fd)) {
+				free(fds);
+				krk_currentThread.stackTop -= 3;
+				return NONE_VAL();
+			}
+			fds[n].events = wanted[i];
+		}
+	}
+
+	int result = waitFor(fds, total, ms);
+	if (result < 0) {
+		free(fds);
+		krk_currentThread.stackTop -= 3;
+		if (errno == EINTR) return NONE_VAL();
+		return selectError();
+	}
+
+	/* Errors and hangups are reported as ready, so the next operation sees them. */
+	static const short ready[3] = {POLLIN | POLLHUP | POLLERR, POLLOUT | POLLERR, POLLPRI};
+	KrkTuple * out = krk_newTuple(3);
+	krk_push(OBJECT_VAL(out));
+	n = 0;
+	for (int i = 0; i < 3; ++i) {
+		out->values.values[out->values.count++] = krk_list_of(0,NULL,0);
+		KrkValueArray * values = AS_LIST(krk_peek(3 - i));
+		for (size_t j = 0; j < counts[i]; ++j, ++n) {
+			if (fds[n].revents & (ready[i] | POLLNVAL)) {
+				krk_writeValueArray(AS_LIST(out->values.values[i]), values->values[j]);
+			}
+		}
+	}
+	krk_gcWriteBarrier((KrkObj*)out);
+	free(fds);
+	krk_currentThread.stackTop -= 4;
+	return OBJECT_VAL(out);
+})
+
+static void _poll_gcsweep(KrkInstance * self) {
+	free(((struct Poll*)self)->fds);
+}
+
+KRK_METHOD(Poll,__init__,{
+	METHOD_TAKES_NONE();
+	return argv[0];
+})
+
+/** Index of @p fd in the poll object, or -1 */
+static ssize_t findDescriptor(struct Poll * self, int fd) {
+	for (size_t i = 0; i < self->count; ++i) {
+		if (self->fds[i].fd == fd) return i;
+	}
+	return -1;
+}
+
+KRK_METHOD(Poll,register,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	int fd;
+	if (!fileDescriptor(argv[1], &fd)) return NONE_VAL();
+	short events = POLLIN | POLLPRI | POLLOUT;
+	if (argc > 2) {
+		CHECK_ARG(2,int,krk_integer_type,eventmask);
+		events = eventmask;
+	}
+	ssize_t i = findDescriptor(self, fd);
+	if (i < 0) {
+		if (self->count == self->capacity) {
+			self->capacity = GROW_CAPACITY(self->capacity);
+			self->fds = realloc(self->fds, sizeof(struct pollfd) * self->capacity);
+		}
+		i = self->count++;
+		self->fds[i].fd = fd;
+	}
+	self->fds[i].events = events;
+	self->fds[i].revents = 0;
+})
+
+KRK_METHOD(Poll,modify,{
+	METHOD_TAKES_EXACTLY(2);
+	int fd;
+	if (!fileDescriptor(argv[1], &fd)) return NONE_VAL();
+	CHECK_ARG(2,int,krk_integer_type,eventmask);
+	ssize_t i = findDescriptor(self, fd);
+	if (i < 0) {
+		errno = ENOENT;
+		return selectError();
+	}
+	self->fds[i].events = eventmask;
+})
+
+KRK_METHOD(Poll,unregister,{
+	METHOD_TAKES_EXACTLY(1);
+	int fd;
+	if (!fileDescriptor(argv[1], &fd)) return NONE_VAL();
+	ssize_t i = findDescriptor(self, fd);
+	if (i < 0) return krk_runtimeError(vm.exceptions->keyError, "%d", fd);
+	self->fds[i] = self->fds[--self->count];
+})
+
+KRK_METHOD(Poll,poll,{
+	METHOD_TAKES_AT_MOST(1);
+	int ms = -1;
+	if (argc > 1 && !timeoutMilliseconds(argv[1], 1.0, &ms)) return NONE_VAL();
+
+	/* Another thread may register descriptors while this one waits, so wait on a copy. */
+	size_t count = self->count;
+	struct pollfd * fds = malloc(sizeof(struct pollfd) * (count ? count : 1));
+	if (count) memcpy(fds, self->fds, sizeof(struct pollfd) * count);
+
+	int result = waitFor(fds, count, ms);
+	if (result < 0) {
+		free(fds);
+		if (errno == EINTR) return NONE_VAL();
+		return selectError();
+	}
+
+	KrkValue list = krk_list_of(0,NULL,0);
+	krk_push(list);
+	for (size_t i = 0; i < count && result; ++i) {
+		if (!fds[i].revents) continue;
+		result--;
+		KrkTuple * item = krk_newTuple(2);
+		krk_push(OBJECT_VAL(item));
+		item->values.values[item->values.count++] = INTEGER_VAL(fds[i].fd);
+		item->values.values[item->values.count++] = INTEGER_VAL(fds[i].revents);
+		krk_writeValueArray(AS_LIST(list), krk_peek(0));
+		krk_pop();
+	}
+	free(fds);
+	return krk_pop();
+})
+
+#ifdef HAS_EPOLL
+/**
+ * @brief An epoll instance.
+ * @extends KrkInstance
+ */
+struct Epoll {
+	KrkInstance inst;
+	int epfd;
+};
+
+#define IS_Epoll(o) (krk_isInstanceOf(o,EpollClass))
+#define AS_Epoll(o) ((struct Epoll*)AS_OBJECT(o))
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct Epoll *
+
+static void _epoll_gcsweep(KrkInstance * self) {
+	struct Epoll * me = (struct Epoll*)self;
+	if (me->epfd >= 0) close(me->epfd);
+}
+
+#define CHECK_OPEN() do { if (self->epfd < 0) return krk_runtimeError(vm.exceptions->valueError, "I/O operation on closed epoll object"); } while (0)
+
+KRK_METHOD(Epoll,__init__,{
+	METHOD_TAKES_AT_MOST(2);
+	self->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (self->epfd < 0) return selectError();
+	return argv[0];
+})
+
+/** Add, change or remove the events watched for on a descriptor */
+static KrkValue control(struct Epoll * self, int op, KrkValue file, unsigned int events) {
+	int fd;
+	if (!fileDescriptor(file, &fd)) return NONE_VAL();
+	struct epoll_event event = {0};
+	event.events = events;
+	event.data.fd = fd;
+	if (epoll_ctl(self->epfd, op, fd, &event) < 0) return selectError();
+	return NONE_VAL();
+}
+
+KRK_METHOD(Epoll,register,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	CHECK_OPEN();
+	unsigned int events = EPOLLIN | EPOLLPRI | EPOLLOUT;
+	if (argc > 2) {
+		CHECK_ARG(2,int,krk_integer_type,eventmask);
+		events = eventmask;
+	}
+	return control(self, EPOLL_CTL_ADD, argv[1], events);
+})
+
+KRK_METHOD(Epoll,modify,{
+	METHOD_TAKES_EXACTLY(2);
+	CHECK_OPEN();
+	CHECK_ARG(2,int,krk_integer_type,eventmask);
+	return control(self, EPOLL_CTL_MOD, argv[1], eventmask);
+})
+
+KRK_METHOD(Epoll,unregister,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_OPEN();
+	return control(self, EPOLL_CTL_DEL, argv[1], 0);
+})
+
+/** Events waited for at once when @c maxevents isn't given. */
+#define EPOLL_EVENTS 1024
+
+KRK_METHOD(Epoll,poll,{
+	METHOD_TAKES_AT_MOST(2);
+	CHECK_OPEN();
+	int ms = -1;
+	if (argc > 1 && !timeoutMilliseconds(argv[1], 1000.0, &ms)) return NONE_VAL();
+	int maxevents = EPOLL_EVENTS;
+	if (argc > 2) {
+		CHECK_ARG(2,int,krk_integer_type,_maxevents);
+		if (_maxevents == 0 || _maxevents < -1) return krk_runtimeError(vm.exceptions->valueError, "maxevents must be greater than 0, got %d", (int)_maxevents);
+		if (_maxevents > 0) maxevents = _maxevents;
+	}
+
+	struct epoll_event * events = malloc(sizeof(struct epoll_event) * maxevents);
+	int epfd = self->epfd;
+	int result;
+	do {
+		krk_beginBlocking();
+		result = epoll_wait(epfd, events, maxevents, ms);
+		int error = errno;
+		krk_endBlocking();
+		errno = error;
+	} while (result < 0 && errno == EINTR && !(krk_currentThread.flags & KRK_THREAD_SIGNALLED));
+
+	if (result < 0) {
+		free(events);
+		if (errno == EINTR) return NONE_VAL();
+		return selectError();
+	}
+
+	KrkValue list = krk_list_of(0,NULL,0);
+	krk_push(list);
+	for (int i = 0; i < result; ++i) {
+		KrkTuple * item = krk_newTuple(2);
+		krk_push(OBJECT_VAL(item));
+		item->values.values[item->values.count++] = INTEGER_VAL(events[i].data.fd);
+		item->values.values[item->values.count++] = INTEGER_VAL(events[i].events);
+		krk_writeValueArray(AS_LIST(list), krk_peek(0));
+		krk_pop();
+	}
+	free(events);
+	return krk_pop();
+})
+
+KRK_METHOD(Epoll,fileno,{
+	METHOD_TAKES_NONE();
+	CHECK_OPEN();
+	return INTEGER_VAL(self->epfd);
+})
+
+KRK_METHOD(Epoll,close,{
+	METHOD_TAKES_NONE();
+	if (self->epfd >= 0) close(self->epfd);
+	self->epfd = -1;
+})
+
+KRK_METHOD(Epoll,closed,{
+	return BOOLEAN_VAL(self->epfd < 0);
+})
+
+KRK_METHOD(Epoll,__enter__,{
+	METHOD_TAKES_NONE();
+	CHECK_OPEN();
+	return argv[0];
+})
+
+KRK_METHOD(Epoll,__exit__,{
+	if (self->epfd >= 0) close(self->epfd);
+	self->epfd = -1;
+})
+#endif
+
+KrkValue krk_module_onload_select(void) {
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	krk_push(OBJECT_VAL(module));
+
+	KRK_DOC(module, "@brief Waiting for file descriptors to become ready.");
+
+	KRK_DOC(BIND_FUNC(module,select),
+		"@brief Wait until some of the given files are ready.\n"
+		"@arguments rlist,wlist,xlist,timeout=None\n\n"
+		"Each list holds descriptors, or objects with a @c fileno() method, to wait on: to be read from, "
+		"to be written to, or for an exceptional condition such as out-of-band data. Waits for up to "
+		"@p timeout seconds, or forever if it is @c None, and returns a three-tuple of lists of the "
+		"items that are ready.");
+
+	KrkClass * Poll = krk_makeClass(module, &PollClass, "poll", vm.baseClasses->objectClass);
+	KRK_DOC(Poll,
+		"@brief A set of descriptors to wait on together.\n\n"
+		"Unlike @ref select, the set is kept between waits.");
+	Poll->allocSize = sizeof(struct Poll);
+	Poll->_ongcsweep = _poll_gcsweep;
+	BIND_METHOD(Poll,__init__);
+	KRK_DOC(BIND_METHOD(Poll,register),
+		"@brief Wait for @p eventmask on @p fd, replacing any events it already had.\n"
+		"@arguments fd,eventmask=POLLIN|POLLPRI|POLLOUT");
+	KRK_DOC(BIND_METHOD(Poll,modify),
+		"@brief Change the events waited for on @p fd, which must be registered.\n"
+		"@arguments fd,eventmask");
+	KRK_DOC(BIND_METHOD(Poll,unregister),
+		"@brief Stop waiting on @p fd. Raises @ref KeyError if it wasn't registered.\n"
+		"@arguments fd");
+	KRK_DOC(BIND_METHOD(Poll,poll),
+		"@brief Wait for registered descriptors to be ready.\n"
+		"@arguments timeout=None\n\n"
+		"Waits for up to @p timeout milliseconds, or forever if it is @c None or negative, and returns "
+		"a list of @c (fd,events) two-tuples for those with events to report.");
+	krk_finalizeClass(Poll);
+
+#ifdef HAS_EPOLL
+	KrkClass * Epoll = krk_makeClass(module, &EpollClass, "epoll", vm.baseClasses->objectClass);
+	KRK_DOC(Epoll,
+		"@brief An epoll instance, for waiting on many descriptors cheaply.\n"
+		"@arguments sizehint=-1,flags=0\n\n"
+		"Both arguments are accepted for compatibility and ignored. The instance is closed with "
+		"@ref epoll_close, on leaving a @c with block, or when it is collected.");
+	Epoll->allocSize = sizeof(struct Epoll);
+	Epoll->_ongcsweep = _epoll_gcsweep;
+	BIND_METHOD(Epoll,__init__);
+	KRK_DOC(BIND_METHOD(Epoll,register),
+		"@brief Start waiting for @p eventmask on @p fd.\n"
+		"@arguments fd,eventmask=EPOLLIN|EPOLLPRI|EPOLLOUT");
+	KRK_DOC(BIND_METHOD(Epoll,modify),
+		"@brief Change the events waited for on a registered @p fd.\n"
+		"@arguments fd,eventmask");
+	KRK_DOC(BIND_METHOD(Epoll,unregister),
+		"@brief Stop waiting on @p fd.\n"
+		"@arguments fd");
+	KRK_DOC(BIND_METHOD(Epoll,poll),
+		"@brief Wait for registered descriptors to be ready.\n"
+		"@arguments timeout=None,maxevents=-1\n\n"
+		"Waits for up to @p timeout seconds, or forever if it is @c None or negative, and returns "
+		"a list of at most @p maxevents @c (fd,events) two-tuples.");
+	KRK_DOC(BIND_METHOD(Epoll,fileno),
+		"@brief The descriptor of the epoll instance.");
+	KRK_DOC(BIND_METHOD(Epoll,close),
+		"@brief Close the epoll instance.");
+	BIND_PROP(Epoll,closed);
+	BIND_METHOD(Epoll,__enter__);
+	BIND_METHOD(Epoll,__exit__);
+	krk_finalizeClass(Epoll);
+#endif
+
+	krk_attachNamedObject(&module->fields, "error", (KrkObj*)vm.exceptions->ioError);
+
+#define SELECT_CONST(o) krk_attachNamedValue(&module->fields, #o, INTEGER_VAL(o));
+	SELECT_CONST(POLLIN);
+	SELECT_CONST(POLLPRI);
+	SELECT_CONST(POLLOUT);
+	SELECT_CONST(POLLERR);
+	SELECT_CONST(POLLHUP);
+	SELECT_CONST(POLLNVAL);
+#ifdef POLLRDHUP
+	SELECT_CONST(POLLRDHUP);
+#endif
+#ifdef HAS_EPOLL
+	SELECT_CONST(EPOLLIN);
+	SELECT_CONST(EPOLLPRI);
+	SELECT_CONST(EPOLLOUT);
+	SELECT_CONST(EPOLLERR);
+	SELECT_CONST(EPOLLHUP);
+	SELECT_CONST(EPOLLRDHUP);
+	SELECT_CONST(EPOLLET);
+	SELECT_CONST(EPOLLONESHOT);
+#ifdef EPOLLEXCLUSIVE
+	SELECT_CONST(EPOLLEXCLUSIVE);
+#endif
+#endif
+
+	return krk_pop();
+}
@@ -9,18 +9,29 @@
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#define poll WSAPoll
 #else
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 #endif
 #include <errno.h>
 
 #include <kuroko/vm.h>
 #include <kuroko/util.h>
 
-static KrkClass * SocketError = NULL;
-static KrkClass * SocketClass = NULL;
+static KrkVMLocal socketErrorKey;
+#define SocketError KRK_VM_LOCAL(KrkClass*,socketErrorKey)
+static KrkVMLocal blockingIOErrorKey;
+#define BlockingIOError KRK_VM_LOCAL(KrkClass*,blockingIOErrorKey)
+static KrkVMLocal socketTimeoutKey;
+#define SocketTimeout KRK_VM_LOCAL(KrkClass*,socketTimeoutKey)
+static KrkVMLocal socketClassKey;
+#define SocketClass KRK_VM_LOCAL(KrkClass*,socketClassKey)
 
 struct socket {
 	KrkInstance inst;
@@ -29,6 +40,7 @@ struct socket {
 	int family;
 	int type;
 	int proto;
+	double timeout; /**< Seconds to wait for the socket to be ready; negative to wait as long as it takes */
 };
 
 #define IS_socket(o) (krk_isInstanceOf(o,SocketClass))
@@ -68,10 +80,75 @@ KRK_METHOD(socket,__init__,{
 	self->family = family;
 	self->type   = type;
 	self->proto  = proto;
+	self->timeout = -1;
 
 	return argv[0];
 })
 
+/**
+ * Raise SocketError for @c errno, or BlockingIOError if a non-blocking
+ * socket would have had to wait.
+ */
+static KrkValue socketError(void) {
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS) {
+		return krk_runtimeError(BlockingIOError, "Socket error: %s", strerror(errno));
+	}
+	return krk_runtimeError(SocketError, "Socket error: %s", strerror(errno));
+}
+
+/**
+ * Wait for a socket with a timeout to be ready for @p events before an
+ * operation is tried on it. Sockets without a timeout are left to block, or
+ * not, in the operation itself. Returns 0 with @c timeout raised if the socket
+ * was not ready in time.
+ */
+static int waitReady(struct socket * self, short events) {
+	if (self->timeout <= 0) return 1;
+	struct pollfd fds = {self->sockfd, events, 0};
+	krk_beginBlocking();
+	int result = poll(&fds, 1, (int)(self->timeout * 1000.0 + 0.999));
+	int error = errno;
+	krk_endBlocking();
+	if (result == 0) {
+		krk_runtimeError(SocketTimeout, "timed out");
+		return 0;
+	} else if (result < 0) {
+		errno = error;
+		socketError();
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Run @p call, which sets @p result, once the socket is ready for @p events.
+ * A socket with a timeout is non-blocking underneath, so if another reader
+ * got there first the wait is repeated.
+ */
+#define WHEN_READY(events, result, call) do { \
+	if (!waitReady(self, events)) return NONE_VAL(); \
+	krk_beginBlocking(); \
+	result = call; \
+	int _error = errno; \
+	krk_endBlocking(); \
+	errno = _error; \
+} while (result < 0 && self->timeout > 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+
+/**
+ * Make the Kuroko form of an address: for @c AF_INET, a two-tuple of the
+ * numeric address and the port; None for other families.
+ */
+static KrkValue makeAddress(struct sockaddr_storage * addr, socklen_t addrlen) {
+	if (!addrlen || addr->ss_family != AF_INET) return NONE_VAL();
+	char hostname[NI_MAXHOST] = "";
+	getnameinfo((struct sockaddr*)addr, addrlen, hostname, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
+	KrkTuple * out = krk_newTuple(2);
+	krk_push(OBJECT_VAL(out));
+	out->values.values[out->values.count++] = OBJECT_VAL(krk_copyString(hostname,strlen(hostname)));
+	out->values.values[out->values.count++] = INTEGER_VAL(ntohs(((struct sockaddr_in*)addr)->sin_port));
+	return krk_pop();
+}
+
 static char * _af_name(int afval) {
 	static char tmp[30];
 	switch (afval) {
@@ -193,10 +270,23 @@ KRK_METHOD(socket,connect,{
 		return NONE_VAL();
 	}
 
+	krk_beginBlocking();
 	int result = connect(self->sockfd, (struct sockaddr*)&sock_addr, sock_size);
+	int error = errno;
+	krk_endBlocking();
+	errno = error;
+
+	if (result < 0 && self->timeout > 0 && (errno == EINPROGRESS || errno == EWOULDBLOCK)) {
+		/* Connecting finishes when the socket becomes writable; SO_ERROR says how it went. */
+		if (!waitReady(self, POLLOUT)) return NONE_VAL();
+		socklen_t len = sizeof(error);
+		if (getsockopt(self->sockfd, SOL_SOCKET, SO_ERROR, (void*)&error, &len) < 0) return socketError();
+		if (!error) return NONE_VAL();
+		errno = error;
+	}
 
 	if (result < 0) {
-		return krk_runtimeError(SocketError, "Socket error: %s", strerror(errno));
+		return socketError();
 	}
 })
 
@@ -237,12 +327,13 @@ KRK_METHOD(socket,listen,{
 
 KRK_METHOD(socket,accept,{
 	struct sockaddr_storage addr;
-	socklen_t addrlen;
+	socklen_t addrlen = sizeof(addr);
 
-	int result = accept(self->sockfd, (struct sockaddr*)&addr, &addrlen);
+	int result;
+	WHEN_READY(POLLIN, result, accept(self->sockfd, (struct sockaddr*)&addr, &addrlen));
 
 	if (result < 0) {
-		return krk_runtimeError(SocketError, "Socket error: %s", strerror(errno));
+		return socketError();
 	}
 
 	KrkTuple * outTuple = krk_newTuple(2);
@@ -255,29 +346,16 @@ KRK_METHOD(socket,accept,{
 	out->family = self->family;
 	out->type   = self->type;
 	out->proto  = self->proto;
+	out->timeout = -1;
 
 	outTuple->values.values[0] = krk_peek(0);
 	outTuple->values.count = 1;
+	krk_gcWriteBarrier((KrkObj*)outTuple);
 	krk_pop();
 
-	KrkTuple * addrTuple = krk_newTuple(2); /* TODO: Other formats */
-	krk_push(OBJECT_VAL(addrTuple));
-
-	if (self->family == AF_INET) {
-		char hostname[NI_MAXHOST] = "";
-		getnameinfo((struct sockaddr*)&addr, addrlen, hostname, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
-
-		addrTuple->values.values[0] = OBJECT_VAL(krk_copyString(hostname,strlen(hostname)));
-		addrTuple->values.count = 1;
-		addrTuple->values.values[1] = INTEGER_VAL(htons(((struct sockaddr_in*)&addr)->sin_port));
-		addrTuple->values.count = 2;
-	} else {
-		krk_push(NONE_VAL());
-	}
-
-	outTuple->values.values[1] = krk_peek(0);
+	outTuple->values.values[1] = makeAddress(&addr, addrlen);
 	outTuple->values.count = 2;
-	krk_pop();
+	krk_gcWriteBarrier((KrkObj*)outTuple);
 
 	return krk_pop();
 })
@@ -304,10 +382,11 @@ KRK_METHOD(socket,recv,{
 	}
 
 	void * buf = malloc(bufsize);
-	ssize_t result = recv(self->sockfd, buf, bufsize, flags);
+	ssize_t result;
+	WHEN_READY(POLLIN, result, recv(self->sockfd, buf, bufsize, flags));
 	if (result < 0) {
 		free(buf);
-		return krk_runtimeError(SocketError, "Socket error: %s", strerror(errno));
+		return socketError();
 	}
 
 	KrkBytes * out = krk_newBytes(result,buf);
@@ -315,28 +394,81 @@ KRK_METHOD(socket,recv,{
 	return OBJECT_VAL(out);
 })
 
+KRK_METHOD(socket,recv_into,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(3);
+	KrkBuffer buffer;
+	if (!krk_getBuffer(argv[1], &buffer, 1)) return NONE_VAL();
+	size_t nbytes = buffer.length;
+	if (argc > 2) {
+		CHECK_ARG(2,int,krk_integer_type,_nbytes);
+		if (_nbytes < 0) return krk_runtimeError(vm.exceptions->valueError, "negative buffersize in recv_into");
+		if (_nbytes > 0 && (size_t)_nbytes < nbytes) nbytes = _nbytes;
+	}
+	int flags = 0;
+	if (argc > 3) {
+		CHECK_ARG(3,int,krk_integer_type,_flags);
+		flags = _flags;
+	}
+
+	ssize_t result;
+	WHEN_READY(POLLIN, result, recv(self->sockfd, (void*)buffer.bytes, nbytes, flags));
+	if (result < 0) {
+		return socketError();
+	}
+
+	return INTEGER_VAL(result);
+})
+
 KRK_METHOD(socket,send,{
 	METHOD_TAKES_AT_LEAST(1);
 	METHOD_TAKES_AT_MOST(2);
-	CHECK_ARG(1,bytes,KrkBytes*,buf);
+	KrkBuffer buf;
+	if (!krk_getBuffer(argv[1], &buf, 0)) return NONE_VAL();
 	int flags = 0;
 	if (argc > 2) {
 		CHECK_ARG(2,int,krk_integer_type,_flags);
 		flags = _flags;
 	}
 
-	ssize_t result = send(self->sockfd, (void*)buf->bytes, buf->length, flags);
+	ssize_t result;
+	WHEN_READY(POLLOUT, result, send(self->sockfd, (void*)buf.bytes, buf.length, flags));
 	if (result < 0) {
-		return krk_runtimeError(SocketError, "Socket error: %s", strerror(errno));
+		return socketError();
 	}
 
 	return INTEGER_VAL(result);
 })
 
+KRK_METHOD(socket,sendall,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	KrkBuffer buf;
+	if (!krk_getBuffer(argv[1], &buf, 0)) return NONE_VAL();
+	int flags = 0;
+	if (argc > 2) {
+		CHECK_ARG(2,int,krk_integer_type,_flags);
+		flags = _flags;
+	}
+
+	/* Nothing in here runs managed code, so the buffer stays where it is. */
+	size_t sent = 0;
+	while (sent < buf.length) {
+		ssize_t result;
+		WHEN_READY(POLLOUT, result, send(self->sockfd, (void*)(buf.bytes + sent), buf.length - sent, flags));
+		if (result < 0) {
+			if (errno == EINTR && !(krk_currentThread.flags & KRK_THREAD_SIGNALLED)) continue;
+			return socketError();
+		}
+		sent += result;
+	}
+})
+
 KRK_METHOD(socket,sendto,{
 	METHOD_TAKES_AT_LEAST(1);
 	METHOD_TAKES_AT_MOST(3);
-	CHECK_ARG(1,bytes,KrkBytes*,buf);
+	KrkBuffer buf;
+	if (!krk_getBuffer(argv[1], &buf, 0)) return NONE_VAL();
 	int flags = 0;
 	if (argc > 3) {
 		CHECK_ARG(2,int,krk_integer_type,_flags);
@@ -354,9 +486,10 @@ KRK_METHOD(socket,sendto,{
 		return NONE_VAL();
 	}
 
-	ssize_t result = sendto(self->sockfd, (void*)buf->bytes, buf->length, flags, (struct sockaddr*)&sock_addr, sock_size);
+	ssize_t result;
+	WHEN_READY(POLLOUT, result, sendto(self->sockfd, (void*)buf.bytes, buf.length, flags, (struct sockaddr*)&sock_addr, sock_size));
 	if (result < 0) {
-		return krk_runtimeError(SocketError, "Socket error: %s", strerror(errno));
+		return socketError();
 	}
 
 	return INTEGER_VAL(result);
@@ -367,6 +500,99 @@ KRK_METHOD(socket,fileno,{
 	return INTEGER_VAL(self->sockfd);
 })
 
+#ifdef _WIN32
+static int setBlocking(int fd, int blocking) {
+	u_long mode = !blocking;
+	return ioctlsocket(fd, FIONBIO, &mode) == 0 ? 0 : -1;
+}
+#define closeSocket closesocket
+#else
+static int setBlocking(int fd, int blocking) {
+	int flags = fcntl(fd, F_GETFL);
+	if (flags == -1) return -1;
+	return fcntl(fd, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+}
+#define closeSocket close
+
+KRK_METHOD(socket,getblocking,{
+	METHOD_TAKES_NONE();
+	int flags = fcntl(self->sockfd, F_GETFL);
+	if (flags == -1) {
+		return krk_runtimeError(SocketError, "Socket error: %s", strerror(errno));
+	}
+	return BOOLEAN_VAL(!(flags & O_NONBLOCK));
+})
+#endif
+
+KRK_METHOD(socket,setblocking,{
+	METHOD_TAKES_EXACTLY(1);
+	if (setBlocking(self->sockfd, !krk_isFalsey(argv[1])) == -1) {
+		return krk_runtimeError(SocketError, "Socket error: %s", strerror(errno));
+	}
+	self->timeout = krk_isFalsey(argv[1]) ? 0 : -1;
+})
+
+KRK_METHOD(socket,settimeout,{
+	METHOD_TAKES_EXACTLY(1);
+	double timeout;
+	if (IS_NONE(argv[1])) {
+		timeout = -1;
+	} else if (IS_INTEGER(argv[1])) {
+		timeout = AS_INTEGER(argv[1]);
+	} else if (IS_FLOATING(argv[1])) {
+		timeout = AS_FLOATING(argv[1]);
+	} else {
+		return TYPE_ERROR(float or None,argv[1]);
+	}
+	if (!IS_NONE(argv[1]) && !(timeout >= 0)) return krk_runtimeError(vm.exceptions->valueError, "Timeout value out of range");
+	/* Waiting with a timeout is done before each operation, on a non-blocking socket. */
+	if (setBlocking(self->sockfd, timeout < 0) == -1) {
+		return krk_runtimeError(SocketError, "Socket error: %s", strerror(errno));
+	}
+	self->timeout = timeout;
+})
+
+KRK_METHOD(socket,gettimeout,{
+	METHOD_TAKES_NONE();
+	if (self->timeout < 0) return NONE_VAL();
+	return FLOATING_VAL(self->timeout);
+})
+
+KRK_METHOD(socket,close,{
+	METHOD_TAKES_NONE();
+	if (self->sockfd < 0) return NONE_VAL();
+	int result = closeSocket(self->sockfd);
+	self->sockfd = -1;
+	if (result < 0) {
+		return krk_runtimeError(SocketError, "Socket error: %s", strerror(errno));
+	}
+})
+
+KRK_METHOD(socket,getsockname,{
+	METHOD_TAKES_NONE();
+	struct sockaddr_storage addr;
+	socklen_t addrlen = sizeof(addr);
+	if (getsockname(self->sockfd, (struct sockaddr*)&addr, &addrlen) < 0) {
+		return krk_runtimeError(SocketError, "Socket error: %s", strerror(errno));
+	}
+	if (self->family != AF_INET) {
+		return krk_runtimeError(vm.exceptions->notImplementedError, "Not implemented.");
+	}
+	return makeAddress(&addr, addrlen);
+})
+
+KRK_METHOD(socket,getsockopt,{
+	METHOD_TAKES_EXACTLY(2);
+	CHECK_ARG(1,int,krk_integer_type,level);
+	CHECK_ARG(2,int,krk_integer_type,optname);
+	int val = 0;
+	socklen_t len = sizeof(int);
+	if (getsockopt(self->sockfd, level, optname, (void*)&val, &len) < 0) {
+		return krk_runtimeError(SocketError, "Socket error: %s", strerror(errno));
+	}
+	return INTEGER_VAL(val);
+})
+
 KRK_METHOD(socket,setsockopt,{
 	METHOD_TAKES_EXACTLY(3);
 	CHECK_ARG(1,int,krk_integer_type,level);
@@ -389,6 +615,273 @@ KRK_METHOD(socket,setsockopt,{
 
 })
 
+#ifndef _WIN32
+/**
+ * Point @p iov at each buffer in the list or tuple @p buffers, which must
+ * stay alive and unchanged while the vector is in use.
+ */
+static struct iovec * makeVector(KrkValue buffers, int writable, size_t * count) {
+	KrkValueArray * values;
+	if (IS_list(buffers)) values = AS_LIST(buffers);
+	else if (IS_TUPLE(buffers)) values = &AS_TUPLE(buffers)->values;
+	else {
+		krk_runtimeError(vm.exceptions->typeError, "buffers should be list or tuple, not '%s'", krk_typeName(buffers));
+		return NULL;
+	}
+	struct iovec * iov = malloc(sizeof(struct iovec) * (values->count ? values->count : 1));
+	for (size_t i = 0; i < values->count; ++i) {
+		KrkBuffer buf;
+		if (!krk_getBuffer(values->values[i], &buf, writable)) {
+			free(iov);
+			return NULL;
+		}
+		iov[i].iov_base = buf.bytes;
+		iov[i].iov_len = buf.length;
+	}
+	*count = values->count;
+	return iov;
+}
+
+/** Turn the control messages received in @p msg into a list of (level, type, data) */
+static KrkValue makeAncillary(struct msghdr * msg) {
+	KrkValue list = krk_list_of(0,NULL,0);
+	krk_push(list);
+	for (struct cmsghdr * cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		size_t length = cmsg->cmsg_len - CMSG_LEN(0);
+		KrkTuple * item = krk_newTuple(3);
+		krk_push(OBJECT_VAL(item));
+		item->values.values[item->values.count++] = INTEGER_VAL(cmsg->cmsg_level);
+		item->values.values[item->values.count++] = INTEGER_VAL(cmsg->cmsg_type);
+		item->values.values[item->values.count++] = OBJECT_VAL(krk_newBytes(length, CMSG_DATA(cmsg)));
+		krk_writeValueArray(AS_LIST(list), krk_peek(0));
+		krk_pop();
+	}
+	return krk_pop();
+}
+
+/**
+ * Receive into the vector @p iov and build the four-tuple returned by
+ * recvmsg and recvmsg_into; @p first is their first element, or None to
+ * put the number of bytes received there.
+ */
+static KrkValue receiveMessage(struct socket * self, struct iovec * iov, size_t count, size_t ancbufsize, int flags, ssize_t * received) {
+	struct sockaddr_storage addr;
+	void * control = ancbufsize ? calloc(1, ancbufsize) : NULL;
+	struct msghdr msg = {0};
+	msg.msg_name = &addr;
+	msg.msg_namelen = sizeof(addr);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = count;
+	msg.msg_control = control;
+	msg.msg_controllen = ancbufsize;
+
+	ssize_t result;
+	do {
+		if (!waitReady(self, POLLIN)) { free(control); return NONE_VAL(); }
+		krk_beginBlocking();
+		result = recvmsg(self->sockfd, &msg, flags);
+		int error = errno;
+		krk_endBlocking();
+		errno = error;
+	} while (result < 0 && self->timeout > 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+
+	if (result < 0) {
+		free(control);
+		socketError();
+		return NONE_VAL();
+	}
+
+	*received = result;
+	KrkTuple * out = krk_newTuple(4);
+	krk_push(OBJECT_VAL(out));
+	out->values.values[out->values.count++] = NONE_VAL();
+	out->values.values[out->values.count++] = ancbufsize ? makeAncillary(&msg) : krk_list_of(0,NULL,0);
+	out->values.values[out->values.count++] = INTEGER_VAL(msg.msg_flags);
+	out->values.values[out->values.count++] = makeAddress(&addr, msg.msg_namelen);
+	krk_gcWriteBarrier((KrkObj*)out);
+	free(control);
+	return krk_pop();
+}
+
+KRK_METHOD(socket,sendmsg,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(4);
+
+	int flags = 0;
+	if (argc > 3) {
+		CHECK_ARG(3,int,krk_integer_type,_flags);
+		flags = _flags;
+	}
+
+	struct sockaddr_storage sock_addr;
+	socklen_t sock_size = 0;
+	if (argc > 4 && !IS_NONE(argv[4])) {
+		if (socket_parse_address(self, argv[4], &sock_addr, &sock_size)) {
+			if (!(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION)) {
+				return krk_runtimeError(SocketError, "Unspecified error.");
+			}
+			return NONE_VAL();
+		}
+	}
+
+	/* Ancillary data is a sequence of (level, type, data) */
+	KrkValueArray * ancillary = NULL;
+	if (argc > 2) {
+		if (IS_list(argv[2])) ancillary = AS_LIST(argv[2]);
+		else if (IS_TUPLE(argv[2])) ancillary = &AS_TUPLE(argv[2])->values;
+		else return krk_runtimeError(vm.exceptions->typeError, "ancdata should be list or tuple, not '%s'", krk_typeName(argv[2]));
+	}
+
+	size_t controllen = 0;
+	for (size_t i = 0; ancillary && i < ancillary->count; ++i) {
+		KrkValue item = ancillary->values[i];
+		KrkBuffer data;
+		if (!IS_TUPLE(item) || AS_TUPLE(item)->values.count != 3 ||
+		    !IS_INTEGER(AS_TUPLE(item)->values.values[0]) || !IS_INTEGER(AS_TUPLE(item)->values.values[1])) {
+			return krk_runtimeError(vm.exceptions->typeError, "ancillary data items should be (level, type, data)");
+		}
+		if (!krk_getBuffer(AS_TUPLE(item)->values.values[2], &data, 0)) return NONE_VAL();
+		controllen += CMSG_SPACE(data.length);
+	}
+
+	size_t count;
+	struct iovec * iov = makeVector(argv[1], 0, &count);
+	if (!iov) return NONE_VAL();
+
+	void * control = controllen ? calloc(1, controllen) : NULL;
+	struct msghdr msg = {0};
+	msg.msg_name = sock_size ? &sock_addr : NULL;
+	msg.msg_namelen = sock_size;
+	msg.msg_iov = iov;
+	msg.msg_iovlen = count;
+	msg.msg_control = control;
+	msg.msg_controllen = controllen;
+
+	if (controllen) {
+		struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+		for (size_t i = 0; i < ancillary->count; ++i, cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			KrkTuple * item = AS_TUPLE(ancillary->values[i]);
+			KrkBuffer data;
+			krk_getBuffer(item->values.values[2], &data, 0);
+			cmsg->cmsg_level = AS_INTEGER(item->values.values[0]);
+			cmsg->cmsg_type = AS_INTEGER(item->values.values[1]);
+			cmsg->cmsg_len = CMSG_LEN(data.length);
+			memcpy(CMSG_DATA(cmsg), data.bytes, data.length);
+		}
+	}
+
+	ssize_t result;
+	do {
+		if (!waitReady(self, POLLOUT)) { free(iov); free(control); return NONE_VAL(); }
+		krk_beginBlocking();
+		result = sendmsg(self->sockfd, &msg, flags);
+		int error = errno;
+		krk_endBlocking();
+		errno = error;
+	} while (result < 0 && self->timeout > 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+
+	free(iov);
+	free(control);
+	if (result < 0) return socketError();
+	return INTEGER_VAL(result);
+})
+
+KRK_METHOD(socket,recvmsg,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(3);
+	CHECK_ARG(1,int,krk_integer_type,bufsize);
+	if (bufsize < 0) return krk_runtimeError(vm.exceptions->valueError, "negative buffer size");
+	size_t ancbufsize = 0;
+	int flags = 0;
+	if (argc > 2) {
+		CHECK_ARG(2,int,krk_integer_type,_ancbufsize);
+		if (_ancbufsize < 0) return krk_runtimeError(vm.exceptions->valueError, "negative buffer size");
+		ancbufsize = _ancbufsize;
+	}
+	if (argc > 3) {
+		CHECK_ARG(3,int,krk_integer_type,_flags);
+		flags = _flags;
+	}
+
+	void * buf = malloc(bufsize ? bufsize : 1);
+	struct iovec iov = {buf, bufsize};
+	ssize_t received;
+	KrkValue out = receiveMessage(self, &iov, 1, ancbufsize, flags, &received);
+	if (IS_NONE(out)) {
+		free(buf);
+		return NONE_VAL();
+	}
+	krk_push(out);
+	AS_TUPLE(out)->values.values[0] = OBJECT_VAL(krk_newBytes(received, buf));
+	krk_gcWriteBarrier(AS_OBJECT(out));
+	free(buf);
+	return krk_pop();
+})
+
+KRK_METHOD(socket,recvmsg_into,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(3);
+	size_t ancbufsize = 0;
+	int flags = 0;
+	if (argc > 2) {
+		CHECK_ARG(2,int,krk_integer_type,_ancbufsize);
+		if (_ancbufsize < 0) return krk_runtimeError(vm.exceptions->valueError, "negative buffer size");
+		ancbufsize = _ancbufsize;
+	}
+	if (argc > 3) {
+		CHECK_ARG(3,int,krk_integer_type,_flags);
+		flags = _flags;
+	}
+
+	size_t count;
+	struct iovec * iov = makeVector(argv[1], 1, &count);
+	if (!iov) return NONE_VAL();
+
+	ssize_t received;
+	KrkValue out = receiveMessage(self, iov, count, ancbufsize, flags, &received);
+	free(iov);
+	if (IS_NONE(out)) return NONE_VAL();
+	AS_TUPLE(out)->values.values[0] = INTEGER_VAL(received);
+	return out;
+})
+
+KRK_FUNC(socketpair,{
+	FUNCTION_TAKES_AT_MOST(3);
+	int family = AF_UNIX;
+	int type = SOCK_STREAM;
+	int proto = 0;
+	if (argc > 0) {
+		CHECK_ARG(0,int,krk_integer_type,_family);
+		family = _family;
+	}
+	if (argc > 1) {
+		CHECK_ARG(1,int,krk_integer_type,_type);
+		type = _type;
+	}
+	if (argc > 2) {
+		CHECK_ARG(2,int,krk_integer_type,_proto);
+		proto = _proto;
+	}
+
+	int fds[2];
+	if (socketpair(family, type, proto, fds) < 0) return socketError();
+
+	KrkTuple * out = krk_newTuple(2);
+	krk_push(OBJECT_VAL(out));
+	for (int i = 0; i < 2; ++i) {
+		struct socket * sock = (struct socket*)krk_newInstance(SocketClass);
+		sock->sockfd = fds[i];
+		sock->family = family;
+		sock->type   = type;
+		sock->proto  = proto;
+		sock->timeout = -1;
+		out->values.values[out->values.count++] = OBJECT_VAL(sock);
+		krk_gcWriteBarrier((KrkObj*)out);
+	}
+	return krk_pop();
+})
+#endif
+
 KRK_FUNC(htons,{
 	FUNCTION_TAKES_EXACTLY(1);
 	CHECK_ARG(0,int,krk_integer_type,value);
@@ -433,15 +926,27 @@ KrkValue krk_module_onload_socket(void) {
 		"@brief Receive data from a connected socket.\n"
 		"@arguments bufsize,[flags]\n\n"
 		"Receive up to @p bufsize bytes of data, which is returned as a @ref bytes object.");
+	KRK_DOC(BIND_METHOD(socket,recv_into),
+		"@brief Receive data from a connected socket into a buffer.\n"
+		"@arguments buffer,[nbytes],[flags]\n\n"
+		"Receive up to @p nbytes bytes, or as many as @p buffer holds if @p nbytes is @c 0 or not given, "
+		"into the writable bytes-like object @p buffer, such as a @ref bytearray or @c memoryview. "
+		"Returns the number of bytes received.");
 	KRK_DOC(BIND_METHOD(socket,send),
 		"@brief Send data to a connected socket.\n"
 		"@arguments buf,[flags]\n\n"
-		"Send the data in the @ref bytes object @p buf to the socket. Returns the number "
+		"Send the data in the bytes-like object @p buf to the socket. Returns the number "
 		"of bytes written to the socket.");
+	KRK_DOC(BIND_METHOD(socket,sendall),
+		"@brief Send all of the data to a connected socket.\n"
+		"@arguments buf,[flags]\n\n"
+		"Unlike @ref socket_send, keeps sending until every byte of @p buf has been written, "
+		"waiting for the socket to be writable in between. An exception may leave only "
+		"part of the data sent.");
 	KRK_DOC(BIND_METHOD(socket,sendto),
 		"@brief Send data to an socket with a particular destination.\n"
 		"@arguments buf,[flags],addr\n\n"
-		"Send the data in the @ref bytes object @p buf to the socket. Returns the number "
+		"Send the data in the bytes-like object @p buf to the socket. Returns the number "
 		"of bytes written to the socket.");
 	KRK_DOC(BIND_METHOD(socket,fileno),
 		"@brief Get the file descriptor number for the underlying socket.");
@@ -450,10 +955,64 @@ KrkValue krk_module_onload_socket(void) {
 		"@arguments level,optname,value\n\n"
 		"@p level and @p optname should be integer values defined by @c SOL and @c SO options. "
 		"@p value must be either an @ref int or a @ref bytes object.");
+	KRK_DOC(BIND_METHOD(socket,setblocking),
+		"@brief Put the socket in blocking or non-blocking mode.\n"
+		"@arguments flag\n\n"
+		"On a non-blocking socket, @ref socket_accept, @ref socket_connect, @ref socket_recv and "
+		"@ref socket_send raise @ref BlockingIOError instead of waiting. They can be retried once "
+		"the socket is ready, which an event loop can be asked to say. "
+		"@c setblocking(True) is @c settimeout(None) and @c setblocking(False) is @c settimeout(0).");
+	KRK_DOC(BIND_METHOD(socket,settimeout),
+		"@brief Set how long operations on the socket may wait.\n"
+		"@arguments value\n\n"
+		"With a positive number of seconds, operations that have to wait for the socket raise "
+		"@c timeout if it is not ready in that time. @c 0 makes the socket non-blocking and "
+		"@c None makes it block without a limit.");
+	KRK_DOC(BIND_METHOD(socket,gettimeout),
+		"@brief The socket's timeout in seconds, or @c None if it has none.");
+#ifndef _WIN32
+	KRK_DOC(BIND_METHOD(socket,sendmsg),
+		"@brief Send data gathered from several buffers, with ancillary data.\n"
+		"@arguments buffers,[ancdata],[flags],[address]\n\n"
+		"@p buffers is a list or tuple of bytes-like objects, sent as one message. @p ancdata "
+		"is a sequence of @c (level,type,data) tuples, such as @c SCM_RIGHTS for passing file "
+		"descriptors over @c AF_UNIX sockets. Returns the number of bytes sent.");
+	KRK_DOC(BIND_METHOD(socket,recvmsg),
+		"@brief Receive a message with its ancillary data.\n"
+		"@arguments bufsize,[ancbufsize],[flags]\n\n"
+		"Returns a four-tuple of the data received, a list of @c (level,type,data) tuples of "
+		"ancillary data fitting in @p ancbufsize bytes, the message flags, and the sender's address.");
+	KRK_DOC(BIND_METHOD(socket,recvmsg_into),
+		"@brief Receive a message into several buffers.\n"
+		"@arguments buffers,[ancbufsize],[flags]\n\n"
+		"Like @ref socket_recvmsg, but the data is scattered over the writable bytes-like objects "
+		"in the list or tuple @p buffers, filling each in turn, and the number of bytes received "
+		"replaces the data in the result.");
+#endif
+#ifndef _WIN32
+	KRK_DOC(BIND_METHOD(socket,getblocking),
+		"@brief Whether the socket is in blocking mode.");
+#endif
+	KRK_DOC(BIND_METHOD(socket,close),
+		"@brief Close the socket.\n\n"
+		"The file descriptor is released; closing a socket again does nothing.");
+	KRK_DOC(BIND_METHOD(socket,getsockname),
+		"@brief Get the address the socket is bound to.\n\n"
+		"For @c AF_INET, this is a two-tuple of a numeric address string and a port number.");
+	KRK_DOC(BIND_METHOD(socket,getsockopt),
+		"@brief Get an integer socket option.\n"
+		"@arguments level,optname\n\n"
+		"For example, @c SO_ERROR gives the result of a non-blocking @ref socket_connect.");
 	krk_defineNative(&socket->methods,"__str__", FUNC_NAME(socket,__repr__));
 	krk_finalizeClass(SocketClass);
 
 	BIND_FUNC(module, htons);
+#ifndef _WIN32
+	KRK_DOC(BIND_FUNC(module, socketpair),
+		"@brief Create a pair of connected sockets.\n"
+		"@arguments family=AF_UNIX,type=SOCK_STREAM,proto=0\n\n"
+		"Returns a two-tuple of socket objects, each connected to the other.");
+#endif
 
 	/* Constants */
 #define SOCK_CONST(o) krk_attachNamedValue(&module->fields, #o, INTEGER_VAL(o));
@@ -496,10 +1055,36 @@ KrkValue krk_module_onload_socket(void) {
 	SOCK_CONST(SOL_SOCKET);
 
 	SOCK_CONST(SO_REUSEADDR);
+	SOCK_CONST(SO_ERROR);
+
+#ifdef SCM_RIGHTS
+	SOCK_CONST(SCM_RIGHTS);
+#endif
+#ifdef MSG_PEEK
+	SOCK_CONST(MSG_PEEK);
+#endif
+#ifdef MSG_DONTWAIT
+	SOCK_CONST(MSG_DONTWAIT);
+#endif
+#ifdef MSG_WAITALL
+	SOCK_CONST(MSG_WAITALL);
+#endif
+#ifdef MSG_TRUNC
+	SOCK_CONST(MSG_TRUNC);
+	SOCK_CONST(MSG_CTRUNC);
+#endif
 
 	krk_makeClass(module, &SocketError, "SocketError", vm.exceptions->baseException);
 	KRK_DOC(SocketError, "Raised on faults from socket functions.");
 	krk_finalizeClass(SocketError);
 
+	krk_makeClass(module, &BlockingIOError, "BlockingIOError", SocketError);
+	KRK_DOC(BlockingIOError, "Raised when an operation on a non-blocking socket would have to wait.");
+	krk_finalizeClass(BlockingIOError);
+
+	krk_makeClass(module, &SocketTimeout, "timeout", SocketError);
+	KRK_DOC(SocketTimeout, "Raised when a socket with a timeout was not ready in time; see @ref socket_settimeout.");
+	krk_finalizeClass(SocketTimeout);
+
 	return krk_pop();
 }
@@ -4,10 +4,7 @@
 #include <kuroko/memory.h>
 #include <kuroko/util.h>
 
-struct ByteArray {
-	KrkInstance inst;
-	KrkValue actual;
-};
+#include "private.h"
 
 #define AS_bytes(o) AS_BYTES(o)
 #define CURRENT_CTYPE KrkBytes *
@@ -44,10 +41,10 @@ KRK_METHOD(bytes,__init__,{
 			out->bytes[i] = AS_INTEGER(AS_LIST(argv[1])->values[i]);
 		}
 		return krk_pop();
-	} else if (IS_bytearray(argv[1])) {
-		return OBJECT_VAL(krk_newBytes(
-			AS_BYTES(AS_bytearray(argv[1])->actual)->length,
-			AS_BYTES(AS_bytearray(argv[1])->actual)->bytes));
+	} else if (IS_INSTANCE(argv[1]) && AS_INSTANCE(argv[1])->_class->_ongetbuffer) {
+		KrkBuffer buffer;
+		if (!krk_getBuffer(argv[1], &buffer, 0)) return NONE_VAL();
+		return OBJECT_VAL(krk_newBytes(buffer.length, buffer.bytes));
 	}
 
 	return krk_runtimeError(vm.exceptions->typeError, "Can not convert '%s' to bytes", krk_typeName(argv[1]));
@@ -58,13 +55,7 @@ KRK_METHOD(bytes,__init__,{
 
 KRK_METHOD(bytes,__hash__,{
 	METHOD_TAKES_NONE();
-	uint32_t hash = 0;
-	/* This is the so-called "sdbm" hash. It comes from a piece of
-	 * public domain code from a clone of ndbm. */
-	for (size_t i = 0; i < self->length; ++i) {
-		hash = (int)self->bytes[i] + (hash << 6) + (hash << 16) - hash;
-	}
-	return INTEGER_VAL(hash);
+	return INTEGER_VAL(krk_hashBytes(self->bytes, self->length));
 })
 
 /* bytes objects are not interned; need to do this the old-fashioned way. */
@@ -73,7 +64,6 @@ KRK_METHOD(bytes,__eq__,{
 	KrkBytes * self = AS_BYTES(argv[0]);
 	KrkBytes * them = AS_BYTES(argv[1]);
 	if (self->length != them->length) return BOOLEAN_VAL(0);
-	if (self->obj.hash != them->obj.hash) return BOOLEAN_VAL(0);
 	for (size_t i = 0; i < self->length; ++i) {
 		if (self->bytes[i] != them->bytes[i]) return BOOLEAN_VAL(0);
 	}
@@ -82,42 +72,47 @@ KRK_METHOD(bytes,__eq__,{
 
 #define AT_END() (self->length == 0 || i == self->length - 1)
 
-KRK_METHOD(bytes,__repr__,{
-	struct StringBuilder sb = {0};
-
-	pushStringBuilder(&sb, 'b');
-	pushStringBuilder(&sb, '\'');
+/**
+ * Append the @c b'...' form of @p length bytes at @p bytes to @p sb.
+ */
+static void reprBytes(struct StringBuilder * sb, const uint8_t * bytes, size_t length) {
+	pushStringBuilder(sb, 'b');
+	pushStringBuilder(sb, '\'');
 
-	for (size_t i = 0; i < AS_BYTES(argv[0])->length; ++i) {
-		uint8_t ch = AS_BYTES(argv[0])->bytes[i];
+	for (size_t i = 0; i < length; ++i) {
+		uint8_t ch = bytes[i];
 		switch (ch) {
-			case '\\': pushStringBuilder(&sb, '\\'); pushStringBuilder(&sb, '\\'); break;
-			case '\'': pushStringBuilder(&sb, '\\'); pushStringBuilder(&sb, '\''); break;
-			case '\a': pushStringBuilder(&sb, '\\'); pushStringBuilder(&sb, 'a'); break;
-			case '\b': pushStringBuilder(&sb, '\\'); pushStringBuilder(&sb, 'b'); break;
-			case '\f': pushStringBuilder(&sb, '\\'); pushStringBuilder(&sb, 'f'); break;
-			case '\n': pushStringBuilder(&sb, '\\'); pushStringBuilder(&sb, 'n'); break;
-			case '\r': pushStringBuilder(&sb, '\\'); pushStringBuilder(&sb, 'r'); break;
-			case '\t': pushStringBuilder(&sb, '\\'); pushStringBuilder(&sb, 't'); break;
-			case '\v': pushStringBuilder(&sb, '\\'); pushStringBuilder(&sb, 'v'); break;
+			case '\\': pushStringBuilder(sb, '\\'); pushStringBuilder(sb, '\\'); break;
+			case '\'': pushStringBuilder(sb, '\\'); pushStringBuilder(sb, '\''); break;
+			case '\a': pushStringBuilder(sb, '\\'); pushStringBuilder(sb, 'a'); break;
+			case '\b': pushStringBuilder(sb, '\\'); pushStringBuilder(sb, 'b'); break;
+			case '\f': pushStringBuilder(sb, '\\'); pushStringBuilder(sb, 'f'); break;
+			case '\n': pushStringBuilder(sb, '\\'); pushStringBuilder(sb, 'n'); break;
+			case '\r': pushStringBuilder(sb, '\\'); pushStringBuilder(sb, 'r'); break;
+			case '\t': pushStringBuilder(sb, '\\'); pushStringBuilder(sb, 't'); break;
+			case '\v': pushStringBuilder(sb, '\\'); pushStringBuilder(sb, 'v'); break;
 			default: {
 				if (ch < ' ' || ch >= 0x7F) {
-					pushStringBuilder(&sb, '\\');
-					pushStringBuilder(&sb, 'x');
+					pushStringBuilder(sb, '\\');
+					pushStringBuilder(sb, 'x');
 					char hex[3];
 					snprintf(hex,3,"%02x", ch);
-					pushStringBuilder(&sb, hex[0]);
-					pushStringBuilder(&sb, hex[1]);
+					pushStringBuilder(sb, hex[0]);
+					pushStringBuilder(sb, hex[1]);
 				} else {
-					pushStringBuilder(&sb, ch);
+					pushStringBuilder(sb, ch);
 				}
 				break;
 			}
 		}
 	}
 
-	pushStringBuilder(&sb, '\'');
+	pushStringBuilder(sb, '\'');
+}
 
+KRK_METHOD(bytes,__repr__,{
+	struct StringBuilder sb = {0};
+	reprBytes(&sb, AS_BYTES(argv[0])->bytes, AS_BYTES(argv[0])->length);
 	return finishStringBuilder(&sb);
 })
 
@@ -162,12 +157,32 @@ KRK_METHOD(bytes,__len__,{
 
 KRK_METHOD(bytes,__contains__,{
 	METHOD_TAKES_EXACTLY(1);
-	return krk_runtimeError(vm.exceptions->notImplementedError, "not implemented");
+	if (IS_INTEGER(argv[1])) {
+		if (AS_INTEGER(argv[1]) < 0 || AS_INTEGER(argv[1]) > 255) return krk_runtimeError(vm.exceptions->valueError, "byte must be in range(0, 256)");
+		return BOOLEAN_VAL(self->length && memchr(self->bytes, AS_INTEGER(argv[1]), self->length) != NULL);
+	}
+	CHECK_ARG(1,bytes,KrkBytes*,needle);
+	return BOOLEAN_VAL(krk_findBytes((char*)self->bytes, self->length, (char*)needle->bytes, needle->length) != NULL);
+})
+
+KRK_METHOD(bytes,find,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,bytes,KrkBytes*,needle);
+	const char * found = krk_findBytes((char*)self->bytes, self->length, (char*)needle->bytes, needle->length);
+	return INTEGER_VAL(found ? found - (char*)self->bytes : -1);
+})
+
+KRK_METHOD(bytes,index,{
+	KrkValue result = FUNC_NAME(bytes,find)(argc,argv,hasKw);
+	if (IS_INTEGER(result) && AS_INTEGER(result) == -1) {
+		return krk_runtimeError(vm.exceptions->valueError, "subsection not found");
+	}
+	return result;
 })
 
 KRK_METHOD(bytes,decode,{
 	METHOD_TAKES_NONE();
-	return OBJECT_VAL(krk_copyString((char*)AS_BYTES(argv[0])->bytes, AS_BYTES(argv[0])->length));
+	return OBJECT_VAL(krk_copyStringUninterned((char*)AS_BYTES(argv[0])->bytes, AS_BYTES(argv[0])->length));
 })
 
 #define unpackArray(counter, indexer) do { \
@@ -200,11 +215,12 @@ _expectedBytes:
 
 KRK_METHOD(bytes,__add__,{
 	METHOD_TAKES_EXACTLY(1);
-	CHECK_ARG(1,bytes,KrkBytes*,them);
+	KrkBuffer them;
+	if (!krk_getBuffer(argv[1], &them, 0)) return NONE_VAL();
 
 	struct StringBuilder sb = {0};
 	pushStringBuilderStr(&sb, (char*)self->bytes, self->length);
-	pushStringBuilderStr(&sb, (char*)them->bytes, them->length);
+	pushStringBuilderStr(&sb, (char*)them.bytes, them.length);
 
 	return finishStringBuilderBytes(&sb);
 })
@@ -238,61 +254,171 @@ static void _bytesiterator_gcscan(KrkInstance * self) {
 	krk_markValue(((struct BytesIterator*)self)->l);
 }
 
+/* Also iterates over bytearrays and memoryviews, whose bytes are found again each step. */
 KRK_METHOD(bytesiterator,__init__,{
 	METHOD_TAKES_EXACTLY(1);
-	CHECK_ARG(1,bytes,KrkBytes*,bytes);
+	if (!IS_BYTES(argv[1]) && !IS_bytearray(argv[1]) && !IS_memoryview(argv[1])) return TYPE_ERROR(bytes,argv[1]);
 	self->l = argv[1];
 	self->i = 0;
+	krk_gcWriteBarrier((KrkObj*)self);
 	return argv[0];
 })
 
 KRK_METHOD(bytesiterator,__call__,{
-	KrkValue _list = self->l;
+	KrkBuffer buffer;
+	if (!krk_getBuffer(self->l, &buffer, 0)) return NONE_VAL();
 	size_t _counter = self->i;
-	if (_counter >= AS_BYTES(_list)->length) {
+	if (_counter >= buffer.length) {
 		return argv[0];
 	} else {
 		self->i = _counter + 1;
-		return INTEGER_VAL(AS_BYTES(_list)->bytes[_counter]);
+		return INTEGER_VAL(buffer.bytes[_counter]);
 	}
 })
 
 #undef CURRENT_CTYPE
 #define CURRENT_CTYPE struct ByteArray *
 
-static void _bytearray_gcscan(KrkInstance * self) {
-	krk_markValue(((struct ByteArray*)self)->actual);
+static void _bytearray_gcsweep(KrkInstance * self) {
+	struct ByteArray * me = (struct ByteArray*)self;
+	if (me->bytes) FREE_ARRAY(uint8_t, me->bytes, me->capacity);
+	me->bytes = NULL;
+	me->length = 0;
+	me->capacity = 0;
+}
+
+static int _bytearray_getbuffer(KrkInstance * self, KrkBuffer * buffer) {
+	struct ByteArray * me = (struct ByteArray*)self;
+	buffer->bytes = me->bytes;
+	buffer->length = me->length;
+	buffer->readonly = 0;
+	return 1;
+}
+
+static int isBuffer(KrkValue value) {
+	return IS_BYTES(value) || (IS_INSTANCE(value) && AS_INSTANCE(value)->_class->_ongetbuffer);
+}
+
+/**
+ * Make room for at least @p length bytes, at least doubling the storage
+ * each time it has to grow so that appending one byte at a time is
+ * amortized constant time.
+ */
+static void bytearrayReserve(struct ByteArray * self, size_t length) {
+	if (length <= self->capacity) return;
+	size_t capacity = GROW_CAPACITY(self->capacity);
+	if (capacity < length) capacity = length;
+	self->bytes = GROW_ARRAY(uint8_t, self->bytes, self->capacity, capacity);
+	self->capacity = capacity;
 }
 
+/**
+ * Replace the bytes from @p start to @p end with the bytes of @p source,
+ * or remove them if @p source is None. @p source may be a view of the same
+ * bytes, so it is copied out first if it is.
+ */
+static int bytearrayReplace(struct ByteArray * self, size_t start, size_t end, KrkValue source) {
+	KrkBuffer buffer = {NULL, 0, 1};
+	if (!IS_NONE(source) && !krk_getBuffer(source, &buffer, 0)) return 0;
+
+	uint8_t * copy = NULL;
+	if (buffer.length && buffer.bytes >= self->bytes && buffer.bytes < self->bytes + self->capacity) {
+		copy = malloc(buffer.length);
+		memcpy(copy, buffer.bytes, buffer.length);
+		buffer.bytes = copy;
+	}
+
+	size_t length = self->length - (end - start) + buffer.length;
+	bytearrayReserve(self, length);
+	if (self->length > end) memmove(self->bytes + start + buffer.length, self->bytes + end, self->length - end);
+	if (buffer.length) memcpy(self->bytes + start, buffer.bytes, buffer.length);
+	self->length = length;
+
+	free(copy);
+	return 1;
+}
+
+static int byteValue(KrkValue value, uint8_t * out) {
+	if (!IS_INTEGER(value)) {
+		krk_runtimeError(vm.exceptions->typeError, "'%s' object cannot be interpreted as an integer", krk_typeName(value));
+		return 0;
+	}
+	if (AS_INTEGER(value) < 0 || AS_INTEGER(value) > 255) {
+		krk_runtimeError(vm.exceptions->valueError, "byte must be in range(0, 256)");
+		return 0;
+	}
+	*out = AS_INTEGER(value);
+	return 1;
+}
+
+#define unpackArray(counter, indexer) do { \
+	for (size_t i = 0; i < counter; ++i) { \
+		uint8_t byte; \
+		if (!byteValue(indexer, &byte)) { \
+			if (unpackingIterable) { krk_pop(); krk_pop(); } \
+			return 0; \
+		} \
+		bytearrayReserve(self, self->length + 1); \
+		self->bytes[self->length++] = byte; \
+	} \
+} while (0)
+#undef unpackError
+#define unpackError(fromInput) do { \
+	krk_runtimeError(vm.exceptions->typeError, "'%s' object is not iterable", krk_typeName(fromInput)); \
+	return 0; \
+} while (0)
+
+/**
+ * Add the bytes of @p source to the end: in one copy if it is bytes-like,
+ * or one integer at a time from any other iterable.
+ */
+static int bytearrayExtend(struct ByteArray * self, KrkValue source) {
+	if (isBuffer(source)) return bytearrayReplace(self, self->length, self->length, source);
+	unpackIterableFast(source);
+	return 1;
+}
+
+#undef unpackArray
+#undef unpackError
+
 KRK_METHOD(bytearray,__init__,{
 	METHOD_TAKES_AT_MOST(1);
-	if (argc < 2) {
-		self->actual = OBJECT_VAL(krk_newBytes(0,NULL));
-	} else if (IS_BYTES(argv[1])) {
-		self->actual = OBJECT_VAL(krk_newBytes(AS_BYTES(argv[1])->length, AS_BYTES(argv[1])->bytes));
+	self->length = 0;
+	if (argc < 2 || IS_NONE(argv[1])) {
+		return argv[0];
 	} else if (IS_INTEGER(argv[1])) {
-		self->actual = OBJECT_VAL(krk_newBytes(AS_INTEGER(argv[1]),NULL));
-	} else {
-		return krk_runtimeError(vm.exceptions->valueError, "expected bytes");
+		if (AS_INTEGER(argv[1]) < 0) return krk_runtimeError(vm.exceptions->valueError, "negative count");
+		bytearrayReserve(self, AS_INTEGER(argv[1]));
+		if (AS_INTEGER(argv[1])) memset(self->bytes, 0, AS_INTEGER(argv[1]));
+		self->length = AS_INTEGER(argv[1]);
+	} else if (IS_STRING(argv[1])) {
+		return krk_runtimeError(vm.exceptions->typeError, "string argument without an encoding");
+	} else if (!bytearrayExtend(self, argv[1])) {
+		return NONE_VAL();
 	}
 	return argv[0];
 })
 
-/* bytes objects are not interned; need to do this the old-fashioned way. */
+/**
+ * Compare the bytes of two bytes-like objects; anything else is unequal.
+ */
+static KrkValue buffersEqual(KrkValue a, KrkValue b) {
+	if (!isBuffer(b)) return BOOLEAN_VAL(0);
+	KrkBuffer left, right;
+	if (!krk_getBuffer(a, &left, 0) || !krk_getBuffer(b, &right, 0)) return NONE_VAL();
+	return BOOLEAN_VAL(left.length == right.length && (!left.length || !memcmp(left.bytes, right.bytes, left.length)));
+}
+
 KRK_METHOD(bytearray,__eq__,{
-	if (!IS_bytearray(argv[1])) return BOOLEAN_VAL(0);
-	struct ByteArray * them = AS_bytearray(argv[1]);
-	return BOOLEAN_VAL(krk_valuesEqual(self->actual, them->actual));
+	METHOD_TAKES_EXACTLY(1);
+	return buffersEqual(argv[0], argv[1]);
 })
 
 KRK_METHOD(bytearray,__repr__,{
 	METHOD_TAKES_NONE();
 	struct StringBuilder sb = {0};
 	pushStringBuilderStr(&sb, "bytearray(", 10);
-
-	krk_push(self->actual);
-	KrkValue repred_bytes = krk_callDirect(vm.baseClasses->bytesClass->_reprer, 1);
-	pushStringBuilderStr(&sb, AS_STRING(repred_bytes)->chars, AS_STRING(repred_bytes)->length);
+	reprBytes(&sb, self->bytes, self->length);
 	pushStringBuilder(&sb,')');
 	return finishStringBuilder(&sb);
 })
@@ -303,25 +429,25 @@ KRK_METHOD(bytearray,__getitem__,{
 	if (IS_INTEGER(argv[1])) {
 		CHECK_ARG(1,int,krk_integer_type,asInt);
 
-		if (asInt < 0) asInt += (long)AS_BYTES(self->actual)->length;
-		if (asInt < 0 || asInt >= (long)AS_BYTES(self->actual)->length) {
+		if (asInt < 0) asInt += (long)self->length;
+		if (asInt < 0 || asInt >= (long)self->length) {
 			return krk_runtimeError(vm.exceptions->indexError, "bytearray index out of range: %d", (int)asInt);
 		}
 
-		return INTEGER_VAL(AS_BYTES(self->actual)->bytes[asInt]);
+		return INTEGER_VAL(self->bytes[asInt]);
 	} else if (IS_slice(argv[1])) {
-		KRK_SLICER(argv[1],AS_BYTES(self->actual)->length) {
+		KRK_SLICER(argv[1],self->length) {
 			return NONE_VAL();
 		}
 
 		if (step == 1) {
 			krk_integer_type len = end - start;
-			return OBJECT_VAL(krk_newBytes(len, &AS_BYTES(self->actual)->bytes[start]));
+			return OBJECT_VAL(krk_newBytes(len, &self->bytes[start]));
 		} else {
 			struct StringBuilder sb = {0};
 			krk_integer_type i = start;
 			while ((step < 0) ? (i > end) : (i < end)) {
-				pushStringBuilder(&sb, AS_BYTES(self->actual)->bytes[i]);
+				pushStringBuilder(&sb, self->bytes[i]);
 				i += step;
 			}
 			return finishStringBuilderBytes(&sb);
@@ -332,36 +458,186 @@ KRK_METHOD(bytearray,__getitem__,{
 	}
 })
 
+/**
+ * Turn the extended slice @p start, @p end, @p step into one with a positive
+ * step that covers the same indices, and return how many there are.
+ */
+static size_t normalizeSlice(krk_integer_type * start, krk_integer_type * end, krk_integer_type * step) {
+	if (*step > 0) {
+		return *end > *start ? (*end - *start + *step - 1) / *step : 0;
+	}
+	if (*start <= *end) return 0;
+	size_t count = (*start - *end - 1) / -*step + 1;
+	*end = *start + 1;
+	*start = *start + (krk_integer_type)(count - 1) * *step;
+	*step = -*step;
+	return count;
+}
+
 KRK_METHOD(bytearray,__setitem__,{
 	METHOD_TAKES_EXACTLY(2);
-	CHECK_ARG(1,int,krk_integer_type,asInt);
-	CHECK_ARG(2,int,krk_integer_type,val);
 
-	if (asInt < 0) asInt += (long)AS_BYTES(self->actual)->length;
-	if (asInt < 0 || asInt >= (long)AS_BYTES(self->actual)->length) {
-		return krk_runtimeError(vm.exceptions->indexError, "bytearray index out of range: %d", (int)asInt);
+	if (IS_INTEGER(argv[1])) {
+		CHECK_ARG(1,int,krk_integer_type,asInt);
+		uint8_t val;
+		if (!byteValue(argv[2], &val)) return NONE_VAL();
+
+		if (asInt < 0) asInt += (long)self->length;
+		if (asInt < 0 || asInt >= (long)self->length) {
+			return krk_runtimeError(vm.exceptions->indexError, "bytearray index out of range: %d", (int)asInt);
+		}
+		self->bytes[asInt] = val;
+
+		return INTEGER_VAL(val);
+	} else if (IS_slice(argv[1])) {
+		KRK_SLICER(argv[1],self->length) {
+			return NONE_VAL();
+		}
+		if (step == 1) {
+			if (!bytearrayReplace(self, start, end > start ? end : start, argv[2])) return NONE_VAL();
+			return argv[2];
+		}
+		KrkBuffer buffer;
+		if (!krk_getBuffer(argv[2], &buffer, 0)) return NONE_VAL();
+		int backwards = step < 0;
+		size_t count = normalizeSlice(&start, &end, &step);
+		if (count != buffer.length) {
+			return krk_runtimeError(vm.exceptions->valueError, "attempt to assign bytes of size %zu to extended slice of size %zu", buffer.length, count);
+		}
+		/* An extended slice of ourselves reversed would read what it just wrote; go through a copy. */
+		uint8_t * copy = malloc(count ? count : 1);
+		if (count) memcpy(copy, buffer.bytes, count);
+		for (size_t i = 0; i < count; ++i) {
+			self->bytes[start + (krk_integer_type)i * step] = copy[backwards ? count - 1 - i : i];
+		}
+		free(copy);
+		return argv[2];
+	} else {
+		return TYPE_ERROR(int or slice, argv[1]);
 	}
-	AS_BYTES(self->actual)->bytes[asInt] = val;
+})
 
-	return INTEGER_VAL(AS_BYTES(self->actual)->bytes[asInt]);
+KRK_METHOD(bytearray,__delitem__,{
+	METHOD_TAKES_EXACTLY(1);
+
+	if (IS_INTEGER(argv[1])) {
+		CHECK_ARG(1,int,krk_integer_type,asInt);
+		if (asInt < 0) asInt += (long)self->length;
+		if (asInt < 0 || asInt >= (long)self->length) {
+			return krk_runtimeError(vm.exceptions->indexError, "bytearray index out of range: %d", (int)asInt);
+		}
+		bytearrayReplace(self, asInt, asInt + 1, NONE_VAL());
+	} else if (IS_slice(argv[1])) {
+		KRK_SLICER(argv[1],self->length) {
+			return NONE_VAL();
+		}
+		size_t count = normalizeSlice(&start, &end, &step);
+		if (!count) return NONE_VAL();
+		size_t out = start;
+		for (size_t i = start; i < self->length; ++i) {
+			if ((krk_integer_type)i < end && ((krk_integer_type)i - start) % step == 0) continue;
+			self->bytes[out++] = self->bytes[i];
+		}
+		self->length = out;
+	} else {
+		return TYPE_ERROR(int or slice, argv[1]);
+	}
 })
 
 KRK_METHOD(bytearray,__len__,{
-	return INTEGER_VAL(AS_BYTES(self->actual)->length);
+	return INTEGER_VAL(self->length);
 })
 
 KRK_METHOD(bytearray,__contains__,{
 	METHOD_TAKES_EXACTLY(1);
-	CHECK_ARG(1,int,krk_integer_type,val);
-	for (size_t i = 0; i < AS_BYTES(self->actual)->length; ++i) {
-		if (AS_BYTES(self->actual)->bytes[i] == val) return BOOLEAN_VAL(1);
+	if (IS_INTEGER(argv[1])) {
+		uint8_t val;
+		if (!byteValue(argv[1], &val)) return NONE_VAL();
+		return BOOLEAN_VAL(self->length && memchr(self->bytes, val, self->length) != NULL);
+	}
+	KrkBuffer needle;
+	if (!krk_getBuffer(argv[1], &needle, 0)) return NONE_VAL();
+	return BOOLEAN_VAL(krk_findBytes((char*)self->bytes, self->length, (char*)needle.bytes, needle.length) != NULL);
+})
+
+KRK_METHOD(bytearray,find,{
+	METHOD_TAKES_EXACTLY(1);
+	KrkBuffer needle;
+	if (!krk_getBuffer(argv[1], &needle, 0)) return NONE_VAL();
+	const char * found = krk_findBytes((char*)self->bytes, self->length, (char*)needle.bytes, needle.length);
+	return INTEGER_VAL(found ? found - (char*)self->bytes : -1);
+})
+
+KRK_METHOD(bytearray,append,{
+	METHOD_TAKES_EXACTLY(1);
+	uint8_t val;
+	if (!byteValue(argv[1], &val)) return NONE_VAL();
+	bytearrayReserve(self, self->length + 1);
+	self->bytes[self->length++] = val;
+})
+
+KRK_METHOD(bytearray,extend,{
+	METHOD_TAKES_EXACTLY(1);
+	bytearrayExtend(self, argv[1]);
+})
+
+KRK_METHOD(bytearray,__iadd__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!isBuffer(argv[1])) return NOTIMPL_VAL();
+	if (!bytearrayReplace(self, self->length, self->length, argv[1])) return NONE_VAL();
+	return argv[0];
+})
+
+KRK_METHOD(bytearray,__add__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!isBuffer(argv[1])) return NOTIMPL_VAL();
+	struct ByteArray * out = (struct ByteArray*)krk_newInstance(vm.baseClasses->bytearrayClass);
+	krk_push(OBJECT_VAL(out));
+	KrkBuffer them;
+	if (!krk_getBuffer(argv[1], &them, 0)) return NONE_VAL();
+	bytearrayReserve(out, self->length + them.length);
+	/* Reserving may have collected; nothing it frees can be ours, but look again anyway. */
+	krk_getBuffer(argv[1], &them, 0);
+	if (self->length) memcpy(out->bytes, self->bytes, self->length);
+	if (them.length) memcpy(out->bytes + self->length, them.bytes, them.length);
+	out->length = self->length + them.length;
+	return krk_pop();
+})
+
+KRK_METHOD(bytearray,pop,{
+	METHOD_TAKES_AT_MOST(1);
+	krk_integer_type index = -1;
+	if (argc > 1) {
+		CHECK_ARG(1,int,krk_integer_type,_index);
+		index = _index;
 	}
-	return BOOLEAN_VAL(0);
+	if (index < 0) index += self->length;
+	if (index < 0 || index >= (krk_integer_type)self->length) {
+		return krk_runtimeError(vm.exceptions->indexError, "pop index out of range");
+	}
+	uint8_t val = self->bytes[index];
+	bytearrayReplace(self, index, index + 1, NONE_VAL());
+	return INTEGER_VAL(val);
+})
+
+KRK_METHOD(bytearray,clear,{
+	METHOD_TAKES_NONE();
+	self->length = 0;
+})
+
+KRK_METHOD(bytearray,copy,{
+	METHOD_TAKES_NONE();
+	struct ByteArray * out = (struct ByteArray*)krk_newInstance(vm.baseClasses->bytearrayClass);
+	krk_push(OBJECT_VAL(out));
+	bytearrayReserve(out, self->length);
+	if (self->length) memcpy(out->bytes, self->bytes, self->length);
+	out->length = self->length;
+	return krk_pop();
 })
 
 KRK_METHOD(bytearray,decode,{
 	METHOD_TAKES_NONE();
-	return OBJECT_VAL(krk_copyString((char*)AS_BYTES(self->actual)->bytes, AS_BYTES(self->actual)->length));
+	return OBJECT_VAL(krk_copyString((char*)self->bytes, self->length));
 })
 
 KRK_METHOD(bytearray,__iter__,{
@@ -369,12 +645,226 @@ KRK_METHOD(bytearray,__iter__,{
 	KrkInstance * output = krk_newInstance(vm.baseClasses->bytesiteratorClass);
 
 	krk_push(OBJECT_VAL(output));
-	FUNC_NAME(bytesiterator,__init__)(2, (KrkValue[]){krk_peek(0), self->actual},0);
+	FUNC_NAME(bytesiterator,__init__)(2, (KrkValue[]){krk_peek(0), argv[0]},0);
 	krk_pop();
 
 	return OBJECT_VAL(output);
 })
 
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct MemoryView *
+
+static void _memoryview_gcscan(KrkInstance * self) {
+	krk_markValue(((struct MemoryView*)self)->obj);
+}
+
+static int _memoryview_getbuffer(KrkInstance * self, KrkBuffer * buffer) {
+	struct MemoryView * me = (struct MemoryView*)self;
+	if (IS_NONE(me->obj)) {
+		krk_runtimeError(vm.exceptions->valueError, "operation forbidden on released memoryview object");
+		return 0;
+	}
+	KrkBuffer whole;
+	if (!krk_getBuffer(me->obj, &whole, 0)) return 0;
+	if (whole.length < me->offset + me->length) {
+		krk_runtimeError(vm.exceptions->valueError, "memoryview refers to %zu bytes past the end of its buffer",
+			me->offset + me->length - whole.length);
+		return 0;
+	}
+	buffer->bytes = whole.bytes + me->offset;
+	buffer->length = me->length;
+	buffer->readonly = whole.readonly || me->readonly;
+	return 1;
+}
+
+KRK_METHOD(memoryview,__init__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (IS_memoryview(argv[1])) {
+		struct MemoryView * them = AS_memoryview(argv[1]);
+		if (IS_NONE(them->obj)) return krk_runtimeError(vm.exceptions->valueError, "operation forbidden on released memoryview object");
+		self->obj = them->obj;
+		self->offset = them->offset;
+		self->length = them->length;
+		self->readonly = them->readonly;
+	} else {
+		KrkBuffer buffer;
+		if (!krk_getBuffer(argv[1], &buffer, 0)) return NONE_VAL();
+		self->obj = argv[1];
+		self->offset = 0;
+		self->length = buffer.length;
+		self->readonly = buffer.readonly;
+	}
+	krk_gcWriteBarrier((KrkObj*)self);
+	return argv[0];
+})
+
+#define VIEW_BUFFER(name) KrkBuffer name; if (!krk_getBuffer(argv[0], &name, 0)) return NONE_VAL()
+
+KRK_METHOD(memoryview,__len__,{
+	METHOD_TAKES_NONE();
+	VIEW_BUFFER(buffer);
+	return INTEGER_VAL(buffer.length);
+})
+
+KRK_METHOD(memoryview,nbytes,{
+	METHOD_TAKES_NONE();
+	VIEW_BUFFER(buffer);
+	return INTEGER_VAL(buffer.length);
+})
+
+KRK_METHOD(memoryview,readonly,{
+	METHOD_TAKES_NONE();
+	VIEW_BUFFER(buffer);
+	return BOOLEAN_VAL(buffer.readonly);
+})
+
+KRK_METHOD(memoryview,obj,{
+	METHOD_TAKES_NONE();
+	VIEW_BUFFER(buffer);
+	return self->obj;
+})
+
+KRK_METHOD(memoryview,__repr__,{
+	METHOD_TAKES_NONE();
+	char tmp[64];
+	size_t len = snprintf(tmp, sizeof(tmp), "<%smemory at %p>", IS_NONE(self->obj) ? "released " : "", (void*)self);
+	return OBJECT_VAL(krk_copyString(tmp, len));
+})
+
+KRK_METHOD(memoryview,__getitem__,{
+	METHOD_TAKES_EXACTLY(1);
+	VIEW_BUFFER(buffer);
+
+	if (IS_INTEGER(argv[1])) {
+		CHECK_ARG(1,int,krk_integer_type,asInt);
+		if (asInt < 0) asInt += (long)buffer.length;
+		if (asInt < 0 || asInt >= (long)buffer.length) {
+			return krk_runtimeError(vm.exceptions->indexError, "index out of bounds on dimension 1");
+		}
+		return INTEGER_VAL(buffer.bytes[asInt]);
+	} else if (IS_slice(argv[1])) {
+		KRK_SLICER(argv[1],buffer.length) {
+			return NONE_VAL();
+		}
+		if (step != 1) {
+			return krk_runtimeError(vm.exceptions->notImplementedError, "memoryview slices must be contiguous");
+		}
+		struct MemoryView * out = (struct MemoryView*)krk_newInstance(vm.baseClasses->memoryviewClass);
+		out->obj = self->obj;
+		out->offset = self->offset + start;
+		out->length = end > start ? end - start : 0;
+		out->readonly = self->readonly;
+		return OBJECT_VAL(out);
+	} else {
+		return TYPE_ERROR(int or slice, argv[1]);
+	}
+})
+
+KRK_METHOD(memoryview,__setitem__,{
+	METHOD_TAKES_EXACTLY(2);
+	KrkBuffer buffer;
+	if (!krk_getBuffer(argv[0], &buffer, 1)) return NONE_VAL();
+
+	if (IS_INTEGER(argv[1])) {
+		CHECK_ARG(1,int,krk_integer_type,asInt);
+		uint8_t val;
+		if (!byteValue(argv[2], &val)) return NONE_VAL();
+		if (asInt < 0) asInt += (long)buffer.length;
+		if (asInt < 0 || asInt >= (long)buffer.length) {
+			return krk_runtimeError(vm.exceptions->indexError, "index out of bounds on dimension 1");
+		}
+		buffer.bytes[asInt] = val;
+		return argv[2];
+	} else if (IS_slice(argv[1])) {
+		KRK_SLICER(argv[1],buffer.length) {
+			return NONE_VAL();
+		}
+		if (step != 1) {
+			return krk_runtimeError(vm.exceptions->notImplementedError, "memoryview slices must be contiguous");
+		}
+		KrkBuffer source;
+		if (!krk_getBuffer(argv[2], &source, 0)) return NONE_VAL();
+		size_t length = end > start ? end - start : 0;
+		if (source.length != length) {
+			return krk_runtimeError(vm.exceptions->valueError, "memoryview assignment: lvalue and rvalue have different structures");
+		}
+		if (length) memmove(buffer.bytes + start, source.bytes, length);
+		return argv[2];
+	} else {
+		return TYPE_ERROR(int or slice, argv[1]);
+	}
+})
+
+KRK_METHOD(memoryview,__eq__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (IS_NONE(self->obj)) return BOOLEAN_VAL(krk_valuesSame(argv[0], argv[1]));
+	return buffersEqual(argv[0], argv[1]);
+})
+
+KRK_METHOD(memoryview,tobytes,{
+	METHOD_TAKES_NONE();
+	VIEW_BUFFER(buffer);
+	return OBJECT_VAL(krk_newBytes(buffer.length, buffer.bytes));
+})
+
+KRK_METHOD(memoryview,tolist,{
+	METHOD_TAKES_NONE();
+	VIEW_BUFFER(buffer);
+	KrkValue list = krk_list_of(0, NULL, 0);
+	krk_push(list);
+	/* Nothing here can run managed code, so the buffer stays put. */
+	for (size_t i = 0; i < buffer.length; ++i) {
+		krk_writeValueArray(AS_LIST(list), INTEGER_VAL(buffer.bytes[i]));
+	}
+	return krk_pop();
+})
+
+KRK_METHOD(memoryview,__iter__,{
+	METHOD_TAKES_NONE();
+	VIEW_BUFFER(buffer);
+	KrkInstance * output = krk_newInstance(vm.baseClasses->bytesiteratorClass);
+
+	krk_push(OBJECT_VAL(output));
+	FUNC_NAME(bytesiterator,__init__)(2, (KrkValue[]){krk_peek(0), argv[0]},0);
+	krk_pop();
+
+	return OBJECT_VAL(output);
+})
+
+KRK_METHOD(memoryview,release,{
+	METHOD_TAKES_NONE();
+	self->obj = NONE_VAL();
+})
+
+KRK_METHOD(memoryview,__enter__,{
+	METHOD_TAKES_NONE();
+	VIEW_BUFFER(buffer);
+	return argv[0];
+})
+
+KRK_METHOD(memoryview,__exit__,{
+	self->obj = NONE_VAL();
+})
+
+#undef VIEW_BUFFER
+
+int krk_getBuffer(KrkValue value, KrkBuffer * buffer, int writable) {
+	if (IS_BYTES(value)) {
+		buffer->bytes = AS_BYTES(value)->bytes;
+		buffer->length = AS_BYTES(value)->length;
+		buffer->readonly = 1;
+	} else if (IS_INSTANCE(value) && AS_INSTANCE(value)->_class->_ongetbuffer) {
+		if (!AS_INSTANCE(value)->_class->_ongetbuffer(AS_INSTANCE(value), buffer)) return 0;
+	} else {
+		krk_runtimeError(vm.exceptions->typeError, "a bytes-like object is required, not '%s'", krk_typeName(value));
+		return 0;
+	}
+	if (writable && buffer->readonly) {
+		krk_runtimeError(vm.exceptions->typeError, "a writable bytes-like object is required, not '%s'", krk_typeName(value));
+		return 0;
+	}
+	return 1;
+}
 
 _noexport
 void _createAndBind_bytesClass(void) {
@@ -384,10 +874,12 @@ void _createAndBind_bytesClass(void) {
 		"@brief An array of bytes.\n"
 		"@arguments iter=None\n\n"
 		"Creates a new @ref bytes object. If @p iter is provided, it should be a @ref tuple or @ref list "
-		"of integers within the range @c 0 and @c 255.");
+		"of integers within the range @c 0 and @c 255, or a bytes-like object to copy.");
 	BIND_METHOD(bytes,__repr__);
 	BIND_METHOD(bytes,__len__);
 	BIND_METHOD(bytes,__contains__);
+	BIND_METHOD(bytes,find);
+	BIND_METHOD(bytes,index);
 	BIND_METHOD(bytes,__getitem__);
 	BIND_METHOD(bytes,__eq__);
 	BIND_METHOD(bytes,__add__);
@@ -407,18 +899,74 @@ void _createAndBind_bytesClass(void) {
 
 	KrkClass * bytearray = ADD_BASE_CLASS(vm.baseClasses->bytearrayClass, "bytearray", vm.baseClasses->objectClass);
 	bytearray->allocSize = sizeof(struct ByteArray);
-	bytearray->_ongcscan = _bytearray_gcscan;
+	bytearray->_ongcsweep = _bytearray_gcsweep;
+	bytearray->_ongetbuffer = _bytearray_getbuffer;
 	KRK_DOC(BIND_METHOD(bytearray,__init__),
 		"@brief A mutable array of bytes.\n"
-		"@arguments bytes=None");
+		"@arguments source=None\n\n"
+		"Creates a new @ref bytearray holding a copy of the bytes-like object @p source, the integers "
+		"from an iterable @p source, or, if @p source is an integer, that many zero bytes. "
+		"Space is kept past the end so that appending is amortized constant time.");
 	BIND_METHOD(bytearray,__repr__);
 	BIND_METHOD(bytearray,__len__);
 	BIND_METHOD(bytearray,__contains__);
 	BIND_METHOD(bytearray,__getitem__);
 	BIND_METHOD(bytearray,__setitem__);
+	BIND_METHOD(bytearray,__delitem__);
 	BIND_METHOD(bytearray,__eq__);
 	BIND_METHOD(bytearray,__iter__);
+	BIND_METHOD(bytearray,__add__);
+	BIND_METHOD(bytearray,__iadd__);
 	BIND_METHOD(bytearray,decode);
+	KRK_DOC(BIND_METHOD(bytearray,find),
+		"@brief Index of the first occurrence of @p sub, or @c -1.\n"
+		"@arguments sub");
+	KRK_DOC(BIND_METHOD(bytearray,append),
+		"@brief Add the byte @p x to the end.\n"
+		"@arguments x");
+	KRK_DOC(BIND_METHOD(bytearray,extend),
+		"@brief Add the bytes of a bytes-like object, or the integers of an iterable, to the end.\n"
+		"@arguments iterable");
+	KRK_DOC(BIND_METHOD(bytearray,pop),
+		"@brief Remove and return the byte at @p index.\n"
+		"@arguments index=-1");
+	KRK_DOC(BIND_METHOD(bytearray,clear),
+		"@brief Remove every byte.");
+	KRK_DOC(BIND_METHOD(bytearray,copy),
+		"@brief A new @ref bytearray with the same bytes.");
 	krk_defineNative(&bytearray->methods,"__str__",FUNC_NAME(bytearray,__repr__)); /* alias */
+	krk_attachNamedValue(&bytearray->methods, "__hash__", NONE_VAL());
 	krk_finalizeClass(bytearray);
+
+	KrkClass * memoryview = ADD_BASE_CLASS(vm.baseClasses->memoryviewClass, "memoryview", vm.baseClasses->objectClass);
+	memoryview->obj.flags |= KRK_OBJ_FLAGS_NO_INHERIT;
+	memoryview->allocSize = sizeof(struct MemoryView);
+	memoryview->_ongcscan = _memoryview_gcscan;
+	memoryview->_ongetbuffer = _memoryview_getbuffer;
+	KRK_DOC(BIND_METHOD(memoryview,__init__),
+		"@brief A view of the bytes of another object, without copying them.\n"
+		"@arguments obj\n\n"
+		"@p obj may be @ref bytes, a @ref bytearray, an @c mmap, or another view. "
+		"Slicing a view makes a view of part of the same bytes, and assigning to a view of something "
+		"writable writes through to it. Only contiguous slices are supported.");
+	BIND_METHOD(memoryview,__len__);
+	BIND_METHOD(memoryview,__repr__);
+	BIND_METHOD(memoryview,__getitem__);
+	BIND_METHOD(memoryview,__setitem__);
+	BIND_METHOD(memoryview,__eq__);
+	BIND_METHOD(memoryview,__iter__);
+	BIND_METHOD(memoryview,__enter__);
+	BIND_METHOD(memoryview,__exit__);
+	BIND_PROP(memoryview,nbytes);
+	BIND_PROP(memoryview,readonly);
+	BIND_PROP(memoryview,obj);
+	KRK_DOC(BIND_METHOD(memoryview,tobytes),
+		"@brief Copy the bytes in the view to a new @ref bytes.");
+	KRK_DOC(BIND_METHOD(memoryview,tolist),
+		"@brief The bytes in the view, as a @ref list of integers.");
+	KRK_DOC(BIND_METHOD(memoryview,release),
+		"@brief Let go of the viewed object. Further use of the view raises @ref ValueError.");
+	krk_defineNative(&memoryview->methods,"__str__",FUNC_NAME(memoryview,__repr__)); /* alias */
+	krk_attachNamedValue(&memoryview->methods, "__hash__", NONE_VAL());
+	krk_finalizeClass(memoryview);
 }
@@ -20,7 +20,8 @@ KrkValue krk_dict_of(int argc, const KrkValue argv[], int hasKw) {
 	KrkInstance * outDict = krk_newInstance(vm.baseClasses->dictClass);
 	krk_push(OBJECT_VAL(outDict));
 	krk_initTable(&((KrkDict*)outDict)->entries);
-	krk_tableAdjustCapacity(&((KrkDict*)outDict)->entries, argc);
+	((KrkDict*)outDict)->entries.owner = (KrkObj*)outDict;
+	krk_tableAdjustCapacity(&((KrkDict*)outDict)->entries, argc / 2);
 	for (int ind = 0; ind < argc; ind += 2) {
 		krk_tableSet(&((KrkDict*)outDict)->entries, argv[ind], argv[ind+1]);
 	}
@@ -28,6 +29,7 @@ KrkValue krk_dict_of(int argc, const KrkValue argv[], int hasKw) {
 }
 
 static void _dict_gcscan(KrkInstance * self) {
+	((KrkDict*)self)->entries.owner = (KrkObj*)self;
 	krk_markTable(&((KrkDict*)self)->entries);
 }
 
@@ -74,6 +76,7 @@ static int unpackKeyValueSequence(KrkDict * self, KrkValue array) {
 KRK_METHOD(dict,__init__,{
 	METHOD_TAKES_AT_MOST(1);
 	krk_initTable(&self->entries);
+	self->entries.owner = (KrkObj*)self;
 
 	if (argc > 1) {
 		if (unpackKeyValueSequence(self, argv[1])) return NONE_VAL();
@@ -143,7 +146,7 @@ KRK_METHOD(dict,__repr__,{
 	pushStringBuilder(&sb,'{');
 
 	size_t c = 0;
-	size_t len = self->entries.capacity;
+	size_t len = self->entries.used;
 	for (size_t i = 0; i < len; ++i) {
 		KrkTableEntry * entry = &self->entries.entries[i];
 		if (IS_KWARGS(entry->key)) continue;
@@ -214,6 +217,20 @@ KRK_METHOD(dict,setdefault,{
 	return out;
 })
 
+KRK_METHOD(dict,popitem,{
+	METHOD_TAKES_NONE();
+	if (!self->entries.count) return krk_runtimeError(vm.exceptions->keyError, "popitem(): dictionary is empty");
+	/* Entries are in insertion order, so the newest one is the last one in use. */
+	KrkTableEntry * entry = &self->entries.entries[self->entries.used - 1];
+	KrkTuple * outValue = krk_newTuple(2);
+	krk_push(OBJECT_VAL(outValue));
+	outValue->values.values[0] = entry->key;
+	outValue->values.values[1] = entry->value;
+	outValue->values.count = 2;
+	krk_tableDelete(&self->entries, entry->key);
+	return krk_pop();
+})
+
 KRK_METHOD(dict,update,{
 	METHOD_TAKES_AT_MOST(1);
 	if (argc > 1) {
@@ -276,6 +293,11 @@ KrkValue krk_dict_nth_key_fast(size_t capacity, KrkTableEntry * entries, size_t
 	return NONE_VAL();
 }
 
+/* Entries may have been added, removed or moved since the iterator started, so its position means nothing now. */
+static KrkValue mutated(void) {
+	return krk_runtimeError(vm.exceptions->valueError, "dict mutated during iteration");
+}
+
 #undef CURRENT_CTYPE
 #define CURRENT_CTYPE struct DictItems *
 
@@ -288,18 +310,22 @@ KRK_METHOD(dictitems,__init__,{
 	CHECK_ARG(1,dict,KrkDict*,source);
 	self->dict = argv[1];
 	self->i = 0;
+	self->version = source->entries.version;
+	krk_gcWriteBarrier((KrkObj*)self);
 	return argv[0];
 })
 
 KRK_METHOD(dictitems,__iter__,{
 	METHOD_TAKES_NONE();
 	self->i = 0;
+	self->version = AS_DICT(self->dict)->version;
 	return argv[0];
 })
 
 KRK_METHOD(dictitems,__call__,{
+	if (self->version != AS_DICT(self->dict)->version) return mutated();
 	do {
-		if (self->i >= AS_DICT(self->dict)->capacity) return argv[0];
+		if (self->i >= AS_DICT(self->dict)->used) return argv[0];
 		if (!IS_KWARGS(AS_DICT(self->dict)->entries[self->i].key)) {
 			KrkTuple * outValue = krk_newTuple(2);
 			krk_push(OBJECT_VAL(outValue));
@@ -321,7 +347,7 @@ KRK_METHOD(dictitems,__repr__,{
 	pushStringBuilderStr(&sb,"dictitems([",11);
 
 	size_t c = 0;
-	size_t len = AS_DICT(self->dict)->capacity;
+	size_t len = AS_DICT(self->dict)->used;
 	for (size_t i = 0; i < len; ++i) {
 		KrkTableEntry * entry = &AS_DICT(self->dict)->entries[i];
 		if (IS_KWARGS(entry->key)) continue;
@@ -372,19 +398,23 @@ KRK_METHOD(dictkeys,__init__,{
 	CHECK_ARG(1,dict,KrkDict*,source);
 	self->dict = argv[1];
 	self->i = 0;
+	self->version = source->entries.version;
+	krk_gcWriteBarrier((KrkObj*)self);
 	return argv[0];
 })
 
 KRK_METHOD(dictkeys,__iter__,{
 	METHOD_TAKES_NONE();
 	self->i = 0;
+	self->version = AS_DICT(self->dict)->version;
 	return argv[0];
 })
 
 KRK_METHOD(dictkeys,__call__,{
 	METHOD_TAKES_NONE();
+	if (self->version != AS_DICT(self->dict)->version) return mutated();
 	do {
-		if (self->i >= AS_DICT(self->dict)->capacity) return argv[0];
+		if (self->i >= AS_DICT(self->dict)->used) return argv[0];
 		if (!IS_KWARGS(AS_DICT(self->dict)->entries[self->i].key)) {
 			krk_push(AS_DICT(self->dict)->entries[self->i].key);
 			self->i++;
@@ -402,7 +432,7 @@ KRK_METHOD(dictkeys,__repr__,{
 	pushStringBuilderStr(&sb,"dictkeys([",10);
 
 	size_t c = 0;
-	size_t len = AS_DICT(self->dict)->capacity;
+	size_t len = AS_DICT(self->dict)->used;
 	for (size_t i = 0; i < len; ++i) {
 		KrkTableEntry * entry = &AS_DICT(self->dict)->entries[i];
 		if (IS_KWARGS(entry->key)) continue;
@@ -438,19 +468,23 @@ KRK_METHOD(dictvalues,__init__,{
 	CHECK_ARG(1,dict,KrkDict*,source);
 	self->dict = argv[1];
 	self->i = 0;
+	self->version = source->entries.version;
+	krk_gcWriteBarrier((KrkObj*)self);
 	return argv[0];
 })
 
 KRK_METHOD(dictvalues,__iter__,{
 	METHOD_TAKES_NONE();
 	self->i = 0;
+	self->version = AS_DICT(self->dict)->version;
 	return argv[0];
 })
 
 KRK_METHOD(dictvalues,__call__,{
 	METHOD_TAKES_NONE();
+	if (self->version != AS_DICT(self->dict)->version) return mutated();
 	do {
-		if (self->i >= AS_DICT(self->dict)->capacity) return argv[0];
+		if (self->i >= AS_DICT(self->dict)->used) return argv[0];
 		if (!IS_KWARGS(AS_DICT(self->dict)->entries[self->i].key)) {
 			krk_push(AS_DICT(self->dict)->entries[self->i].value);
 			self->i++;
@@ -468,7 +502,7 @@ KRK_METHOD(dictvalues,__repr__,{
 	pushStringBuilderStr(&sb,"dictvalues([",12);
 
 	size_t c = 0;
-	size_t len = AS_DICT(self->dict)->capacity;
+	size_t len = AS_DICT(self->dict)->used;
 	for (size_t i = 0; i < len; ++i) {
 		KrkTableEntry * entry = &AS_DICT(self->dict)->entries[i];
 		if (IS_KWARGS(entry->key)) continue;
@@ -516,6 +550,9 @@ void _createAndBind_dictClass(void) {
 	BIND_METHOD(dict,get);
 	BIND_METHOD(dict,setdefault);
 	BIND_METHOD(dict,update);
+	KRK_DOC(BIND_METHOD(dict,popitem),
+		"@brief Remove and return the most recently added key and value.\n\n"
+		"Raises @ref KeyError if the dict is empty.");
 	krk_defineNative(&dict->methods, "__iter__", FUNC_NAME(dict,keys));
 	krk_defineNative(&dict->methods, "__str__", FUNC_NAME(dict,__repr__));
 	krk_defineNative(&dict->methods, "__class_getitem__", KrkGenericAlias)->obj.flags |= KRK_OBJ_FLAGS_FUNCTION_IS_CLASS_METHOD;
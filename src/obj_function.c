@@ -4,6 +4,7 @@
 #include <kuroko/memory.h>
 #include <kuroko/util.h>
 #include <kuroko/debug.h>
+#include <kuroko/marshal.h>
 
 /* Check for and return the name of a native function as a string object */
 static KrkValue nativeFunctionName(KrkValue func) {
@@ -26,6 +27,7 @@ static KrkTuple * functionArgs(KrkCodeObject * _self) {
 		pushStringBuilderStr(&sb, AS_CSTRING(_self->keywordArgNames.values[i]), AS_STRING(_self->keywordArgNames.values[i])->length);
 		pushStringBuilder(&sb,'=');
 		tuple->values.values[tuple->values.count++] = finishStringBuilder(&sb);
+		krk_gcWriteBarrier((KrkObj*)tuple);
 	}
 
 	if (_self->obj.flags & KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_ARGS) {
@@ -33,6 +35,7 @@ static KrkTuple * functionArgs(KrkCodeObject * _self) {
 		pushStringBuilder(&sb, '*');
 		pushStringBuilderStr(&sb, AS_CSTRING(_self->requiredArgNames.values[_self->requiredArgs]), AS_STRING(_self->requiredArgNames.values[_self->requiredArgs])->length);
 		tuple->values.values[tuple->values.count++] = finishStringBuilder(&sb);
+		krk_gcWriteBarrier((KrkObj*)tuple);
 	}
 
 	if (_self->obj.flags & KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_KWS) {
@@ -41,6 +44,7 @@ static KrkTuple * functionArgs(KrkCodeObject * _self) {
 		pushStringBuilder(&sb, '*');
 		pushStringBuilderStr(&sb, AS_CSTRING(_self->keywordArgNames.values[_self->keywordArgs]), AS_STRING(_self->keywordArgNames.values[_self->keywordArgs])->length);
 		tuple->values.values[tuple->values.count++] = finishStringBuilder(&sb);
+		krk_gcWriteBarrier((KrkObj*)tuple);
 	}
 
 	krk_pop();
@@ -169,6 +173,16 @@ KRK_METHOD(codeobject,__name__,{
 	return self->name ? OBJECT_VAL(self->name) : OBJECT_VAL(S(""));
 })
 
+KRK_METHOD(codeobject,__qualname__,{
+	ATTRIBUTE_NOT_ASSIGNABLE();
+	return self->qualname ? OBJECT_VAL(self->qualname) : FUNC_NAME(codeobject,__name__)(1,argv,0);
+})
+
+KRK_METHOD(codeobject,__file__,{
+	ATTRIBUTE_NOT_ASSIGNABLE();
+	return self->chunk.filename ? OBJECT_VAL(self->chunk.filename) : OBJECT_VAL(S(""));
+})
+
 KRK_METHOD(codeobject,__str__,{
 	METHOD_TAKES_NONE();
 	KrkValue s = FUNC_NAME(codeobject,__name__)(1,argv,0);
@@ -194,6 +208,7 @@ KRK_METHOD(codeobject,_ip_to_line,{
 
 KRK_METHOD(codeobject,__constants__,{
 	ATTRIBUTE_NOT_ASSIGNABLE();
+	if (!krk_materializeCodeObject(self)) return NONE_VAL();
 	krk_push(OBJECT_VAL(krk_newTuple(self->chunk.constants.count)));
 	memcpy(AS_TUPLE(krk_peek(0))->values.values,
 		self->chunk.constants.values,
@@ -333,6 +348,8 @@ void _createAndBind_functionClass(void) {
 	BIND_METHOD(codeobject,_ip_to_line);
 	BIND_PROP(codeobject,__constants__);
 	BIND_PROP(codeobject,__name__);
+	BIND_PROP(codeobject,__qualname__);
+	BIND_PROP(codeobject,__file__);
 	BIND_PROP(codeobject,co_flags);
 	BIND_PROP(codeobject,__args__);
 	krk_defineNative(&codeobject->methods, "__repr__", FUNC_NAME(codeobject,__str__));
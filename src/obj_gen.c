@@ -13,7 +13,8 @@
 #include <kuroko/util.h>
 #include <kuroko/debug.h>
 
-static KrkClass * generator;
+#include "private.h"
+
 /**
  * @brief Generator object implementation.
  * @extends KrkInstance
@@ -23,15 +24,18 @@ struct generator {
 	KrkClosure * closure;
 	KrkValue * args;
 	size_t argCount;
+	size_t capacity;
 	uint8_t * ip;
 	int running;
 	int started;
+	int delegating;
 	KrkValue result;
 	int type;
+	KrkValueArray upvalues;
 };
 
 #define AS_generator(o) ((struct generator *)AS_OBJECT(o))
-#define IS_generator(o) (krk_isInstanceOf(o, generator))
+#define IS_generator(o) (krk_isInstanceOf(o, vm.baseClasses->generatorClass))
 
 #define CURRENT_CTYPE struct generator *
 #define CURRENT_NAME  self
@@ -43,10 +47,14 @@ static void _generator_gcscan(KrkInstance * _self) {
 		krk_markValue(self->args[i]);
 	}
 	krk_markValue(self->result);
+	for (size_t i = 0; i < self->upvalues.count; ++i) {
+		krk_markValue(self->upvalues.values[i]);
+	}
 }
 
 static void _generator_gcsweep(KrkInstance * self) {
 	free(((struct generator*)self)->args);
+	krk_freeValueArray(&((struct generator*)self)->upvalues);
 }
 
 static void _set_generator_done(struct generator * self) {
@@ -70,16 +78,58 @@ KrkInstance * krk_buildGenerator(KrkClosure * closure, KrkValue * argsIn, size_t
 	memcpy(args, argsIn, sizeof(KrkValue) * argCount);
 
 	/* Create a generator object */
-	struct generator * self = (struct generator *)krk_newInstance(generator);
+	struct generator * self = (struct generator *)krk_newInstance(vm.baseClasses->generatorClass);
 	self->args = args;
 	self->argCount = argCount;
+	self->capacity = argCount;
 	self->closure = closure;
 	self->ip = self->closure->function->chunk.code;
 	self->result = NONE_VAL();
 	self->type = closure->function->obj.flags & (KRK_OBJ_FLAGS_CODEOBJECT_IS_GENERATOR | KRK_OBJ_FLAGS_CODEOBJECT_IS_COROUTINE);
+	krk_initValueArray(&self->upvalues);
+	self->upvalues.owner = (KrkObj*)self;
 	return (KrkInstance *)self;
 }
 
+/**
+ * @brief Close the upvalues captured from a suspending generator's frame.
+ *
+ * Closures made inside the generator may outlive its place on the stack, which
+ * other frames reuse while it is suspended. Their upvalues hold the values until
+ * @ref _reopen_upvalues puts them back, with their offsets into the frame.
+ */
+static void _close_upvalues(struct generator * self, size_t slots) {
+	while (krk_currentThread.openUpvalues && krk_currentThread.openUpvalues->location >= (int)slots) {
+		KrkUpvalue * upvalue = krk_currentThread.openUpvalues;
+		krk_currentThread.openUpvalues = upvalue->next;
+		krk_writeValueArray(&self->upvalues, OBJECT_VAL(upvalue));
+		krk_writeValueArray(&self->upvalues, INTEGER_VAL(upvalue->location - slots));
+		upvalue->closed = krk_currentThread.stack[upvalue->location];
+		upvalue->location = -1;
+		upvalue->next = NULL;
+		krk_gcWriteBarrier((KrkObj*)upvalue);
+	}
+}
+
+/**
+ * @brief Reopen upvalues closed by @ref _close_upvalues in the resumed frame at @p slots.
+ *
+ * They were closed from the top of the stack down, so they are reopened in reverse
+ * to leave the open list sorted with the highest slot first.
+ */
+static void _reopen_upvalues(struct generator * self, size_t slots) {
+	while (self->upvalues.count) {
+		KrkUpvalue * upvalue = (KrkUpvalue*)AS_OBJECT(self->upvalues.values[self->upvalues.count - 2]);
+		size_t offset = AS_INTEGER(self->upvalues.values[self->upvalues.count - 1]);
+		self->upvalues.count -= 2;
+		upvalue->location = slots + offset;
+		upvalue->owner = &krk_currentThread;
+		krk_currentThread.stack[upvalue->location] = upvalue->closed;
+		upvalue->next = krk_currentThread.openUpvalues;
+		krk_currentThread.openUpvalues = upvalue;
+	}
+}
+
 KRK_METHOD(generator,__repr__,{
 	METHOD_TAKES_NONE();
 
@@ -106,9 +156,81 @@ KRK_METHOD(generator,__iter__,{
 	return OBJECT_VAL(self);
 })
 
+/**
+ * @brief Whether a generator suspended at @p ip is inside a @c yield @c from loop.
+ *
+ * The compiler emits @c OP_YIELD_FROM, @c OP_YIELD and an @c OP_LOOP back to the
+ * @c OP_YIELD_FROM; a generator suspended by that @c OP_YIELD resumes at the loop.
+ */
+static int _suspended_in_yield_from(uint8_t * ip, uint8_t * code) {
+	if (ip[0] != OP_LOOP) return 0;
+	size_t offset = (ip[1] << 8) | ip[2];
+	if (offset > (size_t)(ip + 3 - code)) return 0;
+	return ip[3 - offset] == OP_YIELD_FROM;
+}
+
+FUNC_SIG(generator,__call__);
+
+/**
+ * @brief Resume the generator @p self is delegating to without restoring its own frame.
+ *
+ * While @p self sits in a @c yield @c from loop over another generator, each value
+ * the inner generator yields is passed straight out again. Rather than copying
+ * the outer frame back onto the stack for every step, resume the inner generator
+ * directly (which may in turn delegate further) beneath a stand-in frame for
+ * @p self, so tracebacks still show every level.
+ *
+ * Returns 1 and sets @p out if the inner generator yielded. Otherwise it finished
+ * or raised, and the outer frame must be resumed to deal with that: it will loop
+ * back to @c OP_YIELD_FROM, which either collects the inner generator's result
+ * or handles the pending exception.
+ */
+static int _resume_delegate(struct generator * self, KrkValue sent, KrkValue * out) {
+	KrkValue inner = self->args[self->argCount - 2];
+	if (!IS_generator(inner)) return 0;
+	struct generator * delegate = AS_generator(inner);
+	if (!delegate->ip || !delegate->started || delegate->running) return 0;
+	if (krk_currentThread.frameCount + 1 >= vm.maximumCallDepth) return 0;
+
+	size_t frameCount = krk_currentThread.frameCount;
+	KrkCallFrame * frame = &krk_currentThread.frames[krk_currentThread.frameCount++];
+	frame->closure = self->closure;
+	frame->ip      = self->ip;
+	frame->slots   = krk_currentThread.stackTop - krk_currentThread.stack;
+	frame->outSlots = frame->slots;
+	frame->globals = &self->closure->function->globalsContext->fields;
+
+	KrkValue args[2] = {inner, sent};
+	self->running = 1;
+	KrkValue result = FUNC_NAME(generator,__call__)(2, args, 0);
+	self->running = 0;
+	/* An exception leaves the frames it was raised in behind; they are gone either way. */
+	krk_currentThread.frameCount = frameCount;
+
+	if ((krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) || krk_valuesSame(result, inner)) return 0;
+
+	/* Keep the saved stack as it would be had the outer frame yielded this itself. */
+	self->args[self->argCount - 1] = result;
+	krk_gcWriteBarrier((KrkObj*)self);
+	*out = result;
+	return 1;
+}
+
 KRK_METHOD(generator,__call__,{
 	METHOD_TAKES_AT_MOST(1);
 	if (!self->ip) return OBJECT_VAL(self);
+
+	KrkValue sent = argc > 1 ? argv[1] : NONE_VAL();
+	if (self->delegating) {
+		KrkValue result;
+		if (_resume_delegate(self, sent, &result)) return result;
+	}
+
+	/* Each level of a chain of delegating generators is entered through here the first time. */
+	if (unlikely(krk_currentThread.frameCount == vm.maximumCallDepth)) {
+		return krk_runtimeError(vm.exceptions->baseException, "maximum recursion depth exceeded");
+	}
+
 	/* Prepare frame */
 	KrkCallFrame * frame = &krk_currentThread.frames[krk_currentThread.frameCount++];
 	frame->closure = self->closure;
@@ -118,30 +240,27 @@ KRK_METHOD(generator,__call__,{
 	frame->globals = &self->closure->function->globalsContext->fields;
 
 	/* Stick our stack on their stack */
-	for (size_t i = 0; i < self->argCount; ++i) {
-		krk_push(self->args[i]);
-	}
+	while ((size_t)(krk_currentThread.stackMax - krk_currentThread.stackTop) < self->argCount) krk_growStack();
+	memcpy(krk_currentThread.stackTop, self->args, sizeof(KrkValue) * self->argCount);
+	krk_currentThread.stackTop += self->argCount;
 
 	if (self->started) {
-		krk_pop();
-		if (argc > 1) {
-			krk_push(argv[1]);
-		} else {
-			krk_push(NONE_VAL());
-		}
+		/* Replace the value we yielded with the one we were sent */
+		krk_currentThread.stackTop[-1] = sent;
 	}
+	_reopen_upvalues(self, frame->slots);
 
 	/* Jump into the iterator */
 	self->running = 1;
-	size_t stackBefore = krk_currentThread.stackTop - krk_currentThread.stack;
 	KrkValue result = krk_runNext();
-	size_t stackAfter = krk_currentThread.stackTop - krk_currentThread.stack;
 	self->running = 0;
 
 	self->started = 1;
+	self->delegating = 0;
 
 	if (IS_KWARGS(result) && AS_INTEGER(result) == 0) {
 		self->result = krk_pop();
+		krk_gcWriteBarrier((KrkObj*)self);
 		_set_generator_done(self);
 		return OBJECT_VAL(self);
 	}
@@ -153,20 +272,18 @@ KRK_METHOD(generator,__call__,{
 		return NONE_VAL();
 	}
 
-	/* Determine the stack state */
-	if (stackAfter > stackBefore) {
-		size_t newArgs = stackAfter - stackBefore;
-		self->args = realloc(self->args, sizeof(KrkValue) * (self->argCount + newArgs));
-		self->argCount += newArgs;
-	} else if (stackAfter < stackBefore) {
-		size_t deadArgs = stackBefore - stackAfter;
-		self->args = realloc(self->args, sizeof(KrkValue) * (self->argCount - deadArgs));
-		self->argCount -= deadArgs;
+	/* Save stack entries; the buffer only ever grows, so steady-state resumes don't reallocate. */
+	size_t count = krk_currentThread.stackTop - (krk_currentThread.stack + frame->slots);
+	if (count > self->capacity) {
+		self->args = realloc(self->args, sizeof(KrkValue) * count);
+		self->capacity = count;
 	}
-
-	/* Save stack entries */
-	memcpy(self->args, krk_currentThread.stackTop - self->argCount, sizeof(KrkValue) * self->argCount);
+	self->argCount = count;
+	memcpy(self->args, krk_currentThread.stackTop - count, sizeof(KrkValue) * count);
+	_close_upvalues(self, frame->slots);
+	krk_gcWriteBarrier((KrkObj*)self);
 	self->ip      = frame->ip;
+	self->delegating = count >= 2 && _suspended_in_yield_from(self->ip, self->closure->function->chunk.code);
 
 	krk_currentThread.stackTop = krk_currentThread.stack + frame->slots;
 
@@ -186,6 +303,17 @@ KRK_METHOD(generator,__finish__,{
 	return self->result;
 })
 
+_noexport
+KrkValue krk_generatorSend(KrkValue generator, KrkValue sent) {
+	KrkValue args[2] = {generator, sent};
+	return FUNC_NAME(generator,send)(2, args, 0);
+}
+
+_noexport
+KrkValue krk_generatorResult(KrkValue generator) {
+	return AS_generator(generator)->result;
+}
+
 /*
  * For compatibility with Python...
  */
@@ -222,7 +350,7 @@ int krk_getAwaitable(void) {
 
 _noexport
 void _createAndBind_generatorClass(void) {
-	generator = ADD_BASE_CLASS(vm.baseClasses->generatorClass, "generator", vm.baseClasses->objectClass);
+	KrkClass * generator = ADD_BASE_CLASS(vm.baseClasses->generatorClass, "generator", vm.baseClasses->objectClass);
 	generator->allocSize = sizeof(struct generator);
 	generator->_ongcscan = _generator_gcscan;
 	generator->_ongcsweep = _generator_gcsweep;
@@ -5,6 +5,20 @@
 #include <kuroko/util.h>
 #include <kuroko/threads.h>
 
+#include "private.h"
+
+#ifdef ENABLE_THREADING
+/* Whoever holds a list's lock may be parked at a safepoint inside a callback, so waiting for it is a blocking call. */
+#define LIST_LOCK(how,l) do { \
+	if (pthread_rwlock_try ## how ## lock(&(l)->rwlock)) { \
+		krk_beginBlocking(); \
+		pthread_rwlock_ ## how ## lock(&(l)->rwlock); \
+		krk_endBlocking(); \
+	} } while (0)
+#else
+#define LIST_LOCK(how,l) do { } while (0)
+#endif
+
 #define LIST_WRAP_INDEX() \
 	if (index < 0) index += self->values.count; \
 	if (unlikely(index < 0 || index >= (krk_integer_type)self->values.count)) return krk_runtimeError(vm.exceptions->indexError, "list index out of range: " PRIkrk_int, index)
@@ -15,6 +29,8 @@
 	if (val > (krk_integer_type)self->values.count) val = self->values.count
 
 static void _list_gcscan(KrkInstance * self) {
+	/* Subclasses that never called list.__init__ still need their stores seen once they are old. */
+	((KrkList*)self)->values.owner = (KrkObj*)self;
 	for (size_t i = 0; i < ((KrkList*)self)->values.count; ++i) {
 		krk_markValue(((KrkList*)self)->values.values[i]);
 	}
@@ -32,12 +48,14 @@ KrkValue krk_list_of(int argc, const KrkValue argv[], int hasKw) {
 	KrkValue outList = OBJECT_VAL(krk_newInstance(vm.baseClasses->listClass));
 	krk_push(outList);
 	krk_initValueArray(AS_LIST(outList));
+	AS_LIST(outList)->owner = AS_OBJECT(outList);
 
 	if (argc) {
 		AS_LIST(outList)->capacity = argc;
 		AS_LIST(outList)->values = GROW_ARRAY(KrkValue, AS_LIST(outList)->values, 0, argc);
 		memcpy(AS_LIST(outList)->values, argv, sizeof(KrkValue) * argc);
 		AS_LIST(outList)->count = argc;
+		krk_gcWriteBarrier(AS_OBJECT(outList));
 	}
 
 	pthread_rwlock_init(&((KrkList*)AS_OBJECT(outList))->rwlock, NULL);
@@ -51,13 +69,13 @@ KRK_METHOD(list,__getitem__,{
 	METHOD_TAKES_EXACTLY(1);
 	if (IS_INTEGER(argv[1])) {
 		CHECK_ARG(1,int,krk_integer_type,index);
-		if (vm.globalFlags & KRK_GLOBAL_THREADS) pthread_rwlock_rdlock(&self->rwlock);
+		if (vm.globalFlags & KRK_GLOBAL_THREADS) LIST_LOCK(rd,self);
 		LIST_WRAP_INDEX();
 		KrkValue result = self->values.values[index];
 		if (vm.globalFlags & KRK_GLOBAL_THREADS) pthread_rwlock_unlock(&self->rwlock);
 		return result;
 	} else if (IS_slice(argv[1])) {
-		pthread_rwlock_rdlock(&self->rwlock);
+		LIST_LOCK(rd,self);
 
 		KRK_SLICER(argv[1],self->values.count) {
 			pthread_rwlock_unlock(&self->rwlock);
@@ -109,7 +127,7 @@ KRK_METHOD(list,__eq__,{
 
 KRK_METHOD(list,append,{
 	METHOD_TAKES_EXACTLY(1);
-	pthread_rwlock_wrlock(&self->rwlock);
+	LIST_LOCK(wr,self);
 	krk_writeValueArray(&self->values, argv[1]);
 	pthread_rwlock_unlock(&self->rwlock);
 })
@@ -117,7 +135,7 @@ KRK_METHOD(list,append,{
 KRK_METHOD(list,insert,{
 	METHOD_TAKES_EXACTLY(2);
 	CHECK_ARG(1,int,krk_integer_type,index);
-	pthread_rwlock_wrlock(&self->rwlock);
+	LIST_LOCK(wr,self);
 	LIST_WRAP_INDEX();
 	krk_writeValueArray(&self->values, NONE_VAL());
 	memmove(
@@ -126,6 +144,7 @@ KRK_METHOD(list,insert,{
 		sizeof(KrkValue) * (self->values.count - index - 1)
 	);
 	self->values.values[index] = argv[2];
+	krk_gcWriteBarrier((KrkObj*)self);
 	pthread_rwlock_unlock(&self->rwlock);
 })
 
@@ -135,7 +154,7 @@ KRK_METHOD(list,__repr__,{
 	((KrkObj*)self)->flags |= KRK_OBJ_FLAGS_IN_REPR;
 	struct StringBuilder sb = {0};
 	pushStringBuilder(&sb, '[');
-	pthread_rwlock_rdlock(&self->rwlock);
+	LIST_LOCK(rd,self);
 	for (size_t i = 0; i < self->values.count; ++i) {
 		/* repr(self[i]) */
 		KrkClass * type = krk_getType(self->values.values[i]);
@@ -166,12 +185,13 @@ KRK_METHOD(list,__repr__,{
 			for (size_t i = 0; i < counter; ++i) { \
 				positionals->values[positionals->count] = indexer; \
 				positionals->count++; \
+				krk_gcWriteBarrier((KrkObj*)self); \
 				if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) goto _break_loop; \
 			} \
 		} while (0)
 KRK_METHOD(list,extend,{
 	METHOD_TAKES_EXACTLY(1);
-	pthread_rwlock_wrlock(&self->rwlock);
+	LIST_LOCK(wr,self);
 	KrkValueArray *  positionals = AS_LIST(argv[0]);
 	KrkValue other = argv[1];
 	if (krk_valuesSame(argv[0],other)) {
@@ -186,6 +206,7 @@ _break_loop:
 KRK_METHOD(list,__init__,{
 	METHOD_TAKES_AT_MOST(1);
 	krk_initValueArray(AS_LIST(argv[0]));
+	AS_LIST(argv[0])->owner = (KrkObj*)self;
 	pthread_rwlock_init(&self->rwlock, NULL);
 	if (argc == 2) {
 		_list_extend(2,(KrkValue[]){argv[0],argv[1]},0);
@@ -215,7 +236,7 @@ KRK_METHOD(list,__len__,{
 
 KRK_METHOD(list,__contains__,{
 	METHOD_TAKES_EXACTLY(1);
-	pthread_rwlock_rdlock(&self->rwlock);
+	LIST_LOCK(rd,self);
 	for (size_t i = 0; i < self->values.count; ++i) {
 		if (krk_valuesEqual(argv[1], self->values.values[i])) {
 			pthread_rwlock_unlock(&self->rwlock);
@@ -228,7 +249,7 @@ KRK_METHOD(list,__contains__,{
 
 KRK_METHOD(list,pop,{
 	METHOD_TAKES_AT_MOST(1);
-	pthread_rwlock_wrlock(&self->rwlock);
+	LIST_LOCK(wr,self);
 	krk_integer_type index = self->values.count - 1;
 	if (argc == 2) {
 		CHECK_ARG(1,int,krk_integer_type,ind);
@@ -255,9 +276,10 @@ KRK_METHOD(list,__setitem__,{
 	METHOD_TAKES_EXACTLY(2);
 	if (IS_INTEGER(argv[1])) {
 		CHECK_ARG(1,int,krk_integer_type,index);
-		if (vm.globalFlags & KRK_GLOBAL_THREADS) pthread_rwlock_rdlock(&self->rwlock);
+		if (vm.globalFlags & KRK_GLOBAL_THREADS) LIST_LOCK(rd,self);
 		LIST_WRAP_INDEX();
 		self->values.values[index] = argv[2];
+		krk_gcWriteBarrier((KrkObj*)self);
 		if (vm.globalFlags & KRK_GLOBAL_THREADS) pthread_rwlock_unlock(&self->rwlock);
 		return argv[2];
 	} else if (IS_slice(argv[1])) {
@@ -279,6 +301,7 @@ KRK_METHOD(list,__setitem__,{
 		for (krk_integer_type i = 0; (i < len && i < newLen); ++i) {
 			AS_LIST(argv[0])->values[start+i] = AS_LIST(argv[2])->values[i];
 		}
+		krk_gcWriteBarrier((KrkObj*)self);
 
 		while (len < newLen) {
 			FUNC_NAME(list,insert)(3, (KrkValue[]){argv[0], INTEGER_VAL(start + len), AS_LIST(argv[2])->values[len]}, 0);
@@ -324,7 +347,7 @@ KRK_METHOD(list,__delitem__,{
 
 KRK_METHOD(list,remove,{
 	METHOD_TAKES_EXACTLY(1);
-	pthread_rwlock_wrlock(&self->rwlock);
+	LIST_LOCK(wr,self);
 	for (size_t i = 0; i < self->values.count; ++i) {
 		if (krk_valuesEqual(self->values.values[i], argv[1])) {
 			pthread_rwlock_unlock(&self->rwlock);
@@ -337,7 +360,7 @@ KRK_METHOD(list,remove,{
 
 KRK_METHOD(list,clear,{
 	METHOD_TAKES_NONE();
-	pthread_rwlock_wrlock(&self->rwlock);
+	LIST_LOCK(wr,self);
 	krk_freeValueArray(&self->values);
 	pthread_rwlock_unlock(&self->rwlock);
 })
@@ -363,7 +386,7 @@ KRK_METHOD(list,index,{
 			return krk_runtimeError(vm.exceptions->typeError, "%s must be int, not '%s'", "max", krk_typeName(argv[3]));
 	}
 
-	pthread_rwlock_rdlock(&self->rwlock);
+	LIST_LOCK(rd,self);
 	LIST_WRAP_SOFT(min);
 	LIST_WRAP_SOFT(max);
 
@@ -382,7 +405,7 @@ KRK_METHOD(list,count,{
 	METHOD_TAKES_EXACTLY(1);
 	krk_integer_type count = 0;
 
-	pthread_rwlock_rdlock(&self->rwlock);
+	LIST_LOCK(rd,self);
 	for (size_t i = 0; i < self->values.count; ++i) {
 		if (krk_valuesEqual(self->values.values[i], argv[1])) count++;
 	}
@@ -393,7 +416,7 @@ KRK_METHOD(list,count,{
 
 KRK_METHOD(list,copy,{
 	METHOD_TAKES_NONE();
-	pthread_rwlock_rdlock(&self->rwlock);
+	LIST_LOCK(rd,self);
 	KrkValue result = krk_list_of(self->values.count, self->values.values, 0);
 	pthread_rwlock_unlock(&self->rwlock);
 	return result;
@@ -401,7 +424,7 @@ KRK_METHOD(list,copy,{
 
 KRK_METHOD(list,reverse,{
 	METHOD_TAKES_NONE();
-	pthread_rwlock_wrlock(&self->rwlock);
+	LIST_LOCK(wr,self);
 	for (size_t i = 0; i < (self->values.count) / 2; i++) {
 		KrkValue tmp = self->values.values[i];
 		self->values.values[i] = self->values.values[self->values.count-i-1];
@@ -411,30 +434,74 @@ KRK_METHOD(list,reverse,{
 	return NONE_VAL();
 })
 
-static int _list_sorter(const void * _a, const void * _b) {
-	KrkValue a = *(KrkValue*)_a;
-	KrkValue b = *(KrkValue*)_b;
-
-	KrkValue ltComp = krk_operator_lt(a,b);
-	if (IS_NONE(ltComp) || (IS_BOOLEAN(ltComp) && AS_BOOLEAN(ltComp))) return -1;
-	KrkValue gtComp = krk_operator_gt(a,b);
-	if (IS_NONE(gtComp) || (IS_BOOLEAN(gtComp) && AS_BOOLEAN(gtComp))) return 1;
-	return 0;
-}
-
 KRK_METHOD(list,sort,{
-	METHOD_TAKES_NONE();
+	KRK_ARGS(args, ".$|Op", "key", "reverse");
+	KrkValue key = NONE_VAL();
+	int reverse = 0;
+	if (!krk_parseArgs(args, &key, &reverse)) return NONE_VAL();
+
+	/*
+	 * The values are taken out of the list while it is sorted, so comparisons
+	 * and the key function, which can run managed code, see an empty list and
+	 * can't pull values out from under the sort.
+	 */
+	KrkValue holder = krk_list_of(0,NULL,0);
+	krk_push(holder);
+	LIST_LOCK(wr,self);
+	AS_LIST(holder)->values = self->values.values;
+	AS_LIST(holder)->count = self->values.count;
+	AS_LIST(holder)->capacity = self->values.capacity;
+	self->values.values = NULL;
+	self->values.count = 0;
+	self->values.capacity = 0;
+	pthread_rwlock_unlock(&self->rwlock);
+	krk_gcWriteBarrier(AS_OBJECT(holder));
+
+	int sorted = 1;
+	if (!IS_NONE(key)) {
+		/* The key function is called once for each value, up front. */
+		krk_push(krk_list_of(0,NULL,0));
+		KrkValueArray * keys = AS_LIST(krk_peek(0));
+		keys->values = GROW_ARRAY(KrkValue, keys->values, 0, AS_LIST(holder)->count);
+		keys->capacity = AS_LIST(holder)->count;
+		for (size_t i = 0; i < AS_LIST(holder)->count; ++i) {
+			krk_push(key);
+			krk_push(AS_LIST(holder)->values[i]);
+			KrkValue result = krk_callStack(1);
+			if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) {
+				sorted = 0;
+				break;
+			}
+			krk_writeValueArray(keys, result);
+		}
+		if (sorted) sorted = krk_sortValueArrays(keys, AS_LIST(holder), reverse);
+		krk_pop();
+	} else {
+		sorted = krk_sortValueArrays(AS_LIST(holder), NULL, reverse);
+	}
 
-	pthread_rwlock_wrlock(&self->rwlock);
-	qsort(self->values.values, self->values.count, sizeof(KrkValue), _list_sorter);
+	/* Put the values back, whether or not the sort finished; anything added meanwhile is lost. */
+	LIST_LOCK(wr,self);
+	int modified = self->values.count || self->values.capacity;
+	krk_freeValueArray(&self->values);
+	self->values.values = AS_LIST(holder)->values;
+	self->values.count = AS_LIST(holder)->count;
+	self->values.capacity = AS_LIST(holder)->capacity;
+	AS_LIST(holder)->values = NULL;
+	AS_LIST(holder)->count = 0;
+	AS_LIST(holder)->capacity = 0;
 	pthread_rwlock_unlock(&self->rwlock);
+	krk_gcWriteBarrier((KrkObj*)self);
+	krk_pop();
+
+	if (sorted && modified) return krk_runtimeError(vm.exceptions->valueError, "list modified during sort");
 })
 
 KRK_METHOD(list,__add__,{
 	METHOD_TAKES_EXACTLY(1);
 	if (!IS_list(argv[1])) return TYPE_ERROR(list,argv[1]);
 
-	pthread_rwlock_rdlock(&self->rwlock);
+	LIST_LOCK(rd,self);
 	KrkValue outList = krk_list_of(self->values.count, self->values.values, 0); /* copy */
 	pthread_rwlock_unlock(&self->rwlock);
 	FUNC_NAME(list,extend)(2,(KrkValue[]){outList,argv[1]},0); /* extend */
@@ -456,12 +523,6 @@ KRK_METHOD(list,__iter__,{
 
 #undef CURRENT_CTYPE
 
-struct ListIterator {
-	KrkInstance inst;
-	KrkValue l;
-	size_t i;
-};
-
 #define CURRENT_CTYPE struct ListIterator *
 #define IS_listiterator(o) (likely(IS_INSTANCE(o) && AS_INSTANCE(o)->_class == vm.baseClasses->listiteratorClass) || krk_isInstanceOf(o,vm.baseClasses->listiteratorClass))
 #define AS_listiterator(o) (struct ListIterator*)AS_OBJECT(o)
@@ -475,6 +536,7 @@ KRK_METHOD(listiterator,__init__,{
 	CHECK_ARG(1,list,KrkList*,list);
 	self->l = argv[1];
 	self->i = 0;
+	krk_gcWriteBarrier((KrkObj*)self);
 	return argv[0];
 })
 
@@ -508,7 +570,8 @@ static KrkValue _sorted(int argc, const KrkValue argv[], int hasKw) {
 	krk_push(listOut);
 	FUNC_NAME(list,extend)(2,(KrkValue[]){listOut,argv[0]},0);
 	if (!IS_NONE(krk_currentThread.currentException)) return NONE_VAL();
-	FUNC_NAME(list,sort)(1,&listOut,0);
+	/* key= and reverse= are passed along */
+	FUNC_NAME(list,sort)(1,(KrkValue[]){listOut,hasKw ? argv[argc] : NONE_VAL()},hasKw);
 	if (!IS_NONE(krk_currentThread.currentException)) return NONE_VAL();
 	return krk_pop();
 }
@@ -591,9 +654,13 @@ void _createAndBind_listClass(void) {
 		"@brief Reverse the contents of a list.\n\n"
 		"Reverses the elements of the list in-place.");
 	KRK_DOC(BIND_METHOD(list,sort),
-		"@brief Sort the contents of a list.\n\n"
+		"@brief Sort the contents of a list.\n"
+		"@arguments key=None,reverse=False\n\n"
 		"Performs an in-place sort of the elements in the list, returning @c None as a gentle reminder "
-		"that the sort is in-place. If a sorted copy is desired, use @ref sorted instead.");
+		"that the sort is in-place. If a sorted copy is desired, use @ref sorted instead. "
+		"The sort is stable: elements that compare equal keep their order. If @p key is given, it is "
+		"called once for each element and the results are compared instead of the elements. If "
+		"@p reverse is true, the list is sorted in descending order, still keeping equal elements in order.");
 	krk_defineNative(&list->methods, "__str__", FUNC_NAME(list,__repr__));
 	krk_defineNative(&list->methods, "__class_getitem__", KrkGenericAlias)->obj.flags |= KRK_OBJ_FLAGS_FUNCTION_IS_CLASS_METHOD;
 	krk_attachNamedValue(&list->methods, "__hash__", NONE_VAL());
@@ -606,8 +673,8 @@ void _createAndBind_listClass(void) {
 		"Creates a list from the provided @p args.");
 	BUILTIN_FUNCTION("sorted", _sorted,
 		"@brief Return a sorted representation of an iterable.\n"
-		"@arguments iterable\n\n"
-		"Creates a new, sorted list from the elements of @p iterable.");
+		"@arguments iterable,key=None,reverse=False\n\n"
+		"Creates a new, sorted list from the elements of @p iterable. See @c list.sort for @p key and @p reverse.");
 	BUILTIN_FUNCTION("reversed", _reversed,
 		"@brief Return a reversed representation of an iterable.\n"
 		"@arguments iterable\n\n"
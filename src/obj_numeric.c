@@ -27,7 +27,7 @@ FUNC_SIG(int,__init__) {
 KRK_METHOD(int,__str__,{
 	char tmp[100];
 	size_t l = snprintf(tmp, 100, PRIkrk_int, self);
-	return OBJECT_VAL(krk_copyString(tmp, l));
+	return OBJECT_VAL(krk_copyStringUninterned(tmp, l));
 })
 
 KRK_METHOD(int,__int__,{ return argv[0]; })
@@ -195,7 +195,7 @@ KRK_METHOD(float,__str__,{
 	if (!strstr(tmp,".") && isDigits(tmp)) {
 		l = snprintf(tmp,100,"%.16g.0",self);
 	}
-	return OBJECT_VAL(krk_copyString(tmp, l));
+	return OBJECT_VAL(krk_copyStringUninterned(tmp, l));
 })
 
 KRK_METHOD(float,__eq__,{
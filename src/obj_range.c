@@ -16,18 +16,10 @@ struct Range {
 	krk_integer_type max;
 	krk_integer_type step;
 };
-static KrkClass * range = NULL;
-#define IS_range(o)   (krk_isInstanceOf(o,range))
+#define IS_range(o)   (krk_isInstanceOf(o,vm.baseClasses->rangeClass))
 #define AS_range(o)   ((struct Range*)AS_OBJECT(o))
 
-struct RangeIterator {
-	KrkInstance inst;
-	krk_integer_type i;
-	krk_integer_type max;
-	krk_integer_type step;
-};
-static KrkClass * rangeiterator = NULL;
-#define IS_rangeiterator(o) (krk_isInstanceOf(o,rangeiterator))
+#define IS_rangeiterator(o) (krk_isInstanceOf(o,vm.baseClasses->rangeiteratorClass))
 #define AS_rangeiterator(o) ((struct RangeIterator*)AS_OBJECT(o))
 
 FUNC_SIG(rangeiterator,__init__);
@@ -76,7 +68,7 @@ KRK_METHOD(range,__repr__,{
 })
 
 KRK_METHOD(range,__iter__,{
-	KrkInstance * output = krk_newInstance(rangeiterator);
+	KrkInstance * output = krk_newInstance(vm.baseClasses->rangeiteratorClass);
 	krk_integer_type min = self->min;
 	krk_integer_type max = self->max;
 	krk_integer_type step = self->step;
@@ -113,9 +105,20 @@ KRK_METHOD(rangeiterator,__call__,{
 	}
 })
 
+_noexport
+int krk_rangeValues(KrkValue value, krk_integer_type * first, krk_integer_type * step, krk_integer_type * count) {
+	if (!IS_range(value)) return 0;
+	struct Range * self = AS_range(value);
+	*first = self->min;
+	*step = self->step;
+	if (self->step > 0) *count = self->max > self->min ? (self->max - self->min + self->step - 1) / self->step : 0;
+	else *count = self->min > self->max ? (self->min - self->max - self->step - 1) / -self->step : 0;
+	return 1;
+}
+
 _noexport
 void _createAndBind_rangeClass(void) {
-	range = ADD_BASE_CLASS(vm.baseClasses->rangeClass, "range", vm.baseClasses->objectClass);
+	KrkClass * range = ADD_BASE_CLASS(vm.baseClasses->rangeClass, "range", vm.baseClasses->objectClass);
 	range->allocSize = sizeof(struct Range);
 	KRK_DOC(BIND_METHOD(range,__init__),
 		"@brief Create an iterable that produces sequential numeric values.\n"
@@ -128,7 +131,7 @@ void _createAndBind_rangeClass(void) {
 	KRK_DOC(range, "@brief Iterable object that produces sequential numeric values.");
 	krk_finalizeClass(range);
 
-	rangeiterator = ADD_BASE_CLASS(vm.baseClasses->rangeiteratorClass, "rangeiterator", vm.baseClasses->objectClass);
+	KrkClass * rangeiterator = ADD_BASE_CLASS(vm.baseClasses->rangeiteratorClass, "rangeiterator", vm.baseClasses->objectClass);
 	rangeiterator->allocSize = sizeof(struct RangeIterator);
 	BIND_METHOD(rangeiterator,__init__);
 	BIND_METHOD(rangeiterator,__call__);
@@ -4,29 +4,321 @@
 #include <kuroko/memory.h>
 #include <kuroko/util.h>
 
-static KrkClass * set;
+#include "private.h"
+
+static KrkVMLocal setKey;
+#define setClass KRK_VM_LOCAL(KrkClass*,setKey)
 
 /**
  * @brief Mutable unordered set of values.
  * @extends KrkInstance
+ *
+ * Sets have a table of their own, laid out like a @ref KrkTable without
+ * the values: the keys in the order they were added, then their hashes,
+ * then the index, all in one allocation.
  */
 struct Set {
 	KrkInstance inst;
-	KrkTable entries;
+	size_t count;      /**< Keys in the set */
+	size_t used;       /**< Keys handed out so far, including deleted ones */
+	size_t capacity;   /**< Room in @ref keys; three quarters of the slots in the index */
+	size_t tombstones; /**< Index slots left by deleted keys */
+	KrkValue * keys;   /**< Deleted keys are @c KWARGS_VAL(0) */
 };
 
-#define IS_set(o) krk_isInstanceOf(o,set)
+#define IS_set(o) krk_isInstanceOf(o,setClass)
 #define AS_set(o) ((struct Set*)AS_OBJECT(o))
 
+#define SET_HASHES(s) ((uint32_t*)((s)->keys + (s)->capacity))
+#define SET_INDEX(s)  ((void*)(SET_HASHES(s) + (s)->capacity))
+
+static inline size_t setBytes(size_t capacity) {
+	size_t indexCapacity = KRK_INDEX_CAPACITY(capacity);
+	return (sizeof(KrkValue) + sizeof(uint32_t)) * capacity + krk_indexWidth(indexCapacity) * indexCapacity;
+}
+
+static void setInit(struct Set * self) {
+	self->count = 0;
+	self->used = 0;
+	self->capacity = 0;
+	self->tombstones = 0;
+	self->keys = NULL;
+}
+
+static void setFree(struct Set * self) {
+	if (self->capacity) FREE_ARRAY(char, self->keys, setBytes(self->capacity));
+	setInit(self);
+}
+
 static void _set_gcscan(KrkInstance * self) {
-	krk_markTable(&((struct Set*)self)->entries);
+	struct Set * me = (struct Set*)self;
+	for (size_t i = 0; i < me->used; ++i) {
+		krk_markValue(me->keys[i]);
+	}
 }
 
 static void _set_gcsweep(KrkInstance * self) {
-	krk_freeTable(&((struct Set*)self)->entries);
+	setFree((struct Set*)self);
+}
+
+/* Written once against a width that is a constant at each call site, as in table.c */
+static inline ssize_t setProbe(struct Set * self, KrkValue key, uint32_t hash, size_t * slotOut, size_t width) {
+	uint32_t * hashes = SET_HASHES(self);
+	void * index = SET_INDEX(self);
+	size_t mask = KRK_INDEX_CAPACITY(self->capacity) - 1;
+	size_t slot = hash & mask;
+	size_t free = SIZE_MAX;
+	for (;;) {
+		ssize_t position = krk_indexGet(index, width, slot);
+		if (position == KRK_INDEX_EMPTY) {
+			if (slotOut) *slotOut = free != SIZE_MAX ? free : slot;
+			return KRK_INDEX_EMPTY;
+		} else if (position == KRK_INDEX_DELETED) {
+			if (free == SIZE_MAX) free = slot;
+		} else if (hashes[position] == hash &&
+		           (self->keys[position] == key || krk_valuesEqual(self->keys[position], key))) {
+			if (slotOut) *slotOut = slot;
+			return position;
+		}
+		slot = (slot + 1) & mask;
+	}
+}
+
+/**
+ * Find @p key, whose hash is @p hash. Returns its position in the keys,
+ * or KRK_INDEX_EMPTY if it isn't there, in which case @p slotOut is where
+ * it should be added.
+ */
+static ssize_t setLookup(struct Set * self, KrkValue key, uint32_t hash, size_t * slotOut) {
+	if (!self->capacity) return KRK_INDEX_EMPTY;
+	switch (krk_indexWidth(KRK_INDEX_CAPACITY(self->capacity))) {
+		case 1: return setProbe(self, key, hash, slotOut, 1);
+		case 2: return setProbe(self, key, hash, slotOut, 2);
+		case 4: return setProbe(self, key, hash, slotOut, 4);
+		default: return setProbe(self, key, hash, slotOut, 8);
+	}
+}
+
+static void setResize(struct Set * self, size_t capacity) {
+	if (capacity < self->count) capacity = self->count;
+	size_t indexCapacity = krk_indexCapacityFor(capacity);
+	capacity = indexCapacity / 4 * 3;
+
+	KrkValue * keys = capacity ? (KrkValue*)ALLOCATE(char, setBytes(capacity)) : NULL;
+	uint32_t * hashes = (uint32_t*)(keys + capacity);
+	void * index = hashes + capacity;
+	size_t width = krk_indexWidth(indexCapacity);
+	if (indexCapacity) memset(index, 0xFF, width * indexCapacity);
+
+	/* Keys keep their order; the holes left by deleted ones are squeezed out. */
+	size_t count = 0;
+	for (size_t i = 0; i < self->used; ++i) {
+		if (IS_KWARGS(self->keys[i])) continue;
+		uint32_t hash = SET_HASHES(self)[i];
+		size_t slot = hash & (indexCapacity - 1);
+		while (krk_indexGet(index, width, slot) != KRK_INDEX_EMPTY) slot = (slot + 1) & (indexCapacity - 1);
+		krk_indexSet(index, width, slot, count);
+		hashes[count] = hash;
+		keys[count++] = self->keys[i];
+	}
+
+	if (self->capacity) FREE_ARRAY(char, self->keys, setBytes(self->capacity));
+	self->keys = keys;
+	self->capacity = capacity;
+	self->count = count;
+	self->used = count;
+	self->tombstones = 0;
+}
+
+/**
+ * Make room for @p count keys, so adding them all doesn't resize more than once.
+ */
+static void setReserve(struct Set * self, size_t count) {
+	if (count > self->capacity) setResize(self, count);
+}
+
+/**
+ * Add @p key, whose hash is already known. Returns 1 if it was not in the set.
+ */
+static int setInsert(struct Set * self, KrkValue key, uint32_t hash) {
+	size_t slot;
+	if (setLookup(self, key, hash, &slot) >= 0) return 0;
+	/* Deleted slots count towards the load; if most of it is deleted keys, squeezing them out is enough. */
+	if (self->used == self->capacity || self->count + self->tombstones >= self->capacity) {
+		setResize(self, (self->count + 1 > self->capacity / 2) ? (self->capacity ? self->capacity * 2 : 1) : self->capacity);
+		setLookup(self, key, hash, &slot);
+	}
+	void * index = SET_INDEX(self);
+	size_t width = krk_indexWidth(KRK_INDEX_CAPACITY(self->capacity));
+	if (krk_indexGet(index, width, slot) == KRK_INDEX_DELETED) self->tombstones--;
+	size_t position = self->used++;
+	krk_indexSet(index, width, slot, position);
+	self->keys[position] = key;
+	SET_HASHES(self)[position] = hash;
+	self->count++;
+	if (IS_OBJECT(key)) krk_gcWriteBarrier((KrkObj*)self);
+	return 1;
+}
+
+/**
+ * Remove @p key, whose hash is already known. Returns 1 if it was in the set.
+ */
+static int setRemove(struct Set * self, KrkValue key, uint32_t hash) {
+	size_t slot;
+	ssize_t position = setLookup(self, key, hash, &slot);
+	if (position < 0) return 0;
+	void * index = SET_INDEX(self);
+	size_t width = krk_indexWidth(KRK_INDEX_CAPACITY(self->capacity));
+	size_t mask = KRK_INDEX_CAPACITY(self->capacity) - 1;
+	if (krk_indexGet(index, width, (slot + 1) & mask) == KRK_INDEX_EMPTY) {
+		/* No probe continues past this slot, so it - and any deleted slots leading up to it - can be emptied. */
+		krk_indexSet(index, width, slot, KRK_INDEX_EMPTY);
+		for (slot = (slot - 1) & mask; krk_indexGet(index, width, slot) == KRK_INDEX_DELETED; slot = (slot - 1) & mask) {
+			krk_indexSet(index, width, slot, KRK_INDEX_EMPTY);
+			self->tombstones--;
+		}
+	} else {
+		krk_indexSet(index, width, slot, KRK_INDEX_DELETED);
+		self->tombstones++;
+	}
+	self->count--;
+	self->keys[position] = KWARGS_VAL(0);
+	while (self->used && IS_KWARGS(self->keys[self->used-1])) self->used--;
+	return 1;
+}
+
+static inline int setHas(struct Set * self, KrkValue key, uint32_t hash) {
+	return self->count && setLookup(self, key, hash, NULL) >= 0;
+}
+
+/* These hash the key themselves, and leave an exception set if it can't be. */
+static void setAdd(struct Set * self, KrkValue key) {
+	uint32_t hash;
+	if (krk_hashValue(key, &hash)) return;
+	setInsert(self, key, hash);
+}
+
+static int setContains(struct Set * self, KrkValue key) {
+	uint32_t hash;
+	if (krk_hashValue(key, &hash)) return 0;
+	return setHas(self, key, hash);
 }
 
-static KrkClass * setiterator;
+static int setDiscard(struct Set * self, KrkValue key) {
+	uint32_t hash;
+	if (krk_hashValue(key, &hash)) return 0;
+	return setRemove(self, key, hash);
+}
+
+/*
+ * Bulk operations go straight through the keys and the hashes stored
+ * beside them, so nothing is hashed twice and no __hash__ is called.
+ */
+static void setUpdate(struct Set * self, struct Set * them) {
+	setReserve(self, self->count + them->count);
+	for (size_t i = 0; i < them->used; ++i) {
+		if (IS_KWARGS(them->keys[i])) continue;
+		setInsert(self, them->keys[i], SET_HASHES(them)[i]);
+	}
+}
+
+/** Keep only what is also in @p them */
+static void setIntersectionUpdate(struct Set * self, struct Set * them) {
+	for (size_t i = 0; i < self->used; ++i) {
+		if (IS_KWARGS(self->keys[i])) continue;
+		if (!setHas(them, self->keys[i], SET_HASHES(self)[i])) setRemove(self, self->keys[i], SET_HASHES(self)[i]);
+	}
+}
+
+static void setDifferenceUpdate(struct Set * self, struct Set * them) {
+	if (self == them) {
+		setFree(self);
+		return;
+	}
+	for (size_t i = 0; i < them->used && self->count; ++i) {
+		if (IS_KWARGS(them->keys[i])) continue;
+		setRemove(self, them->keys[i], SET_HASHES(them)[i]);
+	}
+}
+
+static void setSymmetricDifferenceUpdate(struct Set * self, struct Set * them) {
+	if (self == them) {
+		setFree(self);
+		return;
+	}
+	for (size_t i = 0; i < them->used; ++i) {
+		if (IS_KWARGS(them->keys[i])) continue;
+		if (!setRemove(self, them->keys[i], SET_HASHES(them)[i])) setInsert(self, them->keys[i], SET_HASHES(them)[i]);
+	}
+}
+
+static int setIsSubset(struct Set * self, struct Set * them) {
+	if (self->count > them->count) return 0;
+	for (size_t i = 0; i < self->used; ++i) {
+		if (IS_KWARGS(self->keys[i])) continue;
+		if (!setHas(them, self->keys[i], SET_HASHES(self)[i])) return 0;
+	}
+	return 1;
+}
+
+static int setIsDisjoint(struct Set * self, struct Set * them) {
+	if (self->count > them->count) {
+		struct Set * swap = self;
+		self = them;
+		them = swap;
+	}
+	for (size_t i = 0; i < self->used; ++i) {
+		if (IS_KWARGS(self->keys[i])) continue;
+		if (setHas(them, self->keys[i], SET_HASHES(self)[i])) return 0;
+	}
+	return 1;
+}
+
+/**
+ * Create a set and push it. Unless it is to be empty, @p reserve is how many keys to make room for.
+ */
+static struct Set * pushNewSet(size_t reserve) {
+	struct Set * out = (struct Set*)krk_newInstance(setClass);
+	krk_push(OBJECT_VAL(out));
+	setReserve(out, reserve);
+	return out;
+}
+
+static struct Set * pushCopy(struct Set * self, size_t reserve) {
+	struct Set * out = pushNewSet(reserve > self->count ? reserve : self->count);
+	for (size_t i = 0; i < self->used; ++i) {
+		if (IS_KWARGS(self->keys[i])) continue;
+		setInsert(out, self->keys[i], SET_HASHES(self)[i]);
+	}
+	return out;
+}
+
+static struct Set * pushIntersection(struct Set * self, struct Set * them) {
+	/* Only the keys of the smaller set need to be looked up in the larger. */
+	if (self->count > them->count) {
+		struct Set * swap = self;
+		self = them;
+		them = swap;
+	}
+	struct Set * out = pushNewSet(self->count);
+	for (size_t i = 0; i < self->used; ++i) {
+		if (IS_KWARGS(self->keys[i])) continue;
+		if (setHas(them, self->keys[i], SET_HASHES(self)[i])) setInsert(out, self->keys[i], SET_HASHES(self)[i]);
+	}
+	return out;
+}
+
+static struct Set * pushDifference(struct Set * self, struct Set * them) {
+	struct Set * out = pushNewSet(self->count);
+	for (size_t i = 0; i < self->used; ++i) {
+		if (IS_KWARGS(self->keys[i])) continue;
+		if (!setHas(them, self->keys[i], SET_HASHES(self)[i])) setInsert(out, self->keys[i], SET_HASHES(self)[i]);
+	}
+	return out;
+}
+
+static KrkVMLocal setiteratorKey;
+#define setiterator KRK_VM_LOCAL(KrkClass*,setiteratorKey)
 
 /**
  * @brief Iterator over the values in a set.
@@ -47,13 +339,38 @@ static void _setiterator_gcscan(KrkInstance * self) {
 #define CURRENT_CTYPE struct Set *
 #define CURRENT_NAME  self
 
+/* Not pre-sized: a list with a lot of repeats would leave the set far bigger than it needs to be. */
 #define unpackArray(counter, indexer) for (size_t i = 0; i < counter; ++i) { \
-		krk_tableSet(&self->entries, indexer, BOOLEAN_VAL(1)); \
+	setAdd(self, indexer); \
 }
 
+/**
+ * Push a set of the values of @p value: itself, if it is already a set.
+ * Returns NULL, with an exception set and nothing pushed, if it can't be
+ * iterated or a value can't be hashed.
+ */
+#undef unpackError
+#define unpackError(fromInput) return krk_runtimeError(vm.exceptions->typeError, "'%s' object is not iterable", krk_typeName(fromInput)), krk_pop(), NULL;
+static struct Set * pushAsSet(KrkValue value) {
+	if (IS_set(value)) {
+		krk_push(value);
+		return AS_set(value);
+	}
+	struct Set * self = pushNewSet(0);
+	unpackIterableFast(value);
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) {
+		krk_pop();
+		return NULL;
+	}
+	return self;
+}
+
+#undef unpackError
+#define unpackError(fromInput) return krk_runtimeError(vm.exceptions->typeError, "'%s' object is not iterable", krk_typeName(fromInput));
+
 KRK_METHOD(set,__init__,{
 	METHOD_TAKES_AT_MOST(1);
-	krk_initTable(&self->entries);
+	setFree(self);
 	if (argc == 2) {
 		unpackIterableFast(argv[1]);
 	}
@@ -62,30 +379,28 @@ KRK_METHOD(set,__init__,{
 
 KRK_METHOD(set,__contains__,{
 	METHOD_TAKES_EXACTLY(1);
-	KrkValue _unused;
-	return BOOLEAN_VAL(krk_tableGet(&self->entries, argv[1], &_unused));
+	return BOOLEAN_VAL(setContains(self, argv[1]));
 })
 
 KRK_METHOD(set,__repr__,{
 	METHOD_TAKES_NONE();
 	if (((KrkObj*)self)->flags & KRK_OBJ_FLAGS_IN_REPR) return OBJECT_VAL("{...}");
-	if (!self->entries.capacity) return OBJECT_VAL(S("set()"));
+	if (!self->count) return OBJECT_VAL(S("set()"));
 	((KrkObj*)self)->flags |= KRK_OBJ_FLAGS_IN_REPR;
 	struct StringBuilder sb = {0};
 	pushStringBuilder(&sb,'{');
 
 	size_t c = 0;
-	size_t len = self->entries.capacity;
-	for (size_t i = 0; i < len; ++i) {
-		KrkTableEntry * entry = &self->entries.entries[i];
-		if (IS_KWARGS(entry->key)) continue;
+	for (size_t i = 0; i < self->used; ++i) {
+		KrkValue key = self->keys[i];
+		if (IS_KWARGS(key)) continue;
 		if (c > 0) {
 			pushStringBuilderStr(&sb, ", ", 2);
 		}
 		c++;
 
-		KrkClass * type = krk_getType(entry->key);
-		krk_push(entry->key);
+		KrkClass * type = krk_getType(key);
+		krk_push(key);
 		KrkValue result = krk_callDirect(type->_reprer, 1);
 		if (IS_STRING(result)) {
 			pushStringBuilderStr(&sb, AS_CSTRING(result), AS_STRING(result)->length);
@@ -99,92 +414,248 @@ KRK_METHOD(set,__repr__,{
 
 KRK_METHOD(set,__and__,{
 	METHOD_TAKES_EXACTLY(1);
-	CHECK_ARG(1,set,struct Set*,them);
-
-	KrkValue outSet = OBJECT_VAL(krk_newInstance(set));
-	krk_push(outSet);
-	FUNC_NAME(set,__init__)(1,&outSet,0);
-
-	KrkClass * type = krk_getType(argv[1]);
-	KrkValue contains;
-	if (!krk_tableGet(&type->methods, OBJECT_VAL(S("__contains__")), &contains))
-		return krk_runtimeError(vm.exceptions->typeError, "unsupported operand types for %s: '%s' and '%s'", "&", "set", krk_typeName(argv[1]));
-
-	size_t len = self->entries.capacity;
-	for (size_t i = 0; i < len; ++i) {
-		KrkTableEntry * entry = &self->entries.entries[i];
-		if (IS_KWARGS(entry->key)) continue;
+	if (!IS_set(argv[1])) return NOTIMPL_VAL();
+	pushIntersection(self, AS_set(argv[1]));
+	return krk_pop();
+})
 
-		krk_push(contains);
-		krk_push(argv[1]);
-		krk_push(entry->key);
-		KrkValue result = krk_callStack(2);
+KRK_METHOD(set,__or__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_set(argv[1])) return NOTIMPL_VAL();
+	struct Set * out = pushCopy(self, self->count + AS_set(argv[1])->count);
+	setUpdate(out, AS_set(argv[1]));
+	return krk_pop();
+})
 
-		if (IS_BOOLEAN(result) && AS_BOOLEAN(result)) {
-			krk_tableSet(&AS_set(outSet)->entries, entry->key, BOOLEAN_VAL(1));
-		}
-	}
+KRK_METHOD(set,__sub__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_set(argv[1])) return NOTIMPL_VAL();
+	pushDifference(self, AS_set(argv[1]));
+	return krk_pop();
+})
 
+KRK_METHOD(set,__xor__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_set(argv[1])) return NOTIMPL_VAL();
+	struct Set * out = pushCopy(self, self->count + AS_set(argv[1])->count);
+	setSymmetricDifferenceUpdate(out, AS_set(argv[1]));
 	return krk_pop();
 })
 
-KRK_METHOD(set,__or__,{
+KRK_METHOD(set,__ior__,{
 	METHOD_TAKES_EXACTLY(1);
-	CHECK_ARG(1,set,struct Set*,them);
+	if (!IS_set(argv[1])) return NOTIMPL_VAL();
+	setUpdate(self, AS_set(argv[1]));
+	return argv[0];
+})
 
-	KrkValue outSet = OBJECT_VAL(krk_newInstance(set));
-	krk_push(outSet);
-	FUNC_NAME(set,__init__)(1,&outSet,0);
+KRK_METHOD(set,__iand__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_set(argv[1])) return NOTIMPL_VAL();
+	setIntersectionUpdate(self, AS_set(argv[1]));
+	return argv[0];
+})
 
-	krk_tableAddAll(&self->entries, &AS_set(outSet)->entries);
-	krk_tableAddAll(&them->entries, &AS_set(outSet)->entries);
+KRK_METHOD(set,__isub__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_set(argv[1])) return NOTIMPL_VAL();
+	setDifferenceUpdate(self, AS_set(argv[1]));
+	return argv[0];
+})
 
-	return krk_pop();
+KRK_METHOD(set,__ixor__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_set(argv[1])) return NOTIMPL_VAL();
+	setSymmetricDifferenceUpdate(self, AS_set(argv[1]));
+	return argv[0];
 })
 
 KRK_METHOD(set,__len__,{
 	METHOD_TAKES_NONE();
-	return INTEGER_VAL(self->entries.count);
+	return INTEGER_VAL(self->count);
 })
 
 KRK_METHOD(set,__eq__,{
 	METHOD_TAKES_EXACTLY(1);
 	if (!IS_set(argv[1]))
 		return NOTIMPL_VAL();
-	CHECK_ARG(1,set,struct Set*,them);
-	if (self->entries.count != them->entries.count)
-		return BOOLEAN_VAL(0);
+	struct Set * them = AS_set(argv[1]);
+	return BOOLEAN_VAL(self->count == them->count && setIsSubset(self, them));
+})
 
-	KrkValue _unused;
+KRK_METHOD(set,__le__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_set(argv[1])) return NOTIMPL_VAL();
+	return BOOLEAN_VAL(setIsSubset(self, AS_set(argv[1])));
+})
 
-	for (unsigned int i = 0; i < self->entries.capacity; ++i) {
-		if (IS_KWARGS(self->entries.entries[i].key)) continue;
-		if (!krk_tableGet(&them->entries, self->entries.entries[i].key, &_unused)) return BOOLEAN_VAL(0);
+KRK_METHOD(set,__lt__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_set(argv[1])) return NOTIMPL_VAL();
+	return BOOLEAN_VAL(self->count < AS_set(argv[1])->count && setIsSubset(self, AS_set(argv[1])));
+})
+
+KRK_METHOD(set,__ge__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_set(argv[1])) return NOTIMPL_VAL();
+	return BOOLEAN_VAL(setIsSubset(AS_set(argv[1]), self));
+})
+
+KRK_METHOD(set,__gt__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_set(argv[1])) return NOTIMPL_VAL();
+	return BOOLEAN_VAL(AS_set(argv[1])->count < self->count && setIsSubset(AS_set(argv[1]), self));
+})
+
+KRK_METHOD(set,union,{
+	struct Set * out = pushCopy(self, 0);
+	for (int i = 1; i < argc; ++i) {
+		struct Set * them = pushAsSet(argv[i]);
+		if (!them) break;
+		setUpdate(out, them);
+		krk_pop();
 	}
+	return krk_pop();
+})
 
-	return BOOLEAN_VAL(1);
+KRK_METHOD(set,intersection,{
+	/* With no arguments, that's a copy. */
+	if (argc == 1) {
+		pushCopy(self, 0);
+		return krk_pop();
+	}
+	krk_push(argv[0]);
+	for (int i = 1; i < argc; ++i) {
+		struct Set * them = pushAsSet(argv[i]);
+		if (!them) break;
+		KrkValue out = OBJECT_VAL(pushIntersection(AS_set(krk_peek(1)), them));
+		krk_currentThread.stackTop -= 3;
+		krk_push(out);
+	}
+	return krk_pop();
+})
+
+KRK_METHOD(set,difference,{
+	struct Set * out = pushCopy(self, 0);
+	for (int i = 1; i < argc && out->count; ++i) {
+		struct Set * them = pushAsSet(argv[i]);
+		if (!them) break;
+		setDifferenceUpdate(out, them);
+		krk_pop();
+	}
+	return krk_pop();
+})
+
+KRK_METHOD(set,symmetric_difference,{
+	METHOD_TAKES_EXACTLY(1);
+	struct Set * them = pushAsSet(argv[1]);
+	if (!them) return NONE_VAL();
+	struct Set * out = pushCopy(self, self->count + them->count);
+	setSymmetricDifferenceUpdate(out, them);
+	KrkValue result = krk_pop();
+	krk_pop();
+	return result;
+})
+
+KRK_METHOD(set,update,{
+	for (int i = 1; i < argc; ++i) {
+		if (IS_set(argv[i])) {
+			setUpdate(self, AS_set(argv[i]));
+		} else {
+			/* No need for a set of our own; the values can go straight in. */
+			unpackIterableFast(argv[i]);
+			if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return NONE_VAL();
+		}
+	}
+})
+
+KRK_METHOD(set,intersection_update,{
+	for (int i = 1; i < argc; ++i) {
+		struct Set * them = pushAsSet(argv[i]);
+		if (!them) return NONE_VAL();
+		setIntersectionUpdate(self, them);
+		krk_pop();
+	}
+})
+
+KRK_METHOD(set,difference_update,{
+	for (int i = 1; i < argc && self->count; ++i) {
+		struct Set * them = pushAsSet(argv[i]);
+		if (!them) return NONE_VAL();
+		setDifferenceUpdate(self, them);
+		krk_pop();
+	}
+})
+
+KRK_METHOD(set,symmetric_difference_update,{
+	METHOD_TAKES_EXACTLY(1);
+	struct Set * them = pushAsSet(argv[1]);
+	if (!them) return NONE_VAL();
+	setSymmetricDifferenceUpdate(self, them);
+	krk_pop();
+})
+
+KRK_METHOD(set,issubset,{
+	METHOD_TAKES_EXACTLY(1);
+	struct Set * them = pushAsSet(argv[1]);
+	if (!them) return NONE_VAL();
+	int result = setIsSubset(self, them);
+	krk_pop();
+	return BOOLEAN_VAL(result);
+})
+
+KRK_METHOD(set,issuperset,{
+	METHOD_TAKES_EXACTLY(1);
+	struct Set * them = pushAsSet(argv[1]);
+	if (!them) return NONE_VAL();
+	int result = setIsSubset(them, self);
+	krk_pop();
+	return BOOLEAN_VAL(result);
+})
+
+KRK_METHOD(set,isdisjoint,{
+	METHOD_TAKES_EXACTLY(1);
+	struct Set * them = pushAsSet(argv[1]);
+	if (!them) return NONE_VAL();
+	int result = setIsDisjoint(self, them);
+	krk_pop();
+	return BOOLEAN_VAL(result);
+})
+
+KRK_METHOD(set,copy,{
+	METHOD_TAKES_NONE();
+	pushCopy(self, 0);
+	return krk_pop();
 })
 
 KRK_METHOD(set,add,{
 	METHOD_TAKES_EXACTLY(1);
-	krk_tableSet(&self->entries, argv[1], BOOLEAN_VAL(1));
+	setAdd(self, argv[1]);
 })
 
 KRK_METHOD(set,remove,{
 	METHOD_TAKES_EXACTLY(1);
-	if (!krk_tableDelete(&self->entries, argv[1]))
+	if (!setDiscard(self, argv[1]) && !(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION))
 		return krk_runtimeError(vm.exceptions->keyError, "key error");
 })
 
 KRK_METHOD(set,discard,{
 	METHOD_TAKES_EXACTLY(1);
-	krk_tableDelete(&self->entries, argv[1]);
+	setDiscard(self, argv[1]);
+})
+
+KRK_METHOD(set,pop,{
+	METHOD_TAKES_NONE();
+	if (!self->count) return krk_runtimeError(vm.exceptions->keyError, "pop from an empty set");
+	/* The newest key is at the end, and removing it lets its space be reused. */
+	KrkValue key = self->keys[self->used-1];
+	setRemove(self, key, SET_HASHES(self)[self->used-1]);
+	return key;
 })
 
 KRK_METHOD(set,clear,{
 	METHOD_TAKES_NONE();
-	krk_freeTable(&self->entries);
-	krk_initTable(&self->entries);
+	setFree(self);
 })
 
 FUNC_SIG(setiterator,__init__);
@@ -205,38 +676,42 @@ KRK_METHOD(setiterator,__init__,{
 	CHECK_ARG(1,set,void*,source);
 	self->set = argv[1];
 	self->i = 0;
+	krk_gcWriteBarrier((KrkObj*)self);
 	return argv[0];
 })
 
 KRK_METHOD(setiterator,__call__,{
 	METHOD_TAKES_NONE();
+	struct Set * source = AS_set(self->set);
 	do {
-		if (self->i >= AS_set(self->set)->entries.capacity) return argv[0];
-		if (!IS_KWARGS(AS_set(self->set)->entries.entries[self->i].key)) {
-			krk_push(AS_set(self->set)->entries.entries[self->i].key);
-			self->i++;
-			return krk_pop();
+		if (self->i >= source->used) return argv[0];
+		if (!IS_KWARGS(source->keys[self->i])) {
+			return source->keys[self->i++];
 		}
 		self->i++;
 	} while (1);
 })
 
 KrkValue krk_set_of(int argc, const KrkValue argv[], int hasKw) {
-	KrkValue outSet = OBJECT_VAL(krk_newInstance(set));
-	krk_push(outSet);
-	krk_initTable(&AS_set(outSet)->entries);
+	struct Set * outSet = pushNewSet(argc);
 
 	while (argc) {
-		krk_tableSet(&AS_set(outSet)->entries, argv[argc-1], BOOLEAN_VAL(1));
+		setAdd(outSet, argv[argc-1]);
 		argc--;
 	}
 
 	return krk_pop();
 }
 
+_noexport
+size_t krk_setBytes(KrkValue value) {
+	if (!IS_set(value) || !AS_set(value)->capacity) return 0;
+	return setBytes(AS_set(value)->capacity);
+}
+
 _noexport
 void _createAndBind_setClass(void) {
-	krk_makeClass(vm.builtins, &set, "set", vm.baseClasses->objectClass);
+	KrkClass * set = krk_makeClass(vm.builtins, &setClass, "set", vm.baseClasses->objectClass);
 	set->allocSize = sizeof(struct Set);
 	set->_ongcscan = _set_gcscan;
 	set->_ongcsweep = _set_gcsweep;
@@ -244,8 +719,18 @@ void _createAndBind_setClass(void) {
 	BIND_METHOD(set,__repr__);
 	BIND_METHOD(set,__len__);
 	BIND_METHOD(set,__eq__);
+	BIND_METHOD(set,__le__);
+	BIND_METHOD(set,__lt__);
+	BIND_METHOD(set,__ge__);
+	BIND_METHOD(set,__gt__);
 	BIND_METHOD(set,__and__);
 	BIND_METHOD(set,__or__);
+	BIND_METHOD(set,__sub__);
+	BIND_METHOD(set,__xor__);
+	BIND_METHOD(set,__iand__);
+	BIND_METHOD(set,__ior__);
+	BIND_METHOD(set,__isub__);
+	BIND_METHOD(set,__ixor__);
 	BIND_METHOD(set,__contains__);
 	BIND_METHOD(set,__iter__);
 	KRK_DOC(BIND_METHOD(set,add),
@@ -260,9 +745,47 @@ void _createAndBind_setClass(void) {
 		"@brief Remove an element from the set, quietly.\n"
 		"@arguments value\n\n"
 		"Removes @p value from the set, without raising an exception if it is not a member.");
+	KRK_DOC(BIND_METHOD(set,pop),
+		"@brief Remove and return an element of the set.\n\n"
+		"Raises @ref KeyError if the set is empty.");
 	KRK_DOC(BIND_METHOD(set,clear),
 		"@brief Empty the set.\n\n"
 		"Removes all elements from the set, in-place.");
+	KRK_DOC(BIND_METHOD(set,copy),
+		"@brief Make a shallow copy of the set.");
+	KRK_DOC(BIND_METHOD(set,union),
+		"@brief Make a set of the elements of this set and of every argument.\n"
+		"@arguments *others");
+	KRK_DOC(BIND_METHOD(set,intersection),
+		"@brief Make a set of the elements of this set that are also in every argument.\n"
+		"@arguments *others");
+	KRK_DOC(BIND_METHOD(set,difference),
+		"@brief Make a set of the elements of this set that are not in any argument.\n"
+		"@arguments *others");
+	KRK_DOC(BIND_METHOD(set,symmetric_difference),
+		"@brief Make a set of the elements that are in either this set or @p other, but not both.\n"
+		"@arguments other");
+	KRK_DOC(BIND_METHOD(set,update),
+		"@brief Add the elements of every argument to this set.\n"
+		"@arguments *others");
+	KRK_DOC(BIND_METHOD(set,intersection_update),
+		"@brief Remove the elements of this set that are not in every argument.\n"
+		"@arguments *others");
+	KRK_DOC(BIND_METHOD(set,difference_update),
+		"@brief Remove the elements of every argument from this set.\n"
+		"@arguments *others");
+	KRK_DOC(BIND_METHOD(set,symmetric_difference_update),
+		"@brief Keep the elements that are in either this set or @p other, but not both.\n"
+		"@arguments other");
+	KRK_DOC(BIND_METHOD(set,issubset),
+		"@brief Whether every element of this set is in @p other.\n"
+		"@arguments other");
+	KRK_DOC(BIND_METHOD(set,issuperset),
+		"@brief Whether every element of @p other is in this set.\n"
+		"@arguments other");
+	KRK_DOC(BIND_METHOD(set,isdisjoint),
+		"@brief Whether this set and @p other have no elements in common.\n"
+		"@arguments other");
 	krk_defineNative(&set->methods, "__str__", FUNC_NAME(set,__repr__));
 	krk_attachNamedValue(&set->methods, "__hash__", NONE_VAL());
 	krk_finalizeClass(set);
@@ -112,6 +112,7 @@ KRK_METHOD(slice,__init__,{
 			self->step = NONE_VAL();
 		}
 	}
+	krk_gcWriteBarrier((KrkObj*)self);
 	return argv[0];
 })
 
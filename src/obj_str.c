@@ -1,4 +1,5 @@
 #include <string.h>
+#include <math.h>
 #include <kuroko/vm.h>
 #include <kuroko/value.h>
 #include <kuroko/memory.h>
@@ -23,7 +24,8 @@ static KrkValue FUNC_NAME(striterator,__init__)(int,const KrkValue[],int);
 	((string->obj.flags & KRK_OBJ_FLAGS_STRING_MASK) == (KRK_OBJ_FLAGS_STRING_UCS2) ? ((uint16_t*)string->codes)[offset] : \
 	((uint32_t*)string->codes)[offset]))
 
-#define CODEPOINT_BYTES(cp) (cp < 0x80 ? 1 : (cp < 0x800 ? 2 : (cp < 0x10000 ? 3 : 4)))
+#define SEQUENCE_BYTES(lead) ((unsigned char)(lead) < 0x80 ? 1 : ((unsigned char)(lead) < 0xE0 ? 2 : ((unsigned char)(lead) < 0xF0 ? 3 : 4)))
+#define HAS_CODES(string) ((string)->codes && !((string)->obj.flags & KRK_OBJ_FLAGS_STRING_BREADCRUMBS))
 
 KRK_METHOD(str,__ord__,{
 	METHOD_TAKES_NONE();
@@ -73,19 +75,52 @@ KRK_METHOD(str,__add__,{
 
 	KrkStringType type = self_type > them_type ? self_type : them_type;
 
-	/* Hashes can be extended, which saves us calculating the whole thing */
-	uint32_t hash = self->obj.hash;
-	for (size_t i = 0; i < bl; ++i) {
-		hash = (int)b[i] + (hash << 6) + (hash << 16) - hash;
-	}
-
-	KrkString * result = krk_takeStringVetted(chars, length, cpLength, type, hash);
+	KrkString * result = krk_takeStringVettedUninterned(chars, length, cpLength, type);
 	if (needsPop) krk_pop();
 	return OBJECT_VAL(result);
 })
 
+_noexport
+KrkString * krk_appendString(KrkString * self, KrkString * them, int inPlace) {
+	size_t length = self->length + them->length;
+	size_t cpLength = self->codesLength + them->codesLength;
+
+	int self_type = (self->obj.flags & KRK_OBJ_FLAGS_STRING_MASK);
+	int them_type = (them->obj.flags & KRK_OBJ_FLAGS_STRING_MASK);
+
+	KrkStringType type = self_type > them_type ? self_type : them_type;
+
+	if (inPlace && (self->obj.flags & KRK_OBJ_FLAGS_STRING_APPENDABLE)) {
+		if (self->codes && self->codes != self->chars) free(self->codes);
+		self->codes = NULL;
+		size_t capacity = krk_stringCapacity(self);
+		if (capacity < length + 1) {
+			self->chars = krk_reallocate(self->chars, capacity, krk_spareCapacity(length));
+		}
+		memcpy(self->chars + self->length, them->chars, them->length);
+		self->chars[length] = '\0';
+		self->codes = type == KRK_OBJ_FLAGS_STRING_ASCII ? self->chars : NULL;
+		self->length = length;
+		self->codesLength = cpLength;
+		self->obj.flags &= ~(KRK_OBJ_FLAGS_STRING_MASK | KRK_OBJ_FLAGS_VALID_HASH | KRK_OBJ_FLAGS_STRING_BREADCRUMBS);
+		self->obj.flags |= type;
+		return self;
+	}
+
+	/* Short strings are interned, and interned strings can't be changed. */
+	size_t capacity = length < 2 ? length + 1 : krk_spareCapacity(length);
+	char * chars = ALLOCATE(char, capacity);
+	memcpy(chars, self->chars, self->length);
+	memcpy(chars + self->length, them->chars, them->length);
+	chars[length] = '\0';
+
+	KrkString * result = krk_takeStringVettedUninterned(chars, length, cpLength, type);
+	if (length >= 2) result->obj.flags |= KRK_OBJ_FLAGS_STRING_SPARE | KRK_OBJ_FLAGS_STRING_APPENDABLE;
+	return result;
+}
+
 KRK_METHOD(str,__hash__,{
-	return INTEGER_VAL(self->obj.hash);
+	return INTEGER_VAL(krk_stringHash(self));
 })
 
 KRK_METHOD(str,__len__,{
@@ -133,8 +168,11 @@ KRK_METHOD(str,__getitem__,{
 		}
 		if ((self->obj.flags & KRK_OBJ_FLAGS_STRING_MASK) == KRK_OBJ_FLAGS_STRING_ASCII) {
 			return OBJECT_VAL(krk_copyString(self->chars + asInt, 1));
+		} else if (!HAS_CODES(self)) {
+			/* Find the character in the UTF-8 rather than widening the whole string. */
+			size_t offset = krk_stringByteOffset(self, asInt);
+			return OBJECT_VAL(krk_copyString(self->chars + offset, SEQUENCE_BYTES(self->chars[offset])));
 		} else {
-			krk_unicodeString(self);
 			unsigned char asbytes[5];
 			size_t length = krk_codepointToBytes(KRK_STRING_FAST(self,asInt),(unsigned char*)&asbytes);
 			return OBJECT_VAL(krk_copyString((char*)&asbytes, length));
@@ -147,21 +185,11 @@ KRK_METHOD(str,__getitem__,{
 		if (step == 1) {
 			long len = end - start;
 			if ((self->obj.flags & KRK_OBJ_FLAGS_STRING_MASK) == KRK_OBJ_FLAGS_STRING_ASCII) {
-				return OBJECT_VAL(krk_copyString(self->chars + start, len));
+				return OBJECT_VAL(krk_copyStringUninterned(self->chars + start, len));
 			} else {
-				size_t offset = 0;
-				size_t length = 0;
-				/* Figure out where the UTF8 for this string starts. */
-				krk_unicodeString(self);
-				for (long i = 0; i < start; ++i) {
-					uint32_t cp = KRK_STRING_FAST(self,i);
-					offset += CODEPOINT_BYTES(cp);
-				}
-				for (long i = start; i < end; ++i) {
-					uint32_t cp = KRK_STRING_FAST(self,i);
-					length += CODEPOINT_BYTES(cp);
-				}
-				return OBJECT_VAL(krk_copyString(self->chars + offset, length));
+				size_t offset = krk_stringByteOffset(self, start);
+				size_t length = krk_stringByteOffset(self, end) - offset;
+				return OBJECT_VAL(krk_copyStringUninterned(self->chars + offset, length));
 			}
 		} else {
 			struct StringBuilder sb = {0};
@@ -298,7 +326,7 @@ KRK_METHOD(str,format,{
 		}
 	}
 
-	KrkValue out = OBJECT_VAL(krk_copyString(stringBytes, stringLength));
+	KrkValue out = OBJECT_VAL(krk_copyStringUninterned(stringBytes, stringLength));
 	free(workSpace);
 	FREE_ARRAY(char,stringBytes,stringCapacity);
 	return out;
@@ -326,6 +354,317 @@ _freeAndDone:
 	return NONE_VAL();
 })
 
+/**
+ * @brief A parsed format specifier, as in @c {value:spec} in an f-string.
+ */
+struct FormatSpec {
+	char fill[5];       /**< UTF-8 for the fill character */
+	size_t fillLength;
+	char align;         /**< @c < @c > @c ^ @c = or 0 for the type's default */
+	char sign;          /**< @c + @c - space, or 0 */
+	char alternate;     /**< Set by @c # */
+	char grouping;      /**< @c , @c _ or 0 */
+	char type;          /**< Presentation type, or 0 */
+	long width;         /**< Minimum width in codepoints, or -1 */
+	long precision;     /**< Precision, or -1 */
+};
+
+/**
+ * @brief Parse a format specifier.
+ * @return NULL on success, or a description of what is wrong with @p spec
+ */
+static const char * parseFormatSpec(const char * spec, size_t length, struct FormatSpec * out) {
+	const char * c = spec;
+	const char * end = spec + length;
+	memset(out, 0, sizeof(struct FormatSpec));
+	out->fill[0] = ' ';
+	out->fillLength = 1;
+	out->width = -1;
+	out->precision = -1;
+
+#define IS_ALIGN(c) ((c) == '<' || (c) == '>' || (c) == '^' || (c) == '=')
+	size_t first = c < end ? SEQUENCE_BYTES(*c) : 0;
+	if (c + first < end && IS_ALIGN(c[first])) {
+		memcpy(out->fill, c, first);
+		out->fillLength = first;
+		out->align = c[first];
+		c += first + 1;
+	} else if (c < end && IS_ALIGN(*c)) {
+		out->align = *c++;
+	}
+#undef IS_ALIGN
+	if (c < end && (*c == '+' || *c == '-' || *c == ' ')) out->sign = *c++;
+	if (c < end && *c == '#') { out->alternate = 1; c++; }
+	if (c < end && *c == '0') {
+		if (!out->align) {
+			out->fill[0] = '0';
+			out->fillLength = 1;
+			out->align = '=';
+		}
+		c++;
+	}
+	if (c < end && *c >= '0' && *c <= '9') {
+		out->width = 0;
+		while (c < end && *c >= '0' && *c <= '9') out->width = out->width * 10 + (*c++ - '0');
+	}
+	if (c < end && (*c == ',' || *c == '_')) out->grouping = *c++;
+	if (c < end && *c == '.') {
+		c++;
+		if (c == end || *c < '0' || *c > '9') return "Format specifier missing precision";
+		out->precision = 0;
+		while (c < end && *c >= '0' && *c <= '9') out->precision = out->precision * 10 + (*c++ - '0');
+	}
+	if (c < end) {
+		if (!strchr("sbcdoxXneEfFgG%", *c)) return "Invalid format specifier";
+		out->type = *c++;
+	}
+	if (c != end) return "Invalid format specifier";
+	return NULL;
+}
+
+/* Pad @p body, whose first @p prefix bytes are a sign or base prefix, out to the requested width. */
+static KrkValue padFormatted(struct FormatSpec * spec, char defaultAlign, const char * body, size_t bodyLength, size_t bodyCodepoints, size_t prefix) {
+	struct StringBuilder sb = {0};
+	size_t padding = (spec->width > 0 && (size_t)spec->width > bodyCodepoints) ? spec->width - bodyCodepoints : 0;
+	char align = spec->align ? spec->align : defaultAlign;
+	size_t before = align == '<' ? 0 : (align == '^' ? padding / 2 : padding);
+	if (align == '=') pushStringBuilderStr(&sb, body, prefix);
+	for (size_t i = 0; i < before; ++i) pushStringBuilderStr(&sb, spec->fill, spec->fillLength);
+	if (align == '=') pushStringBuilderStr(&sb, body + prefix, bodyLength - prefix);
+	else pushStringBuilderStr(&sb, body, bodyLength);
+	for (size_t i = before; i < padding; ++i) pushStringBuilderStr(&sb, spec->fill, spec->fillLength);
+	return finishStringBuilder(&sb);
+}
+
+/* Copy @p digits into @p out with a separator between each group of @p every, returning the new length. */
+static size_t groupDigits(char * out, const char * digits, size_t count, char separator, size_t every) {
+	size_t o = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (separator && i && (count - i) % every == 0) out[o++] = separator;
+		out[o++] = digits[i];
+	}
+	return o;
+}
+
+static KrkValue formatInteger(struct FormatSpec * spec, krk_integer_type value) {
+	if (spec->precision != -1) return krk_runtimeError(vm.exceptions->valueError, "Precision not allowed in integer format specifier");
+	char type = spec->type ? spec->type : 'd';
+	if (type == 'c') {
+		if (spec->sign) return krk_runtimeError(vm.exceptions->valueError, "Sign not allowed with integer format specifier 'c'");
+		if (value < 0 || value > 0x10FFFF) return krk_runtimeError(vm.exceptions->valueError, "%%c arg not in range(0x110000)");
+		unsigned char bytes[5] = {0};
+		size_t len = krk_codepointToBytes(value, bytes);
+		return padFormatted(spec, '<', (char*)bytes, len, 1, 0);
+	}
+	if (spec->grouping == ',' && type != 'd' && type != 'n') {
+		return krk_runtimeError(vm.exceptions->valueError, "Cannot specify ',' with '%c'.", type);
+	}
+
+	unsigned int base = type == 'b' ? 2 : (type == 'o' ? 8 : ((type == 'x' || type == 'X') ? 16 : 10));
+	const char * alphabet = type == 'X' ? "0123456789ABCDEF" : "0123456789abcdef";
+	uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+	char digits[64];
+	size_t count = 0;
+	do {
+		digits[sizeof(digits) - ++count] = alphabet[magnitude % base];
+		magnitude /= base;
+	} while (magnitude);
+
+	char out[128];
+	size_t length = 0;
+	if (value < 0) out[length++] = '-';
+	else if (spec->sign == '+' || spec->sign == ' ') out[length++] = spec->sign;
+	if (spec->alternate && base != 10) {
+		out[length++] = '0';
+		out[length++] = type == 'X' ? 'X' : (type == 'x' ? 'x' : (type == 'o' ? 'o' : 'b'));
+	}
+	size_t prefix = length;
+	length += groupDigits(out + length, digits + sizeof(digits) - count, count, spec->grouping, base == 10 ? 3 : 4);
+	return padFormatted(spec, '>', out, length, length, prefix);
+}
+
+static KrkValue formatFloat(struct FormatSpec * spec, double value, KrkValue original) {
+	char type = spec->type;
+	if (type == 'n') type = 'g';
+	int negative = signbit(value);
+	double magnitude = negative ? -value : value;
+	char digits[512];
+	int count;
+
+	if (!type && spec->precision == -1) {
+		/* Same digits as str() */
+		krk_push(original);
+		KrkValue asString = krk_callDirect(krk_getType(original)->_tostr, 1);
+		if (!IS_STRING(asString)) return NONE_VAL();
+		const char * chars = AS_CSTRING(asString);
+		if (*chars == '-') chars++;
+		count = snprintf(digits, sizeof(digits) - 1, "%s", chars);
+		if (count > (int)sizeof(digits) - 2) count = sizeof(digits) - 2;
+	} else {
+		int precision = spec->precision == -1 ? 6 : (int)spec->precision;
+		if (precision > 100) precision = 100;
+		if (type == '%') magnitude *= 100.0;
+		char conversion = (!type) ? 'g' : (type == '%' ? 'f' : type);
+		char format[8];
+		snprintf(format, sizeof(format), "%%%s.*%c", spec->alternate ? "#" : "", conversion);
+		count = snprintf(digits, sizeof(digits) - 1, format, precision, magnitude);
+		if (count > (int)sizeof(digits) - 2) count = sizeof(digits) - 2;
+		if (type == '%') digits[count++] = '%';
+	}
+
+	char out[1024];
+	size_t length = 0;
+	if (negative) out[length++] = '-';
+	else if (spec->sign == '+' || spec->sign == ' ') out[length++] = spec->sign;
+	size_t prefix = length;
+
+	/* Only the integer part is grouped. */
+	size_t integerDigits = 0;
+	while ((int)integerDigits < count && digits[integerDigits] >= '0' && digits[integerDigits] <= '9') integerDigits++;
+	length += groupDigits(out + length, digits, integerDigits, spec->grouping, 3);
+	memcpy(out + length, digits + integerDigits, count - integerDigits);
+	length += count - integerDigits;
+	return padFormatted(spec, '>', out, length, length, prefix);
+}
+
+static KrkValue formatString(struct FormatSpec * spec, KrkString * value) {
+	if (spec->type && spec->type != 's') return krk_runtimeError(vm.exceptions->valueError, "Unknown format code '%c' for object of type 'str'", spec->type);
+	if (spec->sign) return krk_runtimeError(vm.exceptions->valueError, "Sign not allowed in string format specifier");
+	if (spec->alternate) return krk_runtimeError(vm.exceptions->valueError, "Alternate form (#) not allowed in string format specifier");
+	if (spec->grouping) return krk_runtimeError(vm.exceptions->valueError, "Cannot specify '%c' with 's'.", spec->grouping);
+	if (spec->align == '=') return krk_runtimeError(vm.exceptions->valueError, "'=' alignment not allowed in string format specifier");
+	size_t codepoints = value->codesLength;
+	size_t length = value->length;
+	if (spec->precision != -1 && (size_t)spec->precision < codepoints) {
+		codepoints = spec->precision;
+		length = krk_stringByteOffset(value, codepoints);
+	}
+	if ((spec->width <= 0 || (size_t)spec->width <= codepoints) && length == value->length) return OBJECT_VAL(value);
+	return padFormatted(spec, '<', value->chars, length, codepoints, 0);
+}
+
+/**
+ * Apply a format specifier to a value. Strings and numbers are handled here;
+ * anything else needs a @c __format__ method to accept a non-empty specifier.
+ */
+static KrkValue formatValue(KrkValue value, KrkString * specString) {
+	KrkClass * type = krk_getType(value);
+	KrkValue method;
+	if (krk_tableGet_fast(&type->methods, S("__format__"), &method)) {
+		krk_push(method);
+		krk_push(value);
+		krk_push(OBJECT_VAL(specString));
+		return krk_callStack(2);
+	}
+
+	struct FormatSpec spec;
+	const char * error = parseFormatSpec(specString->chars, specString->length, &spec);
+	if (error) return krk_runtimeError(vm.exceptions->valueError, "%s", error);
+
+	if (IS_STRING(value)) return formatString(&spec, AS_STRING(value));
+	if (IS_INTEGER(value)) {
+		if (spec.type && strchr("eEfFgG%", spec.type)) return formatFloat(&spec, (double)AS_INTEGER(value), value);
+		if (spec.type == 's') return krk_runtimeError(vm.exceptions->valueError, "Unknown format code 's' for object of type 'int'");
+		return formatInteger(&spec, AS_INTEGER(value));
+	}
+	if (IS_FLOATING(value)) {
+		if (spec.type && !strchr("neEfFgG%", spec.type)) return krk_runtimeError(vm.exceptions->valueError, "Unknown format code '%c' for object of type 'float'", spec.type);
+		return formatFloat(&spec, AS_FLOATING(value), value);
+	}
+	if (!specString->length) {
+		krk_push(value);
+		return krk_callDirect(type->_tostr, 1);
+	}
+	return krk_runtimeError(vm.exceptions->typeError, "unsupported format string passed to %s.__format__", krk_typeName(value));
+}
+
+/* Convert @p value to a string with str() or repr() */
+static KrkValue stringify(KrkValue value, int repr) {
+	if (IS_STRING(value) && !repr) return value;
+	KrkClass * type = krk_getType(value);
+	KrkObj * method = repr ? type->_reprer : type->_tostr;
+	krk_push(value);
+	KrkValue result;
+	if (method) {
+		result = krk_callDirect(method, 1);
+	} else {
+		krk_pop();
+		if (!krk_bindMethod(type, AS_STRING(vm.specialMethodNames[repr ? METHOD_REPR : METHOD_STR]))) {
+			return krk_runtimeError(vm.exceptions->typeError, "Failed to convert field to string.");
+		}
+		result = krk_callStack(0);
+	}
+	if (!(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) && !IS_STRING(result)) {
+		return krk_runtimeError(vm.exceptions->typeError, "%s returned non-string (type %s)",
+			repr ? "__repr__" : "__str__", krk_typeName(result));
+	}
+	return result;
+}
+
+_noexport
+int krk_formatValueOnStack(int flags) {
+	if (flags & (KRK_FORMAT_STR | KRK_FORMAT_REPR)) {
+		KrkValue converted = stringify(krk_peek((flags & KRK_FORMAT_SPEC) ? 1 : 0), flags & KRK_FORMAT_REPR);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return 0;
+		krk_currentThread.stackTop[(flags & KRK_FORMAT_SPEC) ? -2 : -1] = converted;
+	}
+	if (flags & KRK_FORMAT_SPEC) {
+		KrkValue result = formatValue(krk_peek(1), AS_STRING(krk_peek(0)));
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return 0;
+		if (!IS_STRING(result)) {
+			krk_runtimeError(vm.exceptions->typeError, "__format__ must return a str, not %s", krk_typeName(result));
+			return 0;
+		}
+		krk_currentThread.stackTop[-2] = result;
+		krk_pop();
+	}
+	return 1;
+}
+
+_noexport
+int krk_buildString(size_t count) {
+	size_t length = 0;
+	size_t codesLength = 0;
+	int type = KRK_OBJ_FLAGS_STRING_ASCII;
+
+	/* Each value is replaced with its string on the stack, where the collector can see it. */
+	for (size_t i = 0; i < count; ++i) {
+		KrkValue value = krk_currentThread.stackTop[(ssize_t)i - (ssize_t)count];
+		if (!IS_STRING(value)) {
+			KrkValue method;
+			/* Like format(value, ''), a field without a specifier still goes through __format__ */
+			if (IS_OBJECT(value) && krk_tableGet_fast(&krk_getType(value)->methods, S("__format__"), &method)) {
+				value = formatValue(value, S(""));
+				if (!(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) && !IS_STRING(value)) {
+					krk_runtimeError(vm.exceptions->typeError, "__format__ must return a str, not %s", krk_typeName(value));
+				}
+			} else {
+				value = stringify(value, 0);
+			}
+			if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return 0;
+			krk_currentThread.stackTop[(ssize_t)i - (ssize_t)count] = value;
+		}
+		KrkString * string = AS_STRING(value);
+		length += string->length;
+		codesLength += string->codesLength;
+		if ((string->obj.flags & KRK_OBJ_FLAGS_STRING_MASK) > type) type = string->obj.flags & KRK_OBJ_FLAGS_STRING_MASK;
+	}
+
+	char * chars = ALLOCATE(char, length + 1);
+	size_t offset = 0;
+	for (size_t i = 0; i < count; ++i) {
+		KrkString * string = AS_STRING(krk_currentThread.stackTop[(ssize_t)i - (ssize_t)count]);
+		memcpy(chars + offset, string->chars, string->length);
+		offset += string->length;
+	}
+	chars[length] = '\0';
+
+	KrkString * result = krk_takeStringVettedUninterned(chars, length, codesLength, type);
+	krk_currentThread.stackTop[-(ssize_t)count] = OBJECT_VAL(result);
+	krk_currentThread.stackTop -= count - 1;
+	return 1;
+}
+
 KRK_METHOD(str,__mul__,{
 	METHOD_TAKES_EXACTLY(1);
 	if (!IS_INTEGER(argv[1])) return NOTIMPL_VAL();
@@ -343,7 +682,7 @@ KRK_METHOD(str,__mul__,{
 	}
 
 	*c = '\0';
-	return OBJECT_VAL(krk_takeString(out, totalLength));
+	return OBJECT_VAL(krk_takeStringUninterned(out, totalLength));
 })
 
 KRK_METHOD(str,__rmul__,{
@@ -397,21 +736,10 @@ KRK_METHOD(str,__contains__,{
 	METHOD_TAKES_EXACTLY(1);
 	if (IS_NONE(argv[1])) return BOOLEAN_VAL(0);
 	CHECK_ARG(1,str,KrkString*,needle);
-	for (size_t i = 0; i < self->length; ++i) {
-		if (substringMatch(self->chars + i, self->length - i, needle->chars, needle->length)) {
-			return BOOLEAN_VAL(1);
-		}
-	}
-	return BOOLEAN_VAL(0);
+	if (!self->length) return BOOLEAN_VAL(0);
+	return BOOLEAN_VAL(krk_findBytes(self->chars, self->length, needle->chars, needle->length) != NULL);
 })
 
-static int charIn(char c, const char * str) {
-	for (const char * s = str; *s; s++) {
-		if (c == *s) return 1;
-	}
-	return 0;
-}
-
 /**
  * Implements all three of strip, lstrip, rstrip.
  * Set which = 0, 1, 2 respectively
@@ -423,6 +751,7 @@ static KrkValue _string_strip_shared(int argc, const KrkValue argv[], int which)
 	size_t start = 0;
 	size_t end   = AS_STRING(argv[0])->length;
 	const char * subset = " \t\n\r";
+	unsigned char inSubset[256] = {0};
 	if (argc > 1) {
 		if (IS_STRING(argv[1])) {
 			subset = AS_CSTRING(argv[1]);
@@ -434,9 +763,11 @@ static KrkValue _string_strip_shared(int argc, const KrkValue argv[], int which)
 		return krk_runtimeError(vm.exceptions->typeError, "%sstrip() takes at most one argument",
 			(which == 0 ? "" : (which == 1 ? "l" : "r")));
 	}
-	if (which < 2) while (start < end && charIn(AS_CSTRING(argv[0])[start], subset)) start++;
-	if (which != 1) while (end > start && charIn(AS_CSTRING(argv[0])[end-1], subset)) end--;
-	return OBJECT_VAL(krk_copyString(&AS_CSTRING(argv[0])[start], end-start));
+	for (const char * c = subset; *c; ++c) inSubset[(unsigned char)*c] = 1;
+	const unsigned char * chars = (const unsigned char *)AS_CSTRING(argv[0]);
+	if (which < 2) while (start < end && inSubset[chars[start]]) start++;
+	if (which != 1) while (end > start && inSubset[chars[end-1]]) end--;
+	return OBJECT_VAL(krk_copyStringUninterned(&AS_CSTRING(argv[0])[start], end-start));
 }
 
 KRK_METHOD(str,strip,{
@@ -580,6 +911,13 @@ _exception:
 	return NONE_VAL();
 })
 
+static void appendPiece(KrkValue list, const char * from, size_t length) {
+	KrkValue tmp = OBJECT_VAL(krk_copyStringUninterned(from, length));
+	krk_push(tmp);
+	krk_writeValueArray(AS_LIST(list), tmp);
+	krk_pop();
+}
+
 /* str.split() */
 KRK_METHOD(str,split,{
 	METHOD_TAKES_AT_MOST(2);
@@ -600,68 +938,33 @@ KRK_METHOD(str,split,{
 	krk_push(myList);
 
 	size_t i = 0;
-	char * c = self->chars;
+	const char * c = self->chars;
 	size_t count = 0;
 
 	if (argc < 2) {
 		while (i != self->length) {
-			while (i != self->length && isWhitespace(*c)) {
-				i++; c++;
-			}
+			while (i != self->length && isWhitespace(c[i])) i++;
 			if (i != self->length) {
-				size_t stringCapacity = 0;
-				size_t stringLength   = 0;
-				char * stringBytes    = NULL;
-				while (i != self->length && !isWhitespace(*c)) {
-					PUSH_CHAR(*c);
-					i++; c++;
-				}
-				KrkValue tmp = OBJECT_VAL(krk_copyString(stringBytes, stringLength));
-				FREE_ARRAY(char,stringBytes,stringCapacity);
-				krk_push(tmp);
-				krk_writeValueArray(AS_LIST(myList), tmp);
-				krk_pop();
+				size_t start = i;
+				while (i != self->length && !isWhitespace(c[i])) i++;
+				appendPiece(myList, c + start, i - start);
 			}
 		}
 	} else {
+		KrkString * separator = AS_STRING(argv[1]);
 		while (i != self->length) {
-			size_t stringCapacity = 0;
-			size_t stringLength   = 0;
-			char * stringBytes    = NULL;
-			while (i != self->length && !substringMatch(c, self->length - i, AS_STRING(argv[1])->chars, AS_STRING(argv[1])->length)) {
-				PUSH_CHAR(*c);
-				i++; c++;
-			}
-			KrkValue tmp = OBJECT_VAL(krk_copyString(stringBytes, stringLength));
-			if (stringBytes) FREE_ARRAY(char,stringBytes,stringCapacity);
-			krk_push(tmp);
-			krk_writeValueArray(AS_LIST(myList), tmp);
-			krk_pop();
-			if (substringMatch(c, self->length - i, AS_STRING(argv[1])->chars, AS_STRING(argv[1])->length)) {
-				i += AS_STRING(argv[1])->length;
-				c += AS_STRING(argv[1])->length;
+			const char * found = krk_findBytes(c + i, self->length - i, separator->chars, separator->length);
+			size_t pieceEnd = found ? (size_t)(found - c) : self->length;
+			appendPiece(myList, c + i, pieceEnd - i);
+			i = pieceEnd;
+			if (found) {
+				i += separator->length;
 				count++;
 				if (argc > 2 && count == (size_t)AS_INTEGER(argv[2])) {
-					size_t stringCapacity = 0;
-					size_t stringLength   = 0;
-					char * stringBytes    = NULL;
-					while (i != self->length) {
-						PUSH_CHAR(*c);
-						i++; c++;
-					}
-					KrkValue tmp = OBJECT_VAL(krk_copyString(stringBytes, stringLength));
-					if (stringBytes) FREE_ARRAY(char,stringBytes,stringCapacity);
-					krk_push(tmp);
-					krk_writeValueArray(AS_LIST(myList), tmp);
-					krk_pop();
+					appendPiece(myList, c + i, self->length - i);
 					break;
 				}
-				if (i == self->length) {
-					KrkValue tmp = OBJECT_VAL(S(""));
-					krk_push(tmp);
-					krk_writeValueArray(AS_LIST(myList), tmp);
-					krk_pop();
-				}
+				if (i == self->length) appendPiece(myList, c + i, 0);
 			}
 		}
 	}
@@ -676,6 +979,27 @@ KRK_METHOD(str,replace,{
 	CHECK_ARG(1,str,KrkString*,oldStr);
 	CHECK_ARG(2,str,KrkString*,newStr);
 	KrkValue count = (argc > 3 && IS_INTEGER(argv[3])) ? argv[3] : NONE_VAL();
+
+	if (oldStr->length) {
+		struct StringBuilder sb = {0};
+		krk_integer_type replacements = 0;
+		size_t i = 0;
+		while (i < self->length) {
+			const char * found = (IS_NONE(count) || replacements < AS_INTEGER(count)) ?
+				krk_findBytes(self->chars + i, self->length - i, oldStr->chars, oldStr->length) : NULL;
+			if (!found) {
+				pushStringBuilderStr(&sb, self->chars + i, self->length - i);
+				break;
+			}
+			pushStringBuilderStr(&sb, self->chars + i, found - (self->chars + i));
+			pushStringBuilderStr(&sb, newStr->chars, newStr->length);
+			i = found - self->chars + oldStr->length;
+			replacements++;
+		}
+		return finishStringBuilder(&sb);
+	}
+
+	/* An empty pattern matches before every character. */
 	size_t stringCapacity = 0;
 	size_t stringLength   = 0;
 	char * stringBytes    = NULL;
@@ -702,7 +1026,7 @@ KRK_METHOD(str,replace,{
 			i++;
 		}
 	}
-	KrkValue tmp = OBJECT_VAL(krk_copyString(stringBytes, stringLength));
+	KrkValue tmp = OBJECT_VAL(krk_copyStringUninterned(stringBytes, stringLength));
 	if (stringBytes) FREE_ARRAY(char,stringBytes,stringCapacity);
 	return tmp;
 })
@@ -739,19 +1063,22 @@ KRK_METHOD(str,find,{
 	WRAP_INDEX(start);
 	WRAP_INDEX(end);
 
-	/* Make sure both strings have code representations */
-	krk_unicodeString(self);
-	krk_unicodeString(substr);
+	if (start >= end) return INTEGER_VAL(-1);
 
-	for (krk_integer_type i = start; i < end; ++i) {
-		krk_integer_type j;
-		for (j = 0; j < (krk_integer_type)substr->codesLength && (i + j < end); ++j) {
-			if (KRK_STRING_FAST(self,i+j) != KRK_STRING_FAST(substr,j)) break;
-		}
-		if (j == (krk_integer_type)substr->codesLength) return INTEGER_VAL(i);
-	}
+	/* Search the UTF-8 directly and count codepoints up to the match. */
+	size_t byteStart = krk_stringByteOffset(self, start);
+	size_t byteEnd = krk_stringByteOffset(self, end);
+	const char * found = krk_findBytes(self->chars + byteStart, byteEnd - byteStart, substr->chars, substr->length);
+	if (!found) return INTEGER_VAL(-1);
 
-	return INTEGER_VAL(-1);
+	if ((self->obj.flags & KRK_OBJ_FLAGS_STRING_MASK) == KRK_OBJ_FLAGS_STRING_ASCII) {
+		return INTEGER_VAL(found - self->chars);
+	}
+	krk_integer_type index = start;
+	for (const char * c = self->chars + byteStart; c < found; ++c) {
+		if ((*c & 0xC0) != 0x80) index++;
+	}
+	return INTEGER_VAL(index);
 })
 
 KRK_METHOD(str,index,{
@@ -833,7 +1160,7 @@ KRK_METHOD(str,__repr__,{
 	}
 
 	PUSH_CHAR(quote);
-	KrkValue tmp = OBJECT_VAL(krk_copyString(stringBytes, stringLength));
+	KrkValue tmp = OBJECT_VAL(krk_copyStringUninterned(stringBytes, stringLength));
 	if (stringBytes) FREE_ARRAY(char,stringBytes,stringCapacity);
 	return tmp;
 })
@@ -959,6 +1286,7 @@ KRK_METHOD(striterator,__init__,{
 	CHECK_ARG(1,str,KrkString*,base);
 	krk_push(OBJECT_VAL(self));
 	krk_attachNamedObject(&self->fields, "s", (KrkObj*)base);
+	/* Byte offset of the next character, so iterating never needs to index by codepoint. */
 	krk_attachNamedValue(&self->fields, "i", INTEGER_VAL(0));
 	return krk_pop();
 })
@@ -977,11 +1305,14 @@ KRK_METHOD(striterator,__call__,{
 		goto _corrupt;
 	}
 
-	if ((size_t)AS_INTEGER(_counter) >= AS_STRING(_str)->codesLength) {
+	KrkString * string = AS_STRING(_str);
+	size_t offset = AS_INTEGER(_counter);
+	size_t length = offset < string->length ? SEQUENCE_BYTES(string->chars[offset]) : 0;
+	if (!length || offset + length > string->length) {
 		return argv[0];
 	} else {
-		krk_attachNamedValue(&self->fields, "i", INTEGER_VAL(AS_INTEGER(_counter)+1));
-		return FUNC_NAME(str,__getitem__)(2,(KrkValue[]){_str,_counter},3);
+		krk_attachNamedValue(&self->fields, "i", INTEGER_VAL(offset + length));
+		return OBJECT_VAL(krk_copyString(string->chars + offset, length));
 	}
 _corrupt:
 	return krk_runtimeError(vm.exceptions->typeError, "Corrupt str iterator: %s", errorStr);
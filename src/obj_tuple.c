@@ -140,20 +140,11 @@ KRK_METHOD(tuple,__repr__,{
 	return finishStringBuilder(&sb);
 })
 
-/**
- * @brief Iterator over the values in a tuple.
- * @extends KrkInstance
- */
-struct TupleIter {
-	KrkInstance inst;
-	KrkValue myTuple;
-	int i;
-};
-
 static KrkValue _tuple_iter_init(int argc, const KrkValue argv[], int hasKw) {
 	struct TupleIter * self = (struct TupleIter *)AS_OBJECT(argv[0]);
 	self->myTuple = argv[1];
 	self->i = 0;
+	krk_gcWriteBarrier((KrkObj*)self);
 	return argv[0];
 }
 
@@ -7,25 +7,42 @@
 #include <kuroko/value.h>
 #include <kuroko/vm.h>
 #include <kuroko/table.h>
+#include <kuroko/util.h>
+
+#include "private.h"
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+# include <arm_neon.h>
+#endif
 
 #define ALLOCATE_OBJECT(type, objectType) \
 	(type*)allocateObject(sizeof(type), objectType)
 
-#ifdef ENABLE_THREADING
-static volatile int _stringLock = 0;
-static volatile int _objectLock = 0;
-#endif
 
+/**
+ * Once there is more than one thread, each one puts the objects it makes
+ * on its own list, which the collector moves to @c vm.objects while every
+ * thread is stopped, so allocating does not take a lock.
+ */
 static KrkObj * allocateObject(size_t size, KrkObjType type) {
-	KrkObj * object = (KrkObj*)krk_reallocate(NULL, 0, size);
+	KrkObj * object = (KrkObj*)krk_allocateObjectMemory(size);
 	memset(object,0,size);
 	object->type = type;
 
-	_obtain_lock(_objectLock);
-	object->next = vm.objects;
 	krk_currentThread.scratchSpace[2] = OBJECT_VAL(object);
-	vm.objects = object;
-	_release_lock(_objectLock);
+#ifdef ENABLE_THREADING
+	if (vm.globalFlags & KRK_GLOBAL_THREADS) {
+		if (!krk_currentThread.objects) krk_currentThread.objectsTail = object;
+		object->next = krk_currentThread.objects;
+		krk_currentThread.objects = object;
+	} else
+#endif
+	{
+		object->next = vm.objects;
+		vm.objects = object;
+	}
 
 	object->hash = (uint32_t)((intptr_t)(object) >> 4 | ((intptr_t)object & 0xf) << 28);
 
@@ -100,18 +117,49 @@ _reject:
 	return *state;
 }
 
+/**
+ * Length of the run of ASCII bytes at the start of @p chars, checked sixteen
+ * bytes at a time with SSE2 or NEON where they are available, and eight
+ * bytes at a time otherwise. Most text is almost all ASCII, and those runs
+ * need no decoding at all.
+ */
+static inline size_t asciiPrefix(const unsigned char * chars, size_t length) {
+	size_t i = 0;
+#if defined(__SSE2__)
+	for (; i + 16 <= length; i += 16) {
+		int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(chars + i)));
+		if (mask) return i + __builtin_ctz(mask);
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	for (; i + 16 <= length; i += 16) {
+		if (vmaxvq_u8(vld1q_u8(chars + i)) & 0x80) break;
+	}
+#endif
+	for (; i + 8 <= length; i += 8) {
+		uint64_t word;
+		memcpy(&word, chars + i, 8);
+		if (word & 0x8080808080808080ULL) break;
+	}
+	while (i < length && chars[i] < 0x80) i++;
+	return i;
+}
+
 static int checkString(const char * chars, size_t length, size_t *codepointCount) {
 	uint32_t state = 0;
 	uint32_t codepoint = 0;
 	unsigned char * end = (unsigned char *)chars + length;
 	uint32_t maxCodepoint = 0;
 	for (unsigned char * c = (unsigned char *)chars; c < end; ++c) {
+		if (state == UTF8_ACCEPT && *c < 0x80) {
+			size_t run = asciiPrefix(c, end - c);
+			*codepointCount += run;
+			c += run - 1;
+			continue;
+		}
 		if (!decode(&state, &codepoint, *c)) {
 			if (codepoint > maxCodepoint) maxCodepoint = codepoint;
 			(*codepointCount)++;
 		} else if (state == UTF8_REJECT) {
-			_release_lock(_stringLock);
-			krk_runtimeError(vm.exceptions->valueError, "Invalid UTF-8 sequence in string.");
 			*codepointCount = 0;
 			return -1;
 		}
@@ -127,6 +175,57 @@ static int checkString(const char * chars, size_t length, size_t *codepointCount
 	}
 }
 
+/* Copy a run of ASCII bytes into a widened codepoint buffer. */
+static inline void widen1(uint8_t * out, const unsigned char * in, size_t count) {
+	memcpy(out, in, count);
+}
+
+static inline void widen2(uint16_t * out, const unsigned char * in, size_t count) {
+	size_t i = 0;
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(in + i));
+		_mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi8(bytes, zero));
+		_mm_storeu_si128((__m128i*)(out + i + 8), _mm_unpackhi_epi8(bytes, zero));
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	for (; i + 16 <= count; i += 16) {
+		uint8x16_t bytes = vld1q_u8(in + i);
+		vst1q_u16(out + i, vmovl_u8(vget_low_u8(bytes)));
+		vst1q_u16(out + i + 8, vmovl_high_u8(bytes));
+	}
+#endif
+	for (; i < count; ++i) out[i] = in[i];
+}
+
+static inline void widen4(uint32_t * out, const unsigned char * in, size_t count) {
+	size_t i = 0;
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i low = _mm_unpacklo_epi8(bytes, zero);
+		__m128i high = _mm_unpackhi_epi8(bytes, zero);
+		_mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi16(low, zero));
+		_mm_storeu_si128((__m128i*)(out + i + 4), _mm_unpackhi_epi16(low, zero));
+		_mm_storeu_si128((__m128i*)(out + i + 8), _mm_unpacklo_epi16(high, zero));
+		_mm_storeu_si128((__m128i*)(out + i + 12), _mm_unpackhi_epi16(high, zero));
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	for (; i + 16 <= count; i += 16) {
+		uint8x16_t bytes = vld1q_u8(in + i);
+		uint16x8_t low = vmovl_u8(vget_low_u8(bytes));
+		uint16x8_t high = vmovl_high_u8(bytes);
+		vst1q_u32(out + i, vmovl_u16(vget_low_u16(low)));
+		vst1q_u32(out + i + 4, vmovl_high_u16(low));
+		vst1q_u32(out + i + 8, vmovl_u16(vget_low_u16(high)));
+		vst1q_u32(out + i + 12, vmovl_high_u16(high));
+	}
+#endif
+	for (; i < count; ++i) out[i] = in[i];
+}
+
 #define GENREADY(size,type) \
 	static void _readyUCS ## size (KrkString * string) { \
 		uint32_t state = 0; \
@@ -135,7 +234,12 @@ static int checkString(const char * chars, size_t length, size_t *codepointCount
 		string->codes = malloc(sizeof(type) * string->codesLength); \
 		type *outPtr = (type *)string->codes; \
 		for (unsigned char * c = (unsigned char *)string->chars; c < end; ++c) { \
-			if (!decode(&state, &codepoint, *c)) { \
+			if (state == UTF8_ACCEPT && *c < 0x80) { \
+				size_t run = asciiPrefix(c, end - c); \
+				widen ## size (outPtr, c, run); \
+				outPtr += run; \
+				c += run - 1; \
+			} else if (!decode(&state, &codepoint, *c)) { \
 				*(outPtr++) = (type)codepoint; \
 			} else if (state == UTF8_REJECT) { \
 				state = 0; \
@@ -148,6 +252,11 @@ GENREADY(4,uint32_t)
 #undef GENREADY
 
 void * krk_unicodeString(KrkString * string) {
+	if (string->obj.flags & KRK_OBJ_FLAGS_STRING_BREADCRUMBS) {
+		free(string->codes);
+		string->codes = NULL;
+		string->obj.flags &= ~KRK_OBJ_FLAGS_STRING_BREADCRUMBS;
+	}
 	if (string->codes) return string->codes;
 	else if ((string->obj.flags & KRK_OBJ_FLAGS_STRING_MASK) == KRK_OBJ_FLAGS_STRING_UCS1) _readyUCS1(string);
 	else if ((string->obj.flags & KRK_OBJ_FLAGS_STRING_MASK) == KRK_OBJ_FLAGS_STRING_UCS2) _readyUCS2(string);
@@ -156,6 +265,79 @@ void * krk_unicodeString(KrkString * string) {
 	return string->codes;
 }
 
+/*
+ * Single bytes go to memchr. Longer needles are found by testing sixteen
+ * positions at once for both their first and last bytes and only comparing
+ * the rest where both match, which rejects nearly every position in a
+ * couple of instructions; without SSE2, memchr on the first byte plays the
+ * same role.
+ */
+const char * krk_findBytes(const char * haystack, size_t haystackLength, const char * needle, size_t needleLength) {
+	if (needleLength == 0) return haystack;
+	if (needleLength > haystackLength) return NULL;
+	if (needleLength == 1) return memchr(haystack, needle[0], haystackLength);
+
+	size_t positions = haystackLength - needleLength + 1;
+	size_t i = 0;
+#if defined(__SSE2__)
+	const __m128i first = _mm_set1_epi8(needle[0]);
+	const __m128i last  = _mm_set1_epi8(needle[needleLength - 1]);
+	for (; i + 16 <= positions; i += 16) {
+		__m128i starts = _mm_loadu_si128((const __m128i*)(haystack + i));
+		__m128i ends = _mm_loadu_si128((const __m128i*)(haystack + i + needleLength - 1));
+		int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(starts, first), _mm_cmpeq_epi8(ends, last)));
+		while (mask) {
+			const char * candidate = haystack + i + __builtin_ctz(mask);
+			if (!memcmp(candidate + 1, needle + 1, needleLength - 2)) return candidate;
+			mask &= mask - 1;
+		}
+	}
+#endif
+	while (i < positions) {
+		const char * candidate = memchr(haystack + i, needle[0], positions - i);
+		if (!candidate) return NULL;
+		if (candidate[needleLength - 1] == needle[needleLength - 1] && !memcmp(candidate + 1, needle + 1, needleLength - 2)) return candidate;
+		i = candidate - haystack + 1;
+	}
+	return NULL;
+}
+
+/* Bytes in the UTF-8 sequence that starts with @p lead */
+static inline size_t sequenceLength(unsigned char lead) {
+	return lead < 0x80 ? 1 : (lead < 0xE0 ? 2 : (lead < 0xF0 ? 3 : 4));
+}
+
+/* Walk forward @p count codepoints from the byte at @p offset */
+static inline size_t skipCodepoints(KrkString * string, size_t offset, size_t count) {
+	const unsigned char * chars = (const unsigned char *)string->chars;
+	while (count--) offset += sequenceLength(chars[offset]);
+	return offset;
+}
+
+static void buildBreadcrumbs(KrkString * string) {
+	size_t count = string->codesLength / KRK_STRING_BREADCRUMB_SPACING + 1;
+	size_t * crumbs = malloc(sizeof(size_t) * count);
+	crumbs[0] = 0;
+	for (size_t i = 1; i < count; ++i) {
+		crumbs[i] = skipCodepoints(string, crumbs[i-1], KRK_STRING_BREADCRUMB_SPACING);
+	}
+	string->codes = crumbs;
+	string->obj.flags |= KRK_OBJ_FLAGS_STRING_BREADCRUMBS;
+}
+
+size_t krk_stringByteOffset(KrkString * string, size_t index) {
+	if ((string->obj.flags & KRK_OBJ_FLAGS_STRING_MASK) == KRK_OBJ_FLAGS_STRING_ASCII) return index;
+	if (index >= string->codesLength) return string->length;
+	if (string->codes && !(string->obj.flags & KRK_OBJ_FLAGS_STRING_BREADCRUMBS)) {
+		/* Already widened; lookups through it don't need the UTF-8 offset. */
+		return skipCodepoints(string, 0, index);
+	}
+	if (string->codesLength <= KRK_STRING_BREADCRUMB_SPACING) return skipCodepoints(string, 0, index);
+	if (!string->codes) buildBreadcrumbs(string);
+	size_t * crumbs = string->codes;
+	return skipCodepoints(string, crumbs[index / KRK_STRING_BREADCRUMB_SPACING], index % KRK_STRING_BREADCRUMB_SPACING);
+}
+
 uint32_t krk_unicodeCodepoint(KrkString * string, size_t index) {
 	krk_unicodeString(string);
 	switch (string->obj.flags & KRK_OBJ_FLAGS_STRING_MASK) {
@@ -169,93 +351,228 @@ uint32_t krk_unicodeCodepoint(KrkString * string, size_t index) {
 	}
 }
 
-static KrkString * allocateString(char * chars, size_t length, uint32_t hash) {
+/**
+ * If @p intern is set, the caller holds @c vm.stringLock, which this releases,
+ * and the new string is added to the string table. Otherwise @p hash is
+ * ignored and the string's hash is left to be calculated when it is needed.
+ */
+static KrkString * allocateString(char * chars, size_t length, uint32_t hash, int intern) {
 	size_t codesLength = 0;
 	int type = checkString(chars,length,&codesLength);
 	if (type == -1) {
+		/* Raising makes strings, so it has to wait until the string table is unlocked. */
+		if (intern) {
+			_release_lock(vm.stringLock);
+		}
+		FREE_ARRAY(char, chars, length + 1);
+		krk_runtimeError(vm.exceptions->valueError, "Invalid UTF-8 sequence in string.");
 		return krk_copyString("",0);
 	}
 	KrkString * string = ALLOCATE_OBJECT(KrkString, KRK_OBJ_STRING);
 	string->length = length;
 	string->chars = chars;
-	string->obj.hash = hash;
-	string->obj.flags |= KRK_OBJ_FLAGS_VALID_HASH | type;
+	string->obj.flags |= type;
 	string->codesLength = codesLength;
 	string->codes = NULL;
 	if (type == KRK_OBJ_FLAGS_STRING_ASCII) string->codes = string->chars;
-	krk_push(OBJECT_VAL(string));
-	krk_tableSet(&vm.strings, OBJECT_VAL(string), NONE_VAL());
-	krk_pop();
-	_release_lock(_stringLock);
+	if (intern) {
+		string->obj.hash = hash;
+		string->obj.flags |= KRK_OBJ_FLAGS_VALID_HASH | KRK_OBJ_FLAGS_STRING_INTERNED;
+		krk_push(OBJECT_VAL(string));
+		krk_tableSet(&vm.strings, OBJECT_VAL(string), NONE_VAL());
+		krk_pop();
+		_release_lock(vm.stringLock);
+	}
 	return string;
 }
 
-static uint32_t hashString(const char * key, size_t length) {
-	uint32_t hash = 0;
-	/* This is the so-called "sdbm" hash. It comes from a piece of
-	 * public domain code from a clone of ndbm. */
-	for (size_t i = 0; i < length; ++i) {
-		hash = (int)key[i] + (hash << 6) + (hash << 16) - hash;
+static uint64_t hashSeed = 0;
+
+/*
+ * This is wyhash (final4), by Wang Yi, which is in the public domain:
+ * strings are consumed eight bytes at a time in three independent lanes,
+ * and each step folds a 128-bit product back down to 64 bits.
+ */
+static const uint64_t hashPrimes[4] = {
+	0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull,
+};
+
+static inline void hashMultiply(uint64_t * a, uint64_t * b) {
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32);
+	uint64_t c = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t hashMix(uint64_t a, uint64_t b) {
+	hashMultiply(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t read64(const uint8_t * p) { uint64_t v; memcpy(&v, p, 8); return v; }
+static inline uint64_t read32(const uint8_t * p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static inline uint64_t read3(const uint8_t * p, size_t k) { return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1]; }
+
+uint32_t krk_hashBytes(const void * key, size_t length) {
+	const uint8_t * p = key;
+	uint64_t seed = hashSeed;
+	uint64_t a, b;
+	if (likely(length <= 16)) {
+		if (likely(length >= 4)) {
+			a = (read32(p) << 32) | read32(p + ((length >> 3) << 2));
+			b = (read32(p + length - 4) << 32) | read32(p + length - 4 - ((length >> 3) << 2));
+		} else if (likely(length > 0)) {
+			a = read3(p, length);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = length;
+		if (unlikely(i > 48)) {
+			uint64_t see1 = seed, see2 = seed;
+			do {
+				seed = hashMix(read64(p) ^ hashPrimes[1], read64(p + 8) ^ seed);
+				see1 = hashMix(read64(p + 16) ^ hashPrimes[2], read64(p + 24) ^ see1);
+				see2 = hashMix(read64(p + 32) ^ hashPrimes[3], read64(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (likely(i > 48));
+			seed ^= see1 ^ see2;
+		}
+		while (unlikely(i > 16)) {
+			seed = hashMix(read64(p) ^ hashPrimes[1], read64(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = read64(p + i - 16);
+		b = read64(p + i - 8);
 	}
-	return hash;
+	a ^= hashPrimes[1];
+	b ^= seed;
+	hashMultiply(&a, &b);
+	return (uint32_t)hashMix(a ^ hashPrimes[0] ^ length, b ^ hashPrimes[1]);
+}
+
+void krk_seedHash(uint64_t seed) {
+	hashSeed = seed ^ hashMix(seed ^ hashPrimes[0], hashPrimes[1]);
+}
+
+uint32_t krk_stringHashSlow(KrkString * string) {
+	string->obj.hash = krk_hashBytes(string->chars, string->length);
+	string->obj.flags |= KRK_OBJ_FLAGS_VALID_HASH;
+	return string->obj.hash;
 }
 
 KrkString * krk_takeString(char * chars, size_t length) {
-	uint32_t hash = hashString(chars, length);
-	_obtain_lock(_stringLock);
+	uint32_t hash = krk_hashBytes(chars, length);
+	_obtain_lock(vm.stringLock);
 	KrkString * interned = krk_tableFindString(&vm.strings, chars, length, hash);
 	if (interned != NULL) {
 		free(chars); /* This string isn't owned by us yet, so free, not FREE_ARRAY */
-		_release_lock(_stringLock);
+		_release_lock(vm.stringLock);
 		return interned;
 	}
 
 	/* Part of taking ownership of this string is that we track its memory usage */
 	krk_gcTakeBytes(chars, length + 1);
-	KrkString * result = allocateString(chars, length, hash);
-	return result;
+	return allocateString(chars, length, hash, 1);
 }
 
 KrkString * krk_copyString(const char * chars, size_t length) {
-	uint32_t hash = hashString(chars, length);
-	_obtain_lock(_stringLock);
+	uint32_t hash = krk_hashBytes(chars, length);
+	_obtain_lock(vm.stringLock);
 	KrkString * interned = krk_tableFindString(&vm.strings, chars ? chars : "", length, hash);
 	if (interned) {
-		_release_lock(_stringLock);
+		_release_lock(vm.stringLock);
 		return interned;
 	}
 	char * heapChars = ALLOCATE(char, length + 1);
 	memcpy(heapChars, chars ? chars : "", length);
 	heapChars[length] = '\0';
-	KrkString * result = allocateString(heapChars, length, hash);
-	if (result->chars != heapChars) free(heapChars);
-	_release_lock(_stringLock);
-	return result;
+	return allocateString(heapChars, length, hash, 1);
+}
+
+static KrkString * vettedString(char * chars, size_t length, size_t codesLength, KrkStringType type) {
+	KrkString * string = ALLOCATE_OBJECT(KrkString, KRK_OBJ_STRING);
+	string->length = length;
+	string->chars = chars;
+	string->obj.flags |= type;
+	string->codesLength = codesLength;
+	string->codes = NULL;
+	if (type == KRK_OBJ_FLAGS_STRING_ASCII) string->codes = string->chars;
+	return string;
 }
 
 KrkString * krk_takeStringVetted(char * chars, size_t length, size_t codesLength, KrkStringType type, uint32_t hash) {
-	_obtain_lock(_stringLock);
+	_obtain_lock(vm.stringLock);
 	KrkString * interned = krk_tableFindString(&vm.strings, chars, length, hash);
 	if (interned != NULL) {
 		FREE_ARRAY(char, chars, length + 1);
-		_release_lock(_stringLock);
+		_release_lock(vm.stringLock);
 		return interned;
 	}
-	KrkString * string = ALLOCATE_OBJECT(KrkString, KRK_OBJ_STRING);
-	string->length = length;
-	string->chars = chars;
+	KrkString * string = vettedString(chars, length, codesLength, type);
 	string->obj.hash = hash;
-	string->obj.flags |= KRK_OBJ_FLAGS_VALID_HASH | type;
-	string->codesLength = codesLength;
-	string->codes = NULL;
-	if (type == KRK_OBJ_FLAGS_STRING_ASCII) string->codes = string->chars;
+	string->obj.flags |= KRK_OBJ_FLAGS_VALID_HASH | KRK_OBJ_FLAGS_STRING_INTERNED;
 	krk_push(OBJECT_VAL(string));
 	krk_tableSet(&vm.strings, OBJECT_VAL(string), NONE_VAL());
 	krk_pop();
-	_release_lock(_stringLock);
+	_release_lock(vm.stringLock);
 	return string;
 }
 
+/*
+ * Strings built at runtime are mostly compared against once, if at all, so
+ * they skip the string table. Empty and single-byte strings are still
+ * interned: there are few of them, and they come up constantly when
+ * iterating or indexing.
+ */
+KrkString * krk_takeStringUninterned(char * chars, size_t length) {
+	if (length < 2) return krk_takeString(chars, length);
+	krk_gcTakeBytes(chars, length + 1);
+	return allocateString(chars, length, 0, 0);
+}
+
+KrkString * krk_copyStringUninterned(const char * chars, size_t length) {
+	if (length < 2) return krk_copyString(chars, length);
+	char * heapChars = ALLOCATE(char, length + 1);
+	memcpy(heapChars, chars, length);
+	heapChars[length] = '\0';
+	return allocateString(heapChars, length, 0, 0);
+}
+
+KrkString * krk_takeStringVettedUninterned(char * chars, size_t length, size_t codesLength, KrkStringType type) {
+	if (length < 2) return krk_takeStringVetted(chars, length, codesLength, type, krk_hashBytes(chars, length));
+	return vettedString(chars, length, codesLength, type);
+}
+
+KrkString * krk_internString(KrkString * string) {
+	if (string->obj.flags & KRK_OBJ_FLAGS_STRING_INTERNED) return string;
+	_obtain_lock(vm.stringLock);
+	KrkString * interned = krk_tableFindString(&vm.strings, string->chars, string->length, krk_stringHash(string));
+	if (!interned) {
+		string->obj.flags |= KRK_OBJ_FLAGS_STRING_INTERNED;
+		string->obj.flags &= ~KRK_OBJ_FLAGS_STRING_APPENDABLE;
+		krk_push(OBJECT_VAL(string));
+		krk_tableSet(&vm.strings, OBJECT_VAL(string), NONE_VAL());
+		krk_pop();
+		interned = string;
+	}
+	_release_lock(vm.stringLock);
+	return interned;
+}
+
 KrkCodeObject * krk_newCodeObject(void) {
 	KrkCodeObject * codeobject = ALLOCATE_OBJECT(KrkCodeObject, KRK_OBJ_CODEOBJECT);
 	codeobject->requiredArgs = 0;
@@ -269,6 +586,9 @@ KrkCodeObject * krk_newCodeObject(void) {
 	krk_initValueArray(&codeobject->requiredArgNames);
 	krk_initValueArray(&codeobject->keywordArgNames);
 	krk_initChunk(&codeobject->chunk);
+	codeobject->requiredArgNames.owner = (KrkObj*)codeobject;
+	codeobject->keywordArgNames.owner = (KrkObj*)codeobject;
+	codeobject->chunk.constants.owner = (KrkObj*)codeobject;
 	return codeobject;
 }
 
@@ -290,8 +610,10 @@ KrkClosure * krk_newClosure(KrkCodeObject * function) {
 	closure->function = function;
 	closure->upvalues = upvalues;
 	closure->upvalueCount = function->upvalueCount;
-	closure->annotations = krk_dict_of(0,NULL,0);
 	krk_initTable(&closure->fields);
+	closure->fields.owner = (KrkObj*)closure;
+	closure->annotations = krk_dict_of(0,NULL,0);
+	krk_gcWriteBarrier((KrkObj*)closure);
 	return closure;
 }
 
@@ -310,12 +632,16 @@ KrkClass * krk_newClass(KrkString * name, KrkClass * baseClass) {
 	_class->allocSize = sizeof(KrkInstance);
 	krk_initTable(&_class->methods);
 	krk_initTable(&_class->subclasses);
+	_class->methods.owner = (KrkObj*)_class;
+	_class->version = __atomic_add_fetch(&vm.classVersion, 1, __ATOMIC_RELAXED);
 
 	if (baseClass) {
 		_class->base = baseClass;
 		_class->allocSize = baseClass->allocSize;
+		_class->slotsStart = baseClass->slotsStart;
 		_class->_ongcscan = baseClass->_ongcscan;
 		_class->_ongcsweep = baseClass->_ongcsweep;
+		_class->_ongetbuffer = baseClass->_ongetbuffer;
 
 		krk_tableSet(&baseClass->subclasses, OBJECT_VAL(_class), NONE_VAL());
 	}
@@ -327,6 +653,13 @@ KrkInstance * krk_newInstance(KrkClass * _class) {
 	KrkInstance * instance = (KrkInstance*)allocateObject(_class->allocSize, KRK_OBJ_INSTANCE);
 	instance->_class = _class;
 	krk_initTable(&instance->fields);
+	instance->fields.owner = (KrkObj*)instance;
+	if (_class->slotsStart) {
+		/* Slots start out unset */
+		for (size_t offset = _class->slotsStart; offset < _class->allocSize; offset += sizeof(KrkValue)) {
+			*krk_slotValue(instance, offset) = KWARGS_VAL(0);
+		}
+	}
 	return instance;
 }
 
@@ -338,12 +671,13 @@ KrkBoundMethod * krk_newBoundMethod(KrkValue receiver, KrkObj * method) {
 }
 
 KrkTuple * krk_newTuple(size_t length) {
+	/* Allocate the storage first, so the new tuple is still young when it is filled. */
+	KrkValue * values = GROW_ARRAY(KrkValue,NULL,0,length);
 	KrkTuple * tuple = ALLOCATE_OBJECT(KrkTuple, KRK_OBJ_TUPLE);
 	krk_initValueArray(&tuple->values);
-	krk_push(OBJECT_VAL(tuple));
+	tuple->values.owner = (KrkObj*)tuple;
 	tuple->values.capacity = length;
-	tuple->values.values = GROW_ARRAY(KrkValue,NULL,0,length);
-	krk_pop();
+	tuple->values.values = values;
 	return tuple;
 }
 
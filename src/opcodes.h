@@ -56,6 +56,33 @@ SIMPLE(OP_INPLACE_POW)
 SIMPLE(OP_INPLACE_FLOORDIV)
 SIMPLE(OP_INPLACE_MODULO)
 SIMPLE(OP_INPLACE_MULTIPLY)
+SIMPLE(OP_ADD_INT)
+SIMPLE(OP_ADD_FLOAT)
+SIMPLE(OP_ADD_STR)
+SIMPLE(OP_SUBTRACT_INT)
+SIMPLE(OP_SUBTRACT_FLOAT)
+SIMPLE(OP_MULTIPLY_INT)
+SIMPLE(OP_MULTIPLY_FLOAT)
+SIMPLE(OP_DIVIDE_FLOAT)
+SIMPLE(OP_MODULO_INT)
+SIMPLE(OP_BITAND_INT)
+SIMPLE(OP_BITOR_INT)
+SIMPLE(OP_BITXOR_INT)
+SIMPLE(OP_LESS_INT)
+SIMPLE(OP_LESS_FLOAT)
+SIMPLE(OP_GREATER_INT)
+SIMPLE(OP_GREATER_FLOAT)
+SIMPLE(OP_LESS_EQUAL_INT)
+SIMPLE(OP_LESS_EQUAL_FLOAT)
+SIMPLE(OP_GREATER_EQUAL_INT)
+SIMPLE(OP_GREATER_EQUAL_FLOAT)
+SIMPLE(OP_INPLACE_ADD_INT)
+SIMPLE(OP_INPLACE_ADD_FLOAT)
+SIMPLE(OP_INPLACE_ADD_STR)
+SIMPLE(OP_INPLACE_SUBTRACT_INT)
+SIMPLE(OP_INPLACE_SUBTRACT_FLOAT)
+SIMPLE(OP_INPLACE_MULTIPLY_INT)
+SIMPLE(OP_INPLACE_MULTIPLY_FLOAT)
 CONSTANT(OP_DEFINE_GLOBAL,(void)0)
 CONSTANT(OP_CONSTANT,(void)0)
 CONSTANT(OP_GET_GLOBAL,(void)0)
@@ -74,11 +101,14 @@ CONSTANT(OP_GET_METHOD, (void)0)
 OPERAND(OP_KWARGS, (void)0)
 OPERAND(OP_SET_LOCAL, LOCAL_MORE)
 OPERAND(OP_GET_LOCAL, LOCAL_MORE)
+OPERAND(OP_GET_LOCAL_INPLACE, LOCAL_MORE)
 OPERAND(OP_SET_LOCAL_POP, LOCAL_MORE)
 OPERAND(OP_SET_UPVALUE, (void)0)
 OPERAND(OP_GET_UPVALUE, (void)0)
 OPERAND(OP_CALL, (void)0)
 OPERAND(OP_TUPLE, (void)0)
+OPERAND(OP_BUILD_STRING, (void)0)
+OPERAND(OP_FORMAT_VALUE, (void)0)
 OPERAND(OP_UNPACK, (void)0)
 OPERAND(OP_DUP,(void)0)
 OPERAND(OP_EXPAND_ARGS,EXPAND_ARGS_MORE)
@@ -93,6 +123,8 @@ OPERAND(OP_SLICE, (void)0)
 OPERAND(OP_CALL_METHOD, (void)0)
 OPERAND(OP_CLOSE_MANY, (void)0)
 OPERAND(OP_POP_MANY, (void)0)
+OPERANDB(OP_ADD_LOCAL_LOCAL, LOCAL_MORE)
+OPERANDB(OP_LESS_LOCAL_CONST, LOCAL_MORE)
 JUMP(OP_JUMP_IF_FALSE_OR_POP,+)
 JUMP(OP_JUMP_IF_TRUE_OR_POP,+)
 JUMP(OP_JUMP,+)
@@ -0,0 +1,603 @@
+/**
+ * @file optimizer.c
+ * @brief Bytecode optimization pass.
+ *
+ * The compiler emits code in a single pass, so it has no chance to notice
+ * that an expression is made entirely of constants or that a block can never
+ * be reached. When optimization is enabled, each finished code object is
+ * decoded into a list of instructions, simplified, and encoded again.
+ *
+ * Transformations only ever remove instructions or replace them with ones
+ * that are no larger, and a jump to a removed instruction continues at the
+ * next instruction that remains; every transformation is written so that
+ * this is the right place to continue. Instructions that jumps land on are
+ * never merged into the instruction before them. If anything unexpected
+ * turns up, the code object is left exactly as the compiler produced it.
+ */
+#include <string.h>
+
+#include <kuroko/vm.h>
+#include <kuroko/memory.h>
+#include <kuroko/compiler.h>
+
+extern KrkValue krk_operator_add(KrkValue,KrkValue);
+extern KrkValue krk_operator_sub(KrkValue,KrkValue);
+extern KrkValue krk_operator_mul(KrkValue,KrkValue);
+extern KrkValue krk_operator_truediv(KrkValue,KrkValue);
+extern KrkValue krk_operator_floordiv(KrkValue,KrkValue);
+extern KrkValue krk_operator_mod(KrkValue,KrkValue);
+extern KrkValue krk_operator_or(KrkValue,KrkValue);
+extern KrkValue krk_operator_xor(KrkValue,KrkValue);
+extern KrkValue krk_operator_and(KrkValue,KrkValue);
+extern KrkValue krk_operator_lshift(KrkValue,KrkValue);
+extern KrkValue krk_operator_rshift(KrkValue,KrkValue);
+extern KrkValue krk_operator_le(KrkValue,KrkValue);
+extern KrkValue krk_operator_ge(KrkValue,KrkValue);
+
+/* Folded strings longer than this stay as runtime operations, so 'x' * 100000000 doesn't bloat the constant table. */
+#define FOLD_MAX_STRING 256
+
+/* Number of times the passes are repeated; each round can expose more work for the next. */
+#define OPTIMIZE_ROUNDS 8
+
+enum InstructionKind {
+	KIND_SIMPLE,
+	KIND_CONSTANT,
+	KIND_OPERAND,
+	KIND_JUMP_FORWARD,
+	KIND_JUMP_BACKWARD,
+};
+
+typedef struct {
+	size_t offset;   /* Offset in the original code */
+	size_t size;     /* Size in bytes, including any trailing upvalue descriptors */
+	size_t extra;    /* Bytes of upvalue descriptors following an OP_CLOSURE */
+	size_t line;
+	size_t operand;  /* Constant index, operand, or for jumps, the index of the target instruction */
+	uint8_t opcode;  /* Base opcode; long forms are chosen again when encoding */
+	uint8_t kind;
+	uint8_t live;
+	uint8_t reached;
+} Instruction;
+
+typedef struct {
+	KrkCodeObject * function;
+	Instruction * ins;
+	size_t count;
+	size_t * indexOf; /* Original offset to instruction index, or SIZE_MAX for offsets inside an instruction */
+	size_t * targets; /* Number of live jumps landing on each instruction */
+} Optimizer;
+
+#define SIMPLE(opc)
+#define CONSTANT(opc,more) [opc] = opc ## _LONG,
+#define OPERANDB(opc,more)
+#define OPERAND(opc,more) [opc] = opc ## _LONG,
+#define JUMP(opc,sign)
+static const uint8_t longForm[256] = {
+#include "opcodes.h"
+};
+#undef SIMPLE
+#undef CONSTANT
+#undef OPERANDB
+#undef OPERAND
+#undef JUMP
+
+static int isJump(Instruction * in) {
+	return in->kind == KIND_JUMP_FORWARD || in->kind == KIND_JUMP_BACKWARD;
+}
+
+static size_t resolve(Optimizer * opt, size_t i);
+
+static int decode(Optimizer * opt) {
+	KrkChunk * chunk = &opt->function->chunk;
+	opt->ins = malloc(sizeof(Instruction) * (chunk->count + 1));
+	opt->indexOf = malloc(sizeof(size_t) * (chunk->count + 1));
+	for (size_t i = 0; i <= chunk->count; ++i) opt->indexOf[i] = SIZE_MAX;
+
+	size_t offset = 0;
+	size_t lineEntry = 0;
+	while (offset < chunk->count) {
+		Instruction * in = &opt->ins[opt->count];
+		uint8_t opcode = chunk->code[offset];
+		while (lineEntry + 1 < chunk->linesCount && chunk->lines[lineEntry+1].startOffset <= offset) lineEntry++;
+		in->offset  = offset;
+		in->line    = chunk->linesCount ? chunk->lines[lineEntry].line : 0;
+		in->opcode  = opcode;
+		in->operand = 0;
+		in->extra   = 0;
+		in->live    = 1;
+
+#define SIMPLE(opc) case opc: in->kind = KIND_SIMPLE; in->size = 1; break;
+#define CONSTANT(opc,more) case opc: in->kind = KIND_CONSTANT; in->size = 2; \
+			if (offset + 2 > chunk->count) return 0; \
+			in->operand = chunk->code[offset+1]; more; break; \
+		case opc ## _LONG: in->kind = KIND_CONSTANT; in->size = 4; in->opcode = opc; \
+			if (offset + 4 > chunk->count) return 0; \
+			in->operand = (chunk->code[offset+1] << 16) | (chunk->code[offset+2] << 8) | chunk->code[offset+3]; more; break;
+#define OPERANDB(opc,more) case opc: return 0;
+#define OPERAND(opc,more) case opc: in->kind = KIND_OPERAND; in->size = 2; \
+			if (offset + 2 > chunk->count) return 0; \
+			in->operand = chunk->code[offset+1]; break; \
+		case opc ## _LONG: in->kind = KIND_OPERAND; in->size = 4; in->opcode = opc; \
+			if (offset + 4 > chunk->count) return 0; \
+			in->operand = (chunk->code[offset+1] << 16) | (chunk->code[offset+2] << 8) | chunk->code[offset+3]; break;
+#define JUMP(opc,sign) case opc: in->size = 3; \
+			if (offset + 3 > chunk->count) return 0; \
+			in->kind = (1 sign 1) ? KIND_JUMP_FORWARD : KIND_JUMP_BACKWARD; \
+			in->operand = offset + 3 sign ((chunk->code[offset+1] << 8) | chunk->code[offset+2]); break;
+#define CLOSURE_MORE \
+			if (in->operand >= chunk->constants.count || !IS_codeobject(chunk->constants.values[in->operand])) return 0; \
+			for (size_t j = 0; j < AS_codeobject(chunk->constants.values[in->operand])->upvalueCount; ++j) { \
+				if (offset + in->size + 2 > chunk->count) return 0; \
+				size_t descriptor = (chunk->code[offset + in->size] & 2) ? 4 : 2; \
+				in->size += descriptor; \
+				in->extra += descriptor; \
+			}
+#define EXPAND_ARGS_MORE
+#define LOCAL_MORE
+
+		switch (opcode) {
+#include "opcodes.h"
+			default:
+				/* Superinstructions are only installed at runtime, so anything else is a surprise. */
+				return 0;
+		}
+
+#undef SIMPLE
+#undef CONSTANT
+#undef OPERANDB
+#undef OPERAND
+#undef JUMP
+#undef CLOSURE_MORE
+#undef EXPAND_ARGS_MORE
+#undef LOCAL_MORE
+
+		if (offset + in->size > chunk->count) return 0;
+		opt->indexOf[offset] = opt->count;
+		opt->count++;
+		offset += in->size;
+	}
+	opt->indexOf[chunk->count] = opt->count;
+
+	/* Jumps are kept as instruction indices from here on */
+	for (size_t i = 0; i < opt->count; ++i) {
+		Instruction * in = &opt->ins[i];
+		if (!isJump(in)) continue;
+		if (in->operand > chunk->count || opt->indexOf[in->operand] == SIZE_MAX || opt->indexOf[in->operand] == opt->count) return 0;
+		in->operand = opt->indexOf[in->operand];
+	}
+
+	opt->targets = calloc(opt->count + 1, sizeof(size_t));
+	for (size_t i = 0; i < opt->count; ++i) {
+		if (isJump(&opt->ins[i])) opt->targets[opt->ins[i].operand]++;
+	}
+
+	return 1;
+}
+
+/** First live instruction at or after @p i, or @c count if there is none. */
+static size_t resolve(Optimizer * opt, size_t i) {
+	while (i < opt->count && !opt->ins[i].live) i++;
+	return i;
+}
+
+static size_t nextLive(Optimizer * opt, size_t i) {
+	return resolve(opt, i + 1);
+}
+
+static size_t prevLive(Optimizer * opt, size_t i) {
+	while (i > 0) {
+		i--;
+		if (opt->ins[i].live) return i;
+	}
+	return SIZE_MAX;
+}
+
+/** Whether any live jump lands on @p i; such instructions can't be merged into the one before. */
+static int isTarget(Optimizer * opt, size_t i) {
+	return opt->targets[i] != 0;
+}
+
+/** Remove instruction @p i; jumps that landed on it now land on whatever follows. */
+static void kill(Optimizer * opt, size_t i) {
+	Instruction * in = &opt->ins[i];
+	if (isJump(in)) opt->targets[resolve(opt, in->operand)]--;
+	in->live = 0;
+	opt->targets[resolve(opt, i)] += opt->targets[i];
+	opt->targets[i] = 0;
+}
+
+static void retarget(Optimizer * opt, size_t i, size_t target) {
+	opt->targets[resolve(opt, opt->ins[i].operand)]--;
+	opt->ins[i].operand = target;
+	opt->targets[target]++;
+}
+
+/** If @p in pushes a compile-time constant, store it in @p out. */
+static int constantValue(Optimizer * opt, Instruction * in, KrkValue * out) {
+	switch (in->opcode) {
+		case OP_CONSTANT: *out = opt->function->chunk.constants.values[in->operand]; return 1;
+		case OP_NONE:  *out = NONE_VAL(); return 1;
+		case OP_TRUE:  *out = BOOLEAN_VAL(1); return 1;
+		case OP_FALSE: *out = BOOLEAN_VAL(0); return 1;
+		default: return 0;
+	}
+}
+
+static int foldable(KrkValue value) {
+	return IS_INTEGER(value) || IS_FLOATING(value) || IS_STRING(value);
+}
+
+/** Turn @p in into an instruction that pushes @p value. */
+static int setConstant(Optimizer * opt, Instruction * in, KrkValue value) {
+	if (IS_BOOLEAN(value)) {
+		in->opcode = AS_BOOLEAN(value) ? OP_TRUE : OP_FALSE;
+		in->kind = KIND_SIMPLE;
+		in->extra = 0;
+		return 1;
+	}
+	if (IS_STRING(value) && AS_STRING(value)->length > FOLD_MAX_STRING) return 0;
+	if (!foldable(value)) return 0;
+
+	KrkValueArray * constants = &opt->function->chunk.constants;
+	size_t index = constants->count;
+	for (size_t i = 0; i < constants->count; ++i) {
+		if (krk_valuesSame(constants->values[i], value)) {
+			index = i;
+			break;
+		}
+	}
+	if (index == constants->count) index = krk_addConstant(&opt->function->chunk, value);
+
+	in->opcode = OP_CONSTANT;
+	in->kind = KIND_CONSTANT;
+	in->operand = index;
+	in->extra = 0;
+	return 1;
+}
+
+static KrkValue applyBinary(uint8_t opcode, KrkValue a, KrkValue b) {
+	switch (opcode) {
+		case OP_ADD:           return krk_operator_add(a,b);
+		case OP_SUBTRACT:      return krk_operator_sub(a,b);
+		case OP_MULTIPLY:      return krk_operator_mul(a,b);
+		case OP_DIVIDE:        return krk_operator_truediv(a,b);
+		case OP_FLOORDIV:      return krk_operator_floordiv(a,b);
+		case OP_MODULO:        return krk_operator_mod(a,b);
+		case OP_BITOR:         return krk_operator_or(a,b);
+		case OP_BITXOR:        return krk_operator_xor(a,b);
+		case OP_BITAND:        return krk_operator_and(a,b);
+		case OP_SHIFTLEFT:     return krk_operator_lshift(a,b);
+		case OP_SHIFTRIGHT:    return krk_operator_rshift(a,b);
+		case OP_LESS:          return krk_operator_lt(a,b);
+		case OP_GREATER:       return krk_operator_gt(a,b);
+		case OP_LESS_EQUAL:    return krk_operator_le(a,b);
+		case OP_GREATER_EQUAL: return krk_operator_ge(a,b);
+		default:               return KWARGS_VAL(0);
+	}
+}
+
+/**
+ * Evaluate @p opcode on constant operands with the same operator functions
+ * the VM would use. Anything that raises is left for runtime, so the error
+ * still happens when and where the program expects.
+ */
+static int evaluate(uint8_t opcode, KrkValue a, KrkValue b, KrkValue * out) {
+	/* These run native methods only, but keep the operands reachable anyway. */
+	krk_push(a);
+	krk_push(b);
+	KrkValue result = applyBinary(opcode, a, b);
+	krk_pop();
+	krk_pop();
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) {
+		krk_currentThread.flags &= ~(KRK_THREAD_HAS_EXCEPTION);
+		krk_currentThread.currentException = NONE_VAL();
+		return 0;
+	}
+	if (IS_KWARGS(result)) return 0;
+	*out = result;
+	return 1;
+}
+
+static int foldConstants(Optimizer * opt) {
+	int changed = 0;
+	for (size_t i = 0; i < opt->count; ++i) {
+		Instruction * in = &opt->ins[i];
+		if (!in->live) continue;
+
+		if (in->opcode == OP_NEGATE || in->opcode == OP_NOT) {
+			size_t p = prevLive(opt, i);
+			KrkValue a;
+			if (p == SIZE_MAX || !constantValue(opt, &opt->ins[p], &a) || isTarget(opt, i)) continue;
+			KrkValue result;
+			if (in->opcode == OP_NOT) result = BOOLEAN_VAL(krk_isFalsey(a));
+			else if (IS_INTEGER(a)) result = INTEGER_VAL(-AS_INTEGER(a));
+			else if (IS_FLOATING(a)) result = FLOATING_VAL(-AS_FLOATING(a));
+			else continue;
+			if (!setConstant(opt, &opt->ins[p], result)) continue;
+			kill(opt, i);
+			changed = 1;
+			continue;
+		}
+
+		switch (in->opcode) {
+			case OP_ADD: case OP_SUBTRACT: case OP_MULTIPLY: case OP_DIVIDE: case OP_FLOORDIV:
+			case OP_MODULO: case OP_BITOR: case OP_BITXOR: case OP_BITAND: case OP_SHIFTLEFT:
+			case OP_SHIFTRIGHT: case OP_LESS: case OP_GREATER: case OP_LESS_EQUAL: case OP_GREATER_EQUAL:
+				break;
+			default:
+				continue;
+		}
+
+		size_t right = prevLive(opt, i);
+		if (right == SIZE_MAX) continue;
+		size_t left = prevLive(opt, right);
+		if (left == SIZE_MAX) continue;
+		KrkValue a, b, result;
+		if (!constantValue(opt, &opt->ins[left], &a) || !constantValue(opt, &opt->ins[right], &b)) continue;
+		if (!foldable(a) || !foldable(b)) continue;
+		/* Something jumping between the operands would arrive with a different stack. */
+		if (isTarget(opt, right) || isTarget(opt, i)) continue;
+		if (!evaluate(in->opcode, a, b, &result)) continue;
+		krk_push(result);
+		int set = setConstant(opt, &opt->ins[left], result);
+		krk_pop();
+		if (!set) continue;
+		kill(opt, right);
+		kill(opt, i);
+		changed = 1;
+	}
+	return changed;
+}
+
+/* Branches on constants become unconditional, or disappear. */
+static int foldBranches(Optimizer * opt) {
+	int changed = 0;
+	for (size_t i = 0; i < opt->count; ++i) {
+		Instruction * in = &opt->ins[i];
+		if (!in->live) continue;
+		if (in->opcode != OP_POP_JUMP_IF_FALSE && in->opcode != OP_JUMP_IF_FALSE_OR_POP && in->opcode != OP_JUMP_IF_TRUE_OR_POP) continue;
+		size_t p = prevLive(opt, i);
+		KrkValue value;
+		if (p == SIZE_MAX || !constantValue(opt, &opt->ins[p], &value) || isTarget(opt, i)) continue;
+		int falsey = krk_isFalsey(value);
+		if (in->opcode == OP_POP_JUMP_IF_FALSE) {
+			kill(opt, p);
+			if (falsey) in->opcode = OP_JUMP;
+			else kill(opt, i);
+			changed = 1;
+		} else if (falsey == (in->opcode == OP_JUMP_IF_FALSE_OR_POP ? 0 : 1)) {
+			/* The branch is never taken and the value is always popped. */
+			kill(opt, p);
+			kill(opt, i);
+			changed = 1;
+		}
+	}
+	return changed;
+}
+
+/* Values pushed only to be popped again. */
+static int removePushPop(Optimizer * opt) {
+	int changed = 0;
+	for (size_t i = 0; i < opt->count; ++i) {
+		Instruction * in = &opt->ins[i];
+		if (!in->live || in->opcode != OP_POP) continue;
+		size_t p = prevLive(opt, i);
+		if (p == SIZE_MAX || isTarget(opt, i)) continue;
+		Instruction * push = &opt->ins[p];
+		switch (push->opcode) {
+			case OP_CONSTANT: case OP_NONE: case OP_TRUE: case OP_FALSE: case OP_GET_LOCAL:
+				kill(opt, p);
+				kill(opt, i);
+				changed = 1;
+				break;
+			case OP_SET_LOCAL:
+				push->opcode = OP_SET_LOCAL_POP;
+				kill(opt, i);
+				changed = 1;
+				break;
+		}
+	}
+	return changed;
+}
+
+/* Jumps to unconditional jumps go straight to the final destination. */
+static int threadJumps(Optimizer * opt) {
+	int changed = 0;
+	for (size_t i = 0; i < opt->count; ++i) {
+		Instruction * in = &opt->ins[i];
+		if (!in->live) continue;
+		if (in->opcode != OP_JUMP && in->opcode != OP_LOOP && in->opcode != OP_POP_JUMP_IF_FALSE &&
+			in->opcode != OP_JUMP_IF_FALSE_OR_POP && in->opcode != OP_JUMP_IF_TRUE_OR_POP) continue;
+
+		size_t target = resolve(opt, in->operand);
+		for (int hops = 0; hops < 16 && target < opt->count && target != i; ++hops) {
+			Instruction * next = &opt->ins[target];
+			if (next->opcode != OP_JUMP && next->opcode != OP_LOOP) break;
+			size_t final = resolve(opt, next->operand);
+			int forward = final > i;
+			/* Conditional jumps only come in forward forms */
+			if (!forward && in->opcode != OP_JUMP && in->opcode != OP_LOOP) break;
+			target = final;
+		}
+
+		if (target != resolve(opt, in->operand)) {
+			retarget(opt, i, target);
+			if (in->opcode == OP_JUMP || in->opcode == OP_LOOP) {
+				in->opcode = target > i ? OP_JUMP : OP_LOOP;
+				in->kind = target > i ? KIND_JUMP_FORWARD : KIND_JUMP_BACKWARD;
+			}
+			changed = 1;
+		}
+
+		if (in->opcode == OP_JUMP && resolve(opt, in->operand) == nextLive(opt, i)) {
+			kill(opt, i);
+			changed = 1;
+		}
+	}
+	return changed;
+}
+
+/* Anything that can't be reached from the start of the function, or from a handler, is removed. */
+static int removeUnreachable(Optimizer * opt) {
+	for (size_t i = 0; i < opt->count; ++i) opt->ins[i].reached = 0;
+
+	size_t * work = malloc(sizeof(size_t) * (opt->count + 1));
+	size_t workCount = 0;
+	size_t start = resolve(opt, 0);
+	if (start < opt->count) work[workCount++] = start;
+
+	while (workCount) {
+		size_t i = work[--workCount];
+		while (i < opt->count && !opt->ins[i].reached) {
+			Instruction * in = &opt->ins[i];
+			in->reached = 1;
+			if (isJump(in)) {
+				size_t target = resolve(opt, in->operand);
+				if (target < opt->count && !opt->ins[target].reached) work[workCount++] = target;
+			}
+			if (in->opcode == OP_RETURN || in->opcode == OP_RAISE || in->opcode == OP_JUMP || in->opcode == OP_LOOP) break;
+			i = nextLive(opt, i);
+		}
+	}
+	free(work);
+
+	int changed = 0;
+	for (size_t i = 0; i < opt->count; ++i) {
+		if (opt->ins[i].live && !opt->ins[i].reached) {
+			kill(opt, i);
+			changed = 1;
+		}
+	}
+	return changed;
+}
+
+static size_t encodedSize(Instruction * in) {
+	switch (in->kind) {
+		case KIND_SIMPLE: return 1;
+		case KIND_CONSTANT:
+		case KIND_OPERAND: return (in->operand > 255 ? 4 : 2) + in->extra;
+		default: return 3;
+	}
+}
+
+static int encode(Optimizer * opt) {
+	KrkChunk * chunk = &opt->function->chunk;
+	size_t * newOffset = malloc(sizeof(size_t) * (opt->count + 1));
+	size_t offset = 0;
+
+	for (size_t i = 0; i < opt->count; ++i) {
+		newOffset[i] = offset;
+		if (opt->ins[i].live) offset += encodedSize(&opt->ins[i]);
+	}
+	newOffset[opt->count] = offset;
+	if (offset > chunk->count) goto _fail;
+
+	uint8_t * code = malloc(offset ? offset : 1);
+	KrkLineMap * lines = malloc(sizeof(KrkLineMap) * (chunk->linesCount + 1));
+	size_t linesCount = 0;
+
+	for (size_t i = 0; i < opt->count; ++i) {
+		Instruction * in = &opt->ins[i];
+		if (!in->live) continue;
+		uint8_t * out = &code[newOffset[i]];
+
+		if (!linesCount || lines[linesCount-1].line != in->line) {
+			lines[linesCount++] = (KrkLineMap){newOffset[i], in->line};
+		}
+
+		switch (in->kind) {
+			case KIND_SIMPLE:
+				out[0] = in->opcode;
+				break;
+			case KIND_CONSTANT:
+			case KIND_OPERAND: {
+				size_t head = in->operand > 255 ? 4 : 2;
+				if (head == 4) {
+					out[0] = longForm[in->opcode];
+					out[1] = (in->operand >> 16) & 0xFF;
+					out[2] = (in->operand >> 8) & 0xFF;
+					out[3] = in->operand & 0xFF;
+				} else {
+					out[0] = in->opcode;
+					out[1] = in->operand;
+				}
+				/* Upvalue descriptors for OP_CLOSURE are copied as they were */
+				memcpy(&out[head], &chunk->code[in->offset + in->size - in->extra], in->extra);
+				break;
+			}
+			case KIND_JUMP_FORWARD:
+			case KIND_JUMP_BACKWARD: {
+				size_t target = newOffset[resolve(opt, in->operand)];
+				size_t after = newOffset[i] + 3;
+				size_t distance;
+				if (in->kind == KIND_JUMP_FORWARD) {
+					if (target < after) goto _failEncoded;
+					distance = target - after;
+				} else {
+					if (target > after) goto _failEncoded;
+					distance = after - target;
+				}
+				if (distance > 0xFFFF) goto _failEncoded;
+				out[0] = in->opcode;
+				out[1] = (distance >> 8) & 0xFF;
+				out[2] = distance & 0xFF;
+				break;
+			}
+		}
+	}
+
+	/* Offsets kept outside of the code refer to the first remaining instruction at or after them. */
+#define REMAP(o) do { size_t _o = (o); (o) = (_o >= chunk->count) ? offset : \
+	newOffset[resolve(opt, opt->indexOf[_o] == SIZE_MAX ? opt->count : opt->indexOf[_o])]; } while (0)
+	for (size_t i = 0; i < chunk->handlersCount; ++i) {
+		REMAP(chunk->handlers[i].startOffset);
+		REMAP(chunk->handlers[i].endOffset);
+	}
+	for (size_t i = 0; i < opt->function->localNameCount; ++i) {
+		REMAP(opt->function->localNames[i].birthday);
+		REMAP(opt->function->localNames[i].deathday);
+	}
+#undef REMAP
+
+	/* The new code and line map are never longer than the old ones, so they fit in place. */
+	memcpy(chunk->code, code, offset);
+	chunk->count = offset;
+	memcpy(chunk->lines, lines, sizeof(KrkLineMap) * linesCount);
+	chunk->linesCount = linesCount;
+
+	free(code);
+	free(lines);
+	free(newOffset);
+	return 1;
+
+_failEncoded:
+	free(code);
+	free(lines);
+_fail:
+	free(newOffset);
+	return 0;
+}
+
+void krk_optimizeCodeObject(KrkCodeObject * function) {
+	Optimizer opt = {function, NULL, 0, NULL, NULL};
+
+	if (!decode(&opt)) goto _done;
+
+	for (int round = 0; round < OPTIMIZE_ROUNDS; ++round) {
+		int changed = 0;
+		changed |= foldConstants(&opt);
+		changed |= foldBranches(&opt);
+		changed |= removePushPop(&opt);
+		changed |= threadJumps(&opt);
+		changed |= removeUnreachable(&opt);
+		if (!changed) break;
+	}
+
+	encode(&opt);
+
+_done:
+	free(opt.ins);
+	free(opt.indexOf);
+	free(opt.targets);
+}
@@ -1,3 +1,6 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -11,7 +14,13 @@
 #include <sys/utsname.h>
 #include <sys/ioctl.h>
 #include <termios.h>
-#else
+#include <poll.h>
+#endif
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
+#ifdef _WIN32
 #include <windows.h>
 #endif
 
@@ -23,8 +32,23 @@
 /* Did you know this is actually specified to not exist in a header? */
 extern char ** environ;
 
-static KrkClass * OSError = NULL;
-static KrkClass * stat_result = NULL;
+static KrkVMLocal osErrorKey;
+#define OSError KRK_VM_LOCAL(KrkClass*,osErrorKey)
+static KrkVMLocal blockingIOErrorKey;
+#define BlockingIOError KRK_VM_LOCAL(KrkClass*,blockingIOErrorKey)
+static KrkVMLocal stat_resultKey;
+#define stat_result KRK_VM_LOCAL(KrkClass*,stat_resultKey)
+
+/**
+ * Raise OSError for @c errno, or BlockingIOError if a non-blocking
+ * descriptor had nothing to give or no room to take more.
+ */
+static KrkValue ioError(void) {
+	if (errno == EAGAIN || errno == EWOULDBLOCK) {
+		return krk_runtimeError(BlockingIOError, "%s", strerror(errno));
+	}
+	return krk_runtimeError(OSError, "%s", strerror(errno));
+}
 
 #define DO_KEY(key) krk_attachNamedObject(AS_DICT(result), #key, (KrkObj*)krk_copyString(buf. key, strlen(buf .key)))
 #define S_KEY(key,val) krk_attachNamedObject(AS_DICT(result), #key, (KrkObj*)val);
@@ -91,7 +115,8 @@ KRK_FUNC(uname,{
 })
 #endif
 
-static KrkClass * Environ;
+static KrkVMLocal environKey;
+#define Environ KRK_VM_LOCAL(KrkClass*,environKey)
 #define _Environ cls_Environ
 
 #define AS_Environ(o) (AS_INSTANCE(o))
@@ -351,7 +376,7 @@ KRK_FUNC(read,{
 	ssize_t result = read(fd,tmp,n);
 	if (result == -1) {
 		free(tmp);
-		return krk_runtimeError(OSError, "%s", strerror(errno));
+		return ioError();
 	} else {
 		krk_push(OBJECT_VAL(krk_newBytes(result,tmp)));
 		free(tmp);
@@ -359,23 +384,258 @@ KRK_FUNC(read,{
 	}
 })
 
-#ifndef IS_bytes
-#define IS_bytes(o) IS_BYTES(o)
-#define AS_bytes(o) AS_BYTES(o)
-#endif
+KRK_FUNC(readinto,{
+	FUNCTION_TAKES_EXACTLY(2);
+	CHECK_ARG(0,int,krk_integer_type,fd);
+	KrkBuffer buffer;
+	if (!krk_getBuffer(argv[1], &buffer, 1)) return NONE_VAL();
+
+	krk_beginBlocking();
+	ssize_t result = read(fd,buffer.bytes,buffer.length);
+	krk_endBlocking();
+	if (result == -1) {
+		return ioError();
+	}
+	return INTEGER_VAL(result);
+})
 
 KRK_FUNC(write,{
 	FUNCTION_TAKES_EXACTLY(2);
 	CHECK_ARG(0,int,krk_integer_type,fd);
-	CHECK_ARG(1,bytes,KrkBytes*,data);
-	ssize_t result = write(fd,data->bytes,data->length);
+	KrkBuffer data;
+	if (!krk_getBuffer(argv[1], &data, 0)) return NONE_VAL();
+	ssize_t result = write(fd,data.bytes,data.length);
 	if (result == -1) {
-		return krk_runtimeError(OSError, "%s", strerror(errno));
+		return ioError();
 	}
 	return INTEGER_VAL(result);
 })
 
 #ifndef _WIN32
+/**
+ * Get the descriptor for @p value, which is an integer or something with a
+ * @c fileno() method, such as a socket or a file object.
+ */
+static int fileDescriptor(KrkValue value, int * fd) {
+	if (!IS_INTEGER(value)) {
+		KrkValue method = krk_valueGetAttribute_default(value, "fileno", NONE_VAL());
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return 0;
+		if (IS_NONE(method)) {
+			krk_runtimeError(vm.exceptions->typeError, "expected a file descriptor or an object with fileno(), not '%s'", krk_typeName(value));
+			return 0;
+		}
+		krk_push(method);
+		value = krk_callStack(0);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return 0;
+		if (!IS_INTEGER(value)) {
+			krk_runtimeError(vm.exceptions->typeError, "fileno() returned '%s', not 'int'", krk_typeName(value));
+			return 0;
+		}
+	}
+	*fd = AS_INTEGER(value);
+	return 1;
+}
+
+/** An offset argument: None to use and move the file position, or a position to start from. */
+static int fileOffset(KrkValue value, off_t * offset, off_t ** pointer) {
+	if (IS_NONE(value)) {
+		*pointer = NULL;
+		return 1;
+	}
+	if (!IS_INTEGER(value)) {
+		krk_runtimeError(vm.exceptions->typeError, "offset should be int or None, not '%s'", krk_typeName(value));
+		return 0;
+	}
+	if (AS_INTEGER(value) < 0) {
+		krk_runtimeError(vm.exceptions->valueError, "negative offset");
+		return 0;
+	}
+	*offset = AS_INTEGER(value);
+	*pointer = offset;
+	return 1;
+}
+
+/** Size of the bounce buffer used where the kernel can't move the data itself. */
+#define COPY_CHUNK 65536
+
+/**
+ * Move up to @p count bytes from @p in to @p out through memory, for
+ * descriptors and systems the kernel calls don't cover. Offsets that are
+ * given are used with pread/pwrite and advanced, leaving file positions
+ * alone. Stops early when @p in gives less than was asked for, so as not to
+ * wait on a pipe or socket for more, or when @p out takes less than it was
+ * given, and only reports an error if nothing was moved. What @p out doesn't
+ * take is put back by seeking @p in; if that can't be done, as for a pipe,
+ * this waits until @p out takes the rest, rather than losing it.
+ */
+static ssize_t copyThrough(int out, int in, size_t count, off_t * outOffset, off_t * inOffset) {
+	char * buf = malloc(count < COPY_CHUNK ? (count ? count : 1) : COPY_CHUNK);
+	int seekable = inOffset || lseek(in, 0, SEEK_CUR) >= 0;
+	size_t done = 0;
+	while (done < count) {
+		size_t want = count - done < COPY_CHUNK ? count - done : COPY_CHUNK;
+		ssize_t got = inOffset ? pread(in, buf, want, *inOffset) : read(in, buf, want);
+		if (got <= 0) {
+			if (got < 0 && done) got = 0;
+			if (got < 0) { free(buf); return -1; }
+			break;
+		}
+		ssize_t put = 0;
+		while (put < got) {
+			ssize_t result = outOffset ? pwrite(out, buf + put, got - put, *outOffset + put) : write(out, buf + put, got - put);
+			if (result < 0 && !seekable && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+				struct pollfd ready = {out, POLLOUT, 0};
+				poll(&ready, 1, -1);
+				continue;
+			}
+			if (result <= 0) break;
+			put += result;
+		}
+		if (inOffset) *inOffset += put;
+		else if (put < got) lseek(in, put - got, SEEK_CUR);
+		if (outOffset) *outOffset += put;
+		done += put;
+		if (put < got) {
+			if (!done) { free(buf); return -1; }
+			break;
+		}
+		if ((size_t)got < want) break;
+	}
+	free(buf);
+	return done;
+}
+
+/** Whether a kernel transfer failed in a way that copying through memory can get around. */
+static int unsupported(void) {
+	return errno == EINVAL || errno == ENOSYS || errno == EXDEV || errno == EOPNOTSUPP
+#if defined(ENOTSUP) && ENOTSUP != EOPNOTSUPP
+		|| errno == ENOTSUP
+#endif
+		;
+}
+
+/*
+ * The kernel's own transfers, where the system has them; elsewhere these
+ * fail with ENOSYS so the caller copies through memory instead.
+ */
+static ssize_t kernelSendfile(int out, int in, off_t * offset, size_t count) {
+#ifdef __linux__
+	return sendfile(out, in, offset, count);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static ssize_t kernelSplice(int src, off_t * srcOffset, int dst, off_t * dstOffset, size_t count, unsigned int flags) {
+#ifdef __linux__
+	return splice(src, (loff_t*)srcOffset, dst, (loff_t*)dstOffset, count, flags);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static ssize_t kernelCopyFileRange(int src, off_t * srcOffset, int dst, off_t * dstOffset, size_t count) {
+#ifdef SYS_copy_file_range
+	return syscall(SYS_copy_file_range, src, (loff_t*)srcOffset, dst, (loff_t*)dstOffset, count, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/** Read a count argument, which the transfer functions take as a non-negative int. */
+#define CHECK_COUNT(i) CHECK_ARG(i,int,krk_integer_type,count); \
+	if (count < 0) return krk_runtimeError(vm.exceptions->valueError, "negative count")
+
+KRK_FUNC(sendfile,{
+	FUNCTION_TAKES_EXACTLY(4);
+	int out, in;
+	if (!fileDescriptor(argv[0], &out) || !fileDescriptor(argv[1], &in)) return NONE_VAL();
+	off_t offset, * offsetPointer;
+	if (!fileOffset(argv[2], &offset, &offsetPointer)) return NONE_VAL();
+	CHECK_COUNT(3);
+
+	krk_beginBlocking();
+	ssize_t result = kernelSendfile(out, in, offsetPointer, count);
+	if (result < 0 && unsupported()) result = copyThrough(out, in, count, NULL, offsetPointer);
+	int error = errno;
+	krk_endBlocking();
+	errno = error;
+
+	if (result < 0) return ioError();
+	return INTEGER_VAL(result);
+})
+
+KRK_FUNC(splice,{
+	FUNCTION_TAKES_AT_LEAST(3);
+	FUNCTION_TAKES_AT_MOST(6);
+	int src, dst;
+	if (!fileDescriptor(argv[0], &src) || !fileDescriptor(argv[1], &dst)) return NONE_VAL();
+	CHECK_COUNT(2);
+	off_t srcOffset, dstOffset, * srcPointer = NULL, * dstPointer = NULL;
+	if (argc > 3 && !fileOffset(argv[3], &srcOffset, &srcPointer)) return NONE_VAL();
+	if (argc > 4 && !fileOffset(argv[4], &dstOffset, &dstPointer)) return NONE_VAL();
+	unsigned int flags = 0;
+	if (argc > 5) {
+		CHECK_ARG(5,int,krk_integer_type,_flags);
+		flags = _flags;
+	}
+
+	krk_beginBlocking();
+	ssize_t result = kernelSplice(src, srcPointer, dst, dstPointer, count, flags);
+	if (result < 0 && unsupported()) result = copyThrough(dst, src, count, dstPointer, srcPointer);
+	int error = errno;
+	krk_endBlocking();
+	errno = error;
+
+	if (result < 0) return ioError();
+	return INTEGER_VAL(result);
+})
+
+KRK_FUNC(copy_file_range,{
+	FUNCTION_TAKES_AT_LEAST(3);
+	FUNCTION_TAKES_AT_MOST(5);
+	int src, dst;
+	if (!fileDescriptor(argv[0], &src) || !fileDescriptor(argv[1], &dst)) return NONE_VAL();
+	CHECK_COUNT(2);
+	off_t srcOffset, dstOffset, * srcPointer = NULL, * dstPointer = NULL;
+	if (argc > 3 && !fileOffset(argv[3], &srcOffset, &srcPointer)) return NONE_VAL();
+	if (argc > 4 && !fileOffset(argv[4], &dstOffset, &dstPointer)) return NONE_VAL();
+
+	krk_beginBlocking();
+	ssize_t result = kernelCopyFileRange(src, srcPointer, dst, dstPointer, count);
+	if (result < 0 && unsupported()) result = copyThrough(dst, src, count, dstPointer, srcPointer);
+	int error = errno;
+	krk_endBlocking();
+	errno = error;
+
+	if (result < 0) return ioError();
+	return INTEGER_VAL(result);
+})
+#endif
+
+#ifndef _WIN32
+KRK_FUNC(get_blocking,{
+	FUNCTION_TAKES_EXACTLY(1);
+	CHECK_ARG(0,int,krk_integer_type,fd);
+	int flags = fcntl(fd, F_GETFL);
+	if (flags == -1) {
+		return krk_runtimeError(OSError, "%s", strerror(errno));
+	}
+	return BOOLEAN_VAL(!(flags & O_NONBLOCK));
+})
+
+KRK_FUNC(set_blocking,{
+	FUNCTION_TAKES_EXACTLY(2);
+	CHECK_ARG(0,int,krk_integer_type,fd);
+	int flags = fcntl(fd, F_GETFL);
+	if (flags == -1 || fcntl(fd, F_SETFL, krk_isFalsey(argv[1]) ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK)) == -1) {
+		return krk_runtimeError(OSError, "%s", strerror(errno));
+	}
+})
+
 KRK_FUNC(pipe,{
 	FUNCTION_TAKES_NONE();
 	int fds[2];
@@ -721,6 +981,12 @@ void _createAndBind_osMod(void) {
 	DO_INT(SEEK_CUR);
 	DO_INT(SEEK_END);
 
+#ifdef SPLICE_F_MOVE
+	DO_INT(SPLICE_F_MOVE);
+	DO_INT(SPLICE_F_NONBLOCK);
+	DO_INT(SPLICE_F_MORE);
+#endif
+
 #ifdef SEEK_HOLE
 	DO_INT(SEEK_HOLE);
 #endif
@@ -734,6 +1000,12 @@ void _createAndBind_osMod(void) {
 	);
 	krk_finalizeClass(OSError);
 
+	krk_makeClass(module, &BlockingIOError, "BlockingIOError", OSError);
+	KRK_DOC(BlockingIOError,
+		"Raised by @ref read and @ref write on a non-blocking file descriptor that isn't ready."
+	);
+	krk_finalizeClass(BlockingIOError);
+
 	KRK_DOC(BIND_FUNC(module,uname),
 		"@brief Returns a @ref dict of attributes describing the current platform.\n\n"
 		"On POSIX platforms, the result should match the contents and layout of a standard @c uname() call. "
@@ -797,10 +1069,45 @@ void _createAndBind_osMod(void) {
 		"@brief Read from an open file descriptor.\n"
 		"@arguments fd,n\n\n"
 		"Reads at most @p n bytes from the open file descriptor @p fd.");
+	KRK_DOC(BIND_FUNC(module,readinto),
+		"@brief Read from an open file descriptor into a buffer.\n"
+		"@arguments fd,buffer\n\n"
+		"Reads at most as many bytes as the writable bytes-like object @p buffer holds, such as a "
+		"@ref bytearray or @c memoryview, from @p fd into it, and returns how many were read.");
 	KRK_DOC(BIND_FUNC(module,write),
 		"@brief Write to an open file descriptor.\n"
 		"@arguments fd,data\n\n"
-		"Writes the @ref bytes object @p data to the open file descriptor @p fd.");
+		"Writes the bytes-like object @p data to the open file descriptor @p fd.");
+#ifndef _WIN32
+	KRK_DOC(BIND_FUNC(module,sendfile),
+		"@brief Copy data from one file descriptor to another in the kernel.\n"
+		"@arguments out_fd,in_fd,offset,count\n\n"
+		"Sends up to @p count bytes from @p in_fd, starting at @p offset, to @p out_fd, which is usually "
+		"a socket, without bringing them into Kuroko. With an @p offset of @c None, reads from and advances "
+		"the current position of @p in_fd. Either descriptor may be given as an object with a @c fileno() "
+		"method. Returns the number of bytes sent, which is @c 0 at end of file and may be less than @p count. "
+		"Where the system can't transfer between the two in the kernel, the data is copied through a buffer.");
+	KRK_DOC(BIND_FUNC(module,splice),
+		"@brief Move data to or from a pipe in the kernel.\n"
+		"@arguments src,dst,count,offset_src=None,offset_dst=None,flags=0\n\n"
+		"Moves up to @p count bytes from @p src to @p dst, one of which must be a pipe on Linux. The offsets "
+		"behave as for @ref sendfile. Elsewhere, or for descriptors @c splice() can't handle, the data is "
+		"copied through a buffer. Returns the number of bytes moved.");
+	KRK_DOC(BIND_FUNC(module,copy_file_range),
+		"@brief Copy a range of one file to another in the kernel.\n"
+		"@arguments src,dst,count,offset_src=None,offset_dst=None\n\n"
+		"Copies up to @p count bytes between regular files, which a filesystem may do by sharing blocks. "
+		"The offsets behave as for @ref sendfile. Returns the number of bytes copied; where the system has "
+		"no @c copy_file_range, or can't use it between these files, the data is copied through a buffer.");
+	KRK_DOC(BIND_FUNC(module,get_blocking),
+		"@brief Whether the file descriptor @p fd is in blocking mode.\n"
+		"@arguments fd");
+	KRK_DOC(BIND_FUNC(module,set_blocking),
+		"@brief Put the file descriptor @p fd in blocking or non-blocking mode.\n"
+		"@arguments fd,blocking\n\n"
+		"Reads and writes on a non-blocking descriptor that isn't ready raise @ref BlockingIOError "
+		"instead of waiting.");
+#endif
 	KRK_DOC(BIND_FUNC(module,mkdir),
 		"@brief Create a directory.\n"
 		"@arguments path,mode=0o777\n\n"
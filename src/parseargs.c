@@ -0,0 +1,251 @@
+/**
+ * @file parseargs.c
+ * @brief Argument parsing for natives, driven by a format string.
+ *
+ * The names in a @ref KrkArgSpec are interned once per VM, into a tuple
+ * that stays reachable for the life of the VM, and found again through the
+ * spec's VM-local key. Keyword arguments from the call site are interned
+ * strings too, so matching them against the names is a pointer comparison;
+ * only keys that were built at runtime without being interned have to be
+ * compared by their contents.
+ */
+#include <stdarg.h>
+#include <string.h>
+#include <kuroko/vm.h>
+#include <kuroko/value.h>
+#include <kuroko/memory.h>
+#include <kuroko/util.h>
+
+#include "private.h"
+
+/**
+ * @brief Interned names of one spec in one VM.
+ */
+struct KrkArgNames {
+	struct KrkArgNames * next;
+	KrkTuple * names;
+};
+
+void krk_markArgNames(void) {
+	for (struct KrkArgNames * entry = __atomic_load_n(&vm.argNames, __ATOMIC_ACQUIRE); entry; entry = entry->next) {
+		krk_markObject((KrkObj*)entry->names);
+	}
+}
+
+void krk_freeArgNames(void) {
+	struct KrkArgNames * entry = vm.argNames;
+	while (entry) {
+		struct KrkArgNames * next = entry->next;
+		free(entry);
+		entry = next;
+	}
+	vm.argNames = NULL;
+}
+
+static KrkTuple * internNames(KrkArgSpec * spec) {
+	KrkTuple * names = krk_newTuple(spec->count);
+	krk_push(OBJECT_VAL(names));
+	for (size_t i = 0; i < spec->count; ++i) {
+		krk_writeValueArray(&names->values, OBJECT_VAL(krk_copyString(spec->names[i], strlen(spec->names[i]))));
+	}
+	/* Threads that get here at once each add theirs; whichever is stored last is used. */
+	struct KrkArgNames * entry = malloc(sizeof(struct KrkArgNames));
+	entry->names = names;
+	entry->next = __atomic_load_n(&vm.argNames, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&vm.argNames, &entry->next, entry, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	KRK_VM_LOCAL(KrkTuple*,spec->key) = names;
+	krk_pop();
+	return names;
+}
+
+static int sameName(KrkValue key, KrkString * name) {
+	if (!IS_STRING(key)) return 0;
+	KrkString * str = AS_STRING(key);
+	if (str == name) return 1;
+	if (str->obj.flags & KRK_OBJ_FLAGS_STRING_INTERNED) return 0;
+	return str->length == name->length && !memcmp(str->chars, name->chars, str->length);
+}
+
+/** Take the keyword argument @p name out of @p kwargs into @p out, if it is there. */
+static int findKeyword(KrkTable * kwargs, KrkString * name, KrkValue * out) {
+	for (size_t i = 0; i < kwargs->used; ++i) {
+		KrkTableEntry * entry = &kwargs->entries[i];
+		if (sameName(entry->key, name)) {
+			*out = entry->value;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int wrongType(const char * method, const char * name, const char * expected, KrkValue value) {
+	krk_runtimeError(vm.exceptions->typeError, "%s() argument '%s' must be %s, not '%s'",
+		method, name, expected, krk_typeName(value));
+	return 0;
+}
+
+int krk_parseArgs_impl(const char * method, int argc, const KrkValue argv[], int hasKw, KrkArgSpec * spec, ...) {
+	KrkTable * kwargs = hasKw ? AS_DICT(argv[argc]) : NULL;
+	const char * format = spec->format;
+	if (*format == '.') {
+		format++;
+		argc--;
+		argv++;
+	}
+
+	KrkTuple * names = KRK_VM_LOCAL(KrkTuple*,spec->key);
+	if (unlikely(!names)) names = internNames(spec);
+
+	va_list args;
+	va_start(args, spec);
+
+	int required = 1;
+	int keywordOnly = 0;
+	int positional = 0;
+	size_t index = 0;
+	size_t found = 0;
+	int maximum = 0;
+
+	for (; *format; format++) {
+		switch (*format) {
+			case '|': required = 0; continue;
+			case '$': keywordOnly = 1; continue;
+			case '*': {
+				int * count = va_arg(args, int*);
+				const KrkValue ** rest = va_arg(args, const KrkValue**);
+				*count = positional < argc ? argc - positional : 0;
+				*rest = argv + positional;
+				positional = argc;
+				maximum = -1;
+				continue;
+			}
+		}
+
+		KrkString * name = AS_STRING(names->values.values[index++]);
+		KrkValue value = NONE_VAL();
+		int given = 0;
+		if (!keywordOnly) {
+			if (maximum >= 0) maximum++;
+			if (positional < argc) {
+				value = argv[positional++];
+				given = 1;
+			}
+		}
+		if (kwargs && kwargs->count) {
+			KrkValue keyword;
+			if (findKeyword(kwargs, name, &keyword)) {
+				if (given) {
+					va_end(args);
+					krk_runtimeError(vm.exceptions->typeError, "%s() got multiple values for argument '%s'", method, name->chars);
+					return 0;
+				}
+				value = keyword;
+				given = 1;
+				found++;
+			}
+		}
+		if (!given && required) {
+			va_end(args);
+			krk_runtimeError(vm.exceptions->typeError, "%s() missing required %s argument: '%s'",
+				method, keywordOnly ? "keyword" : "positional", name->chars);
+			return 0;
+		}
+
+		int ok = 1;
+		switch (*format) {
+			case 'O': {
+				KrkClass * type = NULL;
+				if (format[1] == '!') {
+					format++;
+					type = va_arg(args, KrkClass*);
+				}
+				KrkValue * out = va_arg(args, KrkValue*);
+				if (!given) break;
+				if (type && !krk_isInstanceOf(value, type)) ok = wrongType(method, name->chars, type->name->chars, value);
+				else *out = value;
+				break;
+			}
+			case 'i': {
+				krk_integer_type * out = va_arg(args, krk_integer_type*);
+				if (!given) break;
+				if (IS_INTEGER(value)) *out = AS_INTEGER(value);
+				else ok = wrongType(method, name->chars, "int", value);
+				break;
+			}
+			case 'd': {
+				double * out = va_arg(args, double*);
+				if (!given) break;
+				if (IS_FLOATING(value)) *out = AS_FLOATING(value);
+				else if (IS_INTEGER(value)) *out = (double)AS_INTEGER(value);
+				else ok = wrongType(method, name->chars, "float", value);
+				break;
+			}
+			case 'p': {
+				int * out = va_arg(args, int*);
+				if (!given) break;
+				*out = !krk_isFalsey(value);
+				if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) ok = 0;
+				break;
+			}
+			case 's':
+			case 'z':
+			case 'y': {
+				char kind = *format;
+				const void ** out = va_arg(args, const void**);
+				size_t * length = NULL;
+				if (format[1] == '#') {
+					format++;
+					length = va_arg(args, size_t*);
+				}
+				if (!given) break;
+				if (kind == 'z' && IS_NONE(value)) {
+					*out = NULL;
+					if (length) *length = 0;
+				} else if (kind == 'y' ? IS_BYTES(value) : IS_STRING(value)) {
+					*out = kind == 'y' ? (const void*)AS_BYTES(value)->bytes : (const void*)AS_CSTRING(value);
+					if (length) *length = kind == 'y' ? AS_BYTES(value)->length : AS_STRING(value)->length;
+				} else {
+					ok = wrongType(method, name->chars, kind == 'y' ? "bytes" : kind == 'z' ? "str or None" : "str", value);
+				}
+				break;
+			}
+			default:
+				ok = 0;
+				krk_runtimeError(vm.exceptions->typeError, "%s() has a bad argument format '%c'", method, *format);
+				break;
+		}
+		if (!ok) {
+			va_end(args);
+			return 0;
+		}
+	}
+	va_end(args);
+
+	if (positional < argc) {
+		if (!maximum) {
+			krk_runtimeError(vm.exceptions->argumentError, "%s() takes no positional arguments (%d given)", method, argc);
+		} else {
+			krk_runtimeError(vm.exceptions->argumentError, "%s() takes %s %d argument%s (%d given)",
+				method, "at most", maximum, (maximum != 1) ? "s" : "", argc);
+		}
+		return 0;
+	}
+
+	if (kwargs && found < kwargs->count) {
+		for (size_t i = 0; i < kwargs->used; ++i) {
+			KrkValue key = kwargs->entries[i].key;
+			if (IS_KWARGS(key)) continue;
+			int named = 0;
+			for (size_t j = 0; j < names->values.count && !named; ++j) {
+				named = sameName(key, AS_STRING(names->values.values[j]));
+			}
+			if (!named) {
+				krk_runtimeError(vm.exceptions->typeError, "%s() got an unexpected keyword argument '%s'",
+					method, IS_STRING(key) ? AS_CSTRING(key) : krk_typeName(key));
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
@@ -6,6 +6,8 @@
  * They are used internally by the interpreter library.
  */
 #include "kuroko/kuroko.h"
+#include "kuroko/value.h"
+#include "kuroko/object.h"
 
 extern void _createAndBind_numericClasses(void);
 extern void _createAndBind_strClass(void);
@@ -22,13 +24,359 @@ extern void _createAndBind_builtins(void);
 extern void _createAndBind_type(void);
 extern void _createAndBind_exceptions(void);
 extern void _createAndBind_gcMod(void);
+extern void _createAndBind_weakrefMod(void);
+extern void _createAndBind_collectionsMod(void);
 extern void _createAndBind_timeMod(void);
 extern void _createAndBind_osMod(void);
 extern void _createAndBind_fileioMod(void);
+extern void _createAndBind_profiler(void);
 #ifdef ENABLE_THREADING
 extern void _createAndBind_threadsMod(void);
 #endif
 
+/**
+ * @brief Set up the collector state of the VM being initialized.
+ */
+extern void krk_initGC(void);
+
+/**
+ * @brief Release the collector state of the VM being freed, after its objects.
+ */
+extern void krk_freeGC(void);
+
+/**
+ * @brief Mark the keyword names interned for krk_parseArgs, which are roots.
+ */
+extern void krk_markArgNames(void);
+
+/**
+ * @brief Release the list of keyword names interned for krk_parseArgs.
+ */
+extern void krk_freeArgNames(void);
+
+/**
+ * @brief Largest object struct that is allocated from slab pages.
+ */
+#define KRK_SLAB_MAX 256
+
+/**
+ * @brief Allocate memory for an object struct from the page for its size class.
+ *
+ * Sizes over @ref KRK_SLAB_MAX come from malloc instead.
+ * Does not count towards @c vm.bytesAllocated; see @ref krk_allocateObjectMemory
+ */
+extern void * krk_slabAllocate(size_t size);
+
+/**
+ * @brief Release memory from @ref krk_slabAllocate
+ *
+ * @param size Must be the size that was allocated.
+ */
+extern void krk_slabFree(void * ptr, size_t size);
+
+/**
+ * @brief Give back the slots the current thread took for itself and has not used.
+ *
+ * Called by a thread as it leaves the VM.
+ */
+extern void krk_slabReleaseCache(void);
+
+/**
+ * @brief Move the objects every thread has allocated onto @c vm.objects
+ *
+ * Stops the world to do so once there is more than one thread. Anything
+ * that walks @c vm.objects outside of a collection should call this first.
+ */
+extern void krk_gcGatherObjects(void);
+
+/**
+ * @brief Allocate memory for an object struct, running the garbage collector if it is due.
+ */
+extern void * krk_allocateObjectMemory(size_t size);
+
+/**
+ * @brief Release the memory of an object struct from @ref krk_allocateObjectMemory
+ */
+extern void krk_freeObjectMemory(void * ptr, size_t size);
+
+/**
+ * @brief Stop for a collection another thread asked for, or run the one this thread asked for.
+ *
+ * Called by the interpreter loop when @c vm.safepointRequested is set.
+ */
+extern void krk_safepoint(void);
+
+/**
+ * @brief Call the functions in @c gc.callbacks with details of the last collection.
+ *
+ * Called by the interpreter loop when @c KRK_THREAD_GC_CALLBACKS is set,
+ * as collections happen during allocations, where managed code can't run.
+ */
+extern void krk_runGCCallbacks(void);
+
+/**
+ * @brief Clear weak references to objects that were not reached by the collection that just marked.
+ *
+ * @param young Whether this is a minor collection, which leaves old objects unmarked.
+ */
+extern void krk_clearWeakReferences(int young);
+
+/**
+ * @brief Mark the weak references whose callbacks are still to be called.
+ */
+extern void krk_markWeakReferences(void);
+
+/**
+ * @brief Call the callbacks of weak references that were cleared.
+ */
+extern void krk_runWeakReferenceCallbacks(void);
+
+/**
+ * @brief Release what the weak references of the VM being freed still hold.
+ */
+extern void krk_freeWeakReferences(void);
+
+/**
+ * @brief Estimate the memory used by an object, as reported by @c sys.getsizeof
+ */
+extern size_t krk_sizeOfObject(KrkObj * object);
+
+/**
+ * @brief Descriptor for a value named in @c __slots__
+ * @extends KrkInstance
+ *
+ * Instances of classes with @c __slots__ keep those values after the rest
+ * of the instance, and the class has one of these for each of them.
+ */
+struct MemberDescriptor {
+	KrkInstance inst;
+	KrkString * name;   /**< Name of the slot */
+	KrkClass * owner;   /**< Class that declared the slot */
+	size_t offset;      /**< Where the value is, in bytes from the start of the instance */
+};
+
+#define IS_member(o) (IS_INSTANCE(o) && AS_INSTANCE(o)->_class == vm.baseClasses->memberClass)
+#define AS_member(o) ((struct MemberDescriptor*)AS_OBJECT(o))
+
+/**
+ * @brief A slot value in an instance; unset slots hold @c KWARGS_VAL(0)
+ */
+static inline KrkValue * krk_slotValue(KrkInstance * instance, size_t offset) {
+	return (KrkValue*)((char*)instance + offset);
+}
+
+/**
+ * @brief Lay out the values named by a class's @c __slots__, if it has one.
+ *
+ * Called when a class built by managed code is finalized, before it can
+ * have any instances.
+ *
+ * @return 0 if an exception was raised.
+ */
+extern int krk_applySlots(KrkClass * _class);
+
+/**
+ * @brief Bytes allocated for the entries and index of a table.
+ */
+extern size_t krk_tableBytes(KrkTable * table);
+
+/**
+ * @brief Tables find entries through an index of their positions.
+ *
+ * Entries take up three quarters of the index, which is as full as it is
+ * allowed to get. Index slots are as wide as they need to be to hold a
+ * position in the entries, so small tables - most of them - use a byte
+ * per slot. Sets use the same index for their keys.
+ */
+#define KRK_INDEX_CAPACITY(capacity) ((capacity) / 3 * 4)
+#define KRK_INDEX_EMPTY   (-1)
+#define KRK_INDEX_DELETED (-2)
+#define KRK_INDEX_CAPACITY_BYTES 0x80
+
+static inline size_t krk_indexWidth(size_t indexCapacity) {
+	if (indexCapacity <= KRK_INDEX_CAPACITY_BYTES) return 1;
+	if (indexCapacity <= 0x8000) return 2;
+	if (indexCapacity <= 0x80000000UL) return 4;
+	return 8;
+}
+
+static inline ssize_t krk_indexGet(const void * index, size_t width, size_t slot) {
+	switch (width) {
+		case 1: return ((const int8_t*)index)[slot];
+		case 2: return ((const int16_t*)index)[slot];
+		case 4: return ((const int32_t*)index)[slot];
+		default: return ((const int64_t*)index)[slot];
+	}
+}
+
+static inline void krk_indexSet(void * index, size_t width, size_t slot, ssize_t value) {
+	switch (width) {
+		case 1: ((int8_t*)index)[slot] = value; break;
+		case 2: ((int16_t*)index)[slot] = value; break;
+		case 4: ((int32_t*)index)[slot] = value; break;
+		default: ((int64_t*)index)[slot] = value; break;
+	}
+}
+
+/**
+ * @brief Smallest index, a power of two, with room for @p capacity entries.
+ */
+extern size_t krk_indexCapacityFor(size_t capacity);
+
+/**
+ * @brief Bytes allocated for the keys and index of a set; 0 if @p value is not a set.
+ */
+extern size_t krk_setBytes(KrkValue value);
+
+/**
+ * @brief Bytes allocated for the ring of a deque; 0 if @p value is not a deque.
+ */
+extern size_t krk_dequeBytes(KrkValue value);
+
+/**
+ * @brief The values of a range: @p count of them, @p step apart, from @p first.
+ *
+ * @return 0, without setting anything, if @p value is not a range.
+ */
+extern int krk_rangeValues(KrkValue value, krk_integer_type * first, krk_integer_type * step, krk_integer_type * count);
+
+/**
+ * @brief Get the stream of a text-mode fileio.File, for print() to write to directly.
+ *
+ * @return 0 if @p value is not a text-mode file. Otherwise 1, with @p out set to
+ *         the stream, or @c NULL if the file is closed.
+ */
+extern int krk_fileStream(KrkValue value, FILE ** out);
+
+/**
+ * @brief Grow the current thread's stack, which may move it.
+ */
+extern void krk_growStack(void);
+
+/**
+ * @brief Give @p thread room for @p count call frames, keeping the ones it has.
+ *
+ * The frames may move, so this is only safe while @p thread is not running.
+ */
+extern void krk_reserveFrames(KrkThreadState * thread, size_t count);
+
+/**
+ * @brief Release the call frames and frame times of @p thread.
+ */
+extern void krk_releaseFrames(KrkThreadState * thread);
+
+/**
+ * @brief Resume the generator @p generator with @p sent, as its @c send method does.
+ *
+ * Used by @c yield @c from to step generators without looking up their methods.
+ *
+ * @return The value yielded, or @p generator itself once it has finished.
+ */
+extern KrkValue krk_generatorSend(KrkValue generator, KrkValue sent);
+
+/**
+ * @brief The value returned by a finished generator, as its @c \__finish__ method gives.
+ */
+extern KrkValue krk_generatorResult(KrkValue generator);
+
+/**
+ * @brief Sort @p keys in place, stably.
+ *
+ * If @p values is not NULL, its values are moved along with their keys;
+ * it must have as many. Either array's owner gets a write barrier before
+ * any comparison that runs managed code.
+ *
+ * @return 0 if a comparison raised an exception. Every value is still
+ *         in the arrays, but in no particular order.
+ */
+extern int krk_sortValueArrays(KrkValueArray * keys, KrkValueArray * values, int reverse);
+
+/**
+ * @brief Set the seed for string hashes.
+ *
+ * Must be called before any strings are created.
+ */
+extern void krk_seedHash(uint64_t seed);
+
+/**
+ * @brief Find the first occurrence of @p needle in @p haystack
+ *
+ * Shared by the searching methods of @c str and @c bytes; UTF-8 is
+ * self-synchronizing, so a byte match of a valid string is also a
+ * codepoint match.
+ *
+ * @return Pointer to the start of the match, or NULL.
+ */
+extern const char * krk_findBytes(const char * haystack, size_t haystackLength, const char * needle, size_t needleLength);
+
+/**
+ * @brief Size of the UTF-8 buffer for a string of @p length bytes that has room to grow.
+ */
+static inline size_t krk_spareCapacity(size_t length) {
+	size_t capacity = 32;
+	while (capacity < length + 1) capacity <<= 1;
+	return capacity;
+}
+
+/**
+ * @brief Size of the buffer holding a string's UTF-8 data, including the terminator.
+ */
+static inline size_t krk_stringCapacity(KrkString * string) {
+	if (string->obj.flags & KRK_OBJ_FLAGS_STRING_SPARE) return krk_spareCapacity(string->length);
+	return string->length + 1;
+}
+
+/**
+ * @brief Note that a local's value is being copied somewhere else.
+ *
+ * A string built by @c += in a local is extended in place for as long as
+ * that local is the only reference to it. Every instruction that reads a
+ * local, other than the left side of @c +=, passes the value through here.
+ */
+static inline void krk_escapeValue(KrkValue value) {
+	if (IS_STRING(value) && (AS_OBJECT(value)->flags & KRK_OBJ_FLAGS_STRING_APPENDABLE)) {
+		AS_OBJECT(value)->flags &= ~KRK_OBJ_FLAGS_STRING_APPENDABLE;
+	}
+}
+
+/**
+ * @brief Concatenate two strings for @c += on a local.
+ *
+ * The result has room to grow and is marked as appendable. If @p inPlace is
+ * set and @p self is appendable, @p self is extended and returned instead.
+ */
+extern KrkString * krk_appendString(KrkString * self, KrkString * them, int inPlace);
+
+/** @brief Operand flags for @c OP_FORMAT_VALUE */
+#define KRK_FORMAT_STR  1 /**< Convert the value with @c str first */
+#define KRK_FORMAT_REPR 2 /**< Convert the value with @c repr first */
+#define KRK_FORMAT_SPEC 4 /**< A format specifier string is on the stack above the value */
+
+/**
+ * @brief Implements @c OP_FORMAT_VALUE on the top of the stack.
+ * @return 0 if an exception was raised.
+ */
+extern int krk_formatValueOnStack(int flags);
+
+/**
+ * @brief Implements @c OP_BUILD_STRING by converting the top @p count values
+ *        to strings and replacing them with their concatenation.
+ * @return 0 if an exception was raised.
+ */
+extern int krk_buildString(size_t count);
+
+#ifdef ENABLE_THREADING
+/**
+ * @brief Add the current thread to @c vm.threads, waiting for any collection in progress.
+ */
+extern void krk_attachThread(void);
+
+/**
+ * @brief Remove the current thread from @c vm.threads
+ */
+extern void krk_detachThread(void);
+#endif
+
 
 /**
  * @brief Index numbers for always-available interned strings representing important method and member names.
@@ -0,0 +1,60 @@
+#pragma once
+/**
+ * @file probes.h
+ * @brief Static tracepoints for bpftrace, perf and SystemTap.
+ *
+ * When built with @c KRK_ENABLE_USDT (which needs @c sys/sdt.h from SystemTap),
+ * each probe below is an SDT note in the binary and a single @c nop at its site.
+ * Each probe also has a semaphore that the tracer increments while attached, and
+ * arguments that cost something to compute, like line numbers, are only worked
+ * out while it is nonzero. Without @c KRK_ENABLE_USDT this all expands to nothing.
+ *
+ * Probes, in the @c kuroko provider:
+ *
+ * | Probe              | Arguments                                          |
+ * |--------------------|----------------------------------------------------|
+ * | function__entry    | function, file, line                               |
+ * | function__return   | function, file, line                               |
+ * | exception__raise   | type, function, file, line                         |
+ * | gc__start          | generation (0 = young, 1 = full)                   |
+ * | gc__done           | generation, objects freed, bytes freed, pause (ns) |
+ * | import__start      | module, path                                       |
+ * | import__done       | module, path, success                              |
+ * | thread__start      | thread id                                          |
+ * | thread__stop       | thread id                                          |
+ *
+ * @c function__return fires when a frame returns normally; frames that are unwound
+ * by an exception do not fire it. Generators and coroutines fire neither of the two.
+ *
+ * For example, counting calls by function with bpftrace:
+ *
+ *     bpftrace -e 'usdt:./kuroko:kuroko:function__entry { @[str(arg0)] = count(); }' -p PID
+ */
+
+#ifdef KRK_ENABLE_USDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define KRK_PROBE_LIST(X) \
+	X(function__entry) \
+	X(function__return) \
+	X(exception__raise) \
+	X(gc__start) \
+	X(gc__done) \
+	X(import__start) \
+	X(import__done) \
+	X(thread__start) \
+	X(thread__stop)
+
+/* sdt.h finds these by name: provider_probe_semaphore */
+#define KRK_PROBE_SEMAPHORE(name) kuroko_ ## name ## _semaphore
+#define KRK_PROBE_DECLARE(name) extern unsigned short KRK_PROBE_SEMAPHORE(name);
+KRK_PROBE_LIST(KRK_PROBE_DECLARE)
+#undef KRK_PROBE_DECLARE
+
+#define KRK_PROBE_ENABLED(name) __builtin_expect(KRK_PROBE_SEMAPHORE(name), 0)
+#define KRK_PROBE(name, ...) STAP_PROBEV(kuroko, name, __VA_ARGS__)
+#else
+#define KRK_PROBE_ENABLED(name) 0
+#define KRK_PROBE(name, ...) do { } while (0)
+#endif
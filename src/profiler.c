@@ -0,0 +1,446 @@
+/**
+ * @file profiler.c
+ * @brief Timer-driven sampling profiler.
+ *
+ * SIGPROF only sets a flag on the thread it lands on; the VM notices the
+ * flag at the next instruction boundary and calls @c krk_profilerSample,
+ * so nothing in the signal handler needs to be async-signal-safe beyond
+ * the flag update. Samples are plain C strings, allocated outside of the
+ * GC, so they stay valid after the functions they describe are collected.
+ *
+ * The line profiler is hooked in the same way, but the flag is set by the VM
+ * itself whenever it enters a frame of a function that has line profiling
+ * enabled, and cleared when it leaves one.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#include <sys/time.h>
+#endif
+
+#include <kuroko/vm.h>
+#include <kuroko/util.h>
+#include <kuroko/profiler.h>
+
+#include "private.h"
+
+#define PROFILER_RING_SIZE 65536
+
+static char * sampleRing[PROFILER_RING_SIZE];
+static size_t sampleHead = 0;
+
+#if !defined(KRK_NO_TRACING) && !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+static void handleSigprof(int sigNum) {
+	if (!krk_currentThread.frameCount) return;
+	krk_currentThread.flags |= KRK_THREAD_PROFILE_SAMPLE;
+}
+
+int krk_profilerStart(long interval) {
+	struct sigaction sigProfAction;
+	sigProfAction.sa_handler = handleSigprof;
+	sigemptyset(&sigProfAction.sa_mask);
+	sigProfAction.sa_flags = SA_RESTART;
+	sigaction(SIGPROF, &sigProfAction, NULL);
+
+	struct itimerval timer;
+	timer.it_interval.tv_sec  = interval / 1000000;
+	timer.it_interval.tv_usec = interval % 1000000;
+	timer.it_value = timer.it_interval;
+	return setitimer(ITIMER_PROF, &timer, NULL) ? -1 : 0;
+}
+
+void krk_profilerStop(void) {
+	struct itimerval timer = {0};
+	setitimer(ITIMER_PROF, &timer, NULL);
+}
+#else
+int krk_profilerStart(long interval) {
+	return -1;
+}
+
+void krk_profilerStop(void) { }
+#endif
+
+static void appendFrame(char ** buf, size_t * len, size_t * cap, KrkCallFrame * frame, size_t offset) {
+	KrkCodeObject * function = frame->closure->function;
+	const char * name = function->qualname ? function->qualname->chars : (function->name ? function->name->chars : "<unnamed>");
+	const char * file = function->chunk.filename ? function->chunk.filename->chars : "<unknown>";
+	size_t line = krk_lineNumber(&function->chunk, offset);
+
+	size_t needed = strlen(name) + strlen(file) + 32;
+	if (*len + needed > *cap) {
+		while (*len + needed > *cap) *cap = *cap ? *cap * 2 : 256;
+		*buf = realloc(*buf, *cap);
+	}
+	*len += snprintf(*buf + *len, *cap - *len, "%s%s (%s:%zu)", *len ? ";" : "", name, file, line);
+}
+
+void krk_profilerSample(void) {
+	char * buf = NULL;
+	size_t len = 0, cap = 0;
+
+	for (size_t i = 0; i < krk_currentThread.frameCount; ++i) {
+		KrkCallFrame * frame = &krk_currentThread.frames[i];
+		size_t offset = frame->ip - frame->closure->function->chunk.code;
+		/* Callers are suspended just past their call instruction; the innermost frame is about to execute ip. */
+		if (i + 1 < krk_currentThread.frameCount && offset) offset--;
+		appendFrame(&buf, &len, &cap, frame, offset);
+	}
+
+	if (!buf) return;
+
+	/* Claim a slot; if it still holds an uncollected sample, that sample is the oldest and is discarded. */
+	size_t slot = __atomic_fetch_add(&sampleHead, 1, __ATOMIC_RELAXED) % PROFILER_RING_SIZE;
+	char * old = __atomic_exchange_n(&sampleRing[slot], buf, __ATOMIC_ACQ_REL);
+	free(old);
+}
+
+KrkValue krk_profilerCollect(void) {
+	KrkValue out = krk_dict_of(0,NULL,0);
+	krk_push(out);
+
+	for (size_t i = 0; i < PROFILER_RING_SIZE; ++i) {
+		char * sample = __atomic_exchange_n(&sampleRing[i], NULL, __ATOMIC_ACQ_REL);
+		if (!sample) continue;
+		krk_push(OBJECT_VAL(krk_copyString(sample, strlen(sample))));
+		free(sample);
+		KrkValue count = INTEGER_VAL(0);
+		krk_tableGet(AS_DICT(out), krk_peek(0), &count);
+		krk_tableSet(AS_DICT(out), krk_peek(0), INTEGER_VAL(AS_INTEGER(count) + 1));
+		krk_pop();
+	}
+
+	return krk_pop();
+}
+
+void krk_profilerWrite(FILE * f) {
+	KrkValue samples = krk_profilerCollect();
+	krk_push(samples);
+	for (size_t i = 0; i < AS_DICT(samples)->capacity; ++i) {
+		KrkTableEntry * entry = &AS_DICT(samples)->entries[i];
+		if (IS_KWARGS(entry->key)) continue;
+		fprintf(f, "%s %lld\n", AS_CSTRING(entry->key), (long long)AS_INTEGER(entry->value));
+	}
+	krk_pop();
+}
+
+KRK_FUNC(start_profiler,{
+	FUNCTION_TAKES_AT_MOST(1);
+	krk_integer_type interval = 1000;
+	if (argc > 0) {
+		CHECK_ARG(0,int,krk_integer_type,_interval);
+		interval = _interval;
+	}
+	if (interval <= 0) return krk_runtimeError(vm.exceptions->valueError, "interval must be positive");
+	if (krk_profilerStart(interval)) return krk_runtimeError(vm.exceptions->notImplementedError, "Profiling is not available in this build.");
+	return NONE_VAL();
+})
+
+KRK_FUNC(stop_profiler,{
+	FUNCTION_TAKES_NONE();
+	krk_profilerStop();
+	return NONE_VAL();
+})
+
+KRK_FUNC(collect_profile,{
+	FUNCTION_TAKES_NONE();
+	return krk_profilerCollect();
+})
+
+/* Where each line-profiled frame was when the hook last ran, indexed by frame depth. */
+struct LineProfileState {
+	KrkCodeObject * function;
+	size_t slots;
+	size_t offset;
+	size_t line;
+	uint64_t time;
+};
+
+static threadLocal struct LineProfileState * lineStates = NULL;
+static threadLocal size_t lineStatesCapacity = 0;
+
+static uint64_t lineProfileNow(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static KrkLineMap * lineForOffset(KrkChunk * chunk, size_t offset) {
+	/* Line map entries are in increasing offset order; find the last one at or before offset. */
+	size_t lo = 0, hi = chunk->linesCount;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (chunk->lines[mid].startOffset <= offset) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo ? &chunk->lines[lo-1] : NULL;
+}
+
+void krk_lineProfileEnable(KrkCodeObject * function) {
+	if (function->lineProfile) return;
+	size_t firstLine = SIZE_MAX, lastLine = 0;
+	for (size_t i = 0; i < function->chunk.linesCount; ++i) {
+		if (function->chunk.lines[i].line < firstLine) firstLine = function->chunk.lines[i].line;
+		if (function->chunk.lines[i].line > lastLine) lastLine = function->chunk.lines[i].line;
+	}
+	if (firstLine > lastLine) firstLine = lastLine = 0;
+	size_t lineCount = lastLine - firstLine + 1;
+	struct KrkLineProfile * profile = calloc(1, sizeof(struct KrkLineProfile) + sizeof(profile->lines[0]) * lineCount);
+	profile->firstLine = firstLine;
+	profile->lineCount = lineCount;
+	function->lineProfile = profile;
+	function->obj.flags |= KRK_OBJ_FLAGS_CODEOBJECT_LINE_PROFILE;
+}
+
+void krk_lineProfileHook(KrkCallFrame * frame) {
+	KrkCodeObject * function = frame->closure->function;
+	struct KrkLineProfile * profile = function->lineProfile;
+	if (!profile) return;
+
+	size_t depth = frame - krk_currentThread.frames;
+	if (depth >= lineStatesCapacity) {
+		size_t old = lineStatesCapacity;
+		while (depth >= lineStatesCapacity) lineStatesCapacity = lineStatesCapacity ? lineStatesCapacity * 2 : 16;
+		lineStates = realloc(lineStates, sizeof(struct LineProfileState) * lineStatesCapacity);
+		memset(&lineStates[old], 0, sizeof(struct LineProfileState) * (lineStatesCapacity - old));
+	}
+
+	uint64_t now = lineProfileNow();
+	struct LineProfileState * state = &lineStates[depth];
+	size_t offset = frame->ip - function->chunk.code;
+	KrkLineMap * entry = lineForOffset(&function->chunk, offset);
+	if (!entry) return;
+	size_t line = entry->line;
+
+	if (state->function == function && state->slots == frame->slots && offset) {
+		/* Still in the same call: everything since the last instruction, callees included, belongs to its line. */
+		profile->lines[state->line - profile->firstLine].nanoseconds += now - state->time;
+		/*
+		 * A line runs again when execution reaches its first instruction, or jumps back into it.
+		 * Forward jumps into the middle of a line, like skipping an if body to reach the loop
+		 * instruction at its end, don't count.
+		 */
+		if ((line != state->line && entry->startOffset == offset) || offset <= state->offset) {
+			profile->lines[line - profile->firstLine].hits++;
+		}
+	} else {
+		profile->lines[line - profile->firstLine].hits++;
+	}
+
+	state->function = function;
+	state->slots = frame->slots;
+	state->offset = offset;
+	state->line = line;
+	/* Don't charge our own bookkeeping to the line. */
+	state->time = lineProfileNow();
+}
+
+KrkValue krk_lineProfileStats(void) {
+	krk_gcGatherObjects();
+	KrkValue out = krk_dict_of(0,NULL,0);
+	krk_push(out);
+
+	for (KrkObj * object = vm.objects; object; object = object->next) {
+		if (object->type != KRK_OBJ_CODEOBJECT || !((KrkCodeObject*)object)->lineProfile) continue;
+		struct KrkLineProfile * profile = ((KrkCodeObject*)object)->lineProfile;
+		KrkValue lines = krk_list_of(0,NULL,0);
+		krk_push(lines);
+		for (size_t i = 0; i < profile->lineCount; ++i) {
+			if (!profile->lines[i].hits) continue;
+			KrkTuple * entry = krk_newTuple(3);
+			krk_push(OBJECT_VAL(entry));
+			entry->values.values[entry->values.count++] = INTEGER_VAL(profile->firstLine + i);
+			entry->values.values[entry->values.count++] = INTEGER_VAL(profile->lines[i].hits);
+			entry->values.values[entry->values.count++] = FLOATING_VAL((double)profile->lines[i].nanoseconds / 1000000000.0);
+			krk_writeValueArray(AS_LIST(lines), krk_peek(0));
+			krk_pop();
+		}
+		krk_tableSet(AS_DICT(out), OBJECT_VAL(object), lines);
+		krk_pop();
+	}
+
+	return krk_pop();
+}
+
+#ifdef KRK_NO_TRACING
+# define LINE_PROFILE_UNAVAILABLE 1
+#else
+# define LINE_PROFILE_UNAVAILABLE 0
+#endif
+
+KRK_FUNC(line_profile,{
+	FUNCTION_TAKES_EXACTLY(1);
+	KrkValue target = argv[0];
+	if (IS_BOUND_METHOD(target)) target = OBJECT_VAL(AS_BOUND_METHOD(target)->method);
+	if (IS_CLOSURE(target)) target = OBJECT_VAL(AS_CLOSURE(target)->function);
+	if (!IS_codeobject(target)) return TYPE_ERROR(function or codeobject,argv[0]);
+	if (LINE_PROFILE_UNAVAILABLE) return krk_runtimeError(vm.exceptions->notImplementedError, "Line profiling is not available in this build.");
+	krk_lineProfileEnable(AS_codeobject(target));
+	return argv[0];
+})
+
+KRK_FUNC(line_profile_stats,{
+	FUNCTION_TAKES_NONE();
+	return krk_lineProfileStats();
+})
+
+#ifdef KRK_OPCODE_STATS
+size_t krk_opcodeCounts[256];
+size_t krk_opcodePairCounts[256][256];
+
+#define SIMPLE(opc) [opc] = #opc,
+#define CONSTANT(opc,more) [opc] = #opc, [opc ## _LONG] = #opc "_LONG",
+#define OPERANDB(opc,more) [opc] = #opc,
+#define OPERAND(opc,more) [opc] = #opc, [opc ## _LONG] = #opc "_LONG",
+#define JUMP(opc,sign) [opc] = #opc,
+static const char * opcodeNames[256] = {
+#include "opcodes.h"
+};
+#undef SIMPLE
+#undef CONSTANT
+#undef OPERANDB
+#undef OPERAND
+#undef JUMP
+
+static KrkValue opcodeName(size_t opcode) {
+	/* Same spelling as the disassembler, without the OP_ prefix */
+	const char * name = opcodeNames[opcode] ? &opcodeNames[opcode][3] : "?";
+	return OBJECT_VAL(krk_copyString(name, strlen(name)));
+}
+
+KrkValue krk_opcodeStats(void) {
+	KrkValue out = krk_dict_of(0,NULL,0);
+	krk_push(out);
+
+	KrkValue opcodes = krk_dict_of(0,NULL,0);
+	krk_attachNamedValue(AS_DICT(out), "opcodes", opcodes);
+	for (size_t i = 0; i < 256; ++i) {
+		if (!krk_opcodeCounts[i]) continue;
+		krk_push(opcodeName(i));
+		krk_tableSet(AS_DICT(opcodes), krk_peek(0), INTEGER_VAL(krk_opcodeCounts[i]));
+		krk_pop();
+	}
+
+	KrkValue pairs = krk_dict_of(0,NULL,0);
+	krk_attachNamedValue(AS_DICT(out), "pairs", pairs);
+	for (size_t i = 0; i < 256; ++i) {
+		for (size_t j = 0; j < 256; ++j) {
+			if (!krk_opcodePairCounts[i][j]) continue;
+			KrkTuple * pair = krk_newTuple(2);
+			krk_push(OBJECT_VAL(pair));
+			pair->values.values[pair->values.count++] = opcodeName(i);
+			krk_gcWriteBarrier((KrkObj*)pair);
+			pair->values.values[pair->values.count++] = opcodeName(j);
+			krk_gcWriteBarrier((KrkObj*)pair);
+			krk_tableSet(AS_DICT(pairs), krk_peek(0), INTEGER_VAL(krk_opcodePairCounts[i][j]));
+			krk_pop();
+		}
+	}
+
+	KrkValue functions = krk_dict_of(0,NULL,0);
+	krk_attachNamedValue(AS_DICT(out), "functions", functions);
+	krk_gcGatherObjects();
+	for (KrkObj * object = vm.objects; object; object = object->next) {
+		if (object->type != KRK_OBJ_CODEOBJECT || !((KrkCodeObject*)object)->instructionCount) continue;
+		krk_tableSet(AS_DICT(functions), OBJECT_VAL(object), INTEGER_VAL(((KrkCodeObject*)object)->instructionCount));
+	}
+
+	return krk_pop();
+}
+
+struct StatsEntry {
+	size_t count;
+	size_t index;
+	KrkCodeObject * function;
+};
+
+static int compareStats(const void * a, const void * b) {
+	size_t l = ((const struct StatsEntry*)a)->count;
+	size_t r = ((const struct StatsEntry*)b)->count;
+	return (l < r) - (l > r);
+}
+
+void krk_opcodeStatsWrite(FILE * f, size_t limit) {
+	struct StatsEntry * entries = malloc(sizeof(struct StatsEntry) * 256 * 256);
+	size_t count = 0;
+
+	for (size_t i = 0; i < 256; ++i) {
+		if (krk_opcodeCounts[i]) entries[count++] = (struct StatsEntry){krk_opcodeCounts[i], i, NULL};
+	}
+	qsort(entries, count, sizeof(struct StatsEntry), compareStats);
+	fprintf(f, "Opcodes:\n");
+	for (size_t i = 0; i < count && i < limit; ++i) {
+		fprintf(f, "  %16zu  %s\n", entries[i].count, opcodeNames[entries[i].index] + 3);
+	}
+
+	count = 0;
+	for (size_t i = 0; i < 256 * 256; ++i) {
+		if (krk_opcodePairCounts[i >> 8][i & 0xFF]) entries[count++] = (struct StatsEntry){krk_opcodePairCounts[i >> 8][i & 0xFF], i, NULL};
+	}
+	qsort(entries, count, sizeof(struct StatsEntry), compareStats);
+	fprintf(f, "Opcode pairs:\n");
+	for (size_t i = 0; i < count && i < limit; ++i) {
+		fprintf(f, "  %16zu  %s %s\n", entries[i].count, opcodeNames[entries[i].index >> 8] + 3, opcodeNames[entries[i].index & 0xFF] + 3);
+	}
+
+	count = 0;
+	krk_gcGatherObjects();
+	for (KrkObj * object = vm.objects; object && count < 256 * 256; object = object->next) {
+		if (object->type != KRK_OBJ_CODEOBJECT || !((KrkCodeObject*)object)->instructionCount) continue;
+		entries[count++] = (struct StatsEntry){((KrkCodeObject*)object)->instructionCount, 0, (KrkCodeObject*)object};
+	}
+	qsort(entries, count, sizeof(struct StatsEntry), compareStats);
+	fprintf(f, "Functions:\n");
+	for (size_t i = 0; i < count && i < limit; ++i) {
+		KrkCodeObject * function = entries[i].function;
+		fprintf(f, "  %16zu  %s (%s:%zu)\n", entries[i].count,
+			function->qualname ? function->qualname->chars : (function->name ? function->name->chars : "<unnamed>"),
+			function->chunk.filename ? function->chunk.filename->chars : "<unknown>",
+			krk_lineNumber(&function->chunk, 0));
+	}
+
+	free(entries);
+}
+
+KRK_FUNC(opcode_stats,{
+	FUNCTION_TAKES_NONE();
+	return krk_opcodeStats();
+})
+#endif
+
+_noexport
+void _createAndBind_profiler(void) {
+	KRK_DOC(BIND_FUNC(vm.system,start_profiler),
+		"@brief Start the sampling profiler.\n"
+		"@arguments interval=1000\n\n"
+		"Samples the call stack of the running thread every @p interval microseconds of CPU time.");
+	KRK_DOC(BIND_FUNC(vm.system,stop_profiler),
+		"@brief Stop the sampling profiler.\n\n"
+		"Samples already taken are kept until they are collected.");
+	KRK_DOC(BIND_FUNC(vm.system,collect_profile),
+		"@brief Collect samples from the profiler.\n\n"
+		"Returns a @ref dict mapping collapsed stacks, with frames separated by semicolons, "
+		"to the number of times each was sampled, and discards the collected samples.");
+	KRK_DOC(BIND_FUNC(vm.system,line_profile),
+		"@brief Enable line-level profiling for a function.\n"
+		"@arguments func\n\n"
+		"Counts how often each line of @p func runs and how long it takes, including time spent in "
+		"functions it calls. Accepts functions, methods, and code objects, and returns @p func, "
+		"so it can be used as a decorator.");
+	KRK_DOC(BIND_FUNC(vm.system,line_profile_stats),
+		"@brief Obtain line profiling results.\n\n"
+		"Returns a @ref dict mapping each line-profiled code object to a list of "
+		"<i>(line, hits, seconds)</i> tuples for the lines that have run.");
+#ifdef KRK_OPCODE_STATS
+	KRK_DOC(BIND_FUNC(vm.system,opcode_stats),
+		"@brief Obtain instruction execution counters.\n\n"
+		"Returns a @ref dict with the entries @c opcodes, mapping opcode names to execution counts, "
+		"@c pairs, mapping tuples of consecutive opcode names to counts, and @c functions, "
+		"mapping code objects to the number of instructions they have executed. "
+		"Only available in builds with @c KRK_OPCODE_STATS.");
+#endif
+}
@@ -5,8 +5,10 @@
 
 #include <kuroko/kuroko.h>
 #include <kuroko/scanner.h>
+#include <kuroko/vm.h>
 
-static KrkScanner scanner;
+/* Each thread scans its own source, so threads can compile at the same time. */
+static threadLocal KrkScanner scanner;
 
 void krk_initScanner(const char * src) {
 	scanner.start = src;
@@ -0,0 +1,243 @@
+/**
+ * @file slab.c
+ * @brief Size-class page allocator for object structs.
+ *
+ * Most objects are a few dozen bytes and come in a handful of sizes.
+ * Rather than going to malloc for each one, object structs are carved out
+ * of aligned 64KiB pages that each hold slots of a single size class, so
+ * allocating is a freelist pop or a bump of a pointer, objects of one type
+ * sit next to each other, and a freed slot is found from its address alone.
+ *
+ * A page that has become completely empty is unmapped, except for one
+ * spare page per size class, which is kept to avoid mapping and unmapping
+ * a page over and over when a program allocates and frees in a tight loop.
+ *
+ * Anything larger than the biggest size class, such as instances of
+ * classes that store a lot of native state, goes to malloc as before.
+ *
+ * With threading, each thread takes slots from its size class a batch at
+ * a time and hands them out from its own cache, so that threads which are
+ * all allocating do not meet on the class's lock for every object. Freed
+ * slots go straight back to their page, as the collector frees objects
+ * made by every thread.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <kuroko/kuroko.h>
+#include <kuroko/threads.h>
+#include <kuroko/vm.h>
+
+#include "private.h"
+
+#if defined(_WIN32)
+# include <malloc.h>
+#elif !defined(__EMSCRIPTEN__)
+# include <sys/mman.h>
+#endif
+
+#if defined(__SANITIZE_ADDRESS__)
+# define SLAB_ASAN 1
+#elif defined(__has_feature)
+# if __has_feature(address_sanitizer)
+#  define SLAB_ASAN 1
+# endif
+#endif
+
+#ifdef SLAB_ASAN
+# include <sanitizer/asan_interface.h>
+# define POISON(p,s)   ASAN_POISON_MEMORY_REGION(p,s)
+# define UNPOISON(p,s) ASAN_UNPOISON_MEMORY_REGION(p,s)
+#else
+# define POISON(p,s)   ((void)(p), (void)(s))
+# define UNPOISON(p,s) ((void)(p), (void)(s))
+#endif
+
+#define SLAB_PAGE_SIZE (64 * 1024)
+#define SLAB_GRANULE   16
+#define SLAB_CLASSES   (KRK_SLAB_MAX / SLAB_GRANULE)
+
+typedef struct SlabPage {
+	struct SlabPage * next;
+	struct SlabPage * prev;
+	void * freeList;       /**< Slots that were freed */
+	char * bump;           /**< Start of the slots that were never handed out */
+	unsigned int used;     /**< Slots in use */
+	unsigned int sizeClass;
+	int partial;           /**< Whether the page is in its class's list of pages with free slots */
+} SlabPage;
+
+#define SLAB_FIRST_SLOT ((sizeof(SlabPage) + SLAB_GRANULE - 1) & ~(size_t)(SLAB_GRANULE - 1))
+
+static struct SlabClass {
+	SlabPage * partial;    /**< Pages with free slots */
+	SlabPage * spare;      /**< An empty page kept for reuse */
+	volatile int lock;
+} classes[SLAB_CLASSES];
+
+#ifdef ENABLE_THREADING
+#define SLAB_BATCH 16
+
+static threadLocal struct SlabCache {
+	void * slots[SLAB_BATCH]; /**< Slots taken from the class and not yet handed out, still poisoned */
+	unsigned int count;
+} caches[SLAB_CLASSES];
+#endif
+
+static void * mapPage(void) {
+#if defined(_WIN32)
+	return _aligned_malloc(SLAB_PAGE_SIZE, SLAB_PAGE_SIZE);
+#elif defined(__EMSCRIPTEN__)
+	void * out;
+	return posix_memalign(&out, SLAB_PAGE_SIZE, SLAB_PAGE_SIZE) ? NULL : out;
+#else
+	/* Map twice as much as we need and trim it down to an aligned page. */
+	char * out = mmap(NULL, SLAB_PAGE_SIZE * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (out == MAP_FAILED) return NULL;
+	uintptr_t aligned = ((uintptr_t)out + SLAB_PAGE_SIZE - 1) & ~(uintptr_t)(SLAB_PAGE_SIZE - 1);
+	size_t before = aligned - (uintptr_t)out;
+	if (before) munmap(out, before);
+	munmap((char*)aligned + SLAB_PAGE_SIZE, SLAB_PAGE_SIZE - before);
+	return (void*)aligned;
+#endif
+}
+
+static void unmapPage(SlabPage * page) {
+	UNPOISON(page, SLAB_PAGE_SIZE);
+#if defined(_WIN32)
+	_aligned_free(page);
+#elif defined(__EMSCRIPTEN__)
+	free(page);
+#else
+	munmap(page, SLAB_PAGE_SIZE);
+#endif
+}
+
+static void resetPage(SlabPage * page) {
+	page->freeList = NULL;
+	page->bump = (char*)page + SLAB_FIRST_SLOT;
+	page->used = 0;
+	POISON(page->bump, SLAB_PAGE_SIZE - SLAB_FIRST_SLOT);
+}
+
+static void linkPartial(struct SlabClass * sc, SlabPage * page) {
+	page->prev = NULL;
+	page->next = sc->partial;
+	if (sc->partial) sc->partial->prev = page;
+	sc->partial = page;
+	page->partial = 1;
+}
+
+static void unlinkPartial(struct SlabClass * sc, SlabPage * page) {
+	if (page->prev) page->prev->next = page->next;
+	else sc->partial = page->next;
+	if (page->next) page->next->prev = page->prev;
+	page->partial = 0;
+}
+
+/* Takes a slot from the class; its lock must be held. */
+static void * takeSlot(struct SlabClass * sc, unsigned int sizeClass, size_t slotSize) {
+	SlabPage * page = sc->partial;
+	if (!page) {
+		if (sc->spare) {
+			page = sc->spare;
+			sc->spare = NULL;
+		} else {
+			page = mapPage();
+			if (!page) return NULL;
+			page->sizeClass = sizeClass;
+			resetPage(page);
+		}
+		linkPartial(sc, page);
+	}
+
+	void * out;
+	if (page->freeList) {
+		out = page->freeList;
+		UNPOISON(out, sizeof(void*));
+		page->freeList = *(void**)out;
+		POISON(out, sizeof(void*));
+	} else {
+		out = page->bump;
+		page->bump += slotSize;
+	}
+	page->used++;
+
+	if (!page->freeList && page->bump + slotSize > (char*)page + SLAB_PAGE_SIZE) {
+		unlinkPartial(sc, page);
+	}
+	return out;
+}
+
+void * krk_slabAllocate(size_t size) {
+	if (size > KRK_SLAB_MAX) return malloc(size);
+
+	unsigned int sizeClass = (size - 1) / SLAB_GRANULE;
+	size_t slotSize = (sizeClass + 1) * SLAB_GRANULE;
+	struct SlabClass * sc = &classes[sizeClass];
+	void * out;
+
+#ifdef ENABLE_THREADING
+	struct SlabCache * cache = &caches[sizeClass];
+	if (!cache->count) {
+		_obtain_lock(sc->lock);
+		while (cache->count < SLAB_BATCH) {
+			void * slot = takeSlot(sc, sizeClass, slotSize);
+			if (!slot) break;
+			cache->slots[cache->count++] = slot;
+		}
+		_release_lock(sc->lock);
+		if (!cache->count) return NULL;
+	}
+	out = cache->slots[--cache->count];
+#else
+	out = takeSlot(sc, sizeClass, slotSize);
+	if (!out) return NULL;
+#endif
+
+	UNPOISON(out, slotSize);
+	return out;
+}
+
+void krk_slabFree(void * ptr, size_t size) {
+	if (size > KRK_SLAB_MAX) {
+		free(ptr);
+		return;
+	}
+
+	SlabPage * page = (SlabPage*)((uintptr_t)ptr & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+	struct SlabClass * sc = &classes[page->sizeClass];
+	size_t slotSize = (page->sizeClass + 1) * SLAB_GRANULE;
+
+	_obtain_lock(sc->lock);
+	*(void**)ptr = page->freeList;
+	page->freeList = ptr;
+	POISON(ptr, slotSize);
+	page->used--;
+
+	if (!page->used) {
+		if (page->partial) unlinkPartial(sc, page);
+		if (sc->spare) {
+			unmapPage(page);
+		} else {
+			resetPage(page);
+			sc->spare = page;
+		}
+	} else if (!page->partial) {
+		linkPartial(sc, page);
+	}
+	_release_lock(sc->lock);
+}
+
+void krk_slabReleaseCache(void) {
+#ifdef ENABLE_THREADING
+	for (unsigned int sizeClass = 0; sizeClass < SLAB_CLASSES; ++sizeClass) {
+		struct SlabCache * cache = &caches[sizeClass];
+		size_t slotSize = (sizeClass + 1) * SLAB_GRANULE;
+		while (cache->count) {
+			void * slot = cache->slots[--cache->count];
+			UNPOISON(slot, slotSize);
+			krk_slabFree(slot, slotSize);
+		}
+	}
+#endif
+}
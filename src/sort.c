@@ -0,0 +1,635 @@
+/**
+ * @file sort.c
+ * @brief Stable sorting for list.sort and sorted.
+ *
+ * This is Timsort, as described in CPython's listsort.txt: the input is
+ * split into runs that are already in order (or in reverse order, which
+ * are flipped), short runs are extended with a binary insertion sort, and
+ * runs are merged from a stack whose lengths are kept balanced. Merges
+ * switch to galloping when one run keeps winning, so presorted and
+ * partially sorted input takes close to linear time.
+ *
+ * Before sorting, the keys are checked once to see if they are all ints,
+ * all numbers, or all strings; those are compared directly in C instead
+ * of going through @c __lt__.
+ */
+#include <string.h>
+#include <kuroko/vm.h>
+#include <kuroko/value.h>
+#include <kuroko/memory.h>
+#include <kuroko/util.h>
+
+#include "private.h"
+
+/* Runs can be at most this much longer than their neighbours before merging; 85 is enough for 2^64 values. */
+#define MAX_RUNS   85
+#define MIN_GALLOP 7
+
+/**
+ * Keys and, when sorting by a key function, the values they came from,
+ * which are moved along with them.
+ */
+typedef struct {
+	KrkValue * keys;
+	KrkValue * values;
+} SortSlice;
+
+typedef struct SortState {
+	int (*lt)(struct SortState *, KrkValue, KrkValue); /**< 1 if a < b, 0 if not, -1 if an exception was raised */
+	int hasValues;
+	ssize_t minGallop;
+
+	/* Merge space, in lists so the values in it are seen by the garbage collector. */
+	KrkValueArray * tempKeys;
+	KrkValueArray * tempValues;
+	SortSlice temp;
+
+	/* The arrays being sorted, which need a write barrier before managed code runs */
+	KrkObj * owners[2];
+
+	size_t runCount;
+	struct {
+		SortSlice base;
+		ssize_t len;
+	} runs[MAX_RUNS];
+} SortState;
+
+static int ltInt(SortState * s, KrkValue a, KrkValue b) {
+	return AS_INTEGER(a) < AS_INTEGER(b);
+}
+
+static int ltNumber(SortState * s, KrkValue a, KrkValue b) {
+	/* The same mixed comparison as int.__lt__ and float.__lt__ */
+	double x = IS_INTEGER(a) ? (double)AS_INTEGER(a) : AS_FLOATING(a);
+	double y = IS_INTEGER(b) ? (double)AS_INTEGER(b) : AS_FLOATING(b);
+	return x < y;
+}
+
+static int ltString(SortState * s, KrkValue a, KrkValue b) {
+	/* Compared the way str.__lt__ does it, byte by byte as char */
+	KrkString * x = AS_STRING(a);
+	KrkString * y = AS_STRING(b);
+	size_t len = x->length < y->length ? x->length : y->length;
+	for (size_t i = 0; i < len; ++i) {
+		if (x->chars[i] < y->chars[i]) return 1;
+		if (x->chars[i] > y->chars[i]) return 0;
+	}
+	return x->length < y->length;
+}
+
+/**
+ * Values are moved between the arrays without write barriers, so before
+ * anything that could run the collector, they all get one.
+ */
+static void barrier(SortState * s) {
+	for (int i = 0; i < 2; ++i) if (s->owners[i]) krk_gcWriteBarrier(s->owners[i]);
+	krk_gcWriteBarrier(s->tempKeys->owner);
+	if (s->tempValues) krk_gcWriteBarrier(s->tempValues->owner);
+}
+
+int krk_lessThan(KrkValue a, KrkValue b) {
+	if (IS_INTEGER(a) && IS_INTEGER(b)) return AS_INTEGER(a) < AS_INTEGER(b);
+	if ((IS_INTEGER(a) || IS_FLOATING(a)) && (IS_INTEGER(b) || IS_FLOATING(b))) {
+		double x = IS_INTEGER(a) ? (double)AS_INTEGER(a) : AS_FLOATING(a);
+		double y = IS_INTEGER(b) ? (double)AS_INTEGER(b) : AS_FLOATING(b);
+		return x < y;
+	}
+	KrkValue result = krk_operator_lt(a, b);
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return -1;
+	return IS_BOOLEAN(result) ? AS_BOOLEAN(result) : !krk_isFalsey(result);
+}
+
+static int ltObject(SortState * s, KrkValue a, KrkValue b) {
+	barrier(s);
+	return krk_lessThan(a, b);
+}
+
+#define IFLT(a,b) int _lt = s->lt(s, (a), (b)); if (_lt < 0) return -1; if (_lt)
+
+static inline void sliceCopy(SortState * s, SortSlice * dst, ssize_t i, SortSlice * src, ssize_t j) {
+	dst->keys[i] = src->keys[j];
+	if (s->hasValues) dst->values[i] = src->values[j];
+}
+
+static inline void sliceMove(SortState * s, SortSlice * dst, ssize_t i, SortSlice * src, ssize_t j, ssize_t n) {
+	memmove(&dst->keys[i], &src->keys[j], sizeof(KrkValue) * n);
+	if (s->hasValues) memmove(&dst->values[i], &src->values[j], sizeof(KrkValue) * n);
+}
+
+static inline void sliceAdvance(SortState * s, SortSlice * slice, ssize_t n) {
+	slice->keys += n;
+	if (s->hasValues) slice->values += n;
+}
+
+static void reverseSlice(SortState * s, SortSlice slice, ssize_t n) {
+	for (ssize_t i = 0, j = n - 1; i < j; ++i, --j) {
+		KrkValue tmp = slice.keys[i];
+		slice.keys[i] = slice.keys[j];
+		slice.keys[j] = tmp;
+		if (s->hasValues) {
+			tmp = slice.values[i];
+			slice.values[i] = slice.values[j];
+			slice.values[j] = tmp;
+		}
+	}
+}
+
+/**
+ * Sort the first @p n values of @p slice, of which the first @p start are already sorted.
+ */
+static int binaryInsertion(SortState * s, SortSlice slice, ssize_t n, ssize_t start) {
+	for (; start < n; ++start) {
+		KrkValue pivot = slice.keys[start];
+		ssize_t l = 0, r = start;
+		while (l < r) {
+			ssize_t p = l + ((r - l) >> 1);
+			int lt = s->lt(s, pivot, slice.keys[p]);
+			if (lt < 0) return -1;
+			if (lt) r = p;
+			else l = p + 1;
+		}
+		/* Equal keys go after the ones already there, which keeps the sort stable. */
+		memmove(&slice.keys[l + 1], &slice.keys[l], sizeof(KrkValue) * (start - l));
+		slice.keys[l] = pivot;
+		if (s->hasValues) {
+			KrkValue value = slice.values[start];
+			memmove(&slice.values[l + 1], &slice.values[l], sizeof(KrkValue) * (start - l));
+			slice.values[l] = value;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Length of the run at the start of @p slice, which is either non-descending
+ * or strictly descending; only strictly descending runs can be flipped without
+ * reordering equal keys.
+ */
+static ssize_t countRun(SortState * s, SortSlice slice, ssize_t n, int * descending) {
+	*descending = 0;
+	if (n == 1) return 1;
+	ssize_t len = 2;
+	int lt = s->lt(s, slice.keys[1], slice.keys[0]);
+	if (lt < 0) return -1;
+	if (lt) {
+		*descending = 1;
+		for (; len < n; ++len) {
+			lt = s->lt(s, slice.keys[len], slice.keys[len - 1]);
+			if (lt < 0) return -1;
+			if (!lt) break;
+		}
+	} else {
+		for (; len < n; ++len) {
+			lt = s->lt(s, slice.keys[len], slice.keys[len - 1]);
+			if (lt < 0) return -1;
+			if (lt) break;
+		}
+	}
+	return len;
+}
+
+/**
+ * Where @p key goes in the sorted @p a, before any keys equal to it,
+ * searching out from @p hint.
+ */
+static ssize_t gallopLeft(SortState * s, KrkValue key, KrkValue * a, ssize_t n, ssize_t hint) {
+	ssize_t ofs = 1, lastofs = 0, maxofs;
+	a += hint;
+	IFLT(*a, key) {
+		/* a[hint] < key: gallop right, until a[hint + lastofs] < key <= a[hint + ofs] */
+		maxofs = n - hint;
+		while (ofs < maxofs) {
+			IFLT(a[ofs], key) {
+				lastofs = ofs;
+				ofs = (ofs << 1) + 1;
+			} else break;
+		}
+		if (ofs > maxofs) ofs = maxofs;
+		lastofs += hint;
+		ofs += hint;
+	} else {
+		/* key <= a[hint]: gallop left, until a[hint - ofs] < key <= a[hint - lastofs] */
+		maxofs = hint + 1;
+		while (ofs < maxofs) {
+			IFLT(*(a - ofs), key) break;
+			lastofs = ofs;
+			ofs = (ofs << 1) + 1;
+		}
+		if (ofs > maxofs) ofs = maxofs;
+		ssize_t k = lastofs;
+		lastofs = hint - ofs;
+		ofs = hint - k;
+	}
+	a -= hint;
+
+	/* Now a[lastofs] < key <= a[ofs], so binary search between them. */
+	++lastofs;
+	while (lastofs < ofs) {
+		ssize_t m = lastofs + ((ofs - lastofs) >> 1);
+		IFLT(a[m], key) lastofs = m + 1;
+		else ofs = m;
+	}
+	return ofs;
+}
+
+/**
+ * Where @p key goes in the sorted @p a, after any keys equal to it.
+ */
+static ssize_t gallopRight(SortState * s, KrkValue key, KrkValue * a, ssize_t n, ssize_t hint) {
+	ssize_t ofs = 1, lastofs = 0, maxofs;
+	a += hint;
+	IFLT(key, *a) {
+		/* key < a[hint]: gallop left, until a[hint - ofs] <= key < a[hint - lastofs] */
+		maxofs = hint + 1;
+		while (ofs < maxofs) {
+			IFLT(key, *(a - ofs)) {
+				lastofs = ofs;
+				ofs = (ofs << 1) + 1;
+			} else break;
+		}
+		if (ofs > maxofs) ofs = maxofs;
+		ssize_t k = lastofs;
+		lastofs = hint - ofs;
+		ofs = hint - k;
+	} else {
+		/* a[hint] <= key: gallop right, until a[hint + lastofs] <= key < a[hint + ofs] */
+		maxofs = n - hint;
+		while (ofs < maxofs) {
+			IFLT(key, a[ofs]) break;
+			lastofs = ofs;
+			ofs = (ofs << 1) + 1;
+		}
+		if (ofs > maxofs) ofs = maxofs;
+		lastofs += hint;
+		ofs += hint;
+	}
+	a -= hint;
+
+	++lastofs;
+	while (lastofs < ofs) {
+		ssize_t m = lastofs + ((ofs - lastofs) >> 1);
+		IFLT(key, a[m]) ofs = m;
+		else lastofs = m + 1;
+	}
+	return ofs;
+}
+
+static void ensureTemp(SortState * s, ssize_t need) {
+	if ((ssize_t)s->tempKeys->count >= need) return;
+	barrier(s);
+	/* The whole of the merge space is kept filled, so the collector can mark all of it. */
+	KrkValueArray * lists[2] = {s->tempKeys, s->tempValues};
+	for (int i = 0; i < 1 + s->hasValues; ++i) {
+		size_t old = lists[i]->capacity;
+		lists[i]->capacity = need;
+		lists[i]->values = GROW_ARRAY(KrkValue, lists[i]->values, old, need);
+		for (size_t j = lists[i]->count; j < (size_t)need; ++j) lists[i]->values[j] = NONE_VAL();
+		lists[i]->count = need;
+	}
+	s->temp.keys = s->tempKeys->values;
+	s->temp.values = s->hasValues ? s->tempValues->values : NULL;
+}
+
+/**
+ * Merge the @p na keys of @p a with the @p nb keys of @p b, which follow
+ * them; @p na is no more than @p nb, so @p a is the one copied aside.
+ * Whatever happens, every key ends up in one place in the merged range.
+ */
+static int mergeLow(SortState * s, SortSlice a, ssize_t na, SortSlice b, ssize_t nb) {
+	ensureTemp(s, na);
+	SortSlice dest = a;
+	SortSlice temp = s->temp;
+	sliceMove(s, &temp, 0, &a, 0, na);
+	a = temp;
+	int result = -1;
+	ssize_t k;
+
+	/* b[0] is known to come first, from the gallop in mergeAt. */
+	sliceCopy(s, &dest, 0, &b, 0);
+	sliceAdvance(s, &dest, 1);
+	sliceAdvance(s, &b, 1);
+	if (--nb == 0) goto _succeed;
+	if (na == 1) goto _copyB;
+
+	ssize_t minGallop = s->minGallop;
+	for (;;) {
+		ssize_t acount = 0, bcount = 0;
+
+		/* One at a time, until one side wins often enough */
+		for (;;) {
+			int lt = s->lt(s, b.keys[0], a.keys[0]);
+			if (lt < 0) goto _fail;
+			if (lt) {
+				sliceCopy(s, &dest, 0, &b, 0);
+				sliceAdvance(s, &dest, 1);
+				sliceAdvance(s, &b, 1);
+				++bcount;
+				acount = 0;
+				if (--nb == 0) goto _succeed;
+				if (bcount >= minGallop) break;
+			} else {
+				sliceCopy(s, &dest, 0, &a, 0);
+				sliceAdvance(s, &dest, 1);
+				sliceAdvance(s, &a, 1);
+				++acount;
+				bcount = 0;
+				if (--na == 1) goto _copyB;
+				if (acount >= minGallop) break;
+			}
+		}
+
+		/* Galloping, for as long as it finds long stretches */
+		++minGallop;
+		do {
+			minGallop -= minGallop > 1;
+			s->minGallop = minGallop;
+			k = gallopRight(s, b.keys[0], a.keys, na, 0);
+			if (k < 0) goto _fail;
+			acount = k;
+			if (k) {
+				sliceMove(s, &dest, 0, &a, 0, k);
+				sliceAdvance(s, &dest, k);
+				sliceAdvance(s, &a, k);
+				na -= k;
+				if (na == 1) goto _copyB;
+				/* Only if the comparison isn't consistent */
+				if (na == 0) goto _succeed;
+			}
+			sliceCopy(s, &dest, 0, &b, 0);
+			sliceAdvance(s, &dest, 1);
+			sliceAdvance(s, &b, 1);
+			if (--nb == 0) goto _succeed;
+
+			k = gallopLeft(s, a.keys[0], b.keys, nb, 0);
+			if (k < 0) goto _fail;
+			bcount = k;
+			if (k) {
+				sliceMove(s, &dest, 0, &b, 0, k);
+				sliceAdvance(s, &dest, k);
+				sliceAdvance(s, &b, k);
+				nb -= k;
+				if (nb == 0) goto _succeed;
+			}
+			sliceCopy(s, &dest, 0, &a, 0);
+			sliceAdvance(s, &dest, 1);
+			sliceAdvance(s, &a, 1);
+			if (--na == 1) goto _copyB;
+		} while (acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+		++minGallop;
+		s->minGallop = minGallop;
+	}
+
+_succeed:
+	result = 0;
+_fail:
+	if (na) sliceMove(s, &dest, 0, &a, 0, na);
+	return result;
+_copyB:
+	/* The last key of a comes after everything left in b. */
+	sliceMove(s, &dest, 0, &b, 0, nb);
+	sliceCopy(s, &dest, nb, &a, 0);
+	return 0;
+}
+
+/**
+ * As @ref mergeLow, but for when @p nb is smaller, so it is @p b that is
+ * copied aside and the merge runs from the end.
+ */
+static int mergeHigh(SortState * s, SortSlice a, ssize_t na, SortSlice b, ssize_t nb) {
+	ensureTemp(s, nb);
+	SortSlice dest = b;
+	sliceAdvance(s, &dest, nb - 1);
+	SortSlice baseB = s->temp;
+	sliceMove(s, &baseB, 0, &b, 0, nb);
+	SortSlice baseA = a;
+	b = baseB;
+	sliceAdvance(s, &b, nb - 1);
+	sliceAdvance(s, &a, na - 1);
+	int result = -1;
+	ssize_t k;
+
+	/* a[na-1] is known to come last. */
+	sliceCopy(s, &dest, 0, &a, 0);
+	sliceAdvance(s, &dest, -1);
+	sliceAdvance(s, &a, -1);
+	if (--na == 0) goto _succeed;
+	if (nb == 1) goto _copyA;
+
+	ssize_t minGallop = s->minGallop;
+	for (;;) {
+		ssize_t acount = 0, bcount = 0;
+
+		for (;;) {
+			int lt = s->lt(s, b.keys[0], a.keys[0]);
+			if (lt < 0) goto _fail;
+			if (lt) {
+				sliceCopy(s, &dest, 0, &a, 0);
+				sliceAdvance(s, &dest, -1);
+				sliceAdvance(s, &a, -1);
+				++acount;
+				bcount = 0;
+				if (--na == 0) goto _succeed;
+				if (acount >= minGallop) break;
+			} else {
+				sliceCopy(s, &dest, 0, &b, 0);
+				sliceAdvance(s, &dest, -1);
+				sliceAdvance(s, &b, -1);
+				++bcount;
+				acount = 0;
+				if (--nb == 1) goto _copyA;
+				if (bcount >= minGallop) break;
+			}
+		}
+
+		++minGallop;
+		do {
+			minGallop -= minGallop > 1;
+			s->minGallop = minGallop;
+			k = gallopRight(s, b.keys[0], baseA.keys, na, na - 1);
+			if (k < 0) goto _fail;
+			k = na - k;
+			acount = k;
+			if (k) {
+				sliceAdvance(s, &dest, -k);
+				sliceAdvance(s, &a, -k);
+				sliceMove(s, &dest, 1, &a, 1, k);
+				na -= k;
+				if (na == 0) goto _succeed;
+			}
+			sliceCopy(s, &dest, 0, &b, 0);
+			sliceAdvance(s, &dest, -1);
+			sliceAdvance(s, &b, -1);
+			if (--nb == 1) goto _copyA;
+
+			k = gallopLeft(s, a.keys[0], baseB.keys, nb, nb - 1);
+			if (k < 0) goto _fail;
+			k = nb - k;
+			bcount = k;
+			if (k) {
+				sliceAdvance(s, &dest, -k);
+				sliceAdvance(s, &b, -k);
+				sliceMove(s, &dest, 1, &b, 1, k);
+				nb -= k;
+				if (nb == 1) goto _copyA;
+				if (nb == 0) goto _succeed;
+			}
+			sliceCopy(s, &dest, 0, &a, 0);
+			sliceAdvance(s, &dest, -1);
+			sliceAdvance(s, &a, -1);
+			if (--na == 0) goto _succeed;
+		} while (acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+		++minGallop;
+		s->minGallop = minGallop;
+	}
+
+_succeed:
+	result = 0;
+_fail:
+	if (nb) sliceMove(s, &dest, -(nb - 1), &baseB, 0, nb);
+	return result;
+_copyA:
+	/* The first key of b comes before everything left in a. */
+	sliceAdvance(s, &dest, -na);
+	sliceAdvance(s, &a, -na);
+	sliceMove(s, &dest, 1, &a, 1, na);
+	sliceCopy(s, &dest, 0, &b, 0);
+	return 0;
+}
+
+/**
+ * Merge runs @p i and @p i + 1 on the stack.
+ */
+static int mergeAt(SortState * s, size_t i) {
+	SortSlice a = s->runs[i].base;
+	ssize_t na = s->runs[i].len;
+	SortSlice b = s->runs[i + 1].base;
+	ssize_t nb = s->runs[i + 1].len;
+
+	s->runs[i].len = na + nb;
+	if (i == s->runCount - 3) s->runs[i + 1] = s->runs[i + 2];
+	s->runCount--;
+
+	/* Keys at the start of a that come before b[0] are already where they belong... */
+	ssize_t k = gallopRight(s, b.keys[0], a.keys, na, 0);
+	if (k < 0) return -1;
+	sliceAdvance(s, &a, k);
+	na -= k;
+	if (na == 0) return 0;
+
+	/* ...and so are keys at the end of b that come after the last of a. */
+	nb = gallopLeft(s, a.keys[na - 1], b.keys, nb, nb - 1);
+	if (nb <= 0) return nb;
+
+	return na <= nb ? mergeLow(s, a, na, b, nb) : mergeHigh(s, a, na, b, nb);
+}
+
+/**
+ * Merge runs until the lengths on the stack shrink quickly enough from the
+ * bottom up, so runs are merged with others of about the same size.
+ */
+static int mergeCollapse(SortState * s) {
+	while (s->runCount > 1) {
+		size_t n = s->runCount - 2;
+		if ((n > 0 && s->runs[n - 1].len <= s->runs[n].len + s->runs[n + 1].len) ||
+		    (n > 1 && s->runs[n - 2].len <= s->runs[n - 1].len + s->runs[n].len)) {
+			if (s->runs[n - 1].len < s->runs[n + 1].len) --n;
+			if (mergeAt(s, n) < 0) return -1;
+		} else if (s->runs[n].len <= s->runs[n + 1].len) {
+			if (mergeAt(s, n) < 0) return -1;
+		} else {
+			break;
+		}
+	}
+	return 0;
+}
+
+static int mergeForceCollapse(SortState * s) {
+	while (s->runCount > 1) {
+		size_t n = s->runCount - 2;
+		if (n > 0 && s->runs[n - 1].len < s->runs[n + 1].len) --n;
+		if (mergeAt(s, n) < 0) return -1;
+	}
+	return 0;
+}
+
+/**
+ * Runs shorter than this are extended with binary insertion; it is chosen so
+ * the number of runs is a power of two, or a little less, for balanced merges.
+ */
+static ssize_t minRun(ssize_t n) {
+	ssize_t r = 0;
+	while (n >= 64) {
+		r |= n & 1;
+		n >>= 1;
+	}
+	return n + r;
+}
+
+static int sortSlice(SortState * s, SortSlice lo, ssize_t remaining) {
+	ssize_t minrun = minRun(remaining);
+	do {
+		int descending;
+		ssize_t n = countRun(s, lo, remaining, &descending);
+		if (n < 0) return -1;
+		if (descending) reverseSlice(s, lo, n);
+		if (n < minrun) {
+			ssize_t force = remaining <= minrun ? remaining : minrun;
+			if (binaryInsertion(s, lo, force, n) < 0) return -1;
+			n = force;
+		}
+		s->runs[s->runCount].base = lo;
+		s->runs[s->runCount].len = n;
+		s->runCount++;
+		if (mergeCollapse(s) < 0) return -1;
+		sliceAdvance(s, &lo, n);
+		remaining -= n;
+	} while (remaining);
+	return mergeForceCollapse(s);
+}
+
+int krk_sortValueArrays(KrkValueArray * keys, KrkValueArray * values, int reverse) {
+	ssize_t count = keys->count;
+	if (count < 2) return 1;
+
+	SortState s;
+	s.hasValues = values != NULL;
+	s.minGallop = MIN_GALLOP;
+	s.runCount = 0;
+	s.owners[0] = keys->owner;
+	s.owners[1] = values ? values->owner : NULL;
+
+	/* See what the keys have in common, to pick a comparison. */
+	int ints = 1, numbers = 1, strings = 1;
+	for (ssize_t i = 0; i < count && (numbers || strings); ++i) {
+		KrkValue key = keys->values[i];
+		if (!IS_INTEGER(key)) {
+			ints = 0;
+			if (!IS_FLOATING(key)) numbers = 0;
+		}
+		if (!IS_STRING(key)) strings = 0;
+	}
+	s.lt = ints ? ltInt : numbers ? ltNumber : strings ? ltString : ltObject;
+
+	krk_push(krk_list_of(0, NULL, 0));
+	s.tempKeys = AS_LIST(krk_peek(0));
+	s.tempValues = NULL;
+	if (values) {
+		krk_push(krk_list_of(0, NULL, 0));
+		s.tempValues = AS_LIST(krk_peek(0));
+	}
+	s.temp.keys = NULL;
+	s.temp.values = NULL;
+
+	SortSlice slice = {keys->values, values ? values->values : NULL};
+
+	/* Reversing before and after keeps equal keys in their original order. */
+	if (reverse) reverseSlice(&s, slice, count);
+	int result = sortSlice(&s, slice, count);
+	if (reverse) reverseSlice(&s, slice, count);
+
+	if (values) krk_pop();
+	krk_pop();
+	if (keys->owner) krk_gcWriteBarrier(keys->owner);
+	if (values && values->owner) krk_gcWriteBarrier(values->owner);
+	return result == 0;
+}
@@ -9,17 +9,37 @@
 #include <kuroko/threads.h>
 #include <kuroko/util.h>
 
-#define TABLE_MAX_LOAD 0.75
+#include "private.h"
+
+static inline size_t tableBytes(size_t capacity) {
+	size_t indexCapacity = KRK_INDEX_CAPACITY(capacity);
+	return (sizeof(KrkTableEntry) + sizeof(uint32_t)) * capacity + krk_indexWidth(indexCapacity) * indexCapacity;
+}
+
+/* Each entry's hash is kept beside it, so probes and resizes don't need to hash keys again. */
+#define TABLE_HASHES(table) ((uint32_t*)((table)->entries + (table)->capacity))
+#define TABLE_INDEX(table)  ((void*)(TABLE_HASHES(table) + (table)->capacity))
 
 void krk_initTable(KrkTable * table) {
 	table->count = 0;
+	table->used = 0;
 	table->capacity = 0;
+	table->tombstones = 0;
 	table->entries = NULL;
+	table->version = 0;
+	table->owner = NULL;
 }
 
 void krk_freeTable(KrkTable * table) {
-	FREE_ARRAY(KrkTableEntry, table->entries, table->capacity);
+	if (table->capacity) FREE_ARRAY(char, table->entries, tableBytes(table->capacity));
+	KrkObj * owner = table->owner;
 	krk_initTable(table);
+	table->owner = owner;
+}
+
+_noexport
+size_t krk_tableBytes(KrkTable * table) {
+	return table->capacity ? tableBytes(table->capacity) : 0;
 }
 
 inline int krk_hashValue(KrkValue value, uint32_t *hashOut) {
@@ -36,6 +56,10 @@ inline int krk_hashValue(KrkValue value, uint32_t *hashOut) {
 				*hashOut = AS_OBJECT(value)->hash;
 				return 0;
 			}
+			if (IS_STRING(value)) {
+				*hashOut = krk_stringHashSlow(AS_STRING(value));
+				return 0;
+			}
 			break;
 		default:
 			*hashOut = (uint32_t)AS_FLOATING(value);
@@ -59,26 +83,78 @@ _unhashable:
 	return 1;
 }
 
-KrkTableEntry * krk_findEntry(KrkTableEntry * entries, size_t capacity, KrkValue key) {
-	uint32_t index;
-	if (krk_hashValue(key, &index)) {
-		return NULL;
+/*
+ * The probe loops are written once against a width that is a constant
+ * at each call site, so each width gets a loop without a switch in it.
+ */
+static inline ssize_t probe(KrkTable * table, KrkValue key, uint32_t hash, size_t * slotOut, size_t width) {
+	uint32_t * hashes = TABLE_HASHES(table);
+	void * index = TABLE_INDEX(table);
+	size_t mask = KRK_INDEX_CAPACITY(table->capacity) - 1;
+	size_t slot = hash & mask;
+	size_t free = SIZE_MAX;
+	for (;;) {
+		ssize_t position = krk_indexGet(index, width, slot);
+		if (position == KRK_INDEX_EMPTY) {
+			if (slotOut) *slotOut = free != SIZE_MAX ? free : slot;
+			return KRK_INDEX_EMPTY;
+		} else if (position == KRK_INDEX_DELETED) {
+			if (free == SIZE_MAX) free = slot;
+		} else if (hashes[position] == hash &&
+		           (table->entries[position].key == key || krk_valuesEqual(table->entries[position].key, key))) {
+			/* Keys with different hashes can't be equal, so __eq__ is only called on a real collision. */
+			if (slotOut) *slotOut = slot;
+			return position;
+		}
+		slot = (slot + 1) & mask;
+	}
+}
+
+/**
+ * Find where @p key, whose hash is @p hash, is in the index. Returns its
+ * position in the entries, or KRK_INDEX_EMPTY if it isn't there, in which
+ * case @p slotOut is where it should be added.
+ */
+static ssize_t lookup(KrkTable * table, KrkValue key, uint32_t hash, size_t * slotOut) {
+	switch (krk_indexWidth(KRK_INDEX_CAPACITY(table->capacity))) {
+		case 1: return probe(table, key, hash, slotOut, 1);
+		case 2: return probe(table, key, hash, slotOut, 2);
+		case 4: return probe(table, key, hash, slotOut, 4);
+		default: return probe(table, key, hash, slotOut, 8);
 	}
-	index &= (capacity-1);
-	KrkTableEntry * tombstone = NULL;
+}
+
+KrkTableEntry * krk_findEntry(KrkTable * table, KrkValue key) {
+	if (table->count == 0) return NULL;
+	uint32_t hash;
+	if (krk_hashValue(key, &hash)) return NULL;
+	ssize_t position = lookup(table, key, hash, NULL);
+	return position >= 0 ? &table->entries[position] : NULL;
+}
+
+static inline KrkTableEntry * probeString(KrkTable * table, KrkString * str, size_t width) {
+	void * index = TABLE_INDEX(table);
+	size_t mask = KRK_INDEX_CAPACITY(table->capacity) - 1;
+	size_t slot = krk_stringHash(str) & mask;
 	for (;;) {
-		KrkTableEntry * entry = &entries[index];
-		if (IS_KWARGS(entry->key)) {
-			if (IS_NONE(entry->value)) {
-				return tombstone != NULL ? tombstone : entry;
-			} else {
-				if (tombstone == entry) return tombstone;
-				if (tombstone == NULL) tombstone = entry;
-			}
-		} else if (krk_valuesEqual(entry->key, key)) {
-			return entry;
+		ssize_t position = krk_indexGet(index, width, slot);
+		if (position == KRK_INDEX_EMPTY) return NULL;
+		if (position >= 0) {
+			KrkTableEntry * entry = &table->entries[position];
+			if (IS_STRING(entry->key) && krk_stringsEqual(AS_STRING(entry->key), str)) return entry;
 		}
-		index = (index + 1) & (capacity-1);
+		slot = (slot + 1) & mask;
+	}
+}
+
+KrkTableEntry * krk_findEntry_fast(KrkTable * table, KrkString * str) {
+	if (unlikely(table->count == 0)) return NULL;
+	/* Attribute tables are nearly always small enough for byte-wide slots. */
+	if (likely(KRK_INDEX_CAPACITY(table->capacity) <= KRK_INDEX_CAPACITY_BYTES)) return probeString(table, str, 1);
+	switch (krk_indexWidth(KRK_INDEX_CAPACITY(table->capacity))) {
+		case 2: return probeString(table, str, 2);
+		case 4: return probeString(table, str, 4);
+		default: return probeString(table, str, 8);
 	}
 }
 
@@ -90,110 +166,164 @@ int __builtin_clz(unsigned int x) {
 }
 #endif
 
+_noexport
+size_t krk_indexCapacityFor(size_t capacity) {
+	if (!capacity) return 0;
+	/* Fast power-of-two calculation, for an index at least 4/3 the number of entries */
+	size_t needed = capacity + (capacity + 2) / 3;
+	if (needed < 4) needed = 4;
+	size_t powerOfTwoCapacity = __builtin_clz(1) - __builtin_clz(needed);
+	if ((1UL << powerOfTwoCapacity) != needed) powerOfTwoCapacity++;
+	return (1UL << powerOfTwoCapacity);
+}
+
 void krk_tableAdjustCapacity(KrkTable * table, size_t capacity) {
-	if (capacity) {
-		/* Fast power-of-two calculation */
-		size_t powerOfTwoCapacity = __builtin_clz(1) - __builtin_clz(capacity);
-		if ((1UL << powerOfTwoCapacity) != capacity) powerOfTwoCapacity++;
-		capacity = (1UL << powerOfTwoCapacity);
-	}
+	if (capacity < table->count) capacity = table->count;
+	size_t indexCapacity = krk_indexCapacityFor(capacity);
+	capacity = indexCapacity / 4 * 3;
 
-	KrkTableEntry * entries = ALLOCATE(KrkTableEntry, capacity);
+	KrkTableEntry * entries = capacity ? (KrkTableEntry*)ALLOCATE(char, tableBytes(capacity)) : NULL;
 	for (size_t i = 0; i < capacity; ++i) {
 		entries[i].key = KWARGS_VAL(0);
 		entries[i].value = NONE_VAL();
 	}
+	uint32_t * hashes = (uint32_t*)(entries + capacity);
+	void * index = hashes + capacity;
+	size_t width = krk_indexWidth(indexCapacity);
+	if (indexCapacity) memset(index, 0xFF, width * indexCapacity);
 
-	table->count = 0;
-	for (size_t i = 0; i < table->capacity; ++i) {
+	/* Live entries keep their order; the holes left by deleted ones are squeezed out. */
+	size_t count = 0;
+	for (size_t i = 0; i < table->used; ++i) {
 		KrkTableEntry * entry = &table->entries[i];
 		if (IS_KWARGS(entry->key)) continue;
-		KrkTableEntry * dest = krk_findEntry(entries, capacity, entry->key);
-		dest->key = entry->key;
-		dest->value = entry->value;
-		table->count++;
+		uint32_t hash = TABLE_HASHES(table)[i];
+		size_t slot = hash & (indexCapacity - 1);
+		while (krk_indexGet(index, width, slot) != KRK_INDEX_EMPTY) slot = (slot + 1) & (indexCapacity - 1);
+		krk_indexSet(index, width, slot, count);
+		hashes[count] = hash;
+		entries[count++] = *entry;
 	}
 
-	FREE_ARRAY(KrkTableEntry, table->entries, table->capacity);
+	if (table->capacity) FREE_ARRAY(char, table->entries, tableBytes(table->capacity));
 	table->entries = entries;
 	table->capacity = capacity;
+	table->count = count;
+	table->used = count;
+	table->tombstones = 0;
+	table->version++;
 }
 
-int krk_tableSet(KrkTable * table, KrkValue key, KrkValue value) {
-	if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
-		size_t capacity = GROW_CAPACITY(table->capacity);
-		krk_tableAdjustCapacity(table, capacity);
+static int tableSetWithHash(KrkTable * table, KrkValue key, uint32_t hash, KrkValue value) {
+	size_t slot = 0;
+	ssize_t position = table->capacity ? lookup(table, key, hash, &slot) : KRK_INDEX_EMPTY;
+	int isNewKey = position == KRK_INDEX_EMPTY;
+	if (isNewKey) {
+		/*
+		 * Only adding an entry resizes the table, so replacing a value leaves iterators alone.
+		 * Deleted slots count towards the load, or a table that sees a lot of deletions ends up with no empty slots.
+		 */
+		if (table->used == table->capacity || table->count + table->tombstones >= table->capacity) {
+			/* If most of that is deleted entries, squeezing them out is enough. */
+			size_t capacity = (table->count + 1 > table->capacity / 2) ? (table->capacity ? table->capacity * 2 : 1) : table->capacity;
+			krk_tableAdjustCapacity(table, capacity);
+			/* The key isn't there, and a fresh index has no deleted slots, so it goes in the first empty one. */
+			size_t mask = KRK_INDEX_CAPACITY(table->capacity) - 1;
+			size_t width = krk_indexWidth(mask + 1);
+			for (slot = hash & mask; krk_indexGet(TABLE_INDEX(table), width, slot) != KRK_INDEX_EMPTY; slot = (slot + 1) & mask);
+		}
+		if (krk_indexGet(TABLE_INDEX(table), krk_indexWidth(KRK_INDEX_CAPACITY(table->capacity)), slot) == KRK_INDEX_DELETED) table->tombstones--;
+		position = table->used++;
+		krk_indexSet(TABLE_INDEX(table), krk_indexWidth(KRK_INDEX_CAPACITY(table->capacity)), slot, position);
+		TABLE_HASHES(table)[position] = hash;
+		table->count++;
+		table->version++;
 	}
-	KrkTableEntry * entry = krk_findEntry(table->entries, table->capacity, key);
-	if (!entry) return 0;
-	int isNewKey = IS_KWARGS(entry->key);
-	if (isNewKey) table->count++;
+	KrkTableEntry * entry = &table->entries[position];
 	entry->key = key;
 	entry->value = value;
+	if (table->owner && (IS_OBJECT(key) || IS_OBJECT(value))) krk_gcWriteBarrier(table->owner);
 	return isNewKey;
 }
 
+int krk_tableSet(KrkTable * table, KrkValue key, KrkValue value) {
+	uint32_t hash;
+	if (krk_hashValue(key, &hash)) return 0;
+	return tableSetWithHash(table, key, hash, value);
+}
+
 void krk_tableAddAll(KrkTable * from, KrkTable * to) {
-	for (size_t i = 0; i < from->capacity; ++i) {
+	/* The hashes come along with the entries, so keys with a __hash__ aren't hashed again. */
+	for (size_t i = 0; i < from->used; ++i) {
 		KrkTableEntry * entry = &from->entries[i];
 		if (!IS_KWARGS(entry->key)) {
-			krk_tableSet(to, entry->key, entry->value);
+			tableSetWithHash(to, entry->key, TABLE_HASHES(from)[i], entry->value);
 		}
 	}
 }
 
 int krk_tableGet(KrkTable * table, KrkValue key, KrkValue * value) {
-	if (table->count == 0) return 0;
-	KrkTableEntry * entry = krk_findEntry(table->entries, table->capacity, key);
-	if (!entry || IS_KWARGS(entry->key)) {
-		return 0;
-	} else {
-		*value = entry->value;
-		return 1;
-	}
+	KrkTableEntry * entry = krk_findEntry(table, key);
+	if (!entry) return 0;
+	*value = entry->value;
+	return 1;
 }
 
 int krk_tableGet_fast(KrkTable * table, KrkString * str, KrkValue * value) {
-	if (unlikely(table->count == 0)) return 0;
-	uint32_t index = str->obj.hash & (table->capacity-1);
-	for (;;) {
-		KrkTableEntry * entry = &table->entries[index];
-		if (IS_KWARGS(entry->key)) return 0;
-		if (IS_OBJECT(entry->key) && AS_OBJECT(entry->key) == (KrkObj*)str) {
-			*value = entry->value;
-			return 1;
-		}
-		index = (index + 1) & (table->capacity-1);
-	}
+	KrkTableEntry * entry = krk_findEntry_fast(table, str);
+	if (!entry) return 0;
+	*value = entry->value;
+	return 1;
 }
 
 int krk_tableDelete(KrkTable * table, KrkValue key) {
 	if (table->count == 0) return 0;
-	KrkTableEntry * entry = krk_findEntry(table->entries, table->capacity, key);
-	if (!entry || IS_KWARGS(entry->key)) {
-		return 0;
+	uint32_t hash;
+	if (krk_hashValue(key, &hash)) return 0;
+	size_t slot;
+	ssize_t position = lookup(table, key, hash, &slot);
+	if (position < 0) return 0;
+	void * index = TABLE_INDEX(table);
+	size_t width = krk_indexWidth(KRK_INDEX_CAPACITY(table->capacity));
+	size_t mask = KRK_INDEX_CAPACITY(table->capacity) - 1;
+	if (krk_indexGet(index, width, (slot + 1) & mask) == KRK_INDEX_EMPTY) {
+		/* No probe continues past this slot, so it - and any deleted slots leading up to it - can be emptied. */
+		krk_indexSet(index, width, slot, KRK_INDEX_EMPTY);
+		for (slot = (slot - 1) & mask; krk_indexGet(index, width, slot) == KRK_INDEX_DELETED; slot = (slot - 1) & mask) {
+			krk_indexSet(index, width, slot, KRK_INDEX_EMPTY);
+			table->tombstones--;
+		}
+	} else {
+		krk_indexSet(index, width, slot, KRK_INDEX_DELETED);
+		table->tombstones++;
 	}
 	table->count--;
-	entry->key = KWARGS_VAL(0);
-	entry->value = KWARGS_VAL(0);
+	table->version++;
+	table->entries[position].key = KWARGS_VAL(0);
+	table->entries[position].value = NONE_VAL();
+	/* Deleting from the end, as popitem does, frees the entry for reuse. */
+	while (table->used && IS_KWARGS(table->entries[table->used-1].key)) table->used--;
 	return 1;
 }
 
 KrkString * krk_tableFindString(KrkTable * table, const char * chars, size_t length, uint32_t hash) {
 	if (table->count == 0) return NULL;
 
-	uint32_t index = hash & (table->capacity-1);
+	uint32_t * hashes = TABLE_HASHES(table);
+	void * index = TABLE_INDEX(table);
+	size_t width = krk_indexWidth(KRK_INDEX_CAPACITY(table->capacity));
+	size_t mask = KRK_INDEX_CAPACITY(table->capacity) - 1;
+	size_t slot = hash & mask;
 	for (;;) {
-		KrkTableEntry * entry = &table->entries[index];
-		if (IS_KWARGS(entry->key)) {
-			if (IS_NONE(entry->value)) {
-				return NULL;
+		ssize_t position = krk_indexGet(index, width, slot);
+		if (position == KRK_INDEX_EMPTY) return NULL;
+		if (position >= 0 && hashes[position] == hash) {
+			KrkTableEntry * entry = &table->entries[position];
+			if (AS_STRING(entry->key)->length == length &&
+			    memcmp(AS_STRING(entry->key)->chars, chars, length) == 0) {
+				return AS_STRING(entry->key);
 			}
-		} else if (AS_STRING(entry->key)->length == length &&
-		           AS_OBJECT(entry->key)->hash == hash &&
-		           memcmp(AS_STRING(entry->key)->chars, chars, length) == 0) {
-			return AS_STRING(entry->key);
 		}
-		index = (index + 1) & (table->capacity-1);
+		slot = (slot + 1) & mask;
 	}
 }
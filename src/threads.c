@@ -4,8 +4,14 @@
 
 #ifdef ENABLE_THREADING
 #include <kuroko/util.h>
+#include <kuroko/threads.h>
 
+#include "private.h"
+#include "probes.h"
+
+#include <errno.h>
 #include <unistd.h>
+#include <time.h>
 #include <pthread.h>
 
 #if defined(__linux__)
@@ -19,8 +25,10 @@
 # define gettid() -1
 #endif
 
-static KrkClass * ThreadError;
-static KrkClass * Thread;
+static KrkVMLocal threadErrorKey;
+#define ThreadError KRK_VM_LOCAL(KrkClass*,threadErrorKey)
+static KrkVMLocal threadKey;
+#define ThreadClass KRK_VM_LOCAL(KrkClass*,threadKey)
 
 /**
  * @brief Object representation of a system thread.
@@ -35,13 +43,15 @@ static KrkClass * Thread;
 struct Thread {
 	KrkInstance inst;
 	KrkThreadState * threadState;
+	KrkVM * owner;
 	pthread_t nativeRef;
 	pid_t  tid;
 	unsigned int    started:1;
 	unsigned int    alive:1;
 };
 
-static KrkClass * Lock;
+static KrkVMLocal lockKey;
+#define LockClass KRK_VM_LOCAL(KrkClass*,lockKey)
 
 /**
  * @brief Simple atomic structure for waiting.
@@ -52,6 +62,7 @@ static KrkClass * Lock;
 struct Lock {
 	KrkInstance inst;
 	pthread_mutex_t mutex;
+	KrkThreadState * owner;
 };
 
 KRK_FUNC(current_thread,{
@@ -59,31 +70,28 @@ KRK_FUNC(current_thread,{
 	return krk_currentThread.stack[0];
 })
 
-#define IS_Thread(o)  (krk_isInstanceOf(o, Thread))
+#define IS_Thread(o)  (krk_isInstanceOf(o, ThreadClass))
 #define AS_Thread(o)  ((struct Thread *)AS_OBJECT(o))
 #define CURRENT_CTYPE struct Thread *
 #define CURRENT_NAME  self
 
-static volatile int _threadLock = 0;
 static void * _startthread(void * _threadObj) {
 #if defined(ENABLE_THREADING) && defined(__APPLE__) && defined(__aarch64__)
 	krk_forceThreadData();
 #endif
+	/* Keep our thread object alive until it is on our stack. */
+	struct Thread * self = _threadObj;
 	memset(&krk_currentThread, 0, sizeof(KrkThreadState));
-	krk_currentThread.frames = calloc(vm.maximumCallDepth,sizeof(KrkCallFrame));
-	vm.globalFlags |= KRK_GLOBAL_THREADS;
-	_obtain_lock(_threadLock);
-	if (vm.threads->next) {
-		krk_currentThread.next = vm.threads->next;
-	}
-	vm.threads->next = &krk_currentThread;
-	_release_lock(_threadLock);
+	krk_currentThread.owner = self->owner;
+	krk_reserveFrames(&krk_currentThread, vm.maximumCallDepth);
 
-	/* Get our run function */
-	struct Thread * self = _threadObj;
-	self->threadState = &krk_currentThread;
+	krk_currentThread.scratchSpace[0] = OBJECT_VAL(self);
+	krk_attachThread();
 	self->tid = gettid();
+	__atomic_store_n(&self->threadState, &krk_currentThread, __ATOMIC_RELEASE);
+	if (KRK_PROBE_ENABLED(thread__start)) KRK_PROBE(thread__start, (int)self->tid);
 
+	/* Get our run function */
 	KrkValue runMethod = NONE_VAL();
 	KrkClass * ourType = self->inst._class;
 	if (!krk_tableGet(&ourType->methods, OBJECT_VAL(S("run")), &runMethod)) {
@@ -91,26 +99,22 @@ static void * _startthread(void * _threadObj) {
 	} else {
 		krk_push(runMethod);
 		krk_push(OBJECT_VAL(self));
+		krk_currentThread.scratchSpace[0] = NONE_VAL();
 		krk_callStack(1);
 	}
 
+	if (KRK_PROBE_ENABLED(thread__stop)) KRK_PROBE(thread__stop, (int)self->tid);
 	self->alive = 0;
 
 	/* Remove this thread from the thread pool, its stack is garbage anyway */
-	_obtain_lock(_threadLock);
 	krk_resetStack();
-	KrkThreadState * previous = vm.threads;
-	while (previous) {
-		if (previous->next == &krk_currentThread) {
-			previous->next = krk_currentThread.next;
-			break;
-		}
-		previous = previous->next;
-	}
-	_release_lock(_threadLock);
-
+	krk_currentThread.scratchSpace[0] = NONE_VAL();
 	FREE_ARRAY(size_t, krk_currentThread.stack, krk_currentThread.stackSize);
-	free(krk_currentThread.frames);
+	krk_currentThread.stack = NULL;
+	krk_currentThread.stackTop = NULL;
+	krk_detachThread();
+
+	krk_releaseFrames(&krk_currentThread);
 
 	return NULL;
 }
@@ -126,7 +130,9 @@ KRK_METHOD(Thread,join,{
 	if (!self->started)
 		return krk_runtimeError(ThreadError, "Thread has not been started.");
 
+	krk_beginBlocking();
 	pthread_join(self->nativeRef, NULL);
+	krk_endBlocking();
 })
 
 KRK_METHOD(Thread,start,{
@@ -137,8 +143,15 @@ KRK_METHOD(Thread,start,{
 
 	self->started = 1;
 	self->alive   = 1;
+	self->owner   = &vm;
+	vm.globalFlags |= KRK_GLOBAL_THREADS;
 	pthread_create(&self->nativeRef, NULL, _startthread, (void*)self);
 
+	/* Nothing else holds on to the thread object until the new thread has registered itself. */
+	krk_beginBlocking();
+	while (!__atomic_load_n(&self->threadState, __ATOMIC_ACQUIRE)) sched_yield();
+	krk_endBlocking();
+
 	return argv[0];
 })
 
@@ -149,7 +162,7 @@ KRK_METHOD(Thread,is_alive,{
 
 #undef CURRENT_CTYPE
 
-#define IS_Lock(o)  (krk_isInstanceOf(o, Lock))
+#define IS_Lock(o)  (krk_isInstanceOf(o, LockClass))
 #define AS_Lock(o)  ((struct Lock *)AS_OBJECT(o))
 #define CURRENT_CTYPE struct Lock *
 
@@ -192,15 +205,1194 @@ KRK_METHOD(Lock,__repr__,{
 	return finishStringBuilder(&sb);
 })
 
+int krk_parseTimeout(KrkValue timeout, struct timespec * until) {
+	if (IS_NONE(timeout)) return 0;
+	double seconds;
+	if (IS_INTEGER(timeout)) seconds = AS_INTEGER(timeout);
+	else if (IS_FLOATING(timeout)) seconds = AS_FLOATING(timeout);
+	else {
+		krk_runtimeError(vm.exceptions->typeError, "timeout must be a number or None, not '%s'", krk_typeName(timeout));
+		return -1;
+	}
+	if (!(seconds >= 0)) {
+		krk_runtimeError(vm.exceptions->valueError, "timeout must be a non-negative number");
+		return -1;
+	}
+	clock_gettime(CLOCK_REALTIME, until);
+	double whole = (double)(time_t)seconds;
+	until->tv_sec += (time_t)whole;
+	until->tv_nsec += (long)((seconds - whole) * 1e9);
+	if (until->tv_nsec >= 1000000000) {
+		until->tv_sec += 1;
+		until->tv_nsec -= 1000000000;
+	}
+	return 1;
+}
+
+/** The positional argument at @p index, or else the keyword argument @p name, or else @p fallback. */
+static KrkValue optionalArg(int argc, const KrkValue argv[], int hasKw, int index, const char * name, KrkValue fallback) {
+	if (index < argc) return argv[index];
+	if (hasKw) krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(krk_copyString(name, strlen(name))), &fallback);
+	return fallback;
+}
+
+/**
+ * Wait on @p cond, until @p until if @p timed is set. The caller must hold
+ * @p mutex and be in a blocking section. Returns non-zero on a timeout.
+ */
+static int waitOn(pthread_cond_t * cond, pthread_mutex_t * mutex, int timed, struct timespec * until) {
+	if (timed) return pthread_cond_timedwait(cond, mutex, until) == ETIMEDOUT;
+	pthread_cond_wait(cond, mutex);
+	return 0;
+}
+
+static int lockUntil(pthread_mutex_t * mutex, struct timespec * until) {
+#ifdef __APPLE__
+	/* There is no pthread_mutex_timedlock, so try again every millisecond until the deadline. */
+	while (pthread_mutex_trylock(mutex)) {
+		struct timespec now;
+		clock_gettime(CLOCK_REALTIME, &now);
+		if (now.tv_sec > until->tv_sec || (now.tv_sec == until->tv_sec && now.tv_nsec >= until->tv_nsec)) return ETIMEDOUT;
+		struct timespec pause = {0, 1000000};
+		nanosleep(&pause, NULL);
+	}
+	return 0;
+#else
+	return pthread_mutex_timedlock(mutex, until);
+#endif
+}
+
+/**
+ * Acquire @p self for the current thread, blocking as a safepoint if another
+ * thread holds it. Returns 0 if @p blocking is not set and it was held, or on a timeout.
+ */
+static int acquireLock(struct Lock * self, int blocking, int timed, struct timespec * until) {
+	if (pthread_mutex_trylock(&self->mutex)) {
+		if (!blocking) return 0;
+		krk_beginBlocking();
+		int status = timed ? lockUntil(&self->mutex, until) : pthread_mutex_lock(&self->mutex);
+		krk_endBlocking();
+		if (status) return 0;
+	}
+	self->owner = &krk_currentThread;
+	return 1;
+}
+
 KRK_METHOD(Lock,__enter__,{
 	METHOD_TAKES_NONE();
-	pthread_mutex_lock(&self->mutex);
+	acquireLock(self, 1, 0, NULL);
 })
 
 KRK_METHOD(Lock,__exit__,{
+	if (self->owner != &krk_currentThread) return krk_runtimeError(ThreadError, "Lock is not held by this thread.");
+	self->owner = NULL;
+	pthread_mutex_unlock(&self->mutex);
+})
+
+KRK_METHOD(Lock,acquire,{
+	METHOD_TAKES_AT_MOST(2);
+	int blocking = !krk_isFalsey(optionalArg(argc, argv, hasKw, 1, "blocking", BOOLEAN_VAL(1)));
+	struct timespec until;
+	int timed = krk_parseTimeout(optionalArg(argc, argv, hasKw, 2, "timeout", NONE_VAL()), &until);
+	if (timed < 0) return NONE_VAL();
+	if (self->owner == &krk_currentThread) return krk_runtimeError(ThreadError, "Lock is already held by this thread.");
+	return BOOLEAN_VAL(acquireLock(self, blocking, timed, &until));
+})
+
+KRK_METHOD(Lock,release,{
+	METHOD_TAKES_NONE();
+	return FUNC_NAME(Lock,__exit__)(1, argv, 0);
+})
+
+KRK_METHOD(Lock,locked,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(__atomic_load_n(&self->owner, __ATOMIC_RELAXED) != NULL);
+})
+
+#undef CURRENT_CTYPE
+
+static KrkVMLocal conditionKey;
+#define ConditionClass KRK_VM_LOCAL(KrkClass*,conditionKey)
+
+/**
+ * @brief A condition variable, waited on while holding a @ref Lock
+ * @extends KrkInstance
+ */
+struct Condition {
+	KrkInstance inst;
+	struct Lock * lock;
+	pthread_cond_t cond;
+};
+
+#define IS_Condition(o)  (krk_isInstanceOf(o, ConditionClass))
+#define AS_Condition(o)  ((struct Condition *)AS_OBJECT(o))
+#define CURRENT_CTYPE struct Condition *
+
+static void _condition_gcscan(KrkInstance * _self) {
+	krk_markObject((KrkObj*)((struct Condition*)_self)->lock);
+}
+
+KRK_METHOD(Condition,__init__,{
+	METHOD_TAKES_AT_MOST(1);
+	KrkValue lock = optionalArg(argc, argv, hasKw, 1, "lock", NONE_VAL());
+	if (IS_NONE(lock)) {
+		lock = OBJECT_VAL(krk_newInstance(LockClass));
+		pthread_mutex_init(&AS_Lock(lock)->mutex, NULL);
+	} else if (!IS_Lock(lock)) {
+		return TYPE_ERROR(Lock,lock);
+	}
+	self->lock = AS_Lock(lock);
+	krk_gcWriteBarrier((KrkObj*)self);
+	pthread_cond_init(&self->cond, NULL);
+	return argv[0];
+})
+
+KRK_METHOD(Condition,__enter__,{
+	METHOD_TAKES_NONE();
+	acquireLock(self->lock, 1, 0, NULL);
+})
+
+KRK_METHOD(Condition,__exit__,{
+	KrkValue lock = OBJECT_VAL(self->lock);
+	return FUNC_NAME(Lock,__exit__)(1, &lock, 0);
+})
+
+/** Wait to be notified, with the lock held. Returns 0 on a timeout. */
+static int waitCondition(struct Condition * self, int timed, struct timespec * until) {
+	self->lock->owner = NULL;
+	krk_beginBlocking();
+	int timedOut = waitOn(&self->cond, &self->lock->mutex, timed, until);
+	/* Another thread may be stopping the world while we hold the lock again, but it does not need it to collect. */
+	krk_endBlocking();
+	self->lock->owner = &krk_currentThread;
+	return !timedOut;
+}
+
+KRK_METHOD(Condition,wait,{
+	METHOD_TAKES_AT_MOST(1);
+	struct timespec until;
+	int timed = krk_parseTimeout(optionalArg(argc, argv, hasKw, 1, "timeout", NONE_VAL()), &until);
+	if (timed < 0) return NONE_VAL();
+	if (self->lock->owner != &krk_currentThread) return krk_runtimeError(ThreadError, "Can not wait on a condition without holding its lock.");
+	return BOOLEAN_VAL(waitCondition(self, timed, &until));
+})
+
+KRK_METHOD(Condition,wait_for,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	struct timespec until;
+	int timed = krk_parseTimeout(optionalArg(argc, argv, hasKw, 2, "timeout", NONE_VAL()), &until);
+	if (timed < 0) return NONE_VAL();
+	if (self->lock->owner != &krk_currentThread) return krk_runtimeError(ThreadError, "Can not wait on a condition without holding its lock.");
+	size_t stackOffset = krk_currentThread.stackTop - krk_currentThread.stack;
+	KrkValue result;
+	while (1) {
+		krk_push(argv[1]);
+		result = krk_callStack(0);
+		krk_currentThread.stackTop = krk_currentThread.stack + stackOffset;
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return NONE_VAL();
+		if (!krk_isFalsey(result) || !waitCondition(self, timed, &until)) break;
+	}
+	/* The predicate may have become true as the wait timed out. */
+	if (krk_isFalsey(result)) {
+		krk_push(argv[1]);
+		result = krk_callStack(0);
+		krk_currentThread.stackTop = krk_currentThread.stack + stackOffset;
+	}
+	return result;
+})
+
+KRK_METHOD(Condition,notify,{
+	METHOD_TAKES_AT_MOST(1);
+	KrkValue count = optionalArg(argc, argv, hasKw, 1, "n", INTEGER_VAL(1));
+	if (!IS_INTEGER(count)) return TYPE_ERROR(int,count);
+	if (self->lock->owner != &krk_currentThread) return krk_runtimeError(ThreadError, "Can not notify a condition without holding its lock.");
+	for (krk_integer_type i = 0; i < AS_INTEGER(count); ++i) pthread_cond_signal(&self->cond);
+})
+
+KRK_METHOD(Condition,notify_all,{
+	METHOD_TAKES_NONE();
+	if (self->lock->owner != &krk_currentThread) return krk_runtimeError(ThreadError, "Can not notify a condition without holding its lock.");
+	pthread_cond_broadcast(&self->cond);
+})
+
+#undef CURRENT_CTYPE
+
+static KrkVMLocal semaphoreKey;
+#define SemaphoreClass KRK_VM_LOCAL(KrkClass*,semaphoreKey)
+static KrkVMLocal boundedSemaphoreKey;
+#define BoundedSemaphore KRK_VM_LOCAL(KrkClass*,boundedSemaphoreKey)
+
+/**
+ * @brief A counter that threads take from and wait on while it is zero.
+ * @extends KrkInstance
+ *
+ * Taking from and giving back to a semaphore that nothing waits on is an
+ * atomic operation on the count; the mutex is only for waiting.
+ */
+struct Semaphore {
+	KrkInstance inst;
+	long count;
+	long initial;
+	int bounded;
+	int waiters;
+	pthread_mutex_t mutex;
+	pthread_cond_t available;
+};
+
+#define IS_Semaphore(o)  (krk_isInstanceOf(o, SemaphoreClass))
+#define AS_Semaphore(o)  ((struct Semaphore *)AS_OBJECT(o))
+#define IS_BoundedSemaphore(o)  (krk_isInstanceOf(o, BoundedSemaphore))
+#define AS_BoundedSemaphore(o)  ((struct Semaphore *)AS_OBJECT(o))
+#define CURRENT_CTYPE struct Semaphore *
+
+static int takeSemaphore(struct Semaphore * self) {
+	long count = __atomic_load_n(&self->count, __ATOMIC_SEQ_CST);
+	while (count > 0) {
+		if (__atomic_compare_exchange_n(&self->count, &count, count - 1, 1, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) return 1;
+	}
+	return 0;
+}
+
+KRK_METHOD(Semaphore,__init__,{
+	METHOD_TAKES_AT_MOST(1);
+	KrkValue value = optionalArg(argc, argv, hasKw, 1, "value", INTEGER_VAL(1));
+	if (!IS_INTEGER(value)) return TYPE_ERROR(int,value);
+	if (AS_INTEGER(value) < 0) return krk_runtimeError(vm.exceptions->valueError, "semaphore initial value must be >= 0");
+	self->count = self->initial = AS_INTEGER(value);
+	pthread_mutex_init(&self->mutex, NULL);
+	pthread_cond_init(&self->available, NULL);
+	return argv[0];
+})
+
+KRK_METHOD(Semaphore,acquire,{
+	METHOD_TAKES_AT_MOST(2);
+	int blocking = !krk_isFalsey(optionalArg(argc, argv, hasKw, 1, "blocking", BOOLEAN_VAL(1)));
+	struct timespec until;
+	int timed = krk_parseTimeout(optionalArg(argc, argv, hasKw, 2, "timeout", NONE_VAL()), &until);
+	if (timed < 0) return NONE_VAL();
+	while (!takeSemaphore(self)) {
+		if (!blocking) return BOOLEAN_VAL(0);
+		int timedOut = 0;
+		krk_beginBlocking();
+		pthread_mutex_lock(&self->mutex);
+		/* A release after this sees us waiting; one before it left a count for us to see. */
+		__atomic_add_fetch(&self->waiters, 1, __ATOMIC_SEQ_CST);
+		if (!__atomic_load_n(&self->count, __ATOMIC_SEQ_CST)) timedOut = waitOn(&self->available, &self->mutex, timed, &until);
+		__atomic_sub_fetch(&self->waiters, 1, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&self->mutex);
+		krk_endBlocking();
+		if (timedOut) return BOOLEAN_VAL(takeSemaphore(self));
+	}
+	return BOOLEAN_VAL(1);
+})
+
+KRK_METHOD(Semaphore,release,{
+	METHOD_TAKES_AT_MOST(1);
+	KrkValue n = optionalArg(argc, argv, hasKw, 1, "n", INTEGER_VAL(1));
+	if (!IS_INTEGER(n)) return TYPE_ERROR(int,n);
+	if (AS_INTEGER(n) < 1) return krk_runtimeError(vm.exceptions->valueError, "n must be one or more");
+	long count = __atomic_load_n(&self->count, __ATOMIC_SEQ_CST);
+	do {
+		if (self->bounded && count + AS_INTEGER(n) > self->initial) {
+			return krk_runtimeError(vm.exceptions->valueError, "Semaphore released too many times");
+		}
+	} while (!__atomic_compare_exchange_n(&self->count, &count, count + AS_INTEGER(n), 1, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+	if (__atomic_load_n(&self->waiters, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&self->mutex);
+		for (krk_integer_type i = 0; i < AS_INTEGER(n); ++i) pthread_cond_signal(&self->available);
+		pthread_mutex_unlock(&self->mutex);
+	}
+})
+
+KRK_METHOD(Semaphore,__enter__,{
+	METHOD_TAKES_NONE();
+	FUNC_NAME(Semaphore,acquire)(1, argv, 0);
+})
+
+KRK_METHOD(Semaphore,__exit__,{
+	return FUNC_NAME(Semaphore,release)(1, argv, 0);
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct Semaphore *
+
+KRK_METHOD(BoundedSemaphore,__init__,{
+	self->bounded = 1;
+	return FUNC_NAME(Semaphore,__init__)(argc, argv, hasKw);
+})
+
+#undef CURRENT_CTYPE
+
+static KrkVMLocal eventKey;
+#define EventClass KRK_VM_LOCAL(KrkClass*,eventKey)
+
+/**
+ * @brief A flag that threads can wait to be set.
+ * @extends KrkInstance
+ */
+struct Event {
+	KrkInstance inst;
+	int flag;
+	pthread_mutex_t mutex;
+	pthread_cond_t changed;
+};
+
+#define IS_Event(o)  (krk_isInstanceOf(o, EventClass))
+#define AS_Event(o)  ((struct Event *)AS_OBJECT(o))
+#define CURRENT_CTYPE struct Event *
+
+KRK_METHOD(Event,__init__,{
+	METHOD_TAKES_NONE();
+	pthread_mutex_init(&self->mutex, NULL);
+	pthread_cond_init(&self->changed, NULL);
+	return argv[0];
+})
+
+KRK_METHOD(Event,is_set,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(__atomic_load_n(&self->flag, __ATOMIC_ACQUIRE));
+})
+
+KRK_METHOD(Event,set,{
+	METHOD_TAKES_NONE();
+	pthread_mutex_lock(&self->mutex);
+	__atomic_store_n(&self->flag, 1, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&self->changed);
+	pthread_mutex_unlock(&self->mutex);
+})
+
+KRK_METHOD(Event,clear,{
+	METHOD_TAKES_NONE();
+	pthread_mutex_lock(&self->mutex);
+	__atomic_store_n(&self->flag, 0, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&self->mutex);
+})
+
+KRK_METHOD(Event,wait,{
+	METHOD_TAKES_AT_MOST(1);
+	struct timespec until;
+	int timed = krk_parseTimeout(optionalArg(argc, argv, hasKw, 1, "timeout", NONE_VAL()), &until);
+	if (timed < 0) return NONE_VAL();
+	if (__atomic_load_n(&self->flag, __ATOMIC_ACQUIRE)) return BOOLEAN_VAL(1);
+	krk_beginBlocking();
+	pthread_mutex_lock(&self->mutex);
+	while (!self->flag) {
+		if (waitOn(&self->changed, &self->mutex, timed, &until)) break;
+	}
+	int flag = self->flag;
+	pthread_mutex_unlock(&self->mutex);
+	krk_endBlocking();
+	return BOOLEAN_VAL(flag);
+})
+
+#undef CURRENT_CTYPE
+
+static KrkVMLocal queueKey;
+#define QueueClass KRK_VM_LOCAL(KrkClass*,queueKey)
+static KrkVMLocal queueEmptyKey;
+#define QueueEmpty KRK_VM_LOCAL(KrkClass*,queueEmptyKey)
+static KrkVMLocal queueFullKey;
+#define QueueFull KRK_VM_LOCAL(KrkClass*,queueFullKey)
+
+/**
+ * @brief A first-in first-out queue for handing values between threads.
+ * @extends KrkInstance
+ *
+ * The values are in a ring buffer behind a spinlock, which is all that a put
+ * or get takes when it does not have to wait. The mutex and condition variables
+ * are only used by threads that wait for a value or for room, and by threads that
+ * have to wake them, which they know to do from the counts of waiting threads.
+ */
+struct Queue {
+	KrkInstance inst;
+	volatile int spin;
+	KrkValue * items;
+	size_t capacity;
+	size_t head;
+	size_t count;
+	size_t maxsize;
+	size_t unfinished;
+	int getters;
+	int putters;
+	pthread_mutex_t mutex;
+	pthread_cond_t notEmpty;
+	pthread_cond_t notFull;
+	pthread_cond_t allDone;
+};
+
+#define IS_Queue(o)  (krk_isInstanceOf(o, QueueClass))
+#define AS_Queue(o)  ((struct Queue *)AS_OBJECT(o))
+#define CURRENT_CTYPE struct Queue *
+
+static void _queue_gcscan(KrkInstance * _self) {
+	struct Queue * self = (struct Queue*)_self;
+	for (size_t i = 0; i < self->count; ++i) {
+		krk_markValue(self->items[(self->head + i) % self->capacity]);
+	}
+}
+
+static void _queue_gcsweep(KrkInstance * _self) {
+	free(((struct Queue*)_self)->items);
+}
+
+static int queuePut(struct Queue * self, KrkValue value) {
+	_obtain_lock(self->spin);
+	if (self->maxsize && self->count == self->maxsize) {
+		_release_lock(self->spin);
+		return 0;
+	}
+	if (self->count == self->capacity) {
+		size_t capacity = self->capacity ? self->capacity * 2 : 8;
+		KrkValue * items = malloc(sizeof(KrkValue) * capacity);
+		for (size_t i = 0; i < self->count; ++i) {
+			items[i] = self->items[(self->head + i) % self->capacity];
+		}
+		free(self->items);
+		self->items = items;
+		self->capacity = capacity;
+		self->head = 0;
+	}
+	self->items[(self->head + self->count) % self->capacity] = value;
+	__atomic_store_n(&self->count, self->count + 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&self->unfinished, 1, __ATOMIC_RELAXED);
+	_release_lock(self->spin);
+	krk_gcWriteBarrier((KrkObj*)self);
+	return 1;
+}
+
+static int queueGet(struct Queue * self, KrkValue * out) {
+	_obtain_lock(self->spin);
+	if (!self->count) {
+		_release_lock(self->spin);
+		return 0;
+	}
+	*out = self->items[self->head];
+	self->head = (self->head + 1) % self->capacity;
+	__atomic_store_n(&self->count, self->count - 1, __ATOMIC_RELAXED);
+	_release_lock(self->spin);
+	return 1;
+}
+
+/** Wake a thread waiting on @p cond, if the count of @p waiters says there is one. */
+static void wakeWaiter(struct Queue * self, int * waiters, pthread_cond_t * cond) {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(waiters, __ATOMIC_SEQ_CST)) return;
+	pthread_mutex_lock(&self->mutex);
+	pthread_cond_signal(cond);
 	pthread_mutex_unlock(&self->mutex);
+}
+
+/**
+ * Wait on @p cond until @p ready says the queue may have changed, counting the
+ * current thread in @p waiters meanwhile. Returns non-zero on a timeout.
+ */
+static int waitForQueue(struct Queue * self, int * waiters, pthread_cond_t * cond, int (*ready)(struct Queue*), int timed, struct timespec * until) {
+	int timedOut = 0;
+	krk_beginBlocking();
+	pthread_mutex_lock(&self->mutex);
+	__atomic_add_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+	if (!ready(self)) timedOut = waitOn(cond, &self->mutex, timed, until);
+	__atomic_sub_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&self->mutex);
+	krk_endBlocking();
+	return timedOut;
+}
+
+static int queueHasItems(struct Queue * self) {
+	return __atomic_load_n(&self->count, __ATOMIC_SEQ_CST) != 0;
+}
+
+static int queueHasRoom(struct Queue * self) {
+	return !self->maxsize || __atomic_load_n(&self->count, __ATOMIC_SEQ_CST) < self->maxsize;
+}
+
+KRK_METHOD(Queue,__init__,{
+	METHOD_TAKES_AT_MOST(1);
+	KrkValue maxsize = optionalArg(argc, argv, hasKw, 1, "maxsize", INTEGER_VAL(0));
+	if (!IS_INTEGER(maxsize)) return TYPE_ERROR(int,maxsize);
+	/* As with Python, a size that is not positive means there is no limit. */
+	self->maxsize = AS_INTEGER(maxsize) > 0 ? AS_INTEGER(maxsize) : 0;
+	pthread_mutex_init(&self->mutex, NULL);
+	pthread_cond_init(&self->notEmpty, NULL);
+	pthread_cond_init(&self->notFull, NULL);
+	pthread_cond_init(&self->allDone, NULL);
+	return argv[0];
+})
+
+KRK_METHOD(Queue,put,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(3);
+	int blocking = !krk_isFalsey(optionalArg(argc, argv, hasKw, 2, "block", BOOLEAN_VAL(1)));
+	struct timespec until;
+	int timed = krk_parseTimeout(optionalArg(argc, argv, hasKw, 3, "timeout", NONE_VAL()), &until);
+	if (timed < 0) return NONE_VAL();
+	while (!queuePut(self, argv[1])) {
+		if (!blocking) return krk_runtimeError(QueueFull, "Queue is full.");
+		if (waitForQueue(self, &self->putters, &self->notFull, queueHasRoom, timed, &until)) {
+			/* There may have been room made as the wait timed out. */
+			if (queuePut(self, argv[1])) break;
+			return krk_runtimeError(QueueFull, "Queue is full.");
+		}
+	}
+	wakeWaiter(self, &self->getters, &self->notEmpty);
+})
+
+KRK_METHOD(Queue,get,{
+	METHOD_TAKES_AT_MOST(2);
+	int blocking = !krk_isFalsey(optionalArg(argc, argv, hasKw, 1, "block", BOOLEAN_VAL(1)));
+	struct timespec until;
+	int timed = krk_parseTimeout(optionalArg(argc, argv, hasKw, 2, "timeout", NONE_VAL()), &until);
+	if (timed < 0) return NONE_VAL();
+	KrkValue out;
+	while (!queueGet(self, &out)) {
+		if (!blocking) return krk_runtimeError(QueueEmpty, "Queue is empty.");
+		if (waitForQueue(self, &self->getters, &self->notEmpty, queueHasItems, timed, &until)) {
+			if (queueGet(self, &out)) break;
+			return krk_runtimeError(QueueEmpty, "Queue is empty.");
+		}
+	}
+	if (self->maxsize) wakeWaiter(self, &self->putters, &self->notFull);
+	return out;
+})
+
+KRK_METHOD(Queue,put_nowait,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!queuePut(self, argv[1])) return krk_runtimeError(QueueFull, "Queue is full.");
+	wakeWaiter(self, &self->getters, &self->notEmpty);
+})
+
+KRK_METHOD(Queue,get_nowait,{
+	METHOD_TAKES_NONE();
+	KrkValue out;
+	if (!queueGet(self, &out)) return krk_runtimeError(QueueEmpty, "Queue is empty.");
+	if (self->maxsize) wakeWaiter(self, &self->putters, &self->notFull);
+	return out;
 })
 
+KRK_METHOD(Queue,task_done,{
+	METHOD_TAKES_NONE();
+	size_t unfinished = __atomic_load_n(&self->unfinished, __ATOMIC_SEQ_CST);
+	do {
+		if (!unfinished) return krk_runtimeError(vm.exceptions->valueError, "task_done() called too many times");
+	} while (!__atomic_compare_exchange_n(&self->unfinished, &unfinished, unfinished - 1, 1, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+	if (unfinished == 1) {
+		pthread_mutex_lock(&self->mutex);
+		pthread_cond_broadcast(&self->allDone);
+		pthread_mutex_unlock(&self->mutex);
+	}
+})
+
+KRK_METHOD(Queue,join,{
+	METHOD_TAKES_NONE();
+	if (!__atomic_load_n(&self->unfinished, __ATOMIC_SEQ_CST)) return NONE_VAL();
+	krk_beginBlocking();
+	pthread_mutex_lock(&self->mutex);
+	while (__atomic_load_n(&self->unfinished, __ATOMIC_SEQ_CST)) pthread_cond_wait(&self->allDone, &self->mutex);
+	pthread_mutex_unlock(&self->mutex);
+	krk_endBlocking();
+})
+
+KRK_METHOD(Queue,qsize,{
+	METHOD_TAKES_NONE();
+	return INTEGER_VAL(__atomic_load_n(&self->count, __ATOMIC_RELAXED));
+})
+
+KRK_METHOD(Queue,empty,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(!queueHasItems(self));
+})
+
+KRK_METHOD(Queue,full,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(!queueHasRoom(self));
+})
+
+KRK_METHOD(Queue,maxsize,{
+	METHOD_TAKES_NONE();
+	return INTEGER_VAL(self->maxsize);
+})
+
+#undef CURRENT_CTYPE
+
+static KrkVMLocal futureKey;
+#define FutureClass KRK_VM_LOCAL(KrkClass*,futureKey)
+static KrkVMLocal threadPoolExecutorKey;
+#define ThreadPoolExecutorClass KRK_VM_LOCAL(KrkClass*,threadPoolExecutorKey)
+
+enum {
+	FUTURE_PENDING,
+	FUTURE_RUNNING,
+	FUTURE_FINISHED,
+	FUTURE_CANCELLED,
+};
+
+/**
+ * @brief The eventual result of a call submitted to a @ref ThreadPoolExecutor.
+ * @extends KrkInstance
+ *
+ * A future for a chunk of @c map holds the list of arguments to call its
+ * callable with one at a time, and gets the list of their results.
+ */
+struct Future {
+	KrkInstance inst;
+	KrkValue callable;
+	KrkValue args;
+	KrkValue result;
+	KrkValue exception;
+	int chunk;
+	int state;
+	pthread_mutex_t mutex;
+	pthread_cond_t finished;
+};
+
+/**
+ * @brief A deque of futures waiting to be run.
+ *
+ * A worker takes the futures it submitted itself from the back of its own
+ * queue, newest first, while idle workers steal from the front.
+ */
+struct TaskQueue {
+	pthread_mutex_t lock;
+	KrkValue * tasks;
+	size_t capacity;
+	size_t head;
+	size_t count;
+};
+
+/**
+ * @brief One of an executor's worker threads.
+ */
+struct Worker {
+	struct ThreadPoolExecutor * pool;
+	KrkVM * owner;
+	pthread_t nativeRef;
+	struct TaskQueue queue;
+};
+
+/**
+ * @brief A fixed pool of worker threads that run submitted calls.
+ * @extends KrkInstance
+ *
+ * Each worker keeps its thread state, stack, and call frames for as long as
+ * the pool runs, so a call costs a queue operation rather than a new thread.
+ */
+struct ThreadPoolExecutor {
+	KrkInstance inst;
+	struct Worker * workers;
+	size_t workerCount;
+	struct TaskQueue injector;
+	size_t running;
+	size_t queued;
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	int initialized;
+	int shutdown;
+	int joined;
+};
+
+/* The worker the current thread is, if it is one. */
+static threadLocal struct Worker * currentWorker = NULL;
+
+#define IS_Future(o)  (krk_isInstanceOf(o, FutureClass))
+#define AS_Future(o)  ((struct Future *)AS_OBJECT(o))
+#define IS_ThreadPoolExecutor(o)  (krk_isInstanceOf(o, ThreadPoolExecutorClass))
+#define AS_ThreadPoolExecutor(o)  ((struct ThreadPoolExecutor *)AS_OBJECT(o))
+
+static void _future_gcscan(KrkInstance * _self) {
+	struct Future * self = (struct Future*)_self;
+	krk_markValue(self->callable);
+	krk_markValue(self->args);
+	krk_markValue(self->result);
+	krk_markValue(self->exception);
+}
+
+static void markQueue(struct TaskQueue * queue) {
+	for (size_t i = 0; i < queue->count; ++i) {
+		krk_markValue(queue->tasks[(queue->head + i) % queue->capacity]);
+	}
+}
+
+static void _executor_gcscan(KrkInstance * _self) {
+	struct ThreadPoolExecutor * self = (struct ThreadPoolExecutor*)_self;
+	markQueue(&self->injector);
+	for (size_t i = 0; i < self->workerCount; ++i) {
+		markQueue(&self->workers[i].queue);
+	}
+}
+
+static void _executor_gcsweep(KrkInstance * _self) {
+	struct ThreadPoolExecutor * self = (struct ThreadPoolExecutor*)_self;
+	/* Workers keep their executor alive, so only the VM shutting down can free one that still has them. */
+	if (!self->initialized || __atomic_load_n(&self->running, __ATOMIC_ACQUIRE)) return;
+	free(self->injector.tasks);
+	for (size_t i = 0; i < self->workerCount; ++i) {
+		free(self->workers[i].queue.tasks);
+	}
+	free(self->workers);
+}
+
+static void pushTask(struct TaskQueue * queue, KrkValue task) {
+	pthread_mutex_lock(&queue->lock);
+	if (queue->count == queue->capacity) {
+		size_t capacity = queue->capacity ? queue->capacity * 2 : 8;
+		KrkValue * tasks = malloc(sizeof(KrkValue) * capacity);
+		for (size_t i = 0; i < queue->count; ++i) {
+			tasks[i] = queue->tasks[(queue->head + i) % queue->capacity];
+		}
+		free(queue->tasks);
+		queue->tasks = tasks;
+		queue->capacity = capacity;
+		queue->head = 0;
+	}
+	queue->tasks[(queue->head + queue->count++) % queue->capacity] = task;
+	pthread_mutex_unlock(&queue->lock);
+}
+
+static int popTask(struct TaskQueue * queue, KrkValue * out) {
+	if (!__atomic_load_n(&queue->count, __ATOMIC_RELAXED)) return 0;
+	pthread_mutex_lock(&queue->lock);
+	int found = queue->count != 0;
+	if (found) *out = queue->tasks[(queue->head + --queue->count) % queue->capacity];
+	pthread_mutex_unlock(&queue->lock);
+	return found;
+}
+
+static int stealTask(struct TaskQueue * queue, KrkValue * out) {
+	if (!__atomic_load_n(&queue->count, __ATOMIC_RELAXED)) return 0;
+	pthread_mutex_lock(&queue->lock);
+	int found = queue->count != 0;
+	if (found) {
+		*out = queue->tasks[queue->head];
+		queue->head = (queue->head + 1) % queue->capacity;
+		queue->count--;
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return found;
+}
+
+/**
+ * Take a future to run: from the back of @p self 's own queue if it is a
+ * worker of @p pool, then from the front of the queue other threads submit
+ * to, and then from the front of the first other worker's queue that has any.
+ */
+static int takeTask(struct ThreadPoolExecutor * pool, struct Worker * self, KrkValue * out) {
+	int own = self && self->pool == pool;
+	if (own && popTask(&self->queue, out)) goto _found;
+	if (stealTask(&pool->injector, out)) goto _found;
+	size_t start = own ? (size_t)(self - pool->workers) + 1 : 0;
+	for (size_t i = 0; i < pool->workerCount; ++i) {
+		struct Worker * victim = &pool->workers[(start + i) % pool->workerCount];
+		if (victim != self && stealTask(&victim->queue, out)) goto _found;
+	}
+	return 0;
+_found:
+	__atomic_sub_fetch(&pool->queued, 1, __ATOMIC_ACQ_REL);
+	return 1;
+}
+
+static void submitTask(struct ThreadPoolExecutor * pool, KrkValue task) {
+	/* Workers queue what they submit for themselves; other threads' submissions run in order. */
+	pushTask((currentWorker && currentWorker->pool == pool) ? &currentWorker->queue : &pool->injector, task);
+	krk_gcWriteBarrier((KrkObj*)pool);
+	pthread_mutex_lock(&pool->lock);
+	pool->queued++;
+	pthread_cond_signal(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void finishFuture(struct Future * self, KrkValue result, KrkValue exception) {
+	pthread_mutex_lock(&self->mutex);
+	self->result = result;
+	self->exception = exception;
+	self->callable = NONE_VAL();
+	self->args = NONE_VAL();
+	krk_gcWriteBarrier((KrkObj*)self);
+	self->state = FUTURE_FINISHED;
+	pthread_cond_broadcast(&self->finished);
+	pthread_mutex_unlock(&self->mutex);
+}
+
+/**
+ * Run the call a future was made for, on top of whatever the current
+ * thread's stack already holds, and leave the stack as it was.
+ */
+static void runTask(struct Future * self) {
+	pthread_mutex_lock(&self->mutex);
+	int pending = self->state == FUTURE_PENDING;
+	if (pending) self->state = FUTURE_RUNNING;
+	pthread_mutex_unlock(&self->mutex);
+	if (!pending) return;
+
+	size_t stackOffset = krk_currentThread.stackTop - krk_currentThread.stack;
+	size_t frameCount = krk_currentThread.frameCount;
+	KrkValue result;
+
+	if (self->chunk) {
+		krk_push(krk_list_of(0, NULL, 0));
+		KrkValueArray * items = AS_LIST(self->args);
+		for (size_t i = 0; i < items->count; ++i) {
+			krk_push(self->callable);
+			krk_push(items->values[i]);
+			KrkValue value = krk_callStack(1);
+			/* A call made with no frames below it leaves the callable behind. */
+			krk_currentThread.stackTop = krk_currentThread.stack + stackOffset + 1;
+			if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) break;
+			krk_writeValueArray(AS_LIST(krk_peek(0)), value);
+		}
+		result = krk_peek(0);
+	} else {
+		krk_push(self->callable);
+		KrkTuple * args = AS_TUPLE(self->args);
+		for (size_t i = 0; i < args->values.count; ++i) krk_push(args->values.values[i]);
+		result = krk_callStack(args->values.count);
+	}
+
+	/* An exception leaves the frames it went through behind, and nothing above us will handle it. */
+	krk_currentThread.frameCount = frameCount;
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) {
+		KrkValue exception = krk_currentThread.currentException;
+		krk_currentThread.currentException = NONE_VAL();
+		krk_currentThread.flags &= ~KRK_THREAD_HAS_EXCEPTION;
+		finishFuture(self, NONE_VAL(), exception);
+	} else {
+		finishFuture(self, result, NONE_VAL());
+	}
+	krk_currentThread.stackTop = krk_currentThread.stack + stackOffset;
+}
+
+static void * _startworker(void * _worker) {
+#if defined(ENABLE_THREADING) && defined(__APPLE__) && defined(__aarch64__)
+	krk_forceThreadData();
+#endif
+	/* The executor stays at the bottom of our stack for as long as we run. */
+	struct Worker * self = _worker;
+	memset(&krk_currentThread, 0, sizeof(KrkThreadState));
+	krk_currentThread.owner = self->owner;
+	krk_reserveFrames(&krk_currentThread, vm.maximumCallDepth);
+
+	struct ThreadPoolExecutor * pool = self->pool;
+	krk_currentThread.scratchSpace[0] = OBJECT_VAL(pool);
+	krk_attachThread();
+	currentWorker = self;
+	krk_push(OBJECT_VAL(pool));
+	krk_currentThread.scratchSpace[0] = NONE_VAL();
+	__atomic_add_fetch(&pool->running, 1, __ATOMIC_RELEASE);
+	if (KRK_PROBE_ENABLED(thread__start)) KRK_PROBE(thread__start, (int)gettid());
+
+	while (1) {
+		KrkValue task;
+		if (takeTask(pool, self, &task)) {
+			krk_push(task);
+			runTask(AS_Future(task));
+			krk_pop();
+			/* Nothing between calls reaches one of the interpreter's safepoints. */
+			if (vm.safepointRequested) krk_safepoint();
+			continue;
+		}
+		pthread_mutex_lock(&pool->lock);
+		if (!pool->queued) {
+			if (pool->shutdown) {
+				pthread_mutex_unlock(&pool->lock);
+				break;
+			}
+			krk_beginBlocking();
+			pthread_cond_wait(&pool->work, &pool->lock);
+			pthread_mutex_unlock(&pool->lock);
+			krk_endBlocking();
+		} else {
+			pthread_mutex_unlock(&pool->lock);
+		}
+	}
+
+	if (KRK_PROBE_ENABLED(thread__stop)) KRK_PROBE(thread__stop, (int)gettid());
+	currentWorker = NULL;
+	__atomic_sub_fetch(&pool->running, 1, __ATOMIC_RELEASE);
+	krk_resetStack();
+	FREE_ARRAY(size_t, krk_currentThread.stack, krk_currentThread.stackSize);
+	krk_currentThread.stack = NULL;
+	krk_currentThread.stackTop = NULL;
+	krk_detachThread();
+
+	krk_releaseFrames(&krk_currentThread);
+
+	return NULL;
+}
+
+/**
+ * Wait for @p self to finish. A worker waiting for a future of its own pool
+ * runs the pool's other futures meanwhile, so that a pool whose workers are
+ * all waiting on futures still gets to them.
+ */
+static void waitForFuture(struct Future * self, struct ThreadPoolExecutor * pool) {
+	while (__atomic_load_n(&self->state, __ATOMIC_ACQUIRE) < FUTURE_FINISHED) {
+		KrkValue task;
+		if (pool && takeTask(pool, currentWorker, &task)) {
+			krk_push(task);
+			runTask(AS_Future(task));
+			krk_pop();
+			continue;
+		}
+		krk_beginBlocking();
+		pthread_mutex_lock(&self->mutex);
+		if (self->state < FUTURE_FINISHED) {
+			if (pool) {
+				/* Something may be queued for us after we looked, so look again before long. */
+				struct timespec until;
+				clock_gettime(CLOCK_REALTIME, &until);
+				until.tv_nsec += 1000000;
+				if (until.tv_nsec >= 1000000000) {
+					until.tv_sec += 1;
+					until.tv_nsec -= 1000000000;
+				}
+				pthread_cond_timedwait(&self->finished, &self->mutex, &until);
+			} else {
+				pthread_cond_wait(&self->finished, &self->mutex);
+			}
+		}
+		pthread_mutex_unlock(&self->mutex);
+		krk_endBlocking();
+	}
+}
+
+static struct ThreadPoolExecutor * currentPool(void) {
+	return currentWorker ? currentWorker->pool : NULL;
+}
+
+/** Raise the exception @p self finished with, or return its result. */
+static KrkValue futureOutcome(struct Future * self) {
+	if (self->state == FUTURE_CANCELLED) return krk_runtimeError(ThreadError, "Future was cancelled.");
+	if (!IS_NONE(self->exception)) {
+		krk_currentThread.currentException = self->exception;
+		krk_currentThread.flags |= KRK_THREAD_HAS_EXCEPTION;
+		return NONE_VAL();
+	}
+	return self->result;
+}
+
+static struct Future * newFuture(KrkValue callable, KrkValue args, int chunk) {
+	struct Future * future = (struct Future*)krk_newInstance(FutureClass);
+	future->callable = callable;
+	future->args = args;
+	future->result = NONE_VAL();
+	future->exception = NONE_VAL();
+	future->chunk = chunk;
+	future->state = FUTURE_PENDING;
+	pthread_mutex_init(&future->mutex, NULL);
+	pthread_cond_init(&future->finished, NULL);
+	return future;
+}
+
+static size_t defaultWorkers(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	if (count > 0) return count;
+#endif
+	return 4;
+}
+
+#define CURRENT_CTYPE struct Future *
+
+KRK_METHOD(Future,__init__,{
+	return krk_runtimeError(vm.exceptions->typeError, "Futures are made by ThreadPoolExecutor.submit()");
+})
+
+KRK_METHOD(Future,result,{
+	METHOD_TAKES_NONE();
+	waitForFuture(self, currentPool());
+	return futureOutcome(self);
+})
+
+KRK_METHOD(Future,exception,{
+	METHOD_TAKES_NONE();
+	waitForFuture(self, currentPool());
+	if (self->state == FUTURE_CANCELLED) return krk_runtimeError(ThreadError, "Future was cancelled.");
+	return self->exception;
+})
+
+KRK_METHOD(Future,done,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(__atomic_load_n(&self->state, __ATOMIC_ACQUIRE) >= FUTURE_FINISHED);
+})
+
+KRK_METHOD(Future,running,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(__atomic_load_n(&self->state, __ATOMIC_ACQUIRE) == FUTURE_RUNNING);
+})
+
+KRK_METHOD(Future,cancelled,{
+	METHOD_TAKES_NONE();
+	return BOOLEAN_VAL(__atomic_load_n(&self->state, __ATOMIC_ACQUIRE) == FUTURE_CANCELLED);
+})
+
+KRK_METHOD(Future,cancel,{
+	METHOD_TAKES_NONE();
+	pthread_mutex_lock(&self->mutex);
+	int cancelled = self->state == FUTURE_PENDING || self->state == FUTURE_CANCELLED;
+	if (self->state == FUTURE_PENDING) {
+		self->state = FUTURE_CANCELLED;
+		pthread_cond_broadcast(&self->finished);
+	}
+	pthread_mutex_unlock(&self->mutex);
+	return BOOLEAN_VAL(cancelled);
+})
+
+KRK_METHOD(Future,__repr__,{
+	METHOD_TAKES_NONE();
+	static const char * states[] = {"pending", "running", "finished", "cancelled"};
+	char tmp[100];
+	size_t len = snprintf(tmp, 100, "<Future %p %s>", (void*)self, states[__atomic_load_n(&self->state, __ATOMIC_ACQUIRE)]);
+	return OBJECT_VAL(krk_copyString(tmp, len));
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct ThreadPoolExecutor *
+
+KRK_METHOD(ThreadPoolExecutor,__init__,{
+	METHOD_TAKES_AT_MOST(1);
+	KrkValue maxWorkers = argc > 1 ? argv[1] : NONE_VAL();
+	if (hasKw) krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("max_workers")), &maxWorkers);
+	size_t count = defaultWorkers();
+	if (!IS_NONE(maxWorkers)) {
+		if (!IS_INTEGER(maxWorkers)) return TYPE_ERROR(int,maxWorkers);
+		if (AS_INTEGER(maxWorkers) < 1) return krk_runtimeError(vm.exceptions->valueError, "max_workers must be greater than 0");
+		count = AS_INTEGER(maxWorkers);
+	}
+	if (self->initialized) return krk_runtimeError(ThreadError, "ThreadPoolExecutor has already been started.");
+
+	self->workers = calloc(count, sizeof(struct Worker));
+	self->workerCount = count;
+	pthread_mutex_init(&self->lock, NULL);
+	pthread_cond_init(&self->work, NULL);
+	pthread_mutex_init(&self->injector.lock, NULL);
+	self->initialized = 1;
+	vm.globalFlags |= KRK_GLOBAL_THREADS;
+
+	for (size_t i = 0; i < count; ++i) {
+		self->workers[i].pool = self;
+		self->workers[i].owner = &vm;
+		pthread_mutex_init(&self->workers[i].queue.lock, NULL);
+		pthread_create(&self->workers[i].nativeRef, NULL, _startworker, (void*)&self->workers[i]);
+	}
+
+	/* As with Thread.start, the workers hold on to the executor once they have registered. */
+	krk_beginBlocking();
+	while (__atomic_load_n(&self->running, __ATOMIC_ACQUIRE) < count) sched_yield();
+	krk_endBlocking();
+
+	return argv[0];
+})
+
+KRK_METHOD(ThreadPoolExecutor,submit,{
+	METHOD_TAKES_AT_LEAST(1);
+	if (!self->initialized) return krk_runtimeError(ThreadError, "ThreadPoolExecutor was not initialized.");
+	if (hasKw) return krk_runtimeError(vm.exceptions->typeError, "%s() does not take keyword arguments", "submit");
+	if (self->shutdown) return krk_runtimeError(ThreadError, "Can not submit to an executor that has been shut down.");
+	KrkTuple * args = krk_newTuple(argc - 2);
+	krk_push(OBJECT_VAL(args));
+	for (int i = 2; i < argc; ++i) args->values.values[args->values.count++] = argv[i];
+	struct Future * future = newFuture(argv[1], OBJECT_VAL(args), 0);
+	krk_push(OBJECT_VAL(future));
+	submitTask(self, OBJECT_VAL(future));
+	krk_pop();
+	krk_pop();
+	return OBJECT_VAL(future);
+})
+
+#define unpackArray(counter, indexer) do { \
+	for (size_t i = 0; i < counter; ++i) { \
+		krk_writeValueArray(AS_LIST(items), indexer); \
+	} \
+} while (0)
+KRK_METHOD(ThreadPoolExecutor,map,{
+	METHOD_TAKES_EXACTLY(2);
+	if (!self->initialized) return krk_runtimeError(ThreadError, "ThreadPoolExecutor was not initialized.");
+	if (self->shutdown) return krk_runtimeError(ThreadError, "Can not submit to an executor that has been shut down.");
+	KrkValue chunksize = INTEGER_VAL(1);
+	if (hasKw) krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("chunksize")), &chunksize);
+	if (!IS_INTEGER(chunksize)) return TYPE_ERROR(int,chunksize);
+	if (AS_INTEGER(chunksize) < 1) return krk_runtimeError(vm.exceptions->valueError, "chunksize must be greater than 0");
+	size_t chunkSize = AS_INTEGER(chunksize);
+
+	size_t stackOffset = krk_currentThread.stackTop - krk_currentThread.stack;
+	KrkValue results = NONE_VAL();
+	KrkValue items = krk_list_of(0, NULL, 0);
+	krk_push(items);
+	unpackIterableFast(argv[2]);
+	if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) goto _done;
+
+	/* Submit each chunk as a list of its arguments, and keep the futures on the stack. */
+	size_t count = AS_LIST(items)->count;
+	KrkValue futures = krk_list_of(0, NULL, 0);
+	krk_push(futures);
+	for (size_t start = 0; start < count; start += chunkSize) {
+		size_t length = count - start < chunkSize ? count - start : chunkSize;
+		KrkValue chunk = krk_list_of(length, &AS_LIST(items)->values[start], 0);
+		krk_push(chunk);
+		struct Future * future = newFuture(argv[1], chunk, 1);
+		krk_push(OBJECT_VAL(future));
+		krk_writeValueArray(AS_LIST(futures), OBJECT_VAL(future));
+		submitTask(self, OBJECT_VAL(future));
+		krk_pop();
+		krk_pop();
+	}
+
+	results = krk_list_of(0, NULL, 0);
+	krk_push(results);
+	for (size_t i = 0; i < AS_LIST(futures)->count; ++i) {
+		struct Future * future = AS_Future(AS_LIST(futures)->values[i]);
+		waitForFuture(future, currentPool());
+		KrkValue outcome = futureOutcome(future);
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) goto _done;
+		for (size_t j = 0; j < AS_LIST(outcome)->count; ++j) {
+			krk_writeValueArray(AS_LIST(results), AS_LIST(outcome)->values[j]);
+		}
+	}
+
+_done:
+	krk_currentThread.stackTop = krk_currentThread.stack + stackOffset;
+	return results;
+})
+#undef unpackArray
+
+KRK_METHOD(ThreadPoolExecutor,shutdown,{
+	METHOD_TAKES_AT_MOST(1);
+	int wait = 1;
+	if (argc > 1) wait = !krk_isFalsey(argv[1]);
+	if (!self->initialized || self->joined) return NONE_VAL();
+	if (currentWorker && currentWorker->pool == self) {
+		return krk_runtimeError(ThreadError, "A worker can not shut down its own executor.");
+	}
+	pthread_mutex_lock(&self->lock);
+	self->shutdown = 1;
+	pthread_cond_broadcast(&self->work);
+	pthread_mutex_unlock(&self->lock);
+	self->joined = 1;
+	if (wait) {
+		krk_beginBlocking();
+		for (size_t i = 0; i < self->workerCount; ++i) pthread_join(self->workers[i].nativeRef, NULL);
+		krk_endBlocking();
+	} else {
+		for (size_t i = 0; i < self->workerCount; ++i) pthread_detach(self->workers[i].nativeRef);
+	}
+})
+
+KRK_METHOD(ThreadPoolExecutor,max_workers,{
+	METHOD_TAKES_NONE();
+	return INTEGER_VAL(self->workerCount);
+})
+
+KRK_METHOD(ThreadPoolExecutor,__enter__,{
+	METHOD_TAKES_NONE();
+	return argv[0];
+})
+
+KRK_METHOD(ThreadPoolExecutor,__exit__,{
+	return FUNC_NAME(ThreadPoolExecutor,shutdown)(1, argv, 0);
+})
+
+#undef CURRENT_CTYPE
+
 _noexport
 void _createAndBind_threadsMod(void) {
 	/**
@@ -227,7 +1419,7 @@ void _createAndBind_threadsMod(void) {
 	);
 	krk_finalizeClass(ThreadError);
 
-	krk_makeClass(threadsModule, &Thread, "Thread", vm.baseClasses->objectClass);
+	KrkClass * Thread = krk_makeClass(threadsModule, &ThreadClass, "Thread", vm.baseClasses->objectClass);
 	KRK_DOC(Thread,
 		"Base class for building threaded execution contexts.\n\n"
 		"The @ref Thread class should be subclassed and the subclass should implement a @c run method."
@@ -239,7 +1431,7 @@ void _createAndBind_threadsMod(void) {
 	KRK_DOC(BIND_PROP(Thread,tid), "The platform-specific thread identifier, if available. Usually an integer.");
 	krk_finalizeClass(Thread);
 
-	krk_makeClass(threadsModule, &Lock, "Lock", vm.baseClasses->objectClass);
+	KrkClass * Lock = krk_makeClass(threadsModule, &LockClass, "Lock", vm.baseClasses->objectClass);
 	KRK_DOC(Lock,
 		"Represents an atomic mutex.\n\n"
 		"@ref Lock objects allow for exclusive access to a resource and can be used in a @c with block."
@@ -248,8 +1440,175 @@ void _createAndBind_threadsMod(void) {
 	KRK_DOC(BIND_METHOD(Lock,__init__), "Initialize a system mutex.");
 	KRK_DOC(BIND_METHOD(Lock,__enter__),"Acquire the lock.");
 	KRK_DOC(BIND_METHOD(Lock,__exit__), "Release the lock.");
+	KRK_DOC(BIND_METHOD(Lock,acquire),
+		"@brief Acquire the lock, and return whether it was acquired.\n"
+		"@arguments blocking=True, timeout=None\n\n"
+		"If @p blocking is false, returns @c False straight away if another thread holds the lock. "
+		"Otherwise waits for it, for at most @p timeout seconds if that is not @c None.");
+	KRK_DOC(BIND_METHOD(Lock,release), "Release the lock, which must be held by the current thread.");
+	KRK_DOC(BIND_METHOD(Lock,locked), "Whether any thread holds the lock.");
 	BIND_METHOD(Lock,__repr__);
 	krk_finalizeClass(Lock);
+
+	KrkClass * Condition = krk_makeClass(threadsModule, &ConditionClass, "Condition", vm.baseClasses->objectClass);
+	KRK_DOC(Condition,
+		"A condition variable, which threads wait on to be notified while holding its @ref Lock.\n\n"
+		"Use a @ref Condition in a @c with block to hold its lock."
+	);
+	Condition->allocSize = sizeof(struct Condition);
+	Condition->_ongcscan = _condition_gcscan;
+	KRK_DOC(BIND_METHOD(Condition,__init__),
+		"@brief Make a condition variable that uses @p lock, or a new @ref Lock if it is @c None.\n"
+		"@arguments lock=None");
+	KRK_DOC(BIND_METHOD(Condition,__enter__), "Acquire the lock.");
+	KRK_DOC(BIND_METHOD(Condition,__exit__), "Release the lock.");
+	KRK_DOC(BIND_METHOD(Condition,wait),
+		"@brief Release the lock until notified, then acquire it again.\n"
+		"@arguments timeout=None\n\n"
+		"Returns @c False if @p timeout seconds passed first.");
+	KRK_DOC(BIND_METHOD(Condition,wait_for),
+		"@brief Wait until @p predicate returns a true value, and return that value.\n"
+		"@arguments predicate, timeout=None\n\n"
+		"If @p timeout seconds pass first, returns what @p predicate returned last.");
+	KRK_DOC(BIND_METHOD(Condition,notify),
+		"@brief Wake up to @p n of the threads waiting on the condition.\n"
+		"@arguments n=1");
+	KRK_DOC(BIND_METHOD(Condition,notify_all), "Wake every thread waiting on the condition.");
+	krk_finalizeClass(Condition);
+
+	KrkClass * Semaphore = krk_makeClass(threadsModule, &SemaphoreClass, "Semaphore", vm.baseClasses->objectClass);
+	KRK_DOC(Semaphore,
+		"A counter that @ref Semaphore.acquire takes from, waiting while it is zero, and @ref Semaphore.release adds to.\n\n"
+		"Use a @ref Semaphore in a @c with block to acquire and release it."
+	);
+	Semaphore->allocSize = sizeof(struct Semaphore);
+	KRK_DOC(BIND_METHOD(Semaphore,__init__),
+		"@brief Make a semaphore with a count of @p value.\n"
+		"@arguments value=1");
+	KRK_DOC(BIND_METHOD(Semaphore,acquire),
+		"@brief Take one from the count, and return whether it was taken.\n"
+		"@arguments blocking=True, timeout=None\n\n"
+		"If @p blocking is false, returns @c False straight away if the count is zero. "
+		"Otherwise waits for a release, for at most @p timeout seconds if that is not @c None.");
+	KRK_DOC(BIND_METHOD(Semaphore,release),
+		"@brief Add @p n to the count, waking as many waiting threads.\n"
+		"@arguments n=1");
+	BIND_METHOD(Semaphore,__enter__);
+	BIND_METHOD(Semaphore,__exit__);
+	krk_finalizeClass(Semaphore);
+
+	krk_makeClass(threadsModule, &BoundedSemaphore, "BoundedSemaphore", Semaphore);
+	KRK_DOC(BoundedSemaphore,
+		"A @ref Semaphore whose count may not be released above where it started."
+	);
+	KRK_DOC(BIND_METHOD(BoundedSemaphore,__init__),
+		"@brief Make a semaphore with a count of @p value, which is also the most it may have.\n"
+		"@arguments value=1");
+	krk_finalizeClass(BoundedSemaphore);
+
+	KrkClass * Event = krk_makeClass(threadsModule, &EventClass, "Event", vm.baseClasses->objectClass);
+	KRK_DOC(Event, "A flag that threads can wait for another thread to set.");
+	Event->allocSize = sizeof(struct Event);
+	BIND_METHOD(Event,__init__);
+	KRK_DOC(BIND_METHOD(Event,is_set), "Whether the flag is set.");
+	KRK_DOC(BIND_METHOD(Event,set), "Set the flag, waking every thread waiting for it.");
+	KRK_DOC(BIND_METHOD(Event,clear), "Unset the flag.");
+	KRK_DOC(BIND_METHOD(Event,wait),
+		"@brief Wait for the flag to be set, and return whether it is.\n"
+		"@arguments timeout=None\n\n"
+		"Returns @c False if @p timeout seconds passed first.");
+	krk_finalizeClass(Event);
+
+	krk_makeClass(threadsModule, &QueueEmpty, "Empty", vm.exceptions->baseException);
+	KRK_DOC(QueueEmpty, "Raised by @ref Queue.get when there is nothing to get.");
+	krk_finalizeClass(QueueEmpty);
+	krk_makeClass(threadsModule, &QueueFull, "Full", vm.exceptions->baseException);
+	KRK_DOC(QueueFull, "Raised by @ref Queue.put when there is no room.");
+	krk_finalizeClass(QueueFull);
+
+	KrkClass * Queue = krk_makeClass(threadsModule, &QueueClass, "Queue", vm.baseClasses->objectClass);
+	KRK_DOC(Queue,
+		"A first-in first-out queue for passing values from threads to other threads.\n\n"
+		"Putting and getting take only a spinlock when they do not have to wait."
+	);
+	Queue->allocSize = sizeof(struct Queue);
+	Queue->_ongcscan = _queue_gcscan;
+	Queue->_ongcsweep = _queue_gcsweep;
+	KRK_DOC(BIND_METHOD(Queue,__init__),
+		"@brief Make a queue that holds at most @p maxsize values, or any number if it is not positive.\n"
+		"@arguments maxsize=0");
+	KRK_DOC(BIND_METHOD(Queue,put),
+		"@brief Add @p item to the end of the queue.\n"
+		"@arguments item, block=True, timeout=None\n\n"
+		"If the queue is full, waits for room, for at most @p timeout seconds if that is not @c None, "
+		"and then raises @ref Full. If @p block is false, raises @ref Full straight away.");
+	KRK_DOC(BIND_METHOD(Queue,get),
+		"@brief Remove and return the value at the front of the queue.\n"
+		"@arguments block=True, timeout=None\n\n"
+		"If the queue is empty, waits for a value, for at most @p timeout seconds if that is not @c None, "
+		"and then raises @ref Empty. If @p block is false, raises @ref Empty straight away.");
+	KRK_DOC(BIND_METHOD(Queue,put_nowait), "@brief Same as <tt>put(item, False)</tt>.\n@arguments item");
+	KRK_DOC(BIND_METHOD(Queue,get_nowait), "Same as <tt>get(False)</tt>.");
+	KRK_DOC(BIND_METHOD(Queue,task_done),
+		"@brief Say that a value taken from the queue has been dealt with.\n\n"
+		"Once every value put in the queue has been, threads waiting in @ref Queue.join wake up.");
+	KRK_DOC(BIND_METHOD(Queue,join), "Wait until @ref Queue.task_done has been called for every value put in the queue.");
+	KRK_DOC(BIND_METHOD(Queue,qsize), "The number of values in the queue.");
+	KRK_DOC(BIND_METHOD(Queue,empty), "Whether the queue is empty.");
+	KRK_DOC(BIND_METHOD(Queue,full), "Whether the queue is full.");
+	KRK_DOC(BIND_PROP(Queue,maxsize), "The most values the queue may hold, or 0 if there is no limit.");
+	krk_finalizeClass(Queue);
+
+	KrkClass * Future = krk_makeClass(threadsModule, &FutureClass, "Future", vm.baseClasses->objectClass);
+	KRK_DOC(Future,
+		"The eventual result of a call submitted to a @ref ThreadPoolExecutor."
+	);
+	Future->allocSize = sizeof(struct Future);
+	Future->_ongcscan = _future_gcscan;
+	BIND_METHOD(Future,__init__);
+	KRK_DOC(BIND_METHOD(Future,result),
+		"@brief Wait for the call to finish and return its result.\n\n"
+		"If the call raised an exception, it is raised again here.");
+	KRK_DOC(BIND_METHOD(Future,exception),
+		"@brief Wait for the call to finish and return the exception it raised, or @c None.");
+	KRK_DOC(BIND_METHOD(Future,done), "Whether the call has finished or was cancelled.");
+	KRK_DOC(BIND_METHOD(Future,running), "Whether a worker is running the call now.");
+	KRK_DOC(BIND_METHOD(Future,cancelled), "Whether the call was cancelled.");
+	KRK_DOC(BIND_METHOD(Future,cancel),
+		"@brief Cancel the call if no worker has started it.\n\n"
+		"Returns whether the call is now cancelled.");
+	BIND_METHOD(Future,__repr__);
+	krk_finalizeClass(Future);
+
+	KrkClass * ThreadPoolExecutor = krk_makeClass(threadsModule, &ThreadPoolExecutorClass, "ThreadPoolExecutor", vm.baseClasses->objectClass);
+	KRK_DOC(ThreadPoolExecutor,
+		"A fixed pool of worker threads that run submitted calls.\n\n"
+		"Each worker has its own queue of calls, and takes from the others when its own is empty. "
+		"Workers keep their thread state and stack between calls, so a call is not a new thread."
+	);
+	ThreadPoolExecutor->allocSize = sizeof(struct ThreadPoolExecutor);
+	ThreadPoolExecutor->_ongcscan = _executor_gcscan;
+	ThreadPoolExecutor->_ongcsweep = _executor_gcsweep;
+	KRK_DOC(BIND_METHOD(ThreadPoolExecutor,__init__),
+		"@brief Start the worker threads.\n"
+		"@arguments max_workers=None\n\n"
+		"Starts @p max_workers workers, or one for each processor if it is @c None.");
+	KRK_DOC(BIND_METHOD(ThreadPoolExecutor,submit),
+		"@brief Queue a call to @p fn with @p args and return a @ref Future for it.\n"
+		"@arguments fn, *args");
+	KRK_DOC(BIND_METHOD(ThreadPoolExecutor,map),
+		"@brief Call @p fn with each value of @p iterable on the workers, and return a list of the results.\n"
+		"@arguments fn, iterable, chunksize=1\n\n"
+		"Values are given to the workers @p chunksize at a time. If a call raises an exception, "
+		"it is raised again here.");
+	KRK_DOC(BIND_METHOD(ThreadPoolExecutor,shutdown),
+		"@brief Stop the workers once everything queued has run.\n"
+		"@arguments wait=True\n\n"
+		"If @p wait is true, does not return until they have stopped.");
+	KRK_DOC(BIND_PROP(ThreadPoolExecutor,max_workers), "The number of worker threads.");
+	BIND_METHOD(ThreadPoolExecutor,__enter__);
+	BIND_METHOD(ThreadPoolExecutor,__exit__);
+	krk_finalizeClass(ThreadPoolExecutor);
 }
 
 
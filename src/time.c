@@ -22,7 +22,9 @@ KRK_FUNC(sleep,{
 	                      (IS_FLOATING(argv[0]) ? AS_FLOATING(argv[0]) : 0)) *
 	                      1000000;
 
+	krk_beginBlocking();
 	usleep(usecs);
+	krk_endBlocking();
 
 	return BOOLEAN_VAL(1);
 })
@@ -10,6 +10,7 @@ void krk_initValueArray(KrkValueArray * array) {
 	array->values = NULL;
 	array->capacity = 0;
 	array->count = 0;
+	array->owner = NULL;
 }
 
 void krk_writeValueArray(KrkValueArray * array, KrkValue value) {
@@ -21,11 +22,14 @@ void krk_writeValueArray(KrkValueArray * array, KrkValue value) {
 
 	array->values[array->count] = value;
 	array->count++;
+	if (array->owner && IS_OBJECT(value)) krk_gcWriteBarrier(array->owner);
 }
 
 void krk_freeValueArray(KrkValueArray * array) {
 	FREE_ARRAY(KrkValue, array->values, array->capacity);
+	KrkObj * owner = array->owner;
 	krk_initValueArray(array);
+	array->owner = owner;
 }
 
 void krk_printValue(FILE * f, KrkValue printable) {
@@ -159,13 +163,13 @@ int krk_valuesEqual(KrkValue a, KrkValue b) {
 			case KRK_VAL_HANDLER:  krk_runtimeError(vm.exceptions->valueError,"Invalid value"); return 0;
 			case KRK_VAL_OBJECT: {
 				if (AS_OBJECT(a) == AS_OBJECT(b)) return 1;
+				if (IS_STRING(a) && IS_STRING(b)) return krk_stringsEqual(AS_STRING(a), AS_STRING(b));
 			} break;
 			default: break;
 		}
 	}
 	if (IS_FLOATING(a) && IS_FLOATING(b)) return AS_FLOATING(a) == AS_FLOATING(b);
 	if (IS_KWARGS(a) || IS_KWARGS(b)) return 0;
-	if (IS_STRING(a) && IS_STRING(b)) return 0;
 
 	KrkClass * type = krk_getType(a);
 	if (likely(type && type->_eq)) {
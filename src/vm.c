@@ -5,6 +5,13 @@
 #include <unistd.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <dirent.h>
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+# include <sys/mman.h>
+# ifndef MAP_NORESERVE
+#  define MAP_NORESERVE 0
+# endif
+#endif
 
 #include <kuroko/vm.h>
 #include <kuroko/debug.h>
@@ -13,8 +20,11 @@
 #include <kuroko/object.h>
 #include <kuroko/table.h>
 #include <kuroko/util.h>
+#include <kuroko/profiler.h>
+#include <kuroko/marshal.h>
 
 #include "private.h"
+#include "probes.h"
 
 #define KRK_VERSION_MAJOR  "1"
 #define KRK_VERSION_MINOR  "3"
@@ -41,8 +51,8 @@
 /* Ensure we don't have a macro for this so we can reference a local version. */
 #undef krk_currentThread
 
-/* This is macro'd to krk_vm for namespacing reasons. */
-KrkVM vm = {0};
+/* Threads use this one unless they are given another with krk_newVM. */
+KrkVM krk_vm = {0};
 
 #ifdef ENABLE_THREADING
 /*
@@ -56,10 +66,10 @@ KrkVM vm = {0};
  * not guaranteed.
  */
 __attribute__((tls_model("initial-exec")))
-__thread KrkThreadState krk_currentThread;
+__thread KrkThreadState krk_currentThread = { .owner = &krk_vm };
 #else
 /* There is only one thread, so don't store it as TLS... */
-KrkThreadState krk_currentThread;
+KrkThreadState krk_currentThread = { .owner = &krk_vm };
 #endif
 
 #if defined(ENABLE_THREADING) && defined(__APPLE__) && defined(__aarch64__)
@@ -89,15 +99,23 @@ void krk_forceThreadData(void) {
 #endif
 
 #if !defined(KRK_NO_TRACING) && !defined(__EMSCRIPTEN__)
-# define FRAME_IN(frame) if (vm.globalFlags & KRK_GLOBAL_CALLGRIND) { clock_gettime(CLOCK_MONOTONIC, &frame->in_time); }
+/* Entry times are kept beside the frames, so frames don't carry them when callgrind output is off. */
+static struct timespec * frameTime(KrkCallFrame * frame) {
+	if (unlikely(!krk_currentThread.frameTimes)) {
+		krk_currentThread.frameTimes = calloc(krk_currentThread.frameSpace, sizeof(struct timespec));
+	}
+	return &krk_currentThread.frameTimes[frame - krk_currentThread.frames];
+}
+# define FRAME_IN(frame) if (vm.globalFlags & KRK_GLOBAL_CALLGRIND) { clock_gettime(CLOCK_MONOTONIC, frameTime(frame)); }
 # define FRAME_OUT(frame) \
 	if (vm.globalFlags & KRK_GLOBAL_CALLGRIND && !(frame->closure->function->obj.flags & KRK_OBJ_FLAGS_CODEOBJECT_IS_GENERATOR)) { \
 		KrkCallFrame * caller = krk_currentThread.frameCount > 1 ? &krk_currentThread.frames[krk_currentThread.frameCount-2] : NULL; \
 		struct timespec outTime; \
 		clock_gettime(CLOCK_MONOTONIC, &outTime); \
+		struct timespec * inTime = frameTime(frame); \
 		struct timespec diff; \
-		diff.tv_sec  = outTime.tv_sec  - frame->in_time.tv_sec; \
-		diff.tv_nsec = outTime.tv_nsec - frame->in_time.tv_nsec; \
+		diff.tv_sec  = outTime.tv_sec  - inTime->tv_sec; \
+		diff.tv_nsec = outTime.tv_nsec - inTime->tv_nsec; \
 		if (diff.tv_nsec < 0) { diff.tv_sec--; diff.tv_nsec += 1000000000L; } \
 		fprintf(vm.callgrindFile, "%s %s@%p %d %s %s@%p %d %lld.%.9ld\n", \
 			caller ? (caller->closure->function->chunk.filename->chars) : "stdin", \
@@ -115,6 +133,32 @@ void krk_forceThreadData(void) {
 # define FRAME_OUT(frame)
 #endif
 
+#ifdef KRK_ENABLE_USDT
+# define FUNCTION_NAME(func) ((func)->qualname ? (func)->qualname->chars : (func)->name ? (func)->name->chars : "<unnamed>")
+
+# define KRK_PROBE_DEFINE(name) unsigned short KRK_PROBE_SEMAPHORE(name) __attribute__((section(".probes")));
+KRK_PROBE_LIST(KRK_PROBE_DEFINE)
+# undef KRK_PROBE_DEFINE
+
+/**
+ * Fire @p probe with the function, file and line of @p frame at @p offset into its code.
+ */
+# define PROBE_FRAME(probe, frame, offset) \
+	if (KRK_PROBE_ENABLED(probe)) { \
+		KrkCodeObject * _func = (frame)->closure->function; \
+		KRK_PROBE(probe, FUNCTION_NAME(_func), _func->chunk.filename->chars, (int)krk_lineNumber(&_func->chunk, (offset))); \
+	}
+# define PROBE_ENTRY(frame) PROBE_FRAME(function__entry, frame, 0)
+/* Generators and coroutines are resumed without an entry probe, so skip their returns. */
+# define PROBE_RETURN(frame) \
+	if (!((frame)->closure->function->obj.flags & (KRK_OBJ_FLAGS_CODEOBJECT_IS_GENERATOR | KRK_OBJ_FLAGS_CODEOBJECT_IS_COROUTINE))) { \
+		PROBE_FRAME(function__return, frame, (frame)->ip - (frame)->closure->function->chunk.code - 1); \
+	}
+#else
+# define PROBE_ENTRY(frame)
+# define PROBE_RETURN(frame)
+#endif
+
 /*
  * In some threading configurations, particular on Windows,
  * we can't have executables reference our thread-local thread
@@ -126,9 +170,25 @@ KrkThreadState * krk_getCurrentThread(void) {
 	return &krk_currentThread;
 }
 
-static struct Exceptions _exceptions = {0};
-static struct BaseClasses _baseClasses = {0};
-static KrkValue _specialMethodNames[METHOD__MAX];
+/* VMs that have been initialized and not yet freed. */
+static size_t _vmCount = 0;
+
+/* Slot 0 of vm.locals is never handed out, so an unset key reads as 0. */
+static size_t _vmLocalCount = 1;
+
+size_t krk_vmLocalSlot(KrkVMLocal * key) {
+	size_t slot = _vmLocalCount;
+	do {
+		if (slot >= KRK_VM_LOCALS) {
+			fprintf(stderr, "Too many VM-local globals (at most %d)\n", KRK_VM_LOCALS - 1);
+			abort();
+		}
+	} while (!__atomic_compare_exchange_n(&_vmLocalCount, &slot, slot + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+	size_t expected = 0;
+	/* If another thread got here first, its slot is the one to use. */
+	if (!__atomic_compare_exchange_n(key, &expected, slot, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) return expected;
+	return slot;
+}
 
 /**
  * Reset the stack pointers, frame, upvalue list,
@@ -238,6 +298,15 @@ void krk_dumpTraceback(void) {
  * Attach a traceback to the current exception object, if it doesn't already have one.
  */
 static void attachTraceback(void) {
+#ifdef KRK_ENABLE_USDT
+	if (KRK_PROBE_ENABLED(exception__raise)) {
+		KrkCallFrame * frame = krk_currentThread.frameCount ? &krk_currentThread.frames[krk_currentThread.frameCount-1] : NULL;
+		KRK_PROBE(exception__raise, krk_typeName(krk_currentThread.currentException),
+			frame ? FUNCTION_NAME(frame->closure->function) : "<native>",
+			frame ? frame->closure->function->chunk.filename->chars : "<native>",
+			frame ? (int)krk_lineNumber(&frame->closure->function->chunk, frame->ip - frame->closure->function->chunk.code - 1) : 0);
+	}
+#endif
 	if (IS_INSTANCE(krk_currentThread.currentException)) {
 		KrkInstance * theException = AS_INSTANCE(krk_currentThread.currentException);
 
@@ -408,6 +477,9 @@ __attribute__((nonnull))
 void krk_finalizeClass(KrkClass * _class) {
 	KrkValue tmp;
 
+	/* Subclasses are finalized again below, which gives them new versions as well. */
+	_class->version = __atomic_add_fetch(&vm.classVersion, 1, __ATOMIC_RELAXED);
+
 	struct TypeMap {
 		KrkObj ** method;
 		KrkSpecialMethods index;
@@ -446,6 +518,15 @@ void krk_finalizeClass(KrkClass * _class) {
 	}
 }
 
+void krk_bumpClassVersion(KrkClass * _class) {
+	_class->version = __atomic_add_fetch(&vm.classVersion, 1, __ATOMIC_RELAXED);
+	for (size_t i = 0; i < _class->subclasses.capacity; ++i) {
+		KrkTableEntry * entry = &_class->subclasses.entries[i];
+		if (IS_KWARGS(entry->key)) continue;
+		krk_bumpClassVersion(AS_CLASS(entry->key));
+	}
+}
+
 /**
  * Maps values to their base classes.
  * Internal version of type().
@@ -590,6 +671,227 @@ int krk_processComplexArguments(int argCount, KrkValueArray * positionals, KrkTa
 }
 #undef unpackArray
 
+/**
+ * Rewrite instruction sequences that have a fused superinstruction form.
+ * Only the opcode of the first instruction in each sequence is replaced, so
+ * the rest stay valid as jump targets and for the disassembler. Called once
+ * for each code object, before it first runs, with @c vm.codeLock held.
+ */
+static void quickenCodeObject(KrkCodeObject * function) {
+	KrkChunk * chunk = &function->chunk;
+	size_t offset = 0;
+
+#define SIMPLE(opc) case opc: size = 1; break;
+#define CONSTANT(opc,more) case opc: { size_t constant __attribute__((unused)) = chunk->code[offset + 1]; size = 2; more; break; } \
+	case opc ## _LONG: { size_t constant __attribute__((unused)) = (chunk->code[offset + 1] << 16) | \
+	(chunk->code[offset + 2] << 8) | (chunk->code[offset + 3]); size = 4; more; break; }
+#define OPERANDB(opc,more) case opc: size = 2; break;
+#define OPERAND(opc,more) OPERANDB(opc,more) case opc ## _LONG: size = 4; break;
+#define JUMP(opc,sign) case opc: size = 3; break;
+#define CLOSURE_MORE \
+	KrkCodeObject * closed = AS_codeobject(chunk->constants.values[constant]); \
+	for (size_t j = 0; j < closed->upvalueCount; ++j) { \
+		size += (chunk->code[offset + size] & 2) ? 4 : 2; \
+	}
+
+	while (offset < chunk->count) {
+		uint8_t opcode = chunk->code[offset];
+		size_t size = 0;
+
+		/* A breakpoint hides the size of the instruction it replaced; leave the rest of this function alone. */
+		if (opcode == OP_BREAKPOINT) return;
+
+		switch (opcode) {
+#include "opcodes.h"
+		}
+
+		if (opcode == OP_GET_LOCAL && offset + 5 <= chunk->count) {
+			if (chunk->code[offset + 2] == OP_GET_LOCAL && chunk->code[offset + 4] == OP_ADD) {
+				chunk->code[offset] = OP_ADD_LOCAL_LOCAL;
+			} else if (chunk->code[offset + 2] == OP_CONSTANT && chunk->code[offset + 4] == OP_LESS) {
+				chunk->code[offset] = OP_LESS_LOCAL_CONST;
+			}
+		}
+
+		if (!size) return;
+		offset += size;
+	}
+#undef SIMPLE
+#undef CONSTANT
+#undef OPERANDB
+#undef OPERAND
+#undef JUMP
+#undef CLOSURE_MORE
+}
+
+/**
+ * Advance one of the built-in iterator types without calling it.
+ *
+ * The loop instructions call iterators through the normal call protocol,
+ * which for the common built-in iterators means a native call per step.
+ * Exact instances of those classes (subclasses may override @c __call__)
+ * are stepped here instead, pushing the next value or, once exhausted, the
+ * iterator itself, just as calling it would. Returns 0, having pushed
+ * nothing, for any other iterator.
+ *
+ * If the loop body starts by unpacking two values, as in
+ * 'for k, v in d.items()', @p pair is set and dict items are pushed as the
+ * key and value themselves instead of a tuple of them; 2 is returned then,
+ * and the caller skips the OP_UNPACK.
+ */
+static inline int iterateBuiltin(KrkValue iter, int pair) {
+	if (!IS_INSTANCE(iter)) return 0;
+	KrkClass * _class = AS_INSTANCE(iter)->_class;
+
+	if (_class == vm.baseClasses->rangeiteratorClass) {
+		struct RangeIterator * self = (struct RangeIterator*)AS_OBJECT(iter);
+		krk_integer_type i = self->i;
+		if (self->step > 0 ? (i >= self->max) : (i <= self->max)) {
+			krk_push(iter);
+		} else {
+			self->i = i + self->step;
+			krk_push(INTEGER_VAL(i));
+		}
+		return 1;
+	} else if (_class == vm.baseClasses->listiteratorClass) {
+		struct ListIterator * self = (struct ListIterator*)AS_OBJECT(iter);
+		if (self->i >= AS_LIST(self->l)->count) {
+			krk_push(iter);
+		} else {
+			krk_push(AS_LIST(self->l)->values[self->i++]);
+		}
+		return 1;
+	} else if (_class == vm.baseClasses->tupleiteratorClass) {
+		struct TupleIter * self = (struct TupleIter*)AS_OBJECT(iter);
+		if (self->i >= (krk_integer_type)AS_TUPLE(self->myTuple)->values.count) {
+			krk_push(iter);
+		} else {
+			krk_push(AS_TUPLE(self->myTuple)->values.values[self->i++]);
+		}
+		return 1;
+	} else if (_class == vm.baseClasses->dictkeysClass || _class == vm.baseClasses->dictvaluesClass) {
+		/* DictKeys and DictValues share a layout */
+		struct DictKeys * self = (struct DictKeys*)AS_OBJECT(iter);
+		KrkTable * table = AS_DICT(self->dict);
+		/* Let __call__ raise the error. */
+		if (self->version != table->version) return 0;
+		while (self->i < table->capacity && IS_KWARGS(table->entries[self->i].key)) self->i++;
+		if (self->i >= table->capacity) {
+			krk_push(iter);
+		} else {
+			KrkTableEntry * entry = &table->entries[self->i++];
+			krk_push(_class == vm.baseClasses->dictkeysClass ? entry->key : entry->value);
+		}
+		return 1;
+	} else if (_class == vm.baseClasses->dictitemsClass) {
+		struct DictItems * self = (struct DictItems*)AS_OBJECT(iter);
+		KrkTable * table = AS_DICT(self->dict);
+		if (self->version != table->version) return 0;
+		while (self->i < table->capacity && IS_KWARGS(table->entries[self->i].key)) self->i++;
+		if (self->i >= table->capacity) {
+			krk_push(iter);
+		} else if (pair) {
+			KrkTableEntry * entry = &table->entries[self->i++];
+			krk_push(entry->key);
+			krk_push(entry->value);
+			return 2;
+		} else {
+			KrkTuple * outValue = krk_newTuple(2);
+			KrkTableEntry * entry = &AS_DICT(self->dict)->entries[self->i++];
+			outValue->values.values[0] = entry->key;
+			outValue->values.values[1] = entry->value;
+			outValue->values.count = 2;
+			krk_push(OBJECT_VAL(outValue));
+		}
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Bind keyword arguments directly into parameter slots on the stack.
+ *
+ * Handles the common case of a call with only positional and named keyword
+ * arguments to a function without *args or **kwargs, without building the
+ * temporary list and dict used by krk_processComplexArguments. Anything else,
+ * including every kind of argument error, is left untouched for the general
+ * path to deal with (and report), so this either succeeds or changes nothing.
+ *
+ * On success, the stack holds exactly the function's potential positionals,
+ * with KWARGS_VAL(0) marking unset slots, and @p argCount is updated.
+ */
+#define KRK_FAST_KWARGS_MAX 32
+static int bindKeywordsInPlace(KrkClosure * closure, int * argCount) {
+	KrkCodeObject * function = closure->function;
+	if (function->obj.flags & (KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_ARGS | KRK_OBJ_FLAGS_CODEOBJECT_COLLECTS_KWS)) return 0;
+
+	size_t kwargsCount = AS_INTEGER(krk_currentThread.stackTop[-1]);
+	if (kwargsCount > KRK_FAST_KWARGS_MAX || (size_t)*argCount < kwargsCount * 2 + 1) return 0;
+
+	size_t positionalCount = *argCount - 1 - kwargsCount * 2;
+	size_t potentialPositionals = function->potentialPositionals;
+	if (positionalCount > potentialPositionals) return 0;
+
+	size_t slots[KRK_FAST_KWARGS_MAX];
+	KrkValue * startOfExtras = &krk_currentThread.stackTop[-1 - kwargsCount * 2];
+
+	/* Resolve every name to a slot before touching the stack. */
+	for (size_t i = 0; i < kwargsCount; ++i) {
+		KrkValue key = startOfExtras[i*2];
+		if (!IS_STRING(key)) return 0;
+		size_t slot = SIZE_MAX;
+		for (size_t j = 0; j < (size_t)function->requiredArgs; ++j) {
+			if (krk_stringsEqual(AS_STRING(key), AS_STRING(function->requiredArgNames.values[j]))) {
+				slot = j;
+				break;
+			}
+		}
+		if (slot == SIZE_MAX) {
+			for (size_t j = 0; j < (size_t)function->keywordArgs; ++j) {
+				if (krk_stringsEqual(AS_STRING(key), AS_STRING(function->keywordArgNames.values[j]))) {
+					slot = j + function->requiredArgs;
+					break;
+				}
+			}
+		}
+		if (slot == SIZE_MAX || slot < positionalCount) return 0;
+		for (size_t j = 0; j < i; ++j) {
+			if (slots[j] == slot) return 0;
+		}
+		slots[i] = slot;
+	}
+
+	/* Every required argument not passed positionally must have been named. */
+	for (size_t j = positionalCount; j < (size_t)function->requiredArgs; ++j) {
+		size_t i;
+		for (i = 0; i < kwargsCount && slots[i] != j; ++i);
+		if (i == kwargsCount) return 0;
+	}
+
+	/* Make sure the stack is large enough for every parameter slot while everything is still on it. */
+	size_t stackBase = (krk_currentThread.stackTop - *argCount) - krk_currentThread.stack;
+	for (size_t i = *argCount; i < potentialPositionals; ++i) krk_push(KWARGS_VAL(0));
+
+	/* Nothing below allocates, so values held here are safe from the collector. */
+	KrkValue * base = &krk_currentThread.stack[stackBase];
+	KrkValue values[KRK_FAST_KWARGS_MAX];
+	for (size_t i = 0; i < kwargsCount; ++i) {
+		values[i] = base[positionalCount + i*2 + 1];
+	}
+	for (size_t i = positionalCount; i < potentialPositionals; ++i) {
+		base[i] = KWARGS_VAL(0);
+	}
+	for (size_t i = 0; i < kwargsCount; ++i) {
+		base[slots[i]] = values[i];
+	}
+
+	krk_currentThread.stackTop = base + potentialPositionals;
+	*argCount = potentialPositionals;
+	return 1;
+}
+#undef KRK_FAST_KWARGS_MAX
+
 /**
  * Call a managed method.
  * Takes care of argument count checking, default argument filling,
@@ -601,6 +903,25 @@ int krk_processComplexArguments(int argCount, KrkValueArray * positionals, KrkTa
  * where we need to restore the stack to when we return from this call.
  */
 static inline int _callManaged(KrkClosure * closure, int argCount, int returnDepth) {
+	if (unlikely(!(__atomic_load_n(&closure->function->obj.flags, __ATOMIC_ACQUIRE) & KRK_OBJ_FLAGS_CODEOBJECT_QUICKENED))) {
+		if (unlikely(!krk_materializeCodeObject(closure->function))) return 0;
+		/* Other threads may be making the first call too; only one rewrites the code, and the rest wait for it. */
+		_obtain_lock(vm.codeLock);
+		if (!(closure->function->obj.flags & KRK_OBJ_FLAGS_CODEOBJECT_QUICKENED)) {
+			/* Property and global instructions index these by constant, so there is one per constant. */
+			if (closure->function->chunk.constants.count && !closure->function->inlineCaches) {
+				closure->function->inlineCaches = calloc(closure->function->chunk.constants.count, sizeof(KrkInlineCache));
+				if (unlikely(!closure->function->inlineCaches)) {
+					_release_lock(vm.codeLock);
+					krk_runtimeError(vm.exceptions->baseException, "Out of memory allocating lookup caches");
+					return 0;
+				}
+			}
+			quickenCodeObject(closure->function);
+			__atomic_or_fetch(&closure->function->obj.flags, KRK_OBJ_FLAGS_CODEOBJECT_QUICKENED, __ATOMIC_RELEASE);
+		}
+		_release_lock(vm.codeLock);
+	}
 	size_t potentialPositionalArgs = closure->function->potentialPositionals;
 	size_t totalArguments = closure->function->totalArguments;
 	size_t offsetOfExtraArgs = potentialPositionalArgs;
@@ -608,7 +929,9 @@ static inline int _callManaged(KrkClosure * closure, int argCount, int returnDep
 	KrkValueArray * positionals;
 	KrkTable * keywords;
 
-	if (argCount && unlikely(IS_KWARGS(krk_currentThread.stackTop[-1]))) {
+	if (argCount && unlikely(IS_KWARGS(krk_currentThread.stackTop[-1])) && bindKeywordsInPlace(closure, &argCount)) {
+		argCountX = argCount;
+	} else if (argCount && unlikely(IS_KWARGS(krk_currentThread.stackTop[-1]))) {
 
 		KrkValue myList = krk_list_of(0,NULL,0);
 		krk_currentThread.scratchSpace[0] = myList;
@@ -759,6 +1082,7 @@ _finishKwarg:
 	frame->outSlots = frame->slots - returnDepth;
 	frame->globals = &closure->function->globalsContext->fields;
 	FRAME_IN(frame);
+	PROBE_ENTRY(frame);
 	return 1;
 
 _errorDuringPositionals:
@@ -942,18 +1266,86 @@ KrkValue krk_callDirect(KrkObj * callable, int argCount) {
 	return NONE_VAL();
 }
 
+#ifdef ENABLE_THREADING
+/**
+ * Inline caches are shared by every thread running the same code, so they
+ * are guarded by a sequence count: readers copy an entry out and only use it
+ * if the count was even and unchanged throughout, and a writer that finds
+ * another update in progress just leaves the cache alone.
+ */
+static inline size_t cacheReadBegin(KrkInlineCache * cache) {
+	return __atomic_load_n(&cache->sequence, __ATOMIC_ACQUIRE);
+}
+
+static inline int cacheReadValid(KrkInlineCache * cache, size_t sequence) {
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return !(sequence & 1) && __atomic_load_n(&cache->sequence, __ATOMIC_RELAXED) == sequence;
+}
+
+static inline int cacheWriteBegin(KrkInlineCache * cache) {
+	size_t sequence = __atomic_load_n(&cache->sequence, __ATOMIC_RELAXED);
+	if (sequence & 1) return 0;
+	return __atomic_compare_exchange_n(&cache->sequence, &sequence, sequence + 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static inline void cacheWriteEnd(KrkInlineCache * cache) {
+	__atomic_add_fetch(&cache->sequence, 1, __ATOMIC_RELEASE);
+}
+#else
+# define cacheReadBegin(cache) ((size_t)0)
+# define cacheReadValid(cache,sequence) ((void)(sequence), 1)
+# define cacheWriteBegin(cache) 1
+# define cacheWriteEnd(cache) do { } while (0)
+#endif
+
+/**
+ * Find @p name in the methods table of @p _class or one of its bases.
+ * If @p cache is provided, it is checked first and updated on a miss.
+ */
+static inline int lookupClassAttribute(KrkClass * _class, KrkString * name, KrkValue * out, KrkInlineCache * cache) {
+	if (cache) {
+		size_t sequence = cacheReadBegin(cache);
+		for (int i = 0; i < KRK_INLINE_CACHE_SIZE; ++i) {
+			KrkClass * cachedClass = cache->as.entries[i]._class;
+			size_t cachedVersion = cache->as.entries[i].version;
+			KrkValue cachedValue = cache->as.entries[i].value;
+			if (cachedClass == _class && cachedVersion == _class->version) {
+				if (!cacheReadValid(cache, sequence)) break;
+				*out = cachedValue;
+				return !IS_KWARGS(cachedValue);
+			}
+		}
+	}
+
+	KrkClass * base = _class;
+	KrkValue value = KWARGS_VAL(0);
+	while (base) {
+		if (krk_tableGet_fast(&base->methods, name, &value)) break;
+		base = base->base;
+	}
+
+	if (cache && cacheWriteBegin(cache)) {
+		/* Newest entry goes first; the oldest one falls off the end. */
+		memmove(&cache->as.entries[1], &cache->as.entries[0], sizeof(cache->as.entries[0]) * (KRK_INLINE_CACHE_SIZE - 1));
+		cache->as.entries[0]._class = _class;
+		cache->as.entries[0].version = _class->version;
+		cache->as.entries[0].value = base ? value : KWARGS_VAL(0);
+		cacheWriteEnd(cache);
+	}
+
+	if (!base) return 0;
+	*out = value;
+	return 1;
+}
+
 /**
  * Attach a method call to its callee and return a BoundMethod.
  * Works for managed and native method calls.
  */
-int krk_bindMethod(KrkClass * _class, KrkString * name) {
+static int bindMethod(KrkClass * _class, KrkString * name, KrkInlineCache * cache) {
 	KrkClass * originalClass = _class;
 	KrkValue method, out;
-	while (_class) {
-		if (krk_tableGet_fast(&_class->methods, name, &method)) break;
-		_class = _class->base;
-	}
-	if (!_class) return 0;
+	if (!lookupClassAttribute(_class, name, &method, cache)) return 0;
 	if (IS_NATIVE(method)||IS_CLOSURE(method)) {
 		if (AS_OBJECT(method)->flags & KRK_OBJ_FLAGS_FUNCTION_IS_CLASS_METHOD) {
 			out = OBJECT_VAL(krk_newBoundMethod(OBJECT_VAL(originalClass), AS_OBJECT(method)));
@@ -964,6 +1356,10 @@ int krk_bindMethod(KrkClass * _class, KrkString * name) {
 		} else {
 			out = OBJECT_VAL(krk_newBoundMethod(krk_peek(0), AS_OBJECT(method)));
 		}
+	} else if (IS_member(method) && IS_INSTANCE(krk_peek(0)) && AS_INSTANCE(krk_peek(0))->_class == originalClass) {
+		/* Slots are read directly, without going through the descriptor. */
+		out = *krk_slotValue(AS_INSTANCE(krk_peek(0)), AS_member(method)->offset);
+		if (IS_KWARGS(out)) return 0;
 	} else {
 		/* Does it have a descriptor __get__? */
 		KrkClass * type = krk_getType(method);
@@ -980,18 +1376,18 @@ int krk_bindMethod(KrkClass * _class, KrkString * name) {
 	return 1;
 }
 
+int krk_bindMethod(KrkClass * _class, KrkString * name) {
+	return bindMethod(_class, name, NULL);
+}
+
 /**
  * Similar to @ref krk_bindMethod but does not create bound method objects.
  * @returns 1 if the result was an (unbound) method, 2 if it was something else, 0 if it was not found.
  */
-int krk_unbindMethod(KrkClass * _class, KrkString * name) {
+static int unbindMethod(KrkClass * _class, KrkString * name, KrkInlineCache * cache) {
 	KrkClass * originalClass = _class;
 	KrkValue method, out;
-	while (_class) {
-		if (krk_tableGet_fast(&_class->methods, name, &method)) break;
-		_class = _class->base;
-	}
-	if (!_class) return 0;
+	if (!lookupClassAttribute(_class, name, &method, cache)) return 0;
 	if (IS_NATIVE(method) || IS_CLOSURE(method)) {
 		if (AS_OBJECT(method)->flags & KRK_OBJ_FLAGS_FUNCTION_IS_DYNAMIC_PROPERTY) {
 			out = AS_NATIVE(method)->function(1, (KrkValue[]){krk_peek(0)}, 0);
@@ -1006,6 +1402,9 @@ int krk_unbindMethod(KrkClass * _class, KrkString * name) {
 			krk_push(method);
 			return 1;
 		}
+	} else if (IS_member(method) && IS_INSTANCE(krk_peek(0)) && AS_INSTANCE(krk_peek(0))->_class == originalClass) {
+		out = *krk_slotValue(AS_INSTANCE(krk_peek(0)), AS_member(method)->offset);
+		if (IS_KWARGS(out)) return 0;
 	} else {
 		/* Does it have a descriptor __get__? */
 		KrkClass * type = krk_getType(method);
@@ -1022,6 +1421,9 @@ int krk_unbindMethod(KrkClass * _class, KrkString * name) {
 	return 2;
 }
 
+int krk_unbindMethod(KrkClass * _class, KrkString * name) {
+	return unbindMethod(_class, name, NULL);
+}
 
 /**
  * Capture upvalues and mark them as open. Called upon closure creation to
@@ -1058,6 +1460,7 @@ static void closeUpvalues(int last) {
 		KrkUpvalue * upvalue = krk_currentThread.openUpvalues;
 		upvalue->closed = krk_currentThread.stack[upvalue->location];
 		upvalue->location = -1;
+		krk_gcWriteBarrier((KrkObj*)upvalue);
 		krk_currentThread.openUpvalues = upvalue->next;
 	}
 }
@@ -1144,14 +1547,16 @@ KRK_FUNC(set_tracing,{
 })
 #endif
 
-KRK_FUNC(getsizeof,{
-	if (argc < 1 || !IS_OBJECT(argv[0])) return INTEGER_VAL(0);
+size_t krk_sizeOfObject(KrkObj * object) {
+	KrkValue value = OBJECT_VAL(object);
 	size_t mySize = 0;
-	switch (AS_OBJECT(argv[0])->type) {
+	switch (object->type) {
 		case KRK_OBJ_STRING: {
-			KrkString * self = AS_STRING(argv[0]);
-			mySize += sizeof(KrkString) + self->length + 1; /* For the UTF8 */
-			if (self->codes && self->chars != self->codes) {
+			KrkString * self = AS_STRING(value);
+			mySize += sizeof(KrkString) + krk_stringCapacity(self); /* For the UTF8 */
+			if (self->obj.flags & KRK_OBJ_FLAGS_STRING_BREADCRUMBS) {
+				mySize += sizeof(size_t) * (self->codesLength / KRK_STRING_BREADCRUMB_SPACING + 1);
+			} else if (self->codes && self->chars != self->codes) {
 				if ((self->obj.flags & KRK_OBJ_FLAGS_STRING_MASK) <= KRK_OBJ_FLAGS_STRING_UCS1) mySize += self->codesLength;
 				else if ((self->obj.flags & KRK_OBJ_FLAGS_STRING_MASK) == KRK_OBJ_FLAGS_STRING_UCS2) mySize += 2 * self->codesLength;
 				else if ((self->obj.flags & KRK_OBJ_FLAGS_STRING_MASK) == KRK_OBJ_FLAGS_STRING_UCS4) mySize += 4 * self->codesLength;
@@ -1159,7 +1564,7 @@ KRK_FUNC(getsizeof,{
 			break;
 		}
 		case KRK_OBJ_CODEOBJECT: {
-			KrkCodeObject * self = (KrkCodeObject*)AS_OBJECT(argv[0]);
+			KrkCodeObject * self = (KrkCodeObject*)AS_OBJECT(value);
 			mySize += sizeof(KrkCodeObject);
 			/* Chunk size */
 			mySize += sizeof(uint8_t) * self->chunk.capacity;
@@ -1174,12 +1579,12 @@ KRK_FUNC(getsizeof,{
 			break;
 		}
 		case KRK_OBJ_NATIVE: {
-			KrkNative * self = (KrkNative*)AS_OBJECT(argv[0]);
+			KrkNative * self = (KrkNative*)AS_OBJECT(value);
 			mySize += sizeof(KrkNative) + strlen(self->name) + 1;
 			break;
 		}
 		case KRK_OBJ_CLOSURE: {
-			KrkClosure * self = AS_CLOSURE(argv[0]);
+			KrkClosure * self = AS_CLOSURE(value);
 			mySize += sizeof(KrkClosure) + sizeof(KrkUpvalue*) * self->function->upvalueCount;
 			break;
 		}
@@ -1190,23 +1595,25 @@ KRK_FUNC(getsizeof,{
 			break;
 		}
 		case KRK_OBJ_CLASS: {
-			KrkClass * self = AS_CLASS(argv[0]);
+			KrkClass * self = AS_CLASS(value);
 			mySize += sizeof(KrkClass);
-			mySize += sizeof(KrkTableEntry) * self->methods.capacity;
-			mySize += sizeof(KrkTableEntry) * self->subclasses.capacity;
+			mySize += krk_tableBytes(&self->methods);
+			mySize += krk_tableBytes(&self->subclasses);
 			break;
 		}
 		case KRK_OBJ_INSTANCE: {
-			KrkInstance * self = AS_INSTANCE(argv[0]);
-			mySize += sizeof(KrkTableEntry) * self->fields.capacity;
-			KrkClass * type = krk_getType(argv[0]);
+			KrkInstance * self = AS_INSTANCE(value);
+			mySize += krk_tableBytes(&self->fields);
+			KrkClass * type = krk_getType(value);
 			mySize += type->allocSize; /* All instance types have an allocSize set */
 
 			/* TODO __sizeof__ */
-			if (krk_isInstanceOf(argv[0], vm.baseClasses->listClass)) {
-				mySize += sizeof(KrkValue) * AS_LIST(argv[0])->capacity;
-			} else if (krk_isInstanceOf(argv[0], vm.baseClasses->dictClass)) {
-				mySize += sizeof(KrkTableEntry) * AS_DICT(argv[0])->capacity;
+			if (krk_isInstanceOf(value, vm.baseClasses->listClass)) {
+				mySize += sizeof(KrkValue) * AS_LIST(value)->capacity;
+			} else if (krk_isInstanceOf(value, vm.baseClasses->dictClass)) {
+				mySize += krk_tableBytes(AS_DICT(value));
+			} else {
+				mySize += krk_setBytes(value) + krk_dequeBytes(value);
 			}
 			break;
 		}
@@ -1215,18 +1622,29 @@ KRK_FUNC(getsizeof,{
 			break;
 		}
 		case KRK_OBJ_TUPLE: {
-			KrkTuple * self = AS_TUPLE(argv[0]);
+			KrkTuple * self = AS_TUPLE(value);
 			mySize += sizeof(KrkTuple) + sizeof(KrkValue) * self->values.capacity;
 			break;
 		}
 		case KRK_OBJ_BYTES: {
-			KrkBytes * self = AS_BYTES(argv[0]);
+			KrkBytes * self = AS_BYTES(value);
 			mySize += sizeof(KrkBytes) + self->length;
 			break;
 		}
 		default: break;
 	}
-	return INTEGER_VAL(mySize);
+	return mySize;
+}
+
+KRK_FUNC(getsizeof,{
+	if (argc < 1 || !IS_OBJECT(argv[0])) return INTEGER_VAL(0);
+	return INTEGER_VAL(krk_sizeOfObject(AS_OBJECT(argv[0])));
+})
+
+KRK_FUNC(intern,{
+	FUNCTION_TAKES_EXACTLY(1);
+	if (!IS_STRING(argv[0])) return TYPE_ERROR(str,argv[0]);
+	return OBJECT_VAL(krk_internString(AS_STRING(argv[0])));
 })
 
 KRK_FUNC(set_clean_output,{
@@ -1238,6 +1656,65 @@ KRK_FUNC(set_clean_output,{
 	return NONE_VAL();
 })
 
+KRK_FUNC(set_optimize,{
+	if (!argc || (IS_BOOLEAN(argv[0]) && AS_BOOLEAN(argv[0]))) {
+		vm.globalFlags |= KRK_GLOBAL_OPTIMIZE;
+	} else {
+		vm.globalFlags &= ~KRK_GLOBAL_OPTIMIZE;
+	}
+	return NONE_VAL();
+})
+
+KRK_FUNC(set_lazy_imports,{
+	if (!argc || (IS_BOOLEAN(argv[0]) && AS_BOOLEAN(argv[0]))) {
+		vm.globalFlags |= KRK_GLOBAL_LAZY_IMPORTS;
+	} else {
+		vm.globalFlags &= ~KRK_GLOBAL_LAZY_IMPORTS;
+	}
+	return NONE_VAL();
+})
+
+KRK_FUNC(invalidate_import_caches,{
+	FUNCTION_TAKES_NONE();
+	krk_freeTable(&vm.importDirs);
+	krk_initTable(&vm.importDirs);
+})
+
+static int resolveLazyModule(KrkInstance * module);
+
+#define IS_lazymodule(o) (krk_isInstanceOf(o, vm.baseClasses->lazyModuleClass))
+#define AS_lazymodule(o) (AS_INSTANCE(o))
+#define CURRENT_CTYPE KrkInstance *
+#define CURRENT_NAME  self
+
+KRK_METHOD(lazymodule,__getattr__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_STRING(argv[1])) return TYPE_ERROR(str,argv[1]);
+	if (self->_class == vm.baseClasses->lazyModuleClass && !resolveLazyModule(self)) return NONE_VAL();
+	return krk_valueGetAttribute(argv[0], AS_CSTRING(argv[1]));
+})
+
+KRK_METHOD(lazymodule,__dir__,{
+	METHOD_TAKES_NONE();
+	if (self->_class == vm.baseClasses->lazyModuleClass && !resolveLazyModule(self)) return NONE_VAL();
+	return krk_dirObject(argc,argv,hasKw);
+})
+
+KRK_METHOD(lazymodule,__repr__,{
+	METHOD_TAKES_NONE();
+	KrkValue name = NONE_VAL();
+	krk_tableGet(&self->fields, vm.specialMethodNames[METHOD_NAME], &name);
+	if (!IS_STRING(name)) return OBJECT_VAL(S("<lazy module>"));
+	struct StringBuilder sb = {0};
+	pushStringBuilderStr(&sb, "<lazy module '", sizeof("<lazy module '") - 1);
+	pushStringBuilderStr(&sb, AS_CSTRING(name), AS_STRING(name)->length);
+	pushStringBuilderStr(&sb, "'>", 2);
+	return finishStringBuilder(&sb);
+})
+
+#undef CURRENT_CTYPE
+#undef CURRENT_NAME
+
 KRK_FUNC(importmodule,{
 	FUNCTION_TAKES_EXACTLY(1);
 	if (!IS_STRING(argv[0])) return TYPE_ERROR(str,argv[0]);
@@ -1270,16 +1747,83 @@ KRK_FUNC(inspect_value,{
 	return OBJECT_VAL(krk_newBytes(sizeof(KrkValue),(uint8_t*)&argv[0]));
 })
 
+/**
+ * The interpreter holds pointers to call frames across calls, so they must not
+ * move while a thread runs, and each thread has room for the deepest call stack
+ * allowed from the start. Where there are anonymous mappings, that room is only
+ * address space, and pages are committed as calls first reach them, so a high
+ * recursion limit costs a thread nothing until it recurses that deeply.
+ */
+static KrkCallFrame * mapFrames(size_t count) {
+#if defined(_WIN32) || defined(__EMSCRIPTEN__)
+	return calloc(count, sizeof(KrkCallFrame));
+#else
+	void * out = mmap(NULL, count * sizeof(KrkCallFrame), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return out == MAP_FAILED ? NULL : out;
+#endif
+}
+
+static void unmapFrames(KrkCallFrame * frames, size_t count) {
+#if defined(_WIN32) || defined(__EMSCRIPTEN__)
+	free(frames);
+#else
+	if (frames) munmap(frames, count * sizeof(KrkCallFrame));
+#endif
+}
+
+void krk_reserveFrames(KrkThreadState * thread, size_t count) {
+	KrkCallFrame * frames = mapFrames(count);
+	if (!frames) {
+		fprintf(stderr, "Failed to reserve %zu call frames.\n", count);
+		abort();
+	}
+	if (thread->frames) {
+		memcpy(frames, thread->frames, sizeof(KrkCallFrame) * (thread->frameCount < count ? thread->frameCount : count));
+		unmapFrames(thread->frames, thread->frameSpace);
+	}
+	thread->frames = frames;
+	thread->frameSpace = count;
+	if (thread->frameTimes) {
+		thread->frameTimes = realloc(thread->frameTimes, count * sizeof(struct timespec));
+	}
+}
+
+void krk_releaseFrames(KrkThreadState * thread) {
+	unmapFrames(thread->frames, thread->frameSpace);
+	thread->frames = NULL;
+	thread->frameSpace = 0;
+	free(thread->frameTimes);
+	thread->frameTimes = NULL;
+}
+
 void krk_setMaximumRecursionDepth(size_t maxDepth) {
 	vm.maximumCallDepth = maxDepth;
 
 	KrkThreadState * thread = vm.threads;
 	while (thread) {
-		thread->frames = realloc(thread->frames, maxDepth * sizeof(KrkCallFrame));
+		krk_reserveFrames(thread, maxDepth);
 		thread = thread->next;
 	}
 }
 
+/**
+ * String hashes are seeded randomly, so that dictionaries keyed by strings
+ * from outside can't be filled with deliberate collisions. Setting
+ * KUROKO_HASH_SEED fixes the seed, for reproducible iteration order.
+ */
+static uint64_t chooseHashSeed(void) {
+	char * env = getenv("KUROKO_HASH_SEED");
+	if (env && *env) return strtoull(env, NULL, 0);
+	uint64_t seed = 0;
+	FILE * f = fopen("/dev/urandom", "rb");
+	if (f) {
+		size_t got = fread(&seed, 1, sizeof(seed), f);
+		fclose(f);
+		if (got == sizeof(seed)) return seed;
+	}
+	return (uint64_t)time(NULL) ^ ((uint64_t)(uintptr_t)&seed << 16) ^ (uint64_t)getpid();
+}
+
 void krk_initVM(int flags) {
 #if defined(ENABLE_THREADING) && defined(__APPLE__) && defined(__aarch64__)
 	krk_forceThreadData();
@@ -1287,10 +1831,12 @@ void krk_initVM(int flags) {
 
 	vm.globalFlags = flags & 0xFF00;
 	vm.maximumCallDepth = KRK_CALL_FRAMES_MAX;
+	vm.locals = calloc(KRK_VM_LOCALS, sizeof(uint64_t));
+	krk_initGC();
 
 	/* Reset current thread */
 	krk_resetStack();
-	krk_currentThread.frames   = calloc(vm.maximumCallDepth,sizeof(KrkCallFrame));
+	krk_reserveFrames(&krk_currentThread, vm.maximumCallDepth);
 	krk_currentThread.flags    = flags & 0x00FF;
 	krk_currentThread.module   = NULL;
 	vm.threads = &krk_currentThread;
@@ -1298,18 +1844,39 @@ void krk_initVM(int flags) {
 
 	/* GC state */
 	vm.objects = NULL;
+	vm.survivors = NULL;
 	vm.bytesAllocated = 0;
-	vm.nextGC = 1024 * 1024;
+	vm.heapGrowth = 2.0;
+	vm.minHeap = 1024 * 1024;
+	vm.maxHeapGrowth = 64 * 1024 * 1024;
+	vm.nextGC = vm.minHeap;
+	vm.nurserySize = 1024 * 1024;
+	vm.nextMinorGC = vm.nurserySize;
+	vm.nextGCStep = 0;
+	vm.gcStepBudget = 0;
+	vm.gcThreads = 1;
+#if defined(ENABLE_THREADING) && defined(_SC_NPROCESSORS_ONLN)
+	{
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		if (cpus > 1) vm.gcThreads = cpus < 8 ? cpus : 8;
+	}
+#endif
 	vm.grayCount = 0;
 	vm.grayCapacity = 0;
 	vm.grayStack = NULL;
+	vm.rememberedCount = 0;
+	vm.rememberedCapacity = 0;
+	vm.remembered = NULL;
 
 	/* Global objects */
-	vm.exceptions = &_exceptions;
-	vm.baseClasses = &_baseClasses;
-	vm.specialMethodNames = _specialMethodNames;
+	vm.exceptions = calloc(1, sizeof(struct Exceptions));
+	vm.baseClasses = calloc(1, sizeof(struct BaseClasses));
+	vm.specialMethodNames = calloc(METHOD__MAX, sizeof(KrkValue));
+	/* VMs that run at the same time share the seed, as they share the interned hashes of C strings. */
+	if (__atomic_fetch_add(&_vmCount, 1, __ATOMIC_ACQ_REL) == 0) krk_seedHash(chooseHashSeed());
 	krk_initTable(&vm.strings);
 	krk_initTable(&vm.modules);
+	krk_initTable(&vm.importDirs);
 
 	/*
 	 * To make lookup faster, store these so we can don't have to keep boxing
@@ -1342,6 +1909,8 @@ void krk_initVM(int flags) {
 	_createAndBind_exceptions();
 	_createAndBind_generatorClass();
 	_createAndBind_gcMod();
+	_createAndBind_weakrefMod();
+	_createAndBind_collectionsMod();
 	_createAndBind_timeMod();
 	_createAndBind_osMod();
 	_createAndBind_fileioMod();
@@ -1372,10 +1941,21 @@ void krk_initVM(int flags) {
 		"@brief Calculate the approximate size of an object in bytes.\n"
 		"@arguments value\n\n"
 		"@param value Value to examine.");
+	KRK_DOC(BIND_FUNC(vm.system,intern),
+		"@brief Obtain the interned copy of a string.\n"
+		"@arguments string\n\n"
+		"Strings built at runtime are not interned. Interning a string that will be compared "
+		"or looked up often lets those comparisons be done by identity.\n\n"
+		"@param string String to intern.");
 	KRK_DOC(BIND_FUNC(vm.system,set_clean_output),
 		"@brief Disables terminal escapes in some output from the VM.\n"
 		"@arguments clean=True\n\n"
 		"@param clean Whether to remove escapes.");
+	KRK_DOC(BIND_FUNC(vm.system,set_optimize),
+		"@brief Enables the bytecode optimizer for code compiled from now on.\n"
+		"@arguments optimize=True\n\n"
+		"Equivalent to the @c -O interpreter option.\n\n"
+		"@param optimize Whether to optimize newly compiled code.");
 	KRK_DOC(BIND_FUNC(vm.system,set_tracing),
 		"@brief Toggle debugging modes.\n"
 		"@arguments tracing=None,disassembly=None,scantracing=None,stressgc=None\n\n"
@@ -1384,6 +1964,18 @@ void krk_initVM(int flags) {
 		"@param disassembly Prints bytecode disassembly after compilation.\n"
 		"@param scantracing Prints debug output from the token scanner during compilation.\n"
 		"@param stressgc Forces a garbage collection cycle on each heap allocation.");
+	KRK_DOC(BIND_FUNC(vm.system,set_lazy_imports),
+		"@brief Makes @c import statements load modules when they are first used.\n"
+		"@arguments enabled=True\n\n"
+		"While enabled, @c import of a module that is not a package member binds a @ref lazymodule "
+		"once the module has been found, and the module is only run the first time an attribute "
+		"is looked up in it. Errors raised by the module are raised from that lookup instead of from "
+		"the @c import statement.\n\n"
+		"@param enabled Whether imports should be lazy.");
+	KRK_DOC(BIND_FUNC(vm.system,invalidate_import_caches),
+		"@brief Forget the cached listings of module search directories.\n\n"
+		"Listings are read again when a directory's modification time changes, so this is only needed "
+		"on file systems that do not keep modification times up to date.");
 	KRK_DOC(BIND_FUNC(vm.system,importmodule),
 		"@brief Import a module by string name\n"
 		"@arguments module\n\n"
@@ -1395,8 +1987,29 @@ void krk_initVM(int flags) {
 		"Removes a module from the module table. It is not necessarily garbage collected if other references to it exist.");
 	KRK_DOC(BIND_FUNC(vm.system,inspect_value),
 		"Obtain the memory representation of a stack value.");
+	_createAndBind_profiler();
 	krk_attachNamedObject(&vm.system->fields, "module", (KrkObj*)vm.baseClasses->moduleClass);
+	vm.baseClasses->lazyModuleClass = krk_newClass(S("lazymodule"), vm.baseClasses->moduleClass);
+	krk_attachNamedObject(&vm.system->fields, "lazymodule", (KrkObj*)vm.baseClasses->lazyModuleClass);
+	KrkClass * lazymodule = vm.baseClasses->lazyModuleClass;
+	BIND_METHOD(lazymodule,__getattr__);
+	BIND_METHOD(lazymodule,__dir__);
+	BIND_METHOD(lazymodule,__repr__);
+	krk_defineNative(&lazymodule->methods, "__str__", FUNC_NAME(lazymodule,__repr__));
+	krk_finalizeClass(lazymodule);
+	KRK_DOC(lazymodule, "Type of modules bound by a lazy import, until something is looked up in them.");
 	krk_attachNamedObject(&vm.system->fields, "path_sep", (KrkObj*)S(PATH_SEP));
+	/* The same File objects as in fileio; print() writes to whichever one is kuroko.stdout. */
+	KrkValue fileio;
+	if (krk_tableGet_fast(&vm.modules, S("fileio"), &fileio) && IS_INSTANCE(fileio)) {
+		static const char * streams[] = {"stdin", "stdout", "stderr"};
+		for (size_t i = 0; i < sizeof(streams) / sizeof(*streams); ++i) {
+			KrkValue stream;
+			if (krk_tableGet_fast(&AS_INSTANCE(fileio)->fields, krk_copyString(streams[i], strlen(streams[i])), &stream)) {
+				krk_attachNamedValue(&vm.system->fields, streams[i], stream);
+			}
+		}
+	}
 	KrkValue module_paths = krk_list_of(0,NULL,0);
 	krk_attachNamedValue(&vm.system->fields, "module_paths", module_paths);
 	krk_writeValueArray(AS_LIST(module_paths), OBJECT_VAL(S("./")));
@@ -1436,16 +2049,30 @@ void krk_initVM(int flags) {
 	krk_resetStack();
 }
 
+KrkVM * krk_newVM(int flags, const char * binpath) {
+	KrkVM * out = calloc(1, sizeof(KrkVM));
+	if (binpath) out->binpath = strdup(binpath);
+	krk_currentThread.owner = out;
+	krk_initVM(flags);
+	return out;
+}
+
 /**
  * Reclaim resources used by the VM.
  */
 void krk_freeVM() {
 	krk_freeTable(&vm.strings);
 	krk_freeTable(&vm.modules);
-	memset(_specialMethodNames,0,sizeof(_specialMethodNames));
-	memset(&_exceptions,0,sizeof(_exceptions));
-	memset(&_baseClasses,0,sizeof(_baseClasses));
+	krk_freeTable(&vm.importDirs);
+	free(vm.specialMethodNames);
+	free(vm.exceptions);
+	free(vm.baseClasses);
+	vm.specialMethodNames = NULL;
+	vm.exceptions = NULL;
+	vm.baseClasses = NULL;
 	krk_freeObjects();
+	krk_freeWeakReferences();
+	krk_freeArgNames();
 
 	if (vm.binpath) free(vm.binpath);
 
@@ -1453,13 +2080,18 @@ void krk_freeVM() {
 		KrkThreadState * thread = krk_currentThread.next;
 		krk_currentThread.next = thread->next;
 		FREE_ARRAY(size_t, thread->stack, thread->stackSize);
-		free(thread->frames);
+		krk_releaseFrames(thread);
 	}
 
 	FREE_ARRAY(size_t, krk_currentThread.stack, krk_currentThread.stackSize);
-	memset(&krk_vm,0,sizeof(krk_vm));
-	free(krk_currentThread.frames);
+	krk_freeGC();
+	free(vm.locals);
+	if (&vm == &krk_vm) memset(&krk_vm,0,sizeof(krk_vm));
+	else free(&vm);
+	__atomic_sub_fetch(&_vmCount, 1, __ATOMIC_ACQ_REL);
+	krk_releaseFrames(&krk_currentThread);
 	memset(&krk_currentThread,0,sizeof(KrkThreadState));
+	krk_currentThread.owner = &krk_vm;
 
 	extern void krk_freeMemoryDebugger(void);
 	krk_freeMemoryDebugger();
@@ -1545,6 +2177,8 @@ static int handleException() {
 		!IS_EXCEPT_HANDLER(krk_currentThread.stack[stackOffset])
 		; stackOffset--);
 	if (stackOffset < exitSlot) {
+		/* The frames being unwound are gone, but closures made in them may not be. */
+		closeUpvalues(exitSlot);
 		if (exitSlot == 0) {
 			/*
 			 * No exception was found and we have reached the top of the call stack.
@@ -1577,164 +2211,320 @@ static int handleException() {
 	return 0;
 }
 
+#ifndef NO_FILESYSTEM
 /**
- * Load a module.
- *
- * The module search path is stored in __builtins__.module_paths and should
- * be a list of directories (with trailing forward-slash) to look at, in order,
- * to resolve module names. krk source files will always take priority, so if
- * a later search path has a krk source and an earlier search path has a shared
- * object module, the later search path will still win.
+ * Compile (or load from the bytecode cache) and run a module from a source file
+ * in a new context, exiting the VM when it returns to the current call frame.
+ * If @p into is set, the module runs in that module object, from a lazy import,
+ * instead of a new one.
  */
-int krk_loadModule(KrkString * path, KrkValue * moduleOut, KrkString * runAs, KrkValue parent) {
-	KrkValue modulePaths;
-
-	/* See if the module is already loaded */
-	if (krk_tableGet_fast(&vm.modules, runAs, moduleOut)) {
-		krk_push(*moduleOut);
-		return 1;
+static int loadSourceModule(KrkString * runAs, KrkValue parent, int isPackage, char * fileName, KrkValue * moduleOut, KrkInstance * into) {
+	KrkInstance * enclosing = krk_currentThread.module;
+	if (into) {
+		krk_currentThread.module = into;
+		krk_tableSet(&vm.modules, OBJECT_VAL(runAs), OBJECT_VAL(into));
+		krk_attachNamedObject(&into->fields, "__builtins__", (KrkObj*)vm.builtins);
+		krk_attachNamedValue(&into->fields, "__annotations__", krk_dict_of(0,NULL,0));
+	} else {
+		krk_startModule(runAs->chars);
 	}
-
-#ifndef NO_FILESYSTEM
-
-	/* Obtain __builtins__.module_paths */
-	if (!krk_tableGet_fast(&vm.system->fields, S("module_paths"), &modulePaths) || !IS_INSTANCE(modulePaths)) {
-		*moduleOut = NONE_VAL();
-		krk_runtimeError(vm.exceptions->importError,
-			"kuroko.module_paths not defined.");
-		return 0;
+	if (isPackage) {
+		krk_attachNamedValue(&krk_currentThread.module->fields,"__ispackage__",BOOLEAN_VAL(1));
+		/* For a module that is a package, __package__ is its own name */
+		krk_attachNamedValue(&krk_currentThread.module->fields,"__package__",OBJECT_VAL(runAs));
+	} else {
+		KrkValue parentName;
+		if (IS_INSTANCE(parent) && krk_tableGet_fast(&AS_INSTANCE(parent)->fields, S("__name__"), &parentName) && IS_STRING(parentName)) {
+			krk_attachNamedValue(&krk_currentThread.module->fields, "__package__", parentName);
+		} else {
+			/* If there is no parent, or the parent doesn't have a string __name__ attribute,
+			 * set the __package__ to None, so it at least exists. */
+			krk_attachNamedValue(&krk_currentThread.module->fields, "__package__", NONE_VAL());
+		}
 	}
-
-	/* Obtain __builtins__.module_paths.__list so we can do lookups directly */
-	int moduleCount = AS_LIST(modulePaths)->count;
-	if (!moduleCount) {
-		*moduleOut = NONE_VAL();
-		krk_runtimeError(vm.exceptions->importError,
-			"No module search directories are specified, so no modules may be imported.");
+	int previousExitFrame = krk_currentThread.exitOnFrame;
+	krk_currentThread.exitOnFrame = krk_currentThread.frameCount;
+	/* Like scripts, modules run directly with -m are not cached; only imports are. */
+	KrkCodeObject * function = krk_compileCached(fileName, runAs != S("__main__"));
+	if (function) {
+		krk_runCodeObject(function);
+	} else if (!krk_currentThread.frameCount) {
+		handleException();
+	}
+	krk_currentThread.exitOnFrame = previousExitFrame;
+	*moduleOut = OBJECT_VAL(krk_currentThread.module);
+	krk_currentThread.module = enclosing;
+	if (!IS_OBJECT(*moduleOut)) {
+		if (!(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION)) {
+			krk_runtimeError(vm.exceptions->importError,
+				"Failed to load module '%s' from '%s'", runAs->chars, fileName);
+		}
 		return 0;
 	}
+	return 1;
+}
+
+#if defined(__APPLE__)
+# define MTIME_NSEC(st) ((st).st_mtimespec.tv_nsec)
+#elif defined(_WIN32)
+# define MTIME_NSEC(st) 0
+#else
+# define MTIME_NSEC(st) ((st).st_mtim.tv_nsec)
+#endif
 
+/**
+ * Get the names in the directory @p dir as a dict, or None if it can not be read.
+ *
+ * Listings are kept in vm.importDirs with the modification time of the directory,
+ * and are only read again when that changes, so looking for a module costs one
+ * stat() of each search directory rather than one for every file name tried.
+ * A directory changed in the last couple of seconds is not cached, as a file
+ * added within the resolution of its timestamp would not change it again.
+ */
+static KrkValue directoryListing(const char * dir) {
 	struct stat statbuf;
+	if (stat(dir, &statbuf) != 0 || !S_ISDIR(statbuf.st_mode)) return NONE_VAL();
+	krk_integer_type seconds = statbuf.st_mtime;
+	krk_integer_type nanoseconds = MTIME_NSEC(statbuf);
 
-	/* First search for {path}.krk in the module search paths */
-	for (int i = 0; i < moduleCount; ++i, krk_pop()) {
-		int isPackage = 0;
-		char * fileName;
+	KrkValue key = OBJECT_VAL(krk_copyString(dir, strlen(dir)));
+	krk_push(key);
 
-		krk_push(AS_LIST(modulePaths)->values[i]);
-		if (!IS_STRING(krk_peek(0))) {
-			*moduleOut = NONE_VAL();
+	KrkValue cached;
+	if (krk_tableGet(&vm.importDirs, key, &cached)) {
+		KrkTuple * listing = AS_TUPLE(cached);
+		if (AS_INTEGER(listing->values.values[0]) == seconds && AS_INTEGER(listing->values.values[1]) == nanoseconds) {
+			krk_pop();
+			return listing->values.values[2];
+		}
+	}
+
+	DIR * handle = opendir(dir);
+	if (!handle) {
+		krk_pop();
+		return NONE_VAL();
+	}
+
+	KrkValue names = krk_dict_of(0,NULL,0);
+	krk_push(names);
+	struct dirent * entry;
+	while ((entry = readdir(handle))) {
+		krk_push(OBJECT_VAL(krk_copyString(entry->d_name, strlen(entry->d_name))));
+		krk_tableSet(AS_DICT(names), krk_peek(0), BOOLEAN_VAL(1));
+		krk_pop();
+	}
+	closedir(handle);
+
+	KrkTuple * listing = krk_newTuple(3);
+	listing->values.values[listing->values.count++] = INTEGER_VAL(seconds);
+	listing->values.values[listing->values.count++] = INTEGER_VAL(nanoseconds);
+	listing->values.values[listing->values.count++] = names;
+	krk_push(OBJECT_VAL(listing));
+	if (time(NULL) - seconds > 1) krk_tableSet(&vm.importDirs, key, OBJECT_VAL(listing));
+	krk_pop(); /* listing */
+	krk_pop(); /* names */
+	krk_pop(); /* key */
+	return names;
+}
+
+/**
+ * Check whether @p path names something in the cached listing of its directory.
+ */
+static int moduleFileExists(char * path) {
+	char * sep = strrchr(path, PATH_SEP[0]);
+	const char * name = sep ? sep + 1 : path;
+	size_t length = strlen(name);
+	if (!length) return 0;
+
+	KrkValue names;
+	if (sep) {
+		char after = sep[1];
+		sep[1] = '\0';
+		names = directoryListing(path);
+		sep[1] = after;
+	} else {
+		names = directoryListing(".");
+	}
+
+	return !IS_NONE(names) && krk_tableFindString(AS_DICT(names), name, length, krk_hashBytes(name, length)) != NULL;
+}
+
+enum ModuleKind {
+	MODULE_NOT_FOUND,
+	MODULE_SOURCE,
+	MODULE_PACKAGE,
+	MODULE_SHARED,
+};
+
+/**
+ * Search the directories in kuroko.module_paths for the module at @p path, a name
+ * with its dots turned into path separators. If found, the file name is pushed and
+ * the kind of module is returned. Returns -1 with an exception set if the search
+ * paths are not usable.
+ */
+static int findModule(KrkString * path) {
+	KrkValue modulePaths;
+
+	/* Obtain __builtins__.module_paths */
+	if (!krk_tableGet_fast(&vm.system->fields, S("module_paths"), &modulePaths) || !IS_INSTANCE(modulePaths)) {
+		krk_runtimeError(vm.exceptions->importError,
+			"kuroko.module_paths not defined.");
+		return -1;
+	}
+
+	/* Obtain __builtins__.module_paths.__list so we can do lookups directly */
+	int moduleCount = AS_LIST(modulePaths)->count;
+	if (!moduleCount) {
+		krk_runtimeError(vm.exceptions->importError,
+			"No module search directories are specified, so no modules may be imported.");
+		return -1;
+	}
+
+	char * fileName = NULL;
+	size_t fileNameSize = 0;
+
+	for (int i = 0; i < moduleCount; ++i) {
+		KrkValue searchPath = AS_LIST(modulePaths)->values[i];
+		if (!IS_STRING(searchPath)) {
+			free(fileName);
 			krk_runtimeError(vm.exceptions->typeError,
 				"Module search paths must be strings; check the search path at index %d", i);
-			return 0;
+			return -1;
 		}
 
-		/* Try .../path/__init__.krk */
-		krk_push(OBJECT_VAL(path));
-		krk_addObjects();
-		krk_push(OBJECT_VAL(S(PATH_SEP "__init__.krk")));
-		krk_addObjects();
-		fileName = AS_CSTRING(krk_peek(0));
-		if (stat(fileName,&statbuf) == 0) {
-			isPackage = 1;
-			if (runAs == S("__main__")) {
-				krk_pop(); /* concatenated name */
-
-				/* Convert back to .-formatted */
-				krk_push(krk_valueGetAttribute(OBJECT_VAL(path), "replace"));
-				krk_push(OBJECT_VAL(S(PATH_SEP)));
-				krk_push(OBJECT_VAL(S(".")));
-				krk_push(krk_callStack(2));
-				KrkValue packageName = krk_peek(0);
-				krk_push(packageName);
-				krk_push(OBJECT_VAL(S(".")));
-				krk_addObjects();
-				krk_push(OBJECT_VAL(runAs));
-				krk_addObjects();
-
-				/* Try to import that. */
-				KrkValue dotted_main = krk_peek(0);
-				if (!krk_importModule(AS_STRING(dotted_main),runAs)) {
-					krk_runtimeError(vm.exceptions->importError, "No module named %s; '%s' is a package and cannot be executed directly",
-						AS_CSTRING(dotted_main), AS_CSTRING(packageName));
-					return 0;
-				}
+		size_t needed = AS_STRING(searchPath)->length + path->length + sizeof(PATH_SEP "__init__.krk");
+		if (needed > fileNameSize) {
+			fileNameSize = needed;
+			fileName = realloc(fileName, fileNameSize);
+		}
+		size_t base = snprintf(fileName, fileNameSize, "%s%s", AS_CSTRING(searchPath), path->chars);
+		int kind = MODULE_NOT_FOUND;
 
-				krk_swap(2);
-				krk_pop(); /* package name */
-				krk_pop(); /* dotted_main */
-				*moduleOut = krk_peek(0);
-				return 1;
-			}
-			goto _normalFile;
+		/* Try .../path/__init__.krk, if there is a .../path at all */
+		if (moduleFileExists(fileName)) {
+			snprintf(fileName + base, fileNameSize - base, "%s", PATH_SEP "__init__.krk");
+			if (moduleFileExists(fileName)) kind = MODULE_PACKAGE;
 		}
 
 #ifndef STATIC_ONLY
 		/* Try .../path.so */
-		krk_pop();
-		krk_push(AS_LIST(modulePaths)->values[i]);
-		krk_push(OBJECT_VAL(path));
-		krk_addObjects(); /* Concatenate path... */
-		krk_push(OBJECT_VAL(S(".so")));
-		krk_addObjects(); /* and file extension */
-		fileName = AS_CSTRING(krk_peek(0));
-		if (stat(fileName,&statbuf) == 0) {
-			goto _sharedObject;
+		if (!kind) {
+			snprintf(fileName + base, fileNameSize - base, "%s", ".so");
+			if (moduleFileExists(fileName)) kind = MODULE_SHARED;
 		}
 #endif
 
 		/* Try .../path.krk */
-		krk_pop();
-		krk_push(AS_LIST(modulePaths)->values[i]);
-		krk_push(OBJECT_VAL(path));
-		krk_addObjects(); /* Concatenate path... */
-		krk_push(OBJECT_VAL(S(".krk")));
-		krk_addObjects(); /* and file extension */
-		fileName = AS_CSTRING(krk_peek(0));
-		if (stat(fileName,&statbuf) == 0) {
-			goto _normalFile;
+		if (!kind) {
+			snprintf(fileName + base, fileNameSize - base, "%s", ".krk");
+			if (moduleFileExists(fileName)) kind = MODULE_SOURCE;
 		}
 
-		/* Try next search path */
-		continue;
+		if (kind) {
+			krk_push(OBJECT_VAL(krk_copyString(fileName, strlen(fileName))));
+			free(fileName);
+			return kind;
+		}
+	}
 
-	_normalFile: (void)0;
-		/* Compile and run the module in a new context and exit the VM when it
-		 * returns to the current call frame; modules should return objects. */
-		KrkInstance * enclosing = krk_currentThread.module;
-		krk_startModule(runAs->chars);
-		if (isPackage) {
-			krk_attachNamedValue(&krk_currentThread.module->fields,"__ispackage__",BOOLEAN_VAL(1));
-			/* For a module that is a package, __package__ is its own name */
-			krk_attachNamedValue(&krk_currentThread.module->fields,"__package__",OBJECT_VAL(runAs));
-		} else {
-			KrkValue parentName;
-			if (IS_INSTANCE(parent) && krk_tableGet_fast(&AS_INSTANCE(parent)->fields, S("__name__"), &parentName) && IS_STRING(parentName)) {
-				krk_attachNamedValue(&krk_currentThread.module->fields, "__package__", parentName);
-			} else {
-				/* If there is no parent, or the parent doesn't have a string __name__ attribute,
-				 * set the __package__ to None, so it at least exists. */
-				krk_attachNamedValue(&krk_currentThread.module->fields, "__package__", NONE_VAL());
-			}
+	free(fileName);
+	return MODULE_NOT_FOUND;
+}
+#endif
+
+/**
+ * Load a module.
+ *
+ * The module search path is stored in __builtins__.module_paths and should
+ * be a list of directories (with trailing forward-slash) to look at, in order,
+ * to resolve module names. krk source files will always take priority, so if
+ * a later search path has a krk source and an earlier search path has a shared
+ * object module, the later search path will still win.
+ */
+static int loadModule(KrkString * path, KrkValue * moduleOut, KrkString * runAs, KrkValue parent, KrkInstance * into);
+
+int krk_loadModule(KrkString * path, KrkValue * moduleOut, KrkString * runAs, KrkValue parent) {
+	/* See if the module is already loaded */
+	if (krk_tableGet_fast(&vm.modules, runAs, moduleOut)) {
+		if (IS_INSTANCE(*moduleOut) && AS_INSTANCE(*moduleOut)->_class == vm.baseClasses->lazyModuleClass) {
+			if (!resolveLazyModule(AS_INSTANCE(*moduleOut))) return 0;
 		}
-		krk_callfile(fileName,fileName);
-		*moduleOut = OBJECT_VAL(krk_currentThread.module);
-		krk_currentThread.module = enclosing;
-		if (!IS_OBJECT(*moduleOut)) {
-			if (!(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION)) {
-				krk_runtimeError(vm.exceptions->importError,
-					"Failed to load module '%s' from '%s'", runAs->chars, fileName);
-			}
+		krk_push(*moduleOut);
+		return 1;
+	}
+
+	if (!KRK_PROBE_ENABLED(import__start) && !KRK_PROBE_ENABLED(import__done)) {
+		return loadModule(path, moduleOut, runAs, parent, NULL);
+	}
+
+	KRK_PROBE(import__start, runAs->chars, path->chars);
+	int result = loadModule(path, moduleOut, runAs, parent, NULL);
+	KRK_PROBE(import__done, runAs->chars, path->chars, result);
+	return result;
+}
+
+static int loadModule(KrkString * path, KrkValue * moduleOut, KrkString * runAs, KrkValue parent, KrkInstance * into) {
+#ifndef NO_FILESYSTEM
+
+	/* Modules bundled in a startup image skip the search */
+	if (runAs != S("__main__")) {
+		int isPackage = 0;
+		const char * imageFile = krk_startupImageFind(path, &isPackage);
+		if (imageFile) {
+			krk_push(OBJECT_VAL(krk_copyString(imageFile, strlen(imageFile))));
+			if (!loadSourceModule(runAs, parent, isPackage, AS_CSTRING(krk_peek(0)), moduleOut, into)) return 0;
+			krk_pop(); /* filename */
+			krk_push(*moduleOut);
+			return 1;
+		}
+	}
+
+	int kind = findModule(path);
+	if (kind < 0) {
+		*moduleOut = NONE_VAL();
+		return 0;
+	}
+
+	if (kind == MODULE_PACKAGE && runAs == S("__main__")) {
+		krk_pop(); /* filename */
+
+		/* Convert back to .-formatted */
+		krk_push(krk_valueGetAttribute(OBJECT_VAL(path), "replace"));
+		krk_push(OBJECT_VAL(S(PATH_SEP)));
+		krk_push(OBJECT_VAL(S(".")));
+		krk_push(krk_callStack(2));
+		KrkValue packageName = krk_peek(0);
+		krk_push(packageName);
+		krk_push(OBJECT_VAL(S(".")));
+		krk_addObjects();
+		krk_push(OBJECT_VAL(runAs));
+		krk_addObjects();
+
+		/* Try to import that. */
+		KrkValue dotted_main = krk_peek(0);
+		if (!krk_importModule(AS_STRING(dotted_main),runAs)) {
+			krk_runtimeError(vm.exceptions->importError, "No module named %s; '%s' is a package and cannot be executed directly",
+				AS_CSTRING(dotted_main), AS_CSTRING(packageName));
 			return 0;
 		}
 
-		krk_pop(); /* concatenated filename on stack */
+		krk_swap(2);
+		krk_pop(); /* package name */
+		krk_pop(); /* dotted_main */
+		*moduleOut = krk_peek(0);
+		return 1;
+	}
+
+	if (kind == MODULE_SOURCE || kind == MODULE_PACKAGE) {
+		if (!loadSourceModule(runAs, parent, kind == MODULE_PACKAGE, AS_CSTRING(krk_peek(0)), moduleOut, into)) return 0;
+		krk_pop(); /* filename */
 		krk_push(*moduleOut);
 		return 1;
+	}
 
 #ifndef STATIC_ONLY
-	_sharedObject: (void)0;
-
+	if (kind == MODULE_SHARED) {
+		char * fileName = AS_CSTRING(krk_peek(0));
 		dlRefType dlRef = dlOpen(fileName);
 		if (!dlRef) {
 			*moduleOut = NONE_VAL();
@@ -1777,6 +2567,14 @@ int krk_loadModule(KrkString * path, KrkValue * moduleOut, KrkString * runAs, Kr
 			return 0;
 		}
 
+		/* A lazy module takes on what the shared object made, so references to it stay good. */
+		if (into) {
+			krk_push(*moduleOut);
+			krk_tableAddAll(&AS_INSTANCE(*moduleOut)->fields, &into->fields);
+			krk_pop();
+			*moduleOut = OBJECT_VAL(into);
+		}
+
 		krk_push(*moduleOut);
 		krk_swap(1);
 
@@ -1789,8 +2587,8 @@ int krk_loadModule(KrkString * path, KrkValue * moduleOut, KrkString * runAs, Kr
 		krk_pop(); /* filename */
 		krk_tableSet(&vm.modules, OBJECT_VAL(runAs), *moduleOut);
 		return 1;
-#endif
 	}
+#endif
 
 #endif
 
@@ -2011,6 +2809,64 @@ int krk_doRecursiveModuleLoad(KrkString * name) {
 	return krk_importModule(name,name);
 }
 
+/**
+ * Run the module a lazy import bound, in place, so every reference to it
+ * sees the loaded module. If it can not be loaded, it is left lazy and out
+ * of the module table, and the next lookup tries again.
+ */
+static int resolveLazyModule(KrkInstance * module) {
+	KrkValue name;
+	if (!krk_tableGet(&module->fields, vm.specialMethodNames[METHOD_NAME], &name) || !IS_STRING(name)) {
+		krk_runtimeError(vm.exceptions->importError, "lazy module has no name");
+		return 0;
+	}
+	size_t stackBefore = krk_currentThread.stackTop - krk_currentThread.stack;
+	krk_push(OBJECT_VAL(module));
+	module->_class = vm.baseClasses->moduleClass;
+	KrkValue out;
+	int loaded = loadModule(AS_STRING(name), &out, AS_STRING(name), NONE_VAL(), module) && !(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION);
+	if (!loaded) {
+		module->_class = vm.baseClasses->lazyModuleClass;
+		krk_tableDelete(&vm.modules, name);
+	}
+	krk_currentThread.stackTop = krk_currentThread.stack + stackBefore;
+	return loaded;
+}
+
+/**
+ * OP_IMPORT while lazy imports are enabled: find the module now, so a
+ * missing one is still an ImportError at the import statement, but leave
+ * running it to the first attribute lookup. Submodules, shared objects
+ * and modules that are already loaded are imported as usual.
+ */
+static int importLazily(KrkString * name) {
+	KrkValue module;
+	if (krk_tableGet_fast(&vm.modules, name, &module)) {
+		krk_push(module);
+		return 1;
+	}
+#ifndef NO_FILESYSTEM
+	if (memchr(name->chars, '.', name->length)) return krk_doRecursiveModuleLoad(name);
+
+	int isPackage = 0;
+	if (!krk_startupImageFind(name, &isPackage)) {
+		int kind = findModule(name);
+		if (kind < 0) return 0;
+		if (kind == MODULE_NOT_FOUND) return krk_doRecursiveModuleLoad(name);
+		krk_pop(); /* filename */
+		if (kind == MODULE_SHARED) return krk_doRecursiveModuleLoad(name);
+	}
+
+	KrkInstance * lazy = krk_newInstance(vm.baseClasses->lazyModuleClass);
+	krk_push(OBJECT_VAL(lazy));
+	krk_attachNamedObject(&lazy->fields, "__name__", (KrkObj*)name);
+	krk_tableSet(&vm.modules, OBJECT_VAL(name), OBJECT_VAL(lazy));
+	return 1;
+#else
+	return krk_doRecursiveModuleLoad(name);
+#endif
+}
+
 /**
  * Try to resolve and push [stack top].name.
  * If [stack top] is an instance, scan fields first.
@@ -2018,7 +2874,7 @@ int krk_doRecursiveModuleLoad(KrkString * name) {
  * Returns 0 if nothing was found, 1 if something was - and that
  * "something" will replace [stack top].
  */
-static int valueGetProperty(KrkString * name) {
+static int valueGetProperty(KrkString * name, KrkInlineCache * cache) {
 	KrkValue this = krk_peek(0);
 	KrkClass * objectClass;
 	KrkValue value;
@@ -2030,17 +2886,13 @@ static int valueGetProperty(KrkString * name) {
 		}
 		objectClass = instance->_class;
 	} else if (IS_CLASS(this)) {
-		KrkClass * _class = AS_CLASS(this);
-		do {
-			if (krk_tableGet_fast(&_class->methods, name, &value)) {
-				if ((IS_NATIVE(value) || IS_CLOSURE(value)) && (AS_OBJECT(value)->flags & KRK_OBJ_FLAGS_FUNCTION_IS_CLASS_METHOD)) {
-					value = OBJECT_VAL(krk_newBoundMethod(this, AS_OBJECT(value)));
-				}
-				krk_currentThread.stackTop[-1] = value;
-				return 1;
+		if (lookupClassAttribute(AS_CLASS(this), name, &value, cache)) {
+			if ((IS_NATIVE(value) || IS_CLOSURE(value)) && (AS_OBJECT(value)->flags & KRK_OBJ_FLAGS_FUNCTION_IS_CLASS_METHOD)) {
+				value = OBJECT_VAL(krk_newBoundMethod(this, AS_OBJECT(value)));
 			}
-			_class = _class->base;
-		} while (_class);
+			krk_currentThread.stackTop[-1] = value;
+			return 1;
+		}
 		objectClass = vm.baseClasses->typeClass;
 	} else if (IS_CLOSURE(krk_peek(0))) {
 		KrkClosure * closure = AS_CLOSURE(this);
@@ -2054,7 +2906,7 @@ static int valueGetProperty(KrkString * name) {
 	}
 
 	/* See if the base class for this non-instance type has a method available */
-	if (krk_bindMethod(objectClass, name)) {
+	if (bindMethod(objectClass, name, cache)) {
 		return 1;
 	}
 
@@ -2072,7 +2924,7 @@ static int valueGetProperty(KrkString * name) {
  * immediately called, eg. for GET_METHOD that is followed by argument pushing
  * and then CALL_METHOD.
  */
-static int valueGetMethod(KrkString * name) {
+static int valueGetMethod(KrkString * name, KrkInlineCache * cache) {
 	KrkValue this = krk_peek(0);
 	KrkClass * objectClass;
 	KrkValue value;
@@ -2084,18 +2936,14 @@ static int valueGetMethod(KrkString * name) {
 		}
 		objectClass = instance->_class;
 	} else if (IS_CLASS(this)) {
-		KrkClass * _class = AS_CLASS(this);
-		do {
-			if (krk_tableGet_fast(&_class->methods, name, &value)) {
-				if ((IS_CLOSURE(value)||IS_NATIVE(value)) && (AS_OBJECT(value)->flags & KRK_OBJ_FLAGS_FUNCTION_IS_CLASS_METHOD)) {
-					krk_push(value);
-					return 1;
-				}
+		if (lookupClassAttribute(AS_CLASS(this), name, &value, cache)) {
+			if ((IS_CLOSURE(value)||IS_NATIVE(value)) && (AS_OBJECT(value)->flags & KRK_OBJ_FLAGS_FUNCTION_IS_CLASS_METHOD)) {
 				krk_push(value);
-				return 2;
+				return 1;
 			}
-			_class = _class->base;
-		} while (_class);
+			krk_push(value);
+			return 2;
+		}
 		objectClass = vm.baseClasses->typeClass;
 	} else if (IS_CLOSURE(krk_peek(0))) {
 		KrkClosure * closure = AS_CLOSURE(this);
@@ -2109,7 +2957,7 @@ static int valueGetMethod(KrkString * name) {
 	}
 
 	/* See if the base class for this non-instance type has a method available */
-	int maybe = krk_unbindMethod(objectClass, name);
+	int maybe = unbindMethod(objectClass, name, cache);
 	if (maybe) return maybe;
 
 	if (objectClass->_getattr) {
@@ -2127,7 +2975,7 @@ static int valueGetMethod(KrkString * name) {
 KrkValue krk_valueGetAttribute(KrkValue value, char * name) {
 	krk_push(OBJECT_VAL(krk_copyString(name,strlen(name))));
 	krk_push(value);
-	if (!valueGetProperty(AS_STRING(krk_peek(1)))) {
+	if (!valueGetProperty(AS_STRING(krk_peek(1)), NULL)) {
 		return krk_runtimeError(vm.exceptions->attributeError, "'%s' object has no attribute '%s'", krk_typeName(krk_peek(0)), name);
 	}
 	krk_swap(1);
@@ -2138,7 +2986,7 @@ KrkValue krk_valueGetAttribute(KrkValue value, char * name) {
 KrkValue krk_valueGetAttribute_default(KrkValue value, char * name, KrkValue defaultVal) {
 	krk_push(OBJECT_VAL(krk_copyString(name,strlen(name))));
 	krk_push(value);
-	if (!valueGetProperty(AS_STRING(krk_peek(1)))) {
+	if (!valueGetProperty(AS_STRING(krk_peek(1)), NULL)) {
 		krk_pop();
 		krk_pop();
 		return defaultVal;
@@ -2152,7 +3000,12 @@ static int valueDelProperty(KrkString * name) {
 	if (IS_INSTANCE(krk_peek(0))) {
 		KrkInstance* instance = AS_INSTANCE(krk_peek(0));
 		if (!krk_tableDelete(&instance->fields, OBJECT_VAL(name))) {
-			return 0;
+			/* Deleting a slot puts it back to being unset. */
+			KrkValue member;
+			if (!instance->_class->slotsStart || !lookupClassAttribute(instance->_class, name, &member, NULL) || !IS_member(member)) return 0;
+			KrkValue * slot = krk_slotValue(instance, AS_member(member)->offset);
+			if (IS_KWARGS(*slot)) return 0;
+			*slot = KWARGS_VAL(0);
 		}
 		krk_pop(); /* the original value */
 		return 1;
@@ -2163,6 +3016,8 @@ static int valueDelProperty(KrkString * name) {
 		}
 		if (name->length > 1 && name->chars[0] == '_' && name->chars[1] == '_') {
 			krk_finalizeClass(_class);
+		} else {
+			krk_bumpClassVersion(_class);
 		}
 		krk_pop(); /* the original value */
 		return 1;
@@ -2181,14 +3036,9 @@ KrkValue krk_valueDelAttribute(KrkValue owner, char * name) {
 	return NONE_VAL();
 }
 
-static int trySetDescriptor(KrkValue owner, KrkString * name, KrkValue value) {
-	KrkClass * _class = krk_getType(owner);
+static int trySetDescriptor(KrkValue owner, KrkString * name, KrkValue value, KrkInlineCache * cache) {
 	KrkValue property;
-	while (_class) {
-		if (krk_tableGet_fast(&_class->methods, name, &property)) break;
-		_class = _class->base;
-	}
-	if (_class) {
+	if (lookupClassAttribute(krk_getType(owner), name, &property, cache)) {
 		KrkClass * type = krk_getType(property);
 		if (type->_descset) {
 			/* Need to rearrange arguments */
@@ -2202,12 +3052,24 @@ static int trySetDescriptor(KrkValue owner, KrkString * name, KrkValue value) {
 	return 0;
 }
 
-static int valueSetProperty(KrkString * name) {
+static int valueSetProperty(KrkString * name, KrkInlineCache * cache) {
 	KrkValue owner = krk_peek(1);
 	KrkValue value = krk_peek(0);
 	if (IS_INSTANCE(owner)) {
-		if (krk_tableSet(&AS_INSTANCE(owner)->fields, OBJECT_VAL(name), value)) {
-			if (trySetDescriptor(owner, name, value)) {
+		KrkInstance * instance = AS_INSTANCE(owner);
+		if (instance->_class->slotsStart) {
+			KrkValue member;
+			if (lookupClassAttribute(instance->_class, name, &member, cache) && IS_member(member)) {
+				*krk_slotValue(instance, AS_member(member)->offset) = value;
+				krk_gcWriteBarrier((KrkObj*)instance);
+				krk_swap(1);
+				krk_pop();
+				return 1;
+			}
+			if (instance->_class->obj.flags & KRK_OBJ_FLAGS_CLASS_NO_FIELDS) return trySetDescriptor(owner, name, value, cache);
+		}
+		if (krk_tableSet(&instance->fields, OBJECT_VAL(name), value)) {
+			if (trySetDescriptor(owner, name, value, cache)) {
 				krk_tableDelete(&AS_INSTANCE(owner)->fields, OBJECT_VAL(name));
 				return 1;
 			}
@@ -2217,17 +3079,19 @@ static int valueSetProperty(KrkString * name) {
 		if (name->length > 1 && name->chars[0] == '_' && name->chars[1] == '_') {
 			/* Quietly call finalizeClass to update special method table if this looks like it might be one */
 			krk_finalizeClass(AS_CLASS(owner));
+		} else {
+			krk_bumpClassVersion(AS_CLASS(owner));
 		}
 	} else if (IS_CLOSURE(owner)) {
 		/* Closures shouldn't have descriptors, but let's let this happen anyway... */
 		if (krk_tableSet(&AS_CLOSURE(owner)->fields, OBJECT_VAL(name), value)) {
-			if (trySetDescriptor(owner, name, value)) {
+			if (trySetDescriptor(owner, name, value, cache)) {
 				krk_tableDelete(&AS_CLOSURE(owner)->fields, OBJECT_VAL(name));
 				return 1;
 			}
 		}
 	} else {
-		return (trySetDescriptor(owner,name,value));
+		return (trySetDescriptor(owner,name,value,cache));
 	}
 	krk_swap(1);
 	krk_pop();
@@ -2238,7 +3102,7 @@ KrkValue krk_valueSetAttribute(KrkValue owner, char * name, KrkValue to) {
 	krk_push(OBJECT_VAL(krk_copyString(name,strlen(name))));
 	krk_push(owner);
 	krk_push(to);
-	if (!valueSetProperty(AS_STRING(krk_peek(2)))) {
+	if (!valueSetProperty(AS_STRING(krk_peek(2)), NULL)) {
 		return krk_runtimeError(vm.exceptions->attributeError, "'%s' object has no attribute '%s'", krk_typeName(krk_peek(1)), name);
 	}
 	krk_swap(1);
@@ -2248,40 +3112,193 @@ KrkValue krk_valueSetAttribute(KrkValue owner, char * name, KrkValue to) {
 
 #define BINARY_OP(op) { KrkValue b = krk_peek(0); KrkValue a = krk_peek(1); \
 	a = krk_operator_ ## op (a,b); \
-	krk_currentThread.stackTop[-2] = a; krk_pop(); break; }
+	krk_currentThread.stackTop[-2] = a; krk_pop(); DISPATCH(); }
 #define INPLACE_BINARY_OP(op) { KrkValue b = krk_peek(0); KrkValue a = krk_peek(1); \
 	a = krk_operator_i ## op (a,b); \
-	krk_currentThread.stackTop[-2] = a; krk_pop(); break; }
+	krk_currentThread.stackTop[-2] = a; krk_pop(); DISPATCH(); }
 
-/* These operations are most likely to occur on integers, so we special case them */
-#define LIKELY_INT_BINARY_OP(op,operator) { KrkValue b = krk_peek(0); KrkValue a = krk_peek(1); \
-	if (likely(IS_INTEGER(a) && IS_INTEGER(b))) a = INTEGER_VAL(AS_INTEGER(a) operator AS_INTEGER(b)); \
-	else a = krk_operator_ ## op (a,b); \
-	krk_currentThread.stackTop[-2] = a; krk_pop(); break; }
+/*
+ * Quickening: the generic arithmetic and comparison instructions look at their
+ * operands and overwrite their own opcode with a form specialized for those
+ * types. Specialized forms check their guard and, on a miss, put the generic
+ * opcode back before falling back to the full operator lookup.
+ */
+#define QUICKEN(opc) (frame->ip[-1] = (opc))
+#define BOTH_INT(a,b) (IS_INTEGER(a) && IS_INTEGER(b))
+#define SOME_FLOAT(a,b) (IS_FLOATING(a) ? (IS_FLOATING(b) || IS_INTEGER(b)) : (IS_INTEGER(a) && IS_FLOATING(b)))
+#define BOTH_NUMBER(a,b) (BOTH_INT(a,b) || SOME_FLOAT(a,b))
+#define AS_DOUBLE(v) (IS_FLOATING(v) ? AS_FLOATING(v) : (double)AS_INTEGER(v))
+#define TRY_INT(opc) if (BOTH_INT(a,b)) QUICKEN(opc ## _INT)
+#define TRY_NUMBER(opc) if (BOTH_INT(a,b)) QUICKEN(opc ## _INT); else if (SOME_FLOAT(a,b)) QUICKEN(opc ## _FLOAT)
+#define TRY_STR(opc) if (IS_STRING(a) && IS_STRING(b)) QUICKEN(opc ## _STR)
+
+#define QUICKENING_OP(op,rewrite) { KrkValue b = krk_peek(0); KrkValue a = krk_peek(1); \
+	rewrite; \
+	krk_escapeValue(a); \
+	a = krk_operator_ ## op (a,b); \
+	krk_currentThread.stackTop[-2] = a; krk_pop(); DISPATCH(); }
+
+#define SPECIALIZED_OP(generic,op,guard,result) { KrkValue b = krk_peek(0); KrkValue a = krk_peek(1); \
+	if (likely(guard)) a = result; \
+	else { QUICKEN(generic); krk_escapeValue(a); a = krk_operator_ ## op (a,b); } \
+	krk_currentThread.stackTop[-2] = a; krk_pop(); DISPATCH(); }
+#define INT_OP(generic,op,operator,wrap) SPECIALIZED_OP(generic,op,BOTH_INT(a,b),wrap(AS_INTEGER(a) operator AS_INTEGER(b)))
+#define FLOAT_OP(generic,op,operator,wrap) SPECIALIZED_OP(generic,op,SOME_FLOAT(a,b),wrap(AS_DOUBLE(a) operator AS_DOUBLE(b)))
+#define STR_OP(generic,op) { \
+	if (likely(IS_STRING(krk_peek(0)) && IS_STRING(krk_peek(1)))) { krk_addObjects(); DISPATCH(); } \
+	QUICKEN(generic); \
+	krk_escapeValue(krk_peek(1)); \
+	KrkValue a = krk_operator_ ## op (krk_peek(1),krk_peek(0)); \
+	krk_currentThread.stackTop[-2] = a; krk_pop(); DISPATCH(); }
 
-/* Comparators like these are almost definitely going to happen on integers. */
-#define LIKELY_INT_COMPARE_OP(op,operator) { KrkValue b = krk_peek(0); KrkValue a = krk_peek(1); \
-	if (likely(IS_INTEGER(a) && IS_INTEGER(b))) a = BOOLEAN_VAL(AS_INTEGER(a) operator AS_INTEGER(b)); \
-	else a = krk_operator_ ## op (a,b); \
-	krk_currentThread.stackTop[-2] = a; krk_pop(); break; }
+/**
+ * The local that the result of @c += is stored straight back into, if the
+ * next instructions are that store and nothing else, so the result is only
+ * referenced from there once they have run.
+ */
+static inline KrkValue * appendTarget(KrkCallFrame * frame) {
+	size_t slot;
+	if (frame->ip[0] == OP_SET_LOCAL_POP) slot = frame->ip[1];
+	else if (frame->ip[0] == OP_SET_LOCAL && frame->ip[2] == OP_POP) slot = frame->ip[1];
+	else return NULL;
+	return &krk_currentThread.stack[frame->slots + slot];
+}
 
 #define READ_BYTE() (*frame->ip++)
 #define READ_CONSTANT(s) (frame->closure->function->chunk.constants.values[OPERAND])
 #define READ_STRING(s) AS_STRING(READ_CONSTANT(s))
 
+/**
+ * Get the lookup cache for the property or global instruction whose name is the
+ * constant at @p index. The caches were allocated when the code object was quickened.
+ */
+static inline KrkInlineCache * inlineCache(KrkCodeObject * function, size_t index) {
+	return &function->inlineCaches[index];
+}
+
 extern FUNC_SIG(list,append);
 extern FUNC_SIG(dict,__setitem__);
 extern FUNC_SIG(set,add);
 
+/*
+ * GCC and clang support taking the address of a label, which lets us jump
+ * directly from the end of one instruction to the start of the next instead
+ * of bouncing through the switch. This can be disabled with KRK_NO_COMPUTED_GOTO.
+ */
+#if !defined(KRK_NO_COMPUTED_GOTO) && defined(__GNUC__) && !defined(__TINYC__)
+# define USE_COMPUTED_GOTO
+#endif
+
+#ifdef KRK_OPCODE_STATS
+# define COUNT_OPCODE() do { \
+	krk_opcodeCounts[opcode]++; \
+	krk_opcodePairCounts[lastOpcode][opcode]++; \
+	lastOpcode = opcode; \
+	frame->closure->function->instructionCount++; \
+	} while (0)
+#else
+# define COUNT_OPCODE() do { } while (0)
+#endif
+
+/* Thread flags that need the VM to stop at the next instruction boundary. */
+#define HOOK_FLAGS (KRK_THREAD_ENABLE_TRACING | KRK_THREAD_SINGLE_STEP | KRK_THREAD_SIGNALLED | KRK_THREAD_PROFILE_SAMPLE | KRK_THREAD_LINE_PROFILE | KRK_THREAD_GC_CALLBACKS)
+/* Another thread wants to collect garbage, which is also checked at the same boundaries. */
+#define HOOKS_PENDING() ((krk_currentThread.flags & HOOK_FLAGS) || vm.safepointRequested)
+
+#ifndef KRK_NO_TRACING
+/* Line profiling is per function, so the hook flag follows whichever frame is current. */
+# define SYNC_LINE_PROFILE(frame) do { \
+	if (unlikely((frame)->closure->function->obj.flags & KRK_OBJ_FLAGS_CODEOBJECT_LINE_PROFILE)) krk_currentThread.flags |= KRK_THREAD_LINE_PROFILE; \
+	else krk_currentThread.flags &= ~(KRK_THREAD_LINE_PROFILE); \
+	} while (0)
+#else
+# define SYNC_LINE_PROFILE(frame) do { } while (0)
+#endif
+
+#ifdef USE_COMPUTED_GOTO
+# pragma GCC diagnostic push
+# pragma GCC diagnostic ignored "-Wpedantic"
+/* The dispatch tables default every slot to _invalidOpcode before filling in real handlers. */
+# ifdef __clang__
+#  pragma GCC diagnostic ignored "-Winitializer-overrides"
+# else
+#  pragma GCC diagnostic ignored "-Woverride-init"
+# endif
+/* Every instruction is also a label, and handlers jump straight to the next one. */
+# define TARGET(opc) case opc: _ ## opc:
+# define DISPATCH() { \
+	if (unlikely(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION)) goto _finishException; \
+	opcode = READ_BYTE(); OPERAND = 0; \
+	if (dispatch == opcodeTable) COUNT_OPCODE(); \
+	goto *dispatch[opcode]; }
+# ifndef KRK_NO_TRACING
+/* Swap in the table that sends every instruction back through the tracing/debugger/signal checks. */
+#  define CHECK_HOOKS() do { \
+	dispatch = HOOKS_PENDING() ? hookTable : opcodeTable; \
+	} while (0)
+# else
+#  define CHECK_HOOKS() do { } while (0)
+# endif
+#else
+# define TARGET(opc) case opc:
+# define DISPATCH() break
+# define CHECK_HOOKS() do { } while (0)
+#endif
+
 /**
  * VM main loop.
  */
 static KrkValue run() {
 	KrkCallFrame* frame = &krk_currentThread.frames[krk_currentThread.frameCount - 1];
+	KrkOpCode opcode;
+	int OPERAND;
+#ifdef KRK_OPCODE_STATS
+	KrkOpCode lastOpcode = OP_NONE;
+#endif
+
+#ifdef USE_COMPUTED_GOTO
+#define SIMPLE(opc) [opc] = &&_ ## opc,
+#define CONSTANT(opc,more) [opc] = &&_ ## opc, [opc ## _LONG] = &&_ ## opc ## _LONG,
+#define OPERANDB(opc,more) [opc] = &&_ ## opc,
+#define OPERAND(opc,more) [opc] = &&_ ## opc, [opc ## _LONG] = &&_ ## opc ## _LONG,
+#define JUMP(opc,sign) [opc] = &&_ ## opc,
+	static void * const opcodeTable[256] = {
+		[0 ... 255] = &&_invalidOpcode,
+#include "opcodes.h"
+	};
+#undef SIMPLE
+#undef CONSTANT
+#undef OPERANDB
+#undef OPERAND
+#undef JUMP
+# ifndef KRK_NO_TRACING
+#define SIMPLE(opc) [opc] = &&_instrumented,
+#define CONSTANT(opc,more) [opc] = &&_instrumented, [opc ## _LONG] = &&_instrumented,
+#define OPERANDB(opc,more) [opc] = &&_instrumented,
+#define OPERAND(opc,more) [opc] = &&_instrumented, [opc ## _LONG] = &&_instrumented,
+#define JUMP(opc,sign) [opc] = &&_instrumented,
+	static void * const hookTable[256] = {
+		[0 ... 255] = &&_invalidOpcode,
+#include "opcodes.h"
+	};
+#undef SIMPLE
+#undef CONSTANT
+#undef OPERANDB
+#undef OPERAND
+#undef JUMP
+# endif
+	void * const * dispatch = opcodeTable;
+#endif
+
+	SYNC_LINE_PROFILE(frame);
 
 	while (1) {
 #ifndef KRK_NO_TRACING
-		if (unlikely(krk_currentThread.flags & (KRK_THREAD_ENABLE_TRACING | KRK_THREAD_SINGLE_STEP | KRK_THREAD_SIGNALLED))) {
+		if (unlikely(HOOKS_PENDING())) {
+			if (vm.safepointRequested) {
+				krk_safepoint();
+			}
+
 			if (krk_currentThread.flags & KRK_THREAD_ENABLE_TRACING) {
 				krk_debug_dumpStack(stderr, frame);
 				krk_disassembleInstruction(stderr, frame->closure->function,
@@ -2292,6 +3309,20 @@ static KrkValue run() {
 				krk_debuggerHook(frame);
 			}
 
+			if (krk_currentThread.flags & KRK_THREAD_PROFILE_SAMPLE) {
+				krk_currentThread.flags &= ~(KRK_THREAD_PROFILE_SAMPLE);
+				krk_profilerSample();
+			}
+
+			if (krk_currentThread.flags & KRK_THREAD_LINE_PROFILE) {
+				krk_lineProfileHook(frame);
+			}
+
+			if (krk_currentThread.flags & KRK_THREAD_GC_CALLBACKS) {
+				krk_runGCCallbacks();
+				if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) goto _finishException;
+			}
+
 			if (krk_currentThread.flags & KRK_THREAD_SIGNALLED) {
 				krk_currentThread.flags &= ~(KRK_THREAD_SIGNALLED); /* Clear signal flag */
 				krk_runtimeError(vm.exceptions->keyboardInterrupt, "Keyboard interrupt.");
@@ -2299,11 +3330,30 @@ static KrkValue run() {
 			}
 		}
 _resumeHook: (void)0;
+		CHECK_HOOKS();
+#else
+		if (unlikely(vm.safepointRequested)) krk_safepoint();
+		if (unlikely(krk_currentThread.flags & KRK_THREAD_GC_CALLBACKS)) {
+			krk_runGCCallbacks();
+			if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) goto _finishException;
+		}
 #endif
 
 		/* Each instruction begins with one opcode byte */
-		KrkOpCode opcode = READ_BYTE();
-		int OPERAND = 0;
+		opcode = READ_BYTE();
+		OPERAND = 0;
+		COUNT_OPCODE();
+
+#ifdef USE_COMPUTED_GOTO
+		/* Hooks for this instruction have already run, so skip straight to it. */
+		goto *opcodeTable[opcode];
+# ifndef KRK_NO_TRACING
+_instrumented:
+		/* Step back onto the opcode byte and let the top of the loop handle it. */
+		frame->ip--;
+		continue;
+# endif
+#endif
 
 /* Only GCC lets us put these on empty statements; just hope clang doesn't start complaining */
 #ifndef __clang__
@@ -2317,7 +3367,7 @@ _resumeHook: (void)0;
 #define ONE_BYTE_OPERAND { OPERAND |= READ_BYTE(); }
 
 		switch (opcode) {
-			case OP_CLEANUP_WITH: {
+			TARGET(OP_CLEANUP_WITH) {
 				/* Top of stack is a HANDLER that should have had something loaded into it if it was still valid */
 				KrkValue handler = krk_peek(0);
 				KrkValue exceptionObject = krk_peek(1);
@@ -2346,29 +3396,32 @@ _resumeHook: (void)0;
 					krk_callDirect(type->_exit, 4);
 					if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) goto _finishException;
 				}
-				if (AS_HANDLER_TYPE(handler) != OP_RETURN) break;
+				if (AS_HANDLER_TYPE(handler) != OP_RETURN) DISPATCH();
 				krk_pop(); /* handler */
-			} /* fallthrough */
-			case OP_RETURN: {
+			} FALLTHROUGH
+			TARGET(OP_RETURN) {
 _finishReturn: (void)0;
 				KrkValue result = krk_pop();
 				closeUpvalues(frame->slots);
-				/* See if this frame had a thing */
-				int stackOffset;
-				for (stackOffset = (int)(krk_currentThread.stackTop - krk_currentThread.stack - 1);
-					stackOffset >= (int)frame->slots && 
-					!IS_WITH_HANDLER(krk_currentThread.stack[stackOffset]) &&
-					!IS_TRY_HANDLER(krk_currentThread.stack[stackOffset]) &&
-					!IS_EXCEPT_HANDLER(krk_currentThread.stack[stackOffset])
-					; stackOffset--);
-				if (stackOffset >= (int)frame->slots) {
-					krk_currentThread.stackTop = &krk_currentThread.stack[stackOffset + 1];
-					frame->ip = frame->closure->function->chunk.code + AS_HANDLER_TARGET(krk_peek(0));
-					krk_currentThread.stackTop[-1] = HANDLER_VAL(OP_RETURN,AS_HANDLER_TARGET(krk_peek(0)));
-					krk_currentThread.stackTop[-2] = result;
-					break;
+				/* Only instructions inside a try or with can have a handler for this frame */
+				if (krk_inHandlerRegion(&frame->closure->function->chunk, frame->ip - frame->closure->function->chunk.code - 1)) {
+					int stackOffset;
+					for (stackOffset = (int)(krk_currentThread.stackTop - krk_currentThread.stack - 1);
+						stackOffset >= (int)frame->slots &&
+						!IS_WITH_HANDLER(krk_currentThread.stack[stackOffset]) &&
+						!IS_TRY_HANDLER(krk_currentThread.stack[stackOffset]) &&
+						!IS_EXCEPT_HANDLER(krk_currentThread.stack[stackOffset])
+						; stackOffset--);
+					if (stackOffset >= (int)frame->slots) {
+						krk_currentThread.stackTop = &krk_currentThread.stack[stackOffset + 1];
+						frame->ip = frame->closure->function->chunk.code + AS_HANDLER_TARGET(krk_peek(0));
+						krk_currentThread.stackTop[-1] = HANDLER_VAL(OP_RETURN,AS_HANDLER_TARGET(krk_peek(0)));
+						krk_currentThread.stackTop[-2] = result;
+						DISPATCH();
+					}
 				}
 				FRAME_OUT(frame);
+				PROBE_RETURN(frame);
 				krk_currentThread.frameCount--;
 				if (krk_currentThread.frameCount == 0) {
 					krk_pop();
@@ -2384,70 +3437,112 @@ _finishReturn: (void)0;
 				}
 				krk_push(result);
 				frame = &krk_currentThread.frames[krk_currentThread.frameCount - 1];
-				break;
+				SYNC_LINE_PROFILE(frame);
+				CHECK_HOOKS();
+				DISPATCH();
 			}
-			case OP_EQUAL: {
+			TARGET(OP_EQUAL) {
 				KrkValue b = krk_pop();
 				KrkValue a = krk_pop();
 				krk_push(BOOLEAN_VAL(krk_valuesEqual(a,b)));
-				break;
+				DISPATCH();
 			}
-			case OP_IS: {
+			TARGET(OP_IS) {
 				KrkValue b = krk_pop();
 				KrkValue a = krk_pop();
 				krk_push(BOOLEAN_VAL(krk_valuesSame(a,b)));
-				break;
+				DISPATCH();
 			}
-			case OP_LESS:          LIKELY_INT_COMPARE_OP(lt,<)
-			case OP_GREATER:       LIKELY_INT_COMPARE_OP(gt,>)
-			case OP_LESS_EQUAL:    LIKELY_INT_COMPARE_OP(le,<=)
-			case OP_GREATER_EQUAL: LIKELY_INT_COMPARE_OP(ge,>=)
-			case OP_ADD:           LIKELY_INT_BINARY_OP(add,+)
-			case OP_SUBTRACT:      LIKELY_INT_BINARY_OP(sub,-)
-			case OP_MULTIPLY:      BINARY_OP(mul)
-			case OP_DIVIDE:        BINARY_OP(truediv)
-			case OP_FLOORDIV:      BINARY_OP(floordiv)
-			case OP_MODULO:        BINARY_OP(mod)
-			case OP_BITOR:         BINARY_OP(or)
-			case OP_BITXOR:        BINARY_OP(xor)
-			case OP_BITAND:        BINARY_OP(and)
-			case OP_SHIFTLEFT:     BINARY_OP(lshift)
-			case OP_SHIFTRIGHT:    BINARY_OP(rshift)
-			case OP_POW:           BINARY_OP(pow)
-			case OP_BITNEGATE: {
+			TARGET(OP_LESS)          QUICKENING_OP(lt, TRY_NUMBER(OP_LESS))
+			TARGET(OP_GREATER)       QUICKENING_OP(gt, TRY_NUMBER(OP_GREATER))
+			TARGET(OP_LESS_EQUAL)    QUICKENING_OP(le, TRY_NUMBER(OP_LESS_EQUAL))
+			TARGET(OP_GREATER_EQUAL) QUICKENING_OP(ge, TRY_NUMBER(OP_GREATER_EQUAL))
+			TARGET(OP_ADD)           QUICKENING_OP(add, TRY_NUMBER(OP_ADD); else TRY_STR(OP_ADD))
+			TARGET(OP_SUBTRACT)      QUICKENING_OP(sub, TRY_NUMBER(OP_SUBTRACT))
+			TARGET(OP_MULTIPLY)      QUICKENING_OP(mul, TRY_NUMBER(OP_MULTIPLY))
+			TARGET(OP_DIVIDE)        QUICKENING_OP(truediv, if (BOTH_NUMBER(a,b)) QUICKEN(OP_DIVIDE_FLOAT))
+			TARGET(OP_FLOORDIV)      BINARY_OP(floordiv)
+			TARGET(OP_MODULO)        QUICKENING_OP(mod, TRY_INT(OP_MODULO))
+			TARGET(OP_BITOR)         QUICKENING_OP(or, TRY_INT(OP_BITOR))
+			TARGET(OP_BITXOR)        QUICKENING_OP(xor, TRY_INT(OP_BITXOR))
+			TARGET(OP_BITAND)        QUICKENING_OP(and, TRY_INT(OP_BITAND))
+			TARGET(OP_SHIFTLEFT)     BINARY_OP(lshift)
+			TARGET(OP_SHIFTRIGHT)    BINARY_OP(rshift)
+			TARGET(OP_POW)           BINARY_OP(pow)
+			TARGET(OP_BITNEGATE) {
 				KrkValue value = krk_pop();
 				if (IS_INTEGER(value)) krk_push(INTEGER_VAL(~AS_INTEGER(value)));
 				else { krk_runtimeError(vm.exceptions->typeError, "Incompatible operand type for %s negation.", "bit"); goto _finishException; }
-				break;
+				DISPATCH();
 			}
-			case OP_NEGATE: {
+			TARGET(OP_NEGATE) {
 				KrkValue value = krk_pop();
 				if (IS_INTEGER(value)) krk_push(INTEGER_VAL(-AS_INTEGER(value)));
 				else if (IS_FLOATING(value)) krk_push(FLOATING_VAL(-AS_FLOATING(value)));
 				else { krk_runtimeError(vm.exceptions->typeError, "Incompatible operand type for %s negation.", "prefix"); goto _finishException; }
-				break;
+				DISPATCH();
 			}
-			case OP_NONE:  krk_push(NONE_VAL()); break;
-			case OP_TRUE:  krk_push(BOOLEAN_VAL(1)); break;
-			case OP_FALSE: krk_push(BOOLEAN_VAL(0)); break;
-			case OP_UNSET: krk_push(KWARGS_VAL(0)); break;
-			case OP_NOT:   krk_push(BOOLEAN_VAL(krk_isFalsey(krk_pop()))); break;
-			case OP_POP:   krk_pop(); break;
-
-			case OP_INPLACE_ADD:        INPLACE_BINARY_OP(add)
-			case OP_INPLACE_SUBTRACT:   INPLACE_BINARY_OP(sub)
-			case OP_INPLACE_MULTIPLY:   INPLACE_BINARY_OP(mul)
-			case OP_INPLACE_DIVIDE:     INPLACE_BINARY_OP(truediv)
-			case OP_INPLACE_FLOORDIV:   INPLACE_BINARY_OP(floordiv)
-			case OP_INPLACE_MODULO:     INPLACE_BINARY_OP(mod)
-			case OP_INPLACE_BITOR:      INPLACE_BINARY_OP(or)
-			case OP_INPLACE_BITXOR:     INPLACE_BINARY_OP(xor)
-			case OP_INPLACE_BITAND:     INPLACE_BINARY_OP(and)
-			case OP_INPLACE_SHIFTLEFT:  INPLACE_BINARY_OP(lshift)
-			case OP_INPLACE_SHIFTRIGHT: INPLACE_BINARY_OP(rshift)
-			case OP_INPLACE_POW:        INPLACE_BINARY_OP(pow)
-
-			case OP_RAISE: {
+			TARGET(OP_NONE)  krk_push(NONE_VAL()); DISPATCH();
+			TARGET(OP_TRUE)  krk_push(BOOLEAN_VAL(1)); DISPATCH();
+			TARGET(OP_FALSE) krk_push(BOOLEAN_VAL(0)); DISPATCH();
+			TARGET(OP_UNSET) krk_push(KWARGS_VAL(0)); DISPATCH();
+			TARGET(OP_NOT)   krk_push(BOOLEAN_VAL(krk_isFalsey(krk_pop()))); DISPATCH();
+			TARGET(OP_POP)   krk_pop(); DISPATCH();
+
+			TARGET(OP_INPLACE_ADD)        QUICKENING_OP(iadd, TRY_NUMBER(OP_INPLACE_ADD); else TRY_STR(OP_INPLACE_ADD))
+			TARGET(OP_INPLACE_SUBTRACT)   QUICKENING_OP(isub, TRY_NUMBER(OP_INPLACE_SUBTRACT))
+			TARGET(OP_INPLACE_MULTIPLY)   QUICKENING_OP(imul, TRY_NUMBER(OP_INPLACE_MULTIPLY))
+			TARGET(OP_INPLACE_DIVIDE)     INPLACE_BINARY_OP(truediv)
+			TARGET(OP_INPLACE_FLOORDIV)   INPLACE_BINARY_OP(floordiv)
+			TARGET(OP_INPLACE_MODULO)     INPLACE_BINARY_OP(mod)
+			TARGET(OP_INPLACE_BITOR)      INPLACE_BINARY_OP(or)
+			TARGET(OP_INPLACE_BITXOR)     INPLACE_BINARY_OP(xor)
+			TARGET(OP_INPLACE_BITAND)     INPLACE_BINARY_OP(and)
+			TARGET(OP_INPLACE_SHIFTLEFT)  INPLACE_BINARY_OP(lshift)
+			TARGET(OP_INPLACE_SHIFTRIGHT) INPLACE_BINARY_OP(rshift)
+			TARGET(OP_INPLACE_POW)        INPLACE_BINARY_OP(pow)
+
+			TARGET(OP_ADD_INT)                INT_OP(OP_ADD, add, +, INTEGER_VAL)
+			TARGET(OP_ADD_FLOAT)              FLOAT_OP(OP_ADD, add, +, FLOATING_VAL)
+			TARGET(OP_ADD_STR)                STR_OP(OP_ADD, add)
+			TARGET(OP_SUBTRACT_INT)           INT_OP(OP_SUBTRACT, sub, -, INTEGER_VAL)
+			TARGET(OP_SUBTRACT_FLOAT)         FLOAT_OP(OP_SUBTRACT, sub, -, FLOATING_VAL)
+			TARGET(OP_MULTIPLY_INT)           INT_OP(OP_MULTIPLY, mul, *, INTEGER_VAL)
+			TARGET(OP_MULTIPLY_FLOAT)         FLOAT_OP(OP_MULTIPLY, mul, *, FLOATING_VAL)
+			TARGET(OP_DIVIDE_FLOAT)           SPECIALIZED_OP(OP_DIVIDE, truediv, BOTH_NUMBER(a,b) && AS_DOUBLE(b) != 0.0, FLOATING_VAL(AS_DOUBLE(a) / AS_DOUBLE(b)))
+			TARGET(OP_MODULO_INT)             SPECIALIZED_OP(OP_MODULO, mod, BOTH_INT(a,b) && AS_INTEGER(b) != 0, INTEGER_VAL(AS_INTEGER(a) % AS_INTEGER(b)))
+			TARGET(OP_BITAND_INT)             INT_OP(OP_BITAND, and, &, INTEGER_VAL)
+			TARGET(OP_BITOR_INT)              INT_OP(OP_BITOR, or, |, INTEGER_VAL)
+			TARGET(OP_BITXOR_INT)             INT_OP(OP_BITXOR, xor, ^, INTEGER_VAL)
+			TARGET(OP_LESS_INT)               INT_OP(OP_LESS, lt, <, BOOLEAN_VAL)
+			TARGET(OP_LESS_FLOAT)             FLOAT_OP(OP_LESS, lt, <, BOOLEAN_VAL)
+			TARGET(OP_GREATER_INT)            INT_OP(OP_GREATER, gt, >, BOOLEAN_VAL)
+			TARGET(OP_GREATER_FLOAT)          FLOAT_OP(OP_GREATER, gt, >, BOOLEAN_VAL)
+			TARGET(OP_LESS_EQUAL_INT)         INT_OP(OP_LESS_EQUAL, le, <=, BOOLEAN_VAL)
+			TARGET(OP_LESS_EQUAL_FLOAT)       FLOAT_OP(OP_LESS_EQUAL, le, <=, BOOLEAN_VAL)
+			TARGET(OP_GREATER_EQUAL_INT)      INT_OP(OP_GREATER_EQUAL, ge, >=, BOOLEAN_VAL)
+			TARGET(OP_GREATER_EQUAL_FLOAT)    FLOAT_OP(OP_GREATER_EQUAL, ge, >=, BOOLEAN_VAL)
+			TARGET(OP_INPLACE_ADD_INT)        INT_OP(OP_INPLACE_ADD, iadd, +, INTEGER_VAL)
+			TARGET(OP_INPLACE_ADD_FLOAT)      FLOAT_OP(OP_INPLACE_ADD, iadd, +, FLOATING_VAL)
+			TARGET(OP_INPLACE_ADD_STR) {
+				if (likely(IS_STRING(krk_peek(0)) && IS_STRING(krk_peek(1)))) {
+					KrkValue * target = appendTarget(frame);
+					if (target) {
+						KrkString * result = krk_appendString(AS_STRING(krk_peek(1)), AS_STRING(krk_peek(0)),
+							krk_valuesSame(*target, krk_peek(1)));
+						krk_currentThread.stackTop[-2] = OBJECT_VAL(result);
+						krk_pop();
+						DISPATCH();
+					}
+				}
+				STR_OP(OP_INPLACE_ADD, iadd)
+			}
+			TARGET(OP_INPLACE_SUBTRACT_INT)   INT_OP(OP_INPLACE_SUBTRACT, isub, -, INTEGER_VAL)
+			TARGET(OP_INPLACE_SUBTRACT_FLOAT) FLOAT_OP(OP_INPLACE_SUBTRACT, isub, -, FLOATING_VAL)
+			TARGET(OP_INPLACE_MULTIPLY_INT)   INT_OP(OP_INPLACE_MULTIPLY, imul, *, INTEGER_VAL)
+			TARGET(OP_INPLACE_MULTIPLY_FLOAT) FLOAT_OP(OP_INPLACE_MULTIPLY, imul, *, FLOATING_VAL)
+
+			TARGET(OP_RAISE) {
 				if (IS_CLASS(krk_peek(0))) {
 					krk_currentThread.currentException = krk_callStack(0);
 				} else {
@@ -2457,11 +3552,11 @@ _finishReturn: (void)0;
 				krk_currentThread.flags |= KRK_THREAD_HAS_EXCEPTION;
 				goto _finishException;
 			}
-			case OP_CLOSE_UPVALUE:
+			TARGET(OP_CLOSE_UPVALUE)
 				closeUpvalues((krk_currentThread.stackTop - krk_currentThread.stack)-1);
 				krk_pop();
-				break;
-			case OP_INVOKE_GETTER: {
+				DISPATCH();
+			TARGET(OP_INVOKE_GETTER) {
 				KrkClass * type = krk_getType(krk_peek(1));
 				if (likely(type->_getter != NULL)) {
 					krk_push(krk_callDirect(type->_getter, 2));
@@ -2470,9 +3565,9 @@ _finishReturn: (void)0;
 				} else {
 					krk_runtimeError(vm.exceptions->attributeError, "'%s' object is not subscriptable", krk_typeName(krk_peek(1)));
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_INVOKE_SETTER: {
+			TARGET(OP_INVOKE_SETTER) {
 				KrkClass * type = krk_getType(krk_peek(2));
 				if (likely(type->_setter != NULL)) {
 					krk_push(krk_callDirect(type->_setter, 3));
@@ -2483,9 +3578,9 @@ _finishReturn: (void)0;
 						krk_runtimeError(vm.exceptions->attributeError, "'%s' object is not subscriptable", krk_typeName(krk_peek(2)));
 					}
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_INVOKE_DELETE: {
+			TARGET(OP_INVOKE_DELETE) {
 				KrkClass * type = krk_getType(krk_peek(1));
 				if (likely(type->_delitem != NULL)) {
 					krk_callDirect(type->_delitem, 2);
@@ -2496,18 +3591,18 @@ _finishReturn: (void)0;
 						krk_runtimeError(vm.exceptions->attributeError, "'%s' object is not subscriptable", krk_typeName(krk_peek(1)));
 					}
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_INVOKE_ITER: {
+			TARGET(OP_INVOKE_ITER) {
 				KrkClass * type = krk_getType(krk_peek(0));
 				if (likely(type->_iter != NULL)) {
 					krk_push(krk_callDirect(type->_iter, 1));
 				} else {
 					krk_runtimeError(vm.exceptions->attributeError, "'%s' object is not iterable", krk_typeName(krk_peek(0)));
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_INVOKE_CONTAINS: {
+			TARGET(OP_INVOKE_CONTAINS) {
 				KrkClass * type = krk_getType(krk_peek(0));
 				if (likely(type->_contains != NULL)) {
 					krk_swap(1);
@@ -2515,19 +3610,20 @@ _finishReturn: (void)0;
 				} else {
 					krk_runtimeError(vm.exceptions->attributeError, "'%s' object can not be tested for membership", krk_typeName(krk_peek(0)));
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_INVOKE_AWAIT: {
+			TARGET(OP_INVOKE_AWAIT) {
 				if (!krk_getAwaitable()) goto _finishException;
-				break;
+				DISPATCH();
 			}
-			case OP_FINALIZE: {
+			TARGET(OP_FINALIZE) {
 				KrkClass * _class = AS_CLASS(krk_peek(0));
+				if (unlikely(!krk_applySlots(_class))) goto _finishException;
 				/* Store special methods for quick access */
 				krk_finalizeClass(_class);
-				break;
+				DISPATCH();
 			}
-			case OP_INHERIT: {
+			TARGET(OP_INHERIT) {
 				KrkValue superclass = krk_peek(0);
 				if (unlikely(!IS_CLASS(superclass))) {
 					krk_runtimeError(vm.exceptions->typeError, "Superclass must be a class, not '%s'",
@@ -2544,22 +3640,27 @@ _finishReturn: (void)0;
 					krk_tableDelete(&subclass->base->subclasses, krk_peek(1));
 				}
 				subclass->base = AS_CLASS(superclass);
+				krk_gcWriteBarrier((KrkObj*)subclass);
 				subclass->allocSize = AS_CLASS(superclass)->allocSize;
+				subclass->slotsStart = AS_CLASS(superclass)->slotsStart;
 				subclass->_ongcsweep = AS_CLASS(superclass)->_ongcsweep;
 				subclass->_ongcscan = AS_CLASS(superclass)->_ongcscan;
+				subclass->_ongetbuffer = AS_CLASS(superclass)->_ongetbuffer;
 				krk_tableSet(&AS_CLASS(superclass)->subclasses, krk_peek(1), NONE_VAL());
+				krk_bumpClassVersion(subclass);
 				krk_pop(); /* Super class */
-				break;
+				DISPATCH();
 			}
-			case OP_DOCSTRING: {
+			TARGET(OP_DOCSTRING) {
 				KrkClass * me = AS_CLASS(krk_peek(1));
 				me->docstring = AS_STRING(krk_pop());
-				break;
+				krk_gcWriteBarrier((KrkObj*)me);
+				DISPATCH();
 			}
-			case OP_SWAP:
+			TARGET(OP_SWAP)
 				krk_swap(1);
-				break;
-			case OP_FILTER_EXCEPT: {
+				DISPATCH();
+			TARGET(OP_FILTER_EXCEPT) {
 				int isMatch = 0;
 				if (AS_HANDLER_TYPE(krk_peek(1)) == OP_RETURN) {
 					isMatch = 0;
@@ -2582,9 +3683,9 @@ _finishReturn: (void)0;
 				}
 				krk_pop();
 				krk_push(BOOLEAN_VAL(isMatch));
-				break;
+				DISPATCH();
 			}
-			case OP_BEGIN_FINALLY: {
+			TARGET(OP_BEGIN_FINALLY) {
 				if (IS_HANDLER(krk_peek(0))) {
 					if (AS_HANDLER_TYPE(krk_peek(0)) == OP_PUSH_TRY) {
 						krk_currentThread.stackTop[-1] = HANDLER_VAL(OP_BEGIN_FINALLY,AS_HANDLER_TARGET(krk_peek(0)));
@@ -2592,9 +3693,9 @@ _finishReturn: (void)0;
 						krk_currentThread.stackTop[-1] = HANDLER_VAL(OP_BEGIN_FINALLY,AS_HANDLER_TARGET(krk_peek(0)));
 					}
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_END_FINALLY: {
+			TARGET(OP_END_FINALLY) {
 				KrkValue handler = krk_peek(0);
 				if (IS_HANDLER(handler)) {
 					if (AS_HANDLER_TYPE(handler) == OP_RAISE || AS_HANDLER_TYPE(handler) == OP_END_FINALLY) {
@@ -2607,9 +3708,9 @@ _finishReturn: (void)0;
 						goto _finishReturn;
 					}
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_BREAKPOINT: {
+			TARGET(OP_BREAKPOINT) {
 #ifndef KRK_DISABLE_DEBUG
 				/* First off, halt execution. */
 				krk_debugBreakpointHandler();
@@ -2620,17 +3721,18 @@ _finishReturn: (void)0;
 				goto _finishException;
 #endif
 			}
-			case OP_YIELD: {
+			TARGET(OP_YIELD) {
 				KrkValue result = krk_peek(0);
 				krk_currentThread.frameCount--;
 				assert(krk_currentThread.frameCount == (size_t)krk_currentThread.exitOnFrame);
 				/* Do NOT restore the stack */
 				return result;
 			}
-			case OP_ANNOTATE: {
+			TARGET(OP_ANNOTATE) {
 				if (IS_CLOSURE(krk_peek(0))) {
 					krk_swap(1);
 					AS_CLOSURE(krk_peek(1))->annotations = krk_peek(0);
+					krk_gcWriteBarrier(AS_OBJECT(krk_peek(1)));
 					krk_pop();
 				} else if (IS_NONE(krk_peek(0))) {
 					krk_swap(1);
@@ -2639,53 +3741,54 @@ _finishReturn: (void)0;
 					krk_runtimeError(vm.exceptions->typeError, "Can not annotate '%s'.", krk_typeName(krk_peek(0)));
 					goto _finishException;
 				}
-				break;
+				DISPATCH();
 			}
 
 			/*
 			 * Two-byte operands
 			 */
-			case OP_JUMP_IF_FALSE_OR_POP: {
+			TARGET(OP_JUMP_IF_FALSE_OR_POP) {
 				TWO_BYTE_OPERAND;
 				uint16_t offset = OPERAND;
 				if (krk_peek(0) == BOOLEAN_VAL(0) || krk_isFalsey(krk_peek(0))) frame->ip += offset;
 				else krk_pop();
-				break;
+				DISPATCH();
 			}
-			case OP_POP_JUMP_IF_FALSE: {
+			TARGET(OP_POP_JUMP_IF_FALSE) {
 				TWO_BYTE_OPERAND;
 				uint16_t offset = OPERAND;
 				if (krk_peek(0) == BOOLEAN_VAL(0) || krk_isFalsey(krk_peek(0))) frame->ip += offset;
 				krk_pop();
-				break;
+				DISPATCH();
 			}
-			case OP_JUMP_IF_TRUE_OR_POP: {
+			TARGET(OP_JUMP_IF_TRUE_OR_POP) {
 				TWO_BYTE_OPERAND;
 				uint16_t offset = OPERAND;
 				if (!krk_isFalsey(krk_peek(0))) frame->ip += offset;
 				else krk_pop();
-				break;
+				DISPATCH();
 			}
-			case OP_JUMP: {
+			TARGET(OP_JUMP) {
 				TWO_BYTE_OPERAND;
 				frame->ip += OPERAND;
-				break;
+				DISPATCH();
 			}
-			case OP_LOOP: {
+			TARGET(OP_LOOP) {
 				TWO_BYTE_OPERAND;
 				uint16_t offset = OPERAND;
 				frame->ip -= offset;
-				break;
+				CHECK_HOOKS();
+				DISPATCH();
 			}
-			case OP_PUSH_TRY: {
+			TARGET(OP_PUSH_TRY) {
 				TWO_BYTE_OPERAND;
 				uint16_t tryTarget = OPERAND + (frame->ip - frame->closure->function->chunk.code);
 				krk_push(NONE_VAL());
 				KrkValue handler = HANDLER_VAL(OP_PUSH_TRY, tryTarget);
 				krk_push(handler);
-				break;
+				DISPATCH();
 			}
-			case OP_PUSH_WITH: {
+			TARGET(OP_PUSH_WITH) {
 				TWO_BYTE_OPERAND;
 				uint16_t cleanupTarget = OPERAND + (frame->ip - frame->closure->function->chunk.code);
 				KrkValue contextManager = krk_peek(0);
@@ -2701,15 +3804,20 @@ _finishReturn: (void)0;
 				krk_push(NONE_VAL());
 				KrkValue handler = HANDLER_VAL(OP_PUSH_WITH, cleanupTarget);
 				krk_push(handler);
-				break;
+				DISPATCH();
 			}
-			case OP_YIELD_FROM: {
+			TARGET(OP_YIELD_FROM) {
 				TWO_BYTE_OPERAND;
 				uint8_t * exitIp = frame->ip + OPERAND;
 				/* Stack has [iterator] [sent value] */
+				int isGenerator = IS_INSTANCE(krk_peek(1)) && AS_INSTANCE(krk_peek(1))->_class == vm.baseClasses->generatorClass;
 				/* Is this a generator or something with a 'send' method? */
-				KrkValue method = krk_valueGetAttribute_default(krk_peek(1), "send", NONE_VAL());
-				if (!IS_NONE(method)) {
+				KrkValue method = isGenerator ? NONE_VAL() : krk_valueGetAttribute_default(krk_peek(1), "send", NONE_VAL());
+				if (isGenerator) {
+					/* The stack can move while the generator runs. */
+					KrkValue result = krk_generatorSend(krk_peek(1), krk_peek(0));
+					krk_currentThread.stackTop[-1] = result;
+				} else if (!IS_NONE(method)) {
 					krk_push(method);
 					krk_swap(1);
 					krk_push(krk_callStack(1));
@@ -2720,14 +3828,16 @@ _finishReturn: (void)0;
 				}
 				if (!krk_valuesSame(krk_peek(0), krk_peek(1))) {
 					/* Value to yield */
-					break;
+					DISPATCH();
 				}
 
 				krk_pop();
 
 				/* Does it have a final value? */
-				method = krk_valueGetAttribute_default(krk_peek(0), "__finish__", NONE_VAL());
-				if (!IS_NONE(method)) {
+				method = isGenerator ? NONE_VAL() : krk_valueGetAttribute_default(krk_peek(0), "__finish__", NONE_VAL());
+				if (isGenerator) {
+					krk_currentThread.stackTop[-1] = krk_generatorResult(krk_peek(0));
+				} else if (!IS_NONE(method)) {
 					krk_push(method);
 					krk_swap(1);
 					krk_pop();
@@ -2737,64 +3847,96 @@ _finishReturn: (void)0;
 					krk_push(NONE_VAL());
 				}
 				frame->ip = exitIp;
-				break;
+				DISPATCH();
 			}
-			case OP_CALL_ITER: {
+			TARGET(OP_CALL_ITER) {
 				TWO_BYTE_OPERAND;
 				uint16_t offset = OPERAND;
 				KrkValue iter = krk_peek(0);
-				krk_push(iter);
-				krk_push(krk_callStack(0));
+				int stepped = iterateBuiltin(iter, frame->ip[0] == OP_UNPACK && frame->ip[1] == 2);
+				if (stepped == 2) {
+					frame->ip += 2;
+					DISPATCH();
+				}
+				if (!stepped) {
+					krk_push(iter);
+					krk_push(krk_callStack(0));
+				}
 				/* krk_valuesSame() */
 				if (iter == krk_peek(0)) frame->ip += offset;
-				break;
+				DISPATCH();
 			}
-			case OP_LOOP_ITER: {
+			TARGET(OP_LOOP_ITER) {
 				TWO_BYTE_OPERAND;
 				uint16_t offset = OPERAND;
 				KrkValue iter = krk_peek(0);
-				krk_push(iter);
-				krk_push(krk_callStack(0));
+				uint8_t * body = frame->ip - offset;
+				int stepped = iterateBuiltin(iter, body[0] == OP_UNPACK && body[1] == 2);
+				if (stepped == 2) {
+					frame->ip = body + 2;
+					CHECK_HOOKS();
+					DISPATCH();
+				}
+				if (!stepped) {
+					krk_push(iter);
+					krk_push(krk_callStack(0));
+				}
 				if (iter != krk_peek(0)) frame->ip -= offset;
-				break;
+				CHECK_HOOKS();
+				DISPATCH();
 			}
 
-			case OP_CONSTANT_LONG:
+			TARGET(OP_CONSTANT_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_CONSTANT: {
+			TARGET(OP_CONSTANT) {
 				ONE_BYTE_OPERAND;
 				size_t index = OPERAND;
 				KrkValue constant = frame->closure->function->chunk.constants.values[index];
 				krk_push(constant);
-				break;
+				DISPATCH();
 			}
-			case OP_DEFINE_GLOBAL_LONG:
+			TARGET(OP_DEFINE_GLOBAL_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_DEFINE_GLOBAL: {
+			TARGET(OP_DEFINE_GLOBAL) {
 				ONE_BYTE_OPERAND;
 				KrkString * name = READ_STRING(OPERAND);
 				krk_tableSet(frame->globals, OBJECT_VAL(name), krk_peek(0));
 				krk_pop();
-				break;
+				DISPATCH();
 			}
-			case OP_GET_GLOBAL_LONG:
+			TARGET(OP_GET_GLOBAL_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_GET_GLOBAL: {
+			TARGET(OP_GET_GLOBAL) {
 				ONE_BYTE_OPERAND;
+				KrkInlineCache * cache = inlineCache(frame->closure->function, OPERAND);
+				size_t sequence = cacheReadBegin(cache);
+				KrkTableEntry * cachedEntry = cache->as.global.entry;
+				size_t globalsVersion = cache->as.global.globalsVersion;
+				size_t builtinsVersion = cache->as.global.builtinsVersion;
+				if (likely(cachedEntry && globalsVersion == frame->globals->version &&
+				    builtinsVersion == vm.builtins->fields.version && cacheReadValid(cache, sequence))) {
+					krk_push(cachedEntry->value);
+					DISPATCH();
+				}
 				KrkString * name = READ_STRING(OPERAND);
-				KrkValue value;
-				if (!krk_tableGet_fast(frame->globals, name, &value)) {
-					if (!krk_tableGet_fast(&vm.builtins->fields, name, &value)) {
-						krk_runtimeError(vm.exceptions->nameError, "Undefined variable '%s'.", name->chars);
-						goto _finishException;
-					}
+				KrkTableEntry * entry = krk_findEntry_fast(frame->globals, name);
+				if (!entry) entry = krk_findEntry_fast(&vm.builtins->fields, name);
+				if (!entry) {
+					krk_runtimeError(vm.exceptions->nameError, "Undefined variable '%s'.", name->chars);
+					goto _finishException;
 				}
-				krk_push(value);
-				break;
+				if (cacheWriteBegin(cache)) {
+					cache->as.global.entry = entry;
+					cache->as.global.globalsVersion = frame->globals->version;
+					cache->as.global.builtinsVersion = vm.builtins->fields.version;
+					cacheWriteEnd(cache);
+				}
+				krk_push(entry->value);
+				DISPATCH();
 			}
-			case OP_SET_GLOBAL_LONG:
+			TARGET(OP_SET_GLOBAL_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_SET_GLOBAL: {
+			TARGET(OP_SET_GLOBAL) {
 				ONE_BYTE_OPERAND;
 				KrkString * name = READ_STRING(OPERAND);
 				if (krk_tableSet(frame->globals, OBJECT_VAL(name), krk_peek(0))) {
@@ -2802,61 +3944,114 @@ _finishReturn: (void)0;
 					krk_runtimeError(vm.exceptions->nameError, "Undefined variable '%s'.", name->chars);
 					goto _finishException;
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_DEL_GLOBAL_LONG:
+			TARGET(OP_DEL_GLOBAL_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_DEL_GLOBAL: {
+			TARGET(OP_DEL_GLOBAL) {
 				ONE_BYTE_OPERAND;
 				KrkString * name = READ_STRING(OPERAND);
 				if (!krk_tableDelete(frame->globals, OBJECT_VAL(name))) {
 					krk_runtimeError(vm.exceptions->nameError, "Undefined variable '%s'.", name->chars);
 					goto _finishException;
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_IMPORT_LONG:
+			TARGET(OP_IMPORT_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_IMPORT: {
+			TARGET(OP_IMPORT) {
 				ONE_BYTE_OPERAND;
 				KrkString * name = READ_STRING(OPERAND);
-				if (!krk_doRecursiveModuleLoad(name)) {
+				if (!((vm.globalFlags & KRK_GLOBAL_LAZY_IMPORTS) ? importLazily(name) : krk_doRecursiveModuleLoad(name))) {
 					goto _finishException;
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_GET_LOCAL_LONG:
+			TARGET(OP_GET_LOCAL_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_GET_LOCAL: {
+			TARGET(OP_GET_LOCAL) {
 				ONE_BYTE_OPERAND;
+				krk_escapeValue(krk_currentThread.stack[frame->slots + OPERAND]);
 				krk_push(krk_currentThread.stack[frame->slots + OPERAND]);
-				break;
+				DISPATCH();
+			}
+			TARGET(OP_GET_LOCAL_INPLACE_LONG)
+				THREE_BYTE_OPERAND;
+			TARGET(OP_GET_LOCAL_INPLACE) {
+				/* The left side of 'local += value', which may be a string that is appended to in place. */
+				ONE_BYTE_OPERAND;
+				krk_push(krk_currentThread.stack[frame->slots + OPERAND]);
+				DISPATCH();
+			}
+			TARGET(OP_ADD_LOCAL_LOCAL) {
+				/* GET_LOCAL a; GET_LOCAL b; ADD */
+				ONE_BYTE_OPERAND;
+				if (unlikely(frame->ip[0] != OP_GET_LOCAL || frame->ip[2] != OP_ADD)) {
+					/* Something (probably a breakpoint) has replaced one of the instructions we cover */
+					frame->ip[-2] = OP_GET_LOCAL;
+					krk_escapeValue(krk_currentThread.stack[frame->slots + OPERAND]);
+					krk_push(krk_currentThread.stack[frame->slots + OPERAND]);
+					DISPATCH();
+				}
+				KrkValue a = krk_currentThread.stack[frame->slots + OPERAND];
+				KrkValue b = krk_currentThread.stack[frame->slots + frame->ip[1]];
+				frame->ip += 3;
+				if (likely(BOTH_INT(a,b))) {
+					krk_push(INTEGER_VAL(AS_INTEGER(a) + AS_INTEGER(b)));
+				} else {
+					krk_escapeValue(a);
+					krk_escapeValue(b);
+					krk_push(krk_operator_add(a,b));
+				}
+				DISPATCH();
+			}
+			TARGET(OP_LESS_LOCAL_CONST) {
+				/* GET_LOCAL a; CONSTANT b; LESS */
+				ONE_BYTE_OPERAND;
+				if (unlikely(frame->ip[0] != OP_CONSTANT || frame->ip[2] != OP_LESS)) {
+					frame->ip[-2] = OP_GET_LOCAL;
+					krk_escapeValue(krk_currentThread.stack[frame->slots + OPERAND]);
+					krk_push(krk_currentThread.stack[frame->slots + OPERAND]);
+					DISPATCH();
+				}
+				KrkValue a = krk_currentThread.stack[frame->slots + OPERAND];
+				KrkValue b = frame->closure->function->chunk.constants.values[frame->ip[1]];
+				frame->ip += 3;
+				if (likely(BOTH_INT(a,b))) {
+					krk_push(BOOLEAN_VAL(AS_INTEGER(a) < AS_INTEGER(b)));
+				} else {
+					krk_escapeValue(a);
+					krk_push(krk_operator_lt(a,b));
+				}
+				DISPATCH();
 			}
-			case OP_SET_LOCAL_LONG:
+			TARGET(OP_SET_LOCAL_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_SET_LOCAL: {
+			TARGET(OP_SET_LOCAL) {
 				ONE_BYTE_OPERAND;
 				krk_currentThread.stack[frame->slots + OPERAND] = krk_peek(0);
-				break;
+				DISPATCH();
 			}
-			case OP_SET_LOCAL_POP_LONG:
+			TARGET(OP_SET_LOCAL_POP_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_SET_LOCAL_POP: {
+			TARGET(OP_SET_LOCAL_POP) {
 				ONE_BYTE_OPERAND;
 				krk_currentThread.stack[frame->slots + OPERAND] = krk_pop();
-				break;
+				DISPATCH();
 			}
-			case OP_CALL_LONG:
+			TARGET(OP_CALL_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_CALL: {
+			TARGET(OP_CALL) {
 				ONE_BYTE_OPERAND;
 				if (unlikely(!krk_callValue(krk_peek(OPERAND), OPERAND, 1))) goto _finishException;
 				frame = &krk_currentThread.frames[krk_currentThread.frameCount - 1];
-				break;
+				SYNC_LINE_PROFILE(frame);
+				CHECK_HOOKS();
+				DISPATCH();
 			}
-			case OP_CALL_METHOD_LONG:
+			TARGET(OP_CALL_METHOD_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_CALL_METHOD: {
+			TARGET(OP_CALL_METHOD) {
 				ONE_BYTE_OPERAND;
 				if (IS_NONE(krk_peek(OPERAND+1))) {
 					if (unlikely(!krk_callValue(krk_peek(OPERAND), OPERAND, 2))) goto _finishException;
@@ -2864,18 +4059,20 @@ _finishReturn: (void)0;
 					if (unlikely(!krk_callValue(krk_peek(OPERAND+1), OPERAND+1, 1))) goto _finishException;
 				}
 				frame = &krk_currentThread.frames[krk_currentThread.frameCount - 1];
-				break;
+				SYNC_LINE_PROFILE(frame);
+				CHECK_HOOKS();
+				DISPATCH();
 			}
-			case OP_EXPAND_ARGS_LONG:
+			TARGET(OP_EXPAND_ARGS_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_EXPAND_ARGS: {
+			TARGET(OP_EXPAND_ARGS) {
 				ONE_BYTE_OPERAND;
 				krk_push(KWARGS_VAL(KWARGS_SINGLE-OPERAND));
-				break;
+				DISPATCH();
 			}
-			case OP_CLOSURE_LONG:
+			TARGET(OP_CLOSURE_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_CLOSURE: {
+			TARGET(OP_CLOSURE) {
 				ONE_BYTE_OPERAND;
 				KrkCodeObject * function = AS_codeobject(READ_CONSTANT(OPERAND));
 				KrkClosure * closure = krk_newClosure(function);
@@ -2892,40 +4089,47 @@ _finishReturn: (void)0;
 					} else {
 						closure->upvalues[i] = frame->closure->upvalues[index];
 					}
+					krk_gcWriteBarrier((KrkObj*)closure);
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_GET_UPVALUE_LONG:
+			TARGET(OP_GET_UPVALUE_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_GET_UPVALUE: {
+			TARGET(OP_GET_UPVALUE) {
 				ONE_BYTE_OPERAND;
+				krk_escapeValue(*UPVALUE_LOCATION(frame->closure->upvalues[OPERAND]));
 				krk_push(*UPVALUE_LOCATION(frame->closure->upvalues[OPERAND]));
-				break;
+				DISPATCH();
 			}
-			case OP_SET_UPVALUE_LONG:
+			TARGET(OP_SET_UPVALUE_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_SET_UPVALUE: {
+			TARGET(OP_SET_UPVALUE) {
 				ONE_BYTE_OPERAND;
 				*UPVALUE_LOCATION(frame->closure->upvalues[OPERAND]) = krk_peek(0);
-				break;
+				krk_gcWriteBarrier((KrkObj*)frame->closure->upvalues[OPERAND]);
+				DISPATCH();
 			}
-			case OP_CLASS_LONG:
+			TARGET(OP_CLASS_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_CLASS: {
+			TARGET(OP_CLASS) {
 				ONE_BYTE_OPERAND;
 				KrkString * name = READ_STRING(OPERAND);
 				KrkClass * _class = krk_newClass(name, vm.baseClasses->objectClass);
 				krk_push(OBJECT_VAL(_class));
 				_class->filename = frame->closure->function->chunk.filename;
+				krk_gcWriteBarrier((KrkObj*)_class);
 				krk_attachNamedObject(&_class->methods, "__func__", (KrkObj*)frame->closure);
-				break;
+				DISPATCH();
 			}
-			case OP_IMPORT_FROM_LONG:
+			TARGET(OP_IMPORT_FROM_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_IMPORT_FROM: {
+			TARGET(OP_IMPORT_FROM) {
 				ONE_BYTE_OPERAND;
 				KrkString * name = READ_STRING(OPERAND);
-				if (unlikely(!valueGetProperty(name))) {
+				if (unlikely(IS_INSTANCE(krk_peek(0)) && AS_INSTANCE(krk_peek(0))->_class == vm.baseClasses->lazyModuleClass)) {
+					if (!resolveLazyModule(AS_INSTANCE(krk_peek(0)))) goto _finishException;
+				}
+				if (unlikely(!valueGetProperty(name, NULL))) {
 					/* Try to import... */
 					KrkValue moduleName;
 					if (!krk_tableGet(&AS_INSTANCE(krk_peek(0))->fields, vm.specialMethodNames[METHOD_NAME], &moduleName)) {
@@ -2944,57 +4148,59 @@ _finishReturn: (void)0;
 					krk_currentThread.stackTop[-3] = krk_currentThread.stackTop[-1];
 					krk_currentThread.stackTop -= 2;
 				}
-			} break;
-			case OP_GET_PROPERTY_LONG:
+				DISPATCH();
+			}
+			TARGET(OP_GET_PROPERTY_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_GET_PROPERTY: {
+			TARGET(OP_GET_PROPERTY) {
 				ONE_BYTE_OPERAND;
 				KrkString * name = READ_STRING(OPERAND);
-				if (unlikely(!valueGetProperty(name))) {
+				if (unlikely(!valueGetProperty(name, inlineCache(frame->closure->function, OPERAND)))) {
 					krk_runtimeError(vm.exceptions->attributeError, "'%s' object has no attribute '%s'", krk_typeName(krk_peek(0)), name->chars);
 					goto _finishException;
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_DEL_PROPERTY_LONG:
+			TARGET(OP_DEL_PROPERTY_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_DEL_PROPERTY: {
+			TARGET(OP_DEL_PROPERTY) {
 				ONE_BYTE_OPERAND;
 				KrkString * name = READ_STRING(OPERAND);
 				if (unlikely(!valueDelProperty(name))) {
 					krk_runtimeError(vm.exceptions->attributeError, "'%s' object has no attribute '%s'", krk_typeName(krk_peek(0)), name->chars);
 					goto _finishException;
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_SET_PROPERTY_LONG:
+			TARGET(OP_SET_PROPERTY_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_SET_PROPERTY: {
+			TARGET(OP_SET_PROPERTY) {
 				ONE_BYTE_OPERAND;
 				KrkString * name = READ_STRING(OPERAND);
-				if (unlikely(!valueSetProperty(name))) {
+				if (unlikely(!valueSetProperty(name, inlineCache(frame->closure->function, OPERAND)))) {
 					krk_runtimeError(vm.exceptions->attributeError, "'%s' object has no attribute '%s'", krk_typeName(krk_peek(1)), name->chars);
 					goto _finishException;
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_CLASS_PROPERTY_LONG:
+			TARGET(OP_CLASS_PROPERTY_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_CLASS_PROPERTY: {
+			TARGET(OP_CLASS_PROPERTY) {
 				ONE_BYTE_OPERAND;
 				KrkValue method = krk_peek(0);
 				KrkClass * _class = AS_CLASS(krk_peek(1));
 				KrkValue name = OBJECT_VAL(READ_STRING(OPERAND));
 				krk_tableSet(&_class->methods, name, method);
+				krk_bumpClassVersion(_class);
 				if (AS_STRING(name) == S("__class_getitem__") && IS_CLOSURE(method)) {
 					AS_CLOSURE(method)->obj.flags |= KRK_OBJ_FLAGS_FUNCTION_IS_CLASS_METHOD;
 				}
 				krk_pop();
-				break;
+				DISPATCH();
 			}
-			case OP_GET_SUPER_LONG:
+			TARGET(OP_GET_SUPER_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_GET_SUPER: {
+			TARGET(OP_GET_SUPER) {
 				ONE_BYTE_OPERAND;
 				KrkString * name = READ_STRING(OPERAND);
 				KrkValue baseClass = krk_peek(1);
@@ -3024,14 +4230,14 @@ _finishReturn: (void)0;
 				krk_swap(1);
 				/* Pop super class */
 				krk_pop();
-				break;
+				DISPATCH();
 			}
-			case OP_GET_METHOD_LONG:
+			TARGET(OP_GET_METHOD_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_GET_METHOD: {
+			TARGET(OP_GET_METHOD) {
 				ONE_BYTE_OPERAND;
 				KrkString * name = READ_STRING(OPERAND);
-				int result = valueGetMethod(name);
+				int result = valueGetMethod(name, inlineCache(frame->closure->function, OPERAND));
 				if (result == 2) {
 					krk_push(NONE_VAL());
 					krk_swap(2);
@@ -3042,39 +4248,39 @@ _finishReturn: (void)0;
 				} else {
 					krk_swap(1); /* unbound-method object */
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_DUP_LONG:
+			TARGET(OP_DUP_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_DUP:
+			TARGET(OP_DUP)
 				ONE_BYTE_OPERAND;
 				krk_push(krk_peek(OPERAND));
-				break;
-			case OP_KWARGS_LONG:
+				DISPATCH();
+			TARGET(OP_KWARGS_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_KWARGS: {
+			TARGET(OP_KWARGS) {
 				ONE_BYTE_OPERAND;
 				krk_push(KWARGS_VAL(OPERAND));
-				break;
+				DISPATCH();
 			}
-			case OP_CLOSE_MANY_LONG:
+			TARGET(OP_CLOSE_MANY_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_CLOSE_MANY: {
+			TARGET(OP_CLOSE_MANY) {
 				ONE_BYTE_OPERAND;
 				for (int i = 0; i < OPERAND; ++i) {
 					closeUpvalues((krk_currentThread.stackTop - krk_currentThread.stack)-1);
 					krk_pop();
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_POP_MANY_LONG:
+			TARGET(OP_POP_MANY_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_POP_MANY: {
+			TARGET(OP_POP_MANY) {
 				ONE_BYTE_OPERAND;
 				for (int i = 0; i < OPERAND; ++i) {
 					krk_pop();
 				}
-				break;
+				DISPATCH();
 			}
 #define doMake(func) { \
 	size_t count = OPERAND; \
@@ -3088,75 +4294,89 @@ _finishReturn: (void)0;
 		krk_push(collection); \
 	} \
 }
-			case OP_TUPLE_LONG:
+			TARGET(OP_TUPLE_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_TUPLE: {
+			TARGET(OP_TUPLE) {
 				ONE_BYTE_OPERAND;
 				doMake(krk_tuple_of);
-				break;
+				DISPATCH();
 			}
-			case OP_MAKE_LIST_LONG:
+			TARGET(OP_BUILD_STRING_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_MAKE_LIST: {
+			TARGET(OP_BUILD_STRING) {
+				ONE_BYTE_OPERAND;
+				if (unlikely(!krk_buildString(OPERAND))) goto _finishException;
+				DISPATCH();
+			}
+			TARGET(OP_FORMAT_VALUE_LONG)
+				THREE_BYTE_OPERAND;
+			TARGET(OP_FORMAT_VALUE) {
+				ONE_BYTE_OPERAND;
+				if (unlikely(!krk_formatValueOnStack(OPERAND))) goto _finishException;
+				DISPATCH();
+			}
+			TARGET(OP_MAKE_LIST_LONG)
+				THREE_BYTE_OPERAND;
+			TARGET(OP_MAKE_LIST) {
 				ONE_BYTE_OPERAND;
 				doMake(krk_list_of);
-				break;
+				DISPATCH();
 			}
-			case OP_MAKE_DICT_LONG:
+			TARGET(OP_MAKE_DICT_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_MAKE_DICT: {
+			TARGET(OP_MAKE_DICT) {
 				ONE_BYTE_OPERAND;
 				doMake(krk_dict_of);
-				break;
+				DISPATCH();
 			}
-			case OP_MAKE_SET_LONG:
+			TARGET(OP_MAKE_SET_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_MAKE_SET: {
+			TARGET(OP_MAKE_SET) {
 				ONE_BYTE_OPERAND;
 				doMake(krk_set_of);
-				break;
+				DISPATCH();
 			}
-			case OP_SLICE_LONG:
+			TARGET(OP_SLICE_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_SLICE: {
+			TARGET(OP_SLICE) {
 				ONE_BYTE_OPERAND;
 				doMake(krk_slice_of);
-				break;
+				DISPATCH();
 			}
-			case OP_LIST_APPEND_LONG:
+			TARGET(OP_LIST_APPEND_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_LIST_APPEND: {
+			TARGET(OP_LIST_APPEND) {
 				ONE_BYTE_OPERAND;
 				uint32_t slot = OPERAND;
 				KrkValue list = krk_currentThread.stack[frame->slots + slot];
 				FUNC_NAME(list,append)(2,(KrkValue[]){list,krk_peek(0)},0);
 				krk_pop();
-				break;
+				DISPATCH();
 			}
-			case OP_DICT_SET_LONG:
+			TARGET(OP_DICT_SET_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_DICT_SET: {
+			TARGET(OP_DICT_SET) {
 				ONE_BYTE_OPERAND;
 				uint32_t slot = OPERAND;
 				KrkValue dict = krk_currentThread.stack[frame->slots + slot];
 				FUNC_NAME(dict,__setitem__)(3,(KrkValue[]){dict,krk_peek(1),krk_peek(0)},0);
 				krk_pop();
 				krk_pop();
-				break;
+				DISPATCH();
 			}
-			case OP_SET_ADD_LONG:
+			TARGET(OP_SET_ADD_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_SET_ADD: {
+			TARGET(OP_SET_ADD) {
 				ONE_BYTE_OPERAND;
 				uint32_t slot = OPERAND;
 				KrkValue set = krk_currentThread.stack[frame->slots + slot];
 				FUNC_NAME(set,add)(2,(KrkValue[]){set,krk_peek(0)},0);
 				krk_pop();
-				break;
+				DISPATCH();
 			}
-			case OP_REVERSE_LONG:
+			TARGET(OP_REVERSE_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_REVERSE: {
+			TARGET(OP_REVERSE) {
 				ONE_BYTE_OPERAND;
 				krk_push(NONE_VAL()); /* Storage space */
 				for (int i = 0; i < OPERAND / 2; ++i) {
@@ -3165,11 +4385,11 @@ _finishReturn: (void)0;
 					krk_currentThread.stackTop[-(OPERAND-i)-1] = krk_currentThread.stackTop[-1];
 				}
 				krk_pop();
-				break;
+				DISPATCH();
 			}
-			case OP_UNPACK_LONG:
+			TARGET(OP_UNPACK_LONG)
 				THREE_BYTE_OPERAND;
-			case OP_UNPACK: {
+			TARGET(OP_UNPACK) {
 				ONE_BYTE_OPERAND;
 				size_t count = OPERAND;
 				KrkValue sequence = krk_peek(0);
@@ -3233,13 +4453,21 @@ _finishReturn: (void)0;
 					}
 				}
 #undef unpackArray
-				break;
+				DISPATCH();
 			}
+			default:
+#ifdef USE_COMPUTED_GOTO
+			_invalidOpcode:
+#endif
+				krk_runtimeError(vm.exceptions->baseException, "Invalid opcode %d at offset %zu", (int)opcode,
+					(size_t)(frame->ip - frame->closure->function->chunk.code - 1));
+				goto _finishException;
 		}
 		if (unlikely(krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION)) {
 _finishException:
 			if (!handleException()) {
 				frame = &krk_currentThread.frames[krk_currentThread.frameCount - 1];
+				SYNC_LINE_PROFILE(frame);
 				frame->ip = frame->closure->function->chunk.code + AS_HANDLER_TARGET(krk_peek(0));
 				/* Stick the exception into the exception slot */
 				if (AS_HANDLER_TYPE(krk_currentThread.stackTop[-1])== OP_FILTER_EXCEPT) {
@@ -3257,6 +4485,12 @@ _finishException:
 #undef BINARY_OP
 #undef READ_BYTE
 }
+#undef TARGET
+#undef DISPATCH
+#undef CHECK_HOOKS
+#ifdef USE_COMPUTED_GOTO
+# pragma GCC diagnostic pop
+#endif
 
 /**
  * Run the VM until it returns from the current call frame;
@@ -3271,6 +4505,8 @@ KrkValue krk_runNext(void) {
 	krk_currentThread.exitOnFrame = krk_currentThread.frameCount - 1;
 	KrkValue result = run();
 	krk_currentThread.exitOnFrame = oldExit;
+	/* The caller's frame is current again; a nested run may have left the profiling hook set for another function. */
+	if (krk_currentThread.frameCount) SYNC_LINE_PROFILE(&krk_currentThread.frames[krk_currentThread.frameCount - 1]);
 	return result;
 }
 
@@ -3291,6 +4527,10 @@ KrkValue krk_interpret(const char * src, char * fromFile) {
 		return NONE_VAL();
 	}
 
+	return krk_runCodeObject(function);
+}
+
+KrkValue krk_runCodeObject(KrkCodeObject * function) {
 	krk_push(OBJECT_VAL(function));
 	krk_attachNamedObject(&krk_currentThread.module->fields, "__file__", (KrkObj*)function->chunk.filename);
 
@@ -0,0 +1,232 @@
+/**
+ * @file weakref.c
+ * @brief Weak references.
+ *
+ * A weak reference points to an object without keeping it alive. Every
+ * weak reference is kept on a list, which the collector walks once it has
+ * finished marking, the same way it prunes @c vm.strings: references to
+ * objects that were not reached are cleared before those objects are swept,
+ * and references with a callback are queued so the callback can be called
+ * once the interpreter is between instructions again.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <kuroko/vm.h>
+#include <kuroko/object.h>
+#include <kuroko/memory.h>
+#include <kuroko/util.h>
+#include <kuroko/threads.h>
+
+#include "private.h"
+
+static KrkVMLocal refKey;
+#define ref KRK_VM_LOCAL(KrkClass*,refKey)
+
+/**
+ * @brief Weak reference to an object.
+ * @extends KrkInstance
+ */
+struct WeakRef {
+	KrkInstance inst;
+	KrkObj * referent;         /**< The object, or NULL once it has been collected */
+	KrkValue callback;         /**< Called with the reference when it is cleared */
+	struct WeakRef * next;     /**< Links in the list of all weak references */
+	struct WeakRef * prev;
+	uint32_t hash;             /**< Hash of the referent, kept so it survives the referent */
+	unsigned int hashed:1;
+	unsigned int linked:1;
+};
+
+#define IS_ref(o) (krk_isInstanceOf(o,ref))
+#define AS_ref(o) ((struct WeakRef*)AS_OBJECT(o))
+#define CURRENT_CTYPE struct WeakRef *
+#define CURRENT_NAME  self
+
+/* Each VM has its own list, kept in VM-local globals. */
+static KrkVMLocal weakRefsKey;
+#define weakRefs     KRK_VM_LOCAL(struct WeakRef*,weakRefsKey)
+#ifdef ENABLE_THREADING
+static KrkVMLocal weakRefLockKey;
+#define _weakRefLock KRK_VM_LOCAL(volatile int,weakRefLockKey)
+#endif
+
+/**
+ * References whose callbacks are still to be called. This is filled during
+ * collections, where allocating through the VM could start another one.
+ */
+static KrkVMLocal pendingKey, pendingCountKey, pendingCapacityKey;
+#define pending         KRK_VM_LOCAL(struct WeakRef**,pendingKey)
+#define pendingCount    KRK_VM_LOCAL(size_t,pendingCountKey)
+#define pendingCapacity KRK_VM_LOCAL(size_t,pendingCapacityKey)
+
+static void linkRef(struct WeakRef * self) {
+	_obtain_lock(_weakRefLock);
+	self->prev = NULL;
+	self->next = weakRefs;
+	if (weakRefs) weakRefs->prev = self;
+	weakRefs = self;
+	self->linked = 1;
+	_release_lock(_weakRefLock);
+}
+
+static void unlinkRef(struct WeakRef * self) {
+	_obtain_lock(_weakRefLock);
+	if (self->linked) {
+		if (self->prev) self->prev->next = self->next;
+		else weakRefs = self->next;
+		if (self->next) self->next->prev = self->prev;
+		self->linked = 0;
+	}
+	_release_lock(_weakRefLock);
+}
+
+static void _ref_gcscan(KrkInstance * self) {
+	krk_markValue(((struct WeakRef*)self)->callback);
+}
+
+static void _ref_gcsweep(KrkInstance * self) {
+	unlinkRef((struct WeakRef*)self);
+}
+
+static inline int reached(KrkObj * object, int young) {
+	if (object->flags & (KRK_OBJ_FLAGS_IS_MARKED | KRK_OBJ_FLAGS_IMMORTAL)) return 1;
+	/* Minor collections don't mark old objects, which are all assumed to be alive. */
+	return young && (object->flags & KRK_OBJ_FLAGS_GC_OLD);
+}
+
+void krk_clearWeakReferences(int young) {
+	_obtain_lock(_weakRefLock);
+	for (struct WeakRef * weak = weakRefs; weak; weak = weak->next) {
+		if (!weak->referent || reached(weak->referent, young)) continue;
+		weak->referent = NULL;
+		/* Nothing can call a reference that is itself garbage. */
+		if (!IS_NONE(weak->callback) && reached((KrkObj*)weak, young)) {
+			if (pendingCapacity < pendingCount + 1) {
+				pendingCapacity = GROW_CAPACITY(pendingCapacity);
+				pending = realloc(pending, sizeof(struct WeakRef*) * pendingCapacity);
+				if (!pending) exit(1);
+			}
+			pending[pendingCount++] = weak;
+		}
+	}
+	_release_lock(_weakRefLock);
+}
+
+void krk_markWeakReferences(void) {
+	for (size_t i = 0; i < pendingCount; ++i) {
+		krk_markObject((KrkObj*)pending[i]);
+	}
+}
+
+void krk_freeWeakReferences(void) {
+	free(pending);
+	pending = NULL;
+	pendingCount = 0;
+	pendingCapacity = 0;
+}
+
+void krk_runWeakReferenceCallbacks(void) {
+	while (pendingCount) {
+		_obtain_lock(_weakRefLock);
+		struct WeakRef * weak = pendingCount ? pending[--pendingCount] : NULL;
+		if (weak) krk_push(OBJECT_VAL(weak));
+		_release_lock(_weakRefLock);
+		if (!weak) break;
+
+		/* Each callback is only called once. */
+		KrkValue callback = weak->callback;
+		weak->callback = NONE_VAL();
+		krk_push(callback);
+		krk_push(OBJECT_VAL(weak));
+		krk_callStack(1);
+		krk_pop();
+		if (krk_currentThread.flags & KRK_THREAD_HAS_EXCEPTION) return;
+	}
+}
+
+KRK_METHOD(ref,__init__,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	if (!IS_OBJECT(argv[1])) return krk_runtimeError(vm.exceptions->typeError, "cannot create weak reference to '%s' object", krk_typeName(argv[1]));
+	self->referent = AS_OBJECT(argv[1]);
+	self->callback = argc > 2 ? argv[2] : NONE_VAL();
+	self->hashed = 0;
+	krk_gcWriteBarrier((KrkObj*)self);
+	if (!self->linked) linkRef(self);
+	return argv[0];
+})
+
+KRK_METHOD(ref,__call__,{
+	METHOD_TAKES_NONE();
+	return self->referent ? OBJECT_VAL(self->referent) : NONE_VAL();
+})
+
+KRK_METHOD(ref,__hash__,{
+	METHOD_TAKES_NONE();
+	if (!self->hashed) {
+		if (!self->referent) return krk_runtimeError(vm.exceptions->typeError, "weak object has gone away");
+		if (krk_hashValue(OBJECT_VAL(self->referent), &self->hash)) return NONE_VAL();
+		self->hashed = 1;
+	}
+	return INTEGER_VAL(self->hash);
+})
+
+KRK_METHOD(ref,__eq__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_ref(argv[1])) return NOTIMPL_VAL();
+	struct WeakRef * other = AS_ref(argv[1]);
+	/* Once either is dead, references are only equal to themselves. */
+	if (!self->referent || !other->referent) return BOOLEAN_VAL(self == other);
+	return BOOLEAN_VAL(krk_valuesEqual(OBJECT_VAL(self->referent), OBJECT_VAL(other->referent)));
+})
+
+KRK_METHOD(ref,__repr__,{
+	METHOD_TAKES_NONE();
+	char tmp[200];
+	size_t len;
+	if (!self->referent) {
+		len = snprintf(tmp, sizeof(tmp), "<weakref at %p; dead>", (void*)self);
+	} else {
+		len = snprintf(tmp, sizeof(tmp), "<weakref at %p; to '%s' at %p>", (void*)self,
+			krk_typeName(OBJECT_VAL(self->referent)), (void*)self->referent);
+	}
+	return OBJECT_VAL(krk_copyString(tmp, len));
+})
+
+KRK_METHOD(ref,__callback__,{
+	METHOD_TAKES_NONE();
+	return self->callback;
+})
+
+#undef CURRENT_CTYPE
+
+_noexport
+void _createAndBind_weakrefMod(void) {
+	/**
+	 * _weakref = module()
+	 *
+	 * Weak reference type, used by the weakref module.
+	 */
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	krk_attachNamedObject(&vm.modules, "_weakref", (KrkObj*)module);
+	krk_attachNamedObject(&module->fields, "__name__", (KrkObj*)S("_weakref"));
+	krk_attachNamedValue(&module->fields, "__file__", NONE_VAL());
+	KRK_DOC(module, "@brief Weak reference type. See the @c weakref module.");
+
+	krk_makeClass(module, &ref, "ref", vm.baseClasses->objectClass);
+	KRK_DOC(ref,
+		"@brief A reference to an object that does not keep it alive.\n"
+		"@arguments obj,callback=None\n\n"
+		"Calling the reference returns @p obj, or @c None once @p obj has been collected. "
+		"If @p callback is given, it is called with the reference after it has been cleared.");
+	ref->allocSize = sizeof(struct WeakRef);
+	ref->_ongcscan = _ref_gcscan;
+	ref->_ongcsweep = _ref_gcsweep;
+	BIND_METHOD(ref,__init__);
+	BIND_METHOD(ref,__call__);
+	BIND_METHOD(ref,__hash__);
+	BIND_METHOD(ref,__eq__);
+	BIND_METHOD(ref,__repr__);
+	BIND_PROP(ref,__callback__);
+	krk_finalizeClass(ref);
+}
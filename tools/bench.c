@@ -0,0 +1,217 @@
+/**
+ * @file bench.c
+ * @brief Microbenchmarks for the C-level hot paths of the VM.
+ *
+ * Times table lookups, string interning and full garbage collections
+ * directly through the embedding API, without the interpreter loop in
+ * the way. Results are reported like the ones from bench/run.krk, and
+ * the JSON written with --json can be compared with its --compare.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <kuroko/kuroko.h>
+#include <kuroko/vm.h>
+#include <kuroko/memory.h>
+#include <kuroko/util.h>
+
+#define KEYS 256
+
+static KrkInstance * holder;  /**< Keeps the table and the live heap reachable. */
+static KrkValue keys[KEYS];
+static KrkValue missing[KEYS];
+static volatile size_t sink;
+
+static void table_get_hit(void) {
+	KrkValue out;
+	for (size_t i = 0; i < KEYS; ++i) sink += krk_tableGet(&holder->fields, keys[i], &out);
+}
+
+static void table_get_miss(void) {
+	KrkValue out;
+	for (size_t i = 0; i < KEYS; ++i) sink += krk_tableGet(&holder->fields, missing[i], &out);
+}
+
+static void table_get_int(void) {
+	KrkValue out;
+	for (size_t i = 0; i < KEYS; ++i) sink += krk_tableGet(&holder->fields, INTEGER_VAL(i), &out);
+}
+
+static void intern_existing(void) {
+	char name[32];
+	for (size_t i = 0; i < KEYS; ++i) {
+		size_t len = snprintf(name, 32, "key%zu", i);
+		sink += krk_copyString(name, len)->length;
+	}
+}
+
+static void intern_new(void) {
+	static size_t counter = 0;
+	char name[32];
+	for (size_t i = 0; i < KEYS; ++i) {
+		size_t len = snprintf(name, 32, "fresh%zu", counter++);
+		sink += krk_copyString(name, len)->length;
+	}
+}
+
+static void collect_garbage(void) {
+	sink += krk_collectGarbage();
+}
+
+struct Benchmark {
+	const char * name;
+	void (*func)(void);
+	int number;
+};
+
+static struct Benchmark benchmarks[] = {
+	{"c.table_get_hit", table_get_hit, 2000},
+	{"c.table_get_miss", table_get_miss, 2000},
+	{"c.table_get_int", table_get_int, 2000},
+	{"c.intern_existing", intern_existing, 1000},
+	{"c.intern_new", intern_new, 200},
+	{"c.collect_garbage", collect_garbage, 5},
+	{NULL, NULL, 0},
+};
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+static int compareDoubles(const void * a, const void * b) {
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+static void setup(void) {
+	holder = krk_newInstance(vm.baseClasses->objectClass);
+	krk_push(OBJECT_VAL(holder));
+
+	char name[32];
+	for (size_t i = 0; i < KEYS; ++i) {
+		size_t len = snprintf(name, 32, "key%zu", i);
+		keys[i] = OBJECT_VAL(krk_copyString(name, len));
+		krk_push(keys[i]);
+		krk_tableSet(&holder->fields, keys[i], INTEGER_VAL(i));
+		krk_pop();
+		krk_tableSet(&holder->fields, INTEGER_VAL(i), INTEGER_VAL(i));
+	}
+	/* Interned, but never stored in the table. */
+	KrkTuple * absent = krk_newTuple(KEYS);
+	krk_push(OBJECT_VAL(absent));
+	krk_attachNamedObject(&holder->fields, "absent", (KrkObj*)absent);
+	krk_pop();
+	for (size_t i = 0; i < KEYS; ++i) {
+		size_t len = snprintf(name, 32, "missing%zu", i);
+		missing[i] = OBJECT_VAL(krk_copyString(name, len));
+		absent->values.values[absent->values.count++] = missing[i];
+	}
+
+	/* Something for the collector to trace: a list of small tuples. */
+	KrkValue list = krk_list_of(0, NULL, 0);
+	krk_push(list);
+	krk_attachNamedValue(&holder->fields, "live", list);
+	krk_pop();
+	for (size_t i = 0; i < 50000; ++i) {
+		KrkTuple * tuple = krk_newTuple(2);
+		krk_push(OBJECT_VAL(tuple));
+		tuple->values.values[tuple->values.count++] = INTEGER_VAL(i);
+		tuple->values.values[tuple->values.count++] = keys[i % KEYS];
+		krk_writeValueArray(AS_LIST(list), OBJECT_VAL(tuple));
+		krk_pop();
+	}
+}
+
+static void usage(const char * self) {
+	fprintf(stderr, "usage: %s [--warmup N] [--repeat N] [--json FILE] [FILTER...]\n", self);
+}
+
+int main(int argc, char *argv[]) {
+	int warmup = 2;
+	int repeat = 10;
+	const char * jsonPath = NULL;
+	int firstFilter = argc;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--warmup") && i + 1 < argc) warmup = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--repeat") && i + 1 < argc) repeat = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--json") && i + 1 < argc) jsonPath = argv[++i];
+		else if (argv[i][0] == '-') {
+			usage(argv[0]);
+			return 1;
+		} else {
+			firstFilter = i;
+			break;
+		}
+	}
+	if (repeat < 1) repeat = 1;
+
+	krk_initVM(0);
+	krk_startModule("__main__");
+	setup();
+
+	FILE * json = NULL;
+	if (jsonPath) {
+		json = fopen(jsonPath, "w");
+		if (!json) {
+			perror(jsonPath);
+			return 1;
+		}
+		KrkValue version = NONE_VAL();
+		krk_tableGet_fast(&vm.system->fields, S("version"), &version);
+		fprintf(json, "{\"kuroko\": \"%s\", \"warmup\": %d, \"repeat\": %d, \"results\": {",
+			IS_STRING(version) ? AS_CSTRING(version) : "unknown", warmup, repeat);
+	}
+
+	double * samples = malloc(sizeof(double) * repeat);
+	int first = 1;
+
+	for (struct Benchmark * b = benchmarks; b->name; ++b) {
+		if (firstFilter < argc) {
+			int matched = 0;
+			for (int i = firstFilter; i < argc && !matched; ++i) matched = strstr(b->name, argv[i]) != NULL;
+			if (!matched) continue;
+		}
+
+		for (int i = 0; i < warmup; ++i) {
+			for (int n = 0; n < b->number; ++n) b->func();
+		}
+
+		for (int i = 0; i < repeat; ++i) {
+			double before = now();
+			for (int n = 0; n < b->number; ++n) b->func();
+			samples[i] = (now() - before) / b->number;
+		}
+
+		double mean = 0.0;
+		for (int i = 0; i < repeat; ++i) mean += samples[i];
+		mean /= repeat;
+		double variance = 0.0;
+		for (int i = 0; i < repeat; ++i) variance += (samples[i] - mean) * (samples[i] - mean);
+		double stddev = repeat > 1 ? sqrt(variance / (repeat - 1)) : 0.0;
+		qsort(samples, repeat, sizeof(double), compareDoubles);
+		double median = (repeat & 1) ? samples[repeat / 2] : (samples[repeat / 2 - 1] + samples[repeat / 2]) / 2.0;
+
+		fprintf(stdout, "%-32s %12.3f us  +- %5.1f%%\n", b->name, median * 1000000.0, median > 0 ? stddev / median * 100.0 : 0.0);
+
+		if (json) {
+			fprintf(json, "%s\n  \"%s\": {\"number\": %d, \"median\": %.9g, \"mean\": %.9g, \"stddev\": %.9g, \"min\": %.9g, \"max\": %.9g}",
+				first ? "" : ",", b->name, b->number, median, mean, stddev, samples[0], samples[repeat - 1]);
+		}
+		first = 0;
+	}
+
+	free(samples);
+
+	if (json) {
+		fprintf(json, "\n}}\n");
+		fclose(json);
+	}
+
+	krk_freeVM();
+	return 0;
+}